@@ -0,0 +1,504 @@
+//===============================================================================
+// desc: Runs the checks in my platform-neutral modules by name, without the engine, so they can be run anywhere the modules build. Every
+//       check is one entry in a table: "AZBTests <name> [-option value ...]" runs one, "AZBTests all" runs the lot and "AZBTests list"
+//       says what there is. Exits non-zero if anything fails.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_AsyncLoader.h"
+#include "AZB_Benchmark.h"
+#include "AZB_BuddyBitmap.h"
+#include "AZB_DDSReader.h"
+#include "AZB_DescriptorPool.h"
+#include "AZB_ExposureStream.h"
+#include "AZB_FencedPool.h"
+#include "AZB_LightClusters.h"
+#include "AZB_LightSets.h"
+#include "AZB_PageRecycler.h"
+#include "AZB_ParticleSim.h"
+#include "AZB_PostFXReference.h"
+#include "AZB_SSAOReference.h"
+#include "AZB_ShadowCache.h"
+#include "AZB_ShadowCascades.h"
+#include "AZB_SlotMap.h"
+#include "AZB_TLSF.h"
+#include "AZB_TestHarness.h"
+#include "AZB_TextureStreaming.h"
+#include "AZB_ThreadProfiler.h"
+#include "AZB_ToneMapReference.h"
+#include "AZB_Trace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	// -key value pairs after the check's name, read the way CommandLineArgs reads the engine's
+	class Args
+	{
+	public:
+		Args(int argc, char** argv, int first)
+		{
+			for (int i = first; i + 1 < argc; i += 2)
+			{
+				if (argv[i][0] == '-')
+					m_Values[Widen(argv[i] + 1)] = Widen(argv[i + 1]);
+			}
+		}
+
+		bool GetInteger(const wchar_t* key, uint32_t& value) const
+		{
+			const auto found = m_Values.find(key);
+			if (found == m_Values.end())
+				return false;
+			value = (uint32_t)std::wcstoul(found->second.c_str(), nullptr, 10);
+			return true;
+		}
+
+		bool GetString(const wchar_t* key, std::wstring& value) const
+		{
+			const auto found = m_Values.find(key);
+			if (found == m_Values.end())
+				return false;
+			value = found->second;
+			return true;
+		}
+
+	private:
+		// File names are the only strings, and they're passed on as the engine would pass them
+		static std::wstring Widen(const char* text) { return std::wstring(text, text + std::strlen(text)); }
+
+		std::unordered_map<std::wstring, std::wstring> m_Values;
+	};
+
+	typedef bool (*CheckFunction)(const Args& args);
+
+	struct Check
+	{
+		const char* m_Name;
+		const char* m_Description;
+		CheckFunction m_Function;
+	};
+
+	//===============================================================================
+	// Every check prints its own line, and then this says why it failed if it knows
+
+	bool Report(const TestHarness::Result& result)
+	{
+		if (!result.m_FirstFailure.empty())
+			std::printf("    %u of %u checks failed, the first: %s\n", result.m_Failures, result.m_Checks, result.m_FirstFailure.c_str());
+		return result.m_bValid;
+	}
+
+	bool RunBenchmarkSelfTest(const Args&)
+	{
+		Benchmark::SelfTestResult selfTest = Benchmark::RunSelfTest();
+		std::printf("Benchmark self test: %u configs over %u ticks, %u frames prepared, %u/%u checks passed\n",
+			selfTest.m_Configs, selfTest.m_Ticks, selfTest.m_FramesPrepared, selfTest.m_Checks - selfTest.m_Failures, selfTest.m_Checks);
+		return Report(selfTest);
+	}
+
+	// The texture load pipeline against loading one at a time. Uses a fake device, so it says nothing about a GPU - just the scheduling
+	bool RunLoadBenchmark(const Args& args)
+	{
+		AsyncLoad::BenchmarkDesc desc;
+		args.GetInteger(L"requests", desc.m_Requests);
+		desc.m_Requests = std::max(1u, desc.m_Requests);
+		AsyncLoad::BenchmarkResult result = AsyncLoad::RunBenchmark(desc);
+		std::printf("Load benchmark: %u requests, serial %.1f ms, pipelined %.1f ms (%.2fx), %u batches of %.1f on average\n",
+			desc.m_Requests, result.m_SerialMs, result.m_PipelinedMs, result.m_SerialMs / std::max(result.m_PipelinedMs, 0.001),
+			result.m_Batches, result.m_AverageBatchSize);
+		return Report(result);
+	}
+
+	// The streaming residency manager driven by random requests, finishing, failing and cancelled streams, against its own bookkeeping
+	bool RunResidencySelfTest(const Args& args)
+	{
+		TextureStreaming::SelfTestDesc desc;
+		args.GetInteger(L"frames", desc.m_Frames);
+		args.GetInteger(L"textures", desc.m_Textures);
+		TextureStreaming::SelfTestResult result = TextureStreaming::RunSelfTest(desc);
+		std::printf("Residency self test: %u frames of %u textures, %u loads (%u failed), %u evictions, %u cancelled mid-stream, peak %.1f of %.1f MB, %s\n",
+			desc.m_Frames, desc.m_Textures, result.m_Loads, result.m_FailedLoads, result.m_Evictions, result.m_Cancels,
+			result.m_PeakCommittedBytes / (1024.0 * 1024.0), result.m_BudgetBytes / (1024.0 * 1024.0), result.m_bValid ? "within budget" : "BUDGET BROKEN");
+		return Report(result);
+	}
+
+	// Random allocate/free churn through both buddy allocators, which have to hand out the same blocks
+	bool RunBuddyBenchmark(const Args& args)
+	{
+		Buddy::BenchmarkDesc desc;
+		args.GetInteger(L"ops", desc.m_Operations);
+		desc.m_Operations = std::max(1u, desc.m_Operations);
+		Buddy::BenchmarkResult result = Buddy::RunBenchmark(desc);
+		std::printf("Buddy benchmark: %u allocations (%u failed), free lists %.1f ns/op, bitmap %.1f ns/op (%.2fx), %s\n",
+			result.m_Allocations, result.m_FailedAllocations, result.m_FreeListNsPerOp, result.m_BitmapNsPerOp,
+			result.m_FreeListNsPerOp / std::max(result.m_BitmapNsPerOp, 0.001), result.m_bValid ? "results match" : "RESULTS DIFFER");
+		return Report(result);
+	}
+
+	// A recorded allocation trace (RTUA -alloctrace), or a synthetic one, through TLSF and a buddy allocator for waste and speed
+	bool RunTLSFBenchmark(const Args& args)
+	{
+		TLSF::BenchmarkDesc desc;
+		args.GetString(L"trace", desc.m_TraceFile);
+		TLSF::BenchmarkResult result = TLSF::RunBenchmark(desc);
+		std::printf("TLSF benchmark: %u %s events, TLSF %.1f ns/op, buddy %.1f ns/op. Peak %.1f MB requested, TLSF used %.1f MB, buddy %.1f MB\n",
+			result.m_Events, result.m_bSynthetic ? "synthetic" : "recorded", result.m_TlsfNsPerOp, result.m_BuddyNsPerOp,
+			result.m_PeakRequestedBytes / 1048576.0, result.m_TlsfPeakUsedBytes / 1048576.0, result.m_BuddyPeakUsedBytes / 1048576.0);
+		std::printf("TLSF benchmark: %u / %u failed allocations, worst fragmentation %.2f, %.2f after %u moves (%.1f MB)\n",
+			result.m_TlsfFailures, result.m_BuddyFailures, result.m_WorstFragmentation, result.m_DefragmentedFragmentation,
+			result.m_DefragmentMoves, result.m_DefragmentBytes / 1048576.0);
+		return Report(result);
+	}
+
+	// Several threads churning pages against a fake GPU, through the recycler and through the old mutex-guarded queues
+	bool RunPageBenchmark(const Args& args)
+	{
+		PageRecycling::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_FramesPerThread);
+		desc.m_FramesPerThread = std::max(1u, desc.m_FramesPerThread);
+		PageRecycling::BenchmarkResult result = PageRecycling::RunBenchmark(desc);
+		std::printf("Page benchmark: %u threads, mutex %.1f ns/page (%u pages made, %llu fence polls), lock-free %.1f ns/page (%u pages made, %llu fence polls for %llu recycled), %s\n",
+			desc.m_Threads, result.m_MutexNsPerPage, result.m_MutexPagesCreated, (unsigned long long)result.m_MutexFencePolls, result.m_LockFreeNsPerPage,
+			result.m_LockFreePagesCreated, (unsigned long long)result.m_Stats.m_FencePolls, (unsigned long long)result.m_Stats.m_Recycled, result.m_bValid ? "no page reused early" : "PAGE REUSED BEFORE ITS FENCE");
+		return Report(result);
+	}
+
+	// Streaming-style view churn on several threads, through the descriptor pool and through a bump allocator that never gets anything back
+	bool RunDescriptorBenchmark(const Args& args)
+	{
+		DescriptorPool::BenchmarkDesc desc;
+		args.GetInteger(L"ops", desc.m_OperationsPerThread);
+		desc.m_OperationsPerThread = std::max(1u, desc.m_OperationsPerThread);
+		DescriptorPool::BenchmarkResult result = DescriptorPool::RunBenchmark(desc);
+		std::printf("Descriptor benchmark: %u threads, bump %.1f ns/op (%llu descriptors reserved), pool %.1f ns/op (%llu reserved, %llu reused, %llu lock trips for %llu allocated), %s\n",
+			desc.m_Threads, result.m_MutexNsPerOp, (unsigned long long)result.m_MutexReserved, result.m_PoolNsPerOp, (unsigned long long)result.m_PoolReserved,
+			(unsigned long long)result.m_Stats.m_Reused, (unsigned long long)result.m_Stats.m_Refills, (unsigned long long)result.m_Stats.m_Allocated,
+			result.m_bValid ? "no descriptor reused early" : "DESCRIPTOR REUSED BEFORE ITS FENCE");
+		return Report(result);
+	}
+
+	// Mock command allocators taken and discarded by several recording threads, through the fenced pool and the old queue
+	bool RunAllocatorBenchmark(const Args& args)
+	{
+		FencedPool::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_FramesPerThread);
+		desc.m_FramesPerThread = std::max(1u, desc.m_FramesPerThread);
+		FencedPool::BenchmarkResult result = FencedPool::RunBenchmark(desc);
+		std::printf("Allocator benchmark: %u threads, mutex %.1f ns/request (%u created), pool %.1f ns/request (%u created, %llu of %llu back to the same thread), %s\n",
+			desc.m_Threads, result.m_MutexNsPerRequest, result.m_MutexCreated, result.m_PoolNsPerRequest, result.m_PoolCreated,
+			(unsigned long long)result.m_Stats.m_AffinityHits, (unsigned long long)result.m_Stats.m_Requests, result.m_bValid ? "no allocator reused early" : "ALLOCATOR REUSED BEFORE ITS FENCE");
+		return Report(result);
+	}
+
+	// Sets of MaxLights lights assigned to tiled and clustered grids at native and DLSS internal resolutions, by the builder and the reference
+	bool RunClusterBenchmark(const Args& args)
+	{
+		LightClusters::BenchmarkDesc desc;
+		args.GetInteger(L"sets", desc.m_LightSets);
+		desc.m_LightSets = std::max(1u, desc.m_LightSets);
+		LightClusters::BenchmarkResult result = LightClusters::RunBenchmark(desc);
+		std::printf("Cluster benchmark: %u grids built, reference %.1f us/grid, builder %.1f us/grid on %u workers (%.2fx), %.1f lights per cell, %s\n",
+			result.m_Builds, result.m_ReferenceUsPerBuild, result.m_BuilderUsPerBuild, result.m_Workers,
+			result.m_ReferenceUsPerBuild / std::max(result.m_BuilderUsPerBuild, 1e-3), result.m_AverageLightsPerCell,
+			result.m_bValid ? "grids match" : "GRIDS DISAGREE");
+		return Report(result);
+	}
+
+	// A big light set made on one thread and on several, which must come out identical, and identical to what every other platform makes
+	bool RunLightSetBenchmark(const Args& args)
+	{
+		LightSets::BenchmarkDesc desc;
+		args.GetInteger(L"lights", desc.m_Lights);
+		desc.m_Lights = std::max(1u, desc.m_Lights);
+		LightSets::BenchmarkResult result = LightSets::RunBenchmark(desc);
+		std::printf("Light set benchmark: %u lights, serial %.2f ms, %u threads %.2f ms (%.2fx), hash %016llx, %s\n",
+			desc.m_Lights, result.m_SerialMs, result.m_Threads, result.m_ParallelMs, result.m_SerialMs / std::max(result.m_ParallelMs, 1e-3),
+			(unsigned long long)result.m_Hash, result.m_bValid ? "sets match" : (result.m_bMatchesReference ? "SETS DISAGREE" : "SET DIFFERS FROM REFERENCE"));
+		return Report(result);
+	}
+
+	// Random views and sun directions over a Sponza sized scatter of casters, culled for every cascade at once and one cascade at a time
+	bool RunCascadeBenchmark(const Args& args)
+	{
+		ShadowCascades::BenchmarkDesc desc;
+		args.GetInteger(L"views", desc.m_Views);
+		desc.m_Views = std::max(1u, desc.m_Views);
+		ShadowCascades::BenchmarkResult result = ShadowCascades::RunBenchmark(desc);
+		std::printf("Cascade benchmark: %u views of %u casters, single shadow camera %.1f casters, %u cascades %.1f / %.1f / %.1f / %.1f (%.1f in any), "
+			"one pass %.1f us, per cascade %.1f us (%.2fx), %s\n",
+			desc.m_Views, desc.m_Casters, result.m_AverageFixed, result.m_Cascades, result.m_AverageCasters[0], result.m_AverageCasters[1],
+			result.m_AverageCasters[2], result.m_AverageCasters[3], result.m_AverageAnyCascade, result.m_SimdUs, result.m_ReferenceUs,
+			result.m_ReferenceUs / std::max(result.m_SimdUs, 1e-3), result.m_bValid ? "culling matches" : "CULLING DISAGREES");
+		return Report(result);
+	}
+
+	// Casters moving and the sun turning over a CPU stand-in for the shadow map, redrawn in full and through the cache, which have to match
+	bool RunShadowCacheBenchmark(const Args& args)
+	{
+		ShadowCache::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_Frames);
+		desc.m_Frames = std::max(1u, desc.m_Frames);
+		ShadowCache::BenchmarkResult result = ShadowCache::RunBenchmark(desc);
+		const ShadowCache::Stats& stats = result.m_Stats;
+		std::printf("Shadow cache benchmark: %u frames of %u casters, %llu full / %llu partial / %llu kept, %.1f casters drawn of %.1f in view, "
+			"full redraw %.3f ms, cached %.3f ms (%.2fx), %s\n",
+			desc.m_Frames, desc.m_Casters, (unsigned long long)stats.m_FullRedraws, (unsigned long long)stats.m_PartialRedraws,
+			(unsigned long long)stats.m_CachedFrames, result.m_AverageDrawn, result.m_AverageInView, result.m_FullMs, result.m_CachedMs,
+			result.m_FullMs / std::max(result.m_CachedMs, 1e-3), result.m_bValid ? "maps match" : "MAPS DIFFER");
+		return Report(result);
+	}
+
+	// Dozens of saturated emitters built from the default effect, stepped through the SoA backend and the line for line reference.
+	// EffectDesc's defaults are ParticleEffectProperties' own
+	bool RunParticleBenchmark(const Args& args)
+	{
+		ParticleSim::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_Frames);
+		desc.m_Frames = std::max(1u, desc.m_Frames);
+		ParticleSim::BenchmarkResult result = ParticleSim::RunBenchmark(desc);
+		std::printf("Particle benchmark: %u frames of %u effects, %.0f particles on average (%u peak), %u workers %.3f ms, reference %.3f ms (%.2fx), %s\n",
+			desc.m_Frames, desc.m_Effects, result.m_AverageParticles, result.m_PeakParticles, result.m_Workers, result.m_SystemMs, result.m_ReferenceMs,
+			result.m_ReferenceMs / std::max(result.m_SystemMs, 1e-3), result.m_bValid ? "particles match" : "PARTICLES DIFFER");
+		return Report(result);
+	}
+
+	// Effects spawned and expired through the slot map from several threads, checking no handle ever finds the wrong effect
+	bool RunEffectSlotBenchmark(const Args& args)
+	{
+		SlotMap::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_Frames);
+		desc.m_Frames = std::max(1u, desc.m_Frames);
+		SlotMap::BenchmarkResult result = SlotMap::RunBenchmark(desc);
+		std::printf("Effect slot benchmark: %u frames, %llu effects from %u threads (%.0f a second, %u peak), slot map %.3f ms, vector %.3f ms (%llu misdirected lookups), %llu stale handles checked, %s\n",
+			result.m_FramesRun, (unsigned long long)result.m_Stats.m_Reserved, desc.m_Threads, result.m_SpawnsPerSecond, result.m_Stats.m_PeakLive,
+			result.m_SlotMapMs, result.m_VectorMs, (unsigned long long)result.m_VectorMisdirected, (unsigned long long)result.m_StaleChecks,
+			result.m_bValid ? "handles hold" : "HANDLES BROKEN");
+		return Report(result);
+	}
+
+	// A camera pan at full and at half resolution through the CPU tone mapping reference, adapting exposure and then replaying one run's
+	// exposure into the other. Runs over a capture (RTUA -capturehdr) if one's named, and if a capture of the same path through DLSS is
+	// named too, that's the second run rather than a bilinear resample
+	bool RunToneMapBenchmark(const Args& args)
+	{
+		ToneMapReference::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_Frames);
+		desc.m_Frames = std::max(1u, desc.m_Frames);
+		args.GetString(L"capture", desc.m_CaptureFile);
+		args.GetString(L"upscaled", desc.m_UpscaledCaptureFile);
+
+		ToneMapReference::BenchmarkResult result = ToneMapReference::RunBenchmark(desc);
+		if (result.m_bFromCapture)
+			std::printf("Tone map benchmark: loaded %u frames from %ls\n", result.m_CaptureFrames, desc.m_CaptureFile.c_str());
+		else if (!desc.m_CaptureFile.empty())
+			std::printf("Tone map benchmark: failed to load %ls, using a synthetic scene\n", desc.m_CaptureFile.c_str());
+		if (result.m_bUpscaledFromCapture)
+			std::printf("Tone map benchmark: the second run is the upscaled capture %ls\n", desc.m_UpscaledCaptureFile.c_str());
+		else if (!desc.m_UpscaledCaptureFile.empty())
+			std::printf("Tone map benchmark: failed to load %ls at the capture's size, resampling the capture instead\n", desc.m_UpscaledCaptureFile.c_str());
+
+		std::printf("Tone map benchmark: %u frames of %s, %u workers %.3f ms, reference %.3f ms (%.2fx), exposure diverged up to %.3f stops, output error %.5f adapted and %.5f replayed, %s\n",
+			result.m_FramesRun, result.m_bFromCapture ? "the capture" : "a synthetic scene", result.m_Workers, result.m_ProcessorMs, result.m_ReferenceMs,
+			result.m_ReferenceMs / std::max(result.m_ProcessorMs, 1e-3), result.m_MaxExposureDivergence, result.m_AdaptedOutputError,
+			result.m_ReplayedOutputError, result.m_bValid ? "frames match" : "FRAMES DIFFER");
+		return Report(result);
+	}
+
+	// Exposure adapted over two simulated runs of the same path, then the first replayed into the second through the stream
+	bool RunExposureBenchmark(const Args& args)
+	{
+		ExposureStream::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_Frames);
+		desc.m_Frames = std::max(1u, desc.m_Frames);
+		ExposureStream::BenchmarkResult result = ExposureStream::RunBenchmark(desc);
+		std::printf("Exposure benchmark: %u frames at %.1f bytes each (of %u), adapt %.0f ns, encode %.0f ns, decode %.0f ns, runs diverged up to %.3f stops, histograms still %.2f bins apart replayed, %s\n",
+			result.m_FramesRun, result.m_BytesPerFrame, (uint32_t)sizeof(ExposureStream::ExposureState), result.m_AdaptNs, result.m_EncodeNs,
+			result.m_DecodeNs, result.m_MaxExposureDivergence, result.m_ReplayedHistogramShift, result.m_bValid ? "replay holds" : "REPLAY BROKEN");
+		return Report(result);
+	}
+
+	// SSAO over the same frames at native and at each upscaler's internal resolution, measuring how far the upscaled AO strays from native.
+	// Runs over a depth capture (RTUA -capturedepth) if one's named
+	bool RunSSAOBenchmark(const Args& args)
+	{
+		SSAOReference::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_Frames);
+		desc.m_Frames = std::max(1u, desc.m_Frames);
+		args.GetString(L"capture", desc.m_CaptureFile);
+		SSAOReference::BenchmarkResult result = SSAOReference::RunBenchmark(desc);
+		std::printf("SSAO benchmark: %u frames of %s, %u workers %.3f ms, reference %.3f ms (%.2fx), %s\n",
+			result.m_FramesRun, result.m_bFromCapture ? "the capture" : "a synthetic room", result.m_Workers, result.m_ProcessorMs,
+			result.m_ReferenceMs, result.m_ReferenceMs / std::max(result.m_ProcessorMs, 1e-3), result.m_bValid ? "frames match" : "FRAMES DIFFER");
+		for (uint32_t scale = 0; scale < SSAOReference::kResolutionScales; ++scale)
+		{
+			std::printf("    at %.3fx: mean error %.4f, %.2f%% of pixels off by more than 0.1\n", SSAOReference::kResolutionScale[scale],
+				result.m_MeanError[scale], result.m_BadPixels[scale] * 100.0);
+		}
+		return Report(result);
+	}
+
+	// DoF and motion blur over the same frames at native and at each upscaler's internal resolution, measuring how far each strays from
+	// native beyond what the lower resolution input already has. Runs over a capture (RTUA -capturepostfx) if one's named
+	bool RunPostFXBenchmark(const Args& args)
+	{
+		PostFXReference::BenchmarkDesc desc;
+		args.GetInteger(L"frames", desc.m_Frames);
+		desc.m_Frames = std::max(1u, desc.m_Frames);
+		args.GetString(L"capture", desc.m_CaptureFile);
+		PostFXReference::BenchmarkResult result = PostFXReference::RunBenchmark(desc);
+		std::printf("Post effects benchmark: %u frames of %s, %.0f/%.0f/%.0f work/fast/fixup tiles, %u workers %.3f ms, reference %.3f ms (%.2fx), %s\n",
+			result.m_FramesRun, result.m_bFromCapture ? "the capture" : "a synthetic courtyard", result.m_WorkTiles, result.m_FastTiles,
+			result.m_FixupTiles, result.m_Workers, result.m_ProcessorMs, result.m_ReferenceMs,
+			result.m_ReferenceMs / std::max(result.m_ProcessorMs, 1e-3), result.m_bValid ? "frames match" : "FRAMES DIFFER");
+		for (uint32_t scale = 0; scale < PostFXReference::kResolutionScales; ++scale)
+		{
+			std::printf("    at %.3fx: mean error input %.4f, DoF %.4f, motion blur %.4f, pixels off by more than 0.05 %.2f%%/%.2f%%/%.2f%%\n",
+				PostFXReference::kResolutionScale[scale], result.m_MeanError[PostFXReference::kMeasuredInput][scale],
+				result.m_MeanError[PostFXReference::kMeasuredDepthOfField][scale], result.m_MeanError[PostFXReference::kMeasuredMotionBlur][scale],
+				result.m_BadPixels[PostFXReference::kMeasuredInput][scale] * 100.0, result.m_BadPixels[PostFXReference::kMeasuredDepthOfField][scale] * 100.0,
+				result.m_BadPixels[PostFXReference::kMeasuredMotionBlur][scale] * 100.0);
+		}
+		return Report(result);
+	}
+
+	// Dozens of threads opening and closing nested scopes while the consumer drains alongside them, as it does once a frame
+	bool RunThreadProfilerStress(const Args& args)
+	{
+		ThreadProfiler::BenchmarkDesc desc;
+		args.GetInteger(L"threads", desc.m_Threads);
+		args.GetInteger(L"scopes", desc.m_ScopesPerThread);
+		ThreadProfiler::BenchmarkResult result = ThreadProfiler::RunBenchmark(desc);
+		std::printf("Thread profiler stress: %u threads, %llu scopes ended, %llu drained over %u drains, %llu dropped, %u deep at most, %.1f ns per scope, %s\n",
+			desc.m_Threads, (unsigned long long)result.m_Produced, (unsigned long long)result.m_Drained, result.m_Drains,
+			(unsigned long long)result.m_Dropped, result.m_DeepestSample, result.m_NsPerScope, result.m_bValid ? "every scope accounted for" : "SCOPES LOST");
+		return Report(result);
+	}
+
+	// Mutated DDS files through the parser, which has to reject them or lay every view inside the file
+	bool RunDDSFuzz(const Args& args)
+	{
+		DDSReader::FuzzDesc desc;
+		args.GetInteger(L"mutations", desc.m_Mutations);
+		DDSReader::FuzzResult result = DDSReader::RunFuzz(desc);
+		std::printf("DDS fuzz: %u mutations of %u seeds, %u accepted, %llu views checked, rejected %u too small / %u bad magic / %u bad header / %u unsupported / %u bad dimensions / %u truncated, %s\n",
+			desc.m_Mutations, result.m_Seeds, result.m_Accepted, (unsigned long long)result.m_ViewsChecked, result.m_Results[DDSReader::RESULT_TOO_SMALL],
+			result.m_Results[DDSReader::RESULT_BAD_MAGIC], result.m_Results[DDSReader::RESULT_BAD_HEADER], result.m_Results[DDSReader::RESULT_UNSUPPORTED_FORMAT],
+			result.m_Results[DDSReader::RESULT_BAD_DIMENSIONS], result.m_Results[DDSReader::RESULT_TRUNCATED], result.m_bValid ? "views in bounds" : "VIEW OUT OF BOUNDS");
+		return Report(result);
+	}
+
+	// Every DDS file under a directory, mapped in place against read with fread
+	bool RunDDSRead(const Args& args)
+	{
+		std::wstring directory;
+		args.GetString(L"dir", directory);
+
+		DDSReader::BenchmarkDesc desc;
+		args.GetInteger(L"passes", desc.m_Passes);
+		std::error_code error;
+		for (std::filesystem::recursive_directory_iterator iter(directory, error), end; !error && iter != end; iter.increment(error))
+		{
+			std::wstring extension = iter->path().extension().wstring();
+			for (wchar_t& c : extension)
+				c = (wchar_t)std::towlower(c);
+			if (iter->is_regular_file() && extension == L".dds")
+				desc.m_Files.push_back(iter->path().wstring());
+		}
+
+		DDSReader::BenchmarkResult result = DDSReader::RunBenchmark(desc);
+		std::printf("DDS read: %u of %u files under %ls, %.1f MB a pass, mapped %.0f MB/s, fread %.0f MB/s (%.2fx)\n",
+			result.m_Files, (uint32_t)desc.m_Files.size(), directory.c_str(), result.m_Bytes / 1048576.0, result.m_MappedMBps, result.m_ReadMBps,
+			result.m_MappedMBps / std::max(result.m_ReadMBps, 1e-3));
+		return Report(result);
+	}
+
+	// What a profiled scope costs with the trace capture off and on, against the budget
+	bool RunTraceBenchmark(const Args& args)
+	{
+		Trace::BenchmarkDesc desc;
+		args.GetInteger(L"bursts", desc.m_Bursts);
+		uint32_t budgetNs;
+		if (args.GetInteger(L"budget", budgetNs))
+			desc.m_BudgetNs = budgetNs;
+		Trace::BenchmarkResult result = Trace::RunBenchmark(desc);
+		std::printf("Trace benchmark: %llu scopes, %.1f ns each with capture off, %.1f ns capturing (%llu dropped), %.1f ns a tick read, budget %.0f ns, %s\n",
+			(unsigned long long)result.m_Scopes, result.m_DisabledNs, result.m_EnabledNs, (unsigned long long)result.m_Dropped, result.m_TickNs, desc.m_BudgetNs,
+			result.m_bValid ? "within budget" : "OVER BUDGET");
+		return Report(result);
+	}
+
+	const Check kChecks[] =
+	{
+		{ "benchmarkselftest",	"Drives the benchmark runner through a scripted frame source and checks its phases and statistics", RunBenchmarkSelfTest },
+		{ "load",				"-requests <n>: the async texture loader against serial loading", RunLoadBenchmark },
+		{ "residency",			"-frames <n> -textures <n>: texture streaming's budget, eviction order and cancelled streams", RunResidencySelfTest },
+		{ "buddy",				"-ops <n>: the bitmap buddy allocator against the old free lists", RunBuddyBenchmark },
+		{ "tlsf",				"-trace <file>: a recorded or synthetic allocation trace through TLSF and buddy allocators", RunTLSFBenchmark },
+		{ "page",				"-frames <n>: lock-free linear allocator page recycling against a simulated fence", RunPageBenchmark },
+		{ "descriptor",			"-ops <n>: descriptor churn through the per-thread magazines against a bump allocator", RunDescriptorBenchmark },
+		{ "allocator",			"-frames <n>: the fenced command allocator pool against the old mutex-guarded queue", RunAllocatorBenchmark },
+		{ "cluster",			"-sets <n>: the CPU light grid builder against a one light at a time reference", RunClusterBenchmark },
+		{ "lightset",			"-lights <n>: the light set generator across thread counts and against the recorded reference", RunLightSetBenchmark },
+		{ "cascade",			"-views <n>: per-cascade caster culling in one pass against one cascade at a time", RunCascadeBenchmark },
+		{ "shadowcache",		"-frames <n>: shadow map dirty regions against full redraws", RunShadowCacheBenchmark },
+		{ "particle",			"-frames <n>: the CPU particle backend against a one particle at a time reference", RunParticleBenchmark },
+		{ "effectslot",			"-frames <n>: effect handles under threads spawning and expiring thousands a second", RunEffectSlotBenchmark },
+		{ "tonemap",			"-frames <n> -capture <file> -upscaled <file>: the CPU tone mapping reference at two resolutions", RunToneMapBenchmark },
+		{ "exposure",			"-frames <n>: the exposure stream and replay over two simulated runs", RunExposureBenchmark },
+		{ "ssao",				"-frames <n> -capture <file>: the CPU SSAO reference at native and each upscaler's resolution", RunSSAOBenchmark },
+		{ "postfx",				"-frames <n> -capture <file>: the CPU DoF and motion blur references at native and each upscaler's resolution", RunPostFXBenchmark },
+		{ "threadprofiler",		"-threads <n> -scopes <n>: producers nesting scopes while a consumer drains, checking none go missing", RunThreadProfilerStress },
+		{ "ddsfuzz",			"-mutations <n>: truncated and corrupted DDS files through the parser, checking every view it hands out", RunDDSFuzz },
+		{ "ddsread",			"-dir <path> -passes <n>: every DDS file under a directory, memory mapped against read with fread", RunDDSRead },
+		{ "trace",				"-bursts <n> -budget <ns>: a profiled scope's cost with the trace capture off and on, against a 50 ns budget", RunTraceBenchmark },
+	};
+
+	const Check* FindCheck(const char* name)
+	{
+		for (const Check& check : kChecks)
+		{
+			if (std::strcmp(check.m_Name, name) == 0)
+				return &check;
+		}
+		return nullptr;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || std::strcmp(argv[1], "list") == 0)
+	{
+		std::printf("AZBTests <name> [-option value ...], AZBTests all, or one of:\n");
+		for (const Check& check : kChecks)
+			std::printf("    %-24s %s\n", check.m_Name, check.m_Description);
+		return argc < 2 ? 1 : 0;
+	}
+
+	const Args args(argc, argv, 2);
+	if (std::strcmp(argv[1], "all") == 0)
+	{
+		uint32_t failures = 0;
+		for (const Check& check : kChecks)
+		{
+			if (!check.m_Function(args))
+				++failures;
+		}
+		std::printf("%u of %u checks failed\n", failures, (uint32_t)(sizeof(kChecks) / sizeof(kChecks[0])));
+		return failures == 0 ? 0 : 1;
+	}
+
+	const Check* check = FindCheck(argv[1]);
+	if (check == nullptr)
+	{
+		std::printf("No check called %s. AZBTests list says what there is\n", argv[1]);
+		return 1;
+	}
+	return check->m_Function(args) ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#pragma once
+//===============================================================================
+// desc: A staged asynchronous loading pipeline. File I/O runs on a small reader pool, CPU-side parsing on a worker pool, and GPU object creation/upload
+//       on a single submitter thread that batches whatever is ready. The stages themselves are supplied through a sink, so the pipeline knows nothing about
+//       D3D - the texture manager plugs in the real device, a fake sink can drive it headless.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AsyncLoad
+{
+	// Base for anything travelling through the pipeline. Derive from this to carry the actual payload
+	class Request
+	{
+	public:
+		Request() : m_Done(m_Promise.get_future().share()) {}
+		virtual ~Request() {}
+
+		// Becomes ready once the submitter has finished with the request. Grab it before enqueueing
+		std::shared_future<void> GetFuture(void) const { return m_Done; }
+
+		// Set during Prepare() so the submitter can keep batches to a sensible size
+		size_t m_UploadBytes = 0;
+
+	private:
+		friend class Pipeline;
+		std::promise<void> m_Promise;
+		std::shared_future<void> m_Done;
+	};
+
+	typedef std::shared_ptr<Request> RequestPtr;
+
+	// The three stages. Each is only ever called from its own stage's threads
+	class Sink
+	{
+	public:
+		virtual ~Sink() {}
+
+		// Reader pool - blocking file I/O only
+		virtual void Read(Request& request) = 0;
+
+		// Worker pool - header parsing, subresource layout, anything CPU-bound that doesn't touch the device
+		virtual void Prepare(Request& request) = 0;
+
+		// Submitter thread - create GPU objects and record one upload for the whole batch
+		virtual void Submit(const std::vector<RequestPtr>& batch) = 0;
+	};
+
+	struct PipelineDesc
+	{
+		uint32_t m_ReaderThreads = 2;					// More than a couple rarely helps a single drive
+		uint32_t m_WorkerThreads = 0;					// 0 picks based on the core count
+		uint32_t m_MaxBatchRequests = 64;
+		size_t m_MaxBatchBytes = 128ull * 1024 * 1024;	// Bounds the upload heap one batch can claim
+	};
+
+	class Pipeline
+	{
+	public:
+		Pipeline(Sink& sink, const PipelineDesc& desc = PipelineDesc());
+
+		// Finishes everything already enqueued before joining the threads
+		~Pipeline();
+
+		void Enqueue(const RequestPtr& request);
+
+		// Block until every request enqueued so far has completed
+		void Flush(void);
+
+	private:
+		// Simple blocking queue. Close() wakes everyone and makes Pop() fail once empty
+		class Queue
+		{
+		public:
+			void Push(const RequestPtr& request);
+			bool Pop(RequestPtr& request);
+			bool TryPop(RequestPtr& request);
+			void Close(void);
+
+		private:
+			std::mutex m_Mutex;
+			std::condition_variable m_Ready;
+			std::deque<RequestPtr> m_Items;
+			bool m_bClosed = false;
+		};
+
+		void ReaderLoop(void);
+		void WorkerLoop(void);
+		void SubmitterLoop(void);
+
+		Sink& m_Sink;
+		PipelineDesc m_Desc;
+
+		Queue m_ReadQueue;
+		Queue m_PrepareQueue;
+		Queue m_SubmitQueue;
+
+		std::vector<std::thread> m_Readers;
+		std::vector<std::thread> m_Workers;
+		std::thread m_Submitter;
+
+		// Tracks outstanding requests for Flush() and for shutting stages down in order
+		std::mutex m_PendingMutex;
+		std::condition_variable m_PendingDone;
+		uint64_t m_Pending = 0;
+	};
+
+	// Headless benchmark of the pipeline against loading one request at a time. A fake sink stands in for the disk and device - reads and
+	// submissions sleep since they'd be waiting on I/O or a fence, parsing burns CPU
+	struct BenchmarkDesc
+	{
+		uint32_t m_Requests = 512;
+		uint32_t m_ReadMicroseconds = 400;
+		uint32_t m_ParseMicroseconds = 250;
+		uint32_t m_SubmitMicroseconds = 1000;			// Per submission - execute plus fence wait
+		uint32_t m_UploadMicrosecondsPerRequest = 50;	// Recording the copy for each request in a submission
+		size_t m_BytesPerRequest = 4ull * 1024 * 1024;
+		PipelineDesc m_Pipeline;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		double m_SerialMs = 0.0;
+		double m_PipelinedMs = 0.0;
+		uint32_t m_Batches = 0;
+		float m_AverageBatchSize = 0.f;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
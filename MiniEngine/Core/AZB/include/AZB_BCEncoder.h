@@ -0,0 +1,51 @@
+#pragma once
+//===============================================================================
+// desc: A portable block compressor for BC1, BC3, BC4, BC5 and BC7. Images are split into rows of blocks and encoded across every core, with the
+//       palette search vectorised (SSE2 where available, plain C++ elsewhere). No D3D or DirectXTex types, so it builds and runs anywhere.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include <cstddef>
+#include <cstdint>
+
+namespace BCEncoder
+{
+	enum eFormat
+	{
+		FORMAT_BC1,		// RGB, alpha ignored
+		FORMAT_BC3,		// RGB + separately coded alpha
+		FORMAT_BC4,		// Red only
+		FORMAT_BC5,		// Red and green, e.g. the X and Y of a tangent space normal map
+		FORMAT_BC7		// RGBA
+	};
+
+	enum eQuality
+	{
+		QUALITY_FAST,	// One fit per block - BC7 sticks to mode 6
+		QUALITY_HIGH	// Least-squares refinement, every p-bit combination, and BC7's two-subset mode 1 for opaque blocks
+	};
+
+	struct EncodeDesc
+	{
+		eFormat m_Format = FORMAT_BC1;
+		eQuality m_Quality = QUALITY_FAST;
+
+		// Weight colour error by each channel's contribution to luminance. Right for sRGB colour - BC7 sRGB endpoints are interpolated before
+		// the sRGB decode, so the fit itself happens in the stored space either way. Leave it off for normals and masks
+		bool m_bPerceptual = false;
+
+		uint32_t m_Threads = 0;		// 0 uses every core
+	};
+
+	// 8 for BC1 and BC4, 16 for the rest
+	uint32_t GetBlockBytes(eFormat format);
+
+	// Blocks are 4x4, so sizes round up
+	size_t GetEncodedSize(eFormat format, uint32_t width, uint32_t height);
+
+	// RGBA8 in, one row of blocks after another out. Any size is accepted - partial blocks at the right and bottom edges repeat the last
+	// column and row. blockRowPitch is the distance between rows of blocks in the output
+	void EncodeImage(const uint8_t* rgba, size_t rowPitch, uint32_t width, uint32_t height, const EncodeDesc& desc, uint8_t* blocks, size_t blockRowPitch);
+
+	// A single block from 16 RGBA8 pixels in raster order
+	void EncodeBlock(const uint8_t pixels[64], const EncodeDesc& desc, uint8_t* block);
+}
@@ -0,0 +1,239 @@
+#pragma once
+//===============================================================================
+// desc: A scripted benchmark runner that sweeps resolutions, rendering modes and DLSS qualities back-to-back.
+//       The scheduling and statistics here are deliberately free of D3D and Windows so they can be driven by a mock frame source on any platform.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_Utils.h"
+#include "AZB_FrameStats.h"
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+//===============================================================================
+
+namespace Benchmark
+{
+	//
+	//	Sweep description
+	//
+
+	// A simple keyframed camera path. Keys are evenly spaced over the measured frames of a config so that every run sees the exact same views
+	struct CameraKey
+	{
+		float m_Eye[3] = { 0.f, 0.f, 0.f };
+		float m_At[3] = { 0.f, 0.f, 1.f };
+	};
+
+	struct CameraPath
+	{
+		std::vector<CameraKey> m_Keys;
+
+		// Evaluate the path at a normalised progress value (0 = first key, 1 = last key)
+		CameraKey Evaluate(float t) const;
+	};
+
+	// One fully resolved configuration that will be measured. These match the controls found in RTUA_GUI
+	struct SweepConfig
+	{
+		std::string m_Name;
+
+		uint32_t m_Scene = 1;					// Index into the app's scene array
+		std::string m_CameraPath;				// Name of a path in SweepSpec::m_CameraPaths, or empty to leave the camera alone
+
+		uint8_t m_RenderingMode = 0;			// Matches RTUA_GUI::eRenderingMode
+		uint8_t m_DLSSMode = 1;					// Matches DLSS::m_CurrentQualityMode (0: Performance, 1: Balanced, 2: Quality, 3: Ultra Performance)
+		Resolution m_NativeResolution = {};		// Output resolution. Zero means "leave it at the maximum native resolution"
+		Resolution m_InternalResolution = {};	// Bilinear input resolution. Ignored by other modes as DLSS dictates its own
+
+		bool m_bOverrideLodBias = false;
+		float m_LodBias = 0.f;
+
+		uint32_t m_Frames = 500;				// Number of measured frames
+	};
+
+	// Global sweep settings along with every config to run, in order
+	struct SweepSpec
+	{
+		std::string m_OutputPath = "BenchmarkResults";	// Results get written to <path>.json and <path>.csv
+
+		// Frames to let the pipeline settle after a config change before we even look at the timings
+		uint32_t m_SettleFrames = 10;
+
+		// Warmup ends once the rolling coefficient of variation of frame times drops below the threshold (or we give up at the max)
+		uint32_t m_MinWarmupFrames = 30;
+		uint32_t m_MaxWarmupFrames = 600;
+		uint32_t m_SteadyStateWindow = 30;
+		float m_SteadyStateThreshold = 0.05f;
+
+		std::map<std::string, CameraPath> m_CameraPaths;
+		std::vector<SweepConfig> m_Configs;
+	};
+
+	// Parse a sweep spec from JSON text. Any array-valued fields within a "sweeps" entry get expanded into every combination
+	// Returns false and fills in the error string if the spec is malformed
+	bool ParseSweepSpec(const std::string& jsonText, SweepSpec& spec, std::string& error);
+	bool LoadSweepSpec(const std::wstring& fileName, SweepSpec& spec, std::string& error);
+
+	//
+	//	Statistics
+	//
+
+	// Per-frame timings as reported by EngineProfiling
+	struct FrameSample
+	{
+		float m_CpuMs = 0.f;
+		float m_GpuMs = 0.f;
+		float m_FrameMs = 0.f;
+	};
+
+	struct Distribution
+	{
+		float m_Mean = 0.f;
+		float m_StdDev = 0.f;
+		float m_Min = 0.f;
+		float m_Max = 0.f;
+		float m_P50 = 0.f;
+		float m_P95 = 0.f;
+		float m_P99 = 0.f;
+	};
+
+	// Percentiles are linearly interpolated between closest ranks. Takes a copy as the samples need sorting
+	Distribution ComputeDistribution(std::vector<float> samples);
+
+	// Tracks a rolling window of frame times and reports when they have stopped drifting
+	class SteadyStateDetector
+	{
+	public:
+		SteadyStateDetector(uint32_t windowSize = 30, float threshold = 0.05f);
+
+		void Reset(void);
+		void Push(float value);
+
+		// Coefficient of variation (stddev / mean) of the current window
+		float GetVariation(void) const;
+		bool IsSteady(void) const;
+
+	private:
+		std::vector<float> m_Window;
+		uint32_t m_Next;
+		uint32_t m_Count;
+		float m_Threshold;
+	};
+
+	//
+	//	Running
+	//
+
+	// The runner never talks to the engine directly - everything goes through this interface. The app provides the real one, tests can provide a mock.
+	class FrameSource
+	{
+	public:
+		virtual ~FrameSource() {}
+
+		// Return false if this config can't run here (e.g. DLSS on unsupported hardware, or a scene that isn't loaded)
+		virtual bool SupportsConfig(const SweepConfig& config) = 0;
+
+		// Called once per frame until it returns true. Config changes often take multiple frames to go through the pipeline
+		virtual bool ApplyConfig(const SweepConfig& config) = 0;
+
+		// Set up the next frame. The camera pointer is null when the config doesn't use a path
+		virtual void PrepareFrame(const SweepConfig& config, const CameraKey* camera) = 0;
+
+		// Timings of the frame that was prepared on the previous tick
+		virtual FrameSample SampleLastFrame(void) = 0;
+	};
+
+	struct ConfigResult
+	{
+		SweepConfig m_Config;
+
+		bool m_bSkipped = false;
+		bool m_bReachedSteadyState = false;
+		uint32_t m_WarmupFrames = 0;
+
+		Distribution m_Cpu;
+		Distribution m_Gpu;
+		Distribution m_Frame;
+
+		// Pacing of the measured frames - jitter, stutters and lows
+		FrameStats::FrameTimeSummary m_Pacing;
+	};
+
+	class Runner
+	{
+	public:
+		enum ePhase : uint8_t
+		{
+			APPLY,
+			SETTLE,
+			WARMUP,
+			MEASURE
+		};
+
+		Runner(const SweepSpec& spec);
+
+		// Advance the sweep by one frame. Call this exactly once per frame, before the frame is rendered
+		void Tick(FrameSource& source);
+
+		bool IsFinished(void) const { return m_CurrentConfig >= m_Spec.m_Configs.size(); }
+		const std::vector<ConfigResult>& GetResults(void) const { return m_Results; }
+		const SweepSpec& GetSpec(void) const { return m_Spec; }
+
+		// Human readable progress, e.g. for an on-screen overlay
+		std::string GetStatus(void) const;
+
+		// The phase the config under way is in. A frame source can read this from PrepareFrame() to see which phase that frame belongs to
+		ePhase GetPhase(void) const { return m_Phase; }
+
+	private:
+		void OnFrameComplete(const FrameSample& sample);
+		void FinishConfig(bool skipped);
+		const CameraKey* GetCameraForFrame(void);
+
+		SweepSpec m_Spec;
+		std::vector<ConfigResult> m_Results;
+
+		size_t m_CurrentConfig;
+		ePhase m_Phase;
+		uint32_t m_PhaseFrames;				// Frames prepared in the current phase
+		bool m_bFramePending;				// A frame was prepared on the previous tick and its timings are due
+		ePhase m_PendingPhase;				// The phase that frame belonged to
+
+		SteadyStateDetector m_Detector;
+		FrameStats::FrameTimeAnalyzer m_PacingAnalyzer;
+		CameraKey m_CameraScratch;
+		std::vector<float> m_CpuSamples;
+		std::vector<float> m_GpuSamples;
+		std::vector<float> m_FrameSamples;
+	};
+
+	//
+	//	Output
+	//
+
+	std::string ResultsToJSON(const std::vector<ConfigResult>& results);
+	std::string ResultsToCSV(const std::vector<ConfigResult>& results);
+
+	// Writes <outputPath>.json and <outputPath>.csv
+	bool WriteResults(const std::string& outputPath, const std::vector<ConfigResult>& results);
+
+	//
+	//	Self test
+	//
+
+	// Sweeps a handful of configs through a Runner with a scripted frame source - one that takes a few frames to apply then settles straight
+	// away, one that isn't supported, one that never settles and one that settles late - and checks the phases each frame went
+	// through, the warmup and sample counts, the camera path and the percentiles of timings whose answers are known. Needs nothing from the
+	// engine, so it runs anywhere
+	struct SelfTestResult : TestHarness::Result
+	{
+		uint32_t m_Configs = 0;
+		uint32_t m_Ticks = 0;
+		uint32_t m_FramesPrepared = 0;
+	};
+
+	SelfTestResult RunSelfTest(void);
+}
@@ -0,0 +1,126 @@
+#pragma once
+//===============================================================================
+// desc: The block bookkeeping behind BuddyAllocator, split out from the D3D side so it can be swapped and checked headless. The original free lists
+//       (a std::set per order) are kept as a reference, and the replacement tracks free blocks in a bitmap per order with a summary hierarchy
+//       above it, so finding, splitting and merging blocks is a handful of bit scans and never touches the heap.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace Buddy
+{
+	constexpr size_t kInvalidOffset = ~(size_t)0;
+
+	// Hands out blocks of 2^order units from a range of 2^maxOrder, always the lowest free block of the smallest order that fits. Offsets and sizes
+	// are in units - the caller decides what a unit is. Single-threaded
+	class IBlockAllocator
+	{
+	public:
+		virtual ~IBlockAllocator() {}
+
+		// kInvalidOffset if nothing large enough is free
+		virtual size_t Allocate(uint32_t order) = 0;
+
+		// offset and order must be exactly what Allocate() was given and returned. Merges with the buddy for as long as it's free
+		virtual void Free(size_t offset, uint32_t order) = 0;
+
+		// Everything free again, as one block of maxOrder
+		virtual void Reset(void) = 0;
+
+		virtual uint32_t GetMaxOrder(void) const = 0;
+		virtual size_t GetFreeUnits(void) const = 0;
+	};
+
+	// What BuddyAllocator originally used. Every call is a red-black tree operation, and splits and frees allocate tree nodes
+	class FreeListAllocator : public IBlockAllocator
+	{
+	public:
+		explicit FreeListAllocator(uint32_t maxOrder);
+
+		size_t Allocate(uint32_t order) override;
+		void Free(size_t offset, uint32_t order) override;
+		void Reset(void) override;
+
+		uint32_t GetMaxOrder(void) const override { return m_MaxOrder; }
+		size_t GetFreeUnits(void) const override { return m_FreeUnits; }
+
+	private:
+		std::vector<std::set<size_t>> m_FreeBlocks;
+		uint32_t m_MaxOrder;
+		size_t m_FreeUnits = 0;
+	};
+
+	// One bit per block per order, set while that block is free. Above each order's bits sit summary levels where a bit means "some bit in this
+	// word below is set", and a mask records which orders have anything free at all. Allocating is a scan for the lowest usable order, a descent
+	// to its first free block and a split back down; freeing walks up through the buddies. O(log n) either way, and all storage is sized up front.
+	// Hands out exactly the same offsets as FreeListAllocator
+	class BitmapAllocator : public IBlockAllocator
+	{
+	public:
+		// maxOrder of up to 32, i.e. 4G units. The bitmaps take around 2^maxOrder / 4 bytes
+		explicit BitmapAllocator(uint32_t maxOrder);
+
+		size_t Allocate(uint32_t order) override;
+		void Free(size_t offset, uint32_t order) override;
+		void Reset(void) override;
+
+		uint32_t GetMaxOrder(void) const override { return m_MaxOrder; }
+		size_t GetFreeUnits(void) const override { return m_FreeUnits; }
+
+	private:
+		static constexpr uint32_t kMaxLevels = 8;	// 64^6 blocks is more than any order here needs
+
+		struct Order
+		{
+			uint32_t m_Levels = 0;						// Level 0 is one bit per block, the last level is a single word
+			size_t m_LevelStart[kMaxLevels] = {};		// Word index into m_Words
+		};
+
+		bool Test(uint32_t order, size_t block) const;
+		void Set(uint32_t order, size_t block);
+		void Clear(uint32_t order, size_t block);
+		size_t FindFirst(uint32_t order) const;
+
+		std::vector<uint64_t> m_Words;
+		std::vector<Order> m_Orders;
+		uint64_t m_NonEmptyOrders = 0;
+		uint32_t m_MaxOrder;
+		size_t m_FreeUnits = 0;
+	};
+
+	enum eAllocatorType
+	{
+		ALLOCATOR_FREE_LIST,
+		ALLOCATOR_BITMAP
+	};
+
+	std::unique_ptr<IBlockAllocator> CreateBlockAllocator(eAllocatorType type, uint32_t maxOrder);
+
+	// Runs the same random allocate/free sequence through both allocators, timing each and checking every offset they hand out matches.
+	// Orders are skewed towards small blocks, and the live set is kept between the two fill levels so the range stays fragmented
+	struct BenchmarkDesc
+	{
+		uint32_t m_Operations = 1000000;
+		uint32_t m_MaxOrder = 16;
+		uint32_t m_LargestRequestOrder = 6;
+		float m_LowFill = 0.5f;			// Fraction of the range in use, in units, below which allocation is favoured
+		float m_HighFill = 0.9f;		// ... and above which freeing is
+		uint32_t m_Seed = 1;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		double m_FreeListNsPerOp = 0.0;
+		double m_BitmapNsPerOp = 0.0;
+		uint32_t m_Allocations = 0;
+		uint32_t m_FailedAllocations = 0;	// Requests nothing was free for, in both
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,137 @@
+#pragma once
+//===============================================================================
+// desc: A persistent record of which converted files (DDS, .mini) were built from what. Entries are keyed by a content hash of the source plus the
+//       conversion flags and converter version, so touching a file (e.g. a fresh checkout) doesn't trigger a rebuild but changing its flags does.
+//       The index is lock-free, and large sources are hashed in parallel chunks. No D3D types, so it builds and runs anywhere.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace ConversionCache
+{
+	// XXH64
+	uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+	// Files are hashed in chunks of this size, spread across threads once there's more than one. The result doesn't depend on the thread count
+	constexpr size_t kHashChunkBytes = 4 * 1024 * 1024;
+
+	// Hash of a whole file's contents. maxThreads of 0 uses every core. False if the file can't be read
+	bool HashFile(const std::wstring& fileName, uint64_t& hash, uint32_t maxThreads = 0);
+
+	// Identifies a path regardless of case and slash direction, the way Windows treats them
+	uint64_t HashPath(const std::wstring& fileName);
+
+	struct FileStamp
+	{
+		uint64_t m_Size = 0;
+		int64_t m_ModifiedTime = 0;
+
+		bool operator==(const FileStamp& other) const { return m_Size == other.m_Size && m_ModifiedTime == other.m_ModifiedTime; }
+		bool operator!=(const FileStamp& other) const { return !(*this == other); }
+	};
+
+	// False if the file doesn't exist
+	bool GetFileStamp(const std::wstring& fileName, FileStamp& stamp);
+
+	// Everything an output depends on
+	struct Key
+	{
+		uint64_t m_ContentHash = 0;
+		uint32_t m_Flags = 0;
+		uint32_t m_ConverterVersion = 0;
+
+		bool operator==(const Key& other) const
+		{
+			return m_ContentHash == other.m_ContentHash && m_Flags == other.m_Flags && m_ConverterVersion == other.m_ConverterVersion;
+		}
+	};
+
+	enum eStatus
+	{
+		STATUS_UP_TO_DATE,	// The output was built from exactly this source, flags and converter, and hasn't been touched since
+		STATUS_STALE,		// Something the output depends on has changed, or the output is missing
+		STATUS_UNKNOWN		// No record of this source - fall back on whatever was used before the cache existed
+	};
+
+	struct Stats
+	{
+		uint32_t m_UpToDate = 0;
+		uint32_t m_Stale = 0;
+		uint32_t m_Unknown = 0;
+		uint32_t m_FilesHashed = 0;
+		uint64_t m_BytesHashed = 0;
+		uint32_t m_Dropped = 0;		// Records that didn't fit in the index
+	};
+
+	// Check(), Record() and Save() can be called from any number of threads at once. Load() must not overlap with anything else
+	class Cache
+	{
+	public:
+		// capacity is the most sources the index holds, rounded up to a power of two. Load() grows it to fit what's on disk
+		explicit Cache(uint32_t capacity = 16384);
+		~Cache();
+
+		Cache(const Cache&) = delete;
+		Cache& operator=(const Cache&) = delete;
+
+		// Replaces whatever is in the index. A missing or out-of-date file just leaves it empty
+		bool Load(const std::wstring& fileName);
+
+		// Written to a temporary file and renamed over the old one, so a crash mid-save can't leave a torn cache
+		bool Save(const std::wstring& fileName) const;
+
+		// Whether outputFile is current for sourceFile converted with flags by converterVersion. The source is only hashed if its size or
+		// timestamp has moved since it was recorded. key is filled in for passing to Record() either way, as long as the source exists
+		eStatus Check(const std::wstring& sourceFile, const std::wstring& outputFile, uint32_t flags, uint32_t converterVersion, Key& key);
+
+		// Call after outputFile has been (re)built from sourceFile, or to adopt an existing output as current
+		void Record(const std::wstring& sourceFile, const std::wstring& outputFile, const Key& key);
+
+		bool IsDirty(void) const { return m_bDirty.load(std::memory_order_relaxed); }
+		Stats GetStats(void) const;
+
+	private:
+		// Immutable once published. Updates swap in a new one, and old ones are kept until the cache is cleared so readers never see freed memory
+		struct Entry
+		{
+			uint64_t m_PathHash;
+			FileStamp m_Source;
+			FileStamp m_Output;
+			Key m_Key;
+			Entry* m_pNextRetired;
+		};
+
+		struct Slot
+		{
+			std::atomic<uint64_t> m_PathHash;	// 0 while free
+			std::atomic<Entry*> m_Entry;
+		};
+
+		// Open addressing with linear probing. Slots are claimed but never released, so a probe can stop at the first free one
+		const Entry* Find(uint64_t pathHash) const;
+		bool Publish(Entry* entry);
+		void Retire(Entry* entry);
+
+		void Clear(void);
+		void Allocate(uint32_t capacity);
+
+		std::unique_ptr<Slot[]> m_Slots;
+		uint32_t m_Mask = 0;
+
+		uint32_t m_MinCapacity;
+
+		std::atomic<Entry*> m_Retired;
+		mutable std::atomic<bool> m_bDirty;		// Cleared by a successful Save()
+
+		std::atomic<uint32_t> m_UpToDate;
+		std::atomic<uint32_t> m_Stale;
+		std::atomic<uint32_t> m_Unknown;
+		std::atomic<uint32_t> m_FilesHashed;
+		std::atomic<uint64_t> m_BytesHashed;
+		std::atomic<uint32_t> m_Dropped;
+	};
+}
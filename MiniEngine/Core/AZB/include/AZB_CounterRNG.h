@@ -0,0 +1,49 @@
+#pragma once
+//===============================================================================
+// desc: Counter-based random numbers (Philox4x32-10, from Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3"). Each number is a pure
+//       function of a key and a position, so any thread can jump straight to its share of a sequence, and nothing depends on the standard library's
+//       engines or distributions, which is what makes Math::RandomNumberGenerator give different numbers on different platforms.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include <cstdint>
+
+namespace CounterRNG
+{
+	struct Block
+	{
+		uint32_t m_Words[4];
+	};
+
+	// Ten rounds of Philox4x32 on a 128 bit counter under a 64 bit key
+	Block Philox4x32(const uint32_t counter[4], const uint32_t key[2]);
+
+	// One independent sequence. The seed is the key, and the stream index fills the top half of the counter, so streams never overlap.
+	// Ranges follow Math::RandomNumberGenerator
+	class Stream
+	{
+	public:
+		Stream(uint64_t seed, uint64_t streamIndex = 0);
+
+		uint32_t NextUint(void);
+
+		// [0, maxVal], and [minVal, maxVal]. Max value is included
+		int32_t NextInt(int32_t maxVal);
+		int32_t NextInt(int32_t minVal, int32_t maxVal);
+
+		// [0, maxVal), and [minVal, maxVal). Max value is excluded
+		float NextFloat(float maxVal = 1.0f);
+		float NextFloat(float minVal, float maxVal);
+
+		// Jump to the index'th number of the stream
+		void Seek(uint64_t index);
+
+	private:
+		uint32_t m_Key[2];
+		uint32_t m_Counter[4];
+		Block m_Block;
+		uint32_t m_Used;		// How many of m_Block's words have been handed out
+	};
+
+	// Checks Philox4x32 against the published known-answer vectors
+	bool SelfTest(void);
+}
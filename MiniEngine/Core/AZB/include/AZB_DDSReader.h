@@ -0,0 +1,163 @@
+#pragma once
+//===============================================================================
+// desc: A zero-copy DDS reader. Files are memory-mapped rather than read into a buffer, the header is validated once, and every mip of every array slice
+//       is exposed as a view straight into the mapping - the only copy left is the one into the upload heap. No D3D types, so it builds and runs anywhere.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace DDSReader
+{
+	// Read-only mapping of a whole file. Pages come from the OS file cache on demand, so opening costs nothing until the data is touched
+	class MappedFile
+	{
+	public:
+		MappedFile() {}
+		~MappedFile() { Close(); }
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// Fails for missing or empty files
+		bool Open(const std::wstring& fileName);
+		void Close(void);
+
+		// Fault the pages in now, on the calling thread, instead of whenever the data is first read
+		void Prefetch(void) const;
+
+		bool IsOpen(void) const { return m_Data != nullptr; }
+		const uint8_t* GetData(void) const { return m_Data; }
+		size_t GetSize(void) const { return m_Size; }
+
+	private:
+		const uint8_t* m_Data = nullptr;
+		size_t m_Size = 0;
+#if defined(_WIN32)
+		void* m_Mapping = nullptr;
+#endif
+	};
+
+	// Same values as D3D12_RESOURCE_DIMENSION, so they can be cast straight across
+	enum eDimension : uint32_t
+	{
+		DIMENSION_UNKNOWN = 0,
+		DIMENSION_TEXTURE1D = 2,
+		DIMENSION_TEXTURE2D = 3,
+		DIMENSION_TEXTURE3D = 4
+	};
+
+	enum eResult
+	{
+		RESULT_OK,
+		RESULT_TOO_SMALL,			// Not even room for the headers
+		RESULT_BAD_MAGIC,
+		RESULT_BAD_HEADER,			// Header sizes or flags don't make sense
+		RESULT_UNSUPPORTED_FORMAT,	// Valid, but a format this reader doesn't lay out (packed, planar, palettised...)
+		RESULT_BAD_DIMENSIONS,		// Zero or beyond the D3D12 limits
+		RESULT_TRUNCATED			// The subresources run past the end of the data
+	};
+
+	const char* GetResultString(eResult result);
+
+	// One mip of one array slice (or cube face). For block compressed formats a "row" is a row of 4x4 blocks
+	struct SubresourceView
+	{
+		const uint8_t* m_Data = nullptr;
+		size_t m_RowPitch = 0;
+		size_t m_SlicePitch = 0;		// Bytes per 2D slice - a 3D mip holds m_Depth of these back to back
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		uint32_t m_Depth = 0;
+	};
+
+	class DDSFile
+	{
+	public:
+		// Validates everything up front - header, format, dimensions, and that every subresource lies inside the data - so the views need no further
+		// checking. The data must outlive this object
+		eResult Parse(const uint8_t* data, size_t size);
+
+		uint32_t GetWidth(void) const { return m_Width; }
+		uint32_t GetHeight(void) const { return m_Height; }
+		uint32_t GetDepth(void) const { return m_Depth; }
+		uint32_t GetMipCount(void) const { return m_MipCount; }
+		uint32_t GetArraySize(void) const { return m_ArraySize; }		// Includes all six faces of each cube
+		uint32_t GetFormat(void) const { return m_Format; }			// A DXGI_FORMAT value
+		uint32_t GetAlphaMode(void) const { return m_AlphaMode; }		// A DDS_ALPHA_MODE value
+		eDimension GetDimension(void) const { return m_Dimension; }
+		bool IsCubeMap(void) const { return m_bCubeMap; }
+
+		// Pixel data following the headers
+		const uint8_t* GetBitData(void) const { return m_BitData; }
+		size_t GetBitSize(void) const { return m_BitSize; }
+
+		// Indexed the same way as D3D subresources - mip + slice * mipCount
+		uint32_t GetSubresourceCount(void) const { return (uint32_t)m_Subresources.size(); }
+		const SubresourceView& GetSubresource(uint32_t mip, uint32_t slice) const { return m_Subresources[mip + slice * m_MipCount]; }
+
+	private:
+		eResult Layout(void);
+
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		uint32_t m_Depth = 0;
+		uint32_t m_MipCount = 0;
+		uint32_t m_ArraySize = 0;
+		uint32_t m_Format = 0;
+		uint32_t m_AlphaMode = 0;
+		eDimension m_Dimension = DIMENSION_UNKNOWN;
+		bool m_bCubeMap = false;
+
+		const uint8_t* m_BitData = nullptr;
+		size_t m_BitSize = 0;
+
+		std::vector<SubresourceView> m_Subresources;
+	};
+
+	//===============================================================================
+	// Mutation fuzz. A handful of valid files - legacy and DX10 headers, mips, arrays, cubes and volumes - are truncated, have bits flipped in
+	// their headers and get oversized mip, array and dimension counts written over them, then go through Parse. Anything it accepts has to lay
+	// every subresource view inside the data it was given, which the fuzz checks by reading the first and last byte of each
+
+	struct FuzzDesc
+	{
+		uint32_t m_Mutations = 200000;
+		uint64_t m_Seed = 3;
+	};
+
+	struct FuzzResult : TestHarness::Result
+	{
+		uint32_t m_Seeds = 0;
+		uint32_t m_Accepted = 0;			// Mutations Parse still took
+		uint32_t m_Results[RESULT_TRUNCATED + 1] = {};	// By eResult
+		uint64_t m_ViewsChecked = 0;
+	};
+
+	FuzzResult RunFuzz(const FuzzDesc& desc = FuzzDesc());
+
+	// Read throughput over real files - mapped and parsed in place, against read into a buffer with fread and parsed there. Both touch every
+	// byte of every subresource, as the copy to the upload heap would. The passes alternate, so both see the same (warm) file cache
+	struct BenchmarkDesc
+	{
+		std::vector<std::wstring> m_Files;
+		uint32_t m_Passes = 5;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint32_t m_Files = 0;				// Ones that opened and parsed, of those given
+		uint64_t m_Bytes = 0;				// Per pass
+		double m_MappedMBps = 0.0;
+		double m_ReadMBps = 0.0;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc);
+}
@@ -0,0 +1,145 @@
+#pragma once
+//===============================================================================
+// desc: Descriptor bookkeeping for DescriptorAllocator. Single descriptors come out of a small per-thread magazine that's refilled, a batch at a
+//       time, from a shared pool under one lock. Freed descriptors are batched up the same way and only handed out again once the fence they were
+//       freed against has passed. Descriptors are just addresses here and heaps come from an interface, so none of this touches D3D.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_PageRecycler.h"
+#include "AZB_TestHarness.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace DescriptorPool
+{
+	// Same thing LinearAllocatorPageManager recycles against
+	using IFence = PageRecycling::IFence;
+
+	// Where the descriptors live. Called under the pool's lock, so implementations needn't be thread-safe themselves
+	class IHeapSource
+	{
+	public:
+		virtual ~IHeapSource() {}
+
+		// Makes a heap of descriptorCount descriptors that lives as long as the pool, and returns the address of its first. 0 if it couldn't
+		virtual uint64_t CreateHeap(uint32_t descriptorCount) = 0;
+
+		// Distance between neighbouring descriptors in a heap
+		virtual uint32_t GetDescriptorSize(void) = 0;
+	};
+
+	constexpr uint64_t kInvalidDescriptor = 0;
+	constexpr uint32_t kMaxMagazine = 64;
+
+	// All in descriptors, not allocations
+	struct Stats
+	{
+		uint64_t m_Allocated = 0;
+		uint64_t m_Freed = 0;
+		uint64_t m_MagazineHits = 0;		// Single descriptors handed straight out of the calling thread's magazine
+		uint64_t m_Refills = 0;				// Times the shared pool's lock was taken, for either direction
+		uint64_t m_Reused = 0;				// Freed and past their fence, so back in circulation
+		uint64_t m_PendingReuse = 0;		// Freed and waiting on their fence, or on their batch filling up
+		uint64_t m_Reserved = 0;			// Across every heap made so far
+		uint32_t m_Heaps = 0;
+
+		uint64_t GetLive(void) const { return m_Allocated - m_Freed; }
+	};
+
+	// Everything can be called from any number of threads, except Clear()
+	class Allocator
+	{
+	public:
+		// magazineSize (up to kMaxMagazine) descriptors move between a thread and the shared pool at a time
+		Allocator(IHeapSource& heapSource, IFence& fence, uint32_t descriptorsPerHeap = 256, uint32_t magazineSize = 32);
+
+		Allocator(const Allocator&) = delete;
+		Allocator& operator=(const Allocator&) = delete;
+
+		// count contiguous descriptors, or kInvalidDescriptor if the heap source failed. Anything more than one goes straight to the shared pool
+		uint64_t Allocate(uint32_t count = 1);
+
+		// The GPU may use the descriptors until fenceValue has passed. Fence values should all come from the same queue
+		void Free(uint64_t descriptor, uint32_t count, uint64_t fenceValue);
+
+		// Sends the calling thread's partly filled batch of frees to the shared pool, rather than waiting for it to fill, and brings its share
+		// of the stats up to date
+		void Flush(void);
+
+		// Forget every descriptor. Outstanding ones and those sitting in other threads' magazines are simply dropped
+		void Clear(void);
+
+		// Up to a magazine's worth behind for each thread, until it next takes the lock or calls Flush()
+		Stats GetStats(void) const;
+
+	private:
+		struct ThreadCache;
+		ThreadCache& GetThreadCache(void);
+
+		struct FreedBatch
+		{
+			uint64_t m_FenceValue;		// The latest in the batch
+			uint32_t m_Count;
+			uint64_t m_Descriptors[kMaxMagazine];
+		};
+
+		// These expect m_Mutex to be held
+		void PublishLocked(ThreadCache& cache);
+		void QueueFreedLocked(ThreadCache& cache);
+		void ReclaimLocked(void);
+		uint64_t CarveLocked(uint32_t count);
+
+		IHeapSource& m_HeapSource;
+		IFence& m_Fence;
+		const uint32_t m_DescriptorsPerHeap;
+		const uint32_t m_MagazineSize;
+		uint64_t m_Id;		// Thread caches are matched to their allocator by this, and it changes on Clear() to orphan them
+
+		std::atomic<uint32_t> m_DescriptorSize;
+
+		mutable std::mutex m_Mutex;
+		std::vector<uint64_t> m_Available;
+		std::deque<FreedBatch> m_Freed;		// Oldest first
+		uint64_t m_HeapCursor = 0;
+		uint32_t m_HeapRemaining = 0;
+		uint64_t m_Reserved = 0;
+		uint32_t m_Heaps = 0;
+
+		std::atomic<uint64_t> m_Allocated;
+		std::atomic<uint64_t> m_FreedCount;
+		std::atomic<uint64_t> m_MagazineHits;
+		std::atomic<uint64_t> m_Refills;
+		std::atomic<uint64_t> m_Reused;
+		std::atomic<uint64_t> m_PendingReuse;
+	};
+
+	//===============================================================================
+	// Several threads creating and destroying views like texture streaming does, against a simulated GPU fence. Compares the pool to how
+	// DescriptorAllocator used to work - a bump pointer behind one lock that never gets anything back - and checks that no descriptor is
+	// handed out twice, or again before its fence
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Threads = 4;
+		uint32_t m_OperationsPerThread = 200000;
+		uint32_t m_LivePerThread = 512;			// Each thread hovers between half this many allocations and this many
+		uint32_t m_MultiplePercent = 5;			// Share of allocations asking for 2-8 contiguous descriptors
+		uint32_t m_FramesInFlight = 3;
+		uint32_t m_Seed = 1;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		double m_MutexNsPerOp = 0.0;
+		double m_PoolNsPerOp = 0.0;
+		uint64_t m_MutexReserved = 0;
+		uint64_t m_PoolReserved = 0;
+		Stats m_Stats;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,113 @@
+#pragma once
+//===============================================================================
+// desc: g_Exposure as it stood after each frame adapted it, kept as a compact stream so one run's exposure can be played back into another in
+//       place of AdaptExposureCS. A frame only writes the values that changed since the frame before, with the bits they had, so a run played
+//       back is tone mapped with exactly what the recorded one was, and two upscalers can be compared over the same camera path without the
+//       histogram each one produces pulling exposure its own way.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ToneMapReference.h"
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ExposureStream
+{
+	// The eight floats of g_Exposure, the same as the CPU tone mapping reference adapts
+	using ExposureState = ToneMapReference::ExposureState;
+
+	// A byte saying which of the eight values changed, then each of those as its four bytes
+	constexpr uint32_t kMaxFrameBytes = 1 + 8 * sizeof(float);
+
+	// Appends state to bytes, as it differs from previous. The first frame of a stream is against an all-zero state
+	void EncodeFrame(const ExposureState& previous, const ExposureState& state, std::vector<uint8_t>& bytes);
+
+	// Reads one frame from bytes at offset, moving offset past it. False if the frame runs off the end
+	bool DecodeFrame(const uint8_t* bytes, size_t byteCount, size_t& offset, const ExposureState& previous, ExposureState& state);
+
+	void Encode(const std::vector<ExposureState>& frames, std::vector<uint8_t>& bytes);
+
+	// Fails unless bytes hold exactly frameCount frames, with nothing left over
+	bool Decode(const std::vector<uint8_t>& bytes, uint32_t frameCount, std::vector<ExposureState>& frames);
+
+	bool Load(const std::wstring& fileName, std::vector<ExposureState>& frames);
+
+	// Frame k is g_Exposure once frame k has adapted it, which is what frame k + 1 is tone mapped with. Frames are encoded and written as they
+	// come, and the counts in the header are filled in by Close()
+	class Writer
+	{
+	public:
+		Writer(void) = default;
+		~Writer(void) { Close(); }
+
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		bool Open(const std::wstring& fileName);
+		bool Append(const ExposureState& state);
+		bool Close(void);
+
+		bool IsOpen(void) const { return m_File != nullptr; }
+		uint32_t GetFrameCount(void) const { return m_FrameCount; }
+		uint64_t GetByteCount(void) const { return m_ByteCount; }
+
+	private:
+		FILE* m_File = nullptr;
+		ExposureState m_Previous = {};
+		std::vector<uint8_t> m_Scratch;
+		uint32_t m_FrameCount = 0;
+		uint64_t m_ByteCount = 0;
+		bool m_bFailed = false;
+	};
+
+	// Hands a recording back one frame at a time, in the order it was recorded
+	class Player
+	{
+	public:
+		bool Load(const std::wstring& fileName);
+		void SetFrames(std::vector<ExposureState> frames);
+		void Clear(void);
+
+		// The next frame's state. Once the recording runs out this keeps giving the last frame and returns false
+		bool Next(ExposureState& state);
+
+		bool IsLoaded(void) const { return !m_Frames.empty(); }
+		uint32_t GetFrameCount(void) const { return (uint32_t)m_Frames.size(); }
+		uint32_t GetPosition(void) const { return m_Position; }
+
+	private:
+		std::vector<ExposureState> m_Frames;
+		uint32_t m_Position = 0;
+	};
+
+	//===============================================================================
+	// Two runs down the same path - a dim interior, out into daylight and back - with the second seeing the slightly darker, narrower
+	// histogram a lower resolution gives. Each adapts through ToneMapReference::AdaptExposure on histograms built from its own exposure, and
+	// the first is recorded. The recording has to decode back to the bit and reject any truncation of itself, and the second run played back
+	// from it has to follow the first exactly, while its histograms go on differing
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Frames = 1800;
+		uint32_t m_LumaWidth = 640;				// g_LumaLR, which the histogram is made from
+		uint32_t m_LumaHeight = 384;
+		ToneMapReference::Settings m_Settings;
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint32_t m_FramesRun = 0;
+		double m_BytesPerFrame = 0.0;			// Against sizeof(ExposureState) uncompressed
+		double m_AdaptNs = 0.0;					// Per frame
+		double m_EncodeNs = 0.0;
+		double m_DecodeNs = 0.0;
+		float m_MaxExposureDivergence = 0.0f;	// Largest log2 ratio between the two runs, each adapting
+		float m_ReplayedHistogramShift = 0.0f;	// Largest difference in histogram average the second run still saw while played back
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,141 @@
+#pragma once
+//===============================================================================
+// desc: A pool of objects the GPU holds onto until a fence, for CommandAllocatorPool. Objects are handed back to the thread that last used them
+//       where possible, to keep their memory warm, and otherwise recycled through PageRecycling::Recycler, which checks fences in batches. Neither
+//       the objects nor the fence are known to it beyond an interface, so a mock of each is enough to drive it.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_PageRecycler.h"
+#include "AZB_TestHarness.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace FencedPool
+{
+	using IFence = PageRecycling::IFence;
+
+	// Makes and resets whatever the pool holds. Create() is called under the pool's lock, Reset() from whichever thread is reusing the object
+	class IFactory
+	{
+	public:
+		virtual ~IFactory() {}
+		virtual void* Create(uint32_t index) = 0;
+		virtual void Reset(void* object) = 0;
+	};
+
+	constexpr uint32_t kMaxAffinity = 32;
+
+	struct Stats
+	{
+		uint64_t m_Requests = 0;
+		uint64_t m_AffinityHits = 0;		// Reused by the thread that discarded it
+		uint64_t m_PoolHits = 0;			// Reused from the shared pool
+		uint64_t m_Created = 0;
+		uint64_t m_Overflowed = 0;			// Created past maxObjects
+		PageRecycling::Stats m_Recycler;
+	};
+
+	// Everything can be called from any number of threads, except Clear()
+	class Pool
+	{
+	public:
+		// Each thread keeps the last affinitySize (up to kMaxAffinity) objects it discarded to itself, and gives older ones to the shared pool,
+		// along with whatever it still held when it exits. The first maxObjects are found again from their object without locking. More are
+		// still created past that if none are free, but finding those takes the creation lock.
+		// Objects in a thread's list are no use to any other thread, so a thread that sits idle holding a long one makes the rest create more
+		Pool(IFence& fence, IFactory& factory, uint32_t affinitySize = 4, uint32_t maxObjects = 1024);
+		~Pool();
+
+		Pool(const Pool&) = delete;
+		Pool& operator=(const Pool&) = delete;
+
+		// A reset object whose fence has passed, or a new one. nullptr only if the factory fails
+		void* Request(void);
+
+		// object must have come from Request(), and mustn't be reused until fenceValue has passed
+		void Discard(uint64_t fenceValue, void* object);
+
+		// How many have been created, and each of them, for releasing them at shutdown
+		uint32_t GetCount(void) const { return m_Count.load(std::memory_order_acquire) + m_OverflowCount.load(std::memory_order_acquire); }
+		void* GetPooled(uint32_t index) const;
+
+		// Forget every object. Only once the owner has destroyed them, with nothing else using the pool
+		void Clear(void);
+
+		// Each thread's requests only show up here every few dozen, or when it exits
+		Stats GetStats(void) const;
+
+	private:
+		struct Entry : public PageRecycling::Node
+		{
+			void* m_pObject = nullptr;
+		};
+
+		struct ThreadCache;
+		struct ThreadCaches;
+		ThreadCache& GetThreadCache(void);
+
+		// Adds what a thread has counted to the shared stats
+		void Report(ThreadCache& cache);
+
+		// Gives everything in a cache to the shared pool, for a thread that's exiting
+		void Flush(ThreadCache& cache);
+
+		Entry* Find(void* object) const;
+
+		// Past maxObjects. Called under the creation lock
+		void* CreateOverflow(void);
+
+		IFence& m_Fence;
+		IFactory& m_Factory;
+		PageRecycling::Recycler m_Recycler;
+		const uint32_t m_AffinitySize;
+		const uint32_t m_MaxObjects;
+		uint64_t m_Id;		// Thread caches are matched to their pool by this, and it changes on Clear() to orphan them
+
+		// Entries never move, so Discard() can find one from its object through the lookup table without locking. Only creating takes the lock
+		mutable std::mutex m_CreateMutex;
+		std::unique_ptr<Entry[]> m_Entries;
+		std::atomic<uint32_t> m_Count;
+		std::unique_ptr<std::atomic<uint32_t>[]> m_Lookup;		// Open addressed by object pointer, holding entry index + 1
+		uint32_t m_LookupMask;
+
+		// Everything created past maxObjects, under the creation lock. These never move either
+		std::vector<std::unique_ptr<Entry>> m_Overflow;
+		std::unordered_map<void*, Entry*> m_OverflowLookup;
+		std::atomic<uint32_t> m_OverflowCount;
+
+		std::atomic<uint64_t> m_Requests;
+		std::atomic<uint64_t> m_AffinityHits;
+		std::atomic<uint64_t> m_PoolHits;
+	};
+
+	//===============================================================================
+	// Several threads recording frames of contexts against a simulated GPU, each context taking an allocator from the pool and discarding it
+	// on submission. Compares the pool to the mutex-guarded FIFO CommandAllocatorPool used to be, and checks that nothing is handed out twice,
+	// before its fence, or without being reset
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Threads = 4;
+		uint32_t m_FramesPerThread = 20000;
+		uint32_t m_ContextsPerFrame = 3;
+		uint32_t m_FramesInFlight = 3;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		double m_MutexNsPerRequest = 0.0;
+		double m_PoolNsPerRequest = 0.0;
+		uint32_t m_MutexCreated = 0;
+		uint32_t m_PoolCreated = 0;
+		Stats m_Stats;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,88 @@
+#pragma once
+//===============================================================================
+// desc: Streaming frame-time analysis. Tracks the shape of the frame-time distribution rather than a single smoothed average - quantiles via the P-squared (P2) algorithm,
+//       frame pacing jitter, stutters and 1%/0.1% lows - all in constant time and memory per frame. Free of engine dependencies so it can be reused anywhere.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include <cstdint>
+
+namespace FrameStats
+{
+	// Jain & Chlamtac's P2 estimator: tracks a single quantile with five markers, no sample storage
+	class P2Quantile
+	{
+	public:
+		explicit P2Quantile(float quantile = 0.5f);
+
+		void Reset(void);
+		void Push(float value);
+
+		// Exact for the first five samples, an estimate after that
+		float Get(void) const;
+		uint64_t GetCount(void) const { return m_Count; }
+
+	private:
+		float m_Quantile;
+		uint64_t m_Count;
+		double m_Heights[5];		// Marker values
+		double m_Positions[5];		// Actual marker positions (1-based ranks)
+		double m_Desired[5];		// Where the markers should be
+		double m_Increments[5];		// How far the desired positions move per sample
+	};
+
+	struct FrameTimeSummary
+	{
+		uint64_t m_Frames = 0;
+
+		float m_MeanMs = 0.f;
+		float m_P50Ms = 0.f;
+		float m_P95Ms = 0.f;
+		float m_P99Ms = 0.f;
+		float m_P999Ms = 0.f;
+
+		// Mean absolute change between consecutive frames. A steady 30ms is smoother to the eye than alternating 10ms/20ms, despite the worse average
+		float m_JitterMs = 0.f;
+
+		// Frames that took longer than the stutter factor times the running median
+		uint64_t m_Stutters = 0;
+		float m_StutterPercent = 0.f;
+
+		// Frame rate at the 99th and 99.9th percentile frame times
+		float m_AverageFPS = 0.f;
+		float m_Low1PercentFPS = 0.f;
+		float m_Low01PercentFPS = 0.f;
+	};
+
+	class FrameTimeAnalyzer
+	{
+	public:
+		explicit FrameTimeAnalyzer(float stutterFactor = 2.0f);
+
+		void Reset(void);
+
+		// O(1) - call once per frame with that frame's time in milliseconds. Non-positive values are ignored
+		void Push(float frameMs);
+
+		FrameTimeSummary GetSummary(void) const;
+		uint64_t GetFrameCount(void) const { return m_Count; }
+
+		void SetStutterFactor(float factor) { m_StutterFactor = factor; }
+		float GetStutterFactor(void) const { return m_StutterFactor; }
+
+	private:
+		// Don't call anything a stutter until the median has had a few frames to settle
+		static constexpr uint64_t kStutterWarmupFrames = 16;
+
+		P2Quantile m_P50;
+		P2Quantile m_P95;
+		P2Quantile m_P99;
+		P2Quantile m_P999;
+
+		float m_StutterFactor;
+		uint64_t m_Count;
+		uint64_t m_Stutters;
+		double m_Sum;
+		double m_JitterSum;
+		float m_LastMs;
+	};
+}
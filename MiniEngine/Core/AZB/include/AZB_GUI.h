@@ -135,9 +135,29 @@ namespace RTUA_GUI
     extern bool m_ShowHardwareMetrics;
     extern bool m_ShowFrameRate;
 
+    // Set while a scripted benchmark sweep is driving the app. The GUI hides itself and only shows progress
+    extern bool m_bBenchmarkActive;
+    extern std::string m_BenchmarkStatus;
+
     // Counter variable to track "pages" on the tutorial
     extern uint8_t m_Page;
 
+    //
+    //  Pipeline state changes
+    //
+    //  These apply the same changes as the GUI controls do, flagging them for UpdateGraphics() next frame. 
+    //  They are shared with the benchmark runner so both paths stay in sync.
+    //
+
+    void SetRenderingMode(eRenderingMode mode);
+    void SetDLSSQualityMode(uint8_t mode);
+    void SetBilinearInputResolution(const Resolution& res);
+    void SetNativeResolution(const Resolution& res);
+    void SetLodBiasOverride(bool bOverride, float bias);
+
+    // True while any requested change is still waiting to go through UpdateGraphics()
+    bool IsPipelineChangePending();
+
     //
     // GBuffer handling
     //
@@ -193,12 +213,19 @@ namespace RTUA_GUI
     void GraphicsSettingsDebug(CommandContext& Context);
 
     void PerformanceMetrics();
+    void FrameTimeDistribution();			// Quantiles, lows and stutters since the last pipeline change
+
+    // Minimal progress window shown instead of the main GUI while a benchmark is running
+    void BenchmarkOverlay();
 
 
 	//
 	// Constants to help with this specific GUI
 	//
 
+    // Frames to ignore after a pipeline change before frame-time stats start counting again
+    const uint32_t kFrameStatsSettleFrames = 5;
+
     // How big is the main GUI window? Normally I'd make this a constant but the resolution will constantly be changing in this app!
     extern ImVec2 m_MainWindowSize;
     // Starting position of main window
@@ -0,0 +1,90 @@
+#pragma once
+//===============================================================================
+// desc: The small floats the CPU references store through - f32tof16 and f16tof32, and the 5 bit exponent encoding that halves and the
+//       R11G11B10_FLOAT channels share - done bit for bit as the GPU does them, so every reference rounds the same way in one place.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace HalfFloat
+{
+	// asuint and asfloat
+	inline uint32_t AsUint(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	inline float AsFloat(uint32_t bits)
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// Shifts right, rounding to nearest even on whatever falls off
+	inline uint32_t RoundShift(uint32_t value, uint32_t shift)
+	{
+		if (shift == 0)
+			return value;
+		if (shift >= 32)
+			return 0;
+
+		const uint32_t result = value >> shift;
+		const uint32_t remainder = value & ((1u << shift) - 1);
+		const uint32_t half = 1u << (shift - 1);
+		return (remainder > half || (remainder == half && (result & 1) != 0)) ? result + 1 : result;
+	}
+
+	// A positive float as a 5 bit exponent and mantissaBits of mantissa. Comes out as 31 << mantissaBits or more if it's too big
+	inline uint32_t EncodeMagnitude(uint32_t bits, uint32_t mantissaBits)
+	{
+		const int32_t exponent = (int32_t)(bits >> 23) - 127 + 15;
+		const uint32_t dropped = 23 - mantissaBits;
+		if (exponent >= 31)
+			return 31u << mantissaBits;
+
+		// A carry out of the mantissa moves the exponent up, which is what it should do
+		if (exponent > 0)
+			return ((uint32_t)exponent << mantissaBits) + RoundShift(bits & 0x7FFFFF, dropped);
+
+		return RoundShift((bits & 0x7FFFFF) | 0x800000, dropped + (uint32_t)(1 - exponent));
+	}
+
+	inline float DecodeMagnitude(uint32_t encoded, uint32_t mantissaBits)
+	{
+		const uint32_t exponent = encoded >> mantissaBits;
+		const uint32_t mantissa = encoded & ((1u << mantissaBits) - 1);
+		if (exponent == 0)
+			return std::ldexp((float)mantissa, -14 - (int32_t)mantissaBits);
+		if (exponent == 31)
+			return mantissa == 0 ? INFINITY : NAN;
+		return std::ldexp((float)(mantissa | (1u << mantissaBits)), (int32_t)exponent - 15 - (int32_t)mantissaBits);
+	}
+
+	// f32tof16 and f16tof32 on their own, for halves packed two to a word as LDS and the velocity buffer hold them
+	inline uint32_t FloatToHalf(float value)
+	{
+		const uint32_t bits = AsUint(value);
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		if (std::isnan(value))
+			return sign | 0x7E00;
+		return sign | std::min(EncodeMagnitude(bits & 0x7FFFFFFF, 10), 0x7C00u);
+	}
+
+	inline float HalfToFloat(uint32_t half)
+	{
+		const float magnitude = DecodeMagnitude(half & 0x7FFF, 10);
+		return (half & 0x8000) != 0 ? -magnitude : magnitude;
+	}
+
+	// What f32tof16 then f16tof32 does to a value, as a store to a 16 bit float buffer or LDS does
+	inline float RoundToHalf(float value)
+	{
+		return HalfToFloat(FloatToHalf(value));
+	}
+}
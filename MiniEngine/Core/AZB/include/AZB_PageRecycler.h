@@ -0,0 +1,163 @@
+#pragma once
+//===============================================================================
+// desc: Lock-free recycling of fence-guarded pages, for LinearAllocatorPageManager. Retired pages go onto a lock-free list stamped with their fence,
+//       get checked against the GPU in batches whenever a thread runs short, and come back through a small per-thread cache backed by a shared
+//       lock-free pool. Pages only need to derive from PageRecycling::Node, and the fence is behind an interface, so none of this touches D3D.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace PageRecycling
+{
+	// Intrusive link, so nothing is allocated to retire or recycle a page
+	struct Node
+	{
+		std::atomic<Node*> m_pNextRecycled{ nullptr };
+		std::atomic<Node*> m_pNextBatch{ nullptr };		// Only while the page waits in the shared pool
+		uint64_t m_RetiredFence = 0;
+	};
+
+	// Fence values carry the queue they were signalled on in their top 8 bits, as CommandListManager hands them out
+	class IFence
+	{
+	public:
+		virtual ~IFence() {}
+		virtual bool IsFenceComplete(uint64_t fenceValue) = 0;
+	};
+
+	constexpr uint32_t kMaxThreadCache = 8;
+
+	struct Stats
+	{
+		uint64_t m_Requests = 0;
+		uint64_t m_ThreadCacheHits = 0;
+		uint64_t m_PoolHits = 0;
+		uint64_t m_Misses = 0;			// Nothing free - the caller made a new page
+		uint64_t m_Recycled = 0;		// Retired pages found to be past their fence
+		uint64_t m_Deleted = 0;
+		uint64_t m_FencePolls = 0;		// Calls into IFence
+	};
+
+	// All of it can be called from any number of threads, except Clear()
+	class Recycler
+	{
+	public:
+		// threadCacheSize pages (up to kMaxThreadCache) are kept back for the thread that found them, so it doesn't have to touch the shared pool
+		// next time. Pages sitting in a thread's cache when that thread exits are never recycled. 0 turns the cache off.
+		// When Acquire() finds another thread checking fences, it gives that thread one yield and then misses, so nobody stalls behind a drainer
+		// that's been preempted. bWaitOnBusyDrain has it wait the drain out instead, for owners whose objects cost more to make than to wait for
+		explicit Recycler(IFence& fence, uint32_t threadCacheSize = 4, bool bWaitOnBusyDrain = false);
+
+		Recycler(const Recycler&) = delete;
+		Recycler& operator=(const Recycler&) = delete;
+
+		// A page whose fence has passed, or nullptr if there isn't one and the caller should create a new page
+		Node* Acquire(void);
+
+		// Hand back pages the GPU may still be reading until fenceValue has passed. Returns immediately - the fence is checked when pages are needed
+		void Retire(uint64_t fenceValue, Node* const* nodes, size_t count);
+
+		// As Retire(), except the pages are destroyed rather than reused. Pass them to the caller once their fence passes via CollectDeletable()
+		void RetireForDeletion(uint64_t fenceValue, Node* const* nodes, size_t count);
+
+		// Pages from RetireForDeletion() that are now safe to destroy, chained through m_pNextRecycled. nullptr if none
+		Node* CollectDeletable(void);
+
+		// Forget every page. Only for when the owner is about to destroy them all, with nothing else using the recycler
+		void Clear(void);
+
+		// Thread cache hits are only added in when that thread next misses its cache, so they can lag behind by up to a cache's worth per thread
+		Stats GetStats(void) const;
+
+	private:
+		struct ThreadCache;
+		ThreadCache& GetThreadCache(void);
+
+		// The shared pool is a stack of batches of up to one more page than a thread cache holds, chained through m_pNextRecycled and stacked
+		// through m_pNextBatch, so one pop serves a request and refills the cache behind it. Tagged with a counter in the top 16 bits against
+		// ABA, as a popped batch can be pushed straight back by another thread
+		void PushAvailable(Node* batch);
+		Node* PopAvailable(void);
+
+		// Keeps the first page of a batch for the caller and puts the rest in the thread's cache, which has to be empty
+		static Node* TakeBatch(Node* batch, ThreadCache* cache);
+
+		static constexpr uint32_t kMaxQueues = 8;
+
+		// Retiring threads push onto m_Incoming without locking. Whoever drains it files the pages per queue in fence order, so completed
+		// pages come off the front, and the fence only needs asking about once per distinct fence value that has passed. Fences are handed
+		// out in order, so pages nearly always arrive in order too - each is inserted from the back, which is an append unless threads raced
+		// to retire. One thread drains at a time - anyone else finding it busy carries on rather than waiting
+		struct PendingPage
+		{
+			uint64_t m_Fence;
+			Node* m_Node;
+		};
+
+		struct RetiredQueue
+		{
+			std::atomic<Node*> m_Incoming{ nullptr };
+			std::atomic<bool> m_bDraining{ false };
+
+			// Only touched by the draining thread. Pages still pending are m_Pending[i] from m_PendingHead[i] on, oldest fence first
+			uint64_t m_QueueIds[kMaxQueues];
+			uint64_t m_KnownComplete[kMaxQueues];
+			std::vector<PendingPage> m_Pending[kMaxQueues];
+			size_t m_PendingHead[kMaxQueues];
+			uint32_t m_QueueCount = 0;
+
+			// Also only written by the draining thread, so they're bumped without a locked add. Drains that found something, pages found past
+			// their fence, and IFence calls
+			std::atomic<uint64_t> m_Hits{ 0 };
+			std::atomic<uint64_t> m_Drained{ 0 };
+			std::atomic<uint64_t> m_FencePolls{ 0 };
+		};
+
+		void Retire(RetiredQueue& queue, uint64_t fenceValue, Node* const* nodes, size_t count);
+
+		// Pages now past their fence, chained through m_pNextRecycled with count filled in. nullptr if none, or if busy
+		Node* Drain(RetiredQueue& queue, uint64_t& count);
+
+		IFence& m_Fence;
+		const uint32_t m_ThreadCacheSize;
+		const bool m_bWaitOnBusyDrain;
+		uint64_t m_Id;		// Thread caches are matched to their recycler by this, and it changes on Clear() to orphan them
+
+		std::atomic<uint64_t> m_Available;
+		RetiredQueue m_Retired;
+		RetiredQueue m_Deletion;
+
+		std::atomic<uint64_t> m_ThreadCacheHits;
+		std::atomic<uint64_t> m_PoolHits;
+		std::atomic<uint64_t> m_Misses;
+	};
+
+	//===============================================================================
+	// Several threads requesting and retiring pages against a fence advanced by a simulated GPU, comparing the recycler to a mutex-guarded FIFO
+	// the way LinearAllocatorPageManager used to work. Also checks that no page is ever handed out before its fence or to two threads at once
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Threads = 8;
+		uint32_t m_FramesPerThread = 20000;
+		uint32_t m_PagesPerFrame = 4;
+		uint32_t m_FramesInFlight = 3;		// How far the simulated GPU lags behind the latest fence
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		double m_MutexNsPerPage = 0.0;
+		double m_LockFreeNsPerPage = 0.0;
+		uint32_t m_MutexPagesCreated = 0;
+		uint32_t m_LockFreePagesCreated = 0;
+		uint64_t m_MutexFencePolls = 0;		// The recycler's are in m_Stats
+		Stats m_Stats;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,179 @@
+#pragma once
+//===============================================================================
+// desc: A CPU backend for the particle system, emitting and updating exactly as ParticleSpawnCS and ParticleUpdateCS do, so it can stand in for
+//       the GPU as a reference and run particle-heavy scenes headless. Particles are kept structure of arrays, one stream per attribute, updated
+//       4 at a time with SSE2 where available and shared between threads in chunks. The dead are swap-removed, and so are effects past their
+//       lifetime, so neither ever leaves a hole to skip over.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_CounterRNG.h"
+#include "AZB_WorkerPool.h"
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ParticleSim
+{
+	// ParticleEffectProperties and its EmissionProperties, in plain floats. Defaults are the same as theirs
+	struct EffectDesc
+	{
+		float m_EmitPosition[3] = { 0.0f, 0.0f, 0.0f };
+		float m_EmitDirection[3] = { 0.0f, 0.0f, 1.0f };
+		float m_EmitRight[3] = { 1.0f, 0.0f, 0.0f };
+		float m_EmitUp[3] = { 0.0f, 1.0f, 0.0f };
+		float m_EmitSpeed = 1.0f;
+		float m_EmitterVelocitySensitivity = 0.0f;
+		float m_Restitution = 0.6f;
+		float m_Gravity[3] = { 0.0f, -5.0f, 0.0f };
+		uint32_t m_MaxParticles = 500;
+		uint32_t m_TextureID = 0;
+
+		float m_EmitRate = 200.0f;
+		float m_LifeMinMax[2] = { 1.0f, 2.0f };
+		float m_MassMinMax[2] = { 0.5f, 1.0f };
+		float m_Size[4] = { 0.07f, 0.7f, 0.8f, 0.8f };			// Start size min and max, then end size min and max
+		float m_Spread[3] = { 0.5f, 1.5f, 0.1f };
+		float m_Velocity[4] = { 0.5f, 3.0f, -0.5f, 3.0f };		// Horizontal speed min and max, then vertical
+		float m_MinStartColor[4] = { 0.8f, 0.8f, 1.0f, 1.0f };
+		float m_MaxStartColor[4] = { 0.9f, 0.9f, 1.0f, 1.0f };
+		float m_MinEndColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		float m_MaxEndColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		float m_TotalActiveLifetime = 20.0f;
+	};
+
+	// Laid out like ParticleVertex, so a frame's sprites can be copied straight into SpriteVertexBuffer
+	struct SpriteVertex
+	{
+		float m_Position[3];
+		float m_Color[4];
+		float m_Size;
+		uint32_t m_TextureID;
+	};
+
+	// One stream per attribute. The start and end values a particle lerps between are copied out of its spawn data when it's born, so the update
+	// never has to gather
+	enum ParticleStream
+	{
+		kPositionX, kPositionY, kPositionZ,
+		kVelocityX, kVelocityY, kVelocityZ,
+		kMass, kAge, kAgeRate,
+		kStartSize, kEndSize,
+		kStartR, kStartG, kStartB, kStartA,
+		kEndR, kEndG, kEndB, kEndA,
+		kSize, kColorR, kColorG, kColorB, kColorA,		// The sprite the last update made
+		kNumParticleStreams
+	};
+
+	// The per slot random data LoadDeviceResources fills m_RandomStateBuffer with
+	enum SpawnStream
+	{
+		kSpawnAgeRate,
+		kSpawnVelocityX, kSpawnVelocityY, kSpawnVelocityZ,
+		kSpawnSpreadX, kSpawnSpreadY, kSpawnSpreadZ,
+		kSpawnStartSize, kSpawnEndSize,
+		kSpawnStartR, kSpawnStartG, kSpawnStartB, kSpawnStartA,
+		kSpawnEndR, kSpawnEndG, kSpawnEndB, kSpawnEndA,
+		kSpawnMass, kSpawnRandom,
+		kNumSpawnStreams
+	};
+
+	struct Effect
+	{
+		EffectDesc m_Desc;
+		CounterRNG::Stream m_Random;
+		float m_LastEmitPosition[3];
+		float m_ElapsedTime = 0.0f;
+
+		uint32_t m_Capacity = 0;			// m_MaxParticles rounded up to a whole SIMD width
+		uint32_t m_Count = 0;
+		uint32_t m_SpriteCount = 0;			// The first m_SpriteCount particles were updated last frame and have sprites. The rest were just born
+
+		std::vector<float> m_Particles;		// kNumParticleStreams streams of m_Capacity
+		std::vector<uint32_t> m_ResetIndex;	// Which spawn slot each particle came from, like ParticleMotion::ResetDataIndex
+		std::vector<uint8_t> m_Alive;
+		std::vector<float> m_Spawn;			// kNumSpawnStreams streams of m_MaxParticles
+
+		Effect(const EffectDesc& desc, uint64_t seed);
+
+		float* GetStream(ParticleStream stream) { return &m_Particles[(size_t)stream * m_Capacity]; }
+		const float* GetStream(ParticleStream stream) const { return &m_Particles[(size_t)stream * m_Capacity]; }
+		const float* GetSpawnStream(SpawnStream stream) const { return &m_Spawn[(size_t)stream * m_Desc.m_MaxParticles]; }
+	};
+
+	// Every live effect and its particles. Keeps a few worker threads around between updates, since it runs every frame when it's in use
+	class System
+	{
+	public:
+		// 0 picks one less than the hardware has, leaving the calling thread to do its share
+		explicit System(uint32_t workerThreads = 0);
+
+		System(const System&) = delete;
+		System& operator=(const System&) = delete;
+
+		// Returns the effect's index. An effect retiring swaps the last one into its place, so indices only hold until the next Update()
+		uint32_t AddEffect(const EffectDesc& desc, uint64_t seed);
+		void Clear(void);
+
+		// ParticleEffect::Update for every effect, then effects past their lifetime are removed like ParticleEffectManager::Update does
+		void Update(float timeDelta);
+
+		uint32_t GetEffectCount(void) const { return (uint32_t)m_Effects.size(); }
+		const Effect& GetEffect(uint32_t index) const { return *m_Effects[index]; }
+		uint32_t GetParticleCount(void) const;
+		uint32_t GetWorkerCount(void) const { return m_Pool.GetWorkerCount(); }
+
+		// Appends what ParticleUpdateCS would have written to the sprite vertex buffer this frame
+		void GatherVertices(std::vector<SpriteVertex>& vertices) const;
+
+	private:
+		enum Phase { kUpdatePhase, kEmitPhase };
+
+		void Run(Phase phase, uint32_t jobCount);
+		void ProcessJob(uint32_t job);
+
+		std::vector<std::unique_ptr<Effect>> m_Effects;
+
+		// A run of one effect's particles, so a big effect is shared out as well as many small ones
+		struct Chunk
+		{
+			uint32_t m_Effect;
+			uint32_t m_First;
+			uint32_t m_Count;
+		};
+		std::vector<Chunk> m_Chunks;
+
+		// Only valid during Update()
+		float m_TimeDelta = 0.0f;
+		Phase m_Phase = kUpdatePhase;
+
+		WorkerPool::Pool m_Pool;
+	};
+
+	//===============================================================================
+	// Many effects firing at once, some retiring part way, stepped through System and through a one particle at a time reference that follows
+	// the shaders line for line with particles stored as ParticleMotion is. Both have to agree on every particle, every frame
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Frames = 300;
+		uint32_t m_Effects = 64;
+		uint32_t m_MaxParticles = 4096;		// Per effect
+		float m_EmitRate = 3000.0f;
+		float m_TimeDelta = 1.0f / 60.0f;
+		EffectDesc m_Template;				// Everything else, varied a little per effect
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint32_t m_Workers = 0;
+		double m_AverageParticles = 0.0;
+		uint32_t m_PeakParticles = 0;
+		double m_SystemMs = 0.0;			// Per frame
+		double m_ReferenceMs = 0.0;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
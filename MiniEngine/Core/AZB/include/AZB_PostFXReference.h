@@ -0,0 +1,239 @@
+#pragma once
+//===============================================================================
+// desc: A CPU implementation of DepthOfField::Render and MotionBlur::RenderObjectBlur - tile classification, the prefilter, the ring blur, the
+//       median filter and the combine, then the motion blur prepass and its final pass - doing the same math as the shaders through the same
+//       buffer formats. It runs over depth, colour and velocity captured from the engine, so the two effects can be measured at each internal
+//       resolution against native, and a shader change can be checked against what the CPU says it should give.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_WorkerPool.h"
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace PostFXReference
+{
+	// Up to four channels per texel, rows top to bottom
+	struct Plane
+	{
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		uint32_t m_Channels = 0;
+		std::vector<float> m_Values;
+
+		void Resize(uint32_t width, uint32_t height, uint32_t channels)
+		{
+			m_Width = width;
+			m_Height = height;
+			m_Channels = channels;
+			m_Values.assign((size_t)width * height * channels, 0.0f);
+		}
+		float* At(uint32_t x, uint32_t y) { return &m_Values[((size_t)y * m_Width + x) * m_Channels]; }
+		const float* At(uint32_t x, uint32_t y) const { return &m_Values[((size_t)y * m_Width + x) * m_Channels]; }
+	};
+
+	// What the engine hands both effects, as the texels of the buffers it keeps them in
+	struct InputFrame
+	{
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		std::vector<uint16_t> m_LinearDepth;	// g_LinearDepth, R16_UNORM view depth over the far plane
+		std::vector<uint32_t> m_Color;			// g_SceneColorBuffer, R11G11B10_FLOAT
+		std::vector<uint32_t> m_Velocity;		// g_VelocityBuffer, as PackVelocity has it
+		float m_FarClip = 10000.0f;
+	};
+
+	// PixelPacking_Velocity's PackVelocity and UnpackVelocity: x and y in pixels to the previous frame, and z in linear depth
+	uint32_t PackVelocity(const float velocity[3]);
+	void UnpackVelocity(uint32_t packed, float velocity[3]);
+
+	// The DepthOfField and MotionBlur settings the two read. Defaults are the same as the engine's
+	struct Settings
+	{
+		bool m_bDepthOfField = true;
+		bool m_bMotionBlur = true;
+
+		float m_FocalDepth = 0.1f;
+		float m_FocalRange = 0.1f;
+		float m_ForegroundRange = 100.0f;		// In world units, turned into linear depth with the frame's far clip
+		float m_AntiSparkleWeight = 1.0f;
+		bool m_bEnablePreFilter = true;
+		bool m_bMedianFilter = true;
+		bool m_bMedianAlpha = false;
+		bool m_bForceSlow = false;
+		bool m_bForceFast = false;
+	};
+
+	// The DoF shaders' CB0
+	struct DoFConstants
+	{
+		float m_FocusCenter;
+		float m_FocalSpread;
+		float m_FocalMinDist;
+		float m_FocalMaxDist;
+		float m_RcpBufferDim[2];
+		uint32_t m_FullDimension[2];
+		int32_t m_HalfDimensionMinusOne[2];		// As Render sets it, which is the half size and not one less
+		uint32_t m_TiledDimension[2];
+		float m_InvTiledDimension[2];
+		bool m_bDisablePreFilter;
+		float m_ForegroundRange;
+		float m_RcpForegroundRange;
+		float m_AntiSparkleFilterStrength;
+	};
+
+	// Every buffer the two effects write, at the formats they write them in, with the inputs as the shaders read them. The effects each start
+	// from the input colour, as Render only ever runs one of them. Buffers an effect that's off, or the median filter, would have written are
+	// left empty
+	struct FrameResult
+	{
+		Plane m_LinearDepth;
+		Plane m_Color;
+		Plane m_Velocity;						// x and y only
+
+		Plane m_TileClass[2];					// g_DoFTileClass
+		std::vector<uint32_t> m_WorkQueue;		// Tiles as x | y << 16, in row order rather than the order the GPU appends them in
+		std::vector<uint32_t> m_FastQueue;
+		std::vector<uint32_t> m_FixupQueue;
+		Plane m_Presort;						// g_DoFPresortBuffer
+		Plane m_Prefilter;						// g_DoFPrefilter
+		Plane m_BlurColor[2];					// g_DoFBlurColor
+		Plane m_BlurAlpha[2];					// g_DoFBlurAlpha
+		Plane m_DepthOfField;					// The scene once DoF is combined into it
+
+		Plane m_MotionPrep;						// g_MotionPrepBuffer
+		Plane m_MotionBlur;						// The scene once it's motion blurred
+	};
+
+	// Each pass is shared between a few worker threads, finishing before the next starts, the way dispatches do. Tiles are handed out from
+	// the queues the way the indirect dispatches take them, and buffers are kept between frames, so frames of the same size don't allocate
+	class Processor
+	{
+	public:
+		// 0 picks one less than the hardware has, leaving the calling thread to do its share
+		explicit Processor(uint32_t workerThreads = 0);
+
+		Processor(const Processor&) = delete;
+		Processor& operator=(const Processor&) = delete;
+
+		void ProcessFrame(const InputFrame& input, const Settings& settings, FrameResult& result);
+
+		uint32_t GetWorkerCount(void) const { return m_Pool.GetWorkerCount(); }
+
+	private:
+		enum Phase
+		{
+			kUnpackPhase, kTileClassPhase, kTileSpreadPhase, kTileFixupPhase, kPreFilterPhase, kMainPhase, kMedianPhase, kCombinePhase,
+			kMotionPrepPhase, kMotionBlurPhase
+		};
+
+		// A tile of one of the indirect dispatches, and which of the shaders for it takes the tile
+		struct TileJob
+		{
+			uint32_t m_Tile;
+			uint32_t m_Queue;
+			bool m_bFast;
+		};
+
+		void Run(Phase phase, uint32_t jobCount);
+		void ProcessJob(uint32_t job);
+
+		// Only valid during ProcessFrame()
+		const InputFrame* m_Input = nullptr;
+		const Settings* m_Settings = nullptr;
+		FrameResult* m_Result = nullptr;
+		DoFConstants m_Constants = {};
+
+		// Each row of tiles' share of the queues, before they're put together in row order
+		std::vector<std::vector<uint32_t>> m_RowQueues[3];
+		std::vector<TileJob> m_TileJobs;
+
+		Phase m_Phase = kUnpackPhase;
+
+		WorkerPool::Pool m_Pool;
+	};
+
+	// The same frame one thread group at a time, each group following its shader line for line, LDS included. Slow, but there to check
+	// Processor against
+	void ProcessFrameReference(const InputFrame& input, const Settings& settings, FrameResult& result);
+
+	//===============================================================================
+	// Captured frames are kept as the texels the three buffers hold, with each frame's far clip alongside
+
+	struct InputSequence
+	{
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		std::vector<InputFrame> m_Frames;
+	};
+
+	bool LoadInputFrames(const std::wstring& fileName, InputSequence& sequence);
+
+	// Writes frames as they come, so a capture doesn't have to be held in memory. The count in the header is filled in by Close()
+	class InputWriter
+	{
+	public:
+		InputWriter(void) = default;
+		~InputWriter(void) { Close(); }
+
+		InputWriter(const InputWriter&) = delete;
+		InputWriter& operator=(const InputWriter&) = delete;
+
+		bool Open(const std::wstring& fileName, uint32_t width, uint32_t height);
+		bool Write(const uint16_t* linearDepth, const uint32_t* color, const uint32_t* velocity, float farClip);
+		bool Close(void);
+
+		bool IsOpen(void) const { return m_File != nullptr; }
+		uint32_t GetFrameCount(void) const { return m_FrameCount; }
+		uint32_t GetWidth(void) const { return m_Width; }
+		uint32_t GetHeight(void) const { return m_Height; }
+
+	private:
+		FILE* m_File = nullptr;
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		uint32_t m_FrameCount = 0;
+		bool m_bFailed = false;
+	};
+
+	//===============================================================================
+	// A camera strafing and turning through a synthetic courtyard of posts in front of a lit back wall, drawn at native resolution and at each
+	// of the upscalers' internal resolutions, with velocity from where each point was the frame before. Every frame at every resolution goes
+	// through Processor and the reference, which have to agree to the bit, and the lower resolutions' input and both effects, scaled back up,
+	// are measured against native
+
+	constexpr uint32_t kResolutionScales = 4;
+	extern const float kResolutionScale[kResolutionScales];		// DLSS's performance, balanced, quality and ultra performance, in that order
+
+	// What's measured at each scale: the input colour on its own, so the effects can be told apart from what the lower resolution lost anyway
+	enum Measured { kMeasuredInput, kMeasuredDepthOfField, kMeasuredMotionBlur, kMeasuredCount };
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Frames = 4;
+		uint32_t m_Width = 1280;
+		uint32_t m_Height = 720;
+		std::wstring m_CaptureFile;				// Run over these frames instead, if it loads. Lower resolutions are point sampled from them
+		Settings m_Settings;
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint32_t m_Workers = 0;
+		uint32_t m_FramesRun = 0;
+		bool m_bFromCapture = false;
+		double m_WorkTiles = 0.0;				// Per frame at native resolution, in each queue
+		double m_FastTiles = 0.0;
+		double m_FixupTiles = 0.0;
+		double m_ProcessorMs = 0.0;				// Per frame, at native resolution
+		double m_ReferenceMs = 0.0;
+		double m_MeanError[kMeasuredCount][kResolutionScales] = {};		// Mean absolute difference from native once scaled back up, tone mapped
+		double m_BadPixels[kMeasuredCount][kResolutionScales] = {};		// Fraction off by more than 0.05
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
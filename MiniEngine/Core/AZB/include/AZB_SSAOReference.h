@@ -0,0 +1,218 @@
+#pragma once
+//===============================================================================
+// desc: A CPU implementation of SSAO::Render - depth linearised, downsampled and deinterleaved, AO rendered at up to four resolutions both
+//       interleaved and whole, then blurred and bilaterally upsampled back to full resolution - doing the same math as the shaders through the
+//       same buffer formats. It runs over depth captured from the engine, so AO can be measured at each internal resolution against native,
+//       and a shader change can be checked against what the CPU says it should give.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_WorkerPool.h"
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace SSAOReference
+{
+	// As SSAO's g_QualityLevel
+	enum Quality { kQualityVeryLow, kQualityLow, kQualityMedium, kQualityHigh, kQualityVeryHigh };
+
+	// The levels below full resolution that AO is rendered at, as g_DepthDownsize1 to 4
+	constexpr uint32_t kLevels = 4;
+
+	// Deinterleaved depth is 4x4 slices of a quarter of the level's size
+	constexpr uint32_t kSlices = 16;
+
+	// One channel per texel, rows top to bottom
+	struct Plane
+	{
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		std::vector<float> m_Values;
+
+		void Resize(uint32_t width, uint32_t height) { m_Width = width; m_Height = height; m_Values.assign((size_t)width * height, 0.0f); }
+		float& At(uint32_t x, uint32_t y) { return m_Values[(size_t)y * m_Width + x]; }
+		float At(uint32_t x, uint32_t y) const { return m_Values[(size_t)y * m_Width + x]; }
+	};
+
+	// What the depth buffer held and the projection it was drawn with
+	struct DepthFrame
+	{
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		std::vector<float> m_Depth;		// Hardware depth, reversed so 1 is the near plane
+		float m_ZMagic = 0.0f;			// (far - near) / near
+		float m_FovTangent = 1.0f;		// 1 / projection[0], the tangent of half the horizontal FOV
+	};
+
+	// The SSAO settings Render reads. Defaults are the same as the engine's
+	struct Settings
+	{
+		Quality m_Quality = kQualityHigh;
+		uint32_t m_HierarchyDepth = 3;				// 1 to 4
+		float m_NoiseFilterTolerance = -3.0f;		// log10
+		float m_BlurTolerance = -5.0f;				// log10
+		float m_UpsampleTolerance = -7.0f;			// log10
+		float m_RejectionFalloff = 2.5f;
+		float m_Accentuation = 0.1f;
+	};
+
+	// Every buffer Render writes, at the formats it writes them in. Levels past the hierarchy depth, and high quality AO the quality level
+	// doesn't ask for, are left empty
+	struct FrameResult
+	{
+		Plane m_LinearDepth;						// g_LinearDepth
+		Plane m_Downsized[kLevels];					// g_DepthDownsize1 to 4
+		Plane m_Tiled[kLevels][kSlices];			// g_DepthTiled1 to 4, a slice at a time
+		Plane m_Merged[kLevels];					// g_AOMerged1 to 4
+		Plane m_HighQuality[kLevels];				// g_AOHighQuality1 to 4
+		Plane m_Smooth[kLevels - 1];				// g_AOSmooth1 to 3
+		Plane m_AO;									// g_SSAOFullScreen
+	};
+
+	// Each pass is shared between a few worker threads, finishing before the next starts, the way dispatches do. AO is rendered and blurred
+	// 4 texels at a time with SSE2 where available. Buffers are kept between frames, so frames of the same size don't allocate
+	class Processor
+	{
+	public:
+		// 0 picks one less than the hardware has, leaving the calling thread to do its share
+		explicit Processor(uint32_t workerThreads = 0);
+
+		Processor(const Processor&) = delete;
+		Processor& operator=(const Processor&) = delete;
+
+		void ProcessFrame(const DepthFrame& depth, const Settings& settings, FrameResult& result);
+
+		uint32_t GetWorkerCount(void) const { return m_Pool.GetWorkerCount(); }
+
+	private:
+		enum Phase { kPreparePhase, kTilePhase, kRenderPhase, kBlurLoadPhase, kBlurHorizontalPhase, kBlurVerticalPhase, kUpsamplePhase };
+
+		// A plane with a border around it, so neighbours can be read without checking bounds
+		struct PaddedPlane
+		{
+			uint32_t m_Width = 0;
+			uint32_t m_Height = 0;
+			uint32_t m_Stride = 0;
+			uint32_t m_Padding = 0;
+			std::vector<float> m_Values;
+
+			void Resize(uint32_t width, uint32_t height, uint32_t padding);
+			float* Row(int32_t y) { return &m_Values[(size_t)(y + (int32_t)m_Padding) * m_Stride + m_Padding]; }
+			const float* Row(int32_t y) const { return &m_Values[(size_t)(y + (int32_t)m_Padding) * m_Stride + m_Padding]; }
+		};
+
+		void RenderAO(const Plane* source, uint32_t sliceCount, bool bInterleaved, Plane& output);
+		void BlurAndUpsample(const Plane& hiDepth, const Plane& loDepth, const Plane& interleavedAO, const Plane* highQualityAO,
+			const Plane* hiAO, Plane& output);
+
+		void Run(Phase phase, uint32_t jobCount);
+		void ProcessJob(uint32_t job);
+
+		// Only valid during ProcessFrame()
+		const DepthFrame* m_Depth = nullptr;
+		const Settings* m_Settings = nullptr;
+		FrameResult* m_Result = nullptr;
+		uint32_t m_PreparedLevels = 0;
+
+		// The AO pass under way
+		const Plane* m_RenderSource = nullptr;
+		uint32_t m_RenderSlices = 0;
+		bool m_bRenderInterleaved = false;
+		Plane* m_RenderOutput = nullptr;
+		float m_RenderConstants[28];				// As ComputeAO's SsaoCB
+		PaddedPlane m_RenderInput[kSlices];
+
+		// The blur and upsample pass under way, and what it keeps between its phases
+		const Plane* m_BlurHiDepth = nullptr;
+		const Plane* m_BlurLoDepth = nullptr;
+		const Plane* m_BlurAO[2] = {};
+		const Plane* m_BlurHiAO = nullptr;
+		Plane* m_BlurOutput = nullptr;
+		float m_BlurConstants[8];				// As BlurAndUpsample's cbData
+		PaddedPlane m_BlurInput;
+		PaddedPlane m_BlurDepth;
+		PaddedPlane m_BlurHorizontal;
+		PaddedPlane m_BlurVertical;
+
+		Phase m_Phase = kPreparePhase;
+
+		WorkerPool::Pool m_Pool;
+	};
+
+	// The same frame one thread group at a time, each group following its shader line for line, LDS included. Slow, but there to check
+	// Processor against
+	void ProcessFrameReference(const DepthFrame& depth, const Settings& settings, FrameResult& result);
+
+	//===============================================================================
+	// Captured depth is kept as the D32_FLOAT the depth buffer holds, with each frame's projection alongside
+
+	struct DepthSequence
+	{
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		std::vector<DepthFrame> m_Frames;
+	};
+
+	bool LoadDepthFrames(const std::wstring& fileName, DepthSequence& sequence);
+
+	// Writes frames as they come, so a capture doesn't have to be held in memory. The count in the header is filled in by Close()
+	class DepthWriter
+	{
+	public:
+		DepthWriter(void) = default;
+		~DepthWriter(void) { Close(); }
+
+		DepthWriter(const DepthWriter&) = delete;
+		DepthWriter& operator=(const DepthWriter&) = delete;
+
+		bool Open(const std::wstring& fileName, uint32_t width, uint32_t height);
+		bool Write(const float* depth, float zMagic, float fovTangent);
+		bool Close(void);
+
+		bool IsOpen(void) const { return m_File != nullptr; }
+		uint32_t GetFrameCount(void) const { return m_FrameCount; }
+		uint32_t GetWidth(void) const { return m_Width; }
+		uint32_t GetHeight(void) const { return m_Height; }
+
+	private:
+		FILE* m_File = nullptr;
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		uint32_t m_FrameCount = 0;
+		bool m_bFailed = false;
+	};
+
+	//===============================================================================
+	// A camera moving through a synthetic room of boxes and pillars, its depth drawn at native resolution and at each of the upscalers'
+	// internal resolutions. Every frame at every resolution goes through Processor and the reference, which have to agree to the bit, and the
+	// lower resolutions' AO, scaled back up, is measured against native
+
+	constexpr uint32_t kResolutionScales = 4;
+	extern const float kResolutionScale[kResolutionScales];		// DLSS's performance, balanced, quality and ultra performance, in that order
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Frames = 4;
+		uint32_t m_Width = 1280;
+		uint32_t m_Height = 720;
+		std::wstring m_CaptureFile;				// Run over these frames instead, if it loads. Lower resolutions are point sampled from them
+		Settings m_Settings;
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint32_t m_Workers = 0;
+		uint32_t m_FramesRun = 0;
+		bool m_bFromCapture = false;
+		double m_ProcessorMs = 0.0;				// Per frame, at native resolution
+		double m_ReferenceMs = 0.0;
+		double m_MeanError[kResolutionScales] = {};		// Mean absolute difference from native, once scaled back up
+		double m_BadPixels[kResolutionScales] = {};		// Fraction off by more than 0.1
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,112 @@
+#pragma once
+//===============================================================================
+// desc: Keeps a shadow map from one frame to the next and works out which part of it has to be drawn again. Casters are matched to last frame's
+//       by index, and one that has moved, or whose transform has changed at all, dirties the texels it covered and the ones it covers now. Any
+//       change to the light or the shadow camera dirties the whole map. One View per shadow map, so each cascade is kept or redrawn on its own.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ShadowCascades.h"
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ShadowCache
+{
+	// Dirty texels are rounded out to tiles this size, so a small move doesn't leave slivers either side
+	constexpr uint32_t kTileSize = 32;
+
+	// Everything that decides which texel a point lands in. If any of it changes, every texel is stale
+	struct ViewState
+	{
+		float m_LightDirection[3];
+		float m_Eye[3];						// World position of the shadow camera, after it's been snapped
+		float m_Bounds[3];					// As given to ShadowCamera::UpdateMatrix
+		uint32_t m_Width;
+		uint32_t m_Height;
+	};
+
+	// Texels, with right and bottom exclusive like a D3D12_RECT
+	struct Rect
+	{
+		uint32_t m_Left = 0;
+		uint32_t m_Top = 0;
+		uint32_t m_Right = 0;
+		uint32_t m_Bottom = 0;
+
+		bool IsEmpty(void) const { return m_Right <= m_Left || m_Bottom <= m_Top; }
+	};
+
+	struct FrameResult
+	{
+		bool m_bFullRedraw = false;
+		Rect m_DirtyRect;					// Empty when the map can be kept as it is
+		float m_DirtyView[4] = {};			// The dirty rect in shadow camera view space, as left, right, bottom and top, to cull casters against
+		uint32_t m_DirtyCasters = 0;
+		uint32_t m_CastersInView = 0;		// What drawing the whole map would draw
+		uint32_t m_CastersDrawn = 0;		// Those touching the dirty rect
+		uint32_t m_CastersSkipped = 0;
+	};
+
+	struct Stats
+	{
+		uint64_t m_Frames = 0;
+		uint64_t m_FullRedraws = 0;
+		uint64_t m_PartialRedraws = 0;
+		uint64_t m_CachedFrames = 0;		// Nothing drawn at all
+		uint64_t m_CastersDrawn = 0;
+		uint64_t m_CastersSkipped = 0;
+		uint32_t m_LastSkipped = 0;
+	};
+
+	class View
+	{
+	public:
+		// versions[i] has to change whenever caster i's transform does, so a caster turning in place, which leaves its sphere alone, is caught
+		FrameResult Update(const ViewState& state, const ShadowCascades::CasterBounds& casters, const std::vector<uint32_t>& versions);
+
+		// Whatever's in the map can't be trusted, e.g. something else drew into it or it was recreated
+		void Invalidate(void) { m_bValid = false; }
+
+		// Whether caster i, as last given to Update(), has to be drawn for the result Update() returned
+		bool IsDrawn(uint32_t i) const { return i < m_Drawn.size() && m_Drawn[i] != 0; }
+
+		const Stats& GetStats(void) const { return m_Stats; }
+
+	private:
+		bool m_bValid = false;
+		ViewState m_State = {};
+		ShadowCascades::LightBasis m_Basis = {};
+		float m_EyeLS[3] = {};
+
+		ShadowCascades::CasterBounds m_Casters;
+		std::vector<uint32_t> m_Versions;
+		std::vector<uint8_t> m_Drawn;
+
+		Stats m_Stats;
+	};
+
+	//===============================================================================
+	// Moves, turns and relights casters over a run of frames, keeping a small CPU stand-in for the shadow map both ways - redrawn in full every
+	// frame, and redrawn only where the cache says - and checks the two are identical every frame
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Frames = 600;
+		uint32_t m_Casters = 2000;
+		uint32_t m_MovingCasters = 4;		// Most a frame can move
+		uint32_t m_RelightInterval = 120;	// Frames between sun changes
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		Stats m_Stats;
+		double m_AverageInView = 0.0;
+		double m_AverageDrawn = 0.0;
+		double m_FullMs = 0.0;				// The stand-in drawn in full, per frame
+		double m_CachedMs = 0.0;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
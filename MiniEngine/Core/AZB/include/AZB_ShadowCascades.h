@@ -0,0 +1,123 @@
+#pragma once
+//===============================================================================
+// desc: Cascaded sun shadows. The view is split with the practical split scheme (a blend of logarithmic and uniform splits), each slice is
+//       wrapped in a sphere so its cascade keeps the same size however the camera turns, and ShadowCamera snaps each cascade to texels the way
+//       it always has. Casters are culled for every cascade at once, in one SIMD pass over their bounding spheres, against each cascade's box
+//       extruded back toward the sun.
+//       This is only the splitting and the culling. Nothing renders into a cascade yet - the sun shadow pass still draws one shadow map through
+//       one ShadowCamera, which the fixed cull box from MakeFixedCascade culls for, and the shaders sample it through SunShadowMatrix alone.
+//       Rendering a cascade array and picking a cascade per pixel in ModelViewerPS / Lighting.hlsli are still to do.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ShadowCascades
+{
+	constexpr uint32_t kMaxCascades = 4;
+
+	// Cull masks have a bit per box, so the cascades and anything to compare them with have to fit in 8
+	constexpr uint32_t kMaxCullBoxes = 8;
+
+	// The camera being shadowed. Half FOV tangents are 1 / the projection's X and Y scales
+	struct ViewDesc
+	{
+		float m_Position[3];
+		float m_Forward[3];
+		float m_TanHalfFovX;
+		float m_TanHalfFovY;
+		float m_Near;
+		float m_Far;
+	};
+
+	struct Settings
+	{
+		uint32_t m_Cascades = 4;
+		float m_Lambda = 0.8f;				// 0 is uniform splits, 1 logarithmic
+		float m_ShadowDistance = 4000.0f;	// Cascades stop here, or at the far plane if that's nearer
+		float m_Extrusion = 3000.0f;		// How far back toward the sun casters are still caught
+		uint32_t m_BufferSize = 2048;		// What ShadowCamera will be given, so the cull boxes can allow for its snapping
+		uint32_t m_BufferPrecision = 16;
+	};
+
+	// The ShadowCamera::UpdateMatrix arguments for one cascade, and the light space box its casters are culled against
+	struct Cascade
+	{
+		float m_SplitNear = 0.0f;			// View distances the cascade covers
+		float m_SplitFar = 0.0f;
+		float m_Center[3];					// World space, on the far bounding plane as UpdateMatrix wants it
+		float m_Bounds[3];					// Width, height and depth in world units
+		float m_CullMin[3];					// Light space, grown by a texel so snapping the center can't move the cascade outside it
+		float m_CullMax[3];
+	};
+
+	// The basis BaseCamera::SetLookDirection(lightDirection, Z) makes, so light space here is the shadow cameras' view space, without the translation
+	struct LightBasis
+	{
+		float m_Right[3];
+		float m_Up[3];
+		float m_Back[3];
+
+		void ToLightSpace(const float world[3], float light[3]) const;
+	};
+
+	LightBasis MakeLightBasis(const float lightDirection[3]);
+
+	// splits[0] is near and splits[count] far
+	void ComputeSplits(float nearDist, float farDist, uint32_t count, float lambda, float splits[kMaxCascades + 1]);
+
+	// Returns how many cascades were made. lightDirection is the way the light travels, as UpdateMatrix takes it
+	uint32_t FitCascades(const ViewDesc& view, const float lightDirection[3], const Settings& settings, Cascade cascades[kMaxCascades]);
+
+	// The single shadow camera everything renders with today, as a Cascade so it can be culled alongside the others
+	Cascade MakeFixedCascade(const float lightDirection[3], const float center[3], const float bounds[3], uint32_t bufferSize, uint32_t bufferPrecision);
+
+	//===============================================================================
+
+	// World space bounding spheres, structure of arrays so four can be loaded at once
+	struct CasterBounds
+	{
+		std::vector<float> m_X;
+		std::vector<float> m_Y;
+		std::vector<float> m_Z;
+		std::vector<float> m_Radius;
+
+		void Clear(void);
+		void Add(float x, float y, float z, float radius);
+		uint32_t GetCount(void) const { return (uint32_t)m_X.size(); }
+	};
+
+	// Bit c of masks[i] is set if caster i touches cull box c. Every box is tested for four casters before moving on to the next four
+	void CullCasters(const CasterBounds& casters, const LightBasis& basis, const Cascade* cascades, uint32_t cascadeCount, std::vector<uint8_t>& masks);
+
+	// A pass over every caster for each cascade in turn, in double precision, as a MeshSorter per cascade would go about it
+	void CullCastersReference(const CasterBounds& casters, const LightBasis& basis, const Cascade* cascades, uint32_t cascadeCount, std::vector<uint8_t>& masks);
+
+	// How many casters each box caught
+	void CountCasters(const std::vector<uint8_t>& masks, uint32_t cascadeCount, uint32_t counts[kMaxCullBoxes]);
+
+	//===============================================================================
+	// Casters scattered through a Sponza sized box, shadowed from a spread of views and sun directions. Compares the SIMD pass against the
+	// reference, checks every slice of the view lies within its cascade, and counts casters per cascade against today's single shadow camera
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Views = 64;
+		uint32_t m_Casters = 4096;
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint32_t m_Cascades = 0;
+		double m_AverageCasters[kMaxCascades] = {};
+		double m_AverageAnyCascade = 0.0;	// Casters at least one cascade wants
+		double m_AverageFixed = 0.0;		// Casters the single shadow camera takes
+		double m_SimdUs = 0.0;				// Per view, for all cascades
+		double m_ReferenceUs = 0.0;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
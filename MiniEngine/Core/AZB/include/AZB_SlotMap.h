@@ -0,0 +1,142 @@
+#pragma once
+//===============================================================================
+// desc: Generational handles over a fixed set of slots, for ParticleEffectManager. Any thread can reserve a slot and publish it without locking,
+//       and the owner drains everything published once a frame. Live slots are packed so removing one is a swap with the last, and a removed
+//       slot's generation moves on so old handles to it stop resolving, while the slot itself waits on a fence before it can be reused.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_PageRecycler.h"
+#include "AZB_TestHarness.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace SlotMap
+{
+	// Same thing LinearAllocatorPageManager recycles against
+	using IFence = PageRecycling::IFence;
+
+	// Slot in the low bits, generation above it
+	typedef uint32_t Handle;
+
+	constexpr uint32_t kSlotBits = 14;
+	constexpr uint32_t kGenerationBits = 32 - kSlotBits;
+	constexpr uint32_t kMaxSlots = (1u << kSlotBits) - 1;		// The last slot is never used, so no handle can come out as kInvalidHandle
+	constexpr Handle kInvalidHandle = 0xFFFFFFFF;
+
+	inline uint32_t GetSlot(Handle handle) { return handle & ((1u << kSlotBits) - 1); }
+	inline uint32_t GetGeneration(Handle handle) { return handle >> kSlotBits; }
+
+	struct Stats
+	{
+		uint64_t m_Reserved = 0;
+		uint64_t m_Rejected = 0;			// Reserve() found every slot taken
+		uint64_t m_Drained = 0;
+		uint64_t m_Despawned = 0;
+		uint64_t m_Recycled = 0;			// Despawned and past their fence, so free again
+		uint32_t m_PeakLive = 0;
+	};
+
+	// Reserve(), Publish() and IsValid() can be called from any thread. Everything else belongs to the one thread that owns the map
+	class Map
+	{
+	public:
+		// capacity is clamped to kMaxSlots
+		Map(IFence& fence, uint32_t capacity);
+
+		Map(const Map&) = delete;
+		Map& operator=(const Map&) = delete;
+
+		// A free slot for the caller to fill in, or kInvalidHandle if there isn't one. Drain() won't see it until it's passed to Publish()
+		Handle Reserve(void);
+		void Publish(Handle handle);
+
+		// Despawned slots whose fence has passed can be reserved again. They're checked oldest first, so the fence values given to Despawn() mustn't
+		// go backwards
+		void Recycle(void);
+
+		// Everything published since last time goes live, in the order it was published, and its slots are appended to drained
+		void Drain(std::vector<uint32_t>& drained);
+
+		// Takes a live slot out, moving the last live slot into liveIndex. Its handle stops being valid straight away, but the slot isn't reserved
+		// again until fenceValue has passed
+		void Despawn(uint32_t liveIndex, uint64_t fenceValue);
+
+		// Frees every slot at once, with handles to any of them left invalid. Only for when nothing is reserving and the GPU is done with them all
+		void Clear(void);
+
+		// Reserved and not yet despawned. Published or not
+		bool IsValid(Handle handle) const;
+
+		// Where a live handle sits among the live slots, or UINT32_MAX if it isn't live
+		uint32_t FindLive(Handle handle) const;
+
+		uint32_t GetLiveCount(void) const { return (uint32_t)m_Live.size(); }
+		uint32_t GetLiveSlot(uint32_t liveIndex) const { return m_Live[liveIndex]; }
+		Handle GetLiveHandle(uint32_t liveIndex) const;
+		uint32_t GetCapacity(void) const { return m_Capacity; }
+		Stats GetStats(void) const;
+
+	private:
+		enum SlotState { kFree, kReserved, kLive, kRetired };
+
+		// Generation above the state, so a handle can be checked with one load
+		static uint32_t MakeWord(uint32_t generation, SlotState state) { return (generation << 2) | (uint32_t)state; }
+
+		void PushFree(uint32_t slot);
+
+		IFence& m_Fence;
+		const uint32_t m_Capacity;
+
+		std::unique_ptr<std::atomic<uint32_t>[]> m_Words;
+		std::unique_ptr<std::atomic<uint32_t>[]> m_NextFree;
+		std::unique_ptr<std::atomic<uint32_t>[]> m_NextPublished;
+
+		// Tagged with a counter in the top 32 bits against ABA, as a slot can be reserved, recycled and freed again while someone else is
+		// looking at it. Published slots are only ever swapped out whole, so that list needs no tag
+		std::atomic<uint64_t> m_FreeHead;
+		std::atomic<uint32_t> m_PublishedHead;
+
+		// Owner only
+		std::vector<uint32_t> m_Live;
+		std::vector<uint32_t> m_LiveIndex;	// Per slot, where it sits in m_Live
+		std::deque<std::pair<uint64_t, uint32_t>> m_Retired;
+		std::vector<uint32_t> m_DrainScratch;
+
+		std::atomic<uint64_t> m_Reserved;
+		std::atomic<uint64_t> m_Rejected;
+		Stats m_OwnerStats;
+	};
+
+	//===============================================================================
+	// Threads spawning effects as fast as they're let, while a frame loop drains them, expires them when their lifetime is up and recycles slots
+	// against a simulated fence - then the same through a mutex-guarded vector of effects indexed by position, the way ParticleEffectManager used
+	// to work. Every handle a spawner was given has to resolve to its own effect for as long as it lives and to nothing afterwards
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Frames = 600;
+		uint32_t m_Threads = 4;
+		uint32_t m_SpawnsPerFrame = 64;		// Across every thread
+		uint32_t m_MaxLifeFrames = 90;
+		uint32_t m_FramesInFlight = 3;
+		uint32_t m_Capacity = 4096;
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		Stats m_Stats;
+		uint32_t m_FramesRun = 0;			// Past m_Frames if spawners fell behind, or effects were still alive
+		double m_SpawnsPerSecond = 0.0;
+		double m_SlotMapMs = 0.0;			// Whole run, less the checking
+		double m_VectorMs = 0.0;
+		uint64_t m_StaleChecks = 0;
+		uint64_t m_VectorMisdirected = 0;	// Lookups through the old handles that found someone else's effect
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,193 @@
+#pragma once
+//===============================================================================
+// desc: A two-level segregated fit (TLSF) sub-allocator for carving arbitrarily sized, long-lived buffers (vertex/index data, constants) out of one
+//       large heap, without the power-of-two rounding and 64KB floor of BuddyAllocator. Allocation and freeing are O(1), and it can plan moves that
+//       compact the heap. It only deals in offsets - what they're offsets into is up to the caller - so there are no D3D types here.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace TLSF
+{
+	constexpr uint32_t kInvalidAllocation = ~0u;
+
+	struct Stats
+	{
+		uint64_t m_HeapBytes = 0;
+		uint64_t m_UsedBytes = 0;			// Including rounding up to the granularity and any alignment padding kept with a block
+		uint64_t m_FreeBytes = 0;
+		uint64_t m_LargestFreeBlock = 0;
+		uint32_t m_Allocations = 0;
+		uint32_t m_FreeBlocks = 0;
+
+		// 0 when all the free space is in one block, approaching 1 as it's split into many small ones
+		float GetFragmentation(void) const { return m_FreeBytes ? 1.f - (float)((double)m_LargestFreeBlock / (double)m_FreeBytes) : 0.f; }
+	};
+
+	// One allocation to relocate. The source range has already been freed by the time Defragment() returns, so copy everything before allocating again
+	struct Move
+	{
+		uint32_t m_Allocation;		// Handle stays the same, only its offset changes
+		uint64_t m_SourceOffset;
+		uint64_t m_DestOffset;
+		uint64_t m_Size;
+	};
+
+	struct DefragmentDesc
+	{
+		uint32_t m_MaxMoves = ~0u;
+		uint64_t m_MaxBytes = ~0ull;	// Total size of what gets moved, to bound the copy cost
+	};
+
+	// Free blocks are binned first by power of two and then split linearly into 32 within it, with a bitmap at each level, so finding a block
+	// that fits is two bit scans. Blocks are split on allocation and merged with free neighbours on release. Single-threaded - lock around it if shared
+	class Allocator
+	{
+	public:
+		// granularity must be a power of two. Every size is rounded up to it, and it's the smallest alignment handed out
+		explicit Allocator(uint64_t heapBytes, uint32_t granularity = 16);
+
+		// alignment of 0 means the granularity, otherwise a power of two. Returns kInvalidAllocation if there's no room
+		uint32_t Allocate(uint64_t size, uint64_t alignment = 0);
+		void Free(uint32_t allocation);
+
+		// Frees everything. Outstanding handles become invalid
+		void Reset(void);
+
+		uint64_t GetOffset(uint32_t allocation) const { return m_Blocks[m_Handles[allocation]].m_Offset; }
+		uint64_t GetSize(uint32_t allocation) const { return m_Blocks[m_Handles[allocation]].m_Size; }
+		uint64_t GetHeapSize(void) const { return m_HeapBytes; }
+		Stats GetStats(void) const;
+
+		// Works down from the top of the heap, moving each allocation to a lower offset if one is free for it. Appends to moves (in the order
+		// the copies must happen) and returns how many were added
+		uint32_t Defragment(std::vector<Move>& moves, const DefragmentDesc& desc = DefragmentDesc());
+
+	private:
+		static constexpr uint32_t kSecondLevelLog2 = 5;
+		static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelLog2;
+		static constexpr uint32_t kFirstLevelCount = 64 - kSecondLevelLog2 + 1;
+		static constexpr uint32_t kNone = ~0u;
+
+		// Both free and allocated space. Records are recycled through m_NextFree once a block is merged away
+		struct Block
+		{
+			uint64_t m_Offset;
+			uint64_t m_Size;
+			uint32_t m_PrevPhysical;
+			uint32_t m_NextPhysical;
+			uint32_t m_PrevFree;		// Within its size class, while free
+			uint32_t m_NextFree;
+			uint32_t m_Handle;			// kNone while free
+			uint32_t m_AlignmentLog2;	// What it was allocated with, for Defragment()
+		};
+
+		// Sizes here are in units of the granularity
+		void Mapping(uint64_t units, uint32_t& firstLevel, uint32_t& secondLevel) const;
+		uint32_t FindFreeBlock(uint64_t units) const;
+
+		void InsertFree(uint32_t block);
+		void RemoveFree(uint32_t block);
+		uint32_t NewBlock(void);
+		void ReleaseBlock(uint32_t block);
+
+		// Splits the front of block off as a new block of size bytes and returns it. block keeps the rest
+		uint32_t SplitFront(uint32_t block, uint64_t size);
+		void FreeBlock(uint32_t block);
+
+		uint32_t NewHandle(uint32_t block);
+
+		std::vector<Block> m_Blocks;
+		uint32_t m_UnusedBlocks = kNone;	// Recycled records, chained through m_NextFree
+
+		std::vector<uint32_t> m_Handles;	// Handle to block. Unused handles are chained through their own entries
+		uint32_t m_UnusedHandles = kNone;
+
+		uint64_t m_FirstLevelMap = 0;
+		uint32_t m_SecondLevelMap[kFirstLevelCount] = {};
+		uint32_t m_FreeHeads[kFirstLevelCount][kSecondLevelCount];
+		uint32_t m_FreeBlockCount = 0;
+
+		uint64_t m_HeapBytes;
+		uint32_t m_GranularityLog2;
+		uint64_t m_UsedBytes = 0;
+		uint32_t m_Allocations = 0;
+	};
+
+	//===============================================================================
+	// Allocation traces, so real load patterns can be replayed offline. Recording is thread-safe and off until StartTrace()
+
+	enum eTraceEvent : uint16_t
+	{
+		TRACE_ALLOCATE,
+		TRACE_FREE
+	};
+
+	// 16 bytes, written to disk as it is after an "AZBA" | u32 version | u32 count header
+	struct TraceEvent
+	{
+		uint64_t m_Size;			// Unused for frees
+		uint32_t m_Id;
+		uint16_t m_AlignmentLog2;
+		uint16_t m_Type;			// eTraceEvent
+	};
+
+	void StartTrace(void);
+	bool IsTracing(void);
+
+	// Returns the id to pass to TraceFree(), or 0 if not tracing
+	uint32_t TraceAllocate(uint64_t size, uint64_t alignment);
+	void TraceFree(uint32_t id);
+
+	// Stops recording and writes out everything since StartTrace()
+	bool StopTrace(const std::wstring& fileName);
+
+	bool LoadTrace(const std::wstring& fileName, std::vector<TraceEvent>& events);
+
+	// A stand-in for when there's no captured trace: models of log-uniformly sized meshes loaded and unloaded at random
+	void GenerateSyntheticTrace(std::vector<TraceEvent>& events, uint32_t models, uint32_t seed);
+
+	//===============================================================================
+	// Replays a trace through TLSF and through a buddy allocator set up like BuddyAllocator's placed mode, both on a heap of the same size
+
+	struct BenchmarkDesc
+	{
+		std::wstring m_TraceFile;				// Empty, or unreadable, uses a synthetic trace
+		uint64_t m_HeapBytes = 512ull * 1024 * 1024;
+		uint32_t m_Granularity = 16;
+		uint32_t m_BuddyMinBlock = 64 * 1024;
+		uint32_t m_Iterations = 8;				// For timing. Anything still allocated at the end of the trace is freed before the next pass
+		uint32_t m_SyntheticModels = 400;
+		uint32_t m_Seed = 1;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint32_t m_Events = 0;
+		bool m_bSynthetic = false;
+
+		double m_TlsfNsPerOp = 0.0;
+		double m_BuddyNsPerOp = 0.0;
+
+		// At the point in the trace where the most is allocated
+		uint64_t m_PeakRequestedBytes = 0;
+		uint64_t m_TlsfPeakUsedBytes = 0;
+		uint64_t m_BuddyPeakUsedBytes = 0;
+
+		uint32_t m_TlsfFailures = 0;
+		uint32_t m_BuddyFailures = 0;
+
+		// TLSF fragmentation at its worst point in the trace, then after defragmenting there
+		float m_WorstFragmentation = 0.f;
+		float m_DefragmentedFragmentation = 0.f;
+		uint32_t m_DefragmentMoves = 0;
+		uint64_t m_DefragmentBytes = 0;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
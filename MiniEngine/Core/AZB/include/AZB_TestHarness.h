@@ -0,0 +1,30 @@
+#pragma once
+//===============================================================================
+// desc: What every module's benchmark or self test hands back on top of its own measurements - whether everything it checked held, and if not,
+//       how many checks failed and what the first one was. AZBTests runs them all by name and goes by this alone to pass or fail them.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include <cstdint>
+#include <string>
+
+namespace TestHarness
+{
+	struct Result
+	{
+		bool m_bValid = true;
+		uint32_t m_Checks = 0;
+		uint32_t m_Failures = 0;
+		std::string m_FirstFailure;
+
+		// Counts a check, and keeps what the first one to fail was about
+		void Check(bool bPassed, const char* what)
+		{
+			++m_Checks;
+			if (bPassed)
+				return;
+			if (m_Failures++ == 0)
+				m_FirstFailure = what;
+			m_bValid = false;
+		}
+	};
+}
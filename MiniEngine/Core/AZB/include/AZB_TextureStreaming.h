@@ -0,0 +1,133 @@
+#pragma once
+//===============================================================================
+// desc: Mip-level texture streaming policy. Textures start with only their coarse mips resident, the renderer reports which mip each one actually needs
+//       (from its on-screen size and the current LOD bias), and the residency manager decides what to stream in or out each frame under a memory budget.
+//       Nothing in here touches the GPU - the texture manager carries out the requests - so the policy can be driven and checked headless.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace TextureStreaming
+{
+	constexpr uint32_t kMaxMips = 16;
+	constexpr uint32_t kInvalidHandle = ~0u;
+
+	// The mip a texture of this size wants when it covers screenPixels across the screen, in the same terms as the sampler - lodBias is added as-is,
+	// so a negative DLSS bias asks for finer mips. Clamped at 0, not at the mip count
+	float EstimateMip(uint32_t width, uint32_t height, float screenPixels, float lodBias);
+
+	struct TextureDesc
+	{
+		uint32_t m_MipCount = 0;
+		uint64_t m_MipBytes[kMaxMips] = {};		// Size of each level, every array slice included
+		uint32_t m_BaseMip = 0;					// Always kept resident - streaming never evicts past this level
+	};
+
+	// Move a texture from one finest-resident mip to another. Lower is finer, so m_ToMip < m_FromMip streams in
+	struct StreamRequest
+	{
+		uint32_t m_Handle = kInvalidHandle;
+		uint32_t m_FromMip = 0;
+		uint32_t m_ToMip = 0;
+
+		bool IsLoad(void) const { return m_ToMip < m_FromMip; }
+	};
+
+	struct ResidencyStats
+	{
+		uint64_t m_BudgetBytes = 0;
+		uint64_t m_CommittedBytes = 0;		// Everything resident, plus loads in flight, less evictions in flight
+		uint64_t m_WantedBytes = 0;			// What this frame's requests would need with an unlimited budget
+		uint32_t m_Textures = 0;
+		uint32_t m_InFlight = 0;
+		uint32_t m_OverBudgetTextures = 0;	// Requested finer than the budget allowed on the last update
+	};
+
+	// Single-threaded - call everything from the thread that renders
+	class ResidencyManager
+	{
+	public:
+		explicit ResidencyManager(uint64_t budgetBytes = 1024ull * 1024 * 1024);
+
+		void SetBudget(uint64_t budgetBytes) { m_BudgetBytes = budgetBytes; }
+		uint64_t GetBudget(void) const { return m_BudgetBytes; }
+
+		// residentMip is whatever the texture was loaded with, normally desc.m_BaseMip
+		uint32_t Register(const TextureDesc& desc, uint32_t residentMip);
+
+		// Cancels any request in flight for it, giving back what it had committed. Drop that request's completion rather than passing it on, as
+		// the handle may already belong to another texture
+		void Unregister(uint32_t handle);
+
+		// Any number of times per frame - the finest request since the last Update() wins
+		void Request(uint32_t handle, float mip);
+
+		// Once per frame. Appends this frame's changes to requests - evictions first, then loads, most starved texture first - keeping at most
+		// maxInFlight outstanding in total. Textures nobody asked for since the last update are only evicted when something else needs the room
+		void Update(std::vector<StreamRequest>& requests, uint32_t maxInFlight = 8);
+
+		// A request from Update() has finished. Pass the mip that actually ended up resident, so a failed load just reverts
+		void OnStreamComplete(uint32_t handle, uint32_t residentMip);
+
+		uint32_t GetResidentMip(uint32_t handle) const { return m_Entries[handle].m_ResidentMip; }
+		uint32_t GetTargetMip(uint32_t handle) const { return m_Entries[handle].m_TargetMip; }
+		bool IsInFlight(uint32_t handle) const { return m_Entries[handle].m_bInFlight; }
+
+		ResidencyStats GetStats(void) const;
+
+	private:
+		struct Entry
+		{
+			TextureDesc m_Desc;
+			uint64_t m_BytesFrom[kMaxMips + 1];	// Size of the chain from each mip down to the smallest - m_BytesFrom[m_MipCount] is 0
+			uint32_t m_ResidentMip = 0;
+			uint32_t m_TargetMip = 0;			// Equal to m_ResidentMip unless a request is in flight
+			float m_RequestedMip = 0.f;
+			uint64_t m_LastRequestFrame = 0;
+			bool m_bInFlight = false;
+			bool m_bAlive = false;
+		};
+
+		// The level this frame's requests call for, clamped to [0, base]. Unrequested textures want their base mip
+		uint32_t GetWantedMip(const Entry& entry) const;
+
+		void Issue(uint32_t handle, uint32_t toMip, std::vector<StreamRequest>& requests);
+
+		std::vector<Entry> m_Entries;
+		std::vector<uint32_t> m_FreeHandles;
+
+		uint64_t m_BudgetBytes;
+		uint64_t m_CommittedBytes = 0;
+		uint64_t m_Frame = 1;
+		uint32_t m_InFlight = 0;
+		uint32_t m_LastOverBudget = 0;
+	};
+
+	//===============================================================================
+	// Textures asking for random mips frame after frame, with their streams finishing a few frames later, some failing and some cancelled by the
+	// texture going away mid-upload. Checks against its own bookkeeping that what's committed never goes over budget and never leaks, and that
+	// textures asked for most recently are the last to lose their mips
+
+	struct SelfTestDesc
+	{
+		uint32_t m_Frames = 5000;
+		uint32_t m_Textures = 96;
+		uint32_t m_MaxInFlight = 8;
+		uint64_t m_Seed = 11;
+	};
+
+	struct SelfTestResult : TestHarness::Result
+	{
+		uint64_t m_BudgetBytes = 0;
+		uint64_t m_PeakCommittedBytes = 0;
+		uint32_t m_Loads = 0;
+		uint32_t m_Evictions = 0;
+		uint32_t m_FailedLoads = 0;
+		uint32_t m_Cancels = 0;
+	};
+
+	SelfTestResult RunSelfTest(const SelfTestDesc& desc = SelfTestDesc());
+}
@@ -0,0 +1,79 @@
+#pragma once
+//===============================================================================
+// desc: Per-thread CPU profiling scopes for worker threads. Each thread builds its own private scope tree behind a thread-local stack, so the hot path never
+//       takes a lock or touches another thread's data. Completed scopes are handed to the profiler through a lock-free queue and merged on its thread.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace ThreadProfiler
+{
+	// One node per unique scope path on a thread. Nodes are never freed or moved, so a pointer stays valid for the life of the program. When a
+	// thread exits, its tree is handed on to the next thread that records a scope
+	struct ScopeNode
+	{
+		// Immutable once the node has been published
+		std::wstring m_Name;
+		ScopeNode* m_Parent = nullptr;			// Null for the thread's root
+		uint32_t m_ThreadIndex = 0;
+
+		// Owning thread only
+		std::unordered_map<std::wstring, ScopeNode*> m_Children;
+		int64_t m_StartTick = 0;
+		uint32_t m_TraceNameId = 0;
+
+		// Consumer thread only - free for the merging code to hang its own data off
+		void* m_pUserData = nullptr;
+	};
+
+	struct ScopeSample
+	{
+		ScopeNode* m_Node;
+		int64_t m_StartTick;
+		int64_t m_EndTick;
+	};
+
+	// Producer side. Called from any thread other than the consumer, always in matching pairs. Ticks are whatever clock the consumer expects
+	void BeginScope(const std::wstring& name, int64_t tick);
+	void EndScope(int64_t tick);
+
+	// Consumer side. Hands over every scope completed since the last drain, in completion order per thread (so children before their parents)
+	void Drain(const std::function<void(const ScopeSample&)>& onSample);
+
+	// Live threads that have recorded at least one scope
+	uint32_t GetThreadCount(void);
+
+	// Samples lost because a thread filled its queue between drains
+	uint64_t GetDroppedSampleCount(void);
+
+	//===============================================================================
+	// Stress test. Many producer threads open and close randomly nested scopes while a consumer drains them as it would once a frame. Every
+	// scope ended has to come out of a drain or be counted as dropped, every sample has to sit at the depth its scope was opened at, and each
+	// thread has to end up back at its root once its scopes are closed
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Threads = 32;
+		uint32_t m_ScopesPerThread = 100000;
+		uint32_t m_MaxDepth = 8;
+		uint32_t m_DrainIntervalUs = 50;	// How long the consumer sleeps between drains. Long enough and queues fill up, which is part of the test
+		uint64_t m_Seed = 7;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint64_t m_Produced = 0;		// Scopes ended by the producers
+		uint64_t m_Drained = 0;
+		uint64_t m_Dropped = 0;
+		uint32_t m_Drains = 0;
+		uint32_t m_DeepestSample = 0;
+		double m_NsPerScope = 0.0;		// Begin and end together, averaged over every producer
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
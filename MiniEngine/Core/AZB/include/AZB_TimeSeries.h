@@ -0,0 +1,213 @@
+#pragma once
+//===============================================================================
+// desc: Fixed-capacity time-series containers for performance history. Samples are published through a lock-free single-producer/single-consumer queue
+//       and drained once per frame into a mirrored history buffer, so the most recent window is always contiguous and can be handed straight to ImPlot.
+//       Rolling min/max/mean and percentiles are maintained on drain rather than recomputed by every reader.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace PerfHistory
+{
+	// Keep producer and consumer indices on separate cache lines so the two threads don't false-share
+	constexpr size_t kCacheLineSize = 64;
+
+	//
+	//	Lock-free single producer, single consumer queue
+	//
+
+	template <typename T, uint32_t Capacity>
+	class SpscRingBuffer
+	{
+		static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRingBuffer capacity must be a power of two");
+
+	public:
+		SpscRingBuffer() : m_Head(0), m_Tail(0) {}
+
+		// Producer thread only. Returns false (dropping the value) if the consumer has fallen a full buffer behind
+		bool Push(const T& value)
+		{
+			const uint32_t head = m_Head.load(std::memory_order_relaxed);
+			if (head - m_Tail.load(std::memory_order_acquire) >= Capacity)
+				return false;
+
+			m_Data[head & (Capacity - 1)] = value;
+			m_Head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer thread only
+		bool Pop(T& value)
+		{
+			const uint32_t tail = m_Tail.load(std::memory_order_relaxed);
+			if (tail == m_Head.load(std::memory_order_acquire))
+				return false;
+
+			value = m_Data[tail & (Capacity - 1)];
+			m_Tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Approximate when called from the producer, exact from the consumer
+		uint32_t Size(void) const { return m_Head.load(std::memory_order_acquire) - m_Tail.load(std::memory_order_acquire); }
+
+	private:
+		alignas(kCacheLineSize) std::atomic<uint32_t> m_Head;	// Written by the producer
+		alignas(kCacheLineSize) std::atomic<uint32_t> m_Tail;	// Written by the consumer
+		alignas(kCacheLineSize) T m_Data[Capacity];
+	};
+
+	//
+	//	Rolling time-series
+	//
+
+	// HistorySize is the plotted window, QueueSize is how many samples can be in flight between two calls to Update()
+	template <uint32_t HistorySize, uint32_t QueueSize = 1024>
+	class TimeSeries
+	{
+		static_assert(HistorySize > 0, "TimeSeries needs room for at least one sample");
+
+	public:
+		TimeSeries() { Reset(); }
+
+		// Producer side, lock-free. Safe to call from one thread other than the consumer
+		bool Publish(float value) { return m_Incoming.Push(value); }
+
+		// Consumer side. Drains everything published so far into the history and refreshes the rolling stats. Returns the number of new samples.
+		uint32_t Update(void)
+		{
+			uint32_t added = 0;
+			float value;
+			while (m_Incoming.Pop(value))
+			{
+				Append(value);
+				++added;
+			}
+
+			if (added > 0)
+				RefreshPercentiles();
+			return added;
+		}
+
+		// Consumer side only. Forget all history (anything still queued will arrive on the next Update)
+		void Reset(void)
+		{
+			m_Next = 0;
+			m_Count = 0;
+			m_Sequence = 0;
+			m_Sum = 0.0;
+			m_MinHead = m_MinTail = 0;
+			m_MaxHead = m_MaxTail = 0;
+			m_P50 = m_P95 = m_P99 = 0.f;
+		}
+
+		// The current window, oldest sample first. Always contiguous thanks to the mirrored storage - pass straight to ImPlot::PlotLine(label, GetData(), GetCount())
+		const float* GetData(void) const { return &m_History[m_Next + HistorySize - m_Count]; }
+		uint32_t GetCount(void) const { return m_Count; }
+		static constexpr uint32_t GetCapacity(void) { return HistorySize; }
+
+		float GetLast(void) const { return m_Count > 0 ? m_History[m_Next + HistorySize - 1] : 0.f; }
+		float GetMin(void) const { return m_Count > 0 ? m_MinValues[m_MinHead % HistorySize] : 0.f; }
+		float GetMax(void) const { return m_Count > 0 ? m_MaxValues[m_MaxHead % HistorySize] : 0.f; }
+		float GetMean(void) const { return m_Count > 0 ? (float)(m_Sum / m_Count) : 0.f; }
+
+		// Refreshed once per Update() rather than on every query
+		float GetP50(void) const { return m_P50; }
+		float GetP95(void) const { return m_P95; }
+		float GetP99(void) const { return m_P99; }
+
+	private:
+		void Append(float value)
+		{
+			// Drop the oldest sample from the running sum and the sorted window once the window is full
+			if (m_Count == HistorySize)
+			{
+				m_Sum -= m_History[m_Next];
+				ReplaceSorted(m_History[m_Next], value);
+			}
+			else
+				InsertSorted(value);
+
+			// Mirror every sample into both halves so any window of HistorySize samples is contiguous
+			m_History[m_Next] = value;
+			m_History[m_Next + HistorySize] = value;
+			m_Next = (m_Next + 1) % HistorySize;
+			m_Sum += value;
+
+			// Monotonic queues give O(1) amortised rolling min/max. Expire anything that has slid out of the window first
+			const uint64_t oldest = m_Sequence + 1 > HistorySize ? m_Sequence + 1 - HistorySize : 0;
+			while (m_MinHead != m_MinTail && m_MinSequence[m_MinHead % HistorySize] < oldest) ++m_MinHead;
+			while (m_MaxHead != m_MaxTail && m_MaxSequence[m_MaxHead % HistorySize] < oldest) ++m_MaxHead;
+
+			while (m_MinHead != m_MinTail && m_MinValues[(m_MinTail - 1) % HistorySize] >= value) --m_MinTail;
+			while (m_MaxHead != m_MaxTail && m_MaxValues[(m_MaxTail - 1) % HistorySize] <= value) --m_MaxTail;
+
+			m_MinValues[m_MinTail % HistorySize] = value;
+			m_MinSequence[m_MinTail % HistorySize] = m_Sequence;
+			++m_MinTail;
+			m_MaxValues[m_MaxTail % HistorySize] = value;
+			m_MaxSequence[m_MaxTail % HistorySize] = m_Sequence;
+			++m_MaxTail;
+
+			++m_Sequence;
+		}
+
+		// m_Sorted follows the window as it slides, a binary search and a shift of whatever lies between the old and new places at a time,
+		// rather than the whole window being copied and sorted on every Update()
+		void InsertSorted(float value)
+		{
+			float* end = m_Sorted + m_Count;
+			float* at = std::upper_bound(m_Sorted, end, value);
+			std::copy_backward(at, end, end + 1);
+			*at = value;
+			++m_Count;
+		}
+
+		void ReplaceSorted(float evicted, float value)
+		{
+			float* end = m_Sorted + m_Count;
+			float* from = std::lower_bound(m_Sorted, end, evicted);
+			float* to;
+			if (value >= evicted)
+			{
+				to = std::upper_bound(from, end, value) - 1;
+				std::copy(from + 1, to + 1, from);
+			}
+			else
+			{
+				to = std::upper_bound(m_Sorted, from, value);
+				std::copy_backward(to, from, from + 1);
+			}
+			*to = value;
+		}
+
+		void RefreshPercentiles(void)
+		{
+			auto percentile = [this](float p) { return m_Sorted[(uint32_t)(p * (float)(m_Count - 1) + 0.5f)]; };
+			m_P50 = percentile(0.50f);
+			m_P95 = percentile(0.95f);
+			m_P99 = percentile(0.99f);
+		}
+
+		SpscRingBuffer<float, QueueSize> m_Incoming;
+
+		// Consumer-owned state below here
+		float m_History[HistorySize * 2];
+		float m_Sorted[HistorySize];		// The window in ascending order
+		uint32_t m_Next;
+		uint32_t m_Count;
+		uint64_t m_Sequence;
+		double m_Sum;
+
+		float m_MinValues[HistorySize];
+		uint64_t m_MinSequence[HistorySize];
+		uint64_t m_MinHead, m_MinTail;
+		float m_MaxValues[HistorySize];
+		uint64_t m_MaxSequence[HistorySize];
+		uint64_t m_MaxHead, m_MaxTail;
+
+		float m_P50, m_P95, m_P99;
+	};
+}
@@ -0,0 +1,225 @@
+#pragma once
+//===============================================================================
+// desc: A CPU implementation of PostEffects::ProcessHDR - bloom extract and luma, the bloom downsample and blur chain, tone mapping, the luma
+//       histogram and exposure adaptation - doing the same math as the shaders, in the same order, through the same buffer formats. It runs
+//       over HDR frames captured from the engine, so exposure can be adapted, frozen or replayed from another run without a GPU in the loop,
+//       and two upscalers can be compared with the exposure differences between them taken out.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_WorkerPool.h"
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ToneMapReference
+{
+	constexpr uint32_t kHistogramBins = 256;
+
+	// The log luminance range g_Exposure starts out with, as in PostEffects.cpp
+	constexpr float kInitialMinLog = -12.0f;
+	constexpr float kInitialMaxLog = 4.0f;
+
+	// Every colour buffer in the chain is R11G11B10_FLOAT, so everything written to one goes through these. Rounds to nearest even, with
+	// negatives and NaN going to 0 and anything too big to the largest finite value
+	uint32_t PackR11G11B10(const float rgb[3]);
+	void UnpackR11G11B10(uint32_t packed, float rgb[3]);
+
+	// Three floats per pixel, rows top to bottom
+	struct Image
+	{
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		std::vector<float> m_RGB;
+
+		void Resize(uint32_t width, uint32_t height) { m_Width = width; m_Height = height; m_RGB.assign((size_t)width * height * 3, 0.0f); }
+		float* GetPixel(uint32_t x, uint32_t y) { return &m_RGB[((size_t)y * m_Width + x) * 3]; }
+		const float* GetPixel(uint32_t x, uint32_t y) const { return &m_RGB[((size_t)y * m_Width + x) * 3]; }
+	};
+
+	// The bloom buffers BufferManager makes for a scene buffer of this size
+	void GetBloomSize(uint32_t sceneWidth, uint32_t sceneHeight, uint32_t& bloomWidth, uint32_t& bloomHeight);
+
+	// The PostEffects and display settings ProcessHDR reads. Defaults are the same as the engine's
+	struct Settings
+	{
+		bool m_bEnableAdaptation = true;
+		float m_Exposure = 2.0f;				// Where exposure starts, and stays with adaptation off
+		float m_MinExposure = 1.0f / 64.0f;
+		float m_MaxExposure = 64.0f;
+		float m_TargetLuminance = 0.08f;
+		float m_AdaptationRate = 0.05f;
+
+		bool m_bEnableBloom = true;
+		bool m_bHighQualityBloom = true;
+		float m_BloomThreshold = 4.0f;
+		float m_BloomStrength = 0.1f;
+		float m_BloomUpsampleFactor = 0.65f;
+
+		bool m_bHDROutput = false;				// ToneMapHDRCS rather than ToneMapCS
+		float m_HDRPaperWhite = 200.0f;
+		float m_MaxDisplayLuminance = 1000.0f;
+
+		// Exposure is left as it's given rather than adapted. The luma and histogram are still made, so they can be compared
+		bool m_bFreezeExposure = false;
+	};
+
+	// g_Exposure: exposure, 1 / exposure, exposure, the histogram average, then min log, max log, log range and 1 / log range
+	struct ExposureState
+	{
+		float m_Values[8];
+
+		static ExposureState Initial(float exposure);
+		float GetExposure(void) const { return m_Values[0]; }
+	};
+
+	// AdaptExposureCS, down to the order its 256 threads add the histogram up in
+	void AdaptExposure(const uint32_t histogram[kHistogramBins], uint32_t pixelCount, const Settings& settings, ExposureState& exposure);
+
+	struct FrameResult
+	{
+		Image m_Output;							// What tone mapping wrote back over the scene
+		std::vector<uint8_t> m_Luma;			// g_LumaBuffer
+		std::vector<uint8_t> m_LumaLR;			// At the bloom size
+		uint32_t m_Histogram[kHistogramBins];
+		Image m_Bloom;							// The blurred bloom that was added in, or empty with bloom off
+		ExposureState m_Exposure;				// What the frame was tone mapped with, before adaptation moved it on
+	};
+
+	// Tiles of each pass are shared between a few worker threads, with every pass finishing before the next starts, the way dispatches do.
+	// Intermediate buffers are kept between frames, so frames of the same size don't allocate
+	class Processor
+	{
+	public:
+		// 0 picks one less than the hardware has, leaving the calling thread to do its share
+		explicit Processor(uint32_t workerThreads = 0);
+
+		Processor(const Processor&) = delete;
+		Processor& operator=(const Processor&) = delete;
+
+		// ProcessHDR on one frame, tone mapping with exposure and then adapting it for the next frame
+		void ProcessFrame(const Image& hdr, const Settings& settings, ExposureState& exposure, FrameResult& result);
+
+		uint32_t GetWorkerCount(void) const { return m_Pool.GetWorkerCount(); }
+
+	private:
+		enum Phase { kExtractPhase, kDownsamplePhase, kBlurLoadPhase, kBlurHorizontalPhase, kBlurVerticalPhase, kToneMapPhase };
+
+		void Blur(Image& higher, const Image* lower, float upsampleBlendFactor, Image& output);
+
+		void Run(Phase phase, uint32_t jobCount);
+		void ProcessJob(uint32_t job);
+
+		// Only valid during ProcessFrame()
+		const Image* m_Scene = nullptr;
+		const Settings* m_Settings = nullptr;
+		ExposureState m_Exposure;
+		FrameResult* m_Result = nullptr;
+		uint32_t m_TilesX = 0;
+
+		// The bloom buffers, a and b for each of the five sizes
+		Image m_BloomBuffers[5][2];
+
+		// The blur pass under way, and what it keeps between its three phases
+		const Image* m_BlurHigher = nullptr;
+		const Image* m_BlurLower = nullptr;
+		float m_BlurFactor = 0.0f;
+		Image* m_BlurOutput = nullptr;
+		Image m_BlurInput;
+		Image m_BlurHorizontal;
+
+		std::vector<uint32_t> m_TileHistograms;		// kHistogramBins per extract job
+
+		Phase m_Phase = kExtractPhase;
+
+		WorkerPool::Pool m_Pool;
+	};
+
+	// The same frame one thread group at a time, each group following its shader line for line, LDS included. Slow, but there to check
+	// Processor against
+	void ProcessFrameReference(const Image& hdr, const Settings& settings, ExposureState& exposure, FrameResult& result);
+
+	//===============================================================================
+	// Captured frames are kept as the texels of the buffer post effects was given, one word a pixel, so they go through the chain exactly as
+	// they came off the GPU. That's the scene buffer's R11G11B10_FLOAT, or R10G10B10A2_UNORM when DLSS has written its output
+
+	enum FrameFormat : uint32_t { kFrameFormatR11G11B10Float, kFrameFormatR10G10B10A2Unorm, kFrameFormatCount };
+
+	struct FrameSequence
+	{
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		FrameFormat m_Format = kFrameFormatR11G11B10Float;
+		std::vector<std::vector<uint32_t>> m_Frames;
+	};
+
+	void PackFrame(const Image& image, std::vector<uint32_t>& packed);
+	void UnpackFrame(const std::vector<uint32_t>& packed, uint32_t width, uint32_t height, Image& image, FrameFormat format = kFrameFormatR11G11B10Float);
+
+	bool LoadFrames(const std::wstring& fileName, FrameSequence& sequence);
+
+	// Writes frames as they come, so a capture doesn't have to be held in memory. The count in the header is filled in by Close()
+	class FrameWriter
+	{
+	public:
+		FrameWriter(void) = default;
+		~FrameWriter(void) { Close(); }
+
+		FrameWriter(const FrameWriter&) = delete;
+		FrameWriter& operator=(const FrameWriter&) = delete;
+
+		bool Open(const std::wstring& fileName, uint32_t width, uint32_t height, FrameFormat format = kFrameFormatR11G11B10Float);
+		bool Write(const uint32_t* packed);
+		bool Close(void);
+
+		bool IsOpen(void) const { return m_File != nullptr; }
+		uint32_t GetFrameCount(void) const { return m_FrameCount; }
+		uint32_t GetWidth(void) const { return m_Width; }
+		uint32_t GetHeight(void) const { return m_Height; }
+		FrameFormat GetFormat(void) const { return m_Format; }
+
+	private:
+		FILE* m_File = nullptr;
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+		FrameFormat m_Format = kFrameFormatR11G11B10Float;
+		uint32_t m_FrameCount = 0;
+		bool m_bFailed = false;
+	};
+
+	//===============================================================================
+	// A camera panning over a synthetic HDR scene, rendered at full resolution and at a lower one upscaled back. Every frame of both goes through
+	// Processor and the reference, which have to agree to the bit. Each run's exposures are recorded, then one run is processed again with the
+	// other's exposures replayed, which has to reproduce its exposures exactly and shows how much of the difference was exposure
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Frames = 60;
+		uint32_t m_Width = 1280;
+		uint32_t m_Height = 720;
+		float m_LowResolutionScale = 0.5f;		// Of the second run, before it's upscaled back
+		std::wstring m_CaptureFile;				// Run over these frames instead, if it loads. They're the full resolution run
+		std::wstring m_UpscaledCaptureFile;		// With a capture, the same path captured through an upscaler such as DLSS. If it loads at the
+												// capture's size it's the second run, rather than the capture resampled down and back up
+		Settings m_Settings;
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		uint32_t m_Workers = 0;
+		uint32_t m_FramesRun = 0;
+		bool m_bFromCapture = false;
+		bool m_bUpscaledFromCapture = false;
+		uint32_t m_CaptureFrames = 0;			// However many the capture held, of which m_FramesRun were used
+		double m_ProcessorMs = 0.0;				// Per frame
+		double m_ReferenceMs = 0.0;
+		float m_MaxExposureDivergence = 0.0f;	// Largest log2 ratio between the two runs' adapted exposures
+		double m_AdaptedOutputError = 0.0;		// Mean absolute difference of the tone mapped outputs, each adapting
+		double m_ReplayedOutputError = 0.0;		// The same, with the low resolution run on the other's exposures
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,87 @@
+#pragma once
+//===============================================================================
+// desc: A streaming timeline exporter for the engine profiler. Every timed scope is recorded into a lock-free buffer owned by the thread that ran it,
+//       and a background thread drains those buffers to disk as either Chrome trace JSON (chrome://tracing, ui.perfetto.dev) or a compact binary stream.
+//       Timestamps are raw ticks from whatever clock the caller uses - they only get converted when written out, keeping the hot path to a single push.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+   Compact binary layout (all little-endian, no padding):
+
+   Header:   char[4] "AZBT" | u32 version | f64 ticksPerSecond | i64 baseTick
+   Records:  u8 kind followed by
+             kind 0 (name):   u32 nameId | u16 byteLength | utf8 bytes
+             kind 1 (thread): u32 threadId | u16 byteLength | utf8 bytes
+             kind 2 (scope):  u8 track | u32 threadId | u32 nameId | i64 startTick | i64 endTick
+
+   Names and threads are always written before the first scope that refers to them.
+*/
+
+namespace Trace
+{
+	enum eFormat : uint8_t
+	{
+		CHROME_JSON,
+		BINARY
+	};
+
+	// CPU scopes are shown per recording thread, GPU scopes on a single queue track
+	enum eTrack : uint8_t
+	{
+		TRACK_CPU,
+		TRACK_GPU
+	};
+
+	// Begin writing to a new file. baseTick becomes time zero and ticksPerSecond converts everything recorded afterwards. Returns false if already capturing or the file can't be opened.
+	bool Start(const std::string& fileName, eFormat format, int64_t baseTick, double ticksPerSecond);
+
+	// Flush everything outstanding, finish the file and join the writer thread. Safe to call when not capturing
+	void Stop(void);
+
+	// Register a scope name once up front and refer to it by id afterwards. Ids are never 0, so callers can use 0 to mean "not registered yet"
+	uint32_t RegisterName(const std::wstring& name);
+
+	// Hot path - lock-free, no allocation after the calling thread's first event. Events are dropped (and counted) if the writer falls too far behind
+	void RecordScope(eTrack track, uint32_t nameId, int64_t startTick, int64_t endTick);
+
+	// Events lost to full buffers since Start()
+	uint64_t GetDroppedEventCount(void);
+
+	namespace Internal
+	{
+		extern std::atomic<bool> s_bCapturing;
+	}
+
+	// Cheap enough to check before every scope
+	inline bool IsCapturing(void) { return Internal::s_bCapturing.load(std::memory_order_relaxed); }
+
+	//===============================================================================
+	// What a profiled scope costs the thread that runs it - a tick read at each end, the capture check, and the push when capturing - with
+	// capture off and then on. Scopes come in bursts of about a busy frame's worth with the writer left to catch up in between, as it would in
+	// the engine, and only the bursts are timed. Either average going over budget fails it
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Bursts = 200;
+		uint32_t m_ScopesPerBurst = 2048;		// Well inside a thread's buffer, so nothing should be dropped
+		double m_BudgetNs = 50.0;
+		std::string m_TraceFile = "TraceBenchmark.azbt";	// Written while capturing and deleted afterwards
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		double m_TickNs = 0.0;				// One tick read on its own. A scope makes two
+		double m_DisabledNs = 0.0;			// Per scope, begin and end together
+		double m_EnabledNs = 0.0;
+		uint64_t m_Scopes = 0;				// Per pass
+		uint64_t m_Dropped = 0;				// While capturing
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
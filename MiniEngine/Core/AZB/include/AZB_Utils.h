@@ -7,12 +7,16 @@
 // A macro to clearly identify my contributions to the starting code
 #define AZB_MOD 1	// Change to 0 to exclude my modifications and run unmodified sample code
 #define AZB_DBG 0	// Another flag for me to quickly test and debug certain GUI functions and more!
-#include "dxgiformat.h"
 #include "stdint.h"
 
+// Some of my helper modules (e.g. the benchmark runner) are platform-neutral so they can be tested off Windows. Keep DXGI out of their way!
+#if defined(_WIN32)
+#include "dxgiformat.h"
+
 // This is defined in Display.cpp
 constexpr int SWAP_CHAIN_BUFFER_COUNT = 3;
 constexpr DXGI_FORMAT SWAP_CHAIN_FORMAT = DXGI_FORMAT_R10G10B10A2_UNORM;
+#endif
 
 
 // Set in GameCore.cpp
@@ -0,0 +1,62 @@
+#pragma once
+//===============================================================================
+// desc: A few worker threads kept around between runs, for CPU work that happens every frame or in passes like a chain of dispatches. Run()
+//       shares jobs out between the workers and the calling thread and only returns once every job has finished, so each pass can read
+//       whatever the one before it wrote.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace WorkerPool
+{
+	class Pool
+	{
+	public:
+		// 0 picks one less than the hardware has, up to 7, leaving the calling thread to do its share
+		explicit Pool(uint32_t workerThreads = 0);
+		~Pool(void);
+
+		Pool(const Pool&) = delete;
+		Pool& operator=(const Pool&) = delete;
+
+		// Calls job(index) once for every index below jobCount, in no particular order. With no workers, or only one job, it all happens on the
+		// calling thread. One Run() at a time, and a job mustn't Run() the pool it's on
+		template <typename JobFunction>
+		void Run(uint32_t jobCount, const JobFunction& job)
+		{
+			RunJobs(jobCount, &CallJob<JobFunction>, &job);
+		}
+
+		uint32_t GetWorkerCount(void) const { return (uint32_t)m_Workers.size(); }
+
+	private:
+		typedef void (*JobCallback)(const void* context, uint32_t job);
+
+		// A plain function pointer rather than std::function, so a run doesn't allocate
+		template <typename JobFunction>
+		static void CallJob(const void* context, uint32_t job) { (*static_cast<const JobFunction*>(context))(job); }
+
+		void RunJobs(uint32_t jobCount, JobCallback callback, const void* context);
+		void WorkerLoop(void);
+		void ProcessJobs(void);
+
+		// Only valid during RunJobs()
+		JobCallback m_Callback = nullptr;
+		const void* m_Context = nullptr;
+		uint32_t m_JobCount = 0;
+		std::atomic<uint32_t> m_NextJob;
+
+		std::vector<std::thread> m_Workers;
+		std::mutex m_Mutex;
+		std::condition_variable m_WorkReady;
+		std::condition_variable m_WorkDone;
+		uint64_t m_Generation = 0;
+		uint32_t m_BusyWorkers = 0;
+		bool m_bQuit = false;
+	};
+}
@@ -0,0 +1,249 @@
+//===============================================================================
+// desc: A staged asynchronous loading pipeline. File I/O runs on a small reader pool, CPU-side parsing on a worker pool, and GPU object creation/upload
+//       on a single submitter thread that batches whatever is ready.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_AsyncLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+//===============================================================================
+//
+// Queue
+//
+
+void AsyncLoad::Pipeline::Queue::Push(const RequestPtr& request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Items.push_back(request);
+	}
+	m_Ready.notify_one();
+}
+
+bool AsyncLoad::Pipeline::Queue::Pop(RequestPtr& request)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Ready.wait(lock, [this] { return !m_Items.empty() || m_bClosed; });
+	if (m_Items.empty())
+		return false;
+
+	request = std::move(m_Items.front());
+	m_Items.pop_front();
+	return true;
+}
+
+bool AsyncLoad::Pipeline::Queue::TryPop(RequestPtr& request)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_Items.empty())
+		return false;
+
+	request = std::move(m_Items.front());
+	m_Items.pop_front();
+	return true;
+}
+
+void AsyncLoad::Pipeline::Queue::Close(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bClosed = true;
+	}
+	m_Ready.notify_all();
+}
+
+//===============================================================================
+//
+// Pipeline
+//
+
+AsyncLoad::Pipeline::Pipeline(Sink& sink, const PipelineDesc& desc) : m_Sink(sink), m_Desc(desc)
+{
+	// Leave a core for the main thread and one for the submitter
+	if (m_Desc.m_WorkerThreads == 0)
+		m_Desc.m_WorkerThreads = std::max(1u, std::thread::hardware_concurrency() - std::min(2u, std::thread::hardware_concurrency()));
+	m_Desc.m_ReaderThreads = std::max(1u, m_Desc.m_ReaderThreads);
+	m_Desc.m_MaxBatchRequests = std::max(1u, m_Desc.m_MaxBatchRequests);
+
+	for (uint32_t i = 0; i < m_Desc.m_ReaderThreads; ++i)
+		m_Readers.emplace_back(&Pipeline::ReaderLoop, this);
+	for (uint32_t i = 0; i < m_Desc.m_WorkerThreads; ++i)
+		m_Workers.emplace_back(&Pipeline::WorkerLoop, this);
+	m_Submitter = std::thread(&Pipeline::SubmitterLoop, this);
+}
+
+AsyncLoad::Pipeline::~Pipeline()
+{
+	Flush();
+
+	// Everything is idle now, so each stage can be shut down in turn
+	m_ReadQueue.Close();
+	for (std::thread& thread : m_Readers)
+		thread.join();
+
+	m_PrepareQueue.Close();
+	for (std::thread& thread : m_Workers)
+		thread.join();
+
+	m_SubmitQueue.Close();
+	m_Submitter.join();
+}
+
+void AsyncLoad::Pipeline::Enqueue(const RequestPtr& request)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_PendingMutex);
+		++m_Pending;
+	}
+	m_ReadQueue.Push(request);
+}
+
+void AsyncLoad::Pipeline::Flush(void)
+{
+	std::unique_lock<std::mutex> lock(m_PendingMutex);
+	m_PendingDone.wait(lock, [this] { return m_Pending == 0; });
+}
+
+void AsyncLoad::Pipeline::ReaderLoop(void)
+{
+	RequestPtr request;
+	while (m_ReadQueue.Pop(request))
+	{
+		m_Sink.Read(*request);
+		m_PrepareQueue.Push(request);
+		request.reset();
+	}
+}
+
+void AsyncLoad::Pipeline::WorkerLoop(void)
+{
+	RequestPtr request;
+	while (m_PrepareQueue.Pop(request))
+	{
+		m_Sink.Prepare(*request);
+		m_SubmitQueue.Push(request);
+		request.reset();
+	}
+}
+
+void AsyncLoad::Pipeline::SubmitterLoop(void)
+{
+	std::vector<RequestPtr> batch;
+	RequestPtr request;
+
+	// Block for the first request, then sweep up whatever else is ready without waiting
+	while (m_SubmitQueue.Pop(request))
+	{
+		size_t batchBytes = request->m_UploadBytes;
+		batch.push_back(std::move(request));
+
+		while (batch.size() < m_Desc.m_MaxBatchRequests && batchBytes < m_Desc.m_MaxBatchBytes && m_SubmitQueue.TryPop(request))
+		{
+			batchBytes += request->m_UploadBytes;
+			batch.push_back(std::move(request));
+		}
+
+		m_Sink.Submit(batch);
+
+		for (RequestPtr& done : batch)
+			done->m_Promise.set_value();
+
+		{
+			std::lock_guard<std::mutex> lock(m_PendingMutex);
+			m_Pending -= batch.size();
+		}
+		m_PendingDone.notify_all();
+		batch.clear();
+	}
+}
+
+//===============================================================================
+//
+// Benchmark
+//
+
+namespace
+{
+	typedef std::chrono::steady_clock BenchmarkClock;
+
+	// Busy-wait so the parse stage actually occupies a core, unlike a sleep
+	void BurnMicroseconds(uint32_t microseconds)
+	{
+		const BenchmarkClock::time_point end = BenchmarkClock::now() + std::chrono::microseconds(microseconds);
+		while (BenchmarkClock::now() < end) {}
+	}
+
+	void SleepMicroseconds(uint32_t microseconds)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(microseconds));
+	}
+
+	double MillisecondsSince(BenchmarkClock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+	}
+
+	class FakeSink : public AsyncLoad::Sink
+	{
+	public:
+		explicit FakeSink(const AsyncLoad::BenchmarkDesc& desc) : m_Desc(desc) {}
+
+		virtual void Read(AsyncLoad::Request&) override
+		{
+			SleepMicroseconds(m_Desc.m_ReadMicroseconds);
+		}
+
+		virtual void Prepare(AsyncLoad::Request& request) override
+		{
+			BurnMicroseconds(m_Desc.m_ParseMicroseconds);
+			request.m_UploadBytes = m_Desc.m_BytesPerRequest;
+		}
+
+		virtual void Submit(const std::vector<AsyncLoad::RequestPtr>& batch) override
+		{
+			SleepMicroseconds(m_Desc.m_SubmitMicroseconds + m_Desc.m_UploadMicrosecondsPerRequest * (uint32_t)batch.size());
+			m_Batches.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		uint32_t GetBatchCount(void) const { return m_Batches.load(std::memory_order_relaxed); }
+
+	private:
+		const AsyncLoad::BenchmarkDesc& m_Desc;
+		std::atomic<uint32_t> m_Batches{ 0 };
+	};
+}
+
+AsyncLoad::BenchmarkResult AsyncLoad::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+	FakeSink sink(desc);
+
+	// The old path - read, parse, create and wait for the upload, one request after another on the calling thread
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	for (uint32_t i = 0; i < desc.m_Requests; ++i)
+	{
+		RequestPtr request = std::make_shared<Request>();
+		sink.Read(*request);
+		sink.Prepare(*request);
+		sink.Submit({ request });
+	}
+	result.m_SerialMs = MillisecondsSince(start);
+
+	const uint32_t serialBatches = sink.GetBatchCount();
+
+	start = BenchmarkClock::now();
+	{
+		Pipeline pipeline(sink, desc.m_Pipeline);
+		for (uint32_t i = 0; i < desc.m_Requests; ++i)
+			pipeline.Enqueue(std::make_shared<Request>());
+		pipeline.Flush();
+	}
+	result.m_PipelinedMs = MillisecondsSince(start);
+
+	result.m_Batches = sink.GetBatchCount() - serialBatches;
+	result.m_AverageBatchSize = result.m_Batches > 0 ? (float)desc.m_Requests / (float)result.m_Batches : 0.f;
+	return result;
+}
@@ -0,0 +1,933 @@
+//===============================================================================
+// desc: A portable block compressor for BC1, BC3, BC4, BC5 and BC7. Images are split into rows of blocks and encoded across every core, with the
+//       palette search vectorised (SSE2 where available, plain C++ elsewhere). No D3D or DirectXTex types, so it builds and runs anywhere.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_BCEncoder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AZB_BC_SSE2 1
+#include <emmintrin.h>
+#else
+#define AZB_BC_SSE2 0
+#endif
+
+namespace
+{
+	// 16 pixels with one array per channel, so four pixels fill a register
+	struct Pixels
+	{
+		alignas(16) float m_C[4][16];
+	};
+
+	// Decoded colours in index order
+	struct Palette
+	{
+		alignas(16) float m_C[4][16];
+		uint32_t m_Count = 0;
+	};
+
+	const uint32_t kAllPixels = 0xFFFF;
+
+	// Below this many blocks per thread it's quicker to stay on the calling thread
+	const uint32_t kMinBlocksPerThread = 256;
+
+	// How many of the best estimated partitions get a full mode 1 encode
+	const uint32_t kMode1Candidates = 4;
+
+	const float kPerceptualWeights[4] = { 0.299f * 3.f, 0.587f * 3.f, 0.114f * 3.f, 1.f };
+	const float kUniformWeights[4] = { 1.f, 1.f, 1.f, 1.f };
+
+	// BC7 two-subset partitions - bit i set means pixel i is in subset 1 - and the anchor pixel of subset 1 for each
+	const uint16_t kPartitions2[64] =
+	{
+		0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+		0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+		0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+		0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+		0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+		0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+		0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+		0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+	};
+
+	const uint8_t kAnchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15,
+		15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,
+		 2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,
+		 2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2,
+		15, 15, 15, 15, 15,  2,  2, 15
+	};
+
+	// BC7 interpolation weights out of 64, by index size
+	const uint8_t kWeights2[4] = { 0, 21, 43, 64 };
+	const uint8_t kWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const uint8_t kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	const uint8_t* GetWeightTable(uint32_t indexBits)
+	{
+		return indexBits == 2 ? kWeights2 : indexBits == 3 ? kWeights3 : kWeights4;
+	}
+
+	float Clamp255(float value)
+	{
+		return std::min(std::max(value, 0.f), 255.f);
+	}
+
+	// Closest palette entry for each pixel in mask, ties going to the lower index. Returns the summed weighted squared error
+	float FindIndices(const Pixels& pixels, uint32_t mask, const Palette& palette, uint32_t channels, const float weights[4], uint8_t indices[16])
+	{
+		float total = 0.f;
+		for (uint32_t group = 0; group < 4; ++group)
+		{
+			const uint32_t lanes = (mask >> (group * 4)) & 0xF;
+			if (lanes == 0)
+				continue;
+
+			alignas(16) float errors[4];
+			alignas(16) int32_t best[4];
+#if AZB_BC_SSE2
+			__m128 colour[4];
+			__m128 weight[4];
+			for (uint32_t c = 0; c < channels; ++c)
+			{
+				colour[c] = _mm_load_ps(&pixels.m_C[c][group * 4]);
+				weight[c] = _mm_set1_ps(weights[c]);
+			}
+
+			__m128 bestError = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+			for (uint32_t entry = 0; entry < palette.m_Count; ++entry)
+			{
+				__m128 error = _mm_setzero_ps();
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					const __m128 delta = _mm_sub_ps(colour[c], _mm_set1_ps(palette.m_C[c][entry]));
+					error = _mm_add_ps(error, _mm_mul_ps(_mm_mul_ps(delta, delta), weight[c]));
+				}
+
+				const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(error, bestError));
+				bestError = _mm_min_ps(error, bestError);
+				bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32((int32_t)entry)), _mm_andnot_si128(closer, bestIndex));
+			}
+
+			_mm_store_ps(errors, bestError);
+			_mm_store_si128((__m128i*)best, bestIndex);
+#else
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				const uint32_t pixel = group * 4 + lane;
+				errors[lane] = FLT_MAX;
+				best[lane] = 0;
+
+				for (uint32_t entry = 0; entry < palette.m_Count; ++entry)
+				{
+					float error = 0.f;
+					for (uint32_t c = 0; c < channels; ++c)
+					{
+						const float delta = pixels.m_C[c][pixel] - palette.m_C[c][entry];
+						error += delta * delta * weights[c];
+					}
+
+					if (error < errors[lane])
+					{
+						errors[lane] = error;
+						best[lane] = (int32_t)entry;
+					}
+				}
+			}
+#endif
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if (lanes & (1u << lane))
+				{
+					indices[group * 4 + lane] = (uint8_t)best[lane];
+					total += errors[lane];
+				}
+			}
+		}
+		return total;
+	}
+
+	// Endpoints spanning the pixels in mask along their principal axis, found by power iteration on the covariance
+	void FitLine(const Pixels& pixels, uint32_t mask, uint32_t channels, float e0[4], float e1[4])
+	{
+		float mean[4] = {};
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			if (mask & (1u << i))
+			{
+				for (uint32_t c = 0; c < channels; ++c)
+					mean[c] += pixels.m_C[c][i];
+				++count;
+			}
+		}
+
+		for (uint32_t c = 0; c < channels; ++c)
+			mean[c] /= (float)std::max(count, 1u);
+
+		float covariance[4][4] = {};
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			if (!(mask & (1u << i)))
+				continue;
+
+			float delta[4];
+			for (uint32_t c = 0; c < channels; ++c)
+				delta[c] = pixels.m_C[c][i] - mean[c];
+			for (uint32_t a = 0; a < channels; ++a)
+				for (uint32_t b = a; b < channels; ++b)
+					covariance[a][b] += delta[a] * delta[b];
+		}
+
+		// Start from the channel with the most spread
+		uint32_t widest = 0;
+		for (uint32_t a = 0; a < channels; ++a)
+		{
+			for (uint32_t b = 0; b < a; ++b)
+				covariance[a][b] = covariance[b][a];
+			if (covariance[a][a] > covariance[widest][widest])
+				widest = a;
+		}
+
+		float axis[4] = {};
+		for (uint32_t c = 0; c < channels; ++c)
+			axis[c] = covariance[widest][c];
+
+		for (uint32_t iteration = 0; iteration < 6; ++iteration)
+		{
+			float next[4] = {};
+			float lengthSqr = 0.f;
+			for (uint32_t a = 0; a < channels; ++a)
+			{
+				for (uint32_t b = 0; b < channels; ++b)
+					next[a] += covariance[a][b] * axis[b];
+				lengthSqr += next[a] * next[a];
+			}
+
+			if (lengthSqr < 1e-12f)
+				break;
+
+			const float scale = 1.f / std::sqrt(lengthSqr);
+			for (uint32_t c = 0; c < channels; ++c)
+				axis[c] = next[c] * scale;
+		}
+
+		float tMin = FLT_MAX;
+		float tMax = -FLT_MAX;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			if (!(mask & (1u << i)))
+				continue;
+
+			float t = 0.f;
+			for (uint32_t c = 0; c < channels; ++c)
+				t += (pixels.m_C[c][i] - mean[c]) * axis[c];
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+
+		// A flat block has no axis, and needs none
+		if (tMin > tMax)
+			tMin = tMax = 0.f;
+
+		for (uint32_t c = 0; c < channels; ++c)
+		{
+			e0[c] = Clamp255(mean[c] + tMin * axis[c]);
+			e1[c] = Clamp255(mean[c] + tMax * axis[c]);
+		}
+	}
+
+	// The endpoints that minimise the error for fixed indices, where factors[index] is how far along the line each index sits. False if the
+	// indices don't pin a line down, e.g. when they're all the same
+	bool RefineEndpoints(const Pixels& pixels, uint32_t mask, uint32_t channels, const uint8_t indices[16], const float* factors, float e0[4], float e1[4])
+	{
+		float aa = 0.f, ab = 0.f, bb = 0.f;
+		float ax[4] = {}, bx[4] = {};
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			if (!(mask & (1u << i)))
+				continue;
+
+			const float t = factors[indices[i]];
+			const float s = 1.f - t;
+			aa += s * s;
+			ab += s * t;
+			bb += t * t;
+			for (uint32_t c = 0; c < channels; ++c)
+			{
+				ax[c] += s * pixels.m_C[c][i];
+				bx[c] += t * pixels.m_C[c][i];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+			return false;
+
+		const float inverse = 1.f / determinant;
+		for (uint32_t c = 0; c < channels; ++c)
+		{
+			e0[c] = Clamp255((ax[c] * bb - bx[c] * ab) * inverse);
+			e1[c] = Clamp255((bx[c] * aa - ax[c] * ab) * inverse);
+		}
+		return true;
+	}
+
+	// Packs bits LSB first, which is how every BC format lays its fields out
+	class BitWriter
+	{
+	public:
+		void Write(uint32_t value, uint32_t bits)
+		{
+			for (uint32_t i = 0; i < bits; ++i, ++m_Position)
+				m_Bytes[m_Position >> 3] |= (uint8_t)(((value >> i) & 1) << (m_Position & 7));
+		}
+
+		uint8_t m_Bytes[16] = {};
+		uint32_t m_Position = 0;
+	};
+
+	//===============================================================================
+	//
+	// BC1 colour
+	//
+
+	uint16_t PackRGB565(const float colour[4])
+	{
+		const uint32_t r = (uint32_t)(Clamp255(colour[0]) * 31.f / 255.f + 0.5f);
+		const uint32_t g = (uint32_t)(Clamp255(colour[1]) * 63.f / 255.f + 0.5f);
+		const uint32_t b = (uint32_t)(Clamp255(colour[2]) * 31.f / 255.f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void UnpackRGB565(uint16_t packed, float colour[4])
+	{
+		const uint32_t r = packed >> 11;
+		const uint32_t g = (packed >> 5) & 63;
+		const uint32_t b = packed & 31;
+		colour[0] = (float)((r << 3) | (r >> 2));
+		colour[1] = (float)((g << 2) | (g >> 4));
+		colour[2] = (float)((b << 3) | (b >> 2));
+	}
+
+	// Where each index sits between the two endpoints in four colour mode
+	const float kBC1Factors[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+	// Always four colour mode, which BC3's colour block uses regardless of endpoint order
+	void EncodeBC1Colour(const Pixels& pixels, const float weights[4], bool bHigh, uint8_t* block)
+	{
+		float e0[4], e1[4];
+		FitLine(pixels, kAllPixels, 3, e0, e1);
+
+		uint8_t indices[16];
+		uint8_t bestIndices[16] = {};
+		uint16_t best0 = 0, best1 = 0;
+		float bestError = FLT_MAX;
+
+		const uint32_t passes = bHigh ? 3 : 1;
+		for (uint32_t pass = 0; pass < passes; ++pass)
+		{
+			// c0 > c1 is what selects four colour mode
+			uint16_t c0 = PackRGB565(e0);
+			uint16_t c1 = PackRGB565(e1);
+			if (c0 < c1)
+			{
+				std::swap(c0, c1);
+				std::swap(e0, e1);
+			}
+
+			float q0[4], q1[4];
+			UnpackRGB565(c0, q0);
+			UnpackRGB565(c1, q1);
+
+			Palette palette;
+			palette.m_Count = 4;
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				palette.m_C[c][0] = q0[c];
+				palette.m_C[c][1] = q1[c];
+				palette.m_C[c][2] = (2.f * q0[c] + q1[c]) / 3.f;
+				palette.m_C[c][3] = (q0[c] + 2.f * q1[c]) / 3.f;
+			}
+
+			const float error = FindIndices(pixels, kAllPixels, palette, 3, weights, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				best0 = c0;
+				best1 = c1;
+				std::memcpy(bestIndices, indices, sizeof(indices));
+			}
+
+			if (error == 0.f || !RefineEndpoints(pixels, kAllPixels, 3, indices, kBC1Factors, e0, e1))
+				break;
+		}
+
+		// With equal endpoints every entry matches, so the tie-break has already picked index 0 - never the transparent black of three colour mode
+		uint32_t packedIndices = 0;
+		for (uint32_t i = 0; i < 16; ++i)
+			packedIndices |= (uint32_t)bestIndices[i] << (i * 2);
+
+		block[0] = (uint8_t)(best0 & 0xFF);
+		block[1] = (uint8_t)(best0 >> 8);
+		block[2] = (uint8_t)(best1 & 0xFF);
+		block[3] = (uint8_t)(best1 >> 8);
+		std::memcpy(block + 4, &packedIndices, 4);
+	}
+
+	//===============================================================================
+	//
+	// BC4 single channel - BC3's alpha and both halves of BC5
+	//
+
+	void WriteBC4(uint8_t r0, uint8_t r1, const uint8_t indices[16], uint8_t* block)
+	{
+		uint64_t packedIndices = 0;
+		for (uint32_t i = 0; i < 16; ++i)
+			packedIndices |= (uint64_t)indices[i] << (i * 3);
+
+		block[0] = r0;
+		block[1] = r1;
+		for (uint32_t i = 0; i < 6; ++i)
+			block[2 + i] = (uint8_t)(packedIndices >> (i * 8));
+	}
+
+	// Eight value mode needs r0 > r1: index 0 is r0, 1 is r1, and 2-7 step from r0 towards r1 in sevenths
+	void BuildBC4Palette8(uint32_t r0, uint32_t r1, Palette& palette)
+	{
+		palette.m_Count = 8;
+		palette.m_C[0][0] = (float)r0;
+		palette.m_C[0][1] = (float)r1;
+		for (uint32_t k = 1; k < 7; ++k)
+			palette.m_C[0][1 + k] = (float)((7 - k) * r0 + k * r1) / 7.f;
+	}
+
+	const float kBC4Factors8[8] = { 0.f, 1.f, 1.f / 7.f, 2.f / 7.f, 3.f / 7.f, 4.f / 7.f, 5.f / 7.f, 6.f / 7.f };
+
+	void EncodeBC4(const Pixels& source, uint32_t channel, bool bHigh, uint8_t* block)
+	{
+		// FindIndices works on the leading channels, so move this one to the front
+		Pixels pixels;
+		std::memcpy(pixels.m_C[0], source.m_C[channel], sizeof(pixels.m_C[0]));
+
+		const float weights[4] = { 1.f, 1.f, 1.f, 1.f };
+		float lo = 255.f, hi = 0.f;
+		bool bHasExtremes = false;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			lo = std::min(lo, pixels.m_C[0][i]);
+			hi = std::max(hi, pixels.m_C[0][i]);
+			bHasExtremes |= pixels.m_C[0][i] == 0.f || pixels.m_C[0][i] == 255.f;
+		}
+
+		uint8_t indices[16] = {};
+		if (lo == hi)
+		{
+			WriteBC4((uint8_t)hi, (uint8_t)lo, indices, block);
+			return;
+		}
+
+		uint8_t bestIndices[16];
+		uint32_t best0 = 0, best1 = 0;
+		float bestError = FLT_MAX;
+
+		float e0[4] = { hi }, e1[4] = { lo };
+		const uint32_t passes = bHigh ? 3 : 1;
+		for (uint32_t pass = 0; pass < passes; ++pass)
+		{
+			uint32_t r0 = (uint32_t)(Clamp255(e0[0]) + 0.5f);
+			uint32_t r1 = (uint32_t)(Clamp255(e1[0]) + 0.5f);
+			if (r0 < r1)
+			{
+				std::swap(r0, r1);
+				std::swap(e0[0], e1[0]);
+			}
+			if (r0 == r1)
+			{
+				if (r0 < 255)
+					++r0;
+				else
+					--r1;
+			}
+
+			Palette palette;
+			BuildBC4Palette8(r0, r1, palette);
+			const float error = FindIndices(pixels, kAllPixels, palette, 1, weights, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				best0 = r0;
+				best1 = r1;
+				std::memcpy(bestIndices, indices, sizeof(indices));
+			}
+
+			if (error == 0.f || !RefineEndpoints(pixels, kAllPixels, 1, indices, kBC4Factors8, e0, e1))
+				break;
+		}
+
+		// Six value mode (r0 <= r1) spends two indices on exact 0 and 255, which suits masks and cutouts
+		if (bHigh && bHasExtremes)
+		{
+			float innerLo = 255.f, innerHi = 0.f;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				const float value = pixels.m_C[0][i];
+				if (value != 0.f && value != 255.f)
+				{
+					innerLo = std::min(innerLo, value);
+					innerHi = std::max(innerHi, value);
+				}
+			}
+			if (innerLo > innerHi)
+				innerLo = innerHi = 0.f;
+
+			const uint32_t r0 = (uint32_t)(innerLo + 0.5f);
+			const uint32_t r1 = (uint32_t)(innerHi + 0.5f);
+
+			Palette palette;
+			palette.m_Count = 8;
+			palette.m_C[0][0] = (float)r0;
+			palette.m_C[0][1] = (float)r1;
+			for (uint32_t k = 1; k < 5; ++k)
+				palette.m_C[0][1 + k] = (float)((5 - k) * r0 + k * r1) / 5.f;
+			palette.m_C[0][6] = 0.f;
+			palette.m_C[0][7] = 255.f;
+
+			const float error = FindIndices(pixels, kAllPixels, palette, 1, weights, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				best0 = r0;
+				best1 = r1;
+				std::memcpy(bestIndices, indices, sizeof(indices));
+			}
+		}
+
+		WriteBC4((uint8_t)best0, (uint8_t)best1, bestIndices, block);
+	}
+
+	//===============================================================================
+	//
+	// BC7
+	//
+
+	// A quantised endpoint and its p-bit back to 8 bits, exactly as the decoder does it
+	uint32_t ExpandEndpoint(uint32_t quantised, uint32_t pBit, uint32_t bits)
+	{
+		const uint32_t total = bits + 1;
+		const uint32_t value = (quantised << 1) | pBit;
+		return (value << (8 - total)) | (value >> (2 * total - 8));
+	}
+
+	uint32_t QuantiseEndpoint(float value, uint32_t pBit, uint32_t bits)
+	{
+		const float scaled = Clamp255(value) * (float)((1u << (bits + 1)) - 1) / 255.f;
+		const int32_t quantised = (int32_t)std::floor((scaled - (float)pBit) * 0.5f + 0.5f);
+		return (uint32_t)std::min(std::max(quantised, 0), (int32_t)(1u << bits) - 1);
+	}
+
+	float QuantisationError(const float endpoint[4], uint32_t pBit, uint32_t bits, uint32_t channels, const float weights[4])
+	{
+		float error = 0.f;
+		for (uint32_t c = 0; c < channels; ++c)
+		{
+			const float delta = (float)ExpandEndpoint(QuantiseEndpoint(endpoint[c], pBit, bits), pBit, bits) - endpoint[c];
+			error += delta * delta * weights[c];
+		}
+		return error;
+	}
+
+	struct SubsetFit
+	{
+		uint32_t m_Endpoints[2][4];		// Quantised, without p-bits
+		uint32_t m_PBits[2];
+		float m_Error;
+	};
+
+	// Fits the pixels in mask with endpointBits per channel plus a p-bit per endpoint (or one shared by both) and indexBits indices. Only the
+	// masked entries of indices are written
+	SubsetFit FitSubset(const Pixels& pixels, uint32_t mask, uint32_t channels, const float weights[4], uint32_t endpointBits, bool bSharedPBit,
+		uint32_t indexBits, bool bHigh, uint8_t indices[16])
+	{
+		const uint8_t* weightTable = GetWeightTable(indexBits);
+		const uint32_t indexCount = 1u << indexBits;
+
+		float factors[16];
+		for (uint32_t i = 0; i < indexCount; ++i)
+			factors[i] = (float)weightTable[i] / 64.f;
+
+		float e0[4] = {}, e1[4] = {};
+		FitLine(pixels, mask, channels, e0, e1);
+
+		SubsetFit best = {};
+		best.m_Error = FLT_MAX;
+		uint8_t candidate[16];
+
+		const uint32_t passes = bHigh ? 3 : 1;
+		for (uint32_t pass = 0; pass < passes; ++pass)
+		{
+			// Every combination when there's time, otherwise whichever p-bits quantise each endpoint best
+			uint32_t pChoices[4][2];
+			uint32_t choiceCount = 0;
+			if (bSharedPBit)
+			{
+				if (bHigh)
+				{
+					pChoices[choiceCount][0] = pChoices[choiceCount][1] = 0; ++choiceCount;
+					pChoices[choiceCount][0] = pChoices[choiceCount][1] = 1; ++choiceCount;
+				}
+				else
+				{
+					const uint32_t p = QuantisationError(e0, 1, endpointBits, channels, weights) + QuantisationError(e1, 1, endpointBits, channels, weights) <
+						QuantisationError(e0, 0, endpointBits, channels, weights) + QuantisationError(e1, 0, endpointBits, channels, weights) ? 1 : 0;
+					pChoices[choiceCount][0] = pChoices[choiceCount][1] = p; ++choiceCount;
+				}
+			}
+			else if (bHigh)
+			{
+				for (uint32_t p = 0; p < 4; ++p)
+				{
+					pChoices[choiceCount][0] = p & 1;
+					pChoices[choiceCount][1] = p >> 1;
+					++choiceCount;
+				}
+			}
+			else
+			{
+				pChoices[0][0] = QuantisationError(e0, 1, endpointBits, channels, weights) < QuantisationError(e0, 0, endpointBits, channels, weights) ? 1 : 0;
+				pChoices[0][1] = QuantisationError(e1, 1, endpointBits, channels, weights) < QuantisationError(e1, 0, endpointBits, channels, weights) ? 1 : 0;
+				choiceCount = 1;
+			}
+
+			for (uint32_t choice = 0; choice < choiceCount; ++choice)
+			{
+				SubsetFit fit;
+				fit.m_PBits[0] = pChoices[choice][0];
+				fit.m_PBits[1] = pChoices[choice][1];
+
+				uint32_t expanded[2][4] = {};
+				for (uint32_t c = 0; c < channels; ++c)
+				{
+					fit.m_Endpoints[0][c] = QuantiseEndpoint(e0[c], fit.m_PBits[0], endpointBits);
+					fit.m_Endpoints[1][c] = QuantiseEndpoint(e1[c], fit.m_PBits[1], endpointBits);
+					expanded[0][c] = ExpandEndpoint(fit.m_Endpoints[0][c], fit.m_PBits[0], endpointBits);
+					expanded[1][c] = ExpandEndpoint(fit.m_Endpoints[1][c], fit.m_PBits[1], endpointBits);
+				}
+
+				Palette palette;
+				palette.m_Count = indexCount;
+				for (uint32_t i = 0; i < indexCount; ++i)
+					for (uint32_t c = 0; c < channels; ++c)
+						palette.m_C[c][i] = (float)(((64 - weightTable[i]) * expanded[0][c] + weightTable[i] * expanded[1][c] + 32) >> 6);
+
+				fit.m_Error = FindIndices(pixels, mask, palette, channels, weights, candidate);
+				if (fit.m_Error < best.m_Error)
+				{
+					best = fit;
+					for (uint32_t i = 0; i < 16; ++i)
+						if (mask & (1u << i))
+							indices[i] = candidate[i];
+				}
+			}
+
+			if (best.m_Error == 0.f || pass + 1 == passes || !RefineEndpoints(pixels, mask, channels, indices, factors, e0, e1))
+				break;
+		}
+
+		return best;
+	}
+
+	// Anchor pixels store their index without its top bit, which must therefore be clear - flip the subset round if it isn't
+	void FixAnchor(SubsetFit& fit, uint32_t mask, uint32_t anchor, uint32_t indexBits, uint8_t indices[16])
+	{
+		const uint32_t highest = (1u << indexBits) - 1;
+		if (indices[anchor] <= highest >> 1)
+			return;
+
+		for (uint32_t c = 0; c < 4; ++c)
+			std::swap(fit.m_Endpoints[0][c], fit.m_Endpoints[1][c]);
+		std::swap(fit.m_PBits[0], fit.m_PBits[1]);
+
+		for (uint32_t i = 0; i < 16; ++i)
+			if (mask & (1u << i))
+				indices[i] = (uint8_t)(highest - indices[i]);
+	}
+
+	// Mode 6: one subset, RGBA 7.7.7.7 with a p-bit per endpoint, 4-bit indices
+	float EncodeBC7Mode6(const Pixels& pixels, const float weights[4], bool bHigh, uint8_t* block)
+	{
+		uint8_t indices[16] = {};
+		SubsetFit fit = FitSubset(pixels, kAllPixels, 4, weights, 7, false, 4, bHigh, indices);
+		FixAnchor(fit, kAllPixels, 0, 4, indices);
+
+		BitWriter writer;
+		writer.Write(1u << 6, 7);
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			writer.Write(fit.m_Endpoints[0][c], 7);
+			writer.Write(fit.m_Endpoints[1][c], 7);
+		}
+		writer.Write(fit.m_PBits[0], 1);
+		writer.Write(fit.m_PBits[1], 1);
+		for (uint32_t i = 0; i < 16; ++i)
+			writer.Write(indices[i], i == 0 ? 3 : 4);
+
+		std::memcpy(block, writer.m_Bytes, 16);
+		return fit.m_Error;
+	}
+
+	// Sums of r, g, b, then rr, rg, rb, gg, gb, bb
+	void AccumulateMoments(const Pixels& pixels, uint32_t pixel, float sums[9])
+	{
+		const float r = pixels.m_C[0][pixel], g = pixels.m_C[1][pixel], b = pixels.m_C[2][pixel];
+		sums[0] += r; sums[1] += g; sums[2] += b;
+		sums[3] += r * r; sums[4] += r * g; sums[5] += r * b;
+		sums[6] += g * g; sums[7] += g * b; sums[8] += b * b;
+	}
+
+	// Squared distance of count pixels from their principal axis, from their moments - the error an unquantised, continuous fit would leave
+	float LineResidual(const float sums[9], uint32_t count)
+	{
+		if (count < 2)
+			return 0.f;
+
+		const float n = (float)count;
+		const float mean[3] = { sums[0] / n, sums[1] / n, sums[2] / n };
+		const float covariance[3][3] =
+		{
+			{ sums[3] - mean[0] * sums[0], sums[4] - mean[0] * sums[1], sums[5] - mean[0] * sums[2] },
+			{ sums[4] - mean[0] * sums[1], sums[6] - mean[1] * sums[1], sums[7] - mean[1] * sums[2] },
+			{ sums[5] - mean[0] * sums[2], sums[7] - mean[1] * sums[2], sums[8] - mean[2] * sums[2] }
+		};
+
+		const float trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+		if (trace <= 0.f)
+			return 0.f;
+
+		// A few rounds of power iteration is plenty to rank partitions by
+		float axis[3] = { 1.f, 1.f, 1.f };
+		float largest = 0.f;
+		for (uint32_t iteration = 0; iteration < 4; ++iteration)
+		{
+			float next[3];
+			for (uint32_t a = 0; a < 3; ++a)
+				next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+
+			const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if (length < 1e-6f)
+				break;
+
+			largest = length / std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+			for (uint32_t a = 0; a < 3; ++a)
+				axis[a] = next[a] / length;
+		}
+
+		return std::max(trace - largest, 0.f);
+	}
+
+	// Mode 1: two subsets, RGB 6.6.6 with a p-bit shared per subset, 3-bit indices. Opaque blocks only
+	float EncodeBC7Mode1(const Pixels& pixels, const float weights[4], uint8_t* block)
+	{
+		// Rank every partition by how far its subsets stray from their best-fit lines first - only the most promising few get the full treatment.
+		// The sums for subset 0 are the whole block's less subset 1's, so each partition only walks half the pixels
+		float sums[9] = {};
+		for (uint32_t i = 0; i < 16; ++i)
+			AccumulateMoments(pixels, i, sums);
+
+		float estimates[64];
+		uint32_t order[64];
+		for (uint32_t partition = 0; partition < 64; ++partition)
+		{
+			float subsetSums[9] = {};
+			uint32_t count = 0;
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				if (kPartitions2[partition] & (1u << i))
+				{
+					AccumulateMoments(pixels, i, subsetSums);
+					++count;
+				}
+			}
+
+			float remainder[9];
+			for (uint32_t m = 0; m < 9; ++m)
+				remainder[m] = sums[m] - subsetSums[m];
+
+			estimates[partition] = LineResidual(subsetSums, count) + LineResidual(remainder, 16 - count);
+			order[partition] = partition;
+		}
+
+		std::partial_sort(order, order + kMode1Candidates, order + 64,
+			[&estimates](uint32_t a, uint32_t b) { return estimates[a] != estimates[b] ? estimates[a] < estimates[b] : a < b; });
+
+		float bestError = FLT_MAX;
+		for (uint32_t candidate = 0; candidate < kMode1Candidates; ++candidate)
+		{
+			const uint32_t partition = order[candidate];
+			const uint32_t masks[2] = { ~kPartitions2[partition] & kAllPixels, kPartitions2[partition] };
+
+			uint8_t indices[16] = {};
+			SubsetFit fits[2];
+			float error = 0.f;
+			for (uint32_t subset = 0; subset < 2 && error < bestError; ++subset)
+			{
+				fits[subset] = FitSubset(pixels, masks[subset], 3, weights, 6, true, 3, true, indices);
+				error += fits[subset].m_Error;
+			}
+
+			if (error >= bestError)
+				continue;
+			bestError = error;
+
+			FixAnchor(fits[0], masks[0], 0, 3, indices);
+			FixAnchor(fits[1], masks[1], kAnchors2[partition], 3, indices);
+
+			BitWriter writer;
+			writer.Write(1u << 1, 2);
+			writer.Write(partition, 6);
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				for (uint32_t subset = 0; subset < 2; ++subset)
+				{
+					writer.Write(fits[subset].m_Endpoints[0][c], 6);
+					writer.Write(fits[subset].m_Endpoints[1][c], 6);
+				}
+			}
+			writer.Write(fits[0].m_PBits[0], 1);
+			writer.Write(fits[1].m_PBits[0], 1);
+			for (uint32_t i = 0; i < 16; ++i)
+				writer.Write(indices[i], i == 0 || i == kAnchors2[partition] ? 2 : 3);
+
+			std::memcpy(block, writer.m_Bytes, 16);
+		}
+
+		return bestError;
+	}
+
+	void EncodeBC7(const Pixels& pixels, const float weights[4], bool bHigh, bool bOpaque, uint8_t* block)
+	{
+		const float mode6Error = EncodeBC7Mode6(pixels, weights, bHigh, block);
+		if (!bHigh || !bOpaque || mode6Error == 0.f)
+			return;
+
+		// Mode 1 only writes a block once some partition beats FLT_MAX, so start from something defined
+		uint8_t mode1Block[16] = {};
+		if (EncodeBC7Mode1(pixels, weights, mode1Block) < mode6Error)
+			std::memcpy(block, mode1Block, 16);
+	}
+}
+
+//===============================================================================
+
+uint32_t BCEncoder::GetBlockBytes(eFormat format)
+{
+	return format == FORMAT_BC1 || format == FORMAT_BC4 ? 8 : 16;
+}
+
+size_t BCEncoder::GetEncodedSize(eFormat format, uint32_t width, uint32_t height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockBytes(format);
+}
+
+void BCEncoder::EncodeBlock(const uint8_t pixels[64], const EncodeDesc& desc, uint8_t* block)
+{
+	Pixels source;
+	bool bOpaque = true;
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+			source.m_C[c][i] = (float)pixels[i * 4 + c];
+		bOpaque &= pixels[i * 4 + 3] == 255;
+	}
+
+	const float* weights = desc.m_bPerceptual ? kPerceptualWeights : kUniformWeights;
+	const bool bHigh = desc.m_Quality == QUALITY_HIGH;
+
+	switch (desc.m_Format)
+	{
+	case FORMAT_BC1:
+		EncodeBC1Colour(source, weights, bHigh, block);
+		break;
+	case FORMAT_BC3:
+		EncodeBC4(source, 3, bHigh, block);
+		EncodeBC1Colour(source, weights, bHigh, block + 8);
+		break;
+	case FORMAT_BC4:
+		EncodeBC4(source, 0, bHigh, block);
+		break;
+	case FORMAT_BC5:
+		EncodeBC4(source, 0, bHigh, block);
+		EncodeBC4(source, 1, bHigh, block + 8);
+		break;
+	case FORMAT_BC7:
+		EncodeBC7(source, weights, bHigh, bOpaque, block);
+		break;
+	}
+}
+
+void BCEncoder::EncodeImage(const uint8_t* rgba, size_t rowPitch, uint32_t width, uint32_t height, const EncodeDesc& desc, uint8_t* blocks, size_t blockRowPitch)
+{
+	if (width == 0 || height == 0)
+		return;
+
+	const uint32_t blocksWide = (width + 3) / 4;
+	const uint32_t blocksHigh = (height + 3) / 4;
+	const uint32_t blockBytes = GetBlockBytes(desc.m_Format);
+
+	auto encodeRow = [&](uint32_t blockY)
+	{
+		uint8_t pixels[64];
+		for (uint32_t blockX = 0; blockX < blocksWide; ++blockX)
+		{
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				const uint8_t* row = rgba + std::min(blockY * 4 + y, height - 1) * rowPitch;
+				for (uint32_t x = 0; x < 4; ++x)
+					std::memcpy(&pixels[(y * 4 + x) * 4], row + std::min(blockX * 4 + x, width - 1) * 4, 4);
+			}
+
+			EncodeBlock(pixels, desc, blocks + blockY * blockRowPitch + blockX * blockBytes);
+		}
+	};
+
+	uint32_t threads = desc.m_Threads != 0 ? desc.m_Threads : std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, std::max(1u, blocksWide * blocksHigh / kMinBlocksPerThread));
+	threads = std::min(threads, blocksHigh);
+
+	if (threads <= 1)
+	{
+		for (uint32_t blockY = 0; blockY < blocksHigh; ++blockY)
+			encodeRow(blockY);
+		return;
+	}
+
+	// Rows of blocks are handed out one at a time, so a row full of expensive blocks doesn't hold everyone else up
+	std::atomic<uint32_t> nextRow(0);
+	auto worker = [&]()
+	{
+		for (uint32_t blockY = nextRow.fetch_add(1); blockY < blocksHigh; blockY = nextRow.fetch_add(1))
+			encodeRow(blockY);
+	};
+
+	std::vector<std::thread> pool;
+	for (uint32_t i = 1; i < threads; ++i)
+		pool.emplace_back(worker);
+	worker();
+
+	for (std::thread& thread : pool)
+		thread.join();
+}
@@ -0,0 +1,907 @@
+//===============================================================================
+// desc: A scripted benchmark runner that sweeps resolutions, rendering modes and DLSS qualities back-to-back.
+//       The scheduling and statistics here are deliberately free of D3D and Windows so they can be driven by a mock frame source on any platform.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_Benchmark.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable : 4100) // unreferenced formal parameter
+#endif
+#include "json.hpp"
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+using json = nlohmann::json;
+
+//===============================================================================
+//
+// Spec parsing helpers
+//
+
+namespace
+{
+	// Short names used in the spec file and the output. Order matches RTUA_GUI::eRenderingMode and DLSS::m_CurrentQualityMode respectively
+	const char* kModeNames[] = { "native", "bilinear", "dlss" };
+	const char* kDLSSModeNames[] = { "performance", "balanced", "quality", "ultraperformance" };
+
+	bool ParseEnumName(const json& value, const char* const* names, uint8_t count, uint8_t& out)
+	{
+		if (value.is_number_unsigned())
+		{
+			out = (uint8_t)value.get<uint32_t>();
+			return out < count;
+		}
+
+		if (!value.is_string())
+			return false;
+
+		std::string name = value.get<std::string>();
+		std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower(c); });
+		// Allow for a little leniency e.g. "Ultra Performance" or "ultra_performance"
+		name.erase(std::remove_if(name.begin(), name.end(), [](char c) { return c == ' ' || c == '_' || c == '-'; }), name.end());
+
+		for (uint8_t i = 0; i < count; ++i)
+		{
+			if (name == names[i])
+			{
+				out = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Resolutions are written as "1920x1080" so that they can't be confused with a list of values to sweep over
+	bool ParseResolution(const json& value, Resolution& out)
+	{
+		if (!value.is_string())
+			return false;
+
+		unsigned int w = 0, h = 0;
+		if (sscanf(value.get<std::string>().c_str(), "%ux%u", &w, &h) != 2 || w == 0 || h == 0)
+			return false;
+
+		out = { w, h };
+		return true;
+	}
+
+	std::string ResolutionToString(const Resolution& res)
+	{
+		return std::to_string(res.m_Width) + "x" + std::to_string(res.m_Height);
+	}
+
+	bool ParseVector3(const json& value, float out[3])
+	{
+		if (!value.is_array() || value.size() != 3)
+			return false;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			if (!value[i].is_number())
+				return false;
+			out[i] = value[i].get<float>();
+		}
+		return true;
+	}
+
+	// Every sweep field can either be a single value or an array of values to expand. A missing field becomes a single null entry so that defaults apply.
+	std::vector<json> GetSweepValues(const json& entry, const char* key)
+	{
+		auto it = entry.find(key);
+		if (it == entry.end())
+			return { json() };
+		if (it->is_array())
+			return it->empty() ? std::vector<json>{ json() } : std::vector<json>(it->begin(), it->end());
+		return { *it };
+	}
+
+	std::string DescribeConfig(const std::string& sweepName, const Benchmark::SweepConfig& config)
+	{
+		std::string name = sweepName.empty() ? "" : sweepName + "/";
+		name += kModeNames[config.m_RenderingMode];
+
+		if (config.m_RenderingMode == 1)
+			name += " " + ResolutionToString(config.m_InternalResolution);
+		else if (config.m_RenderingMode == 2)
+			name += std::string(" ") + kDLSSModeNames[config.m_DLSSMode];
+
+		if (config.m_NativeResolution.m_Width != 0)
+			name += " @ " + ResolutionToString(config.m_NativeResolution);
+
+		if (config.m_bOverrideLodBias)
+		{
+			char bias[32];
+			snprintf(bias, sizeof(bias), " lod%+.2f", config.m_LodBias);
+			name += bias;
+		}
+		return name;
+	}
+
+	void WriteDistributionCSV(std::ostringstream& out, const Benchmark::Distribution& d)
+	{
+		out << "," << d.m_Mean << "," << d.m_StdDev << "," << d.m_Min << "," << d.m_Max << "," << d.m_P50 << "," << d.m_P95 << "," << d.m_P99;
+	}
+
+	json DistributionToJSON(const Benchmark::Distribution& d)
+	{
+		return json{ { "mean", d.m_Mean }, { "stddev", d.m_StdDev }, { "min", d.m_Min }, { "max", d.m_Max },
+			{ "p50", d.m_P50 }, { "p95", d.m_P95 }, { "p99", d.m_P99 } };
+	}
+
+	void WritePacingCSV(std::ostringstream& out, const FrameStats::FrameTimeSummary& p)
+	{
+		out << "," << p.m_P999Ms << "," << p.m_JitterMs << "," << p.m_Stutters << "," << p.m_StutterPercent << "," << p.m_Low1PercentFPS << "," << p.m_Low01PercentFPS;
+	}
+
+	json PacingToJSON(const FrameStats::FrameTimeSummary& p)
+	{
+		return json{ { "p999Ms", p.m_P999Ms }, { "jitterMs", p.m_JitterMs }, { "stutters", p.m_Stutters }, { "stutterPercent", p.m_StutterPercent },
+			{ "low1PercentFps", p.m_Low1PercentFPS }, { "low01PercentFps", p.m_Low01PercentFPS } };
+	}
+}
+
+//===============================================================================
+//
+// Camera Path
+//
+
+Benchmark::CameraKey Benchmark::CameraPath::Evaluate(float t) const
+{
+	if (m_Keys.empty())
+		return CameraKey();
+	if (m_Keys.size() == 1)
+		return m_Keys[0];
+
+	t = std::min(std::max(t, 0.f), 1.f);
+
+	// Keys are evenly spaced, so find the segment and lerp within it
+	float segment = t * (float)(m_Keys.size() - 1);
+	size_t first = std::min((size_t)segment, m_Keys.size() - 2);
+	float alpha = segment - (float)first;
+
+	const CameraKey& a = m_Keys[first];
+	const CameraKey& b = m_Keys[first + 1];
+
+	CameraKey result;
+	for (int i = 0; i < 3; ++i)
+	{
+		result.m_Eye[i] = a.m_Eye[i] + (b.m_Eye[i] - a.m_Eye[i]) * alpha;
+		result.m_At[i] = a.m_At[i] + (b.m_At[i] - a.m_At[i]) * alpha;
+	}
+	return result;
+}
+
+//===============================================================================
+//
+// Spec Parsing
+//
+
+bool Benchmark::ParseSweepSpec(const std::string& jsonText, SweepSpec& spec, std::string& error)
+{
+	// Don't allow exceptions - a malformed spec will come back as discarded
+	json root = json::parse(jsonText, nullptr, false);
+	if (root.is_discarded() || !root.is_object())
+	{
+		error = "Benchmark spec is not a valid JSON object";
+		return false;
+	}
+
+	spec = SweepSpec();
+
+	if (root.contains("output") && root["output"].is_string())
+		spec.m_OutputPath = root["output"].get<std::string>();
+
+	if (root.contains("settleFrames") && root["settleFrames"].is_number_unsigned())
+		spec.m_SettleFrames = root["settleFrames"].get<uint32_t>();
+
+	if (root.contains("warmup") && root["warmup"].is_object())
+	{
+		const json& warmup = root["warmup"];
+		if (warmup.contains("min") && warmup["min"].is_number_unsigned())			spec.m_MinWarmupFrames = warmup["min"].get<uint32_t>();
+		if (warmup.contains("max") && warmup["max"].is_number_unsigned())			spec.m_MaxWarmupFrames = warmup["max"].get<uint32_t>();
+		if (warmup.contains("window") && warmup["window"].is_number_unsigned())		spec.m_SteadyStateWindow = warmup["window"].get<uint32_t>();
+		if (warmup.contains("threshold") && warmup["threshold"].is_number())		spec.m_SteadyStateThreshold = warmup["threshold"].get<float>();
+	}
+
+	if (spec.m_SteadyStateWindow < 2)
+	{
+		error = "Benchmark warmup window must be at least 2 frames";
+		return false;
+	}
+	spec.m_MaxWarmupFrames = std::max(spec.m_MaxWarmupFrames, spec.m_MinWarmupFrames);
+
+	// Camera paths are shared between sweeps and referenced by name
+	if (root.contains("cameraPaths") && root["cameraPaths"].is_object())
+	{
+		for (auto& path : root["cameraPaths"].items())
+		{
+			if (!path.value().is_array())
+			{
+				error = "Camera path \"" + path.key() + "\" must be an array of keys";
+				return false;
+			}
+
+			CameraPath cameraPath;
+			for (const json& key : path.value())
+			{
+				CameraKey cameraKey;
+				if (!key.is_object() || !key.contains("eye") || !key.contains("at") || !ParseVector3(key["eye"], cameraKey.m_Eye) || !ParseVector3(key["at"], cameraKey.m_At))
+				{
+					error = "Camera path \"" + path.key() + "\" has a key without a valid \"eye\" and \"at\"";
+					return false;
+				}
+				cameraPath.m_Keys.push_back(cameraKey);
+			}
+			spec.m_CameraPaths[path.key()] = cameraPath;
+		}
+	}
+
+	if (!root.contains("sweeps") || !root["sweeps"].is_array())
+	{
+		error = "Benchmark spec has no \"sweeps\" array";
+		return false;
+	}
+
+	for (const json& sweep : root["sweeps"])
+	{
+		if (!sweep.is_object())
+		{
+			error = "Every entry in \"sweeps\" must be an object";
+			return false;
+		}
+
+		const std::string sweepName = sweep.contains("name") && sweep["name"].is_string() ? sweep["name"].get<std::string>() : "";
+
+		SweepConfig base;
+		if (sweep.contains("frames") && sweep["frames"].is_number_unsigned())
+			base.m_Frames = sweep["frames"].get<uint32_t>();
+		if (base.m_Frames == 0)
+		{
+			error = "Sweep \"" + sweepName + "\" must measure at least one frame";
+			return false;
+		}
+
+		// Expand every combination. Fields that don't apply to a mode (e.g. DLSS quality for bilinear) are not expanded for that mode
+		for (const json& scene : GetSweepValues(sweep, "scene"))
+		for (const json& cameraPath : GetSweepValues(sweep, "cameraPath"))
+		for (const json& mode : GetSweepValues(sweep, "mode"))
+		for (const json& native : GetSweepValues(sweep, "nativeResolution"))
+		for (const json& lodBias : GetSweepValues(sweep, "lodBias"))
+		{
+			SweepConfig config = base;
+
+			if (scene.is_number_unsigned())
+				config.m_Scene = scene.get<uint32_t>();
+
+			if (cameraPath.is_string())
+			{
+				config.m_CameraPath = cameraPath.get<std::string>();
+				if (spec.m_CameraPaths.find(config.m_CameraPath) == spec.m_CameraPaths.end())
+				{
+					error = "Unknown camera path \"" + config.m_CameraPath + "\"";
+					return false;
+				}
+			}
+
+			if (!mode.is_null() && !ParseEnumName(mode, kModeNames, (uint8_t)std::size(kModeNames), config.m_RenderingMode))
+			{
+				error = "Unknown rendering mode " + mode.dump();
+				return false;
+			}
+
+			if (!native.is_null() && !ParseResolution(native, config.m_NativeResolution))
+			{
+				error = "Invalid native resolution " + native.dump() + ", expected \"WIDTHxHEIGHT\"";
+				return false;
+			}
+
+			if (lodBias.is_number())
+			{
+				config.m_bOverrideLodBias = true;
+				config.m_LodBias = lodBias.get<float>();
+			}
+
+			std::vector<json> internalValues = config.m_RenderingMode == 1 ? GetSweepValues(sweep, "internalResolution") : std::vector<json>{ json() };
+			std::vector<json> dlssValues = config.m_RenderingMode == 2 ? GetSweepValues(sweep, "dlssMode") : std::vector<json>{ json() };
+
+			for (const json& internal : internalValues)
+			for (const json& dlssMode : dlssValues)
+			{
+				SweepConfig expanded = config;
+
+				if (!internal.is_null() && !ParseResolution(internal, expanded.m_InternalResolution))
+				{
+					error = "Invalid internal resolution " + internal.dump() + ", expected \"WIDTHxHEIGHT\"";
+					return false;
+				}
+				if (expanded.m_RenderingMode == 1 && expanded.m_InternalResolution.m_Width == 0)
+				{
+					error = "Bilinear configs in sweep \"" + sweepName + "\" need an \"internalResolution\"";
+					return false;
+				}
+
+				if (!dlssMode.is_null() && !ParseEnumName(dlssMode, kDLSSModeNames, (uint8_t)std::size(kDLSSModeNames), expanded.m_DLSSMode))
+				{
+					error = "Unknown DLSS mode " + dlssMode.dump();
+					return false;
+				}
+
+				expanded.m_Name = DescribeConfig(sweepName, expanded);
+				spec.m_Configs.push_back(expanded);
+			}
+		}
+	}
+
+	if (spec.m_Configs.empty())
+	{
+		error = "Benchmark spec did not produce any configs";
+		return false;
+	}
+
+	return true;
+}
+
+bool Benchmark::LoadSweepSpec(const std::wstring& fileName, SweepSpec& spec, std::string& error)
+{
+#if defined(_WIN32)
+	std::ifstream file(fileName);
+#else
+	std::ifstream file(std::string(fileName.begin(), fileName.end()));
+#endif
+	if (!file.is_open())
+	{
+		error = "Unable to open benchmark spec";
+		return false;
+	}
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return ParseSweepSpec(contents.str(), spec, error);
+}
+
+//===============================================================================
+//
+// Statistics
+//
+
+Benchmark::Distribution Benchmark::ComputeDistribution(std::vector<float> samples)
+{
+	Distribution d;
+	if (samples.empty())
+		return d;
+
+	std::sort(samples.begin(), samples.end());
+
+	// Accumulate in double, a few thousand floats adds up to noticeable error otherwise
+	double sum = 0.0;
+	for (float s : samples)
+		sum += s;
+	const double mean = sum / (double)samples.size();
+
+	double variance = 0.0;
+	for (float s : samples)
+		variance += ((double)s - mean) * ((double)s - mean);
+	variance /= (double)samples.size();
+
+	auto percentile = [&samples](float p)
+	{
+		const float rank = p * (float)(samples.size() - 1);
+		const size_t lower = (size_t)rank;
+		const size_t upper = std::min(lower + 1, samples.size() - 1);
+		const float alpha = rank - (float)lower;
+		return samples[lower] + (samples[upper] - samples[lower]) * alpha;
+	};
+
+	d.m_Mean = (float)mean;
+	d.m_StdDev = (float)std::sqrt(variance);
+	d.m_Min = samples.front();
+	d.m_Max = samples.back();
+	d.m_P50 = percentile(0.50f);
+	d.m_P95 = percentile(0.95f);
+	d.m_P99 = percentile(0.99f);
+	return d;
+}
+
+Benchmark::SteadyStateDetector::SteadyStateDetector(uint32_t windowSize, float threshold)
+	: m_Window(std::max(windowSize, 2u), 0.f), m_Next(0), m_Count(0), m_Threshold(threshold)
+{
+}
+
+void Benchmark::SteadyStateDetector::Reset(void)
+{
+	m_Next = 0;
+	m_Count = 0;
+}
+
+void Benchmark::SteadyStateDetector::Push(float value)
+{
+	m_Window[m_Next] = value;
+	m_Next = (m_Next + 1) % (uint32_t)m_Window.size();
+	m_Count = std::min(m_Count + 1, (uint32_t)m_Window.size());
+}
+
+float Benchmark::SteadyStateDetector::GetVariation(void) const
+{
+	if (m_Count < 2)
+		return FLT_MAX;
+
+	double sum = 0.0;
+	for (uint32_t i = 0; i < m_Count; ++i)
+		sum += m_Window[i];
+	const double mean = sum / m_Count;
+	if (mean <= 0.0)
+		return FLT_MAX;
+
+	double variance = 0.0;
+	for (uint32_t i = 0; i < m_Count; ++i)
+		variance += (m_Window[i] - mean) * (m_Window[i] - mean);
+	variance /= m_Count;
+
+	return (float)(std::sqrt(variance) / mean);
+}
+
+bool Benchmark::SteadyStateDetector::IsSteady(void) const
+{
+	// Only judge a full window, otherwise a couple of lucky frames would pass
+	return m_Count == m_Window.size() && GetVariation() < m_Threshold;
+}
+
+//===============================================================================
+//
+// Runner
+//
+
+Benchmark::Runner::Runner(const SweepSpec& spec)
+	: m_Spec(spec), m_CurrentConfig(0), m_Phase(APPLY), m_PhaseFrames(0), m_bFramePending(false), m_PendingPhase(APPLY),
+	m_Detector(spec.m_SteadyStateWindow, spec.m_SteadyStateThreshold)
+{
+	m_Results.reserve(m_Spec.m_Configs.size());
+}
+
+void Benchmark::Runner::Tick(FrameSource& source)
+{
+	// Timings always describe the frame we set up on the previous tick, so consume those before deciding anything else
+	if (m_bFramePending)
+	{
+		m_bFramePending = false;
+		OnFrameComplete(source.SampleLastFrame());
+	}
+
+	if (IsFinished())
+		return;
+
+	const SweepConfig& config = m_Spec.m_Configs[m_CurrentConfig];
+
+	if (m_Phase == APPLY)
+	{
+		if (!source.SupportsConfig(config))
+		{
+			FinishConfig(true);
+			return;
+		}
+
+		if (!source.ApplyConfig(config))
+			return;
+
+		m_Phase = m_Spec.m_SettleFrames > 0 ? SETTLE : WARMUP;
+		m_PhaseFrames = 0;
+		m_Detector.Reset();
+	}
+
+	if (m_Phase == SETTLE && m_PhaseFrames >= m_Spec.m_SettleFrames)
+	{
+		m_Phase = WARMUP;
+		m_PhaseFrames = 0;
+	}
+
+	// Measured frames are prepared up-front, so stop once they're all in flight and wait for the last one to come back
+	if (m_Phase == MEASURE && m_PhaseFrames >= config.m_Frames)
+		return;
+
+	source.PrepareFrame(config, GetCameraForFrame());
+	++m_PhaseFrames;
+
+	// Settle frames are never sampled
+	m_bFramePending = m_Phase != SETTLE;
+	m_PendingPhase = m_Phase;
+}
+
+void Benchmark::Runner::OnFrameComplete(const FrameSample& sample)
+{
+	if (m_PendingPhase == WARMUP)
+	{
+		m_Detector.Push(sample.m_FrameMs);
+
+		const bool steady = m_PhaseFrames >= m_Spec.m_MinWarmupFrames && m_Detector.IsSteady();
+		if (steady || m_PhaseFrames >= m_Spec.m_MaxWarmupFrames)
+		{
+			ConfigResult result;
+			result.m_Config = m_Spec.m_Configs[m_CurrentConfig];
+			result.m_bReachedSteadyState = steady;
+			result.m_WarmupFrames = m_PhaseFrames;
+			m_Results.push_back(result);
+
+			m_CpuSamples.clear();
+			m_GpuSamples.clear();
+			m_FrameSamples.clear();
+			m_PacingAnalyzer.Reset();
+
+			m_Phase = MEASURE;
+			m_PhaseFrames = 0;
+		}
+	}
+	else if (m_PendingPhase == MEASURE)
+	{
+		m_CpuSamples.push_back(sample.m_CpuMs);
+		m_GpuSamples.push_back(sample.m_GpuMs);
+		m_FrameSamples.push_back(sample.m_FrameMs);
+		m_PacingAnalyzer.Push(sample.m_FrameMs);
+
+		if (m_FrameSamples.size() >= m_Spec.m_Configs[m_CurrentConfig].m_Frames)
+			FinishConfig(false);
+	}
+}
+
+void Benchmark::Runner::FinishConfig(bool skipped)
+{
+	if (skipped)
+	{
+		ConfigResult result;
+		result.m_Config = m_Spec.m_Configs[m_CurrentConfig];
+		result.m_bSkipped = true;
+		m_Results.push_back(result);
+	}
+	else
+	{
+		// The result entry was created when warmup finished
+		ConfigResult& result = m_Results.back();
+		result.m_Cpu = ComputeDistribution(m_CpuSamples);
+		result.m_Gpu = ComputeDistribution(m_GpuSamples);
+		result.m_Frame = ComputeDistribution(m_FrameSamples);
+		result.m_Pacing = m_PacingAnalyzer.GetSummary();
+	}
+
+	++m_CurrentConfig;
+	m_Phase = APPLY;
+	m_PhaseFrames = 0;
+}
+
+const Benchmark::CameraKey* Benchmark::Runner::GetCameraForFrame(void)
+{
+	const SweepConfig& config = m_Spec.m_Configs[m_CurrentConfig];
+	if (config.m_CameraPath.empty())
+		return nullptr;
+
+	const CameraPath& path = m_Spec.m_CameraPaths.at(config.m_CameraPath);
+
+	// Hold the first key until measuring starts, then walk the path once over the measured frames
+	float progress = 0.f;
+	if (m_Phase == MEASURE && config.m_Frames > 1)
+		progress = (float)m_PhaseFrames / (float)(config.m_Frames - 1);
+
+	m_CameraScratch = path.Evaluate(progress);
+	return &m_CameraScratch;
+}
+
+std::string Benchmark::Runner::GetStatus(void) const
+{
+	if (IsFinished())
+		return "Benchmark complete";
+
+	static const char* kPhaseNames[] = { "Applying", "Settling", "Warming up", "Measuring" };
+
+	char status[256];
+	snprintf(status, sizeof(status), "Config %zu/%zu: %s\n%s (%u frames)", m_CurrentConfig + 1, m_Spec.m_Configs.size(),
+		m_Spec.m_Configs[m_CurrentConfig].m_Name.c_str(), kPhaseNames[m_Phase], m_PhaseFrames);
+	return status;
+}
+
+//===============================================================================
+//
+// Output
+//
+
+std::string Benchmark::ResultsToJSON(const std::vector<ConfigResult>& results)
+{
+	json root = json::array();
+
+	for (const ConfigResult& result : results)
+	{
+		const SweepConfig& config = result.m_Config;
+
+		json entry;
+		entry["name"] = config.m_Name;
+		entry["scene"] = config.m_Scene;
+		entry["cameraPath"] = config.m_CameraPath;
+		entry["mode"] = kModeNames[config.m_RenderingMode];
+		entry["dlssMode"] = config.m_RenderingMode == 2 ? kDLSSModeNames[config.m_DLSSMode] : "";
+		entry["nativeResolution"] = config.m_NativeResolution.m_Width ? ResolutionToString(config.m_NativeResolution) : "";
+		entry["internalResolution"] = config.m_RenderingMode == 1 ? ResolutionToString(config.m_InternalResolution) : "";
+		entry["lodBias"] = config.m_bOverrideLodBias ? json(config.m_LodBias) : json();
+		entry["skipped"] = result.m_bSkipped;
+
+		if (!result.m_bSkipped)
+		{
+			entry["frames"] = config.m_Frames;
+			entry["warmupFrames"] = result.m_WarmupFrames;
+			entry["steadyState"] = result.m_bReachedSteadyState;
+			entry["cpuMs"] = DistributionToJSON(result.m_Cpu);
+			entry["gpuMs"] = DistributionToJSON(result.m_Gpu);
+			entry["frameMs"] = DistributionToJSON(result.m_Frame);
+			entry["pacing"] = PacingToJSON(result.m_Pacing);
+		}
+
+		root.push_back(entry);
+	}
+
+	return root.dump(4);
+}
+
+std::string Benchmark::ResultsToCSV(const std::vector<ConfigResult>& results)
+{
+	std::ostringstream out;
+
+	out << "name,scene,camera_path,mode,dlss_mode,native_resolution,internal_resolution,lod_bias,skipped,frames,warmup_frames,steady_state";
+	for (const char* series : { "cpu", "gpu", "frame" })
+		for (const char* stat : { "mean", "stddev", "min", "max", "p50", "p95", "p99" })
+			out << "," << series << "_" << stat << "_ms";
+	out << ",frame_p999_ms,jitter_ms,stutters,stutter_pct,low_1pct_fps,low_0_1pct_fps\n";
+
+	for (const ConfigResult& result : results)
+	{
+		const SweepConfig& config = result.m_Config;
+
+		out << "\"" << config.m_Name << "\"," << config.m_Scene << "," << config.m_CameraPath << "," << kModeNames[config.m_RenderingMode] << ","
+			<< (config.m_RenderingMode == 2 ? kDLSSModeNames[config.m_DLSSMode] : "") << ","
+			<< (config.m_NativeResolution.m_Width ? ResolutionToString(config.m_NativeResolution) : "") << ","
+			<< (config.m_RenderingMode == 1 ? ResolutionToString(config.m_InternalResolution) : "") << ",";
+		if (config.m_bOverrideLodBias)
+			out << config.m_LodBias;
+		out << "," << (result.m_bSkipped ? 1 : 0) << "," << (result.m_bSkipped ? 0 : config.m_Frames) << "," << result.m_WarmupFrames << "," << (result.m_bReachedSteadyState ? 1 : 0);
+
+		WriteDistributionCSV(out, result.m_Cpu);
+		WriteDistributionCSV(out, result.m_Gpu);
+		WriteDistributionCSV(out, result.m_Frame);
+		WritePacingCSV(out, result.m_Pacing);
+		out << "\n";
+	}
+
+	return out.str();
+}
+
+bool Benchmark::WriteResults(const std::string& outputPath, const std::vector<ConfigResult>& results)
+{
+	std::ofstream jsonFile(outputPath + ".json");
+	std::ofstream csvFile(outputPath + ".csv");
+	if (!jsonFile.is_open() || !csvFile.is_open())
+		return false;
+
+	jsonFile << ResultsToJSON(results);
+	csvFile << ResultsToCSV(results);
+	return true;
+}
+
+//===============================================================================
+//
+// Self test
+//
+
+namespace
+{
+	// What each config of the self test does to the runner. m_Scene holds the config's index, so the source can tell them apart
+	enum SelfTestWarmup { kWarmupSteady, kWarmupNoisy, kWarmupLate };
+
+	struct SelfTestConfig
+	{
+		uint32_t m_ApplyTries;			// ApplyConfig() calls before it goes through
+		bool m_bSupported;
+		SelfTestWarmup m_Warmup;
+		uint32_t m_Frames;
+		uint32_t m_ExpectedWarmup;		// Against the spec RunSelfTest() sets up
+		bool m_bExpectSteady;
+	};
+
+	// Settle 5, warmup between 30 and 120 frames, a window of 20. Steady input is steady once both the minimum and the window are met, noisy
+	// input runs to the maximum, and input that's noisy for 50 frames is steady a full window after it calms down
+	const SelfTestConfig kSelfTestConfigs[] =
+	{
+		{ 3, true,  kWarmupSteady, 100, 30,  true  },
+		{ 1, false, kWarmupSteady, 100, 0,   false },
+		{ 1, true,  kWarmupNoisy,  7,   120, false },
+		{ 1, true,  kWarmupLate,   1,   70,  true  },
+	};
+	constexpr uint32_t kSelfTestConfigCount = sizeof(kSelfTestConfigs) / sizeof(kSelfTestConfigs[0]);
+	constexpr uint32_t kSelfTestSettle = 5;
+	constexpr uint32_t kSelfTestLateNoise = 50;
+
+	// Hands the runner timings it can predict: warmup frames as the config says, and measured frame i taking 1 + i ms, the CPU half that and
+	// the GPU twice that. Records the phase of every frame it's asked to prepare, and anything the runner does out of turn
+	class SelfTestSource : public Benchmark::FrameSource
+	{
+	public:
+		SelfTestSource(const Benchmark::Runner& runner) : m_Runner(runner) {}
+
+		virtual bool SupportsConfig(const Benchmark::SweepConfig& config) override
+		{
+			return kSelfTestConfigs[config.m_Scene].m_bSupported;
+		}
+
+		virtual bool ApplyConfig(const Benchmark::SweepConfig& config) override
+		{
+			if (!kSelfTestConfigs[config.m_Scene].m_bSupported)
+				m_Errors.push_back("an unsupported config was applied");
+			return ++m_ApplyCalls[config.m_Scene] >= kSelfTestConfigs[config.m_Scene].m_ApplyTries;
+		}
+
+		virtual void PrepareFrame(const Benchmark::SweepConfig& config, const Benchmark::CameraKey* camera) override
+		{
+			const uint32_t index = config.m_Scene;
+			const Benchmark::Runner::ePhase phase = m_Runner.GetPhase();
+			if (m_ApplyCalls[index] < kSelfTestConfigs[index].m_ApplyTries)
+				m_Errors.push_back("a frame was prepared before its config applied");
+
+			std::vector<Benchmark::Runner::ePhase>& phases = m_Phases[index];
+			const uint32_t phaseIndex = (uint32_t)std::count(phases.begin(), phases.end(), phase);
+			phases.push_back(phase);
+
+			// Only the first config walks a path, holding its first key until measuring starts
+			if ((camera != nullptr) != (index == 0))
+				m_Errors.push_back("the camera path was given to the wrong config");
+			else if (camera != nullptr)
+			{
+				const float expected = phase == Benchmark::Runner::MEASURE ? 10.f * (float)phaseIndex / (float)(config.m_Frames - 1) : 0.f;
+				if (std::fabs(camera->m_Eye[0] - expected) > 1e-4f)
+					m_Errors.push_back("the camera wasn't where the path puts it");
+			}
+
+			float frameMs = 10.f;
+			if (phase == Benchmark::Runner::MEASURE)
+				frameMs = 1.f + (float)phaseIndex;
+			else if (kSelfTestConfigs[index].m_Warmup == kWarmupNoisy || (kSelfTestConfigs[index].m_Warmup == kWarmupLate && phaseIndex < kSelfTestLateNoise))
+				frameMs = (phaseIndex & 1) ? 15.f : 5.f;
+
+			m_Pending.m_FrameMs = frameMs;
+			m_Pending.m_CpuMs = frameMs * 0.5f;
+			m_Pending.m_GpuMs = frameMs * 2.f;
+			m_bPending = true;
+			m_bPendingSettle = phase == Benchmark::Runner::SETTLE;
+		}
+
+		virtual Benchmark::FrameSample SampleLastFrame(void) override
+		{
+			if (!m_bPending)
+				m_Errors.push_back("a frame was sampled twice, or before one was prepared");
+			else if (m_bPendingSettle)
+				m_Errors.push_back("a settle frame was sampled");
+			m_bPending = false;
+			return m_Pending;
+		}
+
+		const Benchmark::Runner& m_Runner;
+		uint32_t m_ApplyCalls[kSelfTestConfigCount] = {};
+		std::vector<Benchmark::Runner::ePhase> m_Phases[kSelfTestConfigCount];
+		std::vector<const char*> m_Errors;
+
+	private:
+		Benchmark::FrameSample m_Pending;
+		bool m_bPending = false;
+		bool m_bPendingSettle = false;
+	};
+}
+
+Benchmark::SelfTestResult Benchmark::RunSelfTest(void)
+{
+	SelfTestResult result;
+
+	auto nearlyEqual = [](float a, float b) { return std::fabs(a - b) <= 1e-3f * std::max(1.f, std::fabs(b)); };
+
+	// The statistics on their own first, against values worked out by hand
+	{
+		Distribution empty = ComputeDistribution({});
+		result.Check(empty.m_Mean == 0.f && empty.m_P99 == 0.f, "an empty distribution isn't zeroed");
+
+		Distribution d = ComputeDistribution({ 4.f, 1.f, 3.f, 2.f });
+		result.Check(nearlyEqual(d.m_Mean, 2.5f) && nearlyEqual(d.m_Min, 1.f) && nearlyEqual(d.m_Max, 4.f), "mean, min or max of 1..4 is off");
+		result.Check(nearlyEqual(d.m_StdDev, 1.118034f), "standard deviation of 1..4 is off");
+		result.Check(nearlyEqual(d.m_P50, 2.5f) && nearlyEqual(d.m_P95, 3.85f) && nearlyEqual(d.m_P99, 3.97f), "percentiles of 1..4 aren't interpolated between ranks");
+
+		Distribution one = ComputeDistribution({ 7.f });
+		result.Check(nearlyEqual(one.m_P50, 7.f) && nearlyEqual(one.m_P99, 7.f) && one.m_StdDev == 0.f, "a single sample isn't its own distribution");
+
+		SteadyStateDetector detector(4, 0.05f);
+		for (int i = 0; i < 3; ++i)
+			detector.Push(10.f);
+		result.Check(!detector.IsSteady(), "a part filled window was judged steady");
+		detector.Push(10.f);
+		result.Check(detector.IsSteady() && detector.GetVariation() == 0.f, "a full window of constant frames isn't steady");
+		detector.Push(20.f);
+		result.Check(!detector.IsSteady(), "a window with an outlier in it is still steady");
+		detector.Reset();
+		result.Check(!detector.IsSteady() && detector.GetVariation() == FLT_MAX, "reset didn't empty the window");
+	}
+
+	// Then the whole runner, a frame at a time
+	SweepSpec spec;
+	spec.m_SettleFrames = kSelfTestSettle;
+	spec.m_MinWarmupFrames = 30;
+	spec.m_MaxWarmupFrames = 120;
+	spec.m_SteadyStateWindow = 20;
+	spec.m_SteadyStateThreshold = 0.05f;
+
+	CameraPath& path = spec.m_CameraPaths["line"];
+	path.m_Keys.resize(2);
+	path.m_Keys[1].m_Eye[0] = 10.f;
+
+	for (uint32_t i = 0; i < kSelfTestConfigCount; ++i)
+	{
+		SweepConfig config;
+		config.m_Name = "selftest" + std::to_string(i);
+		config.m_Scene = i;
+		config.m_CameraPath = i == 0 ? "line" : "";
+		config.m_Frames = kSelfTestConfigs[i].m_Frames;
+		spec.m_Configs.push_back(config);
+	}
+	result.m_Configs = kSelfTestConfigCount;
+
+	Runner runner(spec);
+	SelfTestSource source(runner);
+	while (!runner.IsFinished() && result.m_Ticks < 10000)
+	{
+		runner.Tick(source);
+		++result.m_Ticks;
+	}
+	result.Check(runner.IsFinished(), "the sweep never finished");
+
+	for (const char* error : source.m_Errors)
+		result.Check(false, error);
+
+	const std::vector<ConfigResult>& results = runner.GetResults();
+	result.Check(results.size() == kSelfTestConfigCount, "there isn't a result for every config");
+
+	for (uint32_t i = 0; i < kSelfTestConfigCount && i < results.size(); ++i)
+	{
+		const SelfTestConfig& expected = kSelfTestConfigs[i];
+		const ConfigResult& configResult = results[i];
+		const std::vector<Runner::ePhase>& phases = source.m_Phases[i];
+		result.m_FramesPrepared += (uint32_t)phases.size();
+
+		result.Check(configResult.m_Config.m_Scene == i, "results are out of order");
+		if (!expected.m_bSupported)
+		{
+			result.Check(configResult.m_bSkipped && phases.empty() && source.m_ApplyCalls[i] == 0, "an unsupported config wasn't skipped cleanly");
+			continue;
+		}
+		result.Check(!configResult.m_bSkipped, "a supported config was skipped");
+		result.Check(source.m_ApplyCalls[i] == expected.m_ApplyTries, "ApplyConfig() was called again once it went through");
+
+		// Every frame settles, warms up and is measured in that order, with nothing left over
+		std::vector<Runner::ePhase> expectedPhases(kSelfTestSettle, Runner::SETTLE);
+		expectedPhases.insert(expectedPhases.end(), expected.m_ExpectedWarmup, Runner::WARMUP);
+		expectedPhases.insert(expectedPhases.end(), expected.m_Frames, Runner::MEASURE);
+		result.Check(phases == expectedPhases, "frames didn't go settle, warmup, measure with the expected counts");
+
+		result.Check(configResult.m_WarmupFrames == expected.m_ExpectedWarmup, "warmup ended on the wrong frame");
+		result.Check(configResult.m_bReachedSteadyState == expected.m_bExpectSteady, "warmup was cut off for the wrong reason");
+
+		// Measured frames take 1..n ms, so the distribution follows from n
+		const float n = (float)expected.m_Frames;
+		const Distribution& frame = configResult.m_Frame;
+		result.Check(nearlyEqual(frame.m_Min, 1.f) && nearlyEqual(frame.m_Max, n) && nearlyEqual(frame.m_Mean, (n + 1.f) * 0.5f), "a config's frame times aren't the ones measured");
+		result.Check(nearlyEqual(frame.m_StdDev, std::sqrt((n * n - 1.f) / 12.f)), "a config's frame time deviation is off");
+		result.Check(nearlyEqual(frame.m_P50, 1.f + 0.50f * (n - 1.f)) && nearlyEqual(frame.m_P95, 1.f + 0.95f * (n - 1.f)) && nearlyEqual(frame.m_P99, 1.f + 0.99f * (n - 1.f)),
+			"a config's frame time percentiles are off");
+		result.Check(nearlyEqual(configResult.m_Cpu.m_P50, frame.m_P50 * 0.5f) && nearlyEqual(configResult.m_Gpu.m_P95, frame.m_P95 * 2.f), "CPU or GPU times got mixed up");
+	}
+
+	return result;
+}
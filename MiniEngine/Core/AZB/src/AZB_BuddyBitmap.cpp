@@ -0,0 +1,329 @@
+//===============================================================================
+// desc: The block bookkeeping behind BuddyAllocator, split out from the D3D side so it can be swapped and checked headless. The original free lists
+//       (a std::set per order) are kept as a reference, and the replacement tracks free blocks in a bitmap per order with a summary hierarchy
+//       above it, so finding, splitting and merging blocks is a handful of bit scans and never touches the heap.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_BuddyBitmap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint32_t LowestSetBit(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctzll(value);
+#endif
+	}
+}
+
+//===============================================================================
+
+Buddy::FreeListAllocator::FreeListAllocator(uint32_t maxOrder) : m_MaxOrder(maxOrder)
+{
+	Reset();
+}
+
+void Buddy::FreeListAllocator::Reset(void)
+{
+	m_FreeBlocks.clear();
+	m_FreeBlocks.resize(m_MaxOrder + 1);
+	m_FreeBlocks[m_MaxOrder].insert((size_t)0);
+	m_FreeUnits = (size_t)1 << m_MaxOrder;
+}
+
+size_t Buddy::FreeListAllocator::Allocate(uint32_t order)
+{
+	if (order > m_MaxOrder)
+		return kInvalidOffset;
+
+	size_t offset;
+	auto it = m_FreeBlocks[order].begin();
+	if (it == m_FreeBlocks[order].end())
+	{
+		// No free nodes in the requested pool. Try to find a higher-order block and split it
+		const size_t left = Allocate(order + 1);
+		if (left == kInvalidOffset)
+			return kInvalidOffset;
+
+		// Allocate(order + 1) took the whole of it off the count - hand the right half back
+		m_FreeBlocks[order].insert(left + ((size_t)1 << order));
+		m_FreeUnits += (size_t)1 << order;
+		offset = left;
+	}
+	else
+	{
+		offset = *it;
+		m_FreeBlocks[order].erase(it);
+		m_FreeUnits -= (size_t)1 << order;
+	}
+	return offset;
+}
+
+void Buddy::FreeListAllocator::Free(size_t offset, uint32_t order)
+{
+	const size_t size = (size_t)1 << order;
+	const size_t buddy = offset ^ size;
+
+	auto it = m_FreeBlocks[order].find(buddy);
+	if (it != m_FreeBlocks[order].end())
+	{
+		// The buddy is free, so the pair goes back as one block of the next order up
+		m_FreeBlocks[order].erase(it);
+		m_FreeUnits -= size;
+		Free(std::min(offset, buddy), order + 1);
+	}
+	else
+	{
+		m_FreeBlocks[order].insert(offset);
+		m_FreeUnits += size;
+	}
+}
+
+//===============================================================================
+
+Buddy::BitmapAllocator::BitmapAllocator(uint32_t maxOrder) : m_MaxOrder(std::min(maxOrder, 32u))
+{
+	// Lay every order's levels out back to back in one allocation
+	m_Orders.resize(m_MaxOrder + 1);
+	size_t words = 0;
+	for (uint32_t order = 0; order <= m_MaxOrder; ++order)
+	{
+		Order& layout = m_Orders[order];
+		size_t bits = (size_t)1 << (m_MaxOrder - order);
+		do
+		{
+			const size_t levelWords = (bits + 63) / 64;
+			layout.m_LevelStart[layout.m_Levels++] = words;
+			words += levelWords;
+			bits = levelWords;
+		} while (bits > 1);
+	}
+
+	m_Words.resize(words);
+	Reset();
+}
+
+void Buddy::BitmapAllocator::Reset(void)
+{
+	std::fill(m_Words.begin(), m_Words.end(), 0ull);
+	m_NonEmptyOrders = 0;
+	m_FreeUnits = 0;
+
+	Set(m_MaxOrder, 0);
+	m_FreeUnits = (size_t)1 << m_MaxOrder;
+}
+
+bool Buddy::BitmapAllocator::Test(uint32_t order, size_t block) const
+{
+	return (m_Words[m_Orders[order].m_LevelStart[0] + (block >> 6)] >> (block & 63)) & 1;
+}
+
+void Buddy::BitmapAllocator::Set(uint32_t order, size_t block)
+{
+	const Order& layout = m_Orders[order];
+	for (uint32_t level = 0; level < layout.m_Levels; ++level)
+	{
+		uint64_t& word = m_Words[layout.m_LevelStart[level] + (block >> 6)];
+		const bool bWasEmpty = word == 0;
+		word |= 1ull << (block & 63);
+
+		// The levels above already know about this word
+		if (!bWasEmpty)
+			return;
+		block >>= 6;
+	}
+
+	// Got past the top level, so this order has just gained its first free block
+	m_NonEmptyOrders |= 1ull << order;
+}
+
+void Buddy::BitmapAllocator::Clear(uint32_t order, size_t block)
+{
+	const Order& layout = m_Orders[order];
+	for (uint32_t level = 0; level < layout.m_Levels; ++level)
+	{
+		uint64_t& word = m_Words[layout.m_LevelStart[level] + (block >> 6)];
+		word &= ~(1ull << (block & 63));
+
+		// Other bits still set, so the levels above stay as they are
+		if (word != 0)
+			return;
+		block >>= 6;
+	}
+
+	m_NonEmptyOrders &= ~(1ull << order);
+}
+
+size_t Buddy::BitmapAllocator::FindFirst(uint32_t order) const
+{
+	const Order& layout = m_Orders[order];
+
+	// Down from the single top word, each set bit pointing at the first non-empty word on the level below
+	size_t block = 0;
+	for (uint32_t level = layout.m_Levels; level-- > 0;)
+	{
+		const uint64_t word = m_Words[layout.m_LevelStart[level] + block];
+		block = (block << 6) | LowestSetBit(word);
+	}
+	return block;
+}
+
+size_t Buddy::BitmapAllocator::Allocate(uint32_t order)
+{
+	if (order > m_MaxOrder)
+		return kInvalidOffset;
+
+	// The smallest order at or above the request that has anything free
+	const uint64_t usable = m_NonEmptyOrders & (~0ull << order);
+	if (usable == 0)
+		return kInvalidOffset;
+
+	uint32_t found = LowestSetBit(usable);
+	const size_t block = FindFirst(found);
+	Clear(found, block);
+
+	// Split it down, keeping the left half each time and freeing the right
+	const size_t offset = block << found;
+	while (found > order)
+	{
+		--found;
+		Set(found, (offset >> found) + 1);
+	}
+
+	m_FreeUnits -= (size_t)1 << order;
+	return offset;
+}
+
+void Buddy::BitmapAllocator::Free(size_t offset, uint32_t order)
+{
+	m_FreeUnits += (size_t)1 << order;
+
+	// Absorb the buddy for as long as it's free, moving up an order each time
+	while (order < m_MaxOrder)
+	{
+		const size_t buddy = (offset >> order) ^ 1;
+		if (!Test(order, buddy))
+			break;
+
+		Clear(order, buddy);
+		offset &= ~((size_t)1 << order);
+		++order;
+	}
+
+	Set(order, offset >> order);
+}
+
+//===============================================================================
+
+std::unique_ptr<Buddy::IBlockAllocator> Buddy::CreateBlockAllocator(eAllocatorType type, uint32_t maxOrder)
+{
+	if (type == ALLOCATOR_FREE_LIST)
+		return std::unique_ptr<IBlockAllocator>(new FreeListAllocator(maxOrder));
+	return std::unique_ptr<IBlockAllocator>(new BitmapAllocator(maxOrder));
+}
+
+namespace
+{
+	struct Operation
+	{
+		uint32_t m_Choice;		// Allocate or free, weighed against the fill level
+		uint32_t m_Order;		// If allocating
+		uint32_t m_Pick;		// Which live block, if freeing
+	};
+
+	// Replays the operations through one allocator, appending every offset it hands out. Returns nanoseconds per operation
+	double Replay(Buddy::IBlockAllocator& allocator, const std::vector<Operation>& operations, const Buddy::BenchmarkDesc& desc,
+		std::vector<size_t>& offsets)
+	{
+		struct Live
+		{
+			size_t m_Offset;
+			uint32_t m_Order;
+		};
+		std::vector<Live> live;
+		live.reserve(operations.size());
+
+		const double capacity = (double)((size_t)1 << allocator.GetMaxOrder());
+		const double range = std::max((double)(desc.m_HighFill - desc.m_LowFill), 1e-3);
+
+		const auto start = std::chrono::steady_clock::now();
+		for (const Operation& operation : operations)
+		{
+			// Always allocate below the low mark, always free above the high one, and lean between the two
+			const double fill = 1.0 - (double)allocator.GetFreeUnits() / capacity;
+			const double allocateChance = std::min(std::max((desc.m_HighFill - fill) / range, 0.0), 1.0);
+			const bool bAllocate = live.empty() || (double)(operation.m_Choice & 0xFFFF) / 65536.0 < allocateChance;
+
+			if (bAllocate)
+			{
+				const uint32_t order = operation.m_Order;
+				const size_t offset = allocator.Allocate(order);
+				offsets.push_back(offset);
+				if (offset != Buddy::kInvalidOffset)
+					live.push_back({ offset, order });
+			}
+			else
+			{
+				const size_t index = operation.m_Pick % live.size();
+				allocator.Free(live[index].m_Offset, live[index].m_Order);
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+		const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		for (const Live& block : live)
+			allocator.Free(block.m_Offset, block.m_Order);
+
+		return elapsed / std::max((double)operations.size(), 1.0);
+	}
+}
+
+Buddy::BenchmarkResult Buddy::RunBenchmark(const BenchmarkDesc& desc)
+{
+	// Same random numbers for both, drawn up front so neither run pays for them
+	std::vector<Operation> operations(desc.m_Operations);
+	std::mt19937 random(desc.m_Seed);
+	for (Operation& operation : operations)
+	{
+		operation.m_Choice = random();
+
+		// Squaring a uniform value skews requests towards small orders, as real buffers are
+		const uint32_t uniform = random() % 1024;
+		operation.m_Order = (uint32_t)((uint64_t)(uniform * uniform) * (desc.m_LargestRequestOrder + 1) >> 20);
+		operation.m_Pick = random();
+	}
+
+	FreeListAllocator freeList(desc.m_MaxOrder);
+	BitmapAllocator bitmap(desc.m_MaxOrder);
+
+	std::vector<size_t> freeListOffsets;
+	std::vector<size_t> bitmapOffsets;
+	freeListOffsets.reserve(operations.size());
+	bitmapOffsets.reserve(operations.size());
+
+	BenchmarkResult result;
+	result.m_FreeListNsPerOp = Replay(freeList, operations, desc, freeListOffsets);
+	result.m_BitmapNsPerOp = Replay(bitmap, operations, desc, bitmapOffsets);
+
+	result.m_bValid = freeListOffsets == bitmapOffsets && freeList.GetFreeUnits() == bitmap.GetFreeUnits() &&
+		bitmap.GetFreeUnits() == (size_t)1 << bitmap.GetMaxOrder();
+	result.m_Allocations = (uint32_t)freeListOffsets.size();
+	result.m_FailedAllocations = (uint32_t)std::count(freeListOffsets.begin(), freeListOffsets.end(), kInvalidOffset);
+
+	// Both should be back to a single free block - one more full-size allocation proves it
+	result.m_bValid = result.m_bValid && freeList.Allocate(desc.m_MaxOrder) == 0 && bitmap.Allocate(desc.m_MaxOrder) == 0;
+	return result;
+}
@@ -0,0 +1,547 @@
+//===============================================================================
+// desc: A persistent record of which converted files (DDS, .mini) were built from what. Entries are keyed by a content hash of the source plus the
+//       conversion flags and converter version, so touching a file (e.g. a fresh checkout) doesn't trigger a rebuild but changing its flags does.
+//       The index is lock-free, and large sources are hashed in parallel chunks. No D3D types, so it builds and runs anywhere.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ConversionCache.h"
+#include "AZB_DDSReader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#endif
+
+namespace
+{
+	const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+	const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+	const uint64_t kPrime3 = 0x165667B19E3779F9ull;
+	const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+	const uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+	uint64_t RotateLeft(uint64_t value, uint32_t bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	uint64_t Read64(const uint8_t* data)
+	{
+		uint64_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint32_t Read32(const uint8_t* data)
+	{
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint64_t Round(uint64_t accumulator, uint64_t input)
+	{
+		accumulator += input * kPrime2;
+		return RotateLeft(accumulator, 31) * kPrime1;
+	}
+
+	uint64_t MergeRound(uint64_t accumulator, uint64_t value)
+	{
+		accumulator ^= Round(0, value);
+		return accumulator * kPrime1 + kPrime4;
+	}
+
+	//===============================================================================
+	//
+	// On disk, a header followed by one fixed-size record per source
+	//
+
+	const uint32_t kFileMagic = 0x43425A41;		// "AZBC"
+	const uint32_t kFileVersion = 1;
+	const uint32_t kMaxRecords = 1u << 24;
+
+	struct FileHeader
+	{
+		uint32_t m_Magic;
+		uint32_t m_Version;
+		uint32_t m_Count;
+		uint32_t m_Reserved;
+	};
+
+	struct FileRecord
+	{
+		uint64_t m_PathHash;
+		uint64_t m_SourceSize;
+		int64_t m_SourceTime;
+		uint64_t m_OutputSize;
+		int64_t m_OutputTime;
+		uint64_t m_ContentHash;
+		uint32_t m_Flags;
+		uint32_t m_ConverterVersion;
+	};
+	static_assert(sizeof(FileRecord) == 56, "FileRecord is written as-is, so its layout mustn't change");
+
+	FILE* OpenFile(const std::wstring& fileName, bool bWrite)
+	{
+#if defined(_WIN32)
+		FILE* file = nullptr;
+		return _wfopen_s(&file, fileName.c_str(), bWrite ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+		return std::fopen(std::string(fileName.begin(), fileName.end()).c_str(), bWrite ? "wb" : "rb");
+#endif
+	}
+
+	bool ReplaceFile(const std::wstring& from, const std::wstring& to)
+	{
+#if defined(_WIN32)
+		return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return std::rename(std::string(from.begin(), from.end()).c_str(), std::string(to.begin(), to.end()).c_str()) == 0;
+#endif
+	}
+
+	uint32_t RoundUpToPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 16;
+		while (result < value && result < (1u << 31))
+			result <<= 1;
+		return result;
+	}
+}
+
+//===============================================================================
+
+uint64_t ConversionCache::HashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	const uint8_t* const end = bytes + size;
+	uint64_t hash;
+
+	if (size >= 32)
+	{
+		// Four independent lanes, so consecutive rounds don't wait on each other
+		uint64_t lanes[4] = { seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1 };
+		const uint8_t* const limit = end - 32;
+		do
+		{
+			for (uint32_t lane = 0; lane < 4; ++lane, bytes += 8)
+				lanes[lane] = Round(lanes[lane], Read64(bytes));
+		} while (bytes <= limit);
+
+		hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+		for (uint32_t lane = 0; lane < 4; ++lane)
+			hash = MergeRound(hash, lanes[lane]);
+	}
+	else
+	{
+		hash = seed + kPrime5;
+	}
+
+	hash += (uint64_t)size;
+
+	for (; bytes + 8 <= end; bytes += 8)
+		hash = RotateLeft(hash ^ Round(0, Read64(bytes)), 27) * kPrime1 + kPrime4;
+
+	if (bytes + 4 <= end)
+	{
+		hash = RotateLeft(hash ^ ((uint64_t)Read32(bytes) * kPrime1), 23) * kPrime2 + kPrime3;
+		bytes += 4;
+	}
+
+	for (; bytes < end; ++bytes)
+		hash = RotateLeft(hash ^ (*bytes * kPrime5), 11) * kPrime1;
+
+	hash ^= hash >> 33;
+	hash *= kPrime2;
+	hash ^= hash >> 29;
+	hash *= kPrime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+bool ConversionCache::HashFile(const std::wstring& fileName, uint64_t& hash, uint32_t maxThreads)
+{
+	DDSReader::MappedFile file;
+	if (!file.Open(fileName))
+	{
+		// Mapping refuses empty files, which still have a perfectly good hash
+		FileStamp stamp;
+		if (!GetFileStamp(fileName, stamp) || stamp.m_Size != 0)
+			return false;
+
+		hash = HashBytes(nullptr, 0, 0);
+		return true;
+	}
+
+	// Each chunk is hashed on its own, seeded with its index, then the chunk hashes are hashed together. Same answer however many threads
+	const size_t size = file.GetSize();
+	const uint32_t chunks = (uint32_t)((size + kHashChunkBytes - 1) / kHashChunkBytes);
+	std::vector<uint64_t> chunkHashes(chunks);
+
+	auto hashChunk = [&](uint32_t chunk)
+	{
+		const size_t offset = (size_t)chunk * kHashChunkBytes;
+		chunkHashes[chunk] = HashBytes(file.GetData() + offset, std::min(kHashChunkBytes, size - offset), chunk);
+	};
+
+	uint32_t threads = maxThreads != 0 ? maxThreads : std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, chunks);
+
+	if (threads <= 1)
+	{
+		for (uint32_t chunk = 0; chunk < chunks; ++chunk)
+			hashChunk(chunk);
+	}
+	else
+	{
+		std::atomic<uint32_t> nextChunk(0);
+		auto worker = [&]()
+		{
+			for (uint32_t chunk = nextChunk.fetch_add(1); chunk < chunks; chunk = nextChunk.fetch_add(1))
+				hashChunk(chunk);
+		};
+
+		std::vector<std::thread> pool;
+		for (uint32_t i = 1; i < threads; ++i)
+			pool.emplace_back(worker);
+		worker();
+
+		for (std::thread& thread : pool)
+			thread.join();
+	}
+
+	hash = HashBytes(chunkHashes.data(), chunkHashes.size() * sizeof(uint64_t), size);
+	return true;
+}
+
+uint64_t ConversionCache::HashPath(const std::wstring& fileName)
+{
+	// Fixed-width characters, so wchar_t's size doesn't change the answer
+	std::vector<uint32_t> characters(fileName.size());
+	for (size_t i = 0; i < fileName.size(); ++i)
+	{
+		uint32_t character = (uint32_t)fileName[i];
+		if (character >= 'A' && character <= 'Z')
+			character += 'a' - 'A';
+		else if (character == '\\')
+			character = '/';
+		characters[i] = character;
+	}
+
+	const uint64_t hash = HashBytes(characters.data(), characters.size() * sizeof(uint32_t), 0);
+
+	// 0 marks a free slot in the index
+	return hash != 0 ? hash : 1;
+}
+
+bool ConversionCache::GetFileStamp(const std::wstring& fileName, FileStamp& stamp)
+{
+#if defined(_WIN32)
+	struct _stat64 fileStat;
+	if (_wstat64(fileName.c_str(), &fileStat) != 0)
+		return false;
+#else
+	struct stat fileStat;
+	if (stat(std::string(fileName.begin(), fileName.end()).c_str(), &fileStat) != 0)
+		return false;
+#endif
+
+	stamp.m_Size = (uint64_t)fileStat.st_size;
+	stamp.m_ModifiedTime = (int64_t)fileStat.st_mtime;
+	return true;
+}
+
+//===============================================================================
+
+ConversionCache::Cache::Cache(uint32_t capacity) :
+	m_MinCapacity(RoundUpToPowerOfTwo(capacity)),
+	m_Retired(nullptr),
+	m_bDirty(false),
+	m_UpToDate(0),
+	m_Stale(0),
+	m_Unknown(0),
+	m_FilesHashed(0),
+	m_BytesHashed(0),
+	m_Dropped(0)
+{
+	Allocate(m_MinCapacity);
+}
+
+ConversionCache::Cache::~Cache()
+{
+	Clear();
+}
+
+void ConversionCache::Cache::Allocate(uint32_t capacity)
+{
+	m_Slots.reset(new Slot[capacity]);
+	m_Mask = capacity - 1;
+	for (uint32_t i = 0; i < capacity; ++i)
+	{
+		m_Slots[i].m_PathHash.store(0, std::memory_order_relaxed);
+		m_Slots[i].m_Entry.store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+void ConversionCache::Cache::Clear(void)
+{
+	for (uint32_t i = 0; i <= m_Mask; ++i)
+	{
+		delete m_Slots[i].m_Entry.exchange(nullptr, std::memory_order_relaxed);
+		m_Slots[i].m_PathHash.store(0, std::memory_order_relaxed);
+	}
+
+	Entry* retired = m_Retired.exchange(nullptr, std::memory_order_acquire);
+	while (retired != nullptr)
+	{
+		Entry* next = retired->m_pNextRetired;
+		delete retired;
+		retired = next;
+	}
+}
+
+const ConversionCache::Cache::Entry* ConversionCache::Cache::Find(uint64_t pathHash) const
+{
+	for (uint32_t probe = 0; probe <= m_Mask; ++probe)
+	{
+		const Slot& slot = m_Slots[(pathHash + probe) & m_Mask];
+		const uint64_t slotHash = slot.m_PathHash.load(std::memory_order_acquire);
+		if (slotHash == pathHash)
+			return slot.m_Entry.load(std::memory_order_acquire);	// Null if the slot's first entry is still on its way in
+		if (slotHash == 0)
+			return nullptr;
+	}
+	return nullptr;
+}
+
+bool ConversionCache::Cache::Publish(Entry* entry)
+{
+	for (uint32_t probe = 0; probe <= m_Mask; ++probe)
+	{
+		Slot& slot = m_Slots[(entry->m_PathHash + probe) & m_Mask];
+		uint64_t slotHash = slot.m_PathHash.load(std::memory_order_acquire);
+
+		// Claim a free slot. Losing the race leaves slotHash holding the winner's path, which may well be this one
+		if (slotHash == 0 && slot.m_PathHash.compare_exchange_strong(slotHash, entry->m_PathHash, std::memory_order_acq_rel))
+			slotHash = entry->m_PathHash;
+
+		if (slotHash == entry->m_PathHash)
+		{
+			Entry* previous = slot.m_Entry.exchange(entry, std::memory_order_acq_rel);
+			if (previous != nullptr)
+				Retire(previous);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ConversionCache::Cache::Retire(Entry* entry)
+{
+	entry->m_pNextRetired = m_Retired.load(std::memory_order_relaxed);
+	while (!m_Retired.compare_exchange_weak(entry->m_pNextRetired, entry, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+}
+
+bool ConversionCache::Cache::Load(const std::wstring& fileName)
+{
+	Clear();
+	m_bDirty.store(false, std::memory_order_relaxed);
+
+	FILE* file = OpenFile(fileName, false);
+	if (file == nullptr)
+		return false;
+
+	FileHeader header = {};
+	std::vector<FileRecord> records;
+	bool bValid = std::fread(&header, sizeof(header), 1, file) == 1 && header.m_Magic == kFileMagic && header.m_Version == kFileVersion &&
+		header.m_Count <= kMaxRecords;
+	if (bValid)
+	{
+		records.resize(header.m_Count);
+		bValid = records.empty() || std::fread(records.data(), sizeof(FileRecord), records.size(), file) == records.size();
+	}
+	std::fclose(file);
+
+	if (!bValid)
+		return false;
+
+	// Keep the table at most half full, so probes stay short
+	const uint32_t capacity = std::max(m_MinCapacity, RoundUpToPowerOfTwo(header.m_Count * 2));
+	if (capacity != m_Mask + 1)
+		Allocate(capacity);
+
+	for (const FileRecord& record : records)
+	{
+		Entry* entry = new Entry();
+		entry->m_PathHash = record.m_PathHash != 0 ? record.m_PathHash : 1;
+		entry->m_Source.m_Size = record.m_SourceSize;
+		entry->m_Source.m_ModifiedTime = record.m_SourceTime;
+		entry->m_Output.m_Size = record.m_OutputSize;
+		entry->m_Output.m_ModifiedTime = record.m_OutputTime;
+		entry->m_Key.m_ContentHash = record.m_ContentHash;
+		entry->m_Key.m_Flags = record.m_Flags;
+		entry->m_Key.m_ConverterVersion = record.m_ConverterVersion;
+		entry->m_pNextRetired = nullptr;
+
+		if (!Publish(entry))
+			delete entry;
+	}
+	return true;
+}
+
+bool ConversionCache::Cache::Save(const std::wstring& fileName) const
+{
+	// Cleared first, so anything recorded while this runs still marks the cache dirty
+	m_bDirty.store(false, std::memory_order_relaxed);
+
+	std::vector<FileRecord> records;
+	for (uint32_t i = 0; i <= m_Mask; ++i)
+	{
+		const Entry* entry = m_Slots[i].m_Entry.load(std::memory_order_acquire);
+		if (entry == nullptr)
+			continue;
+
+		FileRecord record;
+		record.m_PathHash = entry->m_PathHash;
+		record.m_SourceSize = entry->m_Source.m_Size;
+		record.m_SourceTime = entry->m_Source.m_ModifiedTime;
+		record.m_OutputSize = entry->m_Output.m_Size;
+		record.m_OutputTime = entry->m_Output.m_ModifiedTime;
+		record.m_ContentHash = entry->m_Key.m_ContentHash;
+		record.m_Flags = entry->m_Key.m_Flags;
+		record.m_ConverterVersion = entry->m_Key.m_ConverterVersion;
+		records.push_back(record);
+	}
+
+	FileHeader header = {};
+	header.m_Magic = kFileMagic;
+	header.m_Version = kFileVersion;
+	header.m_Count = (uint32_t)records.size();
+
+	const std::wstring tempName = fileName + L".tmp";
+	FILE* file = OpenFile(tempName, true);
+	bool bWritten = file != nullptr;
+	if (bWritten)
+	{
+		bWritten = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+			(records.empty() || std::fwrite(records.data(), sizeof(FileRecord), records.size(), file) == records.size());
+		bWritten = std::fclose(file) == 0 && bWritten;
+	}
+
+	if (!bWritten || !ReplaceFile(tempName, fileName))
+	{
+		m_bDirty.store(true, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+ConversionCache::eStatus ConversionCache::Cache::Check(const std::wstring& sourceFile, const std::wstring& outputFile, uint32_t flags,
+	uint32_t converterVersion, Key& key)
+{
+	key = Key();
+	key.m_Flags = flags;
+	key.m_ConverterVersion = converterVersion;
+
+	FileStamp source;
+	if (!GetFileStamp(sourceFile, source))
+	{
+		m_Unknown.fetch_add(1, std::memory_order_relaxed);
+		return STATUS_UNKNOWN;
+	}
+
+	const Entry* entry = Find(HashPath(sourceFile));
+
+	// An untouched source still has the hash it was recorded with - only hash it if it has moved, or was never seen
+	if (entry != nullptr && entry->m_Source == source)
+	{
+		key.m_ContentHash = entry->m_Key.m_ContentHash;
+	}
+	else
+	{
+		if (!HashFile(sourceFile, key.m_ContentHash))
+		{
+			m_Unknown.fetch_add(1, std::memory_order_relaxed);
+			return STATUS_UNKNOWN;
+		}
+
+		m_FilesHashed.fetch_add(1, std::memory_order_relaxed);
+		m_BytesHashed.fetch_add(source.m_Size, std::memory_order_relaxed);
+	}
+
+	if (entry == nullptr)
+	{
+		m_Unknown.fetch_add(1, std::memory_order_relaxed);
+		return STATUS_UNKNOWN;
+	}
+
+	FileStamp output;
+	if (!GetFileStamp(outputFile, output) || output != entry->m_Output || !(entry->m_Key == key))
+	{
+		m_Stale.fetch_add(1, std::memory_order_relaxed);
+		return STATUS_STALE;
+	}
+
+	// Same contents under a new timestamp, as after a checkout. Remember the new one so it isn't hashed again next time
+	if (entry->m_Source != source)
+	{
+		Entry* updated = new Entry(*entry);
+		updated->m_Source = source;
+		updated->m_pNextRetired = nullptr;
+		if (Publish(updated))
+			m_bDirty.store(true, std::memory_order_relaxed);
+		else
+			delete updated;
+	}
+
+	m_UpToDate.fetch_add(1, std::memory_order_relaxed);
+	return STATUS_UP_TO_DATE;
+}
+
+void ConversionCache::Cache::Record(const std::wstring& sourceFile, const std::wstring& outputFile, const Key& key)
+{
+	Entry* entry = new Entry();
+	entry->m_PathHash = HashPath(sourceFile);
+	entry->m_Key = key;
+	entry->m_pNextRetired = nullptr;
+
+	if (!GetFileStamp(sourceFile, entry->m_Source) || !GetFileStamp(outputFile, entry->m_Output))
+	{
+		delete entry;
+		return;
+	}
+
+	if (!Publish(entry))
+	{
+		delete entry;
+		m_Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	m_bDirty.store(true, std::memory_order_relaxed);
+}
+
+ConversionCache::Stats ConversionCache::Cache::GetStats(void) const
+{
+	Stats stats;
+	stats.m_UpToDate = m_UpToDate.load(std::memory_order_relaxed);
+	stats.m_Stale = m_Stale.load(std::memory_order_relaxed);
+	stats.m_Unknown = m_Unknown.load(std::memory_order_relaxed);
+	stats.m_FilesHashed = m_FilesHashed.load(std::memory_order_relaxed);
+	stats.m_BytesHashed = m_BytesHashed.load(std::memory_order_relaxed);
+	stats.m_Dropped = m_Dropped.load(std::memory_order_relaxed);
+	return stats;
+}
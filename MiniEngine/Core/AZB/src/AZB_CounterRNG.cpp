@@ -0,0 +1,133 @@
+//===============================================================================
+// desc: Counter-based random numbers (Philox4x32-10, from Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3"). Each number is a pure
+//       function of a key and a position, so any thread can jump straight to its share of a sequence, and nothing depends on the standard library's
+//       engines or distributions, which is what makes Math::RandomNumberGenerator give different numbers on different platforms.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_CounterRNG.h"
+
+#include <cstring>
+
+namespace
+{
+	constexpr uint32_t kMultiplier0 = 0xD2511F53u;
+	constexpr uint32_t kMultiplier1 = 0xCD9E8D57u;
+	constexpr uint32_t kWeyl0 = 0x9E3779B9u;
+	constexpr uint32_t kWeyl1 = 0xBB67AE85u;
+	constexpr uint32_t kRounds = 10;
+
+	void MulHiLo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo)
+	{
+		const uint64_t product = (uint64_t)a * b;
+		hi = (uint32_t)(product >> 32);
+		lo = (uint32_t)product;
+	}
+}
+
+CounterRNG::Block CounterRNG::Philox4x32(const uint32_t counter[4], const uint32_t key[2])
+{
+	uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	uint32_t k0 = key[0], k1 = key[1];
+
+	for (uint32_t round = 0; round < kRounds; ++round)
+	{
+		uint32_t hi0, lo0, hi1, lo1;
+		MulHiLo(kMultiplier0, c0, hi0, lo0);
+		MulHiLo(kMultiplier1, c2, hi1, lo1);
+
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+
+		k0 += kWeyl0;
+		k1 += kWeyl1;
+	}
+
+	Block block = { { c0, c1, c2, c3 } };
+	return block;
+}
+
+//===============================================================================
+
+CounterRNG::Stream::Stream(uint64_t seed, uint64_t streamIndex)
+{
+	m_Key[0] = (uint32_t)seed;
+	m_Key[1] = (uint32_t)(seed >> 32);
+	m_Counter[2] = (uint32_t)streamIndex;
+	m_Counter[3] = (uint32_t)(streamIndex >> 32);
+	Seek(0);
+}
+
+void CounterRNG::Stream::Seek(uint64_t index)
+{
+	// Four numbers to a block
+	const uint64_t block = index / 4;
+	m_Counter[0] = (uint32_t)block;
+	m_Counter[1] = (uint32_t)(block >> 32);
+	m_Block = Philox4x32(m_Counter, m_Key);
+	m_Used = (uint32_t)(index % 4);
+}
+
+uint32_t CounterRNG::Stream::NextUint(void)
+{
+	if (m_Used == 4)
+	{
+		if (++m_Counter[0] == 0)
+			++m_Counter[1];
+		m_Block = Philox4x32(m_Counter, m_Key);
+		m_Used = 0;
+	}
+	return m_Block.m_Words[m_Used++];
+}
+
+int32_t CounterRNG::Stream::NextInt(int32_t maxVal)
+{
+	return NextInt(0, maxVal);
+}
+
+int32_t CounterRNG::Stream::NextInt(int32_t minVal, int32_t maxVal)
+{
+	// Scaled rather than rejected, so every call takes exactly one number. The bias is at most range / 2^32
+	const uint64_t range = (uint64_t)((int64_t)maxVal - minVal) + 1;
+	return (int32_t)((int64_t)minVal + (int64_t)(((uint64_t)NextUint() * range) >> 32));
+}
+
+float CounterRNG::Stream::NextFloat(float maxVal)
+{
+	// The top 24 bits, which a float holds exactly
+	return (float)(NextUint() >> 8) * (1.0f / 16777216.0f) * maxVal;
+}
+
+float CounterRNG::Stream::NextFloat(float minVal, float maxVal)
+{
+	return minVal + NextFloat(maxVal - minVal);
+}
+
+//===============================================================================
+
+bool CounterRNG::SelfTest(void)
+{
+	struct KnownAnswer
+	{
+		uint32_t m_Counter[4];
+		uint32_t m_Key[2];
+		uint32_t m_Expected[4];
+	};
+
+	// From the Random123 distribution's kat_vectors
+	const KnownAnswer answers[] =
+	{
+		{ { 0, 0, 0, 0 }, { 0, 0 }, { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+		{ { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }, { 0xffffffff, 0xffffffff }, { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+		{ { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, { 0xa4093822, 0x299f31d0 }, { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+	};
+
+	for (const KnownAnswer& answer : answers)
+	{
+		const Block block = Philox4x32(answer.m_Counter, answer.m_Key);
+		if (std::memcmp(block.m_Words, answer.m_Expected, sizeof(answer.m_Expected)) != 0)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,949 @@
+//===============================================================================
+// desc: A zero-copy DDS reader. Files are memory-mapped rather than read into a buffer, the header is validated once, and every mip of every array slice
+//       is exposed as a view straight into the mapping - the only copy left is the one into the upload heap. No D3D types, so it builds and runs anywhere.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_DDSReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//===============================================================================
+//
+// File layout. Mirrors dds.h, which can't be used here as it needs the DXGI headers
+//
+
+namespace
+{
+	constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+	}
+
+	constexpr uint32_t kMagic = MakeFourCC('D', 'D', 'S', ' ');
+
+	// Pixel format flags
+	constexpr uint32_t kFlagFourCC = 0x4;
+	constexpr uint32_t kFlagRGB = 0x40;
+	constexpr uint32_t kFlagLuminance = 0x20000;
+	constexpr uint32_t kFlagAlpha = 0x2;
+
+	// Header flags and caps
+	constexpr uint32_t kHeaderFlagHeight = 0x2;
+	constexpr uint32_t kHeaderFlagVolume = 0x800000;
+	constexpr uint32_t kCaps2CubeMap = 0x200;
+	constexpr uint32_t kCaps2AllFaces = 0xFC00 | kCaps2CubeMap;
+	constexpr uint32_t kMiscTextureCube = 0x4;
+	constexpr uint32_t kMiscFlags2AlphaModeMask = 0x7;
+
+	// The D3D12 hardware limits - nothing in a file is trusted beyond these
+	constexpr uint32_t kMaxMipLevels = 15;
+	constexpr uint32_t kMaxDimension1D2D = 16384;
+	constexpr uint32_t kMaxDimension3D = 2048;
+	constexpr uint32_t kMaxArraySize = 2048;
+
+#pragma pack(push, 1)
+	struct PixelFormat
+	{
+		uint32_t m_Size;
+		uint32_t m_Flags;
+		uint32_t m_FourCC;
+		uint32_t m_RGBBitCount;
+		uint32_t m_RBitMask;
+		uint32_t m_GBitMask;
+		uint32_t m_BBitMask;
+		uint32_t m_ABitMask;
+	};
+
+	struct Header
+	{
+		uint32_t m_Size;
+		uint32_t m_Flags;
+		uint32_t m_Height;
+		uint32_t m_Width;
+		uint32_t m_PitchOrLinearSize;
+		uint32_t m_Depth;
+		uint32_t m_MipMapCount;
+		uint32_t m_Reserved1[11];
+		PixelFormat m_PixelFormat;
+		uint32_t m_Caps;
+		uint32_t m_Caps2;
+		uint32_t m_Caps3;
+		uint32_t m_Caps4;
+		uint32_t m_Reserved2;
+	};
+
+	struct HeaderDX10
+	{
+		uint32_t m_Format;
+		uint32_t m_ResourceDimension;
+		uint32_t m_MiscFlag;
+		uint32_t m_ArraySize;
+		uint32_t m_MiscFlags2;
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(Header) == 124, "DDS header size mismatch");
+	static_assert(sizeof(HeaderDX10) == 20, "DDS DX10 header size mismatch");
+
+	// The DXGI_FORMAT values this file needs to name
+	enum : uint32_t
+	{
+		kFormatUnknown = 0,
+		kFormatR32G32B32A32Float = 2,
+		kFormatR16G16B16A16Float = 10,
+		kFormatR16G16B16A16Unorm = 11,
+		kFormatR16G16B16A16Snorm = 13,
+		kFormatR32G32Float = 16,
+		kFormatR10G10B10A2Unorm = 24,
+		kFormatR8G8B8A8Unorm = 28,
+		kFormatR16G16Float = 34,
+		kFormatR16G16Unorm = 35,
+		kFormatR32Float = 41,
+		kFormatR8G8Unorm = 49,
+		kFormatR16Float = 54,
+		kFormatR16Unorm = 56,
+		kFormatR8Unorm = 61,
+		kFormatA8Unorm = 65,
+		kFormatBC1Unorm = 71,
+		kFormatBC2Unorm = 74,
+		kFormatBC3Unorm = 77,
+		kFormatBC4Unorm = 80,
+		kFormatBC4Snorm = 81,
+		kFormatBC5Unorm = 83,
+		kFormatBC5Snorm = 84,
+		kFormatB5G6R5Unorm = 85,
+		kFormatB5G5R5A1Unorm = 86,
+		kFormatB8G8R8A8Unorm = 87,
+		kFormatB8G8R8X8Unorm = 88,
+		kFormatB4G4R4A4Unorm = 115
+	};
+
+	// How a format is laid out in memory. Zero bits means it's not something this reader handles
+	struct FormatInfo
+	{
+		uint32_t m_BitsPerPixel = 0;
+		uint32_t m_BytesPerBlock = 0;	// Non-zero for block compressed formats
+	};
+
+	FormatInfo GetFormatInfo(uint32_t format)
+	{
+		FormatInfo info;
+
+		if (format >= 1 && format <= 4)				info.m_BitsPerPixel = 128;	// R32G32B32A32
+		else if (format >= 5 && format <= 8)		info.m_BitsPerPixel = 96;	// R32G32B32
+		else if (format >= 9 && format <= 22)		info.m_BitsPerPixel = 64;	// R16G16B16A16, R32G32, R32G8X24
+		else if (format >= 23 && format <= 47)		info.m_BitsPerPixel = 32;	// R10G10B10A2 through R24G8
+		else if (format >= 48 && format <= 59)		info.m_BitsPerPixel = 16;	// R8G8, R16
+		else if (format >= 60 && format <= 65)		info.m_BitsPerPixel = 8;	// R8, A8
+		else if (format == 67)						info.m_BitsPerPixel = 32;	// R9G9B9E5
+		else if (format == 85 || format == 86)		info.m_BitsPerPixel = 16;	// B5G6R5, B5G5R5A1
+		else if (format >= 87 && format <= 93)		info.m_BitsPerPixel = 32;	// B8G8R8A8 and friends
+		else if (format == 115)						info.m_BitsPerPixel = 16;	// B4G4R4A4
+		else if ((format >= 70 && format <= 72) || (format >= 79 && format <= 81))
+		{
+			// BC1, BC4
+			info.m_BitsPerPixel = 4;
+			info.m_BytesPerBlock = 8;
+		}
+		else if ((format >= 73 && format <= 78) || (format >= 82 && format <= 84) || (format >= 94 && format <= 99))
+		{
+			// BC2, BC3, BC5, BC6H, BC7
+			info.m_BitsPerPixel = 8;
+			info.m_BytesPerBlock = 16;
+		}
+
+		// R1, the packed 4:2:2 formats, the video formats and the palettised ones are all left at zero
+		return info;
+	}
+
+	bool IsBitMask(const PixelFormat& pf, uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+	{
+		return pf.m_RBitMask == r && pf.m_GBitMask == g && pf.m_BBitMask == b && pf.m_ABitMask == a;
+	}
+
+	// Legacy (non-DX10) pixel formats, following GetDXGIFormat in DDSTextureLoader.cpp minus the packed formats
+	uint32_t GetLegacyFormat(const PixelFormat& pf)
+	{
+		if (pf.m_Flags & kFlagRGB)
+		{
+			switch (pf.m_RGBBitCount)
+			{
+			case 32:
+				if (IsBitMask(pf, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return kFormatR8G8B8A8Unorm;
+				if (IsBitMask(pf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) return kFormatB8G8R8A8Unorm;
+				if (IsBitMask(pf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000)) return kFormatB8G8R8X8Unorm;
+				if (IsBitMask(pf, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000)) return kFormatR10G10B10A2Unorm;	// D3DX writes the masks swapped
+				if (IsBitMask(pf, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) return kFormatR16G16Unorm;
+				if (IsBitMask(pf, 0xffffffff, 0x00000000, 0x00000000, 0x00000000)) return kFormatR32Float;
+				break;
+
+			case 16:
+				if (IsBitMask(pf, 0x7c00, 0x03e0, 0x001f, 0x8000)) return kFormatB5G5R5A1Unorm;
+				if (IsBitMask(pf, 0xf800, 0x07e0, 0x001f, 0x0000)) return kFormatB5G6R5Unorm;
+				if (IsBitMask(pf, 0x0f00, 0x00f0, 0x000f, 0xf000)) return kFormatB4G4R4A4Unorm;
+				break;
+			}
+		}
+		else if (pf.m_Flags & kFlagLuminance)
+		{
+			if (pf.m_RGBBitCount == 8 && IsBitMask(pf, 0x000000ff, 0, 0, 0)) return kFormatR8Unorm;
+			if (pf.m_RGBBitCount == 16 && IsBitMask(pf, 0x0000ffff, 0, 0, 0)) return kFormatR16Unorm;
+			if (pf.m_RGBBitCount == 16 && IsBitMask(pf, 0x000000ff, 0, 0, 0x0000ff00)) return kFormatR8G8Unorm;
+		}
+		else if (pf.m_Flags & kFlagAlpha)
+		{
+			if (pf.m_RGBBitCount == 8) return kFormatA8Unorm;
+		}
+		else if (pf.m_Flags & kFlagFourCC)
+		{
+			switch (pf.m_FourCC)
+			{
+			case MakeFourCC('D', 'X', 'T', '1'): return kFormatBC1Unorm;
+			case MakeFourCC('D', 'X', 'T', '2'):
+			case MakeFourCC('D', 'X', 'T', '3'): return kFormatBC2Unorm;
+			case MakeFourCC('D', 'X', 'T', '4'):
+			case MakeFourCC('D', 'X', 'T', '5'): return kFormatBC3Unorm;
+			case MakeFourCC('A', 'T', 'I', '1'):
+			case MakeFourCC('B', 'C', '4', 'U'): return kFormatBC4Unorm;
+			case MakeFourCC('B', 'C', '4', 'S'): return kFormatBC4Snorm;
+			case MakeFourCC('A', 'T', 'I', '2'):
+			case MakeFourCC('B', 'C', '5', 'U'): return kFormatBC5Unorm;
+			case MakeFourCC('B', 'C', '5', 'S'): return kFormatBC5Snorm;
+
+			// D3DFORMAT values stored as the FourCC
+			case 36:  return kFormatR16G16B16A16Unorm;
+			case 110: return kFormatR16G16B16A16Snorm;
+			case 111: return kFormatR16Float;
+			case 112: return kFormatR16G16Float;
+			case 113: return kFormatR16G16B16A16Float;
+			case 114: return kFormatR32Float;
+			case 115: return kFormatR32G32Float;
+			case 116: return kFormatR32G32B32A32Float;
+			}
+		}
+
+		return kFormatUnknown;
+	}
+
+	// Alpha mode as DDSTextureLoader's GetAlphaMode reports it
+	uint32_t GetAlphaModeFromHeader(const Header& header, const HeaderDX10* dx10)
+	{
+		if (dx10 != nullptr)
+		{
+			const uint32_t mode = dx10->m_MiscFlags2 & kMiscFlags2AlphaModeMask;
+			return mode <= 4 ? mode : 0;
+		}
+
+		if ((header.m_PixelFormat.m_Flags & kFlagFourCC) &&
+			(header.m_PixelFormat.m_FourCC == MakeFourCC('D', 'X', 'T', '2') || header.m_PixelFormat.m_FourCC == MakeFourCC('D', 'X', 'T', '4')))
+			return 2;	// Premultiplied
+
+		return 0;
+	}
+}
+
+//===============================================================================
+//
+// Mapped File
+//
+
+DDSReader::MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+DDSReader::MappedFile& DDSReader::MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(m_Data, other.m_Data);
+		std::swap(m_Size, other.m_Size);
+#if defined(_WIN32)
+		std::swap(m_Mapping, other.m_Mapping);
+#endif
+	}
+	return *this;
+}
+
+#if defined(_WIN32)
+
+bool DDSReader::MappedFile::Open(const std::wstring& fileName)
+{
+	Close();
+
+	HANDLE file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// The mapping and view keep the file alive on their own
+	m_Mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (m_Mapping == nullptr)
+		return false;
+
+	m_Data = (const uint8_t*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_Data == nullptr)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+		return false;
+	}
+
+	m_Size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void DDSReader::MappedFile::Close(void)
+{
+	if (m_Data != nullptr)
+		UnmapViewOfFile(m_Data);
+	if (m_Mapping != nullptr)
+		CloseHandle(m_Mapping);
+
+	m_Data = nullptr;
+	m_Mapping = nullptr;
+	m_Size = 0;
+}
+
+void DDSReader::MappedFile::Prefetch(void) const
+{
+	if (m_Data == nullptr)
+		return;
+
+	// One large read request up front rather than a fault per page
+	WIN32_MEMORY_RANGE_ENTRY range = { (void*)m_Data, m_Size };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+	// The prefetch is only a hint, so touch every page to make sure the I/O has actually happened here
+	volatile uint8_t sink = 0;
+	for (size_t offset = 0; offset < m_Size; offset += 4096)
+		sink ^= m_Data[offset];
+}
+
+#else
+
+bool DDSReader::MappedFile::Open(const std::wstring& fileName)
+{
+	Close();
+
+	int file = open(std::string(fileName.begin(), fileName.end()).c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size <= 0)
+	{
+		close(file);
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_Data = (const uint8_t*)data;
+	m_Size = (size_t)fileStat.st_size;
+	return true;
+}
+
+void DDSReader::MappedFile::Close(void)
+{
+	if (m_Data != nullptr)
+		munmap((void*)m_Data, m_Size);
+
+	m_Data = nullptr;
+	m_Size = 0;
+}
+
+void DDSReader::MappedFile::Prefetch(void) const
+{
+	if (m_Data == nullptr)
+		return;
+
+	madvise((void*)m_Data, m_Size, MADV_WILLNEED);
+
+	volatile uint8_t sink = 0;
+	for (size_t offset = 0; offset < m_Size; offset += 4096)
+		sink ^= m_Data[offset];
+}
+
+#endif
+
+//===============================================================================
+//
+// DDS File
+//
+
+const char* DDSReader::GetResultString(eResult result)
+{
+	switch (result)
+	{
+	case RESULT_OK:					return "OK";
+	case RESULT_TOO_SMALL:			return "File too small";
+	case RESULT_BAD_MAGIC:			return "Not a DDS file";
+	case RESULT_BAD_HEADER:			return "Invalid header";
+	case RESULT_UNSUPPORTED_FORMAT:	return "Unsupported format";
+	case RESULT_BAD_DIMENSIONS:		return "Invalid dimensions";
+	case RESULT_TRUNCATED:			return "Data truncated";
+	}
+	return "Unknown";
+}
+
+DDSReader::eResult DDSReader::DDSFile::Parse(const uint8_t* data, size_t size)
+{
+	*this = DDSFile();
+
+	if (data == nullptr || size < sizeof(uint32_t) + sizeof(Header))
+		return RESULT_TOO_SMALL;
+
+	// Copy the headers out rather than casting - mapped data has no alignment guarantees past the page
+	uint32_t magic;
+	std::memcpy(&magic, data, sizeof(magic));
+	if (magic != kMagic)
+		return RESULT_BAD_MAGIC;
+
+	Header header;
+	std::memcpy(&header, data + sizeof(uint32_t), sizeof(header));
+	if (header.m_Size != sizeof(Header) || header.m_PixelFormat.m_Size != sizeof(PixelFormat))
+		return RESULT_BAD_HEADER;
+
+	size_t offset = sizeof(uint32_t) + sizeof(Header);
+
+	HeaderDX10 dx10;
+	const bool bHasDX10 = (header.m_PixelFormat.m_Flags & kFlagFourCC) && header.m_PixelFormat.m_FourCC == MakeFourCC('D', 'X', '1', '0');
+	if (bHasDX10)
+	{
+		if (size < offset + sizeof(HeaderDX10))
+			return RESULT_TOO_SMALL;
+
+		std::memcpy(&dx10, data + offset, sizeof(dx10));
+		offset += sizeof(HeaderDX10);
+	}
+
+	m_Width = header.m_Width;
+	m_Height = header.m_Height;
+	m_Depth = header.m_Depth;
+	m_MipCount = std::max(header.m_MipMapCount, 1u);
+	m_ArraySize = 1;
+	m_AlphaMode = GetAlphaModeFromHeader(header, bHasDX10 ? &dx10 : nullptr);
+
+	if (bHasDX10)
+	{
+		m_Format = dx10.m_Format;
+		m_ArraySize = dx10.m_ArraySize;
+		if (m_ArraySize == 0)
+			return RESULT_BAD_HEADER;
+
+		switch (dx10.m_ResourceDimension)
+		{
+		case DIMENSION_TEXTURE1D:
+			// D3DX writes 1D textures with a fixed height of 1
+			if ((header.m_Flags & kHeaderFlagHeight) && m_Height != 1)
+				return RESULT_BAD_HEADER;
+			m_Height = m_Depth = 1;
+			break;
+
+		case DIMENSION_TEXTURE2D:
+			if (dx10.m_MiscFlag & kMiscTextureCube)
+			{
+				if (m_ArraySize > kMaxArraySize / 6)
+					return RESULT_BAD_DIMENSIONS;
+				m_ArraySize *= 6;
+				m_bCubeMap = true;
+			}
+			m_Depth = 1;
+			break;
+
+		case DIMENSION_TEXTURE3D:
+			if (!(header.m_Flags & kHeaderFlagVolume) || m_ArraySize > 1)
+				return RESULT_BAD_HEADER;
+			break;
+
+		default:
+			return RESULT_BAD_HEADER;
+		}
+
+		m_Dimension = (eDimension)dx10.m_ResourceDimension;
+	}
+	else
+	{
+		m_Format = GetLegacyFormat(header.m_PixelFormat);
+
+		if (header.m_Flags & kHeaderFlagVolume)
+		{
+			m_Dimension = DIMENSION_TEXTURE3D;
+		}
+		else
+		{
+			if (header.m_Caps2 & kCaps2CubeMap)
+			{
+				// All six faces or nothing
+				if ((header.m_Caps2 & kCaps2AllFaces) != kCaps2AllFaces)
+					return RESULT_UNSUPPORTED_FORMAT;
+
+				m_ArraySize = 6;
+				m_bCubeMap = true;
+			}
+
+			m_Depth = 1;
+			m_Dimension = DIMENSION_TEXTURE2D;
+		}
+	}
+
+	if (GetFormatInfo(m_Format).m_BitsPerPixel == 0)
+		return RESULT_UNSUPPORTED_FORMAT;
+
+	// Bound everything before it's used to size anything
+	const uint32_t maxDimension = m_Dimension == DIMENSION_TEXTURE3D ? kMaxDimension3D : kMaxDimension1D2D;
+	if (m_Width == 0 || m_Height == 0 || m_Depth == 0 || m_Width > maxDimension || m_Height > maxDimension || m_Depth > maxDimension)
+		return RESULT_BAD_DIMENSIONS;
+	if (m_ArraySize > kMaxArraySize || m_MipCount > kMaxMipLevels)
+		return RESULT_BAD_DIMENSIONS;
+
+	m_BitData = data + offset;
+	m_BitSize = size - offset;
+	return Layout();
+}
+
+DDSReader::eResult DDSReader::DDSFile::Layout(void)
+{
+	const FormatInfo info = GetFormatInfo(m_Format);
+
+	m_Subresources.resize((size_t)m_MipCount * m_ArraySize);
+
+	// Slices are stored one after another, each with its full mip chain
+	size_t offset = 0;
+	for (uint32_t slice = 0; slice < m_ArraySize; ++slice)
+	{
+		uint32_t width = m_Width;
+		uint32_t height = m_Height;
+		uint32_t depth = m_Depth;
+
+		for (uint32_t mip = 0; mip < m_MipCount; ++mip)
+		{
+			size_t rowPitch, rowCount;
+			if (info.m_BytesPerBlock != 0)
+			{
+				rowPitch = (size_t)std::max(1u, (width + 3) / 4) * info.m_BytesPerBlock;
+				rowCount = std::max(1u, (height + 3) / 4);
+			}
+			else
+			{
+				rowPitch = ((size_t)width * info.m_BitsPerPixel + 7) / 8;
+				rowCount = height;
+			}
+
+			// The limits above keep all of this well inside 64 bits, so only the bounds need checking
+			const size_t slicePitch = rowPitch * rowCount;
+			const size_t surfaceBytes = slicePitch * depth;
+			if (surfaceBytes > m_BitSize - offset)
+			{
+				m_Subresources.clear();
+				return RESULT_TRUNCATED;
+			}
+
+			SubresourceView& view = m_Subresources[mip + (size_t)slice * m_MipCount];
+			view.m_Data = m_BitData + offset;
+			view.m_RowPitch = rowPitch;
+			view.m_SlicePitch = slicePitch;
+			view.m_Width = width;
+			view.m_Height = height;
+			view.m_Depth = depth;
+
+			offset += surfaceBytes;
+			width = std::max(width >> 1, 1u);
+			height = std::max(height >> 1, 1u);
+			depth = std::max(depth >> 1, 1u);
+		}
+	}
+
+	return RESULT_OK;
+}
+
+//===============================================================================
+//
+// Fuzz and benchmark
+//
+
+namespace
+{
+	constexpr size_t kHeaderOffset = sizeof(uint32_t);
+	constexpr size_t kDX10Offset = kHeaderOffset + sizeof(Header);
+	constexpr size_t kHeadersEnd = kDX10Offset + sizeof(HeaderDX10);
+
+	uint64_t NextRandom(uint64_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	void WriteDword(std::vector<uint8_t>& file, size_t offset, uint32_t value)
+	{
+		if (offset + sizeof(value) <= file.size())
+			std::memcpy(file.data() + offset, &value, sizeof(value));
+	}
+
+	// A valid file with the given headers, sized to exactly what its subresources need. Laid out by Parse itself over a generous buffer,
+	// then cut down to where the last subresource ends
+	std::vector<uint8_t> MakeSeed(const Header& header, const HeaderDX10* dx10, size_t maxBytes)
+	{
+		const size_t headerBytes = dx10 != nullptr ? kHeadersEnd : kDX10Offset;
+		std::vector<uint8_t> file(headerBytes + maxBytes);
+		std::memcpy(file.data(), &kMagic, sizeof(kMagic));
+		std::memcpy(file.data() + kHeaderOffset, &header, sizeof(header));
+		if (dx10 != nullptr)
+			std::memcpy(file.data() + kDX10Offset, dx10, sizeof(*dx10));
+
+		DDSReader::DDSFile dds;
+		if (dds.Parse(file.data(), file.size()) != DDSReader::RESULT_OK)
+			return std::vector<uint8_t>();
+
+		const DDSReader::SubresourceView& last = dds.GetSubresource(dds.GetMipCount() - 1, dds.GetArraySize() - 1);
+		file.resize((size_t)(last.m_Data - file.data()) + last.m_SlicePitch * last.m_Depth);
+
+		// Something other than zeroes, so reading a view back means something
+		for (size_t i = headerBytes; i < file.size(); ++i)
+			file[i] = (uint8_t)(i * 131);
+		return file;
+	}
+
+	Header MakeHeader(uint32_t width, uint32_t height, uint32_t depth, uint32_t mips)
+	{
+		Header header = {};
+		header.m_Size = sizeof(Header);
+		header.m_Flags = 0x1007 | (depth > 1 ? kHeaderFlagVolume : 0) | (mips > 1 ? 0x20000 : 0);
+		header.m_Width = width;
+		header.m_Height = height;
+		header.m_Depth = depth;
+		header.m_MipMapCount = mips;
+		header.m_PixelFormat.m_Size = sizeof(PixelFormat);
+		header.m_Caps = 0x1000;
+		return header;
+	}
+
+	// One of each shape the loaders see, and a few they don't yet
+	std::vector<std::vector<uint8_t>> MakeSeeds(void)
+	{
+		std::vector<std::vector<uint8_t>> seeds;
+		constexpr size_t kMaxBytes = 1 << 20;
+
+		// Legacy BC1 with a full mip chain
+		Header header = MakeHeader(64, 64, 1, 7);
+		header.m_PixelFormat.m_Flags = kFlagFourCC;
+		header.m_PixelFormat.m_FourCC = MakeFourCC('D', 'X', 'T', '1');
+		seeds.push_back(MakeSeed(header, nullptr, kMaxBytes));
+
+		// Legacy RGBA8 cube
+		header = MakeHeader(16, 16, 1, 5);
+		header.m_PixelFormat.m_Flags = kFlagRGB | kFlagAlpha;
+		header.m_PixelFormat.m_RGBBitCount = 32;
+		header.m_PixelFormat.m_RBitMask = 0x000000ff;
+		header.m_PixelFormat.m_GBitMask = 0x0000ff00;
+		header.m_PixelFormat.m_BBitMask = 0x00ff0000;
+		header.m_PixelFormat.m_ABitMask = 0xff000000;
+		header.m_Caps2 = kCaps2AllFaces;
+		seeds.push_back(MakeSeed(header, nullptr, kMaxBytes));
+
+		// Legacy half float volume, named by its D3DFORMAT
+		header = MakeHeader(16, 16, 8, 5);
+		header.m_PixelFormat.m_Flags = kFlagFourCC;
+		header.m_PixelFormat.m_FourCC = 113;
+		seeds.push_back(MakeSeed(header, nullptr, kMaxBytes));
+
+		// The DX10 headers from here on
+		HeaderDX10 dx10 = {};
+		header = MakeHeader(32, 32, 1, 6);
+		header.m_PixelFormat.m_Flags = kFlagFourCC;
+		header.m_PixelFormat.m_FourCC = MakeFourCC('D', 'X', '1', '0');
+
+		// BC7 array
+		dx10.m_Format = 98;
+		dx10.m_ResourceDimension = DDSReader::DIMENSION_TEXTURE2D;
+		dx10.m_ArraySize = 3;
+		seeds.push_back(MakeSeed(header, &dx10, kMaxBytes));
+
+		// Cube array
+		header.m_Width = header.m_Height = 8;
+		header.m_MipMapCount = 4;
+		dx10.m_Format = kFormatR8G8B8A8Unorm;
+		dx10.m_MiscFlag = kMiscTextureCube;
+		dx10.m_ArraySize = 2;
+		seeds.push_back(MakeSeed(header, &dx10, kMaxBytes));
+
+		// 1D array
+		header.m_Width = 256;
+		header.m_Height = 1;
+		header.m_MipMapCount = 9;
+		dx10.m_Format = kFormatR32Float;
+		dx10.m_ResourceDimension = DDSReader::DIMENSION_TEXTURE1D;
+		dx10.m_MiscFlag = 0;
+		dx10.m_ArraySize = 4;
+		seeds.push_back(MakeSeed(header, &dx10, kMaxBytes));
+
+		// Volume
+		header.m_Flags |= kHeaderFlagVolume;
+		header.m_Width = header.m_Height = header.m_Depth = 8;
+		header.m_MipMapCount = 4;
+		dx10.m_Format = kFormatR10G10B10A2Unorm;
+		dx10.m_ResourceDimension = DDSReader::DIMENSION_TEXTURE3D;
+		dx10.m_ArraySize = 1;
+		seeds.push_back(MakeSeed(header, &dx10, kMaxBytes));
+
+		return seeds;
+	}
+
+	// Counts worth trying in place of a real one - each side of every limit Parse checks, and the values that overflow when multiplied up
+	constexpr uint32_t kHostileCounts[] =
+	{
+		0, 1, 2, 6, 14, 15, 16, 31, 32, 255, 341, 342, 2047, 2048, 2049, 16383, 16384, 16385,
+		0x2AAAAAAB, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFE, 0xFFFFFFFF
+	};
+
+	uint32_t PickCount(uint64_t& state)
+	{
+		const uint64_t pick = NextRandom(state);
+		if ((pick & 7) == 0)
+			return (uint32_t)(pick >> 32);
+		return kHostileCounts[(pick >> 8) % (sizeof(kHostileCounts) / sizeof(kHostileCounts[0]))];
+	}
+
+	void Mutate(std::vector<uint8_t>& file, uint64_t& state)
+	{
+		const uint32_t mutations = 1 + (uint32_t)(NextRandom(state) % 3);
+		for (uint32_t mutation = 0; mutation < mutations; ++mutation)
+		{
+			const uint64_t pick = NextRandom(state);
+			switch (pick % 6)
+			{
+			case 0:
+				// Truncate, mostly to somewhere around the headers where the length checks are
+				if (!file.empty())
+				{
+					const size_t limit = (pick & 0x100) != 0 ? std::min(file.size(), kHeadersEnd + 64) : file.size();
+					file.resize((size_t)((pick >> 16) % (limit + 1)));
+				}
+				break;
+
+			case 1:
+				// Flip a bit in either header
+			{
+				const size_t headerBytes = std::min(file.size(), kHeadersEnd);
+				if (headerBytes != 0)
+				{
+					const size_t bit = (size_t)((pick >> 8) % (headerBytes * 8));
+					file[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+				}
+				break;
+			}
+
+			case 2:
+				WriteDword(file, kHeaderOffset + offsetof(Header, m_MipMapCount), PickCount(state));
+				break;
+
+			case 3:
+				WriteDword(file, kDX10Offset + offsetof(HeaderDX10, m_ArraySize), PickCount(state));
+				break;
+
+			case 4:
+			{
+				static const size_t kDimensions[] = { offsetof(Header, m_Width), offsetof(Header, m_Height), offsetof(Header, m_Depth) };
+				WriteDword(file, kHeaderOffset + kDimensions[(pick >> 8) % 3], PickCount(state));
+				break;
+			}
+
+			default:
+				// Any dword of either header, anything at all
+				WriteDword(file, ((pick >> 8) % (kHeadersEnd / 4)) * 4, (uint32_t)(pick >> 32));
+				break;
+			}
+		}
+	}
+
+	// Every view has to sit inside [data, data + size). Reads each view's first and last byte as well, so a sanitiser catches what the
+	// arithmetic misses
+	bool CheckViews(const DDSReader::DDSFile& dds, const uint8_t* data, size_t size, uint64_t& viewsChecked)
+	{
+		if (dds.GetSubresourceCount() != dds.GetMipCount() * dds.GetArraySize())
+			return false;
+		if (dds.GetBitData() < data || dds.GetBitSize() > size - (size_t)(dds.GetBitData() - data))
+			return false;
+
+		volatile uint8_t sink = 0;
+		for (uint32_t slice = 0; slice < dds.GetArraySize(); ++slice)
+		{
+			for (uint32_t mip = 0; mip < dds.GetMipCount(); ++mip)
+			{
+				const DDSReader::SubresourceView& view = dds.GetSubresource(mip, slice);
+				const size_t bytes = view.m_SlicePitch * view.m_Depth;
+				if (view.m_Data < data || view.m_Data > data + size || bytes == 0 || bytes > size - (size_t)(view.m_Data - data))
+					return false;
+				if (view.m_RowPitch == 0 || view.m_RowPitch > view.m_SlicePitch || view.m_Width == 0 || view.m_Height == 0 || view.m_Depth == 0)
+					return false;
+
+				sink ^= view.m_Data[0];
+				sink ^= view.m_Data[bytes - 1];
+				++viewsChecked;
+			}
+		}
+		return true;
+	}
+
+	bool ReadWholeFile(const std::wstring& fileName, std::vector<uint8_t>& data)
+	{
+#if defined(_WIN32)
+		FILE* file = _wfopen(fileName.c_str(), L"rb");
+#else
+		FILE* file = fopen(std::string(fileName.begin(), fileName.end()).c_str(), "rb");
+#endif
+		if (file == nullptr)
+			return false;
+
+		std::fseek(file, 0, SEEK_END);
+		const long size = std::ftell(file);
+		std::fseek(file, 0, SEEK_SET);
+
+		data.resize(size > 0 ? (size_t)size : 0);
+		const bool bRead = size > 0 && std::fread(data.data(), 1, data.size(), file) == data.size();
+		std::fclose(file);
+		return bRead;
+	}
+
+	// The copy into the upload heap, stood in for by a copy into scratch
+	void CopySubresources(const DDSReader::DDSFile& dds, std::vector<uint8_t>& scratch)
+	{
+		for (uint32_t slice = 0; slice < dds.GetArraySize(); ++slice)
+		{
+			for (uint32_t mip = 0; mip < dds.GetMipCount(); ++mip)
+			{
+				const DDSReader::SubresourceView& view = dds.GetSubresource(mip, slice);
+				const size_t bytes = view.m_SlicePitch * view.m_Depth;
+				if (scratch.size() < bytes)
+					scratch.resize(bytes);
+				std::memcpy(scratch.data(), view.m_Data, bytes);
+			}
+		}
+	}
+}
+
+DDSReader::FuzzResult DDSReader::RunFuzz(const FuzzDesc& desc)
+{
+	FuzzResult result;
+
+	const std::vector<std::vector<uint8_t>> seeds = MakeSeeds();
+	result.m_Seeds = (uint32_t)seeds.size();
+
+	DDSFile dds;
+	for (const std::vector<uint8_t>& seed : seeds)
+	{
+		result.Check(!seed.empty() && dds.Parse(seed.data(), seed.size()) == RESULT_OK, "a seed file didn't parse before it was mutated");
+		result.Check(CheckViews(dds, seed.data(), seed.size(), result.m_ViewsChecked), "a seed file's views ran outside it");
+	}
+	if (!result.m_bValid)
+		return result;
+
+	uint64_t state = desc.m_Seed * 0x9E3779B97F4A7C15ull + 1;
+	std::vector<uint8_t> file;
+	for (uint32_t mutation = 0; mutation < desc.m_Mutations; ++mutation)
+	{
+		const std::vector<uint8_t>& seed = seeds[NextRandom(state) % seeds.size()];
+		file.assign(seed.begin(), seed.end());
+		Mutate(file, state);
+
+		// Copied to exactly its size, so anything read past the end is outside the allocation
+		const std::vector<uint8_t> exact(file);
+		const eResult parsed = dds.Parse(exact.data(), exact.size());
+		++result.m_Results[parsed];
+		if (parsed != RESULT_OK)
+		{
+			result.Check(dds.GetSubresourceCount() == 0, "a rejected file still handed out views");
+			continue;
+		}
+
+		++result.m_Accepted;
+		result.Check(CheckViews(dds, exact.data(), exact.size(), result.m_ViewsChecked), "an accepted file had a view outside the data");
+	}
+
+	return result;
+}
+
+DDSReader::BenchmarkResult DDSReader::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	// Only the files that load both ways are timed
+	std::vector<std::wstring> files;
+	std::vector<uint8_t> data;
+	for (const std::wstring& fileName : desc.m_Files)
+	{
+		MappedFile mapped;
+		DDSFile dds;
+		if (!mapped.Open(fileName) || dds.Parse(mapped.GetData(), mapped.GetSize()) != RESULT_OK || !ReadWholeFile(fileName, data))
+			continue;
+
+		result.Check(data.size() == mapped.GetSize() && std::memcmp(data.data(), mapped.GetData(), data.size()) == 0, "a mapped file differed from the same file read");
+		files.push_back(fileName);
+		result.m_Bytes += mapped.GetSize();
+	}
+	result.m_Files = (uint32_t)files.size();
+	if (files.empty())
+		return result;
+
+	std::vector<uint8_t> scratch;
+	double mappedSeconds = 0.0;
+	double readSeconds = 0.0;
+	for (uint32_t pass = 0; pass < desc.m_Passes; ++pass)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (const std::wstring& fileName : files)
+		{
+			MappedFile mapped;
+			DDSFile dds;
+			if (mapped.Open(fileName) && dds.Parse(mapped.GetData(), mapped.GetSize()) == RESULT_OK)
+				CopySubresources(dds, scratch);
+		}
+		auto end = std::chrono::steady_clock::now();
+		mappedSeconds += std::chrono::duration<double>(end - start).count();
+
+		start = std::chrono::steady_clock::now();
+		for (const std::wstring& fileName : files)
+		{
+			DDSFile dds;
+			if (ReadWholeFile(fileName, data) && dds.Parse(data.data(), data.size()) == RESULT_OK)
+				CopySubresources(dds, scratch);
+		}
+		end = std::chrono::steady_clock::now();
+		readSeconds += std::chrono::duration<double>(end - start).count();
+	}
+
+	const double megabytes = (double)result.m_Bytes * desc.m_Passes / 1048576.0;
+	result.m_MappedMBps = megabytes / std::max(mappedSeconds, 1e-9);
+	result.m_ReadMBps = megabytes / std::max(readSeconds, 1e-9);
+	return result;
+}
@@ -0,0 +1,497 @@
+//===============================================================================
+// desc: Descriptor bookkeeping for DescriptorAllocator. Single descriptors come out of a small per-thread magazine that's refilled, a batch at a
+//       time, from a shared pool under one lock. Freed descriptors are batched up the same way and only handed out again once the fence they were
+//       freed against has passed. Descriptors are just addresses here and heaps come from an interface, so none of this touches D3D.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_DescriptorPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+
+namespace
+{
+	// One per heap type the engine has, with room for a benchmark alongside
+	constexpr uint32_t kThreadCacheSlots = 8;
+
+	std::atomic<uint64_t> s_NextAllocatorId(1);
+}
+
+struct DescriptorPool::Allocator::ThreadCache
+{
+	uint64_t m_Owner = 0;
+	uint32_t m_AllocCount = 0;
+	uint32_t m_FreeCount = 0;
+	uint64_t m_FreeFence = 0;
+
+	// Counted here and added to the allocator's totals whenever the lock's taken, to keep atomics off the fast path
+	uint64_t m_Allocated = 0;
+	uint64_t m_MagazineHits = 0;
+	uint64_t m_Freed = 0;
+
+	uint64_t m_Alloc[kMaxMagazine];
+	uint64_t m_Free[kMaxMagazine];
+};
+
+DescriptorPool::Allocator::Allocator(IHeapSource& heapSource, IFence& fence, uint32_t descriptorsPerHeap, uint32_t magazineSize) :
+	m_HeapSource(heapSource),
+	m_Fence(fence),
+	m_DescriptorsPerHeap(std::max(descriptorsPerHeap, 1u)),
+	m_MagazineSize(std::min(std::max(magazineSize, 1u), kMaxMagazine)),
+	m_Id(s_NextAllocatorId.fetch_add(1)),
+	m_DescriptorSize(0),
+	m_Allocated(0),
+	m_FreedCount(0),
+	m_MagazineHits(0),
+	m_Refills(0),
+	m_Reused(0),
+	m_PendingReuse(0)
+{
+}
+
+DescriptorPool::Allocator::ThreadCache& DescriptorPool::Allocator::GetThreadCache(void)
+{
+	thread_local ThreadCache s_Caches[kThreadCacheSlots];
+
+	ThreadCache& preferred = s_Caches[m_Id % kThreadCacheSlots];
+	if (preferred.m_Owner == m_Id)
+		return preferred;
+
+	ThreadCache* unused = nullptr;
+	for (ThreadCache& cache : s_Caches)
+	{
+		if (cache.m_Owner == m_Id)
+			return cache;
+		if (cache.m_Owner == 0 && unused == nullptr)
+			unused = &cache;
+	}
+
+	// Whatever's left in a slot we take over belongs to an allocator that's been cleared, or to one that's lost it to us. Either way it isn't
+	// ours to hand out, and the descriptors in it are dropped
+	ThreadCache& cache = unused != nullptr ? *unused : preferred;
+	cache = ThreadCache();
+	cache.m_Owner = m_Id;
+	return cache;
+}
+
+void DescriptorPool::Allocator::PublishLocked(ThreadCache& cache)
+{
+	m_Refills.fetch_add(1, std::memory_order_relaxed);
+	if (cache.m_Allocated > 0)
+	{
+		m_Allocated.fetch_add(cache.m_Allocated, std::memory_order_relaxed);
+		m_MagazineHits.fetch_add(cache.m_MagazineHits, std::memory_order_relaxed);
+		cache.m_Allocated = 0;
+		cache.m_MagazineHits = 0;
+	}
+	if (cache.m_Freed > 0)
+	{
+		m_FreedCount.fetch_add(cache.m_Freed, std::memory_order_relaxed);
+		m_PendingReuse.fetch_add(cache.m_Freed, std::memory_order_relaxed);
+		cache.m_Freed = 0;
+	}
+}
+
+void DescriptorPool::Allocator::QueueFreedLocked(ThreadCache& cache)
+{
+	if (cache.m_FreeCount == 0)
+		return;
+
+	m_Freed.emplace_back();
+	FreedBatch& batch = m_Freed.back();
+	batch.m_FenceValue = cache.m_FreeFence;
+	batch.m_Count = cache.m_FreeCount;
+	std::copy(cache.m_Free, cache.m_Free + cache.m_FreeCount, batch.m_Descriptors);
+
+	cache.m_FreeCount = 0;
+	cache.m_FreeFence = 0;
+}
+
+void DescriptorPool::Allocator::ReclaimLocked(void)
+{
+	// Batches go in roughly in fence order, so stopping at the first that isn't done costs at most a little delay for those behind it
+	uint64_t reclaimed = 0;
+	while (!m_Freed.empty() && m_Fence.IsFenceComplete(m_Freed.front().m_FenceValue))
+	{
+		const FreedBatch& batch = m_Freed.front();
+		m_Available.insert(m_Available.end(), batch.m_Descriptors, batch.m_Descriptors + batch.m_Count);
+		reclaimed += batch.m_Count;
+		m_Freed.pop_front();
+	}
+
+	if (reclaimed > 0)
+	{
+		m_Reused.fetch_add(reclaimed, std::memory_order_relaxed);
+		m_PendingReuse.fetch_sub(reclaimed, std::memory_order_relaxed);
+	}
+}
+
+uint64_t DescriptorPool::Allocator::CarveLocked(uint32_t count)
+{
+	uint32_t descriptorSize = m_DescriptorSize.load(std::memory_order_relaxed);
+	if (m_HeapRemaining < count)
+	{
+		// Whatever's left at the end of this heap is too short for the request, but still good for single descriptors
+		for (uint32_t i = 0; i < m_HeapRemaining; ++i)
+			m_Available.push_back(m_HeapCursor + (uint64_t)i * descriptorSize);
+		m_HeapRemaining = 0;
+
+		const uint32_t heapCount = std::max(m_DescriptorsPerHeap, count);
+		const uint64_t heap = m_HeapSource.CreateHeap(heapCount);
+		if (heap == kInvalidDescriptor)
+			return kInvalidDescriptor;
+
+		if (descriptorSize == 0)
+		{
+			descriptorSize = m_HeapSource.GetDescriptorSize();
+			m_DescriptorSize.store(descriptorSize, std::memory_order_relaxed);
+		}
+
+		m_HeapCursor = heap;
+		m_HeapRemaining = heapCount;
+		m_Reserved += heapCount;
+		++m_Heaps;
+	}
+
+	const uint64_t descriptor = m_HeapCursor;
+	m_HeapCursor += (uint64_t)count * descriptorSize;
+	m_HeapRemaining -= count;
+	return descriptor;
+}
+
+uint64_t DescriptorPool::Allocator::Allocate(uint32_t count)
+{
+	if (count == 0)
+		return kInvalidDescriptor;
+
+	ThreadCache& cache = GetThreadCache();
+	if (count == 1 && cache.m_AllocCount > 0)
+	{
+		++cache.m_Allocated;
+		++cache.m_MagazineHits;
+		return cache.m_Alloc[--cache.m_AllocCount];
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	PublishLocked(cache);
+
+	// This thread's own frees may as well go in now the lock's held anyway, and anything past its fence comes back into circulation
+	QueueFreedLocked(cache);
+	ReclaimLocked();
+
+	uint64_t descriptor;
+	if (count == 1)
+	{
+		// Refill the magazine, recycled descriptors first, and keep one of them
+		while (cache.m_AllocCount < m_MagazineSize && !m_Available.empty())
+		{
+			cache.m_Alloc[cache.m_AllocCount++] = m_Available.back();
+			m_Available.pop_back();
+		}
+		while (cache.m_AllocCount < m_MagazineSize)
+		{
+			const uint64_t carved = CarveLocked(1);
+			if (carved == kInvalidDescriptor)
+				break;
+			cache.m_Alloc[cache.m_AllocCount++] = carved;
+		}
+
+		if (cache.m_AllocCount == 0)
+			return kInvalidDescriptor;
+		descriptor = cache.m_Alloc[--cache.m_AllocCount];
+	}
+	else
+	{
+		// Freed descriptors aren't kept in runs, so contiguous ones always come from the heap
+		descriptor = CarveLocked(count);
+		if (descriptor == kInvalidDescriptor)
+			return kInvalidDescriptor;
+	}
+
+	m_Allocated.fetch_add(count, std::memory_order_relaxed);
+	return descriptor;
+}
+
+void DescriptorPool::Allocator::Free(uint64_t descriptor, uint32_t count, uint64_t fenceValue)
+{
+	if (descriptor == kInvalidDescriptor || count == 0)
+		return;
+
+	// Anything freed was allocated first, so the size is known by now
+	const uint32_t descriptorSize = m_DescriptorSize.load(std::memory_order_relaxed);
+
+	ThreadCache& cache = GetThreadCache();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		cache.m_Free[cache.m_FreeCount++] = descriptor + (uint64_t)i * descriptorSize;
+		cache.m_FreeFence = std::max(cache.m_FreeFence, fenceValue);
+		++cache.m_Freed;
+
+		if (cache.m_FreeCount == m_MagazineSize)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			PublishLocked(cache);
+			QueueFreedLocked(cache);
+		}
+	}
+}
+
+void DescriptorPool::Allocator::Flush(void)
+{
+	ThreadCache& cache = GetThreadCache();
+	if (cache.m_FreeCount == 0 && cache.m_Allocated == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	PublishLocked(cache);
+	QueueFreedLocked(cache);
+}
+
+void DescriptorPool::Allocator::Clear(void)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Available.clear();
+	m_Freed.clear();
+	m_HeapCursor = 0;
+	m_HeapRemaining = 0;
+	m_Reserved = 0;
+	m_Heaps = 0;
+
+	m_Allocated.store(0);
+	m_FreedCount.store(0);
+	m_MagazineHits.store(0);
+	m_Refills.store(0);
+	m_Reused.store(0);
+	m_PendingReuse.store(0);
+
+	// Orphans every thread's magazines, including ones on threads we can't reach from here
+	m_Id = s_NextAllocatorId.fetch_add(1);
+}
+
+DescriptorPool::Stats DescriptorPool::Allocator::GetStats(void) const
+{
+	Stats stats;
+	stats.m_Allocated = m_Allocated.load(std::memory_order_relaxed);
+	stats.m_Freed = m_FreedCount.load(std::memory_order_relaxed);
+	stats.m_MagazineHits = m_MagazineHits.load(std::memory_order_relaxed);
+	stats.m_Refills = m_Refills.load(std::memory_order_relaxed);
+	stats.m_Reused = m_Reused.load(std::memory_order_relaxed);
+	stats.m_PendingReuse = m_PendingReuse.load(std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	stats.m_Reserved = m_Reserved;
+	stats.m_Heaps = m_Heaps;
+	return stats;
+}
+
+//===============================================================================
+
+namespace
+{
+	constexpr uint64_t kBenchmarkHeapBase = 0x10000;
+	constexpr uint32_t kBenchmarkDescriptorSize = 32;
+	constexpr uint64_t kLive = ~0ull;
+
+	// Hands out address ranges that nothing ever reads, and tracks every descriptor in them: live, or the fence it was last freed against
+	class BenchmarkHeapSource : public DescriptorPool::IHeapSource
+	{
+	public:
+		explicit BenchmarkHeapSource(uint64_t capacity) : m_States(new std::atomic<uint64_t>[capacity]), m_Capacity(capacity)
+		{
+			for (uint64_t i = 0; i < capacity; ++i)
+				m_States[i].store(0, std::memory_order_relaxed);
+		}
+
+		virtual uint64_t CreateHeap(uint32_t descriptorCount) override
+		{
+			if (m_Used + descriptorCount > m_Capacity)
+				return DescriptorPool::kInvalidDescriptor;
+
+			const uint64_t heap = kBenchmarkHeapBase + m_Used * kBenchmarkDescriptorSize;
+			m_Used += descriptorCount;
+			return heap;
+		}
+
+		virtual uint32_t GetDescriptorSize(void) override { return kBenchmarkDescriptorSize; }
+
+		std::atomic<uint64_t>& GetState(uint64_t descriptor) { return m_States[(descriptor - kBenchmarkHeapBase) / kBenchmarkDescriptorSize]; }
+
+	private:
+		std::unique_ptr<std::atomic<uint64_t>[]> m_States;
+		const uint64_t m_Capacity;
+		uint64_t m_Used = 0;
+	};
+
+	// Stands in for the GPU, which finishes each frame once a fixed number more have been submitted after it
+	class SimulatedFence : public DescriptorPool::IFence
+	{
+	public:
+		explicit SimulatedFence(uint64_t lag) : m_Lag(lag) {}
+
+		virtual bool IsFenceComplete(uint64_t fenceValue) override
+		{
+			const uint64_t submitted = m_Submitted.load(std::memory_order_acquire);
+			return fenceValue <= (submitted > m_Lag ? submitted - m_Lag : 0);
+		}
+
+		uint64_t GetNextFenceValue(void) const { return m_Submitted.load(std::memory_order_acquire) + 1; }
+		void Signal(void) { m_Submitted.fetch_add(1, std::memory_order_acq_rel); }
+
+	private:
+		const uint64_t m_Lag;
+		std::atomic<uint64_t> m_Submitted{ 0 };
+	};
+
+	// How DescriptorAllocator used to do it, with the lock widened to cover the bump as well, since it wasn't safe across threads otherwise
+	class MutexBump
+	{
+	public:
+		MutexBump(DescriptorPool::IHeapSource& heapSource, uint32_t descriptorsPerHeap) : m_HeapSource(heapSource), m_DescriptorsPerHeap(descriptorsPerHeap) {}
+
+		uint64_t Allocate(uint32_t count)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_HeapRemaining < count)
+			{
+				m_HeapCursor = m_HeapSource.CreateHeap(m_DescriptorsPerHeap);
+				if (m_HeapCursor == DescriptorPool::kInvalidDescriptor)
+					return DescriptorPool::kInvalidDescriptor;
+				m_HeapRemaining = m_DescriptorsPerHeap;
+				m_Reserved += m_DescriptorsPerHeap;
+			}
+
+			const uint64_t descriptor = m_HeapCursor;
+			m_HeapCursor += (uint64_t)count * kBenchmarkDescriptorSize;
+			m_HeapRemaining -= count;
+			return descriptor;
+		}
+
+		// Never comes back
+		void Free(uint64_t, uint32_t, uint64_t) {}
+		void Flush(void) {}
+
+		uint64_t GetReserved(void) const { return m_Reserved; }
+
+	private:
+		DescriptorPool::IHeapSource& m_HeapSource;
+		const uint32_t m_DescriptorsPerHeap;
+		std::mutex m_Mutex;
+		uint64_t m_HeapCursor = 0;
+		uint32_t m_HeapRemaining = 0;
+		uint64_t m_Reserved = 0;
+	};
+
+	constexpr uint32_t kOperationsPerFrame = 64;
+
+	// Returns nanoseconds per allocation or free
+	template <typename Pool>
+	double RunThreads(Pool& pool, BenchmarkHeapSource& heapSource, SimulatedFence& fence, const DescriptorPool::BenchmarkDesc& desc, bool& bValid)
+	{
+		std::atomic<bool> bValidAll(true);
+
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (uint32_t thread = 0; thread < desc.m_Threads; ++thread)
+		{
+			workers.emplace_back([&, thread]()
+			{
+				struct Live
+				{
+					uint64_t m_Descriptor;
+					uint32_t m_Count;
+				};
+				std::vector<Live> live;
+				live.reserve(desc.m_LivePerThread);
+
+				std::mt19937 random(desc.m_Seed + thread);
+				const size_t lowMark = desc.m_LivePerThread / 2;
+				bool bThreadValid = true;
+
+				auto freeLive = [&](size_t index)
+				{
+					const Live freed = live[index];
+					const uint64_t fenceValue = fence.GetNextFenceValue();
+					for (uint32_t i = 0; i < freed.m_Count; ++i)
+						heapSource.GetState(freed.m_Descriptor + (uint64_t)i * kBenchmarkDescriptorSize).store(fenceValue, std::memory_order_release);
+					pool.Free(freed.m_Descriptor, freed.m_Count, fenceValue);
+					live[index] = live.back();
+					live.pop_back();
+				};
+
+				for (uint32_t op = 0; op < desc.m_OperationsPerThread; ++op)
+				{
+					const bool bAllocate = live.size() < lowMark || (live.size() < desc.m_LivePerThread && (random() & 1));
+					if (bAllocate)
+					{
+						const uint32_t count = random() % 100 < desc.m_MultiplePercent ? 2 + random() % 7 : 1;
+						const uint64_t descriptor = pool.Allocate(count);
+						if (descriptor == DescriptorPool::kInvalidDescriptor)
+						{
+							bThreadValid = false;
+							break;
+						}
+
+						// Never handed out twice, and never before the GPU is done with it
+						for (uint32_t i = 0; i < count; ++i)
+						{
+							const uint64_t previous = heapSource.GetState(descriptor + (uint64_t)i * kBenchmarkDescriptorSize).exchange(kLive, std::memory_order_acq_rel);
+							bThreadValid &= previous != kLive && fence.IsFenceComplete(previous);
+						}
+						live.push_back({ descriptor, count });
+					}
+					else
+						freeLive(random() % live.size());
+
+					if ((op + 1) % kOperationsPerFrame == 0)
+						fence.Signal();
+				}
+
+				while (!live.empty())
+					freeLive(live.size() - 1);
+				pool.Flush();
+
+				if (!bThreadValid)
+					bValidAll.store(false);
+			});
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+		const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		bValid = bValidAll.load();
+		return elapsed / std::max((double)desc.m_Threads * desc.m_OperationsPerThread, 1.0);
+	}
+}
+
+DescriptorPool::BenchmarkResult DescriptorPool::RunBenchmark(const BenchmarkDesc& desc)
+{
+	// Room for the old way to never get anything back, with at most 8 descriptors per operation
+	const uint64_t capacity = (uint64_t)desc.m_Threads * desc.m_OperationsPerThread * 8 + 256;
+	const uint64_t lag = (uint64_t)desc.m_FramesInFlight * desc.m_Threads;
+
+	BenchmarkResult result;
+	bool bMutexValid, bPoolValid;
+	{
+		BenchmarkHeapSource heapSource(capacity);
+		SimulatedFence fence(lag);
+		MutexBump bump(heapSource, 256);
+		result.m_MutexNsPerOp = RunThreads(bump, heapSource, fence, desc, bMutexValid);
+		result.m_MutexReserved = bump.GetReserved();
+	}
+	{
+		BenchmarkHeapSource heapSource(capacity);
+		SimulatedFence fence(lag);
+		Allocator pool(heapSource, fence, 256);
+		result.m_PoolNsPerOp = RunThreads(pool, heapSource, fence, desc, bPoolValid);
+		result.m_Stats = pool.GetStats();
+		result.m_PoolReserved = result.m_Stats.m_Reserved;
+
+		// Everything was freed, and none of it should have gone missing along the way
+		bPoolValid &= result.m_Stats.GetLive() == 0 && result.m_Stats.m_Reused + result.m_Stats.m_PendingReuse == result.m_Stats.m_Freed;
+	}
+	result.m_bValid = bMutexValid && bPoolValid;
+	return result;
+}
@@ -0,0 +1,425 @@
+//===============================================================================
+// desc: g_Exposure as it stood after each frame adapted it, kept as a compact stream so one run's exposure can be played back into another in
+//       place of AdaptExposureCS. Values are compared and stored as bits, never as floats, so a NaN or a negative zero comes back as it went in.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ExposureStream.h"
+#include "AZB_CounterRNG.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	using namespace ExposureStream;
+
+	constexpr uint32_t kValueCount = 8;
+	static_assert(sizeof(ExposureState) == kValueCount * sizeof(float), "ExposureState is copied in and out of g_Exposure as-is");
+
+	const char kStreamFileMagic[4] = { 'E', 'X', 'P', 'S' };
+	const uint32_t kStreamFileVersion = 1;
+
+	struct StreamFileHeader
+	{
+		char m_Magic[4];
+		uint32_t m_Version;
+		uint32_t m_FrameCount;
+		uint32_t m_ByteCount;
+	};
+	static_assert(sizeof(StreamFileHeader) == 16, "StreamFileHeader is written as-is, so its layout mustn't change");
+
+	FILE* OpenFile(const std::wstring& fileName, bool bWrite)
+	{
+#if defined(_WIN32)
+		FILE* file = nullptr;
+		return _wfopen_s(&file, fileName.c_str(), bWrite ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+		return std::fopen(std::string(fileName.begin(), fileName.end()).c_str(), bWrite ? "wb" : "rb");
+#endif
+	}
+
+	uint32_t GetBits(const ExposureState& state, uint32_t index)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &state.m_Values[index], sizeof(bits));
+		return bits;
+	}
+
+	bool Matches(const ExposureState& a, const ExposureState& b)
+	{
+		return std::memcmp(a.m_Values, b.m_Values, sizeof(a.m_Values)) == 0;
+	}
+}
+
+//===============================================================================
+
+void ExposureStream::EncodeFrame(const ExposureState& previous, const ExposureState& state, std::vector<uint8_t>& bytes)
+{
+	const size_t maskOffset = bytes.size();
+	bytes.push_back(0);
+
+	uint8_t mask = 0;
+	for (uint32_t i = 0; i < kValueCount; ++i)
+	{
+		const uint32_t bits = GetBits(state, i);
+		if (bits == GetBits(previous, i))
+			continue;
+
+		// Little endian whatever the platform, so recordings move between machines
+		mask |= (uint8_t)(1u << i);
+		for (uint32_t b = 0; b < 4; ++b)
+			bytes.push_back((uint8_t)(bits >> (b * 8)));
+	}
+	bytes[maskOffset] = mask;
+}
+
+bool ExposureStream::DecodeFrame(const uint8_t* bytes, size_t byteCount, size_t& offset, const ExposureState& previous, ExposureState& state)
+{
+	if (offset >= byteCount)
+		return false;
+
+	const uint8_t mask = bytes[offset];
+	uint32_t changed = 0;
+	for (uint32_t i = 0; i < kValueCount; ++i)
+		changed += (mask >> i) & 1;
+	if (byteCount - offset - 1 < changed * 4)
+		return false;
+
+	state = previous;
+	size_t read = offset + 1;
+	for (uint32_t i = 0; i < kValueCount; ++i)
+	{
+		if ((mask & (1u << i)) == 0)
+			continue;
+
+		const uint32_t bits = (uint32_t)bytes[read] | ((uint32_t)bytes[read + 1] << 8) | ((uint32_t)bytes[read + 2] << 16) | ((uint32_t)bytes[read + 3] << 24);
+		std::memcpy(&state.m_Values[i], &bits, sizeof(bits));
+		read += 4;
+	}
+	offset = read;
+	return true;
+}
+
+void ExposureStream::Encode(const std::vector<ExposureState>& frames, std::vector<uint8_t>& bytes)
+{
+	bytes.clear();
+	ExposureState previous = {};
+	for (const ExposureState& state : frames)
+	{
+		EncodeFrame(previous, state, bytes);
+		previous = state;
+	}
+}
+
+bool ExposureStream::Decode(const std::vector<uint8_t>& bytes, uint32_t frameCount, std::vector<ExposureState>& frames)
+{
+	frames.clear();
+
+	// Every frame is at least its mask, so a count the bytes can't hold is turned away before anything's allocated for it
+	if (frameCount > bytes.size())
+		return false;
+	frames.reserve(frameCount);
+
+	ExposureState previous = {};
+	size_t offset = 0;
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		ExposureState state;
+		if (!DecodeFrame(bytes.data(), bytes.size(), offset, previous, state))
+		{
+			frames.clear();
+			return false;
+		}
+		frames.push_back(state);
+		previous = state;
+	}
+
+	if (offset != bytes.size())
+	{
+		frames.clear();
+		return false;
+	}
+	return true;
+}
+
+bool ExposureStream::Load(const std::wstring& fileName, std::vector<ExposureState>& frames)
+{
+	frames.clear();
+
+	FILE* file = OpenFile(fileName, false);
+	if (file == nullptr)
+		return false;
+
+	StreamFileHeader header = {};
+	bool bValid = std::fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.m_Magic, kStreamFileMagic, sizeof(kStreamFileMagic)) == 0 &&
+		header.m_Version == kStreamFileVersion && (uint64_t)header.m_ByteCount <= (uint64_t)header.m_FrameCount * kMaxFrameBytes;
+
+	// The byte count has to be what's left of the file, so a corrupt header can't ask for more than is there
+	if (bValid)
+	{
+		const long start = std::ftell(file);
+		bValid = std::fseek(file, 0, SEEK_END) == 0 && std::ftell(file) - start == (long)header.m_ByteCount && std::fseek(file, start, SEEK_SET) == 0;
+	}
+
+	std::vector<uint8_t> bytes;
+	if (bValid)
+	{
+		bytes.resize(header.m_ByteCount);
+		bValid = bytes.empty() || std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	}
+	std::fclose(file);
+
+	return bValid && Decode(bytes, header.m_FrameCount, frames);
+}
+
+bool ExposureStream::Writer::Open(const std::wstring& fileName)
+{
+	Close();
+
+	m_File = OpenFile(fileName, true);
+	if (m_File == nullptr)
+		return false;
+
+	m_Previous = ExposureState();
+	m_FrameCount = 0;
+	m_ByteCount = 0;
+
+	StreamFileHeader header = {};
+	std::memcpy(header.m_Magic, kStreamFileMagic, sizeof(kStreamFileMagic));
+	header.m_Version = kStreamFileVersion;
+	m_bFailed = std::fwrite(&header, sizeof(header), 1, m_File) != 1;
+	return !m_bFailed;
+}
+
+bool ExposureStream::Writer::Append(const ExposureState& state)
+{
+	if (m_File == nullptr || m_bFailed)
+		return false;
+
+	// The header only counts 4GB of frames, which even at the most a frame can take is over a hundred million of them
+	m_Scratch.clear();
+	EncodeFrame(m_Previous, state, m_Scratch);
+	if (m_ByteCount + m_Scratch.size() > UINT32_MAX)
+		return false;
+
+	m_bFailed = std::fwrite(m_Scratch.data(), 1, m_Scratch.size(), m_File) != m_Scratch.size();
+	if (!m_bFailed)
+	{
+		m_Previous = state;
+		m_ByteCount += m_Scratch.size();
+		++m_FrameCount;
+	}
+	return !m_bFailed;
+}
+
+bool ExposureStream::Writer::Close(void)
+{
+	if (m_File == nullptr)
+		return false;
+
+	// The counts go in last. A failed write leaves bytes after the last frame counted, which Load() turns away rather than guess at
+	const uint32_t counts[2] = { m_FrameCount, (uint32_t)m_ByteCount };
+	bool bSuccess = std::fseek(m_File, offsetof(StreamFileHeader, m_FrameCount), SEEK_SET) == 0 &&
+		std::fwrite(counts, sizeof(counts), 1, m_File) == 1;
+	bSuccess = std::fclose(m_File) == 0 && bSuccess && !m_bFailed;
+	m_File = nullptr;
+	return bSuccess;
+}
+
+bool ExposureStream::Player::Load(const std::wstring& fileName)
+{
+	std::vector<ExposureState> frames;
+	const bool bLoaded = ExposureStream::Load(fileName, frames);
+	SetFrames(std::move(frames));
+	return bLoaded && IsLoaded();
+}
+
+void ExposureStream::Player::SetFrames(std::vector<ExposureState> frames)
+{
+	m_Frames = std::move(frames);
+	m_Position = 0;
+}
+
+void ExposureStream::Player::Clear(void)
+{
+	SetFrames(std::vector<ExposureState>());
+}
+
+bool ExposureStream::Player::Next(ExposureState& state)
+{
+	if (m_Frames.empty())
+		return false;
+
+	if (m_Position == m_Frames.size())
+	{
+		state = m_Frames.back();
+		return false;
+	}
+
+	state = m_Frames[m_Position++];
+	return true;
+}
+
+//===============================================================================
+
+namespace
+{
+	float SmoothStep(float edge0, float edge1, float x)
+	{
+		const float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+		return t * t * (3.0f - 2.0f * t);
+	}
+
+	// Where the log2 luminance of the scene is centred partway along the path: inside, out into daylight, and back in again
+	float GetSceneMeanLog(float t)
+	{
+		const float outside = SmoothStep(0.25f, 0.4f, t) - SmoothStep(0.7f, 0.85f, t);
+		return -4.5f + 5.5f * outside + 0.4f * std::sin(t * 37.0f);
+	}
+
+	// The histogram GenerateHistogramCS would make of a frame whose log2 luminance is normally distributed, binned against exposure's range
+	// the way the extract shaders bin it
+	void BuildHistogram(double meanLog, double sigma, double blackFraction, uint32_t pixelCount, const ExposureState& exposure,
+		uint32_t histogram[ToneMapReference::kHistogramBins])
+	{
+		const double minLog = exposure.m_Values[4];
+		const double rcpLogRange = exposure.m_Values[7];
+
+		const uint32_t black = (uint32_t)std::lround(pixelCount * blackFraction);
+		const uint32_t lit = pixelCount - black;
+		histogram[0] = black;
+
+		// Bin k takes log lumas from (k - 1) / 254 up to k / 254 of the way through the range, with the first taking everything below and
+		// the last only what's at or past the top. Counts are differences of a rounded running total, so they always add up to lit
+		uint32_t below = 0;
+		for (uint32_t bin = 1; bin < ToneMapReference::kHistogramBins; ++bin)
+		{
+			uint32_t upTo = lit;
+			if (bin < ToneMapReference::kHistogramBins - 1)
+			{
+				const double edge = minLog + (double)bin / 254.0 / rcpLogRange;
+				upTo = (uint32_t)std::lround(lit * 0.5 * std::erfc(-(edge - meanLog) / (sigma * std::sqrt(2.0))));
+				upTo = std::min(std::max(upTo, below), lit);
+			}
+			histogram[bin] = upTo - below;
+			below = upTo;
+		}
+	}
+
+	// What AdaptExposureCS writes to Exposure[3], done in double since it's only compared
+	float GetHistogramAverage(const uint32_t histogram[ToneMapReference::kHistogramBins], uint32_t pixelCount)
+	{
+		double weightedSum = 0.0;
+		for (uint32_t bin = 0; bin < ToneMapReference::kHistogramBins; ++bin)
+			weightedSum += (double)bin * histogram[bin];
+		return (float)(weightedSum / std::max(1u, pixelCount - histogram[0]) - 1.0);
+	}
+
+	struct Run
+	{
+		double m_MeanBias;						// Added to the scene's mean log luminance
+		double m_Sigma;
+		float m_Jitter;							// Frame to frame, in stops
+	};
+
+	// Run 0 is the full resolution run, run 1 a lower resolution one that loses some of the small highlights
+	const Run kRuns[2] = { { 0.0, 1.6, 0.05f }, { -0.12, 1.45, 0.1f } };
+
+	void BuildRunHistogram(uint32_t run, uint32_t frame, uint32_t frames, uint32_t pixelCount, uint64_t seed, const ExposureState& exposure,
+		uint32_t histogram[ToneMapReference::kHistogramBins])
+	{
+		CounterRNG::Stream random(seed, run);
+		random.Seek(frame);
+		const float t = (float)frame / (float)std::max(frames - 1, 1u);
+		const double meanLog = GetSceneMeanLog(t) + kRuns[run].m_MeanBias + random.NextFloat(-kRuns[run].m_Jitter, kRuns[run].m_Jitter);
+		BuildHistogram(meanLog, kRuns[run].m_Sigma, 0.02, pixelCount, exposure, histogram);
+	}
+}
+
+ExposureStream::BenchmarkResult ExposureStream::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	const uint32_t frames = std::max(desc.m_Frames, 1u);
+	const uint32_t pixelCount = std::max(desc.m_LumaWidth * desc.m_LumaHeight, 1u);
+	uint32_t histogram[ToneMapReference::kHistogramBins];
+
+	// Both runs adapting for themselves
+	std::vector<ExposureState> recorded[2];
+	double adaptSeconds = 0.0;
+	for (uint32_t run = 0; run < 2; ++run)
+	{
+		ExposureState exposure = ExposureState::Initial(desc.m_Settings.m_Exposure);
+		recorded[run].reserve(frames);
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			BuildRunHistogram(run, frame, frames, pixelCount, desc.m_Seed, exposure, histogram);
+
+			const auto start = std::chrono::steady_clock::now();
+			ToneMapReference::AdaptExposure(histogram, pixelCount, desc.m_Settings, exposure);
+			adaptSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			recorded[run].push_back(exposure);
+		}
+	}
+
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		result.m_MaxExposureDivergence = std::max(result.m_MaxExposureDivergence,
+			std::fabs(std::log2(recorded[0][frame].GetExposure() / recorded[1][frame].GetExposure())));
+	}
+
+	// The first run through the stream and back
+	std::vector<uint8_t> bytes;
+	auto start = std::chrono::steady_clock::now();
+	Encode(recorded[0], bytes);
+	const double encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<ExposureState> decoded;
+	start = std::chrono::steady_clock::now();
+	result.m_bValid = Decode(bytes, frames, decoded);
+	const double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (uint32_t frame = 0; result.m_bValid && frame < frames; ++frame)
+		result.m_bValid = Matches(decoded[frame], recorded[0][frame]);
+
+	// Cut short anywhere, or with anything after it, a stream mustn't decode. Cuts are stepped through so long runs stay quick
+	std::vector<uint8_t> damaged;
+	const size_t cutStep = std::max<size_t>(bytes.size() / 4096, 1);
+	for (size_t cut = 0; result.m_bValid && cut < bytes.size(); cut += cutStep)
+	{
+		damaged.assign(bytes.begin(), bytes.begin() + cut);
+		result.m_bValid = !Decode(damaged, frames, decoded);
+	}
+	damaged = bytes;
+	damaged.push_back(0);
+	result.m_bValid = result.m_bValid && !Decode(damaged, frames, decoded) && !Decode(bytes, frames + 1, decoded);
+
+	// The second run played back from the first's recording. Its histograms are built from the exposure it's been given, as they would be
+	// on the GPU, but the exposure it goes on to has to be the first run's to the bit
+	Player player;
+	player.SetFrames(recorded[0]);
+	ExposureState exposure = ExposureState::Initial(desc.m_Settings.m_Exposure);
+	for (uint32_t frame = 0; result.m_bValid && frame < frames; ++frame)
+	{
+		BuildRunHistogram(1, frame, frames, pixelCount, desc.m_Seed, exposure, histogram);
+		result.m_ReplayedHistogramShift = std::max(result.m_ReplayedHistogramShift,
+			std::fabs(GetHistogramAverage(histogram, pixelCount) - recorded[0][frame].m_Values[3]));
+
+		result.m_bValid = player.Next(exposure) && Matches(exposure, recorded[0][frame]);
+		++result.m_FramesRun;
+	}
+
+	// Past the end, the last frame holds
+	ExposureState held = {};
+	result.m_bValid = result.m_bValid && !player.Next(held) && Matches(held, recorded[0].back());
+
+	result.m_BytesPerFrame = (double)bytes.size() / frames;
+	result.m_AdaptNs = adaptSeconds * 1e9 / (frames * 2.0);
+	result.m_EncodeNs = encodeSeconds * 1e9 / frames;
+	result.m_DecodeNs = decodeSeconds * 1e9 / frames;
+	return result;
+}
@@ -0,0 +1,518 @@
+//===============================================================================
+// desc: A pool of objects the GPU holds onto until a fence, for CommandAllocatorPool. Objects are handed back to the thread that last used them
+//       where possible, to keep their memory warm, and otherwise recycled through PageRecycling::Recycler, which checks fences in batches. Neither
+//       the objects nor the fence are known to it beyond an interface, so a mock of each is enough to drive it.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_FencedPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+	// One per command list type, with room for a benchmark alongside
+	constexpr uint32_t kThreadCacheSlots = 8;
+
+	// Requests a thread counts to itself before adding them to the shared stats, so they aren't three contended atomics on every request
+	constexpr uint32_t kStatsInterval = 64;
+
+	std::atomic<uint64_t> s_NextPoolId(1);
+
+	// Every pool by id, so a thread that's exiting can find the ones its caches belong to. Made on first use, as pools can be created during
+	// static initialisation
+	struct LivePools
+	{
+		std::mutex m_Mutex;
+		std::unordered_map<uint64_t, FencedPool::Pool*> m_Pools;
+	};
+
+	LivePools& GetLivePools(void)
+	{
+		static LivePools s_LivePools;
+		return s_LivePools;
+	}
+
+	uint32_t HashPointer(const void* object)
+	{
+		// Objects are at least 8 byte aligned, so the bottom bits carry nothing
+		uint64_t key = (uint64_t)(uintptr_t)object >> 3;
+		key *= 0x9E3779B97F4A7C15ull;
+		return (uint32_t)(key >> 32);
+	}
+}
+
+// The objects this thread discarded most recently, oldest first
+struct FencedPool::Pool::ThreadCache
+{
+	uint64_t m_Owner = 0;
+	uint32_t m_First = 0;
+	uint32_t m_Count = 0;
+	Entry* m_Entries[kMaxAffinity];
+
+	uint32_t m_UnreportedRequests = 0;
+	uint32_t m_UnreportedAffinityHits = 0;
+	uint32_t m_UnreportedPoolHits = 0;
+};
+
+// All of a thread's caches. Whatever's still in them when the thread exits goes to the shared pool, rather than waiting for a thread that'll
+// never ask for it again
+struct FencedPool::Pool::ThreadCaches
+{
+	ThreadCache m_Caches[kThreadCacheSlots];
+
+	~ThreadCaches(void)
+	{
+		LivePools& live = GetLivePools();
+		std::lock_guard<std::mutex> lock(live.m_Mutex);
+		for (ThreadCache& cache : m_Caches)
+		{
+			auto iter = cache.m_Count > 0 || cache.m_UnreportedRequests > 0 ? live.m_Pools.find(cache.m_Owner) : live.m_Pools.end();
+			if (iter != live.m_Pools.end())
+				iter->second->Flush(cache);
+		}
+	}
+};
+
+FencedPool::Pool::Pool(IFence& fence, IFactory& factory, uint32_t affinitySize, uint32_t maxObjects) :
+	m_Fence(fence),
+	m_Factory(factory),
+	m_Recycler(fence, 0, true),		// The affinity lists take the place of its thread cache. Waiting out another thread's drain beats creating
+	m_AffinitySize(std::min(affinitySize, kMaxAffinity)),
+	m_MaxObjects(std::max(maxObjects, 1u)),
+	m_Id(s_NextPoolId.fetch_add(1)),
+	m_Entries(new Entry[m_MaxObjects]),
+	m_Count(0),
+	m_OverflowCount(0),
+	m_Requests(0),
+	m_AffinityHits(0),
+	m_PoolHits(0)
+{
+	// At most half full, so probes stay short
+	uint32_t lookupSize = 1;
+	while (lookupSize < m_MaxObjects * 2)
+		lookupSize <<= 1;
+	m_LookupMask = lookupSize - 1;
+
+	m_Lookup.reset(new std::atomic<uint32_t>[lookupSize]);
+	for (uint32_t i = 0; i < lookupSize; ++i)
+		m_Lookup[i].store(0, std::memory_order_relaxed);
+
+	LivePools& live = GetLivePools();
+	std::lock_guard<std::mutex> lock(live.m_Mutex);
+	live.m_Pools[m_Id] = this;
+}
+
+FencedPool::Pool::~Pool()
+{
+	LivePools& live = GetLivePools();
+	std::lock_guard<std::mutex> lock(live.m_Mutex);
+	live.m_Pools.erase(m_Id);
+}
+
+FencedPool::Pool::ThreadCache& FencedPool::Pool::GetThreadCache(void)
+{
+	thread_local ThreadCaches s_Caches;
+
+	ThreadCache& preferred = s_Caches.m_Caches[m_Id % kThreadCacheSlots];
+	if (preferred.m_Owner == m_Id)
+		return preferred;
+
+	ThreadCache* unused = nullptr;
+	for (ThreadCache& cache : s_Caches.m_Caches)
+	{
+		if (cache.m_Owner == m_Id)
+			return cache;
+		if (cache.m_Owner == 0 && unused == nullptr)
+			unused = &cache;
+	}
+
+	// Whatever's left in a slot we take over belongs to a pool that's been cleared, or to one that's lost it to us. Either way it isn't ours
+	// to hand out
+	ThreadCache& cache = unused != nullptr ? *unused : preferred;
+	cache.m_Owner = m_Id;
+	cache.m_First = 0;
+	cache.m_Count = 0;
+	cache.m_UnreportedRequests = 0;
+	cache.m_UnreportedAffinityHits = 0;
+	cache.m_UnreportedPoolHits = 0;
+	return cache;
+}
+
+void FencedPool::Pool::Report(ThreadCache& cache)
+{
+	m_Requests.fetch_add(cache.m_UnreportedRequests, std::memory_order_relaxed);
+	m_AffinityHits.fetch_add(cache.m_UnreportedAffinityHits, std::memory_order_relaxed);
+	m_PoolHits.fetch_add(cache.m_UnreportedPoolHits, std::memory_order_relaxed);
+	cache.m_UnreportedRequests = 0;
+	cache.m_UnreportedAffinityHits = 0;
+	cache.m_UnreportedPoolHits = 0;
+}
+
+void FencedPool::Pool::Flush(ThreadCache& cache)
+{
+	Report(cache);
+	for (; cache.m_Count > 0; --cache.m_Count)
+	{
+		PageRecycling::Node* node = cache.m_Entries[cache.m_First];
+		m_Recycler.Retire(node->m_RetiredFence, &node, 1);
+		cache.m_First = (cache.m_First + 1) % kMaxAffinity;
+	}
+}
+
+FencedPool::Pool::Entry* FencedPool::Pool::Find(void* object) const
+{
+	for (uint32_t slot = HashPointer(object) & m_LookupMask;; slot = (slot + 1) & m_LookupMask)
+	{
+		const uint32_t index = m_Lookup[slot].load(std::memory_order_acquire);
+		if (index == 0)
+			break;
+		if (m_Entries[index - 1].m_pObject == object)
+			return &m_Entries[index - 1];
+	}
+
+	if (m_OverflowCount.load(std::memory_order_acquire) == 0)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(m_CreateMutex);
+	auto iter = m_OverflowLookup.find(object);
+	return iter != m_OverflowLookup.end() ? iter->second : nullptr;
+}
+
+void* FencedPool::Pool::CreateOverflow(void)
+{
+	void* object = m_Factory.Create(m_MaxObjects + (uint32_t)m_Overflow.size());
+	if (object == nullptr)
+		return nullptr;
+
+	m_Overflow.emplace_back(new Entry);
+	m_Overflow.back()->m_pObject = object;
+	m_OverflowLookup[object] = m_Overflow.back().get();
+	m_OverflowCount.store((uint32_t)m_Overflow.size(), std::memory_order_release);
+	return object;
+}
+
+void* FencedPool::Pool::GetPooled(uint32_t index) const
+{
+	if (index < m_MaxObjects)
+		return m_Entries[index].m_pObject;
+
+	std::lock_guard<std::mutex> lock(m_CreateMutex);
+	return m_Overflow[index - m_MaxObjects]->m_pObject;
+}
+
+void* FencedPool::Pool::Request(void)
+{
+	ThreadCache& cache = GetThreadCache();
+	if (++cache.m_UnreportedRequests == kStatsInterval)
+		Report(cache);
+
+	// The oldest thing this thread discarded is the likeliest to be done with
+	if (cache.m_Count > 0)
+	{
+		Entry* oldest = cache.m_Entries[cache.m_First];
+		if (m_Fence.IsFenceComplete(oldest->m_RetiredFence))
+		{
+			cache.m_First = (cache.m_First + 1) % kMaxAffinity;
+			--cache.m_Count;
+			++cache.m_UnreportedAffinityHits;
+			m_Factory.Reset(oldest->m_pObject);
+			return oldest->m_pObject;
+		}
+	}
+
+	if (PageRecycling::Node* node = m_Recycler.Acquire())
+	{
+		Entry* entry = static_cast<Entry*>(node);
+		++cache.m_UnreportedPoolHits;
+		m_Factory.Reset(entry->m_pObject);
+		return entry->m_pObject;
+	}
+
+	std::lock_guard<std::mutex> lock(m_CreateMutex);
+	// Past the cap, another object is still better than none. It's recycled like the rest, and only finding it again takes this lock
+	const uint32_t index = m_Count.load(std::memory_order_relaxed);
+	if (index == m_MaxObjects)
+		return CreateOverflow();
+
+	Entry& entry = m_Entries[index];
+	entry.m_pObject = m_Factory.Create(index);
+	if (entry.m_pObject == nullptr)
+		return nullptr;
+
+	uint32_t slot = HashPointer(entry.m_pObject) & m_LookupMask;
+	while (m_Lookup[slot].load(std::memory_order_relaxed) != 0)
+		slot = (slot + 1) & m_LookupMask;
+	m_Lookup[slot].store(index + 1, std::memory_order_release);
+
+	m_Count.store(index + 1, std::memory_order_release);
+	return entry.m_pObject;
+}
+
+void FencedPool::Pool::Discard(uint64_t fenceValue, void* object)
+{
+	Entry* entry = Find(object);
+	assert(entry != nullptr);
+	if (entry == nullptr)
+		return;
+
+	entry->m_RetiredFence = fenceValue;
+	if (m_AffinitySize == 0)
+	{
+		PageRecycling::Node* node = entry;
+		m_Recycler.Retire(fenceValue, &node, 1);
+		return;
+	}
+
+	// Keep it for this thread, making room by sharing the oldest
+	ThreadCache& cache = GetThreadCache();
+	if (cache.m_Count == m_AffinitySize)
+	{
+		PageRecycling::Node* oldest = cache.m_Entries[cache.m_First];
+		m_Recycler.Retire(oldest->m_RetiredFence, &oldest, 1);
+		cache.m_First = (cache.m_First + 1) % kMaxAffinity;
+		--cache.m_Count;
+	}
+	cache.m_Entries[(cache.m_First + cache.m_Count) % kMaxAffinity] = entry;
+	++cache.m_Count;
+}
+
+void FencedPool::Pool::Clear(void)
+{
+	// Held throughout, so a thread exiting now either flushes before the recycler's cleared or finds this pool gone
+	LivePools& live = GetLivePools();
+	std::lock_guard<std::mutex> liveLock(live.m_Mutex);
+	live.m_Pools.erase(m_Id);
+
+	m_Recycler.Clear();
+
+	const uint32_t count = m_Count.load();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		m_Entries[i].m_pObject = nullptr;
+		m_Entries[i].m_RetiredFence = 0;
+	}
+	for (uint32_t i = 0; i <= m_LookupMask; ++i)
+		m_Lookup[i].store(0);
+	m_Count.store(0);
+	m_Overflow.clear();
+	m_OverflowLookup.clear();
+	m_OverflowCount.store(0);
+
+	m_Requests.store(0);
+	m_AffinityHits.store(0);
+	m_PoolHits.store(0);
+
+	// Orphans every thread's cache, including ones on threads we can't reach from here
+	m_Id = s_NextPoolId.fetch_add(1);
+	live.m_Pools[m_Id] = this;
+}
+
+FencedPool::Stats FencedPool::Pool::GetStats(void) const
+{
+	Stats stats;
+	stats.m_Requests = m_Requests.load(std::memory_order_relaxed);
+	stats.m_AffinityHits = m_AffinityHits.load(std::memory_order_relaxed);
+	stats.m_PoolHits = m_PoolHits.load(std::memory_order_relaxed);
+	stats.m_Created = GetCount();
+	stats.m_Overflowed = m_OverflowCount.load(std::memory_order_relaxed);
+	stats.m_Recycler = m_Recycler.GetStats();
+	return stats;
+}
+
+//===============================================================================
+
+namespace
+{
+	struct MockAllocator
+	{
+		std::atomic<bool> m_bInUse{ false };
+		std::atomic<bool> m_bNeedsReset{ false };
+		std::atomic<uint64_t> m_DiscardFence{ 0 };
+	};
+
+	class MockFactory : public FencedPool::IFactory
+	{
+	public:
+		virtual void* Create(uint32_t) override
+		{
+			m_Allocators.emplace_back(new MockAllocator);
+			return m_Allocators.back().get();
+		}
+
+		virtual void Reset(void* object) override { static_cast<MockAllocator*>(object)->m_bNeedsReset.store(false, std::memory_order_relaxed); }
+
+		uint32_t GetCount(void) const { return (uint32_t)m_Allocators.size(); }
+
+	private:
+		std::vector<std::unique_ptr<MockAllocator>> m_Allocators;
+	};
+
+	// Stands in for the GPU, which finishes each submission once a fixed number more have been made after it
+	class SimulatedFence : public FencedPool::IFence
+	{
+	public:
+		explicit SimulatedFence(uint64_t lag) : m_Lag(lag) {}
+
+		virtual bool IsFenceComplete(uint64_t fenceValue) override { return fenceValue <= GetCompletedValue(); }
+
+		uint64_t GetCompletedValue(void) const
+		{
+			const uint64_t submitted = m_Submitted.load(std::memory_order_acquire);
+			return submitted > m_Lag ? submitted - m_Lag : 0;
+		}
+
+		uint64_t Signal(void) { return m_Submitted.fetch_add(1, std::memory_order_acq_rel) + 1; }
+
+	private:
+		const uint64_t m_Lag;
+		std::atomic<uint64_t> m_Submitted{ 0 };
+	};
+
+	// How CommandAllocatorPool used to do it - one lock, and only the front of the FIFO is ever checked
+	class MutexQueue
+	{
+	public:
+		MutexQueue(SimulatedFence& fence, FencedPool::IFactory& factory) : m_Fence(fence), m_Factory(factory) {}
+
+		void* Request(void)
+		{
+			const uint64_t completedFenceValue = m_Fence.GetCompletedValue();
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (!m_Ready.empty() && m_Ready.front().first <= completedFenceValue)
+			{
+				void* object = m_Ready.front().second;
+				m_Factory.Reset(object);
+				m_Ready.pop();
+				return object;
+			}
+			return m_Factory.Create(0);
+		}
+
+		void Discard(uint64_t fenceValue, void* object)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Ready.push(std::make_pair(fenceValue, object));
+		}
+
+	private:
+		SimulatedFence& m_Fence;
+		FencedPool::IFactory& m_Factory;
+		std::mutex m_Mutex;
+		std::queue<std::pair<uint64_t, void*>> m_Ready;
+	};
+
+	// Returns nanoseconds per allocator requested
+	template <typename Pool>
+	double RunThreads(Pool& pool, SimulatedFence& fence, const FencedPool::BenchmarkDesc& desc, bool& bValid)
+	{
+		std::atomic<bool> bValidAll(true);
+
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (uint32_t thread = 0; thread < desc.m_Threads; ++thread)
+		{
+			workers.emplace_back([&]()
+			{
+				bool bThreadValid = true;
+				for (uint32_t frame = 0; frame < desc.m_FramesPerThread; ++frame)
+				{
+					for (uint32_t context = 0; context < desc.m_ContextsPerFrame; ++context)
+					{
+						MockAllocator* allocator = static_cast<MockAllocator*>(pool.Request());
+						if (allocator == nullptr)
+						{
+							bThreadValid = false;
+							continue;
+						}
+
+						// Never handed out twice, before the GPU is done with it, or without a reset
+						bThreadValid &= !allocator->m_bInUse.exchange(true, std::memory_order_acquire);
+						bThreadValid &= fence.IsFenceComplete(allocator->m_DiscardFence.load(std::memory_order_relaxed));
+						bThreadValid &= !allocator->m_bNeedsReset.load(std::memory_order_relaxed);
+
+						// Submitted as soon as it's recorded, as Finish() does
+						const uint64_t fenceValue = fence.Signal();
+						allocator->m_DiscardFence.store(fenceValue, std::memory_order_relaxed);
+						allocator->m_bNeedsReset.store(true, std::memory_order_relaxed);
+						allocator->m_bInUse.store(false, std::memory_order_release);
+						pool.Discard(fenceValue, allocator);
+					}
+				}
+				if (!bThreadValid)
+					bValidAll.store(false);
+			});
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+		const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		bValid = bValidAll.load();
+		return elapsed / std::max((double)desc.m_Threads * desc.m_FramesPerThread * desc.m_ContextsPerFrame, 1.0);
+	}
+}
+
+FencedPool::BenchmarkResult FencedPool::RunBenchmark(const BenchmarkDesc& desc)
+{
+	const uint64_t lag = (uint64_t)desc.m_FramesInFlight * desc.m_ContextsPerFrame * desc.m_Threads;
+
+	BenchmarkResult result;
+	bool bMutexValid, bPoolValid;
+	{
+		SimulatedFence fence(lag);
+		MockFactory factory;
+		MutexQueue queue(fence, factory);
+		result.m_MutexNsPerRequest = RunThreads(queue, fence, desc, bMutexValid);
+		result.m_MutexCreated = factory.GetCount();
+	}
+	{
+		SimulatedFence fence(lag);
+		MockFactory factory;
+		Pool pool(fence, factory);
+		result.m_PoolNsPerRequest = RunThreads(pool, fence, desc, bPoolValid);
+		result.m_PoolCreated = factory.GetCount();
+		result.m_Stats = pool.GetStats();
+
+		// The mocks are about to go, and some may still be sitting in this thread's caches
+		pool.Clear();
+	}
+	result.Check(bMutexValid, "the mutex queue handed out an allocator twice, before its fence or without a reset");
+	result.Check(bPoolValid, "the pool handed out an allocator twice, before its fence or without a reset");
+
+	// A pool capped below what's in flight has to keep handing allocators out, and what a thread still held when it exited has to come back
+	// for the others, overflow included
+	{
+		constexpr uint32_t kCap = 4;
+		constexpr uint32_t kHeld = 16;
+
+		SimulatedFence fence(0);
+		MockFactory factory;
+		Pool pool(fence, factory, kHeld, kCap);
+
+		std::vector<void*> held;
+		for (uint32_t i = 0; i < kHeld; ++i)
+			held.push_back(pool.Request());
+		result.Check(std::find(held.begin(), held.end(), nullptr) == held.end(), "a pool at its cap handed out nullptr");
+		result.Check(pool.GetStats().m_Overflowed == kHeld - kCap && pool.GetCount() == kHeld, "a pool past its cap miscounted");
+		if (result.m_bValid)
+		{
+			std::thread([&]()
+			{
+				for (void* object : held)
+					pool.Discard(fence.Signal(), object);
+			}).join();
+
+			for (uint32_t i = 0; i < kHeld; ++i)
+				result.Check(pool.Request() != nullptr, "a pool at its cap handed out nullptr");
+			result.Check(factory.GetCount() == kHeld, "allocators held by a thread that exited weren't reused");
+		}
+		pool.Clear();
+	}
+	return result;
+}
@@ -0,0 +1,195 @@
+//===============================================================================
+// desc: Streaming frame-time analysis. Tracks the shape of the frame-time distribution rather than a single smoothed average - quantiles via the P-squared (P2) algorithm,
+//       frame pacing jitter, stutters and 1%/0.1% lows - all in constant time and memory per frame. Free of engine dependencies so it can be reused anywhere.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+//===============================================================================
+//
+// P2 Quantile
+//
+
+FrameStats::P2Quantile::P2Quantile(float quantile) : m_Quantile(quantile)
+{
+	Reset();
+}
+
+void FrameStats::P2Quantile::Reset(void)
+{
+	const double p = m_Quantile;
+	m_Count = 0;
+
+	for (uint32_t i = 0; i < 5; ++i)
+	{
+		m_Heights[i] = 0.0;
+		m_Positions[i] = i + 1.0;
+	}
+
+	m_Desired[0] = 1.0;
+	m_Desired[1] = 1.0 + 2.0 * p;
+	m_Desired[2] = 1.0 + 4.0 * p;
+	m_Desired[3] = 3.0 + 2.0 * p;
+	m_Desired[4] = 5.0;
+
+	m_Increments[0] = 0.0;
+	m_Increments[1] = p / 2.0;
+	m_Increments[2] = p;
+	m_Increments[3] = (1.0 + p) / 2.0;
+	m_Increments[4] = 1.0;
+}
+
+void FrameStats::P2Quantile::Push(float value)
+{
+	const double x = value;
+
+	// Collect the first five samples as-is, they become the initial markers
+	if (m_Count < 5)
+	{
+		m_Heights[m_Count++] = x;
+		if (m_Count == 5)
+			std::sort(m_Heights, m_Heights + 5);
+		return;
+	}
+	++m_Count;
+
+	// Find the cell the new sample falls into, stretching the extremes if needed
+	uint32_t cell;
+	if (x < m_Heights[0])
+	{
+		m_Heights[0] = x;
+		cell = 0;
+	}
+	else if (x >= m_Heights[4])
+	{
+		m_Heights[4] = x;
+		cell = 3;
+	}
+	else
+	{
+		cell = 0;
+		while (x >= m_Heights[cell + 1])
+			++cell;
+	}
+
+	for (uint32_t i = cell + 1; i < 5; ++i)
+		m_Positions[i] += 1.0;
+	for (uint32_t i = 0; i < 5; ++i)
+		m_Desired[i] += m_Increments[i];
+
+	// Nudge the middle markers towards their desired positions
+	for (uint32_t i = 1; i < 4; ++i)
+	{
+		const double offset = m_Desired[i] - m_Positions[i];
+		if ((offset >= 1.0 && m_Positions[i + 1] - m_Positions[i] > 1.0) || (offset <= -1.0 && m_Positions[i - 1] - m_Positions[i] < -1.0))
+		{
+			const double d = offset >= 0.0 ? 1.0 : -1.0;
+
+			// Piecewise-parabolic prediction first, falling back to linear if it would break marker ordering
+			const double parabolic = m_Heights[i] + d / (m_Positions[i + 1] - m_Positions[i - 1])
+				* ((m_Positions[i] - m_Positions[i - 1] + d) * (m_Heights[i + 1] - m_Heights[i]) / (m_Positions[i + 1] - m_Positions[i])
+				 + (m_Positions[i + 1] - m_Positions[i] - d) * (m_Heights[i] - m_Heights[i - 1]) / (m_Positions[i] - m_Positions[i - 1]));
+
+			if (m_Heights[i - 1] < parabolic && parabolic < m_Heights[i + 1])
+			{
+				m_Heights[i] = parabolic;
+			}
+			else
+			{
+				const uint32_t j = d > 0.0 ? i + 1 : i - 1;
+				m_Heights[i] += d * (m_Heights[j] - m_Heights[i]) / (m_Positions[j] - m_Positions[i]);
+			}
+			m_Positions[i] += d;
+		}
+	}
+}
+
+float FrameStats::P2Quantile::Get(void) const
+{
+	if (m_Count == 0)
+		return 0.f;
+
+	if (m_Count < 5)
+	{
+		double sorted[5];
+		std::copy(m_Heights, m_Heights + m_Count, sorted);
+		std::sort(sorted, sorted + m_Count);
+		return (float)sorted[(uint32_t)std::lround(m_Quantile * (m_Count - 1))];
+	}
+
+	return (float)m_Heights[2];
+}
+
+//===============================================================================
+//
+// Frame Time Analyzer
+//
+
+FrameStats::FrameTimeAnalyzer::FrameTimeAnalyzer(float stutterFactor)
+	: m_P50(0.5f), m_P95(0.95f), m_P99(0.99f), m_P999(0.999f), m_StutterFactor(stutterFactor)
+{
+	Reset();
+}
+
+void FrameStats::FrameTimeAnalyzer::Reset(void)
+{
+	m_P50.Reset();
+	m_P95.Reset();
+	m_P99.Reset();
+	m_P999.Reset();
+
+	m_Count = 0;
+	m_Stutters = 0;
+	m_Sum = 0.0;
+	m_JitterSum = 0.0;
+	m_LastMs = 0.f;
+}
+
+void FrameStats::FrameTimeAnalyzer::Push(float frameMs)
+{
+	if (!(frameMs > 0.f))
+		return;
+
+	// Judge against the median from before this frame so a single spike can't excuse itself
+	if (m_Count >= kStutterWarmupFrames && frameMs > m_StutterFactor * m_P50.Get())
+		++m_Stutters;
+
+	if (m_Count > 0)
+		m_JitterSum += std::fabs(frameMs - m_LastMs);
+
+	m_P50.Push(frameMs);
+	m_P95.Push(frameMs);
+	m_P99.Push(frameMs);
+	m_P999.Push(frameMs);
+
+	m_Sum += frameMs;
+	m_LastMs = frameMs;
+	++m_Count;
+}
+
+FrameStats::FrameTimeSummary FrameStats::FrameTimeAnalyzer::GetSummary(void) const
+{
+	FrameTimeSummary summary;
+	summary.m_Frames = m_Count;
+	if (m_Count == 0)
+		return summary;
+
+	summary.m_MeanMs = (float)(m_Sum / m_Count);
+	summary.m_P50Ms = m_P50.Get();
+	summary.m_P95Ms = m_P95.Get();
+	summary.m_P99Ms = m_P99.Get();
+	summary.m_P999Ms = m_P999.Get();
+
+	summary.m_JitterMs = m_Count > 1 ? (float)(m_JitterSum / (m_Count - 1)) : 0.f;
+
+	summary.m_Stutters = m_Stutters;
+	summary.m_StutterPercent = 100.f * (float)m_Stutters / (float)m_Count;
+
+	summary.m_AverageFPS = summary.m_MeanMs > 0.f ? 1000.f / summary.m_MeanMs : 0.f;
+	summary.m_Low1PercentFPS = summary.m_P99Ms > 0.f ? 1000.f / summary.m_P99Ms : 0.f;
+	summary.m_Low01PercentFPS = summary.m_P999Ms > 0.f ? 1000.f / summary.m_P999Ms : 0.f;
+	return summary;
+}
@@ -254,6 +254,9 @@ namespace RTUA_GUI
 	bool m_ShowHardwareMetrics = false;
 	bool m_ShowFrameRate = false;
 
+	bool m_bBenchmarkActive = false;
+	std::string m_BenchmarkStatus;
+
 
 	ImVec2 m_MainWindowSize{};
 	ImVec2 m_MainWindowPos{};
@@ -368,6 +371,13 @@ void RTUA_GUI::Run(CommandContext& Context)
 	ImGui_ImplWin32_NewFrame();
 	ImGui::NewFrame();
 
+	// While a benchmark sweep is running, the runner owns the pipeline state. Only show its progress so the GUI doesn't fight it (or skew the timings!)
+	if (m_bBenchmarkActive)
+	{
+		BenchmarkOverlay();
+		return;
+	}
+
 		// Display Modal if it is the first time!
 	if (m_bShowStartupModal)
 		StartupModal();
@@ -412,6 +422,10 @@ void RTUA_GUI::Run(CommandContext& Context)
 
 void RTUA_GUI::UpdateGraphics()
 {
+	// Whatever is about to change, the frame-time distribution from before it no longer applies. Skip a few frames so the rebuild hitch isn't counted either
+	if (IsPipelineChangePending())
+		EngineProfiling::ResetFrameTimeAnalysis(kFrameStatsSettleFrames);
+
 	// Check if the common graphics state (samplers etc.) needs updating first
 	if (m_bCommonStateChangePending)
 	{
@@ -599,6 +613,126 @@ void RTUA_GUI::Terminate()
 
 #pragma endregion
 
+#pragma region State Change Helpers
+
+void RTUA_GUI::SetRenderingMode(eRenderingMode mode)
+{
+	// Update rendering modes
+	m_PreviousRenderingMode = m_CurrentRenderingMode;
+	m_CurrentRenderingMode = mode;
+
+	// Now execute appropriate behaviour based on rendering mode, but only if it's changed!
+	if (m_CurrentRenderingMode == m_PreviousRenderingMode)
+		return;
+
+	// Regardless of where we've come from or are going to - reset the LOD override if it's enabled
+	m_bOverrideLodBias = false;
+	switch (m_CurrentRenderingMode)
+	{
+		case eRenderingMode::NATIVE:
+		{
+			// Check if we were using DLSS previously - we need to reset the pipeline and toggle it off
+			if (m_PreviousRenderingMode == eRenderingMode::DLSS)
+			{
+				// Set flags appropriately
+				m_bToggleDLSS = false;
+				m_bDLSSUpdatePending = true;
+			}
+
+			// Check if the resolution is at native, if it's been changed from another mode, reset it!
+			if (Graphics::g_NativeWidth != DLSS::m_MaxNativeResolution.m_Width && Graphics::g_NativeHeight != DLSS::m_MaxNativeResolution.m_Height)
+			{
+				m_NewWidth = DLSS::m_MaxNativeResolution.m_Width;
+				m_NewHeight = DLSS::m_MaxNativeResolution.m_Height;
+				// Set flag to true so that we can update the pipeline next frame! This will result in DLSS needing to be recreated also
+				// This takes place in UpdateGraphics()
+				m_bResolutionChangePending = true;
+			}
+			break;
+		}
+
+		case eRenderingMode::BILINEAR_UPSCALE:
+		{
+			// Reset DLSS just like we did with Native
+			if (m_PreviousRenderingMode == eRenderingMode::DLSS)
+			{
+				m_bToggleDLSS = false;
+				m_bDLSSUpdatePending = true;
+			}
+
+			// Check if the internal resolution is the same as last time, if it's been changed from another mode, reset it!
+			if (Graphics::g_NativeWidth != m_BilinearInputRes.m_Width && Graphics::g_NativeHeight != m_BilinearInputRes.m_Height)
+			{
+				m_NewWidth = m_BilinearInputRes.m_Width;
+				m_NewHeight = m_BilinearInputRes.m_Height;
+				// Set flag to true so that we can update the pipeline next frame! This will result in DLSS needing to be recreated also
+				// This takes place in UpdateGraphics()
+				m_bResolutionChangePending = true;
+			}
+			break;
+		}
+
+		case eRenderingMode::DLSS:
+		{
+			// Only do the next section if DLSS is supported!
+			if (DLSS::m_bIsNGXSupported)
+			{
+				// Removed checkbox and added an automatic toggle when this mode is selected!
+				m_bToggleDLSS = true;
+				m_bDLSSUpdatePending = true;
+			}
+			break;
+		}
+	}
+}
+
+void RTUA_GUI::SetDLSSQualityMode(uint8_t mode)
+{
+	// Update current mode
+	DLSS::m_CurrentQualityMode = mode;
+	// Set flags
+	DLSS::m_bNeedsReleasing = true;
+	m_bDLSSUpdatePending = true;
+	m_bUpdateDLSSMode = true;
+	// Also reset LOD Bias override
+	m_bOverrideLodBias = false;
+}
+
+void RTUA_GUI::SetBilinearInputResolution(const Resolution& res)
+{
+	m_BilinearInputRes = res;
+
+	// Only touch the pipeline if we're actually upscaling right now, otherwise this gets picked up when switching into the mode
+	if (m_CurrentRenderingMode == eRenderingMode::BILINEAR_UPSCALE)
+	{
+		m_NewWidth = res.m_Width;
+		m_NewHeight = res.m_Height;
+		m_bResolutionChangePending = true;
+	}
+}
+
+void RTUA_GUI::SetNativeResolution(const Resolution& res)
+{
+	// Set flag to true so that we can update the pipeline next frame! This will result in DLSS needing to be recreated also
+	m_NewWidth = res.m_Width;
+	m_NewHeight = res.m_Height;
+	m_bResolutionChangePending = true;
+}
+
+void RTUA_GUI::SetLodBiasOverride(bool bOverride, float bias)
+{
+	m_bOverrideLodBias = bOverride;
+	m_ForcedLodBias = bias;
+	m_bCommonStateChangePending = true;
+}
+
+bool RTUA_GUI::IsPipelineChangePending()
+{
+	return m_bResolutionChangePending || m_bDLSSUpdatePending || m_bCommonStateChangePending || m_bDisplayModeChangePending;
+}
+
+#pragma endregion
+
 //
 //	Smaller functions that break down individual sections of the GUI. Makes it much more readable and modular!
 //
@@ -975,8 +1109,6 @@ void RTUA_GUI::ResolutionDisplay()
 
 void RTUA_GUI::RenderModeSelection()
 {
-	static int mode_current_idx = m_CurrentRenderingMode;
-
 	const char* comboLabel = "Rendering Mode";
 	const char* comboPreviewValue = m_RenderModeNames[m_CurrentRenderingMode].c_str();
 
@@ -993,81 +1125,11 @@ void RTUA_GUI::RenderModeSelection()
 	{
 		for (int n = 0; n < eRenderingMode::NUM_RENDER_MODES ; n++)
 		{
-			const bool is_selected = (mode_current_idx == n);
+			const bool is_selected = (m_CurrentRenderingMode == n);
 			if (ImGui::Selectable(m_RenderModeNames[n].c_str(), is_selected))
 			{
-				mode_current_idx = n;
-				// Update rendering modes
-				m_PreviousRenderingMode = m_CurrentRenderingMode;
-				m_CurrentRenderingMode = (eRenderingMode)n;
-
-
-				// Now execute appropriate behaviour based on rendering mode, but only if it's changed!
-				if (m_CurrentRenderingMode != m_PreviousRenderingMode)
-				{
-					// Regardless of where we've come from or are going to - reset the LOD override if it's enabled
-					m_bOverrideLodBias = false;
-					switch (m_CurrentRenderingMode)
-					{
-						case eRenderingMode::NATIVE:
-						{
-							// Check if we were using DLSS previously - we need to reset the pipeline and toggle it off
-							if (m_PreviousRenderingMode == eRenderingMode::DLSS)
-							{
-								// Set flags appropriately
-								m_bToggleDLSS = false;
-								m_bDLSSUpdatePending = true;
-							}
-
-							// Check if the resolution is at native, if it's been changed from another mode, reset it!
-							if (Graphics::g_NativeWidth != DLSS::m_MaxNativeResolution.m_Width && Graphics::g_NativeHeight != DLSS::m_MaxNativeResolution.m_Height)
-							{
-								m_NewWidth = DLSS::m_MaxNativeResolution.m_Width;
-								m_NewHeight = DLSS::m_MaxNativeResolution.m_Height;
-								// Set flag to true so that we can update the pipeline next frame! This will result in DLSS needing to be recreated also
-								// This takes place in UpdateGraphics()
-								m_bResolutionChangePending = true;
-								
-
-							}
-							break;
-						}
-
-						case eRenderingMode::BILINEAR_UPSCALE:
-						{
-							// Reset DLSS just like we did with Native
-							if (m_PreviousRenderingMode == eRenderingMode::DLSS)
-							{
-								m_bToggleDLSS = false;
-								m_bDLSSUpdatePending = true;
-							}
-
-							// Check if the internal resolution is the same as last time, if it's been changed from another mode, reset it!
-							if (Graphics::g_NativeWidth != m_BilinearInputRes.m_Width && Graphics::g_NativeHeight != m_BilinearInputRes.m_Height)
-							{
-								m_NewWidth = m_BilinearInputRes.m_Width;
-								m_NewHeight = m_BilinearInputRes.m_Height;
-								// Set flag to true so that we can update the pipeline next frame! This will result in DLSS needing to be recreated also
-								// This takes place in UpdateGraphics()
-								m_bResolutionChangePending = true;
-							}
-							break;
-						}
-
-						case eRenderingMode::DLSS:
-						{
-							// Only do the next section if DLSS is supported!
-							if (DLSS::m_bIsNGXSupported)
-							{
-								// Removed checkbox and added an automatic toggle when this mode is selected!
-								m_bToggleDLSS = true;
-								m_bDLSSUpdatePending = true;
-
-							}
-							break;
-						}
-					}
-				}
+				// State changes are shared with the benchmark runner, so they live in their own function
+				SetRenderingMode((eRenderingMode)n);
 			}
 
 			if (is_selected)
@@ -1113,11 +1175,7 @@ void RTUA_GUI::RenderModeSelection()
 					if (ImGui::Selectable(DLSS::m_Resolutions[n].first.c_str(), is_selected))
 					{
 						res_current_idx = n;
-						m_bResolutionChangePending = true;
-						// Also update what the values should be
-						m_NewWidth = DLSS::m_Resolutions[n].second.m_Width;
-						m_NewHeight = DLSS::m_Resolutions[n].second.m_Height;
-						m_BilinearInputRes = { m_NewWidth, m_NewHeight };
+						SetBilinearInputResolution(DLSS::m_Resolutions[n].second);
 					}
 
 					if (is_selected)
@@ -1154,14 +1212,7 @@ void RTUA_GUI::RenderModeSelection()
 						if (ImGui::Selectable(modes[n], is_selected))
 						{
 							dlssMode = n;
-							// Update current mode
-							DLSS::m_CurrentQualityMode = n;
-							// Set flags
-							DLSS::m_bNeedsReleasing = true;
-							m_bDLSSUpdatePending = true;
-							m_bUpdateDLSSMode = true;
-							// Also reset LOD Bias override
-							m_bOverrideLodBias = false;
+							SetDLSSQualityMode(n);
 						}
 
 						if (is_selected)
@@ -1284,6 +1335,13 @@ void RTUA_GUI::GraphicsSettings(CommandContext& Context)
 #endif
 }
 
+// One line summary of a profiler history window
+static void MetricSummary(const char* label, const EngineProfiling::FrameTimeSeries& series)
+{
+	ImGui::Text("%s  avg %.2f  min %.2f  max %.2f  p50 %.2f  p95 %.2f  p99 %.2f", label,
+		series.GetMean(), series.GetMin(), series.GetMax(), series.GetP50(), series.GetP95(), series.GetP99());
+}
+
 void RTUA_GUI::PerformanceMetrics()
 {
 	// Show checkboxes that open windows!
@@ -1291,6 +1349,23 @@ void RTUA_GUI::PerformanceMetrics()
 	ImGui::Checkbox("Hardware Frame Times", &m_ShowHardwareMetrics);
 	ImGui::Checkbox("Frame Rate (FPS)", &m_ShowFrameRate);
 
+	// Timeline capture of every profiled scope, for digging into individual frames offline
+	bool bTracing = EngineProfiling::IsTracing();
+	if (ImGui::Checkbox("Record Trace (RTUA_Trace.json)", &bTracing))
+	{
+		if (bTracing)
+			EngineProfiling::StartTrace("RTUA_Trace.json");
+		else
+			EngineProfiling::StopTrace();
+	}
+
+	// Frame data from MiniEngine profiler! It gets published every frame, so drain it whether or not the windows are open to keep the history continuous
+	EngineProfiling::FrameTimeSeries& cpuTimes = EngineProfiling::GetCPUTimeHistory();
+	EngineProfiling::FrameTimeSeries& gpuTimes = EngineProfiling::GetGPUTimeHistory();
+	EngineProfiling::FrameTimeSeries& frameRates = EngineProfiling::GetFrameRateHistory();
+	cpuTimes.Update();
+	gpuTimes.Update();
+	frameRates.Update();
 
 	// Open windows when bools are true! 
 	if (m_ShowHardwareMetrics)
@@ -1306,23 +1381,17 @@ void RTUA_GUI::PerformanceMetrics()
 
 		// Continue with rest of window
 
-		// Frame data from MiniEngine profiler!
-		static std::vector<float> cpuTimes, gpuTimes;
-
-		cpuTimes.push_back(EngineProfiling::GetCPUTime());		// CPU time per frame
-		gpuTimes.push_back(EngineProfiling::GetGPUTime());		// GPU time per frame
-
-		// Limit buffer sizes
-		if (cpuTimes.size() > 1000) cpuTimes.erase(cpuTimes.begin());
-		if (gpuTimes.size() > 1000) gpuTimes.erase(gpuTimes.begin());
+		// Rolling stats are maintained by the series themselves so this is just a read
+		MetricSummary("CPU", cpuTimes);
+		MetricSummary("GPU", gpuTimes);
 
 		// Plot the data
 		if (ImPlot::BeginPlot("Hardware Timings (MS)"))
 		{
 			// Setup axis, x then y. This will be Frame,Ms. Use autofit for now, will mess around with these later
 			ImPlot::SetupAxes("Frame", "Speed(ms)", ImPlotAxisFlags_::ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_::ImPlotAxisFlags_AutoFit);
-			ImPlot::PlotLine("CPU Time", cpuTimes.data(), (int)cpuTimes.size());
-			ImPlot::PlotLine("GPU Time", gpuTimes.data(), (int)gpuTimes.size());
+			ImPlot::PlotLine("CPU Time", cpuTimes.GetData(), (int)cpuTimes.GetCount());
+			ImPlot::PlotLine("GPU Time", gpuTimes.GetData(), (int)gpuTimes.GetCount());
 			ImPlot::EndPlot();
 		}
 
@@ -1340,15 +1409,13 @@ void RTUA_GUI::PerformanceMetrics()
 
 		ImGui::Begin("Frame Rate");
 
-		static std::vector<float> frameTimes;
-
-		frameTimes.push_back(EngineProfiling::GetFrameRate());
-		if (frameTimes.size() > 1000) frameTimes.erase(frameTimes.begin());
+		MetricSummary("FPS", frameRates);
+		FrameTimeDistribution();
 
 		if (ImPlot::BeginPlot("Frame Rate"))
 		{
 			ImPlot::SetupAxes("Count", "FPS", ImPlotAxisFlags_::ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_::ImPlotAxisFlags_AutoFit);
-			ImPlot::PlotLine("Frame Rate", frameTimes.data(), (int)frameTimes.size());
+			ImPlot::PlotLine("Frame Rate", frameRates.GetData(), (int)frameRates.GetCount());
 			ImPlot::EndPlot();
 		}
 
@@ -1356,6 +1423,27 @@ void RTUA_GUI::PerformanceMetrics()
 	}
 }
 
+void RTUA_GUI::FrameTimeDistribution()
+{
+	const FrameStats::FrameTimeSummary summary = EngineProfiling::GetFrameTimeAnalysis().GetSummary();
+
+	ImGui::TextColored(ThemeColours::m_RtuaGold, "Since last change (%llu frames)", (unsigned long long)summary.m_Frames);
+	ImGui::Text("Avg %.1f FPS   1%% low %.1f FPS   0.1%% low %.1f FPS", summary.m_AverageFPS, summary.m_Low1PercentFPS, summary.m_Low01PercentFPS);
+	ImGui::Text("Frame time p50 %.2f  p95 %.2f  p99 %.2f  p99.9 %.2f ms", summary.m_P50Ms, summary.m_P95Ms, summary.m_P99Ms, summary.m_P999Ms);
+	ImGui::Text("Jitter %.2f ms   Stutters %llu (%.2f%%)", summary.m_JitterMs, (unsigned long long)summary.m_Stutters, summary.m_StutterPercent);
+	if (ImGui::Button("Reset Stats"))
+		EngineProfiling::ResetFrameTimeAnalysis();
+}
+
+void RTUA_GUI::BenchmarkOverlay()
+{
+	ImGui::SetNextWindowPos(ImVec2(10.f, 10.f), ImGuiCond_Always, kTopLeftPivot);
+	ImGui::Begin("Benchmark", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_NoSavedSettings);
+	ImGui::TextColored(ThemeColours::m_RtuaGold, "Benchmark Running");
+	ImGui::Text("%s", m_BenchmarkStatus.c_str());
+	ImGui::End();
+}
+
 void RTUA_GUI::ResolutionSettingsDebug()
 {
 	std::string comboValue;
@@ -1399,12 +1487,8 @@ void RTUA_GUI::ResolutionSettingsDebug()
 				if (ImGui::Selectable(DLSS::m_Resolutions[n].first.c_str(), is_selected))
 				{
 					item_current_idx = n;
-					// Set flag to true so that we can update the pipeline next frame! This will result in DLSS needing to be recreated also
 					// This takes place in UpdateGraphics()
-					m_bResolutionChangePending = true;
-					// Also update what the values should be
-					m_NewWidth = DLSS::m_Resolutions[n].second.m_Width;
-					m_NewHeight = DLSS::m_Resolutions[n].second.m_Height;
+					SetNativeResolution(DLSS::m_Resolutions[n].second);
 				}
 
 				if (is_selected)
@@ -0,0 +1,494 @@
+//===============================================================================
+// desc: Lock-free recycling of fence-guarded pages, for LinearAllocatorPageManager. Retired pages go onto a lock-free list stamped with their fence,
+//       get checked against the GPU in batches whenever a thread runs short, and come back through a small per-thread cache backed by a shared
+//       lock-free pool. Pages only need to derive from PageRecycling::Node, and the fence is behind an interface, so none of this touches D3D.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_PageRecycler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Enough for every recycler the engine has, with room to spare. Past that, recyclers whose ids share a slot take turns with it
+	constexpr uint32_t kThreadCacheSlots = 8;
+
+	constexpr uint32_t kTagShift = 48;
+	constexpr uint64_t kPointerMask = (1ull << kTagShift) - 1;
+
+	std::atomic<uint64_t> s_NextRecyclerId(1);
+
+	PageRecycling::Node* GetPointer(uint64_t tagged)
+	{
+		return (PageRecycling::Node*)(uintptr_t)(tagged & kPointerMask);
+	}
+
+	uint64_t MakeTagged(PageRecycling::Node* node, uint64_t previous)
+	{
+		// User-mode addresses fit in 48 bits on every x64 OS this runs on
+		assert(((uint64_t)(uintptr_t)node & ~kPointerMask) == 0);
+		return (uint64_t)(uintptr_t)node | (((previous >> kTagShift) + 1) << kTagShift);
+	}
+}
+
+struct PageRecycling::Recycler::ThreadCache
+{
+	uint64_t m_Owner = 0;
+	uint32_t m_Count = 0;
+	uint32_t m_UnreportedHits = 0;		// Counted here and added to the shared stats on the thread's next trip past its cache
+	Node* m_Nodes[kMaxThreadCache];
+};
+
+PageRecycling::Recycler::Recycler(IFence& fence, uint32_t threadCacheSize, bool bWaitOnBusyDrain) :
+	m_Fence(fence),
+	m_ThreadCacheSize(std::min(threadCacheSize, kMaxThreadCache)),
+	m_bWaitOnBusyDrain(bWaitOnBusyDrain),
+	m_Id(s_NextRecyclerId.fetch_add(1)),
+	m_Available(0),
+	m_ThreadCacheHits(0),
+	m_PoolHits(0),
+	m_Misses(0)
+{
+}
+
+PageRecycling::Recycler::ThreadCache& PageRecycling::Recycler::GetThreadCache(void)
+{
+	thread_local ThreadCache s_Caches[kThreadCacheSlots];
+
+	ThreadCache& preferred = s_Caches[m_Id % kThreadCacheSlots];
+	if (preferred.m_Owner == m_Id)
+		return preferred;
+
+	ThreadCache* unused = nullptr;
+	for (ThreadCache& cache : s_Caches)
+	{
+		if (cache.m_Owner == m_Id)
+			return cache;
+		if (cache.m_Owner == 0 && unused == nullptr)
+			unused = &cache;
+	}
+
+	// Whatever's left in a slot we take over belongs to a recycler that's been cleared, or to one that's lost it to us. Either way it isn't
+	// ours to hand out
+	ThreadCache& cache = unused != nullptr ? *unused : preferred;
+	cache.m_Owner = m_Id;
+	cache.m_Count = 0;
+	cache.m_UnreportedHits = 0;
+	return cache;
+}
+
+void PageRecycling::Recycler::PushAvailable(Node* batch)
+{
+	uint64_t head = m_Available.load(std::memory_order_relaxed);
+	uint64_t newHead;
+	do
+	{
+		batch->m_pNextBatch.store(GetPointer(head), std::memory_order_relaxed);
+		newHead = MakeTagged(batch, head);
+	} while (!m_Available.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+PageRecycling::Node* PageRecycling::Recycler::PopAvailable(void)
+{
+	uint64_t head = m_Available.load(std::memory_order_acquire);
+	for (;;)
+	{
+		Node* batch = GetPointer(head);
+		if (batch == nullptr)
+			return nullptr;
+
+		// batch may be popped and pushed again by another thread while we read this, but then the tag will have moved on and the swap fails
+		Node* next = batch->m_pNextBatch.load(std::memory_order_relaxed);
+		if (m_Available.compare_exchange_weak(head, MakeTagged(next, head), std::memory_order_acquire, std::memory_order_acquire))
+			return batch;
+	}
+}
+
+PageRecycling::Node* PageRecycling::Recycler::TakeBatch(Node* batch, ThreadCache* cache)
+{
+	for (Node* rest = batch->m_pNextRecycled.load(std::memory_order_relaxed); rest != nullptr; rest = rest->m_pNextRecycled.load(std::memory_order_relaxed))
+		cache->m_Nodes[cache->m_Count++] = rest;
+	return batch;
+}
+
+void PageRecycling::Recycler::Retire(RetiredQueue& queue, uint64_t fenceValue, Node* const* nodes, size_t count)
+{
+	if (count == 0)
+		return;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		nodes[i]->m_RetiredFence = fenceValue;
+		nodes[i]->m_pNextRecycled.store(i + 1 < count ? nodes[i + 1] : nullptr, std::memory_order_relaxed);
+	}
+
+	// Pushed as one chain. Nothing is ever popped off the middle of m_Incoming, only swapped out whole, so there's no ABA to worry about
+	Node* head = queue.m_Incoming.load(std::memory_order_relaxed);
+	do
+	{
+		nodes[count - 1]->m_pNextRecycled.store(head, std::memory_order_relaxed);
+	} while (!queue.m_Incoming.compare_exchange_weak(head, nodes[0], std::memory_order_release, std::memory_order_relaxed));
+}
+
+PageRecycling::Node* PageRecycling::Recycler::Drain(RetiredQueue& queue, uint64_t& count)
+{
+	count = 0;
+
+	if (queue.m_bDraining.exchange(true, std::memory_order_acquire))
+		return nullptr;
+
+	// Retirements are pushed onto the front of m_Incoming, so turn the chain round to have the oldest first
+	Node* node = queue.m_Incoming.exchange(nullptr, std::memory_order_acquire);
+	Node* oldestFirst = nullptr;
+	while (node != nullptr)
+	{
+		Node* next = node->m_pNextRecycled.load(std::memory_order_relaxed);
+		node->m_pNextRecycled.store(oldestFirst, std::memory_order_relaxed);
+		oldestFirst = node;
+		node = next;
+	}
+
+	// File it in with what was still pending
+	for (node = oldestFirst; node != nullptr; node = node->m_pNextRecycled.load(std::memory_order_relaxed))
+	{
+		const uint64_t fence = node->m_RetiredFence;
+		const uint64_t queueId = fence >> 56;
+
+		uint32_t index = 0;
+		while (index < queue.m_QueueCount && queue.m_QueueIds[index] != queueId)
+			++index;
+		if (index == queue.m_QueueCount)
+		{
+			// More queues than D3D12 has list types can't happen with real fence values, but lump them together rather than lose pages
+			if (index == kMaxQueues)
+				index = kMaxQueues - 1;
+			else
+			{
+				queue.m_QueueIds[index] = queueId;
+				queue.m_KnownComplete[index] = 0;
+				queue.m_Pending[index].clear();
+				queue.m_PendingHead[index] = 0;
+				++queue.m_QueueCount;
+			}
+		}
+
+		std::vector<PendingPage>& pending = queue.m_Pending[index];
+		size_t position = pending.size();
+		pending.push_back(PendingPage());
+		while (position > queue.m_PendingHead[index] && pending[position - 1].m_Fence > fence)
+		{
+			pending[position] = pending[position - 1];
+			--position;
+		}
+		pending[position].m_Fence = fence;
+		pending[position].m_Node = node;
+	}
+
+	// Take the oldest off each queue for as long as the fence has passed it
+	Node* completed = nullptr;
+	uint64_t polls = 0;
+	for (uint32_t index = 0; index < queue.m_QueueCount; ++index)
+	{
+		std::vector<PendingPage>& pending = queue.m_Pending[index];
+		size_t& head = queue.m_PendingHead[index];
+		for (; head < pending.size(); ++head)
+		{
+			const PendingPage& oldest = pending[head];
+			if (oldest.m_Fence > queue.m_KnownComplete[index])
+			{
+				++polls;
+				if (!m_Fence.IsFenceComplete(oldest.m_Fence))
+					break;
+				queue.m_KnownComplete[index] = oldest.m_Fence;
+			}
+
+			oldest.m_Node->m_pNextRecycled.store(completed, std::memory_order_relaxed);
+			completed = oldest.m_Node;
+			++count;
+		}
+
+		// Close the gap at the front once it's most of the vector, so it's moved a handful of times rather than on every drain
+		if (head == pending.size())
+		{
+			pending.clear();
+			head = 0;
+		}
+		else if (head >= 64 && head * 2 >= pending.size())
+		{
+			pending.erase(pending.begin(), pending.begin() + (ptrdiff_t)head);
+			head = 0;
+		}
+	}
+
+	if (count > 0)
+		queue.m_Hits.store(queue.m_Hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	queue.m_Drained.store(queue.m_Drained.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+	queue.m_FencePolls.store(queue.m_FencePolls.load(std::memory_order_relaxed) + polls, std::memory_order_relaxed);
+	queue.m_bDraining.store(false, std::memory_order_release);
+	return completed;
+}
+
+PageRecycling::Node* PageRecycling::Recycler::Acquire(void)
+{
+	// Without a cache there's no need to claim a slot that another recycler could be using. A hit touches nothing shared, not even the stats
+	ThreadCache* cache = m_ThreadCacheSize > 0 ? &GetThreadCache() : nullptr;
+	if (cache != nullptr && cache->m_Count > 0)
+	{
+		++cache->m_UnreportedHits;
+		return cache->m_Nodes[--cache->m_Count];
+	}
+
+	// Every request ends in exactly one of the hits or a miss, so that's all that's counted
+	if (cache != nullptr && cache->m_UnreportedHits > 0)
+	{
+		m_ThreadCacheHits.fetch_add(cache->m_UnreportedHits, std::memory_order_relaxed);
+		cache->m_UnreportedHits = 0;
+	}
+
+	if (Node* batch = PopAvailable())
+	{
+		m_PoolHits.fetch_add(1, std::memory_order_relaxed);
+		return TakeBatch(batch, cache);
+	}
+
+	// Pool's dry, so see what the GPU has finished with. If another thread is already doing that, give it one yield to share what it finds
+	// and check the pool again. Unless the owner asked to, never wait on it any longer - if it's been preempted mid-drain, every thread behind
+	// it would stall with it
+	uint64_t count;
+	Node* node = Drain(m_Retired, count);
+	if (node == nullptr)
+	{
+		if (m_Retired.m_bDraining.load(std::memory_order_relaxed))
+		{
+			std::this_thread::yield();
+			while (m_bWaitOnBusyDrain && m_Retired.m_bDraining.load(std::memory_order_acquire))
+				std::this_thread::yield();
+			if (Node* batch = PopAvailable())
+			{
+				m_PoolHits.fetch_add(1, std::memory_order_relaxed);
+				return TakeBatch(batch, cache);
+			}
+		}
+
+		// Nothing to be had - the caller makes a new page, which gets recycled like any other
+		m_Misses.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	// Keep one, hold a few back for this thread and share the rest in batches the next threads to run short can take whole
+	Node* rest = node->m_pNextRecycled.load(std::memory_order_relaxed);
+	while (rest != nullptr && cache != nullptr && cache->m_Count < m_ThreadCacheSize)
+	{
+		cache->m_Nodes[cache->m_Count++] = rest;
+		rest = rest->m_pNextRecycled.load(std::memory_order_relaxed);
+	}
+	while (rest != nullptr)
+	{
+		Node* batch = rest;
+		Node* batchLast = rest;
+		for (uint32_t i = 0; i < m_ThreadCacheSize && batchLast->m_pNextRecycled.load(std::memory_order_relaxed) != nullptr; ++i)
+			batchLast = batchLast->m_pNextRecycled.load(std::memory_order_relaxed);
+
+		rest = batchLast->m_pNextRecycled.load(std::memory_order_relaxed);
+		batchLast->m_pNextRecycled.store(nullptr, std::memory_order_relaxed);
+		PushAvailable(batch);
+	}
+
+	return node;
+}
+
+void PageRecycling::Recycler::Retire(uint64_t fenceValue, Node* const* nodes, size_t count)
+{
+	Retire(m_Retired, fenceValue, nodes, count);
+}
+
+void PageRecycling::Recycler::RetireForDeletion(uint64_t fenceValue, Node* const* nodes, size_t count)
+{
+	Retire(m_Deletion, fenceValue, nodes, count);
+}
+
+PageRecycling::Node* PageRecycling::Recycler::CollectDeletable(void)
+{
+	uint64_t count;
+	return Drain(m_Deletion, count);
+}
+
+void PageRecycling::Recycler::Clear(void)
+{
+	m_Available.store(0);
+	for (RetiredQueue* queue : { &m_Retired, &m_Deletion })
+	{
+		queue->m_Incoming.store(nullptr);
+		for (std::vector<PendingPage>& pending : queue->m_Pending)
+			pending.clear();
+		queue->m_QueueCount = 0;
+	}
+
+	// Orphans every thread's cache, including ones on threads we can't reach from here
+	m_Id = s_NextRecyclerId.fetch_add(1);
+}
+
+PageRecycling::Stats PageRecycling::Recycler::GetStats(void) const
+{
+	Stats stats;
+	stats.m_ThreadCacheHits = m_ThreadCacheHits.load(std::memory_order_relaxed);
+	stats.m_PoolHits = m_PoolHits.load(std::memory_order_relaxed);
+	stats.m_Misses = m_Misses.load(std::memory_order_relaxed);
+	stats.m_Requests = stats.m_ThreadCacheHits + stats.m_PoolHits + m_Retired.m_Hits.load(std::memory_order_relaxed) + stats.m_Misses;
+	stats.m_Recycled = m_Retired.m_Drained.load(std::memory_order_relaxed);
+	stats.m_Deleted = m_Deletion.m_Drained.load(std::memory_order_relaxed);
+	stats.m_FencePolls = m_Retired.m_FencePolls.load(std::memory_order_relaxed) + m_Deletion.m_FencePolls.load(std::memory_order_relaxed);
+	return stats;
+}
+
+//===============================================================================
+
+namespace
+{
+	struct BenchmarkPage : public PageRecycling::Node
+	{
+		std::atomic<bool> m_bInUse{ false };
+	};
+
+	// Stands in for the GPU, which finishes each frame once a fixed number more have been submitted after it. Worked out on the spot rather
+	// than by a thread ticking it along, so the results don't hinge on how that thread happens to be scheduled
+	class SimulatedFence : public PageRecycling::IFence
+	{
+	public:
+		explicit SimulatedFence(uint64_t lag) : m_Lag(lag) {}
+
+		virtual bool IsFenceComplete(uint64_t fenceValue) override
+		{
+			const uint64_t submitted = m_Submitted.load(std::memory_order_acquire);
+			return fenceValue <= (submitted > m_Lag ? submitted - m_Lag : 0);
+		}
+
+		uint64_t Signal(void) { return m_Submitted.fetch_add(1, std::memory_order_acq_rel) + 1; }
+
+	private:
+		const uint64_t m_Lag;
+		std::atomic<uint64_t> m_Submitted{ 0 };
+	};
+
+	// How LinearAllocatorPageManager used to do it - one lock, polling the front of a FIFO inside it
+	class MutexPool
+	{
+	public:
+		explicit MutexPool(PageRecycling::IFence& fence) : m_Fence(fence) {}
+
+		PageRecycling::Node* Acquire(void)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			while (!m_Retired.empty() && (++m_FencePolls, m_Fence.IsFenceComplete(m_Retired.front().first)))
+			{
+				m_Available.push(m_Retired.front().second);
+				m_Retired.pop();
+			}
+
+			if (m_Available.empty())
+				return nullptr;
+			PageRecycling::Node* node = m_Available.front();
+			m_Available.pop();
+			return node;
+		}
+
+		void Retire(uint64_t fenceValue, PageRecycling::Node* const* nodes, size_t count)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (size_t i = 0; i < count; ++i)
+				m_Retired.push(std::make_pair(fenceValue, nodes[i]));
+		}
+
+		uint64_t GetFencePolls(void) const { return m_FencePolls; }
+
+	private:
+		PageRecycling::IFence& m_Fence;
+		uint64_t m_FencePolls = 0;
+		std::mutex m_Mutex;
+		std::queue<std::pair<uint64_t, PageRecycling::Node*>> m_Retired;
+		std::queue<PageRecycling::Node*> m_Available;
+	};
+
+	// Returns nanoseconds per page requested
+	template <typename Pool>
+	double RunThreads(Pool& pool, SimulatedFence& fence, const PageRecycling::BenchmarkDesc& desc, uint32_t& pagesCreated, bool& bValid)
+	{
+		std::atomic<bool> bValidAll(true);
+
+		std::mutex createMutex;
+		std::vector<std::unique_ptr<BenchmarkPage>> pages;
+
+		const auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> workers;
+		for (uint32_t thread = 0; thread < desc.m_Threads; ++thread)
+		{
+			workers.emplace_back([&]()
+			{
+				std::vector<PageRecycling::Node*> frame(desc.m_PagesPerFrame);
+				bool bThreadValid = true;
+				for (uint32_t f = 0; f < desc.m_FramesPerThread; ++f)
+				{
+					for (PageRecycling::Node*& node : frame)
+					{
+						node = pool.Acquire();
+						if (node == nullptr)
+						{
+							std::lock_guard<std::mutex> lock(createMutex);
+							pages.emplace_back(new BenchmarkPage);
+							node = pages.back().get();
+						}
+
+						// Never handed out twice, and never before the GPU is done with it
+						BenchmarkPage* page = static_cast<BenchmarkPage*>(node);
+						bThreadValid &= !page->m_bInUse.exchange(true, std::memory_order_acquire);
+						bThreadValid &= fence.IsFenceComplete(page->m_RetiredFence);
+					}
+
+					const uint64_t fenceValue = fence.Signal();
+					for (PageRecycling::Node* node : frame)
+						static_cast<BenchmarkPage*>(node)->m_bInUse.store(false, std::memory_order_release);
+					pool.Retire(fenceValue, frame.data(), frame.size());
+				}
+				if (!bThreadValid)
+					bValidAll.store(false);
+			});
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+		const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		pagesCreated = (uint32_t)pages.size();
+		bValid = bValidAll.load();
+		return elapsed / std::max((double)desc.m_Threads * desc.m_FramesPerThread * desc.m_PagesPerFrame, 1.0);
+	}
+}
+
+PageRecycling::BenchmarkResult PageRecycling::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+	bool bMutexValid, bLockFreeValid;
+	{
+		SimulatedFence fence((uint64_t)desc.m_FramesInFlight * desc.m_Threads);
+		MutexPool pool(fence);
+		result.m_MutexNsPerPage = RunThreads(pool, fence, desc, result.m_MutexPagesCreated, bMutexValid);
+		result.m_MutexFencePolls = pool.GetFencePolls();
+	}
+	{
+		SimulatedFence fence((uint64_t)desc.m_FramesInFlight * desc.m_Threads);
+		Recycler recycler(fence);
+		result.m_LockFreeNsPerPage = RunThreads(recycler, fence, desc, result.m_LockFreePagesCreated, bLockFreeValid);
+		result.m_Stats = recycler.GetStats();
+
+		// The pages are about to go, and some may still be sitting in this thread's cache
+		recycler.Clear();
+	}
+	result.m_bValid = bMutexValid && bLockFreeValid;
+	return result;
+}
@@ -0,0 +1,736 @@
+//===============================================================================
+// desc: A CPU backend for the particle system, emitting and updating exactly as ParticleSpawnCS and ParticleUpdateCS do, so it can stand in for
+//       the GPU as a reference and run particle-heavy scenes headless. Particles are kept structure of arrays, one stream per attribute, updated
+//       4 at a time with SSE2 where available and shared between threads in chunks. The dead are swap-removed, and so are effects past their
+//       lifetime, so neither ever leaves a hole to skip over.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ParticleSim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AZB_PARTICLES_SSE2 1
+#include <emmintrin.h>
+#else
+#define AZB_PARTICLES_SSE2 0
+#endif
+
+namespace
+{
+	constexpr uint32_t kSimdWidth = 4;
+
+	// Particles per job. A whole number of SIMD widths, so no two jobs ever write the same cache line of a stream
+	constexpr uint32_t kChunkSize = 2048;
+
+	// Below this, waking the workers costs more than it saves
+	constexpr uint32_t kMinParticlesToShare = 4096;
+
+	// ParticleSpawnCS looks its spawn slots up in EmissionProperties::RandIndex, refilled every update
+	constexpr uint32_t kRandIndices = 64;
+
+	// ParticleSpawnCS runs in groups of 64, and every thread of a group spawns, so emission comes in whole groups
+	constexpr uint32_t kSpawnGroupSize = 64;
+
+	constexpr float kTwoPi = 6.283185307f;
+
+	uint32_t GetSpawnCount(const ParticleSim::EffectDesc& desc, float timeDelta, uint32_t liveCount)
+	{
+		const uint32_t spawnThreads = (uint32_t)(desc.m_EmitRate * timeDelta);
+		const uint32_t groups = (spawnThreads + kSpawnGroupSize - 1) / kSpawnGroupSize;
+		return std::min(groups * kSpawnGroupSize, desc.m_MaxParticles - std::min(liveCount, desc.m_MaxParticles));
+	}
+
+	// The per slot data, drawn in the order LoadDeviceResources draws it. out is kNumSpawnStreams values, plus the rotation speed nothing reads
+	void DrawSpawnData(const ParticleSim::EffectDesc& desc, CounterRNG::Stream& random, float out[ParticleSim::kNumSpawnStreams])
+	{
+		using namespace ParticleSim;
+
+		out[kSpawnAgeRate] = 1.0f / random.NextFloat(desc.m_LifeMinMax[0], desc.m_LifeMinMax[1]);
+		const float horizontalAngle = random.NextFloat(kTwoPi);
+		const float horizontalVelocity = random.NextFloat(desc.m_Velocity[0], desc.m_Velocity[1]);
+		out[kSpawnVelocityX] = horizontalVelocity * std::cos(horizontalAngle);
+		out[kSpawnVelocityY] = random.NextFloat(desc.m_Velocity[2], desc.m_Velocity[3]);
+		out[kSpawnVelocityZ] = horizontalVelocity * std::sin(horizontalAngle);
+
+		out[kSpawnSpreadX] = random.NextFloat(-desc.m_Spread[0], desc.m_Spread[0]);
+		out[kSpawnSpreadY] = random.NextFloat(-desc.m_Spread[1], desc.m_Spread[1]);
+		out[kSpawnSpreadZ] = random.NextFloat(-desc.m_Spread[2], desc.m_Spread[2]);
+
+		out[kSpawnStartSize] = random.NextFloat(desc.m_Size[0], desc.m_Size[1]);
+		out[kSpawnEndSize] = random.NextFloat(desc.m_Size[2], desc.m_Size[3]);
+		for (uint32_t c = 0; c < 4; ++c)
+			out[kSpawnStartR + c] = random.NextFloat(desc.m_MinStartColor[c], desc.m_MaxStartColor[c]);
+		for (uint32_t c = 0; c < 4; ++c)
+			out[kSpawnEndR + c] = random.NextFloat(desc.m_MinEndColor[c], desc.m_MaxEndColor[c]);
+
+		out[kSpawnMass] = random.NextFloat(desc.m_MassMinMax[0], desc.m_MassMinMax[1]);
+		random.NextFloat();		// RotationSpeed, which the shaders never read
+		out[kSpawnRandom] = random.NextFloat();
+	}
+
+	// ParticleSpawnCS for one slot. position and velocity are where the new particle starts
+	void SpawnMotion(const ParticleSim::EffectDesc& desc, const float emitterVelocity[3], const float velocity[3], const float spread[3], float random,
+		float position[3], float newVelocity[3])
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			const float randDir = velocity[0] * desc.m_EmitRight[axis] + velocity[1] * desc.m_EmitUp[axis] + velocity[2] * desc.m_EmitDirection[axis];
+			newVelocity[axis] = emitterVelocity[axis] * desc.m_EmitterVelocitySensitivity + randDir + desc.m_EmitDirection[axis] * desc.m_EmitSpeed;
+			position[axis] = desc.m_EmitPosition[axis] - emitterVelocity[axis] * random + spread[axis];
+		}
+	}
+
+	float Lerp(float a, float b, float t)
+	{
+		return a + t * (b - a);
+	}
+
+	// ...Originally from Reflex... A trinomial to smoothly fade a particle in at birth and out at death
+	float Fade(float age)
+	{
+		return age * (1.0f - age) * (1.0f - age) * 6.7f;
+	}
+
+	void UpdateParticles(ParticleSim::Effect& effect, uint32_t first, uint32_t count, float timeDelta)
+	{
+		using namespace ParticleSim;
+
+		float* px = effect.GetStream(kPositionX);
+		float* py = effect.GetStream(kPositionY);
+		float* pz = effect.GetStream(kPositionZ);
+		float* vx = effect.GetStream(kVelocityX);
+		float* vy = effect.GetStream(kVelocityY);
+		float* vz = effect.GetStream(kVelocityZ);
+		const float* mass = effect.GetStream(kMass);
+		float* age = effect.GetStream(kAge);
+		const float* ageRate = effect.GetStream(kAgeRate);
+		const float* startSize = effect.GetStream(kStartSize);
+		const float* endSize = effect.GetStream(kEndSize);
+		float* size = effect.GetStream(kSize);
+		uint8_t* alive = effect.m_Alive.data();
+
+		const EffectDesc& desc = effect.m_Desc;
+		const uint32_t end = first + count;
+		uint32_t i = first;
+
+#if AZB_PARTICLES_SSE2
+		const __m128 dt = _mm_set1_ps(timeDelta);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 fadeScale = _mm_set1_ps(6.7f);
+		const __m128 restitution = _mm_set1_ps(desc.m_Restitution);
+		const __m128 gravityX = _mm_set1_ps(desc.m_Gravity[0]);
+		const __m128 gravityY = _mm_set1_ps(desc.m_Gravity[1]);
+		const __m128 gravityZ = _mm_set1_ps(desc.m_Gravity[2]);
+
+		// Streams are padded to the SIMD width, so the last group can run past count. Whatever it writes there is never read as a particle
+		for (; i < end; i += kSimdWidth)
+		{
+			// Update age. If normalized age exceeds 1, the particle does not renew its lease on life
+			const __m128 newAge = _mm_add_ps(_mm_loadu_ps(age + i), _mm_mul_ps(dt, _mm_loadu_ps(ageRate + i)));
+			const __m128 bAlive = _mm_cmplt_ps(newAge, one);
+
+			__m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i), z = _mm_loadu_ps(pz + i);
+			__m128 velX = _mm_loadu_ps(vx + i), velY = _mm_loadu_ps(vy + i), velZ = _mm_loadu_ps(vz + i);
+			const __m128 m = _mm_loadu_ps(mass + i);
+			const __m128 gmX = _mm_mul_ps(gravityX, m), gmY = _mm_mul_ps(gravityY, m), gmZ = _mm_mul_ps(gravityZ, m);
+
+			// Two steps, to rebound off the ground plane part way through
+			const __m128 bFalling = _mm_and_ps(_mm_cmpgt_ps(y, zero), _mm_cmplt_ps(velY, zero));
+			const __m128 hitTime = _mm_min_ps(dt, _mm_div_ps(y, _mm_sub_ps(zero, velY)));
+			const __m128 step = _mm_or_ps(_mm_and_ps(bFalling, hitTime), _mm_andnot_ps(bFalling, dt));
+
+			x = _mm_add_ps(x, _mm_mul_ps(velX, step));
+			y = _mm_add_ps(y, _mm_mul_ps(velY, step));
+			z = _mm_add_ps(z, _mm_mul_ps(velZ, step));
+			velX = _mm_add_ps(velX, _mm_mul_ps(gmX, step));
+			velY = _mm_add_ps(velY, _mm_mul_ps(gmY, step));
+			velZ = _mm_add_ps(velZ, _mm_mul_ps(gmZ, step));
+
+			const __m128 rest = _mm_sub_ps(dt, step);
+			const __m128 bRebound = _mm_cmpgt_ps(rest, zero);
+			if (_mm_movemask_ps(bRebound) != 0)
+			{
+				// reflect() about +y, then the rest of the step
+				__m128 bounceVelX = _mm_mul_ps(velX, restitution);
+				__m128 bounceVelY = _mm_mul_ps(_mm_sub_ps(zero, velY), restitution);
+				__m128 bounceVelZ = _mm_mul_ps(velZ, restitution);
+				const __m128 bounceX = _mm_add_ps(x, _mm_mul_ps(bounceVelX, rest));
+				const __m128 bounceY = _mm_add_ps(y, _mm_mul_ps(bounceVelY, rest));
+				const __m128 bounceZ = _mm_add_ps(z, _mm_mul_ps(bounceVelZ, rest));
+				bounceVelX = _mm_add_ps(bounceVelX, _mm_mul_ps(gmX, rest));
+				bounceVelY = _mm_add_ps(bounceVelY, _mm_mul_ps(gmY, rest));
+				bounceVelZ = _mm_add_ps(bounceVelZ, _mm_mul_ps(gmZ, rest));
+
+				x = _mm_or_ps(_mm_and_ps(bRebound, bounceX), _mm_andnot_ps(bRebound, x));
+				y = _mm_or_ps(_mm_and_ps(bRebound, bounceY), _mm_andnot_ps(bRebound, y));
+				z = _mm_or_ps(_mm_and_ps(bRebound, bounceZ), _mm_andnot_ps(bRebound, z));
+				velX = _mm_or_ps(_mm_and_ps(bRebound, bounceVelX), _mm_andnot_ps(bRebound, velX));
+				velY = _mm_or_ps(_mm_and_ps(bRebound, bounceVelY), _mm_andnot_ps(bRebound, velY));
+				velZ = _mm_or_ps(_mm_and_ps(bRebound, bounceVelZ), _mm_andnot_ps(bRebound, velZ));
+			}
+
+			_mm_storeu_ps(px + i, x); _mm_storeu_ps(py + i, y); _mm_storeu_ps(pz + i, z);
+			_mm_storeu_ps(vx + i, velX); _mm_storeu_ps(vy + i, velY); _mm_storeu_ps(vz + i, velZ);
+			_mm_storeu_ps(age + i, newAge);
+
+			// The sprite
+			const __m128 startS = _mm_loadu_ps(startSize + i);
+			_mm_storeu_ps(size + i, _mm_add_ps(startS, _mm_mul_ps(newAge, _mm_sub_ps(_mm_loadu_ps(endSize + i), startS))));
+
+			const __m128 youth = _mm_sub_ps(one, newAge);
+			const __m128 fade = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(newAge, youth), youth), fadeScale);
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const __m128 startC = _mm_loadu_ps(effect.GetStream((ParticleStream)(kStartR + c)) + i);
+				const __m128 endC = _mm_loadu_ps(effect.GetStream((ParticleStream)(kEndR + c)) + i);
+				const __m128 color = _mm_add_ps(startC, _mm_mul_ps(newAge, _mm_sub_ps(endC, startC)));
+				_mm_storeu_ps(effect.GetStream((ParticleStream)(kColorR + c)) + i, _mm_mul_ps(color, fade));
+			}
+
+			const int aliveMask = _mm_movemask_ps(bAlive);
+			for (uint32_t lane = 0; lane < kSimdWidth; ++lane)
+				alive[i + lane] = (uint8_t)((aliveMask >> lane) & 1);
+		}
+#endif
+
+		for (; i < end; ++i)
+		{
+			age[i] += timeDelta * ageRate[i];
+			alive[i] = age[i] < 1.0f ? 1 : 0;
+
+			const float gm[3] = { desc.m_Gravity[0] * mass[i], desc.m_Gravity[1] * mass[i], desc.m_Gravity[2] * mass[i] };
+			float step = (py[i] > 0.0f && vy[i] < 0.0f) ? std::min(timeDelta, py[i] / (0.0f - vy[i])) : timeDelta;
+
+			px[i] += vx[i] * step; py[i] += vy[i] * step; pz[i] += vz[i] * step;
+			vx[i] += gm[0] * step; vy[i] += gm[1] * step; vz[i] += gm[2] * step;
+
+			step = timeDelta - step;
+			if (step > 0.0f)
+			{
+				vx[i] = vx[i] * desc.m_Restitution; vy[i] = (0.0f - vy[i]) * desc.m_Restitution; vz[i] = vz[i] * desc.m_Restitution;
+				px[i] += vx[i] * step; py[i] += vy[i] * step; pz[i] += vz[i] * step;
+				vx[i] += gm[0] * step; vy[i] += gm[1] * step; vz[i] += gm[2] * step;
+			}
+
+			size[i] = Lerp(startSize[i], endSize[i], age[i]);
+			const float fade = Fade(age[i]);
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const float color = Lerp(effect.GetStream((ParticleStream)(kStartR + c))[i], effect.GetStream((ParticleStream)(kEndR + c))[i], age[i]);
+				effect.GetStream((ParticleStream)(kColorR + c))[i] = color * fade;
+			}
+		}
+	}
+
+	// Swap-removes the dead, then ParticleSpawnCS into the free slots
+	void EmitParticles(ParticleSim::Effect& effect, float timeDelta)
+	{
+		using namespace ParticleSim;
+
+		const EffectDesc& desc = effect.m_Desc;
+		uint32_t count = effect.m_Count;
+
+		for (uint32_t i = 0; i < count; )
+		{
+			if (effect.m_Alive[i] != 0)
+			{
+				++i;
+				continue;
+			}
+
+			--count;
+			if (i != count)
+			{
+				for (uint32_t s = 0; s < kNumParticleStreams; ++s)
+				{
+					float* stream = effect.GetStream((ParticleStream)s);
+					stream[i] = stream[count];
+				}
+				effect.m_ResetIndex[i] = effect.m_ResetIndex[count];
+				effect.m_Alive[i] = effect.m_Alive[count];
+			}
+		}
+		effect.m_SpriteCount = count;
+
+		if (desc.m_MaxParticles == 0)
+		{
+			effect.m_Count = 0;
+			return;
+		}
+
+		// Drawn every update, whether anything spawns or not, as ParticleEffect::Update does
+		uint32_t randIndex[kRandIndices];
+		for (uint32_t i = 0; i < kRandIndices; ++i)
+			randIndex[i] = (uint32_t)effect.m_Random.NextInt((int32_t)desc.m_MaxParticles - 1);
+
+		float emitterVelocity[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			emitterVelocity[axis] = desc.m_EmitPosition[axis] - effect.m_LastEmitPosition[axis];
+
+		// Only 64 indices are refreshed, so a dispatch of more than one group reuses them
+		const uint32_t spawnCount = GetSpawnCount(desc, timeDelta, count);
+		for (uint32_t k = 0; k < spawnCount; ++k)
+		{
+			const uint32_t slot = randIndex[k % kRandIndices];
+			const uint32_t i = count + k;
+
+			float rd[kNumSpawnStreams];
+			for (uint32_t s = 0; s < kNumSpawnStreams; ++s)
+				rd[s] = effect.GetSpawnStream((SpawnStream)s)[slot];
+
+			float position[3], velocity[3];
+			SpawnMotion(desc, emitterVelocity, &rd[kSpawnVelocityX], &rd[kSpawnSpreadX], rd[kSpawnRandom], position, velocity);
+
+			effect.GetStream(kPositionX)[i] = position[0];
+			effect.GetStream(kPositionY)[i] = position[1];
+			effect.GetStream(kPositionZ)[i] = position[2];
+			effect.GetStream(kVelocityX)[i] = velocity[0];
+			effect.GetStream(kVelocityY)[i] = velocity[1];
+			effect.GetStream(kVelocityZ)[i] = velocity[2];
+			effect.GetStream(kMass)[i] = rd[kSpawnMass];
+			effect.GetStream(kAge)[i] = 0.0f;
+			effect.GetStream(kAgeRate)[i] = rd[kSpawnAgeRate];
+			effect.GetStream(kStartSize)[i] = rd[kSpawnStartSize];
+			effect.GetStream(kEndSize)[i] = rd[kSpawnEndSize];
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				effect.GetStream((ParticleStream)(kStartR + c))[i] = rd[kSpawnStartR + c];
+				effect.GetStream((ParticleStream)(kEndR + c))[i] = rd[kSpawnEndR + c];
+			}
+			effect.m_ResetIndex[i] = slot;
+		}
+		effect.m_Count = count + spawnCount;
+	}
+}
+
+//===============================================================================
+
+ParticleSim::Effect::Effect(const EffectDesc& desc, uint64_t seed) : m_Desc(desc), m_Random(seed)
+{
+	std::memcpy(m_LastEmitPosition, desc.m_EmitPosition, sizeof(m_LastEmitPosition));
+
+	m_Capacity = (desc.m_MaxParticles + kSimdWidth - 1) / kSimdWidth * kSimdWidth;
+	m_Particles.assign((size_t)kNumParticleStreams * m_Capacity, 0.0f);
+	m_ResetIndex.assign(m_Capacity, 0);
+	m_Alive.assign(m_Capacity, 0);
+
+	m_Spawn.resize((size_t)kNumSpawnStreams * desc.m_MaxParticles);
+	for (uint32_t i = 0; i < desc.m_MaxParticles; ++i)
+	{
+		float rd[kNumSpawnStreams];
+		DrawSpawnData(desc, m_Random, rd);
+		for (uint32_t s = 0; s < kNumSpawnStreams; ++s)
+			m_Spawn[(size_t)s * desc.m_MaxParticles + i] = rd[s];
+	}
+}
+
+ParticleSim::System::System(uint32_t workerThreads) : m_Pool(workerThreads)
+{
+}
+
+uint32_t ParticleSim::System::AddEffect(const EffectDesc& desc, uint64_t seed)
+{
+	m_Effects.emplace_back(new Effect(desc, seed));
+	return (uint32_t)m_Effects.size() - 1;
+}
+
+void ParticleSim::System::Clear(void)
+{
+	m_Effects.clear();
+}
+
+void ParticleSim::System::Update(float timeDelta)
+{
+	if (timeDelta != 0.0f)
+	{
+		m_TimeDelta = timeDelta;
+
+		uint32_t particleCount = 0;
+		m_Chunks.clear();
+		for (uint32_t e = 0; e < (uint32_t)m_Effects.size(); ++e)
+		{
+			Effect& effect = *m_Effects[e];
+			effect.m_ElapsedTime += timeDelta;
+			particleCount += effect.m_Count;
+
+			for (uint32_t first = 0; first < effect.m_Count; first += kChunkSize)
+				m_Chunks.push_back({ e, first, std::min(kChunkSize, effect.m_Count - first) });
+		}
+
+		// Emitting is cheap next to updating, but still one effect at a time, so it's shared out the same way
+		const bool bShare = particleCount >= kMinParticlesToShare;
+		Run(kUpdatePhase, bShare ? (uint32_t)m_Chunks.size() : 0);
+		Run(kEmitPhase, bShare ? (uint32_t)m_Effects.size() : 0);
+
+		if (!bShare)
+		{
+			for (const Chunk& chunk : m_Chunks)
+				UpdateParticles(*m_Effects[chunk.m_Effect], chunk.m_First, chunk.m_Count, timeDelta);
+			for (std::unique_ptr<Effect>& effect : m_Effects)
+				EmitParticles(*effect, timeDelta);
+		}
+
+		// EmitPosW becomes LastEmitPosW ahead of the next spawn
+		for (std::unique_ptr<Effect>& effect : m_Effects)
+			std::memcpy(effect->m_LastEmitPosition, effect->m_Desc.m_EmitPosition, sizeof(effect->m_LastEmitPosition));
+	}
+	else
+	{
+		// The sprite counter is still reset, but nothing updates, so there are no sprites
+		for (std::unique_ptr<Effect>& effect : m_Effects)
+			effect->m_SpriteCount = 0;
+	}
+
+	for (uint32_t e = 0; e < (uint32_t)m_Effects.size(); )
+	{
+		if (m_Effects[e]->m_Desc.m_TotalActiveLifetime <= m_Effects[e]->m_ElapsedTime)
+		{
+			m_Effects[e] = std::move(m_Effects.back());
+			m_Effects.pop_back();
+		}
+		else
+		{
+			++e;
+		}
+	}
+}
+
+uint32_t ParticleSim::System::GetParticleCount(void) const
+{
+	uint32_t count = 0;
+	for (const std::unique_ptr<Effect>& effect : m_Effects)
+		count += effect->m_Count;
+	return count;
+}
+
+void ParticleSim::System::GatherVertices(std::vector<SpriteVertex>& vertices) const
+{
+	for (const std::unique_ptr<Effect>& pEffect : m_Effects)
+	{
+		const Effect& effect = *pEffect;
+		for (uint32_t i = 0; i < effect.m_SpriteCount; ++i)
+		{
+			SpriteVertex vertex;
+			vertex.m_Position[0] = effect.GetStream(kPositionX)[i];
+			vertex.m_Position[1] = effect.GetStream(kPositionY)[i];
+			vertex.m_Position[2] = effect.GetStream(kPositionZ)[i];
+			for (uint32_t c = 0; c < 4; ++c)
+				vertex.m_Color[c] = effect.GetStream((ParticleStream)(kColorR + c))[i];
+			vertex.m_Size = effect.GetStream(kSize)[i];
+			vertex.m_TextureID = effect.m_Desc.m_TextureID;
+			vertices.push_back(vertex);
+		}
+	}
+}
+
+void ParticleSim::System::Run(Phase phase, uint32_t jobCount)
+{
+	m_Phase = phase;
+	m_Pool.Run(jobCount, [this](uint32_t job) { ProcessJob(job); });
+}
+
+void ParticleSim::System::ProcessJob(uint32_t job)
+{
+	if (m_Phase == kUpdatePhase)
+	{
+		const Chunk& chunk = m_Chunks[job];
+		UpdateParticles(*m_Effects[chunk.m_Effect], chunk.m_First, chunk.m_Count, m_TimeDelta);
+	}
+	else
+	{
+		EmitParticles(*m_Effects[job], m_TimeDelta);
+	}
+}
+
+//===============================================================================
+
+namespace
+{
+	// ParticleSpawnData and ParticleMotion, as the shaders see them
+	struct ReferenceSpawnData
+	{
+		float AgeRate;
+		float StartSize;
+		float EndSize;
+		float Velocity[3];
+		float Mass;
+		float SpreadOffset[3];
+		float Random;
+		float StartColor[4];
+		float EndColor[4];
+	};
+
+	struct ReferenceMotion
+	{
+		float Position[3];
+		float Mass;
+		float Velocity[3];
+		float Age;
+		uint32_t ResetDataIndex;
+	};
+
+	// ParticleEffect, with ParticleUpdateCS and ParticleSpawnCS run one thread at a time
+	struct ReferenceEffect
+	{
+		ParticleSim::EffectDesc m_Desc;
+		CounterRNG::Stream m_Random;
+		float m_LastEmitPosition[3];
+		float m_ElapsedTime = 0.0f;
+		std::vector<ReferenceSpawnData> m_ResetData;
+		std::vector<ReferenceMotion> m_State;
+		std::vector<ParticleSim::SpriteVertex> m_Vertices;
+
+		ReferenceEffect(const ParticleSim::EffectDesc& desc, uint64_t seed) : m_Desc(desc), m_Random(seed)
+		{
+			using namespace ParticleSim;
+
+			std::memcpy(m_LastEmitPosition, desc.m_EmitPosition, sizeof(m_LastEmitPosition));
+			m_ResetData.resize(desc.m_MaxParticles);
+			for (ReferenceSpawnData& rd : m_ResetData)
+			{
+				float values[kNumSpawnStreams];
+				DrawSpawnData(desc, m_Random, values);
+				rd.AgeRate = values[kSpawnAgeRate];
+				rd.StartSize = values[kSpawnStartSize];
+				rd.EndSize = values[kSpawnEndSize];
+				std::memcpy(rd.Velocity, &values[kSpawnVelocityX], sizeof(rd.Velocity));
+				rd.Mass = values[kSpawnMass];
+				std::memcpy(rd.SpreadOffset, &values[kSpawnSpreadX], sizeof(rd.SpreadOffset));
+				rd.Random = values[kSpawnRandom];
+				std::memcpy(rd.StartColor, &values[kSpawnStartR], sizeof(rd.StartColor));
+				std::memcpy(rd.EndColor, &values[kSpawnEndR], sizeof(rd.EndColor));
+			}
+		}
+
+		// ParticleUpdateCS for one particle. False if it has died
+		bool UpdateParticle(ReferenceMotion& state, float elapsed)
+		{
+			const ReferenceSpawnData& rd = m_ResetData[state.ResetDataIndex];
+
+			state.Age += elapsed * rd.AgeRate;
+			if (state.Age >= 1.0f)
+				return false;
+
+			const float* gravity = m_Desc.m_Gravity;
+			float stepSize = (state.Position[1] > 0.0f && state.Velocity[1] < 0.0f) ?
+				std::min(elapsed, state.Position[1] / (0.0f - state.Velocity[1])) : elapsed;
+
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				state.Position[axis] += state.Velocity[axis] * stepSize;
+				state.Velocity[axis] += gravity[axis] * state.Mass * stepSize;
+			}
+
+			stepSize = elapsed - stepSize;
+			if (stepSize > 0.0f)
+			{
+				state.Velocity[0] = state.Velocity[0] * m_Desc.m_Restitution;
+				state.Velocity[1] = (0.0f - state.Velocity[1]) * m_Desc.m_Restitution;
+				state.Velocity[2] = state.Velocity[2] * m_Desc.m_Restitution;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					state.Position[axis] += state.Velocity[axis] * stepSize;
+					state.Velocity[axis] += gravity[axis] * state.Mass * stepSize;
+				}
+			}
+
+			ParticleSim::SpriteVertex sprite;
+			std::memcpy(sprite.m_Position, state.Position, sizeof(sprite.m_Position));
+			sprite.m_TextureID = m_Desc.m_TextureID;
+			sprite.m_Size = Lerp(rd.StartSize, rd.EndSize, state.Age);
+			const float fade = Fade(state.Age);
+			for (uint32_t c = 0; c < 4; ++c)
+				sprite.m_Color[c] = Lerp(rd.StartColor[c], rd.EndColor[c], state.Age) * fade;
+			m_Vertices.push_back(sprite);
+			return true;
+		}
+
+		void Update(float timeDelta)
+		{
+			m_Vertices.clear();
+			if (timeDelta == 0.0f)
+				return;
+
+			m_ElapsedTime += timeDelta;
+
+			uint32_t randIndex[kRandIndices];
+			for (uint32_t i = 0; i < kRandIndices && m_Desc.m_MaxParticles > 0; ++i)
+				randIndex[i] = (uint32_t)m_Random.NextInt((int32_t)m_Desc.m_MaxParticles - 1);
+
+			// A dead particle takes the last one's place, which is then updated in turn
+			for (size_t i = 0; i < m_State.size(); )
+			{
+				if (UpdateParticle(m_State[i], timeDelta))
+				{
+					++i;
+				}
+				else
+				{
+					m_State[i] = m_State.back();
+					m_State.pop_back();
+				}
+			}
+
+			if (m_Desc.m_MaxParticles > 0)
+			{
+				float emitterVelocity[3];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+					emitterVelocity[axis] = m_Desc.m_EmitPosition[axis] - m_LastEmitPosition[axis];
+
+				const uint32_t spawnCount = GetSpawnCount(m_Desc, timeDelta, (uint32_t)m_State.size());
+				for (uint32_t k = 0; k < spawnCount; ++k)
+				{
+					const uint32_t resetDataIndex = randIndex[k % kRandIndices];
+					const ReferenceSpawnData& rd = m_ResetData[resetDataIndex];
+
+					ReferenceMotion newParticle;
+					SpawnMotion(m_Desc, emitterVelocity, rd.Velocity, rd.SpreadOffset, rd.Random, newParticle.Position, newParticle.Velocity);
+					newParticle.Mass = rd.Mass;
+					newParticle.Age = 0.0f;
+					newParticle.ResetDataIndex = resetDataIndex;
+					m_State.push_back(newParticle);
+				}
+			}
+
+			std::memcpy(m_LastEmitPosition, m_Desc.m_EmitPosition, sizeof(m_LastEmitPosition));
+		}
+	};
+
+	bool NearlyEqual(float a, float b)
+	{
+		return std::fabs(a - b) <= 1e-4f * std::max(std::max(std::fabs(a), std::fabs(b)), 1.0f);
+	}
+
+	bool Matches(const ParticleSim::Effect& effect, const ReferenceEffect& reference)
+	{
+		using namespace ParticleSim;
+
+		if (effect.m_Count != (uint32_t)reference.m_State.size() || effect.m_SpriteCount != (uint32_t)reference.m_Vertices.size())
+			return false;
+
+		for (uint32_t i = 0; i < effect.m_Count; ++i)
+		{
+			const ReferenceMotion& state = reference.m_State[i];
+			if (effect.m_ResetIndex[i] != state.ResetDataIndex ||
+				!NearlyEqual(effect.GetStream(kPositionX)[i], state.Position[0]) ||
+				!NearlyEqual(effect.GetStream(kPositionY)[i], state.Position[1]) ||
+				!NearlyEqual(effect.GetStream(kPositionZ)[i], state.Position[2]) ||
+				!NearlyEqual(effect.GetStream(kVelocityX)[i], state.Velocity[0]) ||
+				!NearlyEqual(effect.GetStream(kVelocityY)[i], state.Velocity[1]) ||
+				!NearlyEqual(effect.GetStream(kVelocityZ)[i], state.Velocity[2]) ||
+				!NearlyEqual(effect.GetStream(kAge)[i], state.Age))
+				return false;
+		}
+
+		for (uint32_t i = 0; i < effect.m_SpriteCount; ++i)
+		{
+			const SpriteVertex& vertex = reference.m_Vertices[i];
+			if (!NearlyEqual(effect.GetStream(kSize)[i], vertex.m_Size))
+				return false;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				if (!NearlyEqual(effect.GetStream((ParticleStream)(kColorR + c))[i], vertex.m_Color[c]))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	ParticleSim::EffectDesc MakeBenchmarkEffect(const ParticleSim::BenchmarkDesc& desc, CounterRNG::Stream& random)
+	{
+		ParticleSim::EffectDesc effect = desc.m_Template;
+		effect.m_MaxParticles = desc.m_MaxParticles;
+		effect.m_EmitRate = desc.m_EmitRate;
+
+		// Somewhere around a Sponza sized floor, some from above it and some from below so both sides of the rebound get used
+		effect.m_EmitPosition[0] = random.NextFloat(-10.0f, 10.0f);
+		effect.m_EmitPosition[1] = random.NextFloat(-1.0f, 4.0f);
+		effect.m_EmitPosition[2] = random.NextFloat(-5.0f, 5.0f);
+		effect.m_EmitSpeed = random.NextFloat(0.5f, 2.0f);
+		effect.m_Restitution = random.NextFloat(0.2f, 0.9f);
+		effect.m_Gravity[1] = random.NextFloat(-9.8f, -1.0f);
+		effect.m_LifeMinMax[0] = random.NextFloat(0.5f, 1.5f);
+		effect.m_LifeMinMax[1] = effect.m_LifeMinMax[0] + random.NextFloat(0.1f, 1.5f);
+
+		// Most outlast the run, the rest retire part way and are replaced
+		const float runTime = desc.m_Frames * desc.m_TimeDelta;
+		effect.m_TotalActiveLifetime = random.NextFloat(0.25f * runTime, 3.0f * runTime);
+		return effect;
+	}
+}
+
+ParticleSim::BenchmarkResult ParticleSim::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	System system;
+	std::vector<std::unique_ptr<ReferenceEffect>> reference;
+	result.m_Workers = system.GetWorkerCount();
+
+	CounterRNG::Stream random(desc.m_Seed);
+	uint64_t nextSeed = desc.m_Seed;
+
+	auto addEffect = [&]()
+	{
+		const EffectDesc effect = MakeBenchmarkEffect(desc, random);
+		++nextSeed;
+		system.AddEffect(effect, nextSeed);
+		reference.emplace_back(new ReferenceEffect(effect, nextSeed));
+	};
+	for (uint32_t e = 0; e < desc.m_Effects; ++e)
+		addEffect();
+
+	double systemSeconds = 0.0, referenceSeconds = 0.0;
+	uint64_t totalParticles = 0;
+
+	for (uint32_t frame = 0; frame < desc.m_Frames && result.m_bValid; ++frame)
+	{
+		auto start = std::chrono::steady_clock::now();
+		system.Update(desc.m_TimeDelta);
+		systemSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Effects are updated, then retired with the same swap-remove, so the two lists stay in step
+		start = std::chrono::steady_clock::now();
+		for (std::unique_ptr<ReferenceEffect>& effect : reference)
+			effect->Update(desc.m_TimeDelta);
+		for (size_t e = 0; e < reference.size(); )
+		{
+			if (reference[e]->m_Desc.m_TotalActiveLifetime <= reference[e]->m_ElapsedTime)
+			{
+				reference[e] = std::move(reference.back());
+				reference.pop_back();
+			}
+			else
+			{
+				++e;
+			}
+		}
+		referenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (system.GetEffectCount() != (uint32_t)reference.size())
+		{
+			result.m_bValid = false;
+			break;
+		}
+		for (uint32_t e = 0; e < system.GetEffectCount() && result.m_bValid; ++e)
+			result.m_bValid = Matches(system.GetEffect(e), *reference[e]);
+
+		const uint32_t particles = system.GetParticleCount();
+		totalParticles += particles;
+		result.m_PeakParticles = std::max(result.m_PeakParticles, particles);
+
+		while (system.GetEffectCount() < desc.m_Effects)
+			addEffect();
+	}
+
+	const double frames = (double)std::max(desc.m_Frames, 1u);
+	result.m_AverageParticles = (double)totalParticles / frames;
+	result.m_SystemMs = systemSeconds * 1000.0 / frames;
+	result.m_ReferenceMs = referenceSeconds * 1000.0 / frames;
+	return result;
+}
@@ -0,0 +1,2283 @@
+//===============================================================================
+// desc: A CPU implementation of DepthOfField::Render - DoFPass1, the tile pass and its fixup, the prefilters, the main passes, the median
+//       filters and the combine - and of MotionBlur::RenderObjectBlur's compute path, doing the same math as the shaders, in the same order,
+//       through the same buffer formats, so both can be measured at each internal resolution against native from captured frames. Texture
+//       coordinates are snapped to the 8 bits of subtexel precision D3D12 hardware addresses and filters with. What keeps it from matching a
+//       GPU to the bit is that the shaders' divides are reciprocals there, and their multiply-adds and dot products may be fused. The
+//       debug modes and DebugTiles aren't done, and neither is the pixel shader final pass motion blur falls back to without typed UAV loads.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_PostFXReference.h"
+#include "AZB_ToneMapReference.h"
+#include "AZB_CounterRNG.h"
+#include "AZB_HalfFloat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+const float PostFXReference::kResolutionScale[kResolutionScales] = { 0.5f, 0.58f, 0.667f, 0.333f };
+
+namespace
+{
+	using namespace PostFXReference;
+	using HalfFloat::AsUint;
+	using HalfFloat::AsFloat;
+	using HalfFloat::FloatToHalf;
+	using HalfFloat::HalfToFloat;
+	using HalfFloat::RoundToHalf;
+
+	// Tiles are 16x16 at full resolution, which is 8x8 of the half resolution buffers most of the passes work in
+	constexpr uint32_t kTileSize = 16;
+	constexpr uint32_t kHalfTileSize = 8;
+
+	// Unpack and motion blur jobs are bands of rows
+	constexpr uint32_t kRowsPerJob = 16;
+
+	enum Queue { kWorkQueue, kFastQueue, kFixupQueue, kQueueCount };
+
+	// DoFCommon's s_Ring1Q to s_Ring3Q: offsets into the main pass' 24x24 LDS, in the order they're added
+	const int32_t kRing1Q[8] = { 3, -3, 50, -50, 72, -72, 46, -46 };
+	const int32_t kRing2Q[16] = { 6, -6, 53, -53, 100, -100, 122, -122, 144, -144, 118, -118, 92, -92, 43, -43 };
+	const int32_t kRing3Q[24] =
+	{
+		8, -8, 56, -56, 103, -103, 150, -150, 172, -172, 194, -194, 192, -192, 190, -190, 164, -164, 138, -138, 89, -89, 40, -40
+	};
+
+	const int32_t* const kRings[3] = { kRing1Q, kRing2Q, kRing3Q };
+	const uint32_t kRingSizes[3] = { 8, 16, 24 };
+
+	// Where the prefilters' ring samples are in their 10x10 LDS, in the order AccumulateOneRing adds them
+	const int32_t kPreFilterRing[8] = { -1, 1, -10, 10, -9, -11, 9, 11 };
+
+	const float kPi = 3.1415926535897f;
+	const float kMinCoC = 0.56418958f;			// 1 / sqrt(pi)
+	const float kMaxCoCRadius = 16.0f;
+	const float kLumaWeights[3] = { 0.212671f, 0.715160f, 0.072169f };
+
+	const char kInputFileMagic[4] = { 'P', 'F', 'X', 'C' };
+	const uint32_t kInputFileVersion = 1;
+
+	struct InputFileHeader
+	{
+		char m_Magic[4];
+		uint32_t m_Version;
+		uint32_t m_Width;
+		uint32_t m_Height;
+		uint32_t m_FrameCount;
+	};
+	static_assert(sizeof(InputFileHeader) == 20, "InputFileHeader is written as-is, so its layout mustn't change");
+
+	// Ahead of each frame's depth, colour and velocity
+	struct InputFrameHeader
+	{
+		float m_FarClip;
+	};
+	static_assert(sizeof(InputFrameHeader) == 4, "InputFrameHeader is written as-is, so its layout mustn't change");
+
+	// Capture resolutions go no higher than this, so a corrupt header can't ask for gigabytes
+	constexpr uint32_t kMaxFrameDimension = 16384;
+
+	FILE* OpenFile(const std::wstring& fileName, bool bWrite)
+	{
+#if defined(_WIN32)
+		FILE* file = nullptr;
+		return _wfopen_s(&file, fileName.c_str(), bWrite ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+		return std::fopen(std::string(fileName.begin(), fileName.end()).c_str(), bWrite ? "wb" : "rb");
+#endif
+	}
+
+	uint32_t DivideUp(uint32_t value, uint32_t divisor)
+	{
+		return (value + divisor - 1) / divisor;
+	}
+
+	int32_t Clamp(int32_t value, int32_t minValue, int32_t maxValue)
+	{
+		return std::min(std::max(value, minValue), maxValue);
+	}
+
+	void EnsureSize(Plane& plane, uint32_t width, uint32_t height, uint32_t channels)
+	{
+		if (plane.m_Width != width || plane.m_Height != height || plane.m_Channels != channels)
+			plane.Resize(width, height, channels);
+	}
+
+	// Keeps the allocation, for the next frame that uses it
+	void Empty(Plane& plane)
+	{
+		plane.m_Width = 0;
+		plane.m_Height = 0;
+		plane.m_Channels = 0;
+		plane.m_Values.clear();
+	}
+
+	uint32_t MakeTile(uint32_t x, uint32_t y)
+	{
+		return x | y << 16;
+	}
+
+	uint32_t GetTileX(uint32_t tile)
+	{
+		return tile & 0xFFFF;
+	}
+
+	uint32_t GetTileY(uint32_t tile)
+	{
+		return tile >> 16;
+	}
+
+	// Which shader takes each queue's tiles in the prefilter and main passes, as Render picks them. Under ForceSlow the fast queue keeps
+	// whichever the work queue had
+	bool IsWorkQueueFast(const Settings& settings)
+	{
+		return settings.m_bForceFast;
+	}
+
+	bool IsFastQueueFast(const Settings& settings)
+	{
+		return settings.m_bForceSlow ? settings.m_bForceFast : true;
+	}
+
+	// CB0, as DepthOfField::Render fills it in for a linear depth buffer of width by height
+	DoFConstants GetDoFConstants(uint32_t width, uint32_t height, float farClip, const Settings& settings)
+	{
+		DoFConstants constants = {};
+		constants.m_FocusCenter = settings.m_FocalDepth;
+		constants.m_FocalSpread = 1.0f / settings.m_FocalRange;
+		constants.m_FocalMinDist = settings.m_FocalDepth - settings.m_FocalRange;
+		constants.m_FocalMaxDist = settings.m_FocalDepth + settings.m_FocalRange;
+		constants.m_RcpBufferDim[0] = 1.0f / (float)width;
+		constants.m_RcpBufferDim[1] = 1.0f / (float)height;
+		constants.m_FullDimension[0] = width;
+		constants.m_FullDimension[1] = height;
+		constants.m_HalfDimensionMinusOne[0] = (int32_t)DivideUp(width, 2);
+		constants.m_HalfDimensionMinusOne[1] = (int32_t)DivideUp(height, 2);
+		constants.m_TiledDimension[0] = DivideUp(width, kTileSize);
+		constants.m_TiledDimension[1] = DivideUp(height, kTileSize);
+		constants.m_InvTiledDimension[0] = 1.0f / (float)constants.m_TiledDimension[0];
+		constants.m_InvTiledDimension[1] = 1.0f / (float)constants.m_TiledDimension[1];
+		constants.m_bDisablePreFilter = !settings.m_bEnablePreFilter;
+		constants.m_ForegroundRange = settings.m_ForegroundRange / farClip;
+		constants.m_RcpForegroundRange = farClip / settings.m_ForegroundRange;
+		constants.m_AntiSparkleFilterStrength = settings.m_AntiSparkleWeight;
+		return constants;
+	}
+
+	//===============================================================================
+	// Velocity packing, as PixelPacking_Velocity has it: x and y as 10 bit floats of a 32768th, and z as a 12 bit float of a 128th
+
+	uint32_t PackXY(float x)
+	{
+		const uint32_t signBit = AsUint(x) >> 31;
+		x = std::min(std::max(std::fabs(x / 32768.0f), 0.0f), AsFloat(0x3BFFE000));
+		return (FloatToHalf(x) + 8) >> 4 | signBit << 9;
+	}
+
+	float UnpackXY(uint32_t x)
+	{
+		return HalfToFloat((x & 0x1FF) << 4 | (x >> 9) << 15) * 32768.0f;
+	}
+
+	uint32_t PackZ(float x)
+	{
+		const uint32_t signBit = AsUint(x) >> 31;
+		x = std::min(std::max(std::fabs(x / 128.0f), 0.0f), AsFloat(0x3BFFE000));
+		return (FloatToHalf(x) + 2) >> 2 | signBit << 11;
+	}
+
+	float UnpackZ(uint32_t x)
+	{
+		return HalfToFloat((x & 0x7FF) << 2 | (x >> 11) << 15) * 128.0f;
+	}
+
+	//===============================================================================
+	// Shader helpers. Processor and the reference share these, so they can only differ in how they walk the buffers
+
+	// As maxps and minps, which give the second operand when either is NaN. That's also what saturate does with a NaN
+	float Max(float a, float b)
+	{
+		return a > b ? a : b;
+	}
+
+	float Min(float a, float b)
+	{
+		return a < b ? a : b;
+	}
+
+	float Saturate(float value)
+	{
+		return Min(Max(value, 0.0f), 1.0f);
+	}
+
+	float Clamp(float value, float minValue, float maxValue)
+	{
+		return Min(Max(value, minValue), maxValue);
+	}
+
+	// HLSL's lerp
+	float Lerp(float a, float b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	float Max3(float a, float b, float c)
+	{
+		return Max(Max(a, b), c);
+	}
+
+	float Min3(float a, float b, float c)
+	{
+		return Min(Min(a, b), c);
+	}
+
+	float Med3(float a, float b, float c)
+	{
+		return Clamp(a, Min(b, c), Max(b, c));
+	}
+
+	float Max4(const float values[4])
+	{
+		return Max3(values[0], values[1], Max(values[2], values[3]));
+	}
+
+	float Min4(const float values[4])
+	{
+		return Min3(values[0], values[1], Min(values[2], values[3]));
+	}
+
+	// The median filter's, which is close to the median of 9 without sorting them
+	float Med9(const float values[9])
+	{
+		const float a = Max3(Min3(values[0], values[1], values[2]), Min3(values[3], values[4], values[5]), Min3(values[6], values[7], values[8]));
+		const float b = Min3(Max3(values[0], values[1], values[2]), Max3(values[3], values[4], values[5]), Max3(values[6], values[7], values[8]));
+		const float c = Med3(Med3(values[0], values[1], values[2]), Med3(values[3], values[4], values[5]), Med3(values[6], values[7], values[8]));
+		return Med3(a, b, c);
+	}
+
+	float RGBToLuminance(const float rgb[3])
+	{
+		return rgb[0] * kLumaWeights[0] + rgb[1] * kLumaWeights[1] + rgb[2] * kLumaWeights[2];
+	}
+
+	float ComputeCoC(float depth, const DoFConstants& constants)
+	{
+		return Max(kMinCoC, kMaxCoCRadius * Saturate(std::fabs(depth - constants.m_FocusCenter) * constants.m_FocalSpread));
+	}
+
+	// DoFPass1CS's MaxCoC, of the four depths a gather gave
+	float MaxCoC(const float depths[4], const DoFConstants& constants)
+	{
+		float distances[4];
+		for (uint32_t i = 0; i < 4; ++i)
+			distances[i] = std::fabs(depths[i] - constants.m_FocusCenter);
+		return Max(kMinCoC, kMaxCoCRadius * Saturate(Max4(distances) * constants.m_FocalSpread));
+	}
+
+	float BackgroundPercent(float depth, float tileMinDepth, const DoFConstants& constants)
+	{
+		return Saturate((depth - tileMinDepth) * constants.m_RcpForegroundRange - 1.0f);
+	}
+
+	float ForegroundPercent(float depth, float tileMinDepth, const DoFConstants& constants)
+	{
+		return 1.0f - BackgroundPercent(depth, tileMinDepth, constants);
+	}
+
+	float SampleAlpha(float coc)
+	{
+		return 1.0f / (kPi * coc * coc);
+	}
+
+	float ComputeRenormalizationFactor(float foregroundDepth, const DoFConstants& constants)
+	{
+		const float foregroundCoC = ComputeCoC(foregroundDepth, constants);
+		const float rings = (foregroundCoC - 1.0f) / 5.0f;
+		const float sampleCount = 1.0f + Saturate(rings) * 8.0f + Saturate(rings - 1.0f) * 16.0f + Saturate(rings - 2.0f) * 24.0f;
+		return 2.0f * kPi * foregroundCoC * foregroundCoC / sampleCount;
+	}
+
+	// The prefilters' weight for a sample as far in front of or behind what it's compared with as depth goes
+	float ComputeSampleWeight(float sampleDepth, float compareDepth, const DoFConstants& constants)
+	{
+		return 1.0f - Saturate(std::fabs(compareDepth - sampleDepth) * constants.m_RcpForegroundRange - 1.0f);
+	}
+
+	void WeightByInverseLuminance(const float rgb[3], const DoFConstants& constants, float color[4])
+	{
+		const float weight = 1.0f / (RGBToLuminance(rgb) * constants.m_AntiSparkleFilterStrength + 1.0f);
+		for (uint32_t c = 0; c < 3; ++c)
+			color[c] = rgb[c] * weight;
+		color[3] = weight;
+	}
+
+	// The median filter's sort key: luminance with the low 8 bits swapped for where the colour is in LDS
+	float LumaKey(const float rgb[3], uint32_t index)
+	{
+		return AsFloat((AsUint(RGBToLuminance(rgb) + 1.0f) & ~0xFFu) | index);
+	}
+
+	//===============================================================================
+	// Buffers
+
+	// The UAV store of a float3 to R11G11B10_FLOAT, and reading it back
+	void StoreColor(Plane& plane, uint32_t x, uint32_t y, const float rgb[3])
+	{
+		ToneMapReference::UnpackR11G11B10(ToneMapReference::PackR11G11B10(rgb), plane.At(x, y));
+	}
+
+	// And to R8_UNORM, which the blurred alpha is
+	void StoreUnorm8(Plane& plane, uint32_t x, uint32_t y, float value)
+	{
+		plane.At(x, y)[0] = (float)(int32_t)(Saturate(value) * 255.0f + 0.5f) / 255.0f;
+	}
+
+	// And to R16G16B16A16_FLOAT, which g_MotionPrepBuffer is
+	void StoreHalf4(Plane& plane, uint32_t x, uint32_t y, const float rgba[4])
+	{
+		float* texel = plane.At(x, y);
+		for (uint32_t c = 0; c < 4; ++c)
+			texel[c] = RoundToHalf(rgba[c]);
+	}
+
+	// Texture Load, with anything outside the texture reading as 0
+	void Load(const Plane& plane, int32_t x, int32_t y, float* texel)
+	{
+		if (x < 0 || y < 0 || x >= (int32_t)plane.m_Width || y >= (int32_t)plane.m_Height)
+		{
+			std::fill(texel, texel + plane.m_Channels, 0.0f);
+			return;
+		}
+		std::memcpy(texel, plane.At((uint32_t)x, (uint32_t)y), plane.m_Channels * sizeof(float));
+	}
+
+	const float* LoadClamped(const Plane& plane, int32_t x, int32_t y)
+	{
+		return plane.At((uint32_t)Clamp(x, 0, (int32_t)plane.m_Width - 1), (uint32_t)Clamp(y, 0, (int32_t)plane.m_Height - 1));
+	}
+
+	// std::floor is a library call on plain SSE2, and this is on every sample
+	int32_t FloorToInt(float value)
+	{
+		const int32_t truncated = (int32_t)value;
+		return (float)truncated > value ? truncated - 1 : truncated;
+	}
+
+	// Where a texture coordinate lands, in 256ths of a texel
+	int32_t ToSubtexels(float coordinate, uint32_t size)
+	{
+		return FloorToInt(coordinate * (float)size * 256.0f + 0.5f);
+	}
+
+	int32_t ToTexels(int32_t subtexels)
+	{
+		return FloorToInt((float)subtexels * (1.0f / 256.0f));
+	}
+
+	// Gather through the clamping sampler, of one channel: x is below left of where (u, v) lands, y below right, z above right and w above left
+	void Gather(const Plane& plane, uint32_t channel, float u, float v, float texels[4])
+	{
+		const int32_t left = ToTexels(ToSubtexels(u, plane.m_Width) - 128);
+		const int32_t top = ToTexels(ToSubtexels(v, plane.m_Height) - 128);
+		texels[0] = LoadClamped(plane, left, top + 1)[channel];
+		texels[1] = LoadClamped(plane, left + 1, top + 1)[channel];
+		texels[2] = LoadClamped(plane, left + 1, top)[channel];
+		texels[3] = LoadClamped(plane, left, top)[channel];
+	}
+
+	enum AddressMode { kClamp, kBorder };
+
+	// SampleLevel at mip 0 through a linear sampler. Border is transparent black, as the common root signature's linear border sampler has it
+	void Sample(const Plane& plane, float u, float v, AddressMode mode, float* result)
+	{
+		const int32_t x = ToSubtexels(u, plane.m_Width) - 128;
+		const int32_t y = ToSubtexels(v, plane.m_Height) - 128;
+		const int32_t left = ToTexels(x);
+		const int32_t top = ToTexels(y);
+		const float fx = (float)(x - left * 256) * (1.0f / 256.0f);
+		const float fy = (float)(y - top * 256) * (1.0f / 256.0f);
+
+		float texels[4][4];
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			const int32_t tx = left + (int32_t)(i & 1);
+			const int32_t ty = top + (int32_t)(i >> 1);
+			if (mode == kClamp)
+				std::memcpy(texels[i], LoadClamped(plane, tx, ty), plane.m_Channels * sizeof(float));
+			else
+				Load(plane, tx, ty, texels[i]);
+		}
+
+		for (uint32_t c = 0; c < plane.m_Channels; ++c)
+			result[c] = Lerp(Lerp(texels[0][c], texels[1][c], fx), Lerp(texels[2][c], texels[3][c], fx), fy);
+	}
+
+	// Through the DoF root signature's point sampler, which has a black border
+	float SamplePoint(const Plane& plane, float u, float v)
+	{
+		float texel[4];
+		Load(plane, ToTexels(ToSubtexels(u, plane.m_Width)), ToTexels(ToSubtexels(v, plane.m_Height)), texel);
+		return texel[0];
+	}
+
+	//===============================================================================
+	// Passes, a pixel or a sample at a time
+
+	void UnpackRows(const InputFrame& input, uint32_t y0, uint32_t y1, FrameResult& result)
+	{
+		const uint32_t width = input.m_Width;
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const size_t index = (size_t)y * width + x;
+				result.m_LinearDepth.At(x, y)[0] = (float)input.m_LinearDepth[index] / 65535.0f;
+				ToneMapReference::UnpackR11G11B10(input.m_Color[index], result.m_Color.At(x, y));
+
+				float velocity[3];
+				UnpackVelocity(input.m_Velocity[index], velocity);
+				result.m_Velocity.At(x, y)[0] = velocity[0];
+				result.m_Velocity.At(x, y)[1] = velocity[1];
+			}
+
+			// DoF is combined into the scene where it's blurred, and leaves the rest as it was
+			if (!result.m_DepthOfField.m_Values.empty())
+				std::memcpy(result.m_DepthOfField.At(0, y), result.m_Color.At(0, y), (size_t)width * 3 * sizeof(float));
+		}
+	}
+
+	// One DoFPass1CS thread's gather, from its 2x2 of full resolution pixels
+	void GatherTileQuad(const Plane& linearDepth, uint32_t x, uint32_t y, const DoFConstants& constants, float& closest, float& farthest,
+		float& maxCoC)
+	{
+		float depths[4];
+		Gather(linearDepth, 0, (float)(x * 2 + 1) * constants.m_RcpBufferDim[0], (float)(y * 2 + 1) * constants.m_RcpBufferDim[1], depths);
+		closest = Min4(depths);
+		farthest = Max4(depths);
+		maxCoC = MaxCoC(depths, constants);
+	}
+
+	// DoFTilePassCS for one tile, from the 3x3 of TileClass0 around it a row at a time. Gives the queue it goes in, or kQueueCount for none
+	uint32_t SpreadTile(const float maxCoCs[9], const float minDepths[9], const float maxDepths[9], const DoFConstants& constants,
+		float tileClass[3])
+	{
+		const float finalMaxCoC = Max3(Max3(maxCoCs[0], maxCoCs[1], maxCoCs[2]), Max3(maxCoCs[3], maxCoCs[4], maxCoCs[5]),
+			Max3(maxCoCs[6], maxCoCs[7], maxCoCs[8]));
+		const float finalMinDepth = Clamp(Min3(Min3(minDepths[0], minDepths[1], minDepths[2]), Min3(minDepths[3], minDepths[4], minDepths[5]),
+			Min3(minDepths[6], minDepths[7], minDepths[8])), constants.m_FocalMinDist, constants.m_FocalMaxDist);
+		const float finalMaxDepth = Clamp(Max3(Max3(maxDepths[0], maxDepths[1], maxDepths[2]), Max3(maxDepths[3], maxDepths[4], maxDepths[5]),
+			Max3(maxDepths[6], maxDepths[7], maxDepths[8])), constants.m_FocalMinDist, constants.m_FocalMaxDist);
+
+		tileClass[0] = finalMaxCoC;
+		tileClass[1] = finalMinDepth;
+		tileClass[2] = ComputeRenormalizationFactor(finalMinDepth, constants);
+
+		// Decided on what was worked out, not on what TileClass1 rounds it to
+		if (finalMaxCoC < 1.0f)
+			return kQueueCount;
+		return finalMaxDepth - finalMinDepth > constants.m_ForegroundRange ? kWorkQueue : kFastQueue;
+	}
+
+	// DoFTilePassFixupCS: a sharp tile next to a blurred one, which has to have something in the half resolution buffers for its neighbours
+	// to blur
+	bool NeedsFixup(const float maxCoCs[9])
+	{
+		const float maxNeighborCoC = Max3(Max3(maxCoCs[0], maxCoCs[1], maxCoCs[2]), Max(maxCoCs[3], maxCoCs[5]), Max3(maxCoCs[6], maxCoCs[7], maxCoCs[8]));
+		return maxCoCs[4] < 1.0f && maxNeighborCoC >= 1.0f;
+	}
+
+	// LoadBlurriestSample from DoFPreFilterCS, or from DoFPreFilterFastCS with bFast, at full resolution texel corner (x, y). The colour is
+	// weighted by inverse luminance, and has yet to go through halves into LDS
+	void LoadBlurriestSample(const FrameResult& result, const DoFConstants& constants, bool bFast, int32_t x, int32_t y, float color[4],
+		float& maxDepth)
+	{
+		const float u = (float)x * constants.m_RcpBufferDim[0];
+		const float v = (float)y * constants.m_RcpBufferDim[1];
+
+		float depths[4];
+		Gather(result.m_LinearDepth, 0, u, v, depths);
+		for (uint32_t i = 0; i < 4; ++i)
+			depths[i] = Clamp(depths[i], constants.m_FocalMinDist, constants.m_FocalMaxDist);
+		maxDepth = Max4(depths);
+
+		float rgb[3];
+		if (bFast)
+		{
+			Sample(result.m_Color, u, v, kClamp, rgb);
+		}
+		else
+		{
+			float channels[3][4], weights[4];
+			for (uint32_t c = 0; c < 3; ++c)
+				Gather(result.m_Color, c, u, v, channels[c]);
+			for (uint32_t i = 0; i < 4; ++i)
+				weights[i] = ComputeSampleWeight(depths[i], maxDepth, constants);
+
+			const float totalWeight = weights[0] + weights[1] + weights[2] + weights[3];
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				rgb[c] = (weights[0] * channels[c][0] + weights[1] * channels[c][1] + weights[2] * channels[c][2] + weights[3] * channels[c][3]) /
+					totalWeight;
+			}
+		}
+		WeightByInverseLuminance(rgb, constants, color);
+	}
+
+	// The rest of either prefilter for one pixel, from its LDS sample and the 8 around it in kPreFilterRing's order
+	void PreFilterPixel(const float center[4], float depth, const float* const ring[8], const float ringDepths[8], bool bFast,
+		const DoFConstants& constants, float presort[3], float output[3])
+	{
+		const float coc = ComputeCoC(depth, constants);
+
+		// The fast path leaves a negative ring count for the store to clamp
+		presort[0] = bFast ? (coc - 1.0f) / 5.0f : Max(0.0f, (coc - 1.0f) / 5.0f);
+		presort[1] = SampleAlpha(coc);
+		presort[2] = depth;
+
+		float color[4] = { center[0], center[1], center[2], center[3] };
+		if (coc >= 1.0f && !constants.m_bDisablePreFilter)
+		{
+			float weights[8];
+			for (uint32_t i = 0; i < 8; ++i)
+				weights[i] = bFast ? 1.0f : ComputeSampleWeight(ringDepths[i], depth, constants);
+
+			const float blend = Saturate(coc - 1.0f);
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				float sample[8];
+				for (uint32_t i = 0; i < 8; ++i)
+					sample[i] = bFast ? ring[i][c] : ring[i][c] * weights[i];
+				const float accumulated = sample[0] + sample[1] + sample[2] + sample[3] + 0.75f * (sample[4] + sample[5] + sample[6] + sample[7]);
+				color[c] += blend * accumulated;
+			}
+		}
+
+		for (uint32_t c = 0; c < 3; ++c)
+			output[c] = color[c] / color[3];
+	}
+
+	// DoFPreFilterFixupCS, which only samples down
+	void PreFilterFixupPixel(const FrameResult& result, const DoFConstants& constants, uint32_t x, uint32_t y, float presort[3], float output[3])
+	{
+		const float u = (float)(2 * x + 1) * constants.m_RcpBufferDim[0];
+		const float v = (float)(2 * y + 1) * constants.m_RcpBufferDim[1];
+		Sample(result.m_Color, u, v, kClamp, output);
+		presort[0] = 0.0f;
+		presort[1] = 1.0f;
+		presort[2] = SamplePoint(result.m_LinearDepth, u, v);
+	}
+
+	// DoFPass2CS's PrefetchPixel, before it goes through halves into LDS. The main passes clamp to one past the last texel, which reads as 0
+	void PrefetchMainPass(const FrameResult& result, const DoFConstants& constants, int32_t x, int32_t y, float tileMinDepth, float renormFactor,
+		float color[4], float& rings, float& foreground)
+	{
+		x = Clamp(x, 0, constants.m_HalfDimensionMinusOne[0]);
+		y = Clamp(y, 0, constants.m_HalfDimensionMinusOne[1]);
+
+		float presort[3], prefilter[3];
+		Load(result.m_Presort, x, y, presort);
+		Load(result.m_Prefilter, x, y, prefilter);
+		const float sampleAlpha = presort[1];
+		for (uint32_t c = 0; c < 3; ++c)
+			color[c] = prefilter[c] * sampleAlpha * renormFactor;
+		color[3] = sampleAlpha * renormFactor;
+		rings = presort[0];
+		foreground = ForegroundPercent(presort[2], tileMinDepth, constants);
+	}
+
+	// DoFPass2FastCS's, which is only the colour
+	void PrefetchMainPassFast(const FrameResult& result, const DoFConstants& constants, int32_t x, int32_t y, float color[3])
+	{
+		Load(result.m_Prefilter, Clamp(x, 0, constants.m_HalfDimensionMinusOne[0]), Clamp(y, 0, constants.m_HalfDimensionMinusOne[1]), color);
+	}
+
+	void AccumulateSample(const float color[4], float coc, float foregroundPercent, float radius, float background[4], float foreground[4])
+	{
+		const float weight = Saturate(1.0f - (radius - coc));
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			background[c] += color[c] * (1.0f - foregroundPercent) * weight;
+			foreground[c] += color[c] * foregroundPercent * weight;
+		}
+	}
+
+	// The end of DoFPass2CS, once the rings are in
+	void ResolveMainPass(float background[4], float foreground[4], float output[3], float& alpha)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			background[c] /= background[3] + 0.00001f;
+			foreground[c] /= foreground[3] + 0.00001f;
+		}
+
+		const float foregroundAlpha = Saturate(foreground[3]);
+		for (uint32_t c = 0; c < 3; ++c)
+			output[c] = Lerp(background[c], foreground[c], foregroundAlpha);
+		alpha = Lerp(foregroundAlpha, 1.0f, 0.5f);
+	}
+
+	// DoFCombine2CS for one full resolution pixel of a tile
+	void CombinePixel(FrameResult& result, const DoFConstants& constants, uint32_t tile, uint32_t x, uint32_t y)
+	{
+		const uint32_t source = result.m_BlurColor[1].m_Values.empty() ? 0 : 1;
+		const float u = ((float)x + 0.5f) * constants.m_RcpBufferDim[0];
+		const float v = ((float)y + 0.5f) * constants.m_RcpBufferDim[1];
+		const float depth = result.m_LinearDepth.At(x, y)[0];
+
+		float dofColor[3], foregroundAlpha;
+		Sample(result.m_BlurColor[source], u, v, kClamp, dofColor);
+		Sample(result.m_BlurAlpha[source], u, v, kClamp, &foregroundAlpha);
+
+		const float tileMinDepth = result.m_TileClass[1].At(GetTileX(tile), GetTileY(tile))[1];
+		const float backgroundPercent = BackgroundPercent(depth, tileMinDepth, constants);
+		const float pixelBlurriness = Saturate((ComputeCoC(depth, constants) - 1.0f) / 1.5f);
+		const float combinedFactor = Lerp(pixelBlurriness, Lerp(foregroundAlpha, 1.0f, pixelBlurriness), backgroundPercent);
+
+		const float* destination = result.m_DepthOfField.At(x, y);
+		float output[3];
+		for (uint32_t c = 0; c < 3; ++c)
+			output[c] = Lerp(destination[c], dofColor[c], combinedFactor);
+		StoreColor(result.m_DepthOfField, x, y, output);
+	}
+
+	// MotionBlurPrePassCS for one texel of g_MotionPrepBuffer: its 2x2 of full resolution pixels, each weighted by how fast it's moving
+	void MotionPrepTexel(FrameResult& result, uint32_t x, uint32_t y)
+	{
+		float samples[4][4];
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			float velocity[2];
+			Load(result.m_Color, (int32_t)(x * 2 + (i & 1)), (int32_t)(y * 2 + (i >> 1)), samples[i]);
+			Load(result.m_Velocity, (int32_t)(x * 2 + (i & 1)), (int32_t)(y * 2 + (i >> 1)), velocity);
+
+			const float speed = std::sqrt(velocity[0] * velocity[0] + velocity[1] * velocity[1]);
+			const float weight = Saturate(speed * 32.0f / 4.0f);
+			for (uint32_t c = 0; c < 3; ++c)
+				samples[i][c] *= weight;
+			samples[i][3] = weight;
+		}
+
+		const float combinedMotionWeight = samples[0][3] + samples[1][3] + samples[2][3] + samples[3][3] + 0.0001f;
+		const float scale = std::floor(0.25f * combinedMotionWeight * 3.0f) / 3.0f;
+
+		float prep[4];
+		for (uint32_t c = 0; c < 3; ++c)
+			prep[c] = scale * ((samples[0][c] + samples[1][c] + samples[2][c] + samples[3][c]) / combinedMotionWeight);
+		prep[3] = scale;
+		StoreHalf4(result.m_MotionPrep, x, y, prep);
+	}
+
+	// MotionBlurFinalPassCS for one pixel: up to 5 samples of the prepass each way along its velocity, 3 pixels apart
+	void MotionBlurPixel(FrameResult& result, uint32_t x, uint32_t y)
+	{
+		const Plane& prep = result.m_MotionPrep;
+		const float rcpWidth = 1.0f / (float)result.m_Color.m_Width;
+		const float rcpHeight = 1.0f / (float)result.m_Color.m_Height;
+
+		const float* velocity = result.m_Velocity.At(x, y);
+		const float* color = result.m_Color.At(x, y);
+		float output[3] = { color[0], color[1], color[2] };
+
+		const float speed = std::sqrt(velocity[0] * velocity[0] + velocity[1] * velocity[1]);
+		if (speed >= 4.0f)
+		{
+			float accum[4] = { color[0], color[1], color[2], 1.0f };
+			const float halfSampleCount = Min(10.0f * 0.5f, speed * 0.5f / 3.0f);
+
+			float delta[2] = { velocity[0] / speed * rcpWidth * 3.0f, velocity[1] / speed * rcpHeight * 3.0f };
+			float uv1[2] = { ((float)x + 0.5f) * rcpWidth, ((float)y + 0.5f) * rcpHeight };
+			float uv2[2] = { uv1[0], uv1[1] };
+
+			float sample[4];
+			for (float i = halfSampleCount - 1.0f; i > 0.0f; i -= 1.0f)
+			{
+				uv1[0] += delta[0];
+				uv1[1] += delta[1];
+				Sample(prep, uv1[0], uv1[1], kBorder, sample);
+				for (uint32_t c = 0; c < 4; ++c)
+					accum[c] += sample[c];
+
+				uv2[0] -= delta[0];
+				uv2[1] -= delta[1];
+				Sample(prep, uv2[0], uv2[1], kBorder, sample);
+				for (uint32_t c = 0; c < 4; ++c)
+					accum[c] += sample[c];
+			}
+
+			// As frac(halfSampleCount), but with 1 in place of 0
+			const float remainder = 1.0f + halfSampleCount - std::ceil(halfSampleCount);
+			delta[0] *= remainder;
+			delta[1] *= remainder;
+
+			Sample(prep, uv1[0] + delta[0], uv1[1] + delta[1], kBorder, sample);
+			for (uint32_t c = 0; c < 4; ++c)
+				accum[c] += sample[c] * remainder;
+			Sample(prep, uv2[0] - delta[0], uv2[1] - delta[1], kBorder, sample);
+			for (uint32_t c = 0; c < 4; ++c)
+				accum[c] += sample[c] * remainder;
+
+			const float blend = Saturate(speed / 32.0f);
+			for (uint32_t c = 0; c < 3; ++c)
+				output[c] = Lerp(color[c], accum[c] / accum[3], blend);
+		}
+		StoreColor(result.m_MotionBlur, x, y, output);
+	}
+
+	//===============================================================================
+	// Processor's tiles. LDS is kept as the floats the halves in it would come back as, rather than packed two to a word
+
+	bool IsInside(const Plane& plane, uint32_t x, uint32_t y)
+	{
+		return x < plane.m_Width && y < plane.m_Height;
+	}
+
+	void PreFilterTile(FrameResult& result, const DoFConstants& constants, uint32_t tile, bool bFast)
+	{
+		const int32_t cornerX = (int32_t)(GetTileX(tile) * kTileSize) - 1;
+		const int32_t cornerY = (int32_t)(GetTileY(tile) * kTileSize) - 1;
+
+		float colors[100][4], depths[100];
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			LoadBlurriestSample(result, constants, bFast, cornerX + (int32_t)(i % 10) * 2, cornerY + (int32_t)(i / 10) * 2, colors[i], depths[i]);
+			for (uint32_t c = 0; c < 4; ++c)
+				colors[i][c] = RoundToHalf(colors[i][c]);
+		}
+
+		for (uint32_t threadY = 0; threadY < kHalfTileSize; ++threadY)
+		{
+			for (uint32_t threadX = 0; threadX < kHalfTileSize; ++threadX)
+			{
+				const uint32_t x = GetTileX(tile) * kHalfTileSize + threadX, y = GetTileY(tile) * kHalfTileSize + threadY;
+				if (!IsInside(result.m_Prefilter, x, y))
+					continue;
+
+				const uint32_t index = threadX + threadY * 10 + 11;
+				const float* ring[8];
+				float ringDepths[8];
+				for (uint32_t i = 0; i < 8; ++i)
+				{
+					ring[i] = colors[index + kPreFilterRing[i]];
+					ringDepths[i] = depths[index + kPreFilterRing[i]];
+				}
+
+				float presort[3], output[3];
+				PreFilterPixel(colors[index], depths[index], ring, ringDepths, bFast, constants, presort, output);
+				StoreColor(result.m_Presort, x, y, presort);
+				StoreColor(result.m_Prefilter, x, y, output);
+			}
+		}
+	}
+
+	void MainPassTile(FrameResult& result, const DoFConstants& constants, uint32_t tile, bool bFast)
+	{
+		const uint32_t tileX = GetTileX(tile), tileY = GetTileY(tile);
+		const int32_t cornerX = (int32_t)(tileX * kHalfTileSize) - 8, cornerY = (int32_t)(tileY * kHalfTileSize) - 8;
+		const float* tileClass = result.m_TileClass[1].At(tileX, tileY);
+		const float ringCount = (tileClass[0] - 1.0f) / 5.0f;
+
+		if (bFast)
+		{
+			// Red and blue go through halves, and green is kept whole
+			float colors[24 * 24][3];
+			for (uint32_t i = 0; i < 24 * 24; ++i)
+			{
+				PrefetchMainPassFast(result, constants, cornerX + (int32_t)(i % 24), cornerY + (int32_t)(i / 24), colors[i]);
+				colors[i][0] = RoundToHalf(colors[i][0]);
+				colors[i][2] = RoundToHalf(colors[i][2]);
+			}
+
+			for (uint32_t threadY = 0; threadY < kHalfTileSize; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < kHalfTileSize; ++threadX)
+				{
+					const uint32_t x = tileX * kHalfTileSize + threadX, y = tileY * kHalfTileSize + threadY;
+					if (!IsInside(result.m_BlurColor[0], x, y))
+						continue;
+
+					const uint32_t index = threadX + threadY * 24 + 200;
+					float foreground[4] = { colors[index][0], colors[index][1], colors[index][2], 1.0f };
+					for (uint32_t ring = 0; ring < 3; ++ring)
+					{
+						if (ring > 0 && !(ringCount > (float)ring))
+							break;
+
+						float ringSamples[3] = {};
+						for (uint32_t i = 0; i < kRingSizes[ring]; ++i)
+						{
+							for (uint32_t c = 0; c < 3; ++c)
+								ringSamples[c] += colors[(int32_t)index + kRings[ring][i]][c];
+						}
+
+						const float weight = Saturate(ringCount - (float)ring);
+						for (uint32_t c = 0; c < 3; ++c)
+							foreground[c] += weight * ringSamples[c];
+						foreground[3] += weight * (float)kRingSizes[ring];
+					}
+
+					const float output[3] = { foreground[0] / foreground[3], foreground[1] / foreground[3], foreground[2] / foreground[3] };
+					StoreColor(result.m_BlurColor[0], x, y, output);
+					StoreUnorm8(result.m_BlurAlpha[0], x, y, 1.0f);
+				}
+			}
+			return;
+		}
+
+		float colors[24 * 24][4], rings[24 * 24], foregrounds[24 * 24];
+		for (uint32_t i = 0; i < 24 * 24; ++i)
+		{
+			PrefetchMainPass(result, constants, cornerX + (int32_t)(i % 24), cornerY + (int32_t)(i / 24), tileClass[1], tileClass[2], colors[i],
+				rings[i], foregrounds[i]);
+			for (uint32_t c = 0; c < 4; ++c)
+				colors[i][c] = RoundToHalf(colors[i][c]);
+			rings[i] = RoundToHalf(rings[i]);
+			foregrounds[i] = RoundToHalf(foregrounds[i]);
+		}
+
+		for (uint32_t threadY = 0; threadY < kHalfTileSize; ++threadY)
+		{
+			for (uint32_t threadX = 0; threadX < kHalfTileSize; ++threadX)
+			{
+				const uint32_t x = tileX * kHalfTileSize + threadX, y = tileY * kHalfTileSize + threadY;
+				if (!IsInside(result.m_BlurColor[0], x, y))
+					continue;
+
+				const uint32_t index = threadX + threadY * 24 + 200;
+				const float* center = colors[index];
+				const float foregroundPercent = foregrounds[index];
+
+				float background[4], foreground[4];
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					background[c] = center[c] * (1.01f - foregroundPercent);
+					foreground[c] = center[c] * foregroundPercent;
+				}
+
+				for (uint32_t ring = 0; ring < 3; ++ring)
+				{
+					if (ring > 0 && !(ringCount > (float)ring))
+						break;
+					for (uint32_t i = 0; i < kRingSizes[ring]; ++i)
+					{
+						const uint32_t sample = (uint32_t)((int32_t)index + kRings[ring][i]);
+						AccumulateSample(colors[sample], rings[sample], foregrounds[sample], (float)(ring + 1), background, foreground);
+					}
+				}
+
+				float output[3], alpha;
+				ResolveMainPass(background, foreground, output, alpha);
+				StoreColor(result.m_BlurColor[0], x, y, output);
+				StoreUnorm8(result.m_BlurAlpha[0], x, y, alpha);
+			}
+		}
+	}
+
+	void MedianTile(FrameResult& result, const DoFConstants& constants, uint32_t tile, bool bSeparateAlpha)
+	{
+		const uint32_t tileX = GetTileX(tile), tileY = GetTileY(tile);
+
+		// With the alpha median, blue and alpha are kept whole
+		float colors[100][4], keys[100];
+		for (uint32_t threadY = 0; threadY < 5; ++threadY)
+		{
+			for (uint32_t threadX = 0; threadX < 5; ++threadX)
+			{
+				const float u = (float)(2 * (tileX * kHalfTileSize + threadX * 2)) * constants.m_RcpBufferDim[0];
+				const float v = (float)(2 * (tileY * kHalfTileSize + threadY * 2)) * constants.m_RcpBufferDim[1];
+				float texels[4][4];
+				for (uint32_t c = 0; c < 3; ++c)
+					Gather(result.m_BlurColor[0], c, u, v, texels[c]);
+				Gather(result.m_BlurAlpha[0], 0, u, v, texels[3]);
+
+				// w is above left, z above right, x below left and y below right
+				const uint32_t destination = threadX * 2 + threadY * 20;
+				const uint32_t indices[4] = { destination + 10, destination + 11, destination + 1, destination };
+				for (uint32_t i = 0; i < 4; ++i)
+				{
+					const float rgb[3] = { texels[0][i], texels[1][i], texels[2][i] };
+					float* color = colors[indices[i]];
+					color[0] = RoundToHalf(rgb[0]);
+					color[1] = RoundToHalf(rgb[1]);
+					color[2] = bSeparateAlpha ? rgb[2] : RoundToHalf(rgb[2]);
+					color[3] = bSeparateAlpha ? texels[3][i] : RoundToHalf(texels[3][i]);
+					keys[indices[i]] = LumaKey(rgb, indices[i]);
+				}
+			}
+		}
+
+		for (uint32_t threadY = 0; threadY < kHalfTileSize; ++threadY)
+		{
+			for (uint32_t threadX = 0; threadX < kHalfTileSize; ++threadX)
+			{
+				const uint32_t x = tileX * kHalfTileSize + threadX, y = tileY * kHalfTileSize + threadY;
+				if (!IsInside(result.m_BlurColor[1], x, y))
+					continue;
+
+				const uint32_t upperLeft = threadX + threadY * 10;
+				float neighbours[9], alphas[9];
+				for (uint32_t i = 0; i < 9; ++i)
+				{
+					neighbours[i] = keys[upperLeft + (i % 3) + (i / 3) * 10];
+					alphas[i] = colors[upperLeft + (i % 3) + (i / 3) * 10][3];
+				}
+
+				const float* median = colors[AsUint(Med9(neighbours)) & 0xFF];
+				StoreColor(result.m_BlurColor[1], x, y, median);
+				StoreUnorm8(result.m_BlurAlpha[1], x, y, bSeparateAlpha ? Med9(alphas) : median[3]);
+			}
+		}
+	}
+
+	// The fixups only copy or sample down, so they're the same whichever way they're walked
+	void FixupTile(FrameResult& result, const DoFConstants& constants, uint32_t tile, Queue pass)
+	{
+		for (uint32_t threadY = 0; threadY < kHalfTileSize; ++threadY)
+		{
+			for (uint32_t threadX = 0; threadX < kHalfTileSize; ++threadX)
+			{
+				const uint32_t x = GetTileX(tile) * kHalfTileSize + threadX, y = GetTileY(tile) * kHalfTileSize + threadY;
+				if (!IsInside(result.m_Prefilter, x, y))
+					continue;
+
+				if (pass == kWorkQueue)
+				{
+					float presort[3], output[3];
+					PreFilterFixupPixel(result, constants, x, y, presort, output);
+					StoreColor(result.m_Presort, x, y, presort);
+					StoreColor(result.m_Prefilter, x, y, output);
+				}
+				else if (pass == kFastQueue)
+				{
+					StoreColor(result.m_BlurColor[0], x, y, result.m_Prefilter.At(x, y));
+					StoreUnorm8(result.m_BlurAlpha[0], x, y, 1.0f);
+				}
+				else
+				{
+					StoreColor(result.m_BlurColor[1], x, y, result.m_BlurColor[0].At(x, y));
+					StoreUnorm8(result.m_BlurAlpha[1], x, y, result.m_BlurAlpha[0].At(x, y)[0]);
+				}
+			}
+		}
+	}
+
+	void CombineTile(FrameResult& result, const DoFConstants& constants, uint32_t tile)
+	{
+		const uint32_t x0 = GetTileX(tile) * kTileSize, y0 = GetTileY(tile) * kTileSize;
+		const uint32_t x1 = std::min(x0 + kTileSize, result.m_DepthOfField.m_Width), y1 = std::min(y0 + kTileSize, result.m_DepthOfField.m_Height);
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			for (uint32_t x = x0; x < x1; ++x)
+				CombinePixel(result, constants, tile, x, y);
+		}
+	}
+
+	// Sizes every DoF buffer, and clears the half resolution ones. Tiles in none of the queues are never written, and on the GPU would still
+	// hold whatever an earlier frame left in them
+	void PrepareDepthOfField(const InputFrame& input, const Settings& settings, const DoFConstants& constants, FrameResult& result)
+	{
+		const uint32_t halfWidth = DivideUp(input.m_Width, 2), halfHeight = DivideUp(input.m_Height, 2);
+		for (uint32_t i = 0; i < 2; ++i)
+			EnsureSize(result.m_TileClass[i], constants.m_TiledDimension[0], constants.m_TiledDimension[1], 3);
+
+		Plane* halfPlanes[] = { &result.m_Presort, &result.m_Prefilter, &result.m_BlurColor[0], &result.m_BlurAlpha[0], &result.m_BlurColor[1],
+			&result.m_BlurAlpha[1] };
+		const uint32_t channels[] = { 3, 3, 3, 1, 3, 1 };
+		const uint32_t planeCount = settings.m_bMedianFilter ? 6 : 4;
+		for (uint32_t i = 0; i < 6; ++i)
+		{
+			if (i < planeCount)
+			{
+				EnsureSize(*halfPlanes[i], halfWidth, halfHeight, channels[i]);
+				std::fill(halfPlanes[i]->m_Values.begin(), halfPlanes[i]->m_Values.end(), 0.0f);
+			}
+			else
+			{
+				Empty(*halfPlanes[i]);
+			}
+		}
+	}
+
+	void EmptyDepthOfField(FrameResult& result)
+	{
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			Empty(result.m_TileClass[i]);
+			Empty(result.m_BlurColor[i]);
+			Empty(result.m_BlurAlpha[i]);
+		}
+		Empty(result.m_Presort);
+		Empty(result.m_Prefilter);
+		Empty(result.m_DepthOfField);
+		result.m_WorkQueue.clear();
+		result.m_FastQueue.clear();
+		result.m_FixupQueue.clear();
+	}
+}
+
+uint32_t PostFXReference::PackVelocity(const float velocity[3])
+{
+	return PackXY(velocity[0]) | PackXY(velocity[1]) << 10 | PackZ(velocity[2]) << 20;
+}
+
+void PostFXReference::UnpackVelocity(uint32_t packed, float velocity[3])
+{
+	velocity[0] = UnpackXY(packed & 0x3FF);
+	velocity[1] = UnpackXY((packed >> 10) & 0x3FF);
+	velocity[2] = UnpackZ(packed >> 20);
+}
+
+//===============================================================================
+
+PostFXReference::Processor::Processor(uint32_t workerThreads) : m_Pool(workerThreads)
+{
+}
+
+void PostFXReference::Processor::ProcessFrame(const InputFrame& input, const Settings& settings, FrameResult& result)
+{
+	m_Input = &input;
+	m_Settings = &settings;
+	m_Result = &result;
+
+	const uint32_t width = input.m_Width, height = input.m_Height;
+	m_Constants = GetDoFConstants(width, height, input.m_FarClip, settings);
+
+	EnsureSize(result.m_LinearDepth, width, height, 1);
+	EnsureSize(result.m_Color, width, height, 3);
+	EnsureSize(result.m_Velocity, width, height, 2);
+	if (settings.m_bDepthOfField)
+		EnsureSize(result.m_DepthOfField, width, height, 3);
+	else
+		EmptyDepthOfField(result);
+	Run(kUnpackPhase, DivideUp(height, kRowsPerJob));
+
+	if (settings.m_bDepthOfField)
+	{
+		// Tiling: each pass a row of tiles at a time, with the queues put together in row order once it's done
+		const uint32_t tilesY = m_Constants.m_TiledDimension[1];
+		PrepareDepthOfField(input, settings, m_Constants, result);
+		for (std::vector<std::vector<uint32_t>>& rowQueues : m_RowQueues)
+		{
+			rowQueues.resize(tilesY);
+			for (std::vector<uint32_t>& row : rowQueues)
+				row.clear();
+		}
+
+		Run(kTileClassPhase, tilesY);
+		Run(kTileSpreadPhase, tilesY);
+		Run(kTileFixupPhase, tilesY);
+
+		std::vector<uint32_t>* queues[kQueueCount] = { &result.m_WorkQueue, &result.m_FastQueue, &result.m_FixupQueue };
+		for (uint32_t queue = 0; queue < kQueueCount; ++queue)
+		{
+			queues[queue]->clear();
+			for (const std::vector<uint32_t>& row : m_RowQueues[queue])
+				queues[queue]->insert(queues[queue]->end(), row.begin(), row.end());
+		}
+
+		// The prefilter, main and median passes each take all three queues' tiles at once, since they write to different pixels. The work
+		// and fast queues come first, so the combine can take just those
+		m_TileJobs.clear();
+		for (uint32_t tile : result.m_WorkQueue)
+			m_TileJobs.push_back({ tile, kWorkQueue, IsWorkQueueFast(settings) });
+		for (uint32_t tile : result.m_FastQueue)
+			m_TileJobs.push_back({ tile, kFastQueue, IsFastQueueFast(settings) });
+		for (uint32_t tile : result.m_FixupQueue)
+			m_TileJobs.push_back({ tile, kFixupQueue, false });
+
+		Run(kPreFilterPhase, (uint32_t)m_TileJobs.size());
+		Run(kMainPhase, (uint32_t)m_TileJobs.size());
+		if (settings.m_bMedianFilter)
+			Run(kMedianPhase, (uint32_t)m_TileJobs.size());
+		Run(kCombinePhase, (uint32_t)(result.m_WorkQueue.size() + result.m_FastQueue.size()));
+	}
+
+	if (settings.m_bMotionBlur)
+	{
+		EnsureSize(result.m_MotionPrep, DivideUp(width, 2), DivideUp(height, 2), 4);
+		EnsureSize(result.m_MotionBlur, width, height, 3);
+		Run(kMotionPrepPhase, DivideUp(result.m_MotionPrep.m_Height, kRowsPerJob));
+		Run(kMotionBlurPhase, DivideUp(height, kRowsPerJob));
+	}
+	else
+	{
+		Empty(result.m_MotionPrep);
+		Empty(result.m_MotionBlur);
+	}
+
+	m_Input = nullptr;
+	m_Settings = nullptr;
+	m_Result = nullptr;
+}
+
+void PostFXReference::Processor::Run(Phase phase, uint32_t jobCount)
+{
+	m_Phase = phase;
+	m_Pool.Run(jobCount, [this](uint32_t job) { ProcessJob(job); });
+}
+
+void PostFXReference::Processor::ProcessJob(uint32_t job)
+{
+	FrameResult& result = *m_Result;
+	const DoFConstants& constants = m_Constants;
+	const int32_t tilesX = (int32_t)constants.m_TiledDimension[0], tilesY = (int32_t)constants.m_TiledDimension[1];
+
+	switch (m_Phase)
+	{
+	case kUnpackPhase:
+	{
+		const uint32_t y0 = job * kRowsPerJob;
+		UnpackRows(*m_Input, y0, std::min(y0 + kRowsPerJob, m_Input->m_Height), result);
+		break;
+	}
+
+	case kTileClassPhase:
+	{
+		// Every tile ends up with what its first thread gathered, as DoFPass1CS's reduction never reaches gs[0]
+		for (uint32_t tileX = 0; tileX < (uint32_t)tilesX; ++tileX)
+		{
+			float closest, farthest, maxCoC;
+			GatherTileQuad(result.m_LinearDepth, tileX * kHalfTileSize, job * kHalfTileSize, constants, closest, farthest, maxCoC);
+			const float tileClass[3] = { maxCoC, farthest, farthest };
+			StoreColor(result.m_TileClass[0], tileX, job, tileClass);
+		}
+		break;
+	}
+
+	case kTileSpreadPhase:
+	case kTileFixupPhase:
+	{
+		const Plane& source = result.m_TileClass[m_Phase == kTileSpreadPhase ? 0 : 1];
+		for (int32_t tileX = 0; tileX < tilesX; ++tileX)
+		{
+			float maxCoCs[9], minDepths[9], maxDepths[9];
+			for (int32_t i = 0; i < 9; ++i)
+			{
+				const float* neighbour = LoadClamped(source, tileX + i % 3 - 1, (int32_t)job + i / 3 - 1);
+				maxCoCs[i] = neighbour[0];
+				minDepths[i] = neighbour[1];
+				maxDepths[i] = neighbour[2];
+			}
+
+			if (m_Phase == kTileFixupPhase)
+			{
+				if (NeedsFixup(maxCoCs))
+					m_RowQueues[kFixupQueue][job].push_back(MakeTile((uint32_t)tileX, job));
+				continue;
+			}
+
+			float tileClass[3];
+			const uint32_t queue = SpreadTile(maxCoCs, minDepths, maxDepths, constants, tileClass);
+			StoreColor(result.m_TileClass[1], (uint32_t)tileX, job, tileClass);
+			if (queue != kQueueCount)
+				m_RowQueues[queue][job].push_back(MakeTile((uint32_t)tileX, job));
+		}
+		(void)tilesY;
+		break;
+	}
+
+	case kPreFilterPhase:
+	{
+		const TileJob& tileJob = m_TileJobs[job];
+		if (tileJob.m_Queue == kFixupQueue)
+			FixupTile(result, constants, tileJob.m_Tile, kWorkQueue);
+		else
+			PreFilterTile(result, constants, tileJob.m_Tile, tileJob.m_bFast);
+		break;
+	}
+
+	case kMainPhase:
+	{
+		const TileJob& tileJob = m_TileJobs[job];
+		if (tileJob.m_Queue == kFixupQueue)
+			FixupTile(result, constants, tileJob.m_Tile, kFastQueue);
+		else
+			MainPassTile(result, constants, tileJob.m_Tile, tileJob.m_bFast);
+		break;
+	}
+
+	case kMedianPhase:
+	{
+		const TileJob& tileJob = m_TileJobs[job];
+		if (tileJob.m_Queue == kFixupQueue)
+			FixupTile(result, constants, tileJob.m_Tile, kFixupQueue);
+		else
+			MedianTile(result, constants, tileJob.m_Tile, m_Settings->m_bMedianAlpha);
+		break;
+	}
+
+	case kCombinePhase:
+		CombineTile(result, constants, m_TileJobs[job].m_Tile);
+		break;
+
+	case kMotionPrepPhase:
+	{
+		const uint32_t y0 = job * kRowsPerJob, y1 = std::min(y0 + kRowsPerJob, result.m_MotionPrep.m_Height);
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			for (uint32_t x = 0; x < result.m_MotionPrep.m_Width; ++x)
+				MotionPrepTexel(result, x, y);
+		}
+		break;
+	}
+
+	case kMotionBlurPhase:
+	{
+		const uint32_t y0 = job * kRowsPerJob, y1 = std::min(y0 + kRowsPerJob, result.m_MotionBlur.m_Height);
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			for (uint32_t x = 0; x < result.m_MotionBlur.m_Width; ++x)
+				MotionBlurPixel(result, x, y);
+		}
+		break;
+	}
+	}
+}
+
+//===============================================================================
+
+namespace
+{
+	// Two f32tof16s in one LDS word, and f16tof32 of either half
+	uint32_t PackHalves(float low, float high)
+	{
+		return FloatToHalf(low) | FloatToHalf(high) << 16;
+	}
+
+	float LowHalf(uint32_t word)
+	{
+		return HalfToFloat(word & 0xFFFF);
+	}
+
+	float HighHalf(uint32_t word)
+	{
+		return HalfToFloat(word >> 16);
+	}
+
+	// DoFPass1CS, a group to a tile
+	void TileClassReference(FrameResult& result, const DoFConstants& constants)
+	{
+		for (uint32_t groupY = 0; groupY < constants.m_TiledDimension[1]; ++groupY)
+		{
+			for (uint32_t groupX = 0; groupX < constants.m_TiledDimension[0]; ++groupX)
+			{
+				float closestDepthSearch[64], farthestDepthSearch[64], maximumCoC[64];
+				for (uint32_t groupIndex = 0; groupIndex < 64; ++groupIndex)
+				{
+					GatherTileQuad(result.m_LinearDepth, groupX * 8 + groupIndex % 8, groupY * 8 + groupIndex / 8, constants,
+						closestDepthSearch[groupIndex], farthestDepthSearch[groupIndex], maximumCoC[groupIndex]);
+				}
+
+				// As written, the reduction writes to [i] rather than [GI], so [0] is left as thread 0 had it
+				for (uint32_t i = 32; i > 0; i >>= 1)
+				{
+					for (uint32_t groupIndex = 0; groupIndex < i; ++groupIndex)
+					{
+						closestDepthSearch[i] = Min(closestDepthSearch[i], closestDepthSearch[groupIndex + i]);
+						farthestDepthSearch[i] = Max(farthestDepthSearch[i], farthestDepthSearch[groupIndex + i]);
+						maximumCoC[i] = Max(maximumCoC[i], maximumCoC[groupIndex + i]);
+					}
+				}
+
+				const float tileClass[3] = { maximumCoC[0], farthestDepthSearch[0], farthestDepthSearch[0] };
+				StoreColor(result.m_TileClass[0], groupX, groupY, tileClass);
+			}
+		}
+	}
+
+	// DoFTilePassCS, or DoFTilePassFixupCS with bFixup, a group to 8x8 tiles
+	void TilePassReference(FrameResult& result, const DoFConstants& constants, bool bFixup)
+	{
+		const Plane& inputClass = result.m_TileClass[bFixup ? 1 : 0];
+		const uint32_t channels = bFixup ? 1 : 3;
+
+		for (uint32_t groupY = 0; groupY < DivideUp(constants.m_TiledDimension[1], 8); ++groupY)
+		{
+			for (uint32_t groupX = 0; groupX < DivideUp(constants.m_TiledDimension[0], 8); ++groupX)
+			{
+				// Max CoC, min depth and max depth
+				float lds[3][100];
+				for (uint32_t threadY = 0; threadY < 5; ++threadY)
+				{
+					for (uint32_t threadX = 0; threadX < 5; ++threadX)
+					{
+						const float u = (float)(groupX * 8 + threadX + threadX) * constants.m_InvTiledDimension[0];
+						const float v = (float)(groupY * 8 + threadY + threadY) * constants.m_InvTiledDimension[1];
+						const uint32_t destination = threadX * 2 + threadY * 2 * 10;
+						for (uint32_t c = 0; c < channels; ++c)
+						{
+							float texels[4];
+							Gather(inputClass, c, u, v, texels);
+							lds[c][destination] = texels[3];
+							lds[c][destination + 1] = texels[2];
+							lds[c][destination + 10] = texels[0];
+							lds[c][destination + 11] = texels[1];
+						}
+					}
+				}
+
+				for (uint32_t threadY = 0; threadY < 8; ++threadY)
+				{
+					for (uint32_t threadX = 0; threadX < 8; ++threadX)
+					{
+						const uint32_t x = groupX * 8 + threadX, y = groupY * 8 + threadY;
+						if (x >= constants.m_TiledDimension[0] || y >= constants.m_TiledDimension[1])
+							continue;
+
+						const uint32_t upperLeft = threadX + threadY * 10;
+						float neighbours[3][9];
+						for (uint32_t c = 0; c < channels; ++c)
+						{
+							for (uint32_t i = 0; i < 9; ++i)
+								neighbours[c][i] = lds[c][upperLeft + i % 3 + (i / 3) * 10];
+						}
+
+						if (bFixup)
+						{
+							if (NeedsFixup(neighbours[0]))
+								result.m_FixupQueue.push_back(MakeTile(x, y));
+							continue;
+						}
+
+						float tileClass[3];
+						const uint32_t queue = SpreadTile(neighbours[0], neighbours[1], neighbours[2], constants, tileClass);
+						StoreColor(result.m_TileClass[1], x, y, tileClass);
+						if (queue == kWorkQueue)
+							result.m_WorkQueue.push_back(MakeTile(x, y));
+						else if (queue == kFastQueue)
+							result.m_FastQueue.push_back(MakeTile(x, y));
+					}
+				}
+			}
+		}
+	}
+
+	// DoFPreFilterCS, or DoFPreFilterFastCS with bFast, over a queue
+	void PreFilterReference(FrameResult& result, const DoFConstants& constants, const std::vector<uint32_t>& queue, bool bFast)
+	{
+		for (uint32_t tile : queue)
+		{
+			uint32_t rgBuffer[100], bwBuffer[100];
+			float depthBuffer[100];
+
+			const int32_t cornerX = (int32_t)(GetTileX(tile) * 16) - 1, cornerY = (int32_t)(GetTileY(tile) * 16) - 1;
+			auto loadBlurriestSample = [&](uint32_t index)
+			{
+				float color[4];
+				LoadBlurriestSample(result, constants, bFast, cornerX + (int32_t)(index % 10) * 2, cornerY + (int32_t)(index / 10) * 2, color,
+					depthBuffer[index]);
+				rgBuffer[index] = PackHalves(color[1], color[0]);
+				bwBuffer[index] = PackHalves(color[3], color[2]);
+			};
+			for (uint32_t groupIndex = 0; groupIndex < 64; ++groupIndex)
+			{
+				loadBlurriestSample(groupIndex);
+				if (groupIndex < 36)
+					loadBlurriestSample(groupIndex + 64);
+			}
+
+			auto loadSample = [&](uint32_t index, float color[4])
+			{
+				color[0] = HighHalf(rgBuffer[index]);
+				color[1] = LowHalf(rgBuffer[index]);
+				color[2] = HighHalf(bwBuffer[index]);
+				color[3] = LowHalf(bwBuffer[index]);
+			};
+
+			for (uint32_t threadY = 0; threadY < 8; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 8; ++threadX)
+				{
+					const uint32_t x = GetTileX(tile) * 8 + threadX, y = GetTileY(tile) * 8 + threadY;
+					if (!IsInside(result.m_Prefilter, x, y))
+						continue;
+
+					const uint32_t lsIdx = threadX + threadY * 10 + 11;
+					float color[4], ringColors[8][4], ringDepths[8];
+					const float* ring[8];
+					loadSample(lsIdx, color);
+					for (uint32_t i = 0; i < 8; ++i)
+					{
+						loadSample((uint32_t)((int32_t)lsIdx + kPreFilterRing[i]), ringColors[i]);
+						ring[i] = ringColors[i];
+						ringDepths[i] = depthBuffer[(int32_t)lsIdx + kPreFilterRing[i]];
+					}
+
+					float presort[3], output[3];
+					PreFilterPixel(color, depthBuffer[lsIdx], ring, ringDepths, bFast, constants, presort, output);
+					StoreColor(result.m_Presort, x, y, presort);
+					StoreColor(result.m_Prefilter, x, y, output);
+				}
+			}
+		}
+	}
+
+	// DoFPass2CS over a queue
+	void MainPassReference(FrameResult& result, const DoFConstants& constants, const std::vector<uint32_t>& queue)
+	{
+		for (uint32_t tile : queue)
+		{
+			uint32_t rgBuffer[24 * 24], bwBuffer[24 * 24], cfBuffer[24 * 24];
+
+			const uint32_t tileX = GetTileX(tile), tileY = GetTileY(tile);
+			const float* tileClass = result.m_TileClass[1].At(tileX, tileY);
+			const float tileMinDepth = tileClass[1];
+			const float fgRenormFactor = tileClass[2];
+
+			const int32_t cornerX = (int32_t)(tileX * 8) - 8, cornerY = (int32_t)(tileY * 8) - 8;
+			for (uint32_t threadY = 0; threadY < 8; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 8; ++threadX)
+				{
+					for (uint32_t offset = 0; offset < 9; ++offset)
+					{
+						const uint32_t offsetX = threadX + (offset / 3) * 8, offsetY = threadY + (offset % 3) * 8;
+						const uint32_t ldsIdx = offsetX + offsetY * 24;
+						float color[4], rings, foreground;
+						PrefetchMainPass(result, constants, cornerX + (int32_t)offsetX, cornerY + (int32_t)offsetY, tileMinDepth, fgRenormFactor, color,
+							rings, foreground);
+						rgBuffer[ldsIdx] = PackHalves(color[0], color[1]);
+						bwBuffer[ldsIdx] = PackHalves(color[2], color[3]);
+						cfBuffer[ldsIdx] = PackHalves(rings, foreground);
+					}
+				}
+			}
+
+			auto accumulateSample = [&](uint32_t ldsIdx, float sampleRadius, float background[4], float foreground[4])
+			{
+				const float sampleColor[4] = { LowHalf(rgBuffer[ldsIdx]), HighHalf(rgBuffer[ldsIdx]), LowHalf(bwBuffer[ldsIdx]), HighHalf(bwBuffer[ldsIdx]) };
+				AccumulateSample(sampleColor, LowHalf(cfBuffer[ldsIdx]), HighHalf(cfBuffer[ldsIdx]), sampleRadius, background, foreground);
+			};
+
+			for (uint32_t threadY = 0; threadY < 8; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 8; ++threadX)
+				{
+					const uint32_t x = tileX * 8 + threadX, y = tileY * 8 + threadY;
+					if (!IsInside(result.m_BlurColor[0], x, y))
+						continue;
+
+					const uint32_t ldsIdx = threadX + threadY * 24 + 25 * 8;
+					const float ringCount = (tileClass[0] - 1.0f) / 5.0f;
+
+					const float centerColor[4] = { LowHalf(rgBuffer[ldsIdx]), HighHalf(rgBuffer[ldsIdx]), LowHalf(bwBuffer[ldsIdx]), HighHalf(bwBuffer[ldsIdx]) };
+					const float fg = HighHalf(cfBuffer[ldsIdx]);
+
+					float background[4], foreground[4];
+					for (uint32_t c = 0; c < 4; ++c)
+					{
+						background[c] = centerColor[c] * (1.01f - fg);
+						foreground[c] = centerColor[c] * fg;
+					}
+
+					for (uint32_t i = 0; i < 8; ++i)
+						accumulateSample((uint32_t)((int32_t)ldsIdx + kRing1Q[i]), 1.0f, background, foreground);
+
+					if (ringCount > 1.0f)
+					{
+						for (uint32_t i = 0; i < 16; ++i)
+							accumulateSample((uint32_t)((int32_t)ldsIdx + kRing2Q[i]), 2.0f, background, foreground);
+					}
+
+					if (ringCount > 2.0f)
+					{
+						for (uint32_t i = 0; i < 24; ++i)
+							accumulateSample((uint32_t)((int32_t)ldsIdx + kRing3Q[i]), 3.0f, background, foreground);
+					}
+
+					float output[3], alpha;
+					ResolveMainPass(background, foreground, output, alpha);
+					StoreColor(result.m_BlurColor[0], x, y, output);
+					StoreUnorm8(result.m_BlurAlpha[0], x, y, alpha);
+				}
+			}
+		}
+	}
+
+	// DoFPass2FastCS over a queue
+	void MainPassFastReference(FrameResult& result, const DoFConstants& constants, const std::vector<uint32_t>& queue)
+	{
+		for (uint32_t tile : queue)
+		{
+			uint32_t rbBuffer[24 * 24];
+			float grBuffer[24 * 24];
+
+			const uint32_t tileX = GetTileX(tile), tileY = GetTileY(tile);
+			const int32_t cornerX = (int32_t)(tileX * 8) - 8, cornerY = (int32_t)(tileY * 8) - 8;
+			for (uint32_t threadY = 0; threadY < 8; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 8; ++threadX)
+				{
+					for (uint32_t offset = 0; offset < 9; ++offset)
+					{
+						const uint32_t offsetX = threadX + (offset / 3) * 8, offsetY = threadY + (offset % 3) * 8;
+						const uint32_t ldsIdx = offsetX + offsetY * 24;
+						float color[3];
+						PrefetchMainPassFast(result, constants, cornerX + (int32_t)offsetX, cornerY + (int32_t)offsetY, color);
+						rbBuffer[ldsIdx] = PackHalves(color[0], color[2]);
+						grBuffer[ldsIdx] = color[1];
+					}
+				}
+			}
+
+			auto loadColor = [&](uint32_t ldsIdx, float color[3])
+			{
+				color[0] = LowHalf(rbBuffer[ldsIdx]);
+				color[1] = grBuffer[ldsIdx];
+				color[2] = HighHalf(rbBuffer[ldsIdx]);
+			};
+
+			auto accumulateRing = [&](uint32_t ldsIdx, const int32_t* offsets, uint32_t count, float weight, float foreground[4])
+			{
+				float ringSamples[3] = {};
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					float color[3];
+					loadColor((uint32_t)((int32_t)ldsIdx + offsets[i]), color);
+					for (uint32_t c = 0; c < 3; ++c)
+						ringSamples[c] += color[c];
+				}
+				for (uint32_t c = 0; c < 3; ++c)
+					foreground[c] += weight * ringSamples[c];
+				foreground[3] += weight * (float)count;
+			};
+
+			for (uint32_t threadY = 0; threadY < 8; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 8; ++threadX)
+				{
+					const uint32_t x = tileX * 8 + threadX, y = tileY * 8 + threadY;
+					if (!IsInside(result.m_BlurColor[0], x, y))
+						continue;
+
+					const uint32_t ldsIdx = threadX + threadY * 24 + 25 * 8;
+					float centerColor[3];
+					loadColor(ldsIdx, centerColor);
+					const float ringCount = (result.m_TileClass[1].At(tileX, tileY)[0] - 1.0f) / 5.0f;
+
+					float foreground[4] = { centerColor[0], centerColor[1], centerColor[2], 1.0f };
+					accumulateRing(ldsIdx, kRing1Q, 8, Saturate(ringCount), foreground);
+					if (ringCount > 1.0f)
+						accumulateRing(ldsIdx, kRing2Q, 16, Saturate(ringCount - 1.0f), foreground);
+					if (ringCount > 2.0f)
+						accumulateRing(ldsIdx, kRing3Q, 24, Saturate(ringCount - 2.0f), foreground);
+
+					const float output[3] = { foreground[0] / foreground[3], foreground[1] / foreground[3], foreground[2] / foreground[3] };
+					StoreColor(result.m_BlurColor[0], x, y, output);
+					StoreUnorm8(result.m_BlurAlpha[0], x, y, 1.0f);
+				}
+			}
+		}
+	}
+
+	// DoFMedianFilterCS, or DoFMedianFilterSepAlphaCS with bSeparateAlpha, over a queue
+	void MedianReference(FrameResult& result, const DoFConstants& constants, const std::vector<uint32_t>& queue, bool bSeparateAlpha)
+	{
+		for (uint32_t tile : queue)
+		{
+			uint32_t rgBuffer[100], baBuffer[100];
+			float lumaBuffer[100], blueBuffer[100], alphaBuffer[100];
+
+			auto storeColor = [&](uint32_t index, float r, float g, float b, float a)
+			{
+				rgBuffer[index] = PackHalves(g, r);
+				if (bSeparateAlpha)
+				{
+					alphaBuffer[index] = a;
+					blueBuffer[index] = b;
+				}
+				else
+				{
+					baBuffer[index] = PackHalves(a, b);
+				}
+
+				const float rgb[3] = { r, g, b };
+				lumaBuffer[index] = LumaKey(rgb, index);
+			};
+
+			const uint32_t tileX = GetTileX(tile), tileY = GetTileY(tile);
+			for (uint32_t threadY = 0; threadY < 5; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 5; ++threadX)
+				{
+					const uint32_t x = tileX * 8 + threadX, y = tileY * 8 + threadY;
+					const float u = (float)(2 * (x + threadX)) * constants.m_RcpBufferDim[0];
+					const float v = (float)(2 * (y + threadY)) * constants.m_RcpBufferDim[1];
+					float r[4], g[4], b[4], a[4];
+					Gather(result.m_BlurColor[0], 0, u, v, r);
+					Gather(result.m_BlurColor[0], 1, u, v, g);
+					Gather(result.m_BlurColor[0], 2, u, v, b);
+					Gather(result.m_BlurAlpha[0], 0, u, v, a);
+
+					const uint32_t destination = threadX * 2 + threadY * 2 * 10;
+					storeColor(destination, r[3], g[3], b[3], a[3]);
+					storeColor(destination + 1, r[2], g[2], b[2], a[2]);
+					storeColor(destination + 10, r[0], g[0], b[0], a[0]);
+					storeColor(destination + 11, r[1], g[1], b[1], a[1]);
+				}
+			}
+
+			for (uint32_t threadY = 0; threadY < 8; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 8; ++threadX)
+				{
+					const uint32_t x = tileX * 8 + threadX, y = tileY * 8 + threadY;
+					if (!IsInside(result.m_BlurColor[1], x, y))
+						continue;
+
+					const uint32_t upperLeft = threadX + threadY * 10;
+					float lumas[9];
+					for (uint32_t i = 0; i < 9; ++i)
+						lumas[i] = lumaBuffer[upperLeft + i % 3 + (i / 3) * 10];
+
+					const uint32_t cIdx = AsUint(Med9(lumas)) & 0xFF;
+					const float blue = bSeparateAlpha ? blueBuffer[cIdx] : HighHalf(baBuffer[cIdx]);
+					const float output[3] = { HighHalf(rgBuffer[cIdx]), LowHalf(rgBuffer[cIdx]), blue };
+					StoreColor(result.m_BlurColor[1], x, y, output);
+
+					if (bSeparateAlpha)
+					{
+						float alphas[9];
+						for (uint32_t i = 0; i < 9; ++i)
+							alphas[i] = alphaBuffer[upperLeft + i % 3 + (i / 3) * 10];
+						StoreUnorm8(result.m_BlurAlpha[1], x, y, Med9(alphas));
+					}
+					else
+					{
+						StoreUnorm8(result.m_BlurAlpha[1], x, y, LowHalf(baBuffer[cIdx]));
+					}
+				}
+			}
+		}
+	}
+}
+
+void PostFXReference::ProcessFrameReference(const InputFrame& input, const Settings& settings, FrameResult& result)
+{
+	const uint32_t width = input.m_Width, height = input.m_Height;
+	const DoFConstants constants = GetDoFConstants(width, height, input.m_FarClip, settings);
+
+	EnsureSize(result.m_LinearDepth, width, height, 1);
+	EnsureSize(result.m_Color, width, height, 3);
+	EnsureSize(result.m_Velocity, width, height, 2);
+	if (settings.m_bDepthOfField)
+		EnsureSize(result.m_DepthOfField, width, height, 3);
+	else
+		EmptyDepthOfField(result);
+	UnpackRows(input, 0, height, result);
+
+	if (settings.m_bDepthOfField)
+	{
+		PrepareDepthOfField(input, settings, constants, result);
+		result.m_WorkQueue.clear();
+		result.m_FastQueue.clear();
+		result.m_FixupQueue.clear();
+
+		TileClassReference(result, constants);
+		TilePassReference(result, constants, false);
+		TilePassReference(result, constants, true);
+
+		// The GPU appends them in whatever order its groups finish. Tiles are x | y << 16, so sorting them puts them in row order
+		std::sort(result.m_WorkQueue.begin(), result.m_WorkQueue.end());
+		std::sort(result.m_FastQueue.begin(), result.m_FastQueue.end());
+		std::sort(result.m_FixupQueue.begin(), result.m_FixupQueue.end());
+
+		PreFilterReference(result, constants, result.m_WorkQueue, IsWorkQueueFast(settings));
+		PreFilterReference(result, constants, result.m_FastQueue, IsFastQueueFast(settings));
+		for (uint32_t tile : result.m_FixupQueue)
+			FixupTile(result, constants, tile, kWorkQueue);
+
+		if (IsWorkQueueFast(settings))
+			MainPassFastReference(result, constants, result.m_WorkQueue);
+		else
+			MainPassReference(result, constants, result.m_WorkQueue);
+		if (IsFastQueueFast(settings))
+			MainPassFastReference(result, constants, result.m_FastQueue);
+		else
+			MainPassReference(result, constants, result.m_FastQueue);
+		for (uint32_t tile : result.m_FixupQueue)
+			FixupTile(result, constants, tile, kFastQueue);
+
+		if (settings.m_bMedianFilter)
+		{
+			MedianReference(result, constants, result.m_WorkQueue, settings.m_bMedianAlpha);
+			MedianReference(result, constants, result.m_FastQueue, settings.m_bMedianAlpha);
+			for (uint32_t tile : result.m_FixupQueue)
+				FixupTile(result, constants, tile, kFixupQueue);
+		}
+
+		for (uint32_t tile : result.m_WorkQueue)
+			CombineTile(result, constants, tile);
+		for (uint32_t tile : result.m_FastQueue)
+			CombineTile(result, constants, tile);
+	}
+
+	if (settings.m_bMotionBlur)
+	{
+		EnsureSize(result.m_MotionPrep, DivideUp(width, 2), DivideUp(height, 2), 4);
+		EnsureSize(result.m_MotionBlur, width, height, 3);
+
+		// MotionBlurPrePassCS and MotionBlurFinalPassCS, a group at a time. Neither shares anything between its threads
+		for (uint32_t groupY = 0; groupY < DivideUp(result.m_MotionPrep.m_Height, 8); ++groupY)
+		{
+			for (uint32_t groupX = 0; groupX < DivideUp(result.m_MotionPrep.m_Width, 8); ++groupX)
+			{
+				for (uint32_t thread = 0; thread < 64; ++thread)
+				{
+					const uint32_t x = groupX * 8 + thread % 8, y = groupY * 8 + thread / 8;
+					if (IsInside(result.m_MotionPrep, x, y))
+						MotionPrepTexel(result, x, y);
+				}
+			}
+		}
+		for (uint32_t groupY = 0; groupY < DivideUp(height, 8); ++groupY)
+		{
+			for (uint32_t groupX = 0; groupX < DivideUp(width, 8); ++groupX)
+			{
+				for (uint32_t thread = 0; thread < 64; ++thread)
+				{
+					const uint32_t x = groupX * 8 + thread % 8, y = groupY * 8 + thread / 8;
+					if (IsInside(result.m_MotionBlur, x, y))
+						MotionBlurPixel(result, x, y);
+				}
+			}
+		}
+	}
+	else
+	{
+		Empty(result.m_MotionPrep);
+		Empty(result.m_MotionBlur);
+	}
+}
+
+//===============================================================================
+
+bool PostFXReference::LoadInputFrames(const std::wstring& fileName, InputSequence& sequence)
+{
+	sequence = InputSequence();
+
+	FILE* file = OpenFile(fileName, false);
+	if (file == nullptr)
+		return false;
+
+	InputFileHeader header = {};
+	bool bValid = std::fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.m_Magic, kInputFileMagic, sizeof(kInputFileMagic)) == 0 &&
+		header.m_Version == kInputFileVersion && header.m_Width > 0 && header.m_Height > 0 && header.m_Width <= kMaxFrameDimension &&
+		header.m_Height <= kMaxFrameDimension;
+
+	// Frames are read one at a time, so a count that's more than the file holds runs out rather than allocating it all up front
+	const size_t pixelCount = (size_t)header.m_Width * header.m_Height;
+	for (uint32_t frame = 0; bValid && frame < header.m_FrameCount; ++frame)
+	{
+		InputFrameHeader frameHeader = {};
+		bValid = std::fread(&frameHeader, sizeof(frameHeader), 1, file) == 1 && std::isfinite(frameHeader.m_FarClip) && frameHeader.m_FarClip > 0.0f;
+
+		InputFrame input;
+		if (bValid)
+		{
+			input.m_LinearDepth.resize(pixelCount);
+			input.m_Color.resize(pixelCount);
+			input.m_Velocity.resize(pixelCount);
+			bValid = std::fread(input.m_LinearDepth.data(), sizeof(uint16_t), pixelCount, file) == pixelCount &&
+				std::fread(input.m_Color.data(), sizeof(uint32_t), pixelCount, file) == pixelCount &&
+				std::fread(input.m_Velocity.data(), sizeof(uint32_t), pixelCount, file) == pixelCount;
+		}
+		if (bValid)
+		{
+			input.m_Width = header.m_Width;
+			input.m_Height = header.m_Height;
+			input.m_FarClip = frameHeader.m_FarClip;
+			sequence.m_Frames.push_back(std::move(input));
+		}
+	}
+	std::fclose(file);
+
+	if (!bValid)
+	{
+		sequence = InputSequence();
+		return false;
+	}
+
+	sequence.m_Width = header.m_Width;
+	sequence.m_Height = header.m_Height;
+	return true;
+}
+
+bool PostFXReference::InputWriter::Open(const std::wstring& fileName, uint32_t width, uint32_t height)
+{
+	Close();
+	if (width == 0 || height == 0 || width > kMaxFrameDimension || height > kMaxFrameDimension)
+		return false;
+
+	m_File = OpenFile(fileName, true);
+	if (m_File == nullptr)
+		return false;
+
+	m_Width = width;
+	m_Height = height;
+	m_FrameCount = 0;
+
+	InputFileHeader header = {};
+	std::memcpy(header.m_Magic, kInputFileMagic, sizeof(kInputFileMagic));
+	header.m_Version = kInputFileVersion;
+	header.m_Width = width;
+	header.m_Height = height;
+	m_bFailed = std::fwrite(&header, sizeof(header), 1, m_File) != 1;
+	return !m_bFailed;
+}
+
+bool PostFXReference::InputWriter::Write(const uint16_t* linearDepth, const uint32_t* color, const uint32_t* velocity, float farClip)
+{
+	if (m_File == nullptr || m_bFailed)
+		return false;
+
+	const InputFrameHeader frameHeader = { farClip };
+	const size_t pixelCount = (size_t)m_Width * m_Height;
+	m_bFailed = std::fwrite(&frameHeader, sizeof(frameHeader), 1, m_File) != 1 ||
+		std::fwrite(linearDepth, sizeof(uint16_t), pixelCount, m_File) != pixelCount ||
+		std::fwrite(color, sizeof(uint32_t), pixelCount, m_File) != pixelCount ||
+		std::fwrite(velocity, sizeof(uint32_t), pixelCount, m_File) != pixelCount;
+	if (!m_bFailed)
+		++m_FrameCount;
+	return !m_bFailed;
+}
+
+bool PostFXReference::InputWriter::Close(void)
+{
+	if (m_File == nullptr)
+		return false;
+
+	// The count goes in last, so a capture cut short by a failed write still loads as the frames that made it
+	bool bSuccess = std::fseek(m_File, offsetof(InputFileHeader, m_FrameCount), SEEK_SET) == 0 &&
+		std::fwrite(&m_FrameCount, sizeof(m_FrameCount), 1, m_File) == 1;
+	bSuccess = std::fclose(m_File) == 0 && bSuccess && !m_bFailed;
+	m_File = nullptr;
+	return bSuccess;
+}
+
+//===============================================================================
+
+namespace
+{
+	// A courtyard of posts down both sides, closed off by a wall with lit windows in it, and a camera strafing and turning between them
+	// as it walks towards the wall. The wall comes into focus at the engine's default focal depth partway along, and the posts are blurred
+	// in front of it, so all three queues get tiles. Turning and strafing move things tens of pixels a frame, which is what motion blur needs
+	class SyntheticCourtyard
+	{
+	public:
+		static constexpr float kFarClip = 10000.0f;
+		static constexpr float kTanHalfFovV = 0.41421356f;	// A 45 degree vertical FOV, as the engine's cameras default to
+		static constexpr float kPathSeconds = 8.0f;
+
+		explicit SyntheticCourtyard(uint64_t seed)
+		{
+			// A stream per post, so they don't depend on the order they're made in
+			for (uint32_t i = 0; i < 24; ++i)
+			{
+				CounterRNG::Stream random(seed, i);
+				const float side = i % 2 == 0 ? -1.0f : 1.0f;
+				Post post;
+				post.m_Radius = random.NextFloat(20.0f, 70.0f);
+				post.m_Center[0] = side * random.NextFloat(300.0f, kHalfWidth - post.m_Radius);
+				post.m_Center[1] = random.NextFloat(300.0f, kBackWall - 150.0f);
+				for (uint32_t c = 0; c < 3; ++c)
+					post.m_Albedo[c] = random.NextFloat(0.2f, 0.9f);
+				m_Posts.push_back(post);
+			}
+		}
+
+		// seconds is how far along the path the camera is, from 0 to kPathSeconds
+		void Render(float seconds, uint32_t width, uint32_t height, InputFrame& frame) const
+		{
+			frame.m_Width = width;
+			frame.m_Height = height;
+			frame.m_FarClip = kFarClip;
+			frame.m_LinearDepth.resize((size_t)width * height);
+			frame.m_Color.resize((size_t)width * height);
+			frame.m_Velocity.resize((size_t)width * height);
+
+			const float tanHalfFovH = kTanHalfFovV * (float)width / (float)height;
+			const Camera camera(seconds);
+			const Camera previous(seconds - 1.0f / 60.0f);
+
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					// A view direction with a z of 1, so the distance along it is view depth
+					const float view[3] =
+					{
+						(2.0f * ((float)x + 0.5f) / (float)width - 1.0f) * tanHalfFovH, (1.0f - 2.0f * ((float)y + 0.5f) / (float)height) * kTanHalfFovV, 1.0f
+					};
+					float direction[3];
+					camera.ToWorld(view, direction);
+
+					float rgb[3];
+					const float viewDepth = Trace(camera.m_Position, direction, rgb);
+					const bool bSky = viewDepth >= kFarClip;
+					const float linearDepth = bSky ? 1.0f : viewDepth / kFarClip;
+
+					// Where the same point was the frame before. The sky's only turned, not moved
+					float point[3], previousView[3];
+					for (uint32_t c = 0; c < 3; ++c)
+						point[c] = bSky ? direction[c] : camera.m_Position[c] + direction[c] * viewDepth;
+					previous.ToView(point, bSky, previousView);
+
+					float velocity[3] = {};
+					if (previousView[2] > 0.0f)
+					{
+						const float previousX = (previousView[0] / previousView[2] / tanHalfFovH + 1.0f) * 0.5f * (float)width;
+						const float previousY = (1.0f - previousView[1] / previousView[2] / kTanHalfFovV) * 0.5f * (float)height;
+						velocity[0] = previousX - ((float)x + 0.5f);
+						velocity[1] = previousY - ((float)y + 0.5f);
+						velocity[2] = bSky ? 0.0f : previousView[2] / kFarClip - linearDepth;
+					}
+
+					const size_t index = (size_t)y * width + x;
+					frame.m_LinearDepth[index] = (uint16_t)(std::min(linearDepth, 1.0f) * 65535.0f + 0.5f);
+					frame.m_Color[index] = ToneMapReference::PackR11G11B10(rgb);
+					frame.m_Velocity[index] = PackVelocity(velocity);
+				}
+			}
+		}
+
+	private:
+		static constexpr float kHalfWidth = 600.0f;
+		static constexpr float kWallHeight = 800.0f;
+		static constexpr float kBackWall = 1120.0f;
+		static constexpr float kPostHeight = 400.0f;
+
+		struct Post
+		{
+			float m_Center[2];		// x and z
+			float m_Radius;
+			float m_Albedo[3];
+		};
+
+		// Walking forward at 30 units a second, strafing up to 220 either side and turning up to 0.6 radians either way
+		struct Camera
+		{
+			explicit Camera(float seconds)
+			{
+				m_Position[0] = 220.0f * std::sin(0.8f * seconds);
+				m_Position[1] = 170.0f;
+				m_Position[2] = 30.0f * seconds;
+				const float yaw = 0.6f * std::sin(2.1f * seconds);
+				m_Cos = std::cos(yaw);
+				m_Sin = std::sin(yaw);
+			}
+
+			void ToWorld(const float view[3], float world[3]) const
+			{
+				world[0] = view[0] * m_Cos + view[2] * m_Sin;
+				world[1] = view[1];
+				world[2] = view[2] * m_Cos - view[0] * m_Sin;
+			}
+
+			void ToView(const float world[3], bool bDirection, float view[3]) const
+			{
+				float relative[3];
+				for (uint32_t c = 0; c < 3; ++c)
+					relative[c] = bDirection ? world[c] : world[c] - m_Position[c];
+				view[0] = relative[0] * m_Cos - relative[2] * m_Sin;
+				view[1] = relative[1];
+				view[2] = relative[0] * m_Sin + relative[2] * m_Cos;
+			}
+
+			float m_Position[3];
+			float m_Cos;
+			float m_Sin;
+		};
+
+		static void Shade(const float albedo[3], const float normal[3], float rgb[3])
+		{
+			// The sun, normalized
+			const float light[3] = { 0.3995009f, 0.7990019f, -0.4494386f };
+			const float lit = 0.25f + 1.5f * std::max(normal[0] * light[0] + normal[1] * light[1] + normal[2] * light[2], 0.0f);
+			for (uint32_t c = 0; c < 3; ++c)
+				rgb[c] = albedo[c] * lit;
+		}
+
+		// The view depth of what's hit and its colour, or the far clip for the sky
+		float Trace(const float origin[3], const float direction[3], float rgb[3]) const
+		{
+			float nearest = kFarClip;
+			const float sky[3] = { 0.75f, 1.05f, 1.8f };
+			std::memcpy(rgb, sky, sizeof(sky));
+
+			auto hitPoint = [&](float t, float point[3])
+			{
+				for (uint32_t c = 0; c < 3; ++c)
+					point[c] = origin[c] + direction[c] * t;
+			};
+
+			// The floor, checkered every 100 units
+			float point[3];
+			if (direction[1] < 0.0f)
+			{
+				const float t = -origin[1] / direction[1];
+				if (t < nearest)
+				{
+					hitPoint(t, point);
+					const bool bLight = (FloorToInt(point[0] / 100.0f) + FloorToInt(point[2] / 100.0f)) % 2 == 0;
+					const float albedo[3] = { bLight ? 0.6f : 0.25f, bLight ? 0.55f : 0.25f, bLight ? 0.5f : 0.3f };
+					const float normal[3] = { 0.0f, 1.0f, 0.0f };
+					nearest = t;
+					Shade(albedo, normal, rgb);
+				}
+			}
+
+			// The side walls, striped every 80 units
+			if (direction[0] != 0.0f)
+			{
+				const float side = direction[0] > 0.0f ? 1.0f : -1.0f;
+				const float t = (side * kHalfWidth - origin[0]) / direction[0];
+				hitPoint(t, point);
+				if (t < nearest && point[1] <= kWallHeight && point[2] <= kBackWall)
+				{
+					const bool bStripe = FloorToInt(point[2] / 80.0f) % 2 == 0;
+					const float albedo[3] = { bStripe ? 0.7f : 0.5f, bStripe ? 0.3f : 0.5f, bStripe ? 0.2f : 0.55f };
+					const float normal[3] = { -side, 0.0f, 0.0f };
+					nearest = t;
+					Shade(albedo, normal, rgb);
+				}
+			}
+
+			// The back wall, with a window lit from inside in every 150 unit square
+			if (direction[2] > 0.0f)
+			{
+				const float t = (kBackWall - origin[2]) / direction[2];
+				hitPoint(t, point);
+				if (t < nearest && point[1] <= kWallHeight && std::fabs(point[0]) <= kHalfWidth)
+				{
+					const float cellX = point[0] + kHalfWidth - 150.0f * (float)FloorToInt((point[0] + kHalfWidth) / 150.0f);
+					const float cellY = point[1] - 150.0f * (float)FloorToInt(point[1] / 150.0f);
+					nearest = t;
+					if (cellX > 40.0f && cellX < 110.0f && cellY > 40.0f && cellY < 110.0f)
+					{
+						const float window[3] = { 6.0f, 5.0f, 3.5f };
+						std::memcpy(rgb, window, sizeof(window));
+					}
+					else
+					{
+						const float albedo[3] = { 0.55f, 0.5f, 0.45f };
+						const float normal[3] = { 0.0f, 0.0f, -1.0f };
+						Shade(albedo, normal, rgb);
+					}
+				}
+			}
+
+			// The posts only matter in x and z, up to their height
+			for (const Post& post : m_Posts)
+			{
+				const float ox = origin[0] - post.m_Center[0], oz = origin[2] - post.m_Center[1];
+				const float a = direction[0] * direction[0] + direction[2] * direction[2];
+				const float b = ox * direction[0] + oz * direction[2];
+				const float c = ox * ox + oz * oz - post.m_Radius * post.m_Radius;
+				const float discriminant = b * b - a * c;
+				if (discriminant <= 0.0f)
+					continue;
+
+				const float t = (-b - std::sqrt(discriminant)) / a;
+				hitPoint(t, point);
+				if (t > 0.0f && t < nearest && point[1] <= kPostHeight)
+				{
+					const float normal[3] = { (point[0] - post.m_Center[0]) / post.m_Radius, 0.0f, (point[2] - post.m_Center[1]) / post.m_Radius };
+					nearest = t;
+					Shade(post.m_Albedo, normal, rgb);
+				}
+			}
+			return nearest;
+		}
+
+		std::vector<Post> m_Posts;
+	};
+
+	// Nearest, from the centre of each destination pixel, for frames there's only one resolution of. Velocity is in pixels, so it's scaled
+	// with them
+	void PointSample(const InputFrame& source, uint32_t width, uint32_t height, InputFrame& destination)
+	{
+		destination = InputFrame();
+		destination.m_Width = width;
+		destination.m_Height = height;
+		destination.m_FarClip = source.m_FarClip;
+		destination.m_LinearDepth.resize((size_t)width * height);
+		destination.m_Color.resize((size_t)width * height);
+		destination.m_Velocity.resize((size_t)width * height);
+
+		const float scaleX = (float)width / (float)source.m_Width, scaleY = (float)height / (float)source.m_Height;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const uint32_t sourceY = std::min((uint32_t)(((float)y + 0.5f) * (float)source.m_Height / (float)height), source.m_Height - 1);
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const uint32_t sourceX = std::min((uint32_t)(((float)x + 0.5f) * (float)source.m_Width / (float)width), source.m_Width - 1);
+				const size_t sourceIndex = (size_t)sourceY * source.m_Width + sourceX, index = (size_t)y * width + x;
+				destination.m_LinearDepth[index] = source.m_LinearDepth[sourceIndex];
+				destination.m_Color[index] = source.m_Color[sourceIndex];
+
+				float velocity[3];
+				UnpackVelocity(source.m_Velocity[sourceIndex], velocity);
+				velocity[0] *= scaleX;
+				velocity[1] *= scaleY;
+				destination.m_Velocity[index] = PackVelocity(velocity);
+			}
+		}
+	}
+
+	// Reinhard, so the windows don't swamp everything else
+	float ToneMap(float value)
+	{
+		return value / (1.0f + value);
+	}
+
+	// Bilinear back up to native, as an upscaler's input would be at its simplest, and measured against what native gave once both are tone
+	// mapped. A pixel's error is the mean over its channels
+	void MeasureError(const Plane& native, const Plane& low, double& meanError, double& badPixels)
+	{
+		double sum = 0.0;
+		uint64_t bad = 0;
+		for (uint32_t y = 0; y < native.m_Height; ++y)
+		{
+			const float sourceY = std::min(std::max(((float)y + 0.5f) * (float)low.m_Height / (float)native.m_Height - 0.5f, 0.0f), (float)(low.m_Height - 1));
+			const uint32_t y0 = (uint32_t)sourceY, y1 = std::min(y0 + 1, low.m_Height - 1);
+			const float fy = sourceY - (float)y0;
+			for (uint32_t x = 0; x < native.m_Width; ++x)
+			{
+				const float sourceX = std::min(std::max(((float)x + 0.5f) * (float)low.m_Width / (float)native.m_Width - 0.5f, 0.0f), (float)(low.m_Width - 1));
+				const uint32_t x0 = (uint32_t)sourceX, x1 = std::min(x0 + 1, low.m_Width - 1);
+				const float fx = sourceX - (float)x0;
+
+				double error = 0.0;
+				for (uint32_t c = 0; c < 3; ++c)
+				{
+					const float top = Lerp(low.At(x0, y0)[c], low.At(x1, y0)[c], fx);
+					const float bottom = Lerp(low.At(x0, y1)[c], low.At(x1, y1)[c], fx);
+					error += std::fabs((double)ToneMap(Lerp(top, bottom, fy)) - (double)ToneMap(native.At(x, y)[c]));
+				}
+				error /= 3.0;
+				sum += error;
+				bad += error > 0.05 ? 1 : 0;
+			}
+		}
+
+		const double pixelCount = (double)std::max((size_t)native.m_Width * native.m_Height, (size_t)1);
+		meanError += sum / pixelCount;
+		badPixels += (double)bad / pixelCount;
+	}
+
+	bool Matches(const Plane& a, const Plane& b)
+	{
+		// Planes a frame didn't use are empty, with nothing to compare
+		return a.m_Width == b.m_Width && a.m_Height == b.m_Height && a.m_Channels == b.m_Channels && a.m_Values.size() == b.m_Values.size() &&
+			(a.m_Values.empty() || std::memcmp(a.m_Values.data(), b.m_Values.data(), a.m_Values.size() * sizeof(float)) == 0);
+	}
+
+	bool Matches(const FrameResult& a, const FrameResult& b)
+	{
+		bool bMatches = Matches(a.m_LinearDepth, b.m_LinearDepth) && Matches(a.m_Color, b.m_Color) && Matches(a.m_Velocity, b.m_Velocity) &&
+			a.m_WorkQueue == b.m_WorkQueue && a.m_FastQueue == b.m_FastQueue && a.m_FixupQueue == b.m_FixupQueue &&
+			Matches(a.m_Presort, b.m_Presort) && Matches(a.m_Prefilter, b.m_Prefilter) && Matches(a.m_DepthOfField, b.m_DepthOfField) &&
+			Matches(a.m_MotionPrep, b.m_MotionPrep) && Matches(a.m_MotionBlur, b.m_MotionBlur);
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			bMatches = bMatches && Matches(a.m_TileClass[i], b.m_TileClass[i]) && Matches(a.m_BlurColor[i], b.m_BlurColor[i]) &&
+				Matches(a.m_BlurAlpha[i], b.m_BlurAlpha[i]);
+		}
+		return bMatches;
+	}
+}
+
+PostFXReference::BenchmarkResult PostFXReference::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	Processor processor;
+	result.m_Workers = processor.GetWorkerCount();
+
+	InputSequence capture;
+	result.m_bFromCapture = !desc.m_CaptureFile.empty() && LoadInputFrames(desc.m_CaptureFile, capture) && !capture.m_Frames.empty();
+
+	const uint32_t width = result.m_bFromCapture ? capture.m_Width : desc.m_Width;
+	const uint32_t height = result.m_bFromCapture ? capture.m_Height : desc.m_Height;
+	const uint32_t frames = result.m_bFromCapture ? std::min(desc.m_Frames, (uint32_t)capture.m_Frames.size()) : desc.m_Frames;
+
+	const SyntheticCourtyard courtyard(desc.m_Seed);
+
+	InputFrame native, low;
+	FrameResult processed, reference, lowProcessed;
+	double processorSeconds = 0.0, referenceSeconds = 0.0;
+
+	for (uint32_t frame = 0; frame < frames && result.m_bValid; ++frame)
+	{
+		const float seconds = SyntheticCourtyard::kPathSeconds * (float)frame / (float)std::max(frames - 1, 1u);
+		const InputFrame* input = &native;
+		if (result.m_bFromCapture)
+			input = &capture.m_Frames[frame];
+		else
+			courtyard.Render(seconds, width, height, native);
+
+		auto start = std::chrono::steady_clock::now();
+		processor.ProcessFrame(*input, desc.m_Settings, processed);
+		processorSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		ProcessFrameReference(*input, desc.m_Settings, reference);
+		referenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		result.m_bValid = Matches(processed, reference);
+
+		// Each lower resolution is drawn at that resolution, as a frame rendered for an upscaler would be. A capture only has the one, so
+		// it's point sampled down instead
+		for (uint32_t scale = 0; scale < kResolutionScales && result.m_bValid; ++scale)
+		{
+			const uint32_t lowWidth = std::max((uint32_t)((float)width * kResolutionScale[scale] + 0.5f), 16u);
+			const uint32_t lowHeight = std::max((uint32_t)((float)height * kResolutionScale[scale] + 0.5f), 16u);
+			if (result.m_bFromCapture)
+				PointSample(*input, lowWidth, lowHeight, low);
+			else
+				courtyard.Render(seconds, lowWidth, lowHeight, low);
+
+			processor.ProcessFrame(low, desc.m_Settings, lowProcessed);
+			ProcessFrameReference(low, desc.m_Settings, reference);
+			result.m_bValid = Matches(lowProcessed, reference);
+
+			MeasureError(processed.m_Color, lowProcessed.m_Color, result.m_MeanError[kMeasuredInput][scale], result.m_BadPixels[kMeasuredInput][scale]);
+			if (desc.m_Settings.m_bDepthOfField)
+			{
+				MeasureError(processed.m_DepthOfField, lowProcessed.m_DepthOfField, result.m_MeanError[kMeasuredDepthOfField][scale],
+					result.m_BadPixels[kMeasuredDepthOfField][scale]);
+			}
+			if (desc.m_Settings.m_bMotionBlur)
+			{
+				MeasureError(processed.m_MotionBlur, lowProcessed.m_MotionBlur, result.m_MeanError[kMeasuredMotionBlur][scale],
+					result.m_BadPixels[kMeasuredMotionBlur][scale]);
+			}
+		}
+		if (!result.m_bValid)
+			break;
+
+		result.m_WorkTiles += (double)processed.m_WorkQueue.size();
+		result.m_FastTiles += (double)processed.m_FastQueue.size();
+		result.m_FixupTiles += (double)processed.m_FixupQueue.size();
+		++result.m_FramesRun;
+	}
+
+	const double runs = (double)std::max(result.m_FramesRun, 1u);
+	result.m_ProcessorMs = processorSeconds * 1000.0 / runs;
+	result.m_ReferenceMs = referenceSeconds * 1000.0 / runs;
+	result.m_WorkTiles /= runs;
+	result.m_FastTiles /= runs;
+	result.m_FixupTiles /= runs;
+	for (uint32_t measured = 0; measured < kMeasuredCount; ++measured)
+	{
+		for (uint32_t scale = 0; scale < kResolutionScales; ++scale)
+		{
+			result.m_MeanError[measured][scale] /= runs;
+			result.m_BadPixels[measured][scale] /= runs;
+		}
+	}
+	return result;
+}
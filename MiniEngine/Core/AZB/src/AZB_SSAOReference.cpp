@@ -0,0 +1,1576 @@
+//===============================================================================
+// desc: A CPU implementation of SSAO::Render - AoPrepareDepthBuffers, AoRender and AoBlurUpsample - doing the same math as the shaders, in the
+//       same order, through the same buffer formats, so AO can be measured at each internal resolution against native from captured depth.
+//       Every gather in these shaders lands exactly on a texel corner, so each is done as the four texel fetches it comes down to. What keeps
+//       it from matching a GPU to the bit is that the shaders' divides are reciprocals there, and their multiply-adds and dot products may be
+//       fused. An AO value right on the edge of an 8 bit step can land one step over. Only SAMPLE_CHECKER, which the engine builds with, is done.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_SSAOReference.h"
+#include "AZB_CounterRNG.h"
+#include "AZB_HalfFloat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AZB_SSAO_SSE2 1
+#include <emmintrin.h>
+#else
+#define AZB_SSAO_SSE2 0
+#endif
+
+const float SSAOReference::kResolutionScale[kResolutionScales] = { 0.5f, 0.58f, 0.667f, 0.333f };
+
+namespace
+{
+	using namespace SSAOReference;
+	using HalfFloat::RoundToHalf;
+
+	constexpr uint32_t kSimdWidth = 4;
+
+	// Prepare jobs are bands of full resolution rows, as tall as a 4th level texel so every band starts a row of each level
+	constexpr uint32_t kPrepareRowsPerJob = 16;
+
+	// Blur and upsample jobs are runs of rows
+	constexpr uint32_t kBlurRowsPerJob = 16;
+
+	// AoRenderCS samples up to 4 texels out, and twice that when it samples wide
+	constexpr uint32_t kRenderReach = 4;
+
+	// The upsample reads the blurred AO a texel outside the low resolution buffer, and the blur reaches 2 further, so the blur's planes carry
+	// a border that wide
+	constexpr int32_t kBlurRadius = 2;
+	constexpr uint32_t kBlurPadding = 4;
+
+	// SAMPLE_CHECKER's samples, in the order AoRenderCS adds them up: the offset, then where its weight and inverse thickness are in SsaoCB
+	struct AOSample
+	{
+		int32_t m_X;
+		int32_t m_Y;
+		uint32_t m_Weight;
+		uint32_t m_InvThickness;
+	};
+
+	const AOSample kSamples[] =
+	{
+		{ 2, 0, 13, 1 }, { 4, 0, 15, 3 }, { 1, 1, 16, 4 }, { 2, 2, 20, 8 }, { 3, 3, 23, 11 }, { 1, 3, 18, 6 }, { 2, 4, 22, 10 }
+	};
+
+	// Where BlurAndUpsample's values sit in cbData
+	enum BlurConstant { kNoiseFilterStrength = 4, kStepSize = 5, kBlurTolerance = 6, kUpsampleTolerance = 7 };
+
+	const char kDepthFileMagic[4] = { 'D', 'P', 'T', 'H' };
+	const uint32_t kDepthFileVersion = 1;
+
+	struct DepthFileHeader
+	{
+		char m_Magic[4];
+		uint32_t m_Version;
+		uint32_t m_Width;
+		uint32_t m_Height;
+		uint32_t m_FrameCount;
+	};
+	static_assert(sizeof(DepthFileHeader) == 20, "DepthFileHeader is written as-is, so its layout mustn't change");
+
+	// Ahead of each frame's depth
+	struct DepthFrameHeader
+	{
+		float m_ZMagic;
+		float m_FovTangent;
+	};
+	static_assert(sizeof(DepthFrameHeader) == 8, "DepthFrameHeader is written as-is, so its layout mustn't change");
+
+	// Capture resolutions go no higher than this, so a corrupt header can't ask for gigabytes
+	constexpr uint32_t kMaxFrameDimension = 16384;
+
+	FILE* OpenFile(const std::wstring& fileName, bool bWrite)
+	{
+#if defined(_WIN32)
+		FILE* file = nullptr;
+		return _wfopen_s(&file, fileName.c_str(), bWrite ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+		return std::fopen(std::string(fileName.begin(), fileName.end()).c_str(), bWrite ? "wb" : "rb");
+#endif
+	}
+
+	uint32_t DivideUp(uint32_t value, uint32_t divisor)
+	{
+		return (value + divisor - 1) / divisor;
+	}
+
+	int32_t Clamp(int32_t value, int32_t minValue, int32_t maxValue)
+	{
+		return std::min(std::max(value, minValue), maxValue);
+	}
+
+	void EnsureSize(Plane& plane, uint32_t width, uint32_t height)
+	{
+		if (plane.m_Width != width || plane.m_Height != height)
+			plane.Resize(width, height);
+	}
+
+	// Keeps the allocation, for the next frame that uses it
+	void Empty(Plane& plane)
+	{
+		plane.m_Width = 0;
+		plane.m_Height = 0;
+		plane.m_Values.clear();
+	}
+
+	// g_DepthDownsize1 to 4 are indexed 0 to 3 here, and g_DepthTiled1 to 4 are a quarter of the size again
+	uint32_t GetDownsizedSize(uint32_t size, uint32_t level)
+	{
+		return DivideUp(size, 2u << level);
+	}
+
+	uint32_t GetTiledSize(uint32_t size, uint32_t level)
+	{
+		return DivideUp(size, 8u << level);
+	}
+
+	uint32_t GetHierarchyDepth(const Settings& settings)
+	{
+		return std::min(std::max(settings.m_HierarchyDepth, 1u), kLevels);
+	}
+
+	// Very high quality renders every level whole as well as interleaved, and each step down stops one level sooner
+	bool UsesHighQuality(const Settings& settings, uint32_t level)
+	{
+		return (int32_t)settings.m_Quality >= (int32_t)kQualityVeryHigh - (int32_t)level;
+	}
+
+	//===============================================================================
+	// Shader helpers. Processor and the reference share these, so they can only differ in how they walk the buffers
+
+	// As maxps and minps, which give the second operand when either is NaN. That's also what saturate does with a NaN
+	float Max(float a, float b)
+	{
+		return a > b ? a : b;
+	}
+
+	float Min(float a, float b)
+	{
+		return a < b ? a : b;
+	}
+
+	float Saturate(float value)
+	{
+		return Min(Max(value, 0.0f), 1.0f);
+	}
+
+	// A store to R8_UNORM, then what a load gives back
+	float StoreUnorm8(float value)
+	{
+		return (float)(int32_t)(Saturate(value) * 255.0f + 0.5f) / 255.0f;
+	}
+
+	// And to R16_UNORM, which g_LinearDepth is
+	float StoreUnorm16(float value)
+	{
+		return (float)(int32_t)(Saturate(value) * 65535.0f + 0.5f) / 65535.0f;
+	}
+
+	// Depth over the far plane, from reversed hardware depth
+	float Linearize(float depth, float zMagic)
+	{
+		return 1.0f / (zMagic * depth + 1.0f);
+	}
+
+	// The texels a gather at texel corner (u, v) returns: x is below left, y below right, z above right and w above left. Outside the plane
+	// each is either clamped or the black border
+	void GatherCorner(const Plane& plane, int32_t u, int32_t v, bool bClamp, float texels[4])
+	{
+		const int32_t x[4] = { u - 1, u, u, u - 1 };
+		const int32_t y[4] = { v, v, v - 1, v - 1 };
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			if (bClamp)
+				texels[i] = plane.At((uint32_t)Clamp(x[i], 0, (int32_t)plane.m_Width - 1), (uint32_t)Clamp(y[i], 0, (int32_t)plane.m_Height - 1));
+			else if (x[i] >= 0 && y[i] >= 0 && x[i] < (int32_t)plane.m_Width && y[i] < (int32_t)plane.m_Height)
+				texels[i] = plane.At((uint32_t)x[i], (uint32_t)y[i]);
+			else
+				texels[i] = 0.0f;
+		}
+	}
+
+	// ComputeAO's SsaoCB, for a depth buffer of bufferWidth by bufferHeight with arrayCount slices
+	void GetRenderConstants(uint32_t bufferWidth, uint32_t bufferHeight, uint32_t arrayCount, float fovTangent, const Settings& settings, float constants[28])
+	{
+		float sampleThickness[12];
+		sampleThickness[ 0] = std::sqrt(1.0f - 0.2f * 0.2f);
+		sampleThickness[ 1] = std::sqrt(1.0f - 0.4f * 0.4f);
+		sampleThickness[ 2] = std::sqrt(1.0f - 0.6f * 0.6f);
+		sampleThickness[ 3] = std::sqrt(1.0f - 0.8f * 0.8f);
+		sampleThickness[ 4] = std::sqrt(1.0f - 0.2f * 0.2f - 0.2f * 0.2f);
+		sampleThickness[ 5] = std::sqrt(1.0f - 0.2f * 0.2f - 0.4f * 0.4f);
+		sampleThickness[ 6] = std::sqrt(1.0f - 0.2f * 0.2f - 0.6f * 0.6f);
+		sampleThickness[ 7] = std::sqrt(1.0f - 0.2f * 0.2f - 0.8f * 0.8f);
+		sampleThickness[ 8] = std::sqrt(1.0f - 0.4f * 0.4f - 0.4f * 0.4f);
+		sampleThickness[ 9] = std::sqrt(1.0f - 0.4f * 0.4f - 0.6f * 0.6f);
+		sampleThickness[10] = std::sqrt(1.0f - 0.4f * 0.4f - 0.8f * 0.8f);
+		sampleThickness[11] = std::sqrt(1.0f - 0.6f * 0.6f - 0.6f * 0.6f);
+
+		const float screenspaceDiameter = 10.0f;
+		float thicknessMultiplier = 2.0f * fovTangent * screenspaceDiameter / (float)bufferWidth;
+		if (arrayCount == 1)
+			thicknessMultiplier *= 2.0f;
+
+		const float inverseRangeFactor = 1.0f / thicknessMultiplier;
+		for (uint32_t i = 0; i < 12; ++i)
+			constants[i] = inverseRangeFactor / sampleThickness[i];
+
+		const float sampleCounts[12] = { 4.0f, 4.0f, 4.0f, 4.0f, 4.0f, 8.0f, 8.0f, 8.0f, 4.0f, 8.0f, 8.0f, 4.0f };
+		for (uint32_t i = 0; i < 12; ++i)
+			constants[12 + i] = sampleCounts[i] * sampleThickness[i];
+
+		// Only the checkerboard's samples are taken
+		constants[12] = 0.0f;
+		constants[14] = 0.0f;
+		constants[17] = 0.0f;
+		constants[19] = 0.0f;
+		constants[21] = 0.0f;
+
+		float totalWeight = 0.0f;
+		for (uint32_t i = 12; i < 24; ++i)
+			totalWeight += constants[i];
+		for (uint32_t i = 12; i < 24; ++i)
+			constants[i] /= totalWeight;
+
+		constants[24] = 1.0f / (float)bufferWidth;
+		constants[25] = 1.0f / (float)bufferHeight;
+		constants[26] = 1.0f / -settings.m_RejectionFalloff;
+		constants[27] = 1.0f / (1.0f + settings.m_Accentuation);
+	}
+
+	// BlurAndUpsample's cbData
+	void GetBlurConstants(const Plane& loDepth, const Plane& hiDepth, const Settings& settings, float constants[8])
+	{
+		float blurTolerance = 1.0f - std::pow(10.0f, settings.m_BlurTolerance) * 1920.0f / (float)loDepth.m_Width;
+		blurTolerance *= blurTolerance;
+		const float upsampleTolerance = std::pow(10.0f, settings.m_UpsampleTolerance);
+		const float noiseFilterWeight = 1.0f / (std::pow(10.0f, settings.m_NoiseFilterTolerance) + upsampleTolerance);
+
+		constants[0] = 1.0f / (float)loDepth.m_Width;
+		constants[1] = 1.0f / (float)loDepth.m_Height;
+		constants[2] = 1.0f / (float)hiDepth.m_Width;
+		constants[3] = 1.0f / (float)hiDepth.m_Height;
+		constants[kNoiseFilterStrength] = noiseFilterWeight;
+		constants[kStepSize] = 1920.0f / (float)loDepth.m_Width;
+		constants[kBlurTolerance] = blurTolerance;
+		constants[kUpsampleTolerance] = upsampleTolerance;
+	}
+
+	// AoRenderCS
+	float TestSamplePair(float frontDepth, float invRange, float rejectFadeoff, float depth1, float depth2)
+	{
+		// Below 0 the sample is in front of the sphere and fully occludes, above 1 it's behind it and doesn't
+		const float disocclusion1 = depth1 * invRange - frontDepth;
+		const float disocclusion2 = depth2 * invRange - frontDepth;
+
+		const float pseudoDisocclusion1 = Saturate(rejectFadeoff * disocclusion1);
+		const float pseudoDisocclusion2 = Saturate(rejectFadeoff * disocclusion2);
+
+		return Min(Max(disocclusion1, pseudoDisocclusion2), 1.0f) + Min(Max(disocclusion2, pseudoDisocclusion1), 1.0f) -
+			pseudoDisocclusion1 * pseudoDisocclusion2;
+	}
+
+	// center is the depth being occluded and stride a row of whatever it sits in, the group's LDS or a whole padded slice
+	float TestSamples(const float* center, int32_t stride, int32_t x, int32_t y, bool bWide, float invDepth, float invThickness, float rejectFadeoff)
+	{
+		if (bWide)
+		{
+			x <<= 1;
+			y <<= 1;
+		}
+
+		const float invRange = invThickness * invDepth;
+		const float frontDepth = invThickness - 0.5f;
+		auto testPair = [&](int32_t offset)
+		{
+			return TestSamplePair(frontDepth, invRange, rejectFadeoff, center[offset], center[-offset]);
+		};
+
+		if (y == 0)
+			return 0.5f * (testPair(x) + testPair(x * stride));
+		else if (x == y)
+			return 0.5f * (testPair(x * stride - x) + testPair(x * stride + x));
+		else
+			return 0.25f * (testPair(y * stride + x) + testPair(y * stride - x) + testPair(x * stride + y) + testPair(x * stride - y));
+	}
+
+	// What AoRenderCS writes to Occlusion, once through R8_UNORM
+	float ComputeOcclusion(const float* center, int32_t stride, bool bWide, const float constants[28])
+	{
+		const float invThisDepth = 1.0f / center[0];
+
+		float ao = 0.0f;
+		for (const AOSample& sample : kSamples)
+			ao += constants[sample.m_Weight] * TestSamples(center, stride, sample.m_X, sample.m_Y, bWide, invThisDepth, constants[sample.m_InvThickness], constants[26]);
+
+		return StoreUnorm8(ao * constants[27]);
+	}
+
+	// AoBlurAndUpsampleCS
+	float SmartBlur(float a, float b, float c, float d, float e, bool bLeft, bool bMiddle, bool bRight)
+	{
+		b = bLeft || bMiddle ? b : c;
+		a = bLeft ? a : b;
+		d = bRight || bMiddle ? d : c;
+		e = bRight ? e : d;
+		return ((a + e) / 2.0f + b + c + d) / 4.0f;
+	}
+
+	bool CompareDeltas(float d1, float d2, float l1, float l2, const float constants[8])
+	{
+		const float temp = d1 * d2 + constants[kStepSize];
+		return temp * temp > l1 * l2 * constants[kBlurTolerance];
+	}
+
+	// One blurred value, from the 5 AO values centred on it and the inverse depths under them, step apart
+	float BlurFive(const float* ao, const float* invDepth, ptrdiff_t step, const float constants[8])
+	{
+		const float d01 = invDepth[-step] - invDepth[-2 * step];
+		const float d12 = invDepth[0] - invDepth[-step];
+		const float d23 = invDepth[step] - invDepth[0];
+		const float d34 = invDepth[2 * step] - invDepth[step];
+
+		const float l01 = d01 * d01 + constants[kStepSize];
+		const float l12 = d12 * d12 + constants[kStepSize];
+		const float l23 = d23 * d23 + constants[kStepSize];
+		const float l34 = d34 * d34 + constants[kStepSize];
+
+		const bool c02 = CompareDeltas(d01, d12, l01, l12, constants);
+		const bool c13 = CompareDeltas(d12, d23, l12, l23, constants);
+		const bool c24 = CompareDeltas(d23, d34, l23, l34, constants);
+
+		return SmartBlur(ao[-2 * step], ao[-step], ao[0], ao[step], ao[2 * step], c02, c13, c24);
+	}
+
+	// lowDepths and lowAO are in gather order, and first is the one nearest, which the shader swizzles to the front
+	float BilateralUpsample(float hiDepth, float hiAO, const float lowDepths[4], const float lowAO[4], uint32_t first, const float constants[8])
+	{
+		const float kWeights[4] = { 9.0f, 3.0f, 1.0f, 3.0f };
+
+		float weights[4];
+		for (uint32_t i = 0; i < 4; ++i)
+			weights[i] = kWeights[i] / (std::fabs(hiDepth - lowDepths[(first + i) & 3]) + constants[kUpsampleTolerance]);
+
+		const float totalWeight = weights[0] + weights[1] + weights[2] + weights[3] + constants[kNoiseFilterStrength];
+		const float weightedSum = lowAO[first & 3] * weights[0] + lowAO[(first + 1) & 3] * weights[1] + lowAO[(first + 2) & 3] * weights[2] +
+			lowAO[(first + 3) & 3] * weights[3] + constants[kNoiseFilterStrength];
+		return hiAO * weightedSum / totalWeight;
+	}
+
+#if AZB_SSAO_SSE2
+	// The same, 4 pixels along a row at a time
+
+	__m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	__m128 Saturate(__m128 value)
+	{
+		return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	}
+
+	__m128 StoreUnorm8(__m128 value)
+	{
+		const __m128i stored = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Saturate(value), _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+		return _mm_div_ps(_mm_cvtepi32_ps(stored), _mm_set1_ps(255.0f));
+	}
+
+	__m128 TestSamplePair(__m128 frontDepth, __m128 invRange, __m128 rejectFadeoff, __m128 depth1, __m128 depth2)
+	{
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 disocclusion1 = _mm_sub_ps(_mm_mul_ps(depth1, invRange), frontDepth);
+		const __m128 disocclusion2 = _mm_sub_ps(_mm_mul_ps(depth2, invRange), frontDepth);
+
+		const __m128 pseudoDisocclusion1 = Saturate(_mm_mul_ps(rejectFadeoff, disocclusion1));
+		const __m128 pseudoDisocclusion2 = Saturate(_mm_mul_ps(rejectFadeoff, disocclusion2));
+
+		return _mm_sub_ps(_mm_add_ps(_mm_min_ps(_mm_max_ps(disocclusion1, pseudoDisocclusion2), one), _mm_min_ps(_mm_max_ps(disocclusion2, pseudoDisocclusion1), one)),
+			_mm_mul_ps(pseudoDisocclusion1, pseudoDisocclusion2));
+	}
+
+	__m128 ComputeOcclusion4(const float* center, int32_t stride, bool bWide, const float constants[28])
+	{
+		const __m128 invThisDepth = _mm_div_ps(_mm_set1_ps(1.0f), _mm_loadu_ps(center));
+		const __m128 rejectFadeoff = _mm_set1_ps(constants[26]);
+
+		__m128 ao = _mm_setzero_ps();
+		for (const AOSample& sample : kSamples)
+		{
+			const int32_t x = bWide ? sample.m_X << 1 : sample.m_X;
+			const int32_t y = bWide ? sample.m_Y << 1 : sample.m_Y;
+			const float invThickness = constants[sample.m_InvThickness];
+			const __m128 invRange = _mm_mul_ps(_mm_set1_ps(invThickness), invThisDepth);
+			const __m128 frontDepth = _mm_set1_ps(invThickness - 0.5f);
+			auto testPair = [&](int32_t offset)
+			{
+				return TestSamplePair(frontDepth, invRange, rejectFadeoff, _mm_loadu_ps(center + offset), _mm_loadu_ps(center - offset));
+			};
+
+			__m128 tested;
+			if (y == 0)
+				tested = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_add_ps(testPair(x), testPair(x * stride)));
+			else if (x == y)
+				tested = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_add_ps(testPair(x * stride - x), testPair(x * stride + x)));
+			else
+				tested = _mm_mul_ps(_mm_set1_ps(0.25f), _mm_add_ps(_mm_add_ps(_mm_add_ps(testPair(y * stride + x), testPair(y * stride - x)),
+					testPair(x * stride + y)), testPair(x * stride - y)));
+
+			ao = _mm_add_ps(ao, _mm_mul_ps(_mm_set1_ps(constants[sample.m_Weight]), tested));
+		}
+
+		return StoreUnorm8(_mm_mul_ps(ao, _mm_set1_ps(constants[27])));
+	}
+
+	__m128 CompareDeltas(__m128 d1, __m128 d2, __m128 l1, __m128 l2, __m128 stepSize, __m128 blurTolerance)
+	{
+		const __m128 temp = _mm_add_ps(_mm_mul_ps(d1, d2), stepSize);
+		return _mm_cmpgt_ps(_mm_mul_ps(temp, temp), _mm_mul_ps(_mm_mul_ps(l1, l2), blurTolerance));
+	}
+
+	__m128 BlurFive4(const float* ao, const float* invDepth, ptrdiff_t step, const float constants[8])
+	{
+		const __m128 stepSize = _mm_set1_ps(constants[kStepSize]);
+		const __m128 blurTolerance = _mm_set1_ps(constants[kBlurTolerance]);
+
+		const __m128 depth0 = _mm_loadu_ps(invDepth - 2 * step), depth1 = _mm_loadu_ps(invDepth - step), depth2 = _mm_loadu_ps(invDepth);
+		const __m128 depth3 = _mm_loadu_ps(invDepth + step), depth4 = _mm_loadu_ps(invDepth + 2 * step);
+
+		const __m128 d01 = _mm_sub_ps(depth1, depth0);
+		const __m128 d12 = _mm_sub_ps(depth2, depth1);
+		const __m128 d23 = _mm_sub_ps(depth3, depth2);
+		const __m128 d34 = _mm_sub_ps(depth4, depth3);
+
+		const __m128 l01 = _mm_add_ps(_mm_mul_ps(d01, d01), stepSize);
+		const __m128 l12 = _mm_add_ps(_mm_mul_ps(d12, d12), stepSize);
+		const __m128 l23 = _mm_add_ps(_mm_mul_ps(d23, d23), stepSize);
+		const __m128 l34 = _mm_add_ps(_mm_mul_ps(d34, d34), stepSize);
+
+		const __m128 bLeft = CompareDeltas(d01, d12, l01, l12, stepSize, blurTolerance);
+		const __m128 bMiddle = CompareDeltas(d12, d23, l12, l23, stepSize, blurTolerance);
+		const __m128 bRight = CompareDeltas(d23, d34, l23, l34, stepSize, blurTolerance);
+
+		// SmartBlur
+		const __m128 c = _mm_loadu_ps(ao);
+		const __m128 b = Select(_mm_or_ps(bLeft, bMiddle), _mm_loadu_ps(ao - step), c);
+		const __m128 a = Select(bLeft, _mm_loadu_ps(ao - 2 * step), b);
+		const __m128 d = Select(_mm_or_ps(bRight, bMiddle), _mm_loadu_ps(ao + step), c);
+		const __m128 e = Select(bRight, _mm_loadu_ps(ao + 2 * step), d);
+		const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(a, e), _mm_set1_ps(0.5f)), b), c), d);
+		return _mm_mul_ps(sum, _mm_set1_ps(0.25f));
+	}
+#endif
+
+	//===============================================================================
+	// The reference's thread groups. Each follows its shader, writes outside the buffer dropped as a UAV drops them
+
+	void Store(Plane& plane, int32_t x, int32_t y, float value)
+	{
+		if (x >= 0 && y >= 0 && x < (int32_t)plane.m_Width && y < (int32_t)plane.m_Height)
+			plane.At((uint32_t)x, (uint32_t)y) = value;
+	}
+
+	float Load(const Plane& plane, uint32_t x, uint32_t y)
+	{
+		return x < plane.m_Width && y < plane.m_Height ? plane.At(x, y) : 0.0f;
+	}
+
+	// AoRender1CS into a slice at a time of an interleaved result, or AoRender2CS over the whole of a level
+	void RenderAOReference(const Plane* source, uint32_t sliceCount, bool bInterleaved, float fovTangent, const Settings& settings, Plane& output)
+	{
+		float constants[28];
+		GetRenderConstants(source[0].m_Width, source[0].m_Height, sliceCount, fovTangent, settings, constants);
+
+		const bool bWide = !bInterleaved;
+		const uint32_t groupSize = bWide ? 16 : 8;
+		const uint32_t tileDim = groupSize * 2;
+		const int32_t reach = (int32_t)(bWide ? kRenderReach * 2 : kRenderReach);
+
+		float depthSamples[32 * 32];
+		for (uint32_t slice = 0; slice < sliceCount; ++slice)
+		{
+			const Plane& depth = source[slice];
+			for (uint32_t groupY = 0; groupY < DivideUp(depth.m_Height, groupSize); ++groupY)
+			{
+				for (uint32_t groupX = 0; groupX < DivideUp(depth.m_Width, groupSize); ++groupX)
+				{
+					for (uint32_t threadY = 0; threadY < groupSize; ++threadY)
+					{
+						for (uint32_t threadX = 0; threadX < groupSize; ++threadX)
+						{
+							// QuadCenterUV
+							const int32_t u = (int32_t)(groupX * groupSize + threadX * 2) - (reach - 1);
+							const int32_t v = (int32_t)(groupY * groupSize + threadY * 2) - (reach - 1);
+							float depths[4];
+							GatherCorner(depth, u, v, false, depths);
+
+							const uint32_t destIdx = threadX * 2 + threadY * 2 * tileDim;
+							depthSamples[destIdx] = depths[3];
+							depthSamples[destIdx + 1] = depths[2];
+							depthSamples[destIdx + tileDim] = depths[0];
+							depthSamples[destIdx + tileDim + 1] = depths[1];
+						}
+					}
+
+					for (uint32_t threadY = 0; threadY < groupSize; ++threadY)
+					{
+						for (uint32_t threadX = 0; threadX < groupSize; ++threadX)
+						{
+							const uint32_t dispatchX = groupX * groupSize + threadX, dispatchY = groupY * groupSize + threadY;
+							const int32_t outX = (int32_t)(bInterleaved ? dispatchX << 2 | (slice & 3) : dispatchX);
+							const int32_t outY = (int32_t)(bInterleaved ? dispatchY << 2 | (slice >> 2) : dispatchY);
+
+							// A write that would be dropped needn't be worked out
+							if (outX >= (int32_t)output.m_Width || outY >= (int32_t)output.m_Height)
+								continue;
+
+							const uint32_t thisIdx = threadX + threadY * tileDim + reach * tileDim + reach;
+							Store(output, outX, outY, ComputeOcclusion(&depthSamples[thisIdx], (int32_t)tileDim, bWide, constants));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void BlurHorizontally(const float* aoCache, const float* depthCache, float* blurred, uint32_t leftMostIndex, const float constants[8])
+	{
+		const float* a = aoCache + leftMostIndex;
+		const float* d = depthCache + leftMostIndex;
+
+		const float d01 = d[1] - d[0];
+		const float d12 = d[2] - d[1];
+		const float d23 = d[3] - d[2];
+		const float d34 = d[4] - d[3];
+		const float d45 = d[5] - d[4];
+		const float d56 = d[6] - d[5];
+
+		const float l01 = d01 * d01 + constants[kStepSize];
+		const float l12 = d12 * d12 + constants[kStepSize];
+		const float l23 = d23 * d23 + constants[kStepSize];
+		const float l34 = d34 * d34 + constants[kStepSize];
+		const float l45 = d45 * d45 + constants[kStepSize];
+		const float l56 = d56 * d56 + constants[kStepSize];
+
+		const bool c02 = CompareDeltas(d01, d12, l01, l12, constants);
+		const bool c13 = CompareDeltas(d12, d23, l12, l23, constants);
+		const bool c24 = CompareDeltas(d23, d34, l23, l34, constants);
+		const bool c35 = CompareDeltas(d34, d45, l34, l45, constants);
+		const bool c46 = CompareDeltas(d45, d56, l45, l56, constants);
+
+		blurred[leftMostIndex] = SmartBlur(a[0], a[1], a[2], a[3], a[4], c02, c13, c24);
+		blurred[leftMostIndex + 1] = SmartBlur(a[1], a[2], a[3], a[4], a[5], c13, c24, c35);
+		blurred[leftMostIndex + 2] = SmartBlur(a[2], a[3], a[4], a[5], a[6], c24, c35, c46);
+	}
+
+	void BlurVertically(const float* aoCache, const float* depthCache, float* blurred, uint32_t topMostIndex, const float constants[8])
+	{
+		const float* a = aoCache + topMostIndex;
+		const float* d = depthCache + topMostIndex + 2;
+
+		const float d01 = d[16] - d[0];
+		const float d12 = d[32] - d[16];
+		const float d23 = d[48] - d[32];
+		const float d34 = d[64] - d[48];
+		const float d45 = d[80] - d[64];
+
+		const float l01 = d01 * d01 + constants[kStepSize];
+		const float l12 = d12 * d12 + constants[kStepSize];
+		const float l23 = d23 * d23 + constants[kStepSize];
+		const float l34 = d34 * d34 + constants[kStepSize];
+		const float l45 = d45 * d45 + constants[kStepSize];
+
+		const bool c02 = CompareDeltas(d01, d12, l01, l12, constants);
+		const bool c13 = CompareDeltas(d12, d23, l12, l23, constants);
+		const bool c24 = CompareDeltas(d23, d34, l23, l34, constants);
+		const bool c35 = CompareDeltas(d34, d45, l34, l45, constants);
+
+		blurred[topMostIndex] = SmartBlur(a[0], a[16], a[32], a[48], a[64], c02, c13, c24);
+		blurred[topMostIndex + 16] = SmartBlur(a[16], a[32], a[48], a[64], a[80], c13, c24, c35);
+	}
+
+	// AoBlurUpsampleCS and its PreMin and BlendOut variants, picked by which of highQualityAO and hiAO there are
+	void BlurAndUpsampleReference(const Plane& hiDepth, const Plane& loDepth, const Plane& interleavedAO, const Plane* highQualityAO, const Plane* hiAO,
+		const Settings& settings, Plane& output)
+	{
+		float constants[8];
+		GetBlurConstants(loDepth, hiDepth, settings, constants);
+		output.Resize(hiDepth.m_Width, hiDepth.m_Height);
+
+		float depthCache[256];
+		float aoCache1[256];
+		float aoCache2[256];
+
+		// Dispatched over the high resolution size plus 2, 16 wide, by groups of 8x8 that each write 2x2
+		for (uint32_t groupY = 0; groupY < DivideUp(hiDepth.m_Height + 2, 16); ++groupY)
+		{
+			for (uint32_t groupX = 0; groupX < DivideUp(hiDepth.m_Width + 2, 16); ++groupX)
+			{
+				// PrefetchData
+				for (uint32_t threadY = 0; threadY < 8; ++threadY)
+				{
+					for (uint32_t threadX = 0; threadX < 8; ++threadX)
+					{
+						const uint32_t index = threadX << 1 | threadY << 5;
+						const int32_t u = (int32_t)(groupX * 8 + threadX * 2) - 2;
+						const int32_t v = (int32_t)(groupY * 8 + threadY * 2) - 2;
+
+						float ao1[4];
+						GatherCorner(interleavedAO, u, v, true, ao1);
+						if (highQualityAO != nullptr)
+						{
+							float ao2[4];
+							GatherCorner(*highQualityAO, u, v, true, ao2);
+							for (uint32_t i = 0; i < 4; ++i)
+								ao1[i] = Min(ao1[i], ao2[i]);
+						}
+						aoCache1[index] = ao1[3];
+						aoCache1[index + 1] = ao1[2];
+						aoCache1[index + 16] = ao1[0];
+						aoCache1[index + 17] = ao1[1];
+
+						float depths[4];
+						GatherCorner(loDepth, u, v, true, depths);
+						depthCache[index] = 1.0f / depths[3];
+						depthCache[index + 1] = 1.0f / depths[2];
+						depthCache[index + 16] = 1.0f / depths[0];
+						depthCache[index + 17] = 1.0f / depths[1];
+					}
+				}
+
+				// 13x13 -> 9x13
+				for (uint32_t groupIndex = 0; groupIndex < 39; ++groupIndex)
+					BlurHorizontally(aoCache1, depthCache, aoCache2, (groupIndex / 3) * 16 + (groupIndex % 3) * 3, constants);
+
+				// 9x13 -> 9x9
+				for (uint32_t groupIndex = 0; groupIndex < 45; ++groupIndex)
+					BlurVertically(aoCache2, depthCache, aoCache1, (groupIndex / 9) * 32 + groupIndex % 9, constants);
+
+				for (uint32_t threadY = 0; threadY < 8; ++threadY)
+				{
+					for (uint32_t threadX = 0; threadX < 8; ++threadX)
+					{
+						const uint32_t idx0 = threadX + threadY * 16;
+						const float loSSAOs[4] = { aoCache1[idx0 + 16], aoCache1[idx0 + 17], aoCache1[idx0 + 1], aoCache1[idx0] };
+
+						const int32_t dispatchX = (int32_t)(groupX * 8 + threadX), dispatchY = (int32_t)(groupY * 8 + threadY);
+						float hiSSAOs[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+						if (hiAO != nullptr)
+							GatherCorner(*hiAO, dispatchX * 2, dispatchY * 2, true, hiSSAOs);
+						float loDepths[4], hiDepths[4];
+						GatherCorner(loDepth, dispatchX, dispatchY, true, loDepths);
+						GatherCorner(hiDepth, dispatchX * 2, dispatchY * 2, true, hiDepths);
+
+						const int32_t outX = dispatchX * 2, outY = dispatchY * 2;
+						Store(output, outX - 1, outY, StoreUnorm8(BilateralUpsample(hiDepths[0], hiSSAOs[0], loDepths, loSSAOs, 0, constants)));
+						Store(output, outX, outY, StoreUnorm8(BilateralUpsample(hiDepths[1], hiSSAOs[1], loDepths, loSSAOs, 1, constants)));
+						Store(output, outX, outY - 1, StoreUnorm8(BilateralUpsample(hiDepths[2], hiSSAOs[2], loDepths, loSSAOs, 2, constants)));
+						Store(output, outX - 1, outY - 1, StoreUnorm8(BilateralUpsample(hiDepths[3], hiSSAOs[3], loDepths, loSSAOs, 3, constants)));
+					}
+				}
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+void SSAOReference::Processor::PaddedPlane::Resize(uint32_t width, uint32_t height, uint32_t padding)
+{
+	// Only the border has to start out black, and nothing ever writes to it
+	if (m_Width == width && m_Height == height && m_Padding == padding)
+		return;
+
+	m_Width = width;
+	m_Height = height;
+	m_Padding = padding;
+	m_Stride = width + padding * 2;
+	m_Values.assign((size_t)m_Stride * (height + padding * 2), 0.0f);
+}
+
+SSAOReference::Processor::Processor(uint32_t workerThreads) : m_Pool(workerThreads)
+{
+}
+
+void SSAOReference::Processor::ProcessFrame(const DepthFrame& depth, const Settings& settings, FrameResult& result)
+{
+	m_Depth = &depth;
+	m_Settings = &settings;
+	m_Result = &result;
+
+	const uint32_t width = depth.m_Width, height = depth.m_Height;
+	const uint32_t hierarchyDepth = GetHierarchyDepth(settings);
+
+	// Phase 1: AoPrepareDepthBuffers1CS always, and AoPrepareDepthBuffers2CS for the 3rd and 4th levels
+	m_PreparedLevels = hierarchyDepth > 2 ? kLevels : 2;
+	EnsureSize(result.m_LinearDepth, width, height);
+	for (uint32_t level = 0; level < kLevels; ++level)
+	{
+		if (level < m_PreparedLevels)
+			EnsureSize(result.m_Downsized[level], GetDownsizedSize(width, level), GetDownsizedSize(height, level));
+		else
+			Empty(result.m_Downsized[level]);
+
+		for (uint32_t slice = 0; slice < kSlices; ++slice)
+		{
+			if (level < m_PreparedLevels)
+				EnsureSize(result.m_Tiled[level][slice], GetTiledSize(width, level), GetTiledSize(height, level));
+			else
+				Empty(result.m_Tiled[level][slice]);
+		}
+	}
+
+	Run(kPreparePhase, DivideUp(height, kPrepareRowsPerJob));
+	Run(kTilePhase, m_PreparedLevels * kSlices);
+
+	// Phase 2: the deepest level first, as Render dispatches them
+	for (int32_t level = kLevels - 1; level >= 0; --level)
+	{
+		Plane& merged = result.m_Merged[level];
+		Plane& highQuality = result.m_HighQuality[level];
+		if ((uint32_t)level >= hierarchyDepth)
+		{
+			Empty(merged);
+			Empty(highQuality);
+			continue;
+		}
+
+		const Plane& downsized = result.m_Downsized[level];
+		EnsureSize(merged, downsized.m_Width, downsized.m_Height);
+		RenderAO(result.m_Tiled[level], kSlices, true, merged);
+
+		if (UsesHighQuality(settings, level))
+		{
+			EnsureSize(highQuality, downsized.m_Width, downsized.m_Height);
+			RenderAO(&downsized, 1, false, highQuality);
+		}
+		else
+		{
+			Empty(highQuality);
+		}
+	}
+
+	// Phase 4: blur each level and upsample it into the next one up, combining it with that level's AO
+	const Plane* next = &result.m_Merged[kLevels - 1];
+	for (int32_t level = kLevels - 2; level >= 0; --level)
+	{
+		if ((uint32_t)level + 1 < hierarchyDepth)
+		{
+			BlurAndUpsample(result.m_Downsized[level], result.m_Downsized[level + 1], *next,
+				UsesHighQuality(settings, level + 1) ? &result.m_HighQuality[level + 1] : nullptr, &result.m_Merged[level], result.m_Smooth[level]);
+			next = &result.m_Smooth[level];
+		}
+		else
+		{
+			Empty(result.m_Smooth[level]);
+			next = &result.m_Merged[level];
+		}
+	}
+
+	BlurAndUpsample(result.m_LinearDepth, result.m_Downsized[0], *next, UsesHighQuality(settings, 0) ? &result.m_HighQuality[0] : nullptr, nullptr,
+		result.m_AO);
+
+	m_Depth = nullptr;
+	m_Settings = nullptr;
+	m_Result = nullptr;
+}
+
+void SSAOReference::Processor::RenderAO(const Plane* source, uint32_t sliceCount, bool bInterleaved, Plane& output)
+{
+	GetRenderConstants(source[0].m_Width, source[0].m_Height, sliceCount, m_Depth->m_FovTangent, *m_Settings, m_RenderConstants);
+
+	// Each slice goes into its own plane with a black border as wide as the samples reach, so they can be read without checking bounds
+	const uint32_t padding = bInterleaved ? kRenderReach : kRenderReach * 2;
+	for (uint32_t slice = 0; slice < sliceCount; ++slice)
+	{
+		const Plane& depth = source[slice];
+		PaddedPlane& input = m_RenderInput[slice];
+		input.Resize(depth.m_Width, depth.m_Height, padding);
+		for (uint32_t y = 0; y < depth.m_Height; ++y)
+			std::memcpy(input.Row((int32_t)y), &depth.m_Values[(size_t)y * depth.m_Width], depth.m_Width * sizeof(float));
+	}
+
+	m_RenderSource = source;
+	m_RenderSlices = sliceCount;
+	m_bRenderInterleaved = bInterleaved;
+	m_RenderOutput = &output;
+	Run(kRenderPhase, sliceCount * source[0].m_Height);
+}
+
+void SSAOReference::Processor::BlurAndUpsample(const Plane& hiDepth, const Plane& loDepth, const Plane& interleavedAO, const Plane* highQualityAO,
+	const Plane* hiAO, Plane& output)
+{
+	GetBlurConstants(loDepth, hiDepth, *m_Settings, m_BlurConstants);
+
+	m_BlurHiDepth = &hiDepth;
+	m_BlurLoDepth = &loDepth;
+	m_BlurAO[0] = &interleavedAO;
+	m_BlurAO[1] = highQualityAO;
+	m_BlurHiAO = hiAO;
+	m_BlurOutput = &output;
+
+	// The upsample reads the blurred AO from a texel before the low resolution buffer to a texel after, as a group's LDS holds it. The blurs
+	// are done over everything that reaches
+	EnsureSize(output, hiDepth.m_Width, hiDepth.m_Height);
+	m_BlurInput.Resize(loDepth.m_Width, loDepth.m_Height, kBlurPadding);
+	m_BlurDepth.Resize(loDepth.m_Width, loDepth.m_Height, kBlurPadding);
+	m_BlurHorizontal.Resize(loDepth.m_Width, loDepth.m_Height, kBlurPadding);
+	m_BlurVertical.Resize(loDepth.m_Width, loDepth.m_Height, kBlurPadding);
+
+	Run(kBlurLoadPhase, DivideUp(loDepth.m_Height + kBlurPadding * 2, kBlurRowsPerJob));
+	Run(kBlurHorizontalPhase, DivideUp(loDepth.m_Height + 2 + kBlurRadius * 2, kBlurRowsPerJob));
+	Run(kBlurVerticalPhase, DivideUp(loDepth.m_Height + 2, kBlurRowsPerJob));
+	Run(kUpsamplePhase, DivideUp(hiDepth.m_Height, kBlurRowsPerJob));
+}
+
+void SSAOReference::Processor::Run(Phase phase, uint32_t jobCount)
+{
+	m_Phase = phase;
+	m_Pool.Run(jobCount, [this](uint32_t job) { ProcessJob(job); });
+}
+
+void SSAOReference::Processor::ProcessJob(uint32_t job)
+{
+	FrameResult& result = *m_Result;
+
+	switch (m_Phase)
+	{
+	case kPreparePhase:
+	{
+		// Every level's texels are the depth at their top left full resolution pixel, and it's the same float however it's arrived at
+		const DepthFrame& depth = *m_Depth;
+		const uint32_t y0 = job * kPrepareRowsPerJob, y1 = std::min(y0 + kPrepareRowsPerJob, depth.m_Height);
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			const float* row = &depth.m_Depth[(size_t)y * depth.m_Width];
+			for (uint32_t x = 0; x < depth.m_Width; ++x)
+			{
+				const float dist = Linearize(row[x], depth.m_ZMagic);
+				result.m_LinearDepth.At(x, y) = StoreUnorm16(dist);
+
+				for (uint32_t level = 0; level < m_PreparedLevels; ++level)
+				{
+					const uint32_t mask = (2u << level) - 1;
+					if ((x & mask) != 0 || (y & mask) != 0)
+						break;
+					result.m_Downsized[level].At(x >> (level + 1), y >> (level + 1)) = dist;
+				}
+			}
+		}
+		break;
+	}
+
+	case kTilePhase:
+	{
+		// Slices go past the end of their level. The first two levels are linearised there from depth read out of bounds, which is 0, and the
+		// last two are copied from the second level out of bounds, which is 0 itself
+		const uint32_t level = job / kSlices, slice = job % kSlices;
+		const Plane& downsized = result.m_Downsized[level];
+		Plane& tiled = result.m_Tiled[level][slice];
+		const float outside = level < 2 ? Linearize(0.0f, m_Depth->m_ZMagic) : 0.0f;
+		for (uint32_t y = 0; y < tiled.m_Height; ++y)
+		{
+			const uint32_t sourceY = y * 4 + (slice >> 2);
+			for (uint32_t x = 0; x < tiled.m_Width; ++x)
+			{
+				const uint32_t sourceX = x * 4 + (slice & 3);
+				const bool bInside = sourceX < downsized.m_Width && sourceY < downsized.m_Height;
+				tiled.At(x, y) = RoundToHalf(bInside ? downsized.At(sourceX, sourceY) : outside);
+			}
+		}
+		break;
+	}
+
+	case kRenderPhase:
+	{
+		const uint32_t sliceHeight = m_RenderSource[0].m_Height;
+		const uint32_t slice = job / sliceHeight, y = job % sliceHeight;
+		const PaddedPlane& input = m_RenderInput[slice];
+		Plane& output = *m_RenderOutput;
+
+		// Interleaved, this row of the slice is every 4th texel of a row of the output. Only as many as land inside it are worked out
+		uint32_t outY = y, outX0 = 0, outStep = 1, count = input.m_Width;
+		if (m_bRenderInterleaved)
+		{
+			outY = y * 4 + (slice >> 2);
+			outX0 = slice & 3;
+			outStep = 4;
+			count = output.m_Width > outX0 ? std::min(DivideUp(output.m_Width - outX0, 4), input.m_Width) : 0;
+		}
+		if (outY >= output.m_Height)
+			break;
+
+		const bool bWide = !m_bRenderInterleaved;
+		const float* center = input.Row((int32_t)y);
+		float* out = &output.At(outX0, outY);
+
+		uint32_t x = 0;
+#if AZB_SSAO_SSE2
+		for (; x + kSimdWidth <= count; x += kSimdWidth)
+		{
+			float ao[kSimdWidth];
+			_mm_storeu_ps(ao, ComputeOcclusion4(center + x, (int32_t)input.m_Stride, bWide, m_RenderConstants));
+			for (uint32_t i = 0; i < kSimdWidth; ++i)
+				out[(x + i) * outStep] = ao[i];
+		}
+#endif
+		for (; x < count; ++x)
+			out[x * outStep] = ComputeOcclusion(center + x, (int32_t)input.m_Stride, bWide, m_RenderConstants);
+		break;
+	}
+
+	case kBlurLoadPhase:
+	{
+		// Clamped past the edges, as the blur's sampler is
+		const Plane& loDepth = *m_BlurLoDepth;
+		const int32_t padding = (int32_t)kBlurPadding;
+		const int32_t row0 = (int32_t)(job * kBlurRowsPerJob) - padding;
+		const int32_t row1 = std::min(row0 + (int32_t)kBlurRowsPerJob, (int32_t)loDepth.m_Height + padding);
+		for (int32_t y = row0; y < row1; ++y)
+		{
+			const uint32_t sourceY = (uint32_t)Clamp(y, 0, (int32_t)loDepth.m_Height - 1);
+			float* ao = m_BlurInput.Row(y);
+			float* invDepth = m_BlurDepth.Row(y);
+			for (int32_t x = -padding; x < (int32_t)loDepth.m_Width + padding; ++x)
+			{
+				const uint32_t sourceX = (uint32_t)Clamp(x, 0, (int32_t)loDepth.m_Width - 1);
+				ao[x] = m_BlurAO[0]->At(sourceX, sourceY);
+				if (m_BlurAO[1] != nullptr)
+					ao[x] = Min(ao[x], m_BlurAO[1]->At(sourceX, sourceY));
+				invDepth[x] = 1.0f / loDepth.At(sourceX, sourceY);
+			}
+		}
+		break;
+	}
+
+	case kBlurHorizontalPhase:
+	case kBlurVerticalPhase:
+	{
+		// Horizontally over every row the vertical blur reads, then vertically over the texel either side of the buffer the upsample reads
+		const bool bHorizontal = m_Phase == kBlurHorizontalPhase;
+		const int32_t reach = bHorizontal ? 1 + kBlurRadius : 1;
+		const int32_t width = (int32_t)m_BlurInput.m_Width, height = (int32_t)m_BlurInput.m_Height;
+		const int32_t row0 = (int32_t)(job * kBlurRowsPerJob) - reach;
+		const int32_t row1 = std::min(row0 + (int32_t)kBlurRowsPerJob, height + reach);
+		const PaddedPlane& input = bHorizontal ? m_BlurInput : m_BlurHorizontal;
+		PaddedPlane& output = bHorizontal ? m_BlurHorizontal : m_BlurVertical;
+		const ptrdiff_t step = bHorizontal ? 1 : (ptrdiff_t)input.m_Stride;
+
+		for (int32_t y = row0; y < row1; ++y)
+		{
+			const float* ao = input.Row(y);
+			const float* invDepth = m_BlurDepth.Row(y);
+			float* blurred = output.Row(y);
+
+			int32_t x = -1;
+#if AZB_SSAO_SSE2
+			for (; x + (int32_t)kSimdWidth <= width + 1; x += kSimdWidth)
+				_mm_storeu_ps(blurred + x, BlurFive4(ao + x, invDepth + x, step, m_BlurConstants));
+#endif
+			for (; x < width + 1; ++x)
+				blurred[x] = BlurFive(ao + x, invDepth + x, step, m_BlurConstants);
+		}
+		break;
+	}
+
+	case kUpsamplePhase:
+	{
+		// Each pixel sits between two low resolution texels each way, the nearest of them weighted most. Which of the four the shader puts
+		// first in its swizzle follows from which quarter of the texel the pixel is in
+		const Plane& hiDepth = *m_BlurHiDepth;
+		const Plane& loDepth = *m_BlurLoDepth;
+		Plane& output = *m_BlurOutput;
+		const int32_t maxX = (int32_t)loDepth.m_Width - 1, maxY = (int32_t)loDepth.m_Height - 1;
+		const uint32_t y0 = job * kBlurRowsPerJob, y1 = std::min(y0 + kBlurRowsPerJob, hiDepth.m_Height);
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			const int32_t dispatchY = ((int32_t)y + 1) >> 1;
+			const int32_t cornerY[4] = { dispatchY, dispatchY, dispatchY - 1, dispatchY - 1 };
+			for (uint32_t x = 0; x < hiDepth.m_Width; ++x)
+			{
+				const int32_t dispatchX = ((int32_t)x + 1) >> 1;
+				const int32_t cornerX[4] = { dispatchX - 1, dispatchX, dispatchX, dispatchX - 1 };
+
+				float lowDepths[4], lowAO[4];
+				for (uint32_t i = 0; i < 4; ++i)
+				{
+					lowDepths[i] = loDepth.At((uint32_t)Clamp(cornerX[i], 0, maxX), (uint32_t)Clamp(cornerY[i], 0, maxY));
+					lowAO[i] = m_BlurVertical.Row(cornerY[i])[cornerX[i]];
+				}
+
+				const uint32_t first = (x & 1) != 0 ? ((y & 1) != 0 ? 3 : 0) : ((y & 1) != 0 ? 2 : 1);
+				const float hiAO = m_BlurHiAO != nullptr ? m_BlurHiAO->At(x, y) : 1.0f;
+				output.At(x, y) = StoreUnorm8(BilateralUpsample(hiDepth.At(x, y), hiAO, lowDepths, lowAO, first, m_BlurConstants));
+			}
+		}
+		break;
+	}
+	}
+}
+
+//===============================================================================
+
+void SSAOReference::ProcessFrameReference(const DepthFrame& depth, const Settings& settings, FrameResult& result)
+{
+	const uint32_t width = depth.m_Width, height = depth.m_Height;
+	const uint32_t hierarchyDepth = GetHierarchyDepth(settings);
+	const uint32_t preparedLevels = hierarchyDepth > 2 ? kLevels : 2;
+
+	result.m_LinearDepth.Resize(width, height);
+	for (uint32_t level = 0; level < kLevels; ++level)
+	{
+		if (level < preparedLevels)
+			result.m_Downsized[level].Resize(GetDownsizedSize(width, level), GetDownsizedSize(height, level));
+		else
+			result.m_Downsized[level] = Plane();
+
+		for (uint32_t slice = 0; slice < kSlices; ++slice)
+		{
+			if (level < preparedLevels)
+				result.m_Tiled[level][slice].Resize(GetTiledSize(width, level), GetTiledSize(height, level));
+			else
+				result.m_Tiled[level][slice] = Plane();
+		}
+	}
+
+	// AoPrepareDepthBuffers1CS, over g_DepthTiled2's size times 8. Each group linearises a 16x16 block and writes every other texel of it to the
+	// first level, and every 4th to the second
+	auto linearize = [&](uint32_t x, uint32_t y)
+	{
+		const float dist = Linearize(x < width && y < height ? depth.m_Depth[(size_t)y * width + x] : 0.0f, depth.m_ZMagic);
+		Store(result.m_LinearDepth, (int32_t)x, (int32_t)y, StoreUnorm16(dist));
+		return dist;
+	};
+
+	for (uint32_t groupY = 0; groupY < GetTiledSize(height, 1); ++groupY)
+	{
+		for (uint32_t groupX = 0; groupX < GetTiledSize(width, 1); ++groupX)
+		{
+			float cacheW[256];
+			for (uint32_t threadY = 0; threadY < 8; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 8; ++threadX)
+				{
+					const uint32_t startX = groupX << 4 | threadX, startY = groupY << 4 | threadY;
+					const uint32_t destIdx = threadY << 4 | threadX;
+					cacheW[destIdx + 0] = linearize(startX, startY);
+					cacheW[destIdx + 8] = linearize(startX | 8, startY);
+					cacheW[destIdx + 128] = linearize(startX, startY | 8);
+					cacheW[destIdx + 136] = linearize(startX | 8, startY | 8);
+				}
+			}
+
+			for (uint32_t threadY = 0; threadY < 8; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 8; ++threadX)
+				{
+					const float w1 = cacheW[threadX << 1 | threadY << 5];
+
+					uint32_t stX = groupX * 8 + threadX, stY = groupY * 8 + threadY;
+					uint32_t slice = (stX & 3) | ((stY & 3) << 2);
+					Store(result.m_Downsized[0], (int32_t)stX, (int32_t)stY, w1);
+					Store(result.m_Tiled[0][slice], (int32_t)(stX >> 2), (int32_t)(stY >> 2), RoundToHalf(w1));
+
+					const uint32_t groupIndex = threadY * 8 + threadX;
+					if ((groupIndex & 011) == 0)
+					{
+						stX >>= 1;
+						stY >>= 1;
+						slice = (stX & 3) | ((stY & 3) << 2);
+						Store(result.m_Downsized[1], (int32_t)stX, (int32_t)stY, w1);
+						Store(result.m_Tiled[1][slice], (int32_t)(stX >> 2), (int32_t)(stY >> 2), RoundToHalf(w1));
+					}
+				}
+			}
+		}
+	}
+
+	// AoPrepareDepthBuffers2CS, over g_DepthTiled4's size times 8, point sampling the second level
+	if (hierarchyDepth > 2)
+	{
+		for (uint32_t groupY = 0; groupY < GetTiledSize(height, 3); ++groupY)
+		{
+			for (uint32_t groupX = 0; groupX < GetTiledSize(width, 3); ++groupX)
+			{
+				for (uint32_t threadY = 0; threadY < 8; ++threadY)
+				{
+					for (uint32_t threadX = 0; threadX < 8; ++threadX)
+					{
+						const uint32_t dispatchX = groupX * 8 + threadX, dispatchY = groupY * 8 + threadY;
+						const float m1 = Load(result.m_Downsized[1], dispatchX << 1, dispatchY << 1);
+
+						uint32_t slice = (dispatchX & 3) | ((dispatchY & 3) << 2);
+						Store(result.m_Downsized[2], (int32_t)dispatchX, (int32_t)dispatchY, m1);
+						Store(result.m_Tiled[2][slice], (int32_t)(dispatchX >> 2), (int32_t)(dispatchY >> 2), RoundToHalf(m1));
+
+						if (((threadY * 8 + threadX) & 011) == 0)
+						{
+							const uint32_t stX = dispatchX >> 1, stY = dispatchY >> 1;
+							slice = (stX & 3) | ((stY & 3) << 2);
+							Store(result.m_Downsized[3], (int32_t)stX, (int32_t)stY, m1);
+							Store(result.m_Tiled[3][slice], (int32_t)(stX >> 2), (int32_t)(stY >> 2), RoundToHalf(m1));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (int32_t level = kLevels - 1; level >= 0; --level)
+	{
+		result.m_Merged[level] = Plane();
+		result.m_HighQuality[level] = Plane();
+		if ((uint32_t)level >= hierarchyDepth)
+			continue;
+
+		const Plane& downsized = result.m_Downsized[level];
+		result.m_Merged[level].Resize(downsized.m_Width, downsized.m_Height);
+		RenderAOReference(result.m_Tiled[level], kSlices, true, depth.m_FovTangent, settings, result.m_Merged[level]);
+
+		if (UsesHighQuality(settings, level))
+		{
+			result.m_HighQuality[level].Resize(downsized.m_Width, downsized.m_Height);
+			RenderAOReference(&downsized, 1, false, depth.m_FovTangent, settings, result.m_HighQuality[level]);
+		}
+	}
+
+	const Plane* next = &result.m_Merged[kLevels - 1];
+	for (int32_t level = kLevels - 2; level >= 0; --level)
+	{
+		result.m_Smooth[level] = Plane();
+		if ((uint32_t)level + 1 < hierarchyDepth)
+		{
+			BlurAndUpsampleReference(result.m_Downsized[level], result.m_Downsized[level + 1], *next,
+				UsesHighQuality(settings, level + 1) ? &result.m_HighQuality[level + 1] : nullptr, &result.m_Merged[level], settings, result.m_Smooth[level]);
+			next = &result.m_Smooth[level];
+		}
+		else
+		{
+			next = &result.m_Merged[level];
+		}
+	}
+
+	BlurAndUpsampleReference(result.m_LinearDepth, result.m_Downsized[0], *next, UsesHighQuality(settings, 0) ? &result.m_HighQuality[0] : nullptr,
+		nullptr, settings, result.m_AO);
+}
+
+//===============================================================================
+
+bool SSAOReference::LoadDepthFrames(const std::wstring& fileName, DepthSequence& sequence)
+{
+	sequence = DepthSequence();
+
+	FILE* file = OpenFile(fileName, false);
+	if (file == nullptr)
+		return false;
+
+	DepthFileHeader header = {};
+	bool bValid = std::fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.m_Magic, kDepthFileMagic, sizeof(kDepthFileMagic)) == 0 &&
+		header.m_Version == kDepthFileVersion && header.m_Width > 0 && header.m_Height > 0 && header.m_Width <= kMaxFrameDimension &&
+		header.m_Height <= kMaxFrameDimension;
+
+	// Frames are read one at a time, so a count that's more than the file holds runs out rather than allocating it all up front
+	const size_t pixelCount = (size_t)header.m_Width * header.m_Height;
+	for (uint32_t frame = 0; bValid && frame < header.m_FrameCount; ++frame)
+	{
+		DepthFrameHeader frameHeader = {};
+		bValid = std::fread(&frameHeader, sizeof(frameHeader), 1, file) == 1 && std::isfinite(frameHeader.m_ZMagic) && frameHeader.m_ZMagic > 0.0f &&
+			std::isfinite(frameHeader.m_FovTangent) && frameHeader.m_FovTangent > 0.0f;
+
+		DepthFrame depth;
+		if (bValid)
+		{
+			depth.m_Depth.resize(pixelCount);
+			bValid = std::fread(depth.m_Depth.data(), sizeof(float), pixelCount, file) == pixelCount;
+		}
+		if (bValid)
+		{
+			depth.m_Width = header.m_Width;
+			depth.m_Height = header.m_Height;
+			depth.m_ZMagic = frameHeader.m_ZMagic;
+			depth.m_FovTangent = frameHeader.m_FovTangent;
+			sequence.m_Frames.push_back(std::move(depth));
+		}
+	}
+	std::fclose(file);
+
+	if (!bValid)
+	{
+		sequence = DepthSequence();
+		return false;
+	}
+
+	sequence.m_Width = header.m_Width;
+	sequence.m_Height = header.m_Height;
+	return true;
+}
+
+bool SSAOReference::DepthWriter::Open(const std::wstring& fileName, uint32_t width, uint32_t height)
+{
+	Close();
+	if (width == 0 || height == 0 || width > kMaxFrameDimension || height > kMaxFrameDimension)
+		return false;
+
+	m_File = OpenFile(fileName, true);
+	if (m_File == nullptr)
+		return false;
+
+	m_Width = width;
+	m_Height = height;
+	m_FrameCount = 0;
+
+	DepthFileHeader header = {};
+	std::memcpy(header.m_Magic, kDepthFileMagic, sizeof(kDepthFileMagic));
+	header.m_Version = kDepthFileVersion;
+	header.m_Width = width;
+	header.m_Height = height;
+	m_bFailed = std::fwrite(&header, sizeof(header), 1, m_File) != 1;
+	return !m_bFailed;
+}
+
+bool SSAOReference::DepthWriter::Write(const float* depth, float zMagic, float fovTangent)
+{
+	if (m_File == nullptr || m_bFailed)
+		return false;
+
+	const DepthFrameHeader frameHeader = { zMagic, fovTangent };
+	const size_t pixelCount = (size_t)m_Width * m_Height;
+	m_bFailed = std::fwrite(&frameHeader, sizeof(frameHeader), 1, m_File) != 1 || std::fwrite(depth, sizeof(float), pixelCount, m_File) != pixelCount;
+	if (!m_bFailed)
+		++m_FrameCount;
+	return !m_bFailed;
+}
+
+bool SSAOReference::DepthWriter::Close(void)
+{
+	if (m_File == nullptr)
+		return false;
+
+	// The count goes in last, so a capture cut short by a failed write still loads as the frames that made it
+	bool bSuccess = std::fseek(m_File, offsetof(DepthFileHeader, m_FrameCount), SEEK_SET) == 0 &&
+		std::fwrite(&m_FrameCount, sizeof(m_FrameCount), 1, m_File) == 1;
+	bSuccess = std::fclose(m_File) == 0 && bSuccess && !m_bFailed;
+	m_File = nullptr;
+	return bSuccess;
+}
+
+//===============================================================================
+
+namespace
+{
+	// A long room with boxes, pillars and balls along both sides, and a clear path down the middle for the camera. Made of what SSAO darkens
+	// most - creases where things meet the floor and walls, and gaps between them a few pixels across at the lower resolutions
+	class SyntheticRoom
+	{
+	public:
+		static constexpr float kNearClip = 0.25f;
+		static constexpr float kFarClip = 500.0f;
+		static constexpr float kTanHalfFovV = 0.41421356f;	// A 45 degree vertical FOV, as the engine's cameras default to
+
+		explicit SyntheticRoom(uint64_t seed)
+		{
+			// A stream per object, so they don't depend on the order they're made in
+			for (uint32_t i = 0; i < 28; ++i)
+			{
+				CounterRNG::Stream random(seed, i);
+				const float side = i % 2 == 0 ? -1.0f : 1.0f;
+				const float halfWidth = random.NextFloat(0.2f, 1.0f);
+				const float halfDepth = random.NextFloat(0.2f, 1.0f);
+				const float x = side * random.NextFloat(1.4f + halfWidth, kRoomHalfWidth);
+				const float z = random.NextFloat(2.0f, kRoomLength - 1.0f);
+				const float height = random.NextFloat(0.3f, 2.5f);
+				const float box[6] = { x - halfWidth, 0.0f, z - halfDepth, x + halfWidth, height, z + halfDepth };
+				m_Boxes.emplace_back();
+				std::memcpy(m_Boxes.back().m_Bounds, box, sizeof(box));
+			}
+			for (uint32_t i = 0; i < 10; ++i)
+			{
+				CounterRNG::Stream random(seed, 100 + i);
+				const float side = i % 2 == 0 ? -1.0f : 1.0f;
+				Round pillar;
+				pillar.m_Radius = random.NextFloat(0.15f, 0.45f);
+				pillar.m_Center[0] = side * random.NextFloat(1.4f + pillar.m_Radius, kRoomHalfWidth - pillar.m_Radius);
+				pillar.m_Center[1] = 0.0f;
+				pillar.m_Center[2] = random.NextFloat(2.0f, kRoomLength - 1.0f);
+				m_Pillars.push_back(pillar);
+			}
+			for (uint32_t i = 0; i < 12; ++i)
+			{
+				CounterRNG::Stream random(seed, 200 + i);
+				const float side = i % 2 == 0 ? -1.0f : 1.0f;
+				Round ball;
+				ball.m_Radius = random.NextFloat(0.2f, 0.7f);
+				ball.m_Center[0] = side * random.NextFloat(1.2f + ball.m_Radius, kRoomHalfWidth - ball.m_Radius);
+				ball.m_Center[1] = ball.m_Radius;
+				ball.m_Center[2] = random.NextFloat(2.0f, kRoomLength - 1.0f);
+				m_Balls.push_back(ball);
+			}
+		}
+
+		// The camera walks down the room at head height, looking from side to side. t goes from 0 to 1 over the run
+		void Render(float t, uint32_t width, uint32_t height, DepthFrame& depth) const
+		{
+			depth.m_Width = width;
+			depth.m_Height = height;
+			depth.m_Depth.resize((size_t)width * height);
+			depth.m_ZMagic = (kFarClip - kNearClip) / kNearClip;
+
+			const float tanHalfFovH = kTanHalfFovV * (float)width / (float)height;
+			depth.m_FovTangent = tanHalfFovH;
+
+			const float origin[3] = { 0.0f, 1.6f, 1.0f + 12.0f * t };
+			const float yaw = 0.5f * std::sin(6.2831853f * t);
+			const float pitch = -0.15f;
+			const float cosYaw = std::cos(yaw), sinYaw = std::sin(yaw), cosPitch = std::cos(pitch), sinPitch = std::sin(pitch);
+
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					// A view direction with a z of 1, so the distance along it is view depth
+					const float viewX = (2.0f * ((float)x + 0.5f) / (float)width - 1.0f) * tanHalfFovH;
+					const float viewY = (1.0f - 2.0f * ((float)y + 0.5f) / (float)height) * kTanHalfFovV;
+					const float pitchedY = viewY * cosPitch + sinPitch;
+					const float pitchedZ = cosPitch - viewY * sinPitch;
+					const float direction[3] = { viewX * cosYaw + pitchedZ * sinYaw, pitchedY, pitchedZ * cosYaw - viewX * sinYaw };
+
+					const float viewDepth = Trace(origin, direction);
+					depth.m_Depth[(size_t)y * width + x] = viewDepth < kFarClip ? (kFarClip / viewDepth - 1.0f) / depth.m_ZMagic : 0.0f;
+				}
+			}
+		}
+
+	private:
+		static constexpr float kRoomHalfWidth = 6.0f;
+		static constexpr float kRoomHeight = 4.0f;
+		static constexpr float kRoomLength = 30.0f;
+
+		struct Box
+		{
+			float m_Bounds[6];		// Min then max
+		};
+
+		struct Round
+		{
+			float m_Center[3];
+			float m_Radius;
+		};
+
+		float Trace(const float origin[3], const float direction[3]) const
+		{
+			// From inside the room, the nearest of its walls along each axis
+			const float roomMin[3] = { -kRoomHalfWidth, 0.0f, -2.0f };
+			const float roomMax[3] = { kRoomHalfWidth, kRoomHeight, kRoomLength };
+			float nearest = kFarClip;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				if (direction[axis] != 0.0f)
+					nearest = std::min(nearest, ((direction[axis] > 0.0f ? roomMax[axis] : roomMin[axis]) - origin[axis]) / direction[axis]);
+			}
+
+			for (const Box& box : m_Boxes)
+			{
+				float enter = 0.0f, exit = nearest;
+				for (uint32_t axis = 0; axis < 3 && enter <= exit; ++axis)
+				{
+					const float inverse = 1.0f / direction[axis];
+					float t0 = (box.m_Bounds[axis] - origin[axis]) * inverse;
+					float t1 = (box.m_Bounds[axis + 3] - origin[axis]) * inverse;
+					if (t0 > t1)
+						std::swap(t0, t1);
+					enter = std::max(enter, t0);
+					exit = std::min(exit, t1);
+				}
+				if (enter <= exit && enter > kNearClip)
+					nearest = enter;
+			}
+
+			// Pillars go floor to ceiling, so only x and z matter
+			for (const Round& pillar : m_Pillars)
+			{
+				const float ox = origin[0] - pillar.m_Center[0], oz = origin[2] - pillar.m_Center[2];
+				const float a = direction[0] * direction[0] + direction[2] * direction[2];
+				const float b = ox * direction[0] + oz * direction[2];
+				const float c = ox * ox + oz * oz - pillar.m_Radius * pillar.m_Radius;
+				const float discriminant = b * b - a * c;
+				if (discriminant > 0.0f)
+				{
+					const float t = (-b - std::sqrt(discriminant)) / a;
+					if (t > kNearClip && t < nearest)
+						nearest = t;
+				}
+			}
+
+			for (const Round& ball : m_Balls)
+			{
+				const float o[3] = { origin[0] - ball.m_Center[0], origin[1] - ball.m_Center[1], origin[2] - ball.m_Center[2] };
+				const float a = direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2];
+				const float b = o[0] * direction[0] + o[1] * direction[1] + o[2] * direction[2];
+				const float c = o[0] * o[0] + o[1] * o[1] + o[2] * o[2] - ball.m_Radius * ball.m_Radius;
+				const float discriminant = b * b - a * c;
+				if (discriminant > 0.0f)
+				{
+					const float t = (-b - std::sqrt(discriminant)) / a;
+					if (t > kNearClip && t < nearest)
+						nearest = t;
+				}
+			}
+			return nearest;
+		}
+
+		std::vector<Box> m_Boxes;
+		std::vector<Round> m_Pillars;
+		std::vector<Round> m_Balls;
+	};
+
+	// Nearest, from the centre of each destination pixel, for depth there's only one resolution of
+	void PointSample(const DepthFrame& source, uint32_t width, uint32_t height, DepthFrame& destination)
+	{
+		destination = DepthFrame();
+		destination.m_Width = width;
+		destination.m_Height = height;
+		destination.m_ZMagic = source.m_ZMagic;
+		destination.m_FovTangent = source.m_FovTangent;
+		destination.m_Depth.resize((size_t)width * height);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const uint32_t sourceY = std::min((uint32_t)(((float)y + 0.5f) * (float)source.m_Height / (float)height), source.m_Height - 1);
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const uint32_t sourceX = std::min((uint32_t)(((float)x + 0.5f) * (float)source.m_Width / (float)width), source.m_Width - 1);
+				destination.m_Depth[(size_t)y * width + x] = source.m_Depth[(size_t)sourceY * source.m_Width + sourceX];
+			}
+		}
+	}
+
+	// Bilinear back up to native, as an upscaler's input would be at its simplest, and measured against what native gave
+	void MeasureError(const Plane& native, const Plane& low, double& meanError, double& badPixels)
+	{
+		double sum = 0.0;
+		uint64_t bad = 0;
+		for (uint32_t y = 0; y < native.m_Height; ++y)
+		{
+			const float sourceY = std::min(std::max(((float)y + 0.5f) * (float)low.m_Height / (float)native.m_Height - 0.5f, 0.0f), (float)(low.m_Height - 1));
+			const uint32_t y0 = (uint32_t)sourceY, y1 = std::min(y0 + 1, low.m_Height - 1);
+			const float fy = sourceY - (float)y0;
+			for (uint32_t x = 0; x < native.m_Width; ++x)
+			{
+				const float sourceX = std::min(std::max(((float)x + 0.5f) * (float)low.m_Width / (float)native.m_Width - 0.5f, 0.0f), (float)(low.m_Width - 1));
+				const uint32_t x0 = (uint32_t)sourceX, x1 = std::min(x0 + 1, low.m_Width - 1);
+				const float fx = sourceX - (float)x0;
+				const float top = low.At(x0, y0) + (low.At(x1, y0) - low.At(x0, y0)) * fx;
+				const float bottom = low.At(x0, y1) + (low.At(x1, y1) - low.At(x0, y1)) * fx;
+				const double error = std::fabs((double)(top + (bottom - top) * fy) - (double)native.At(x, y));
+				sum += error;
+				bad += error > 0.1 ? 1 : 0;
+			}
+		}
+
+		const double pixelCount = (double)std::max((size_t)native.m_Width * native.m_Height, (size_t)1);
+		meanError += sum / pixelCount;
+		badPixels += (double)bad / pixelCount;
+	}
+
+	bool Matches(const Plane& a, const Plane& b)
+	{
+		// Planes a frame didn't use are empty, with nothing to compare
+		return a.m_Width == b.m_Width && a.m_Height == b.m_Height && a.m_Values.size() == b.m_Values.size() &&
+			(a.m_Values.empty() || std::memcmp(a.m_Values.data(), b.m_Values.data(), a.m_Values.size() * sizeof(float)) == 0);
+	}
+
+	bool Matches(const FrameResult& a, const FrameResult& b)
+	{
+		bool bMatches = Matches(a.m_LinearDepth, b.m_LinearDepth) && Matches(a.m_AO, b.m_AO);
+		for (uint32_t level = 0; level < kLevels; ++level)
+		{
+			bMatches = bMatches && Matches(a.m_Downsized[level], b.m_Downsized[level]) && Matches(a.m_Merged[level], b.m_Merged[level]) &&
+				Matches(a.m_HighQuality[level], b.m_HighQuality[level]);
+			for (uint32_t slice = 0; slice < kSlices; ++slice)
+				bMatches = bMatches && Matches(a.m_Tiled[level][slice], b.m_Tiled[level][slice]);
+			if (level < kLevels - 1)
+				bMatches = bMatches && Matches(a.m_Smooth[level], b.m_Smooth[level]);
+		}
+		return bMatches;
+	}
+}
+
+SSAOReference::BenchmarkResult SSAOReference::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	Processor processor;
+	result.m_Workers = processor.GetWorkerCount();
+
+	DepthSequence capture;
+	result.m_bFromCapture = !desc.m_CaptureFile.empty() && LoadDepthFrames(desc.m_CaptureFile, capture) && !capture.m_Frames.empty();
+
+	const uint32_t width = result.m_bFromCapture ? capture.m_Width : desc.m_Width;
+	const uint32_t height = result.m_bFromCapture ? capture.m_Height : desc.m_Height;
+	const uint32_t frames = result.m_bFromCapture ? std::min(desc.m_Frames, (uint32_t)capture.m_Frames.size()) : desc.m_Frames;
+
+	const SyntheticRoom room(desc.m_Seed);
+
+	DepthFrame native, low;
+	FrameResult processed, reference, lowProcessed;
+	double processorSeconds = 0.0, referenceSeconds = 0.0;
+
+	for (uint32_t frame = 0; frame < frames && result.m_bValid; ++frame)
+	{
+		const float t = (float)frame / (float)std::max(frames - 1, 1u);
+		const DepthFrame* depth = &native;
+		if (result.m_bFromCapture)
+			depth = &capture.m_Frames[frame];
+		else
+			room.Render(t, width, height, native);
+
+		auto start = std::chrono::steady_clock::now();
+		processor.ProcessFrame(*depth, desc.m_Settings, processed);
+		processorSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		ProcessFrameReference(*depth, desc.m_Settings, reference);
+		referenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		result.m_bValid = Matches(processed, reference);
+
+		// Each lower resolution is drawn at that resolution, as a frame rendered for an upscaler would be. A capture only has the one, so
+		// it's point sampled down instead
+		for (uint32_t scale = 0; scale < kResolutionScales && result.m_bValid; ++scale)
+		{
+			const uint32_t lowWidth = std::max((uint32_t)((float)width * kResolutionScale[scale] + 0.5f), 16u);
+			const uint32_t lowHeight = std::max((uint32_t)((float)height * kResolutionScale[scale] + 0.5f), 16u);
+			if (result.m_bFromCapture)
+				PointSample(*depth, lowWidth, lowHeight, low);
+			else
+				room.Render(t, lowWidth, lowHeight, low);
+
+			processor.ProcessFrame(low, desc.m_Settings, lowProcessed);
+			ProcessFrameReference(low, desc.m_Settings, reference);
+			result.m_bValid = Matches(lowProcessed, reference);
+
+			MeasureError(processed.m_AO, lowProcessed.m_AO, result.m_MeanError[scale], result.m_BadPixels[scale]);
+		}
+		if (!result.m_bValid)
+			break;
+
+		++result.m_FramesRun;
+	}
+
+	const double runs = (double)std::max(result.m_FramesRun, 1u);
+	result.m_ProcessorMs = processorSeconds * 1000.0 / runs;
+	result.m_ReferenceMs = referenceSeconds * 1000.0 / runs;
+	for (uint32_t scale = 0; scale < kResolutionScales; ++scale)
+	{
+		result.m_MeanError[scale] /= runs;
+		result.m_BadPixels[scale] /= runs;
+	}
+	return result;
+}
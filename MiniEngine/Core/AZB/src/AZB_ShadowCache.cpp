@@ -0,0 +1,354 @@
+//===============================================================================
+// desc: Keeps a shadow map from one frame to the next and works out which part of it has to be drawn again. Casters are matched to last frame's
+//       by index, and one that has moved, or whose transform has changed at all, dirties the texels it covered and the ones it covers now. Any
+//       change to the light or the shadow camera dirties the whole map. One View per shadow map, so each cascade is kept or redrawn on its own.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ShadowCache.h"
+#include "AZB_CounterRNG.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	bool SameState(const ShadowCache::ViewState& a, const ShadowCache::ViewState& b)
+	{
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			if (a.m_LightDirection[axis] != b.m_LightDirection[axis] || a.m_Eye[axis] != b.m_Eye[axis] || a.m_Bounds[axis] != b.m_Bounds[axis])
+				return false;
+		}
+		return a.m_Width == b.m_Width && a.m_Height == b.m_Height;
+	}
+
+	void Union(ShadowCache::Rect& rect, const ShadowCache::Rect& other)
+	{
+		if (other.IsEmpty())
+			return;
+		if (rect.IsEmpty())
+		{
+			rect = other;
+			return;
+		}
+		rect.m_Left = std::min(rect.m_Left, other.m_Left);
+		rect.m_Top = std::min(rect.m_Top, other.m_Top);
+		rect.m_Right = std::max(rect.m_Right, other.m_Right);
+		rect.m_Bottom = std::max(rect.m_Bottom, other.m_Bottom);
+	}
+
+	bool Overlaps(const ShadowCache::Rect& a, const ShadowCache::Rect& b)
+	{
+		return !a.IsEmpty() && !b.IsEmpty() && a.m_Left < b.m_Right && b.m_Left < a.m_Right && a.m_Top < b.m_Bottom && b.m_Top < a.m_Bottom;
+	}
+
+	// Position in shadow camera view space, which is light space less the eye
+	void ToView(const ShadowCascades::LightBasis& basis, const float eyeLS[3], float x, float y, float z, float view[3])
+	{
+		const float world[3] = { x, y, z };
+		basis.ToLightSpace(world, view);
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			view[axis] -= eyeLS[axis];
+	}
+
+	// Texels a sphere covers, and one more all round so a rasterizer working things out a little differently can't reach past it. Empty if the
+	// sphere misses the map, or the depth range behind the eye
+	ShadowCache::Rect Footprint(const ShadowCache::ViewState& state, const float view[3], float radius)
+	{
+		ShadowCache::Rect rect;
+		if (view[2] + radius < 0.0f || view[2] - radius > state.m_Bounds[2])
+			return rect;
+
+		const float width = (float)state.m_Width;
+		const float height = (float)state.m_Height;
+		const float left = std::floor(((view[0] - radius) / state.m_Bounds[0] + 0.5f) * width) - 1.0f;
+		const float right = std::ceil(((view[0] + radius) / state.m_Bounds[0] + 0.5f) * width) + 1.0f;
+		const float top = std::floor((0.5f - (view[1] + radius) / state.m_Bounds[1]) * height) - 1.0f;
+		const float bottom = std::ceil((0.5f - (view[1] - radius) / state.m_Bounds[1]) * height) + 1.0f;
+
+		rect.m_Left = (uint32_t)std::min(std::max(left, 0.0f), width);
+		rect.m_Right = (uint32_t)std::min(std::max(right, 0.0f), width);
+		rect.m_Top = (uint32_t)std::min(std::max(top, 0.0f), height);
+		rect.m_Bottom = (uint32_t)std::min(std::max(bottom, 0.0f), height);
+		if (rect.IsEmpty())
+			rect = ShadowCache::Rect();
+		return rect;
+	}
+}
+
+//===============================================================================
+
+ShadowCache::FrameResult ShadowCache::View::Update(const ViewState& state, const ShadowCascades::CasterBounds& casters, const std::vector<uint32_t>& versions)
+{
+	FrameResult result;
+	const uint32_t count = casters.GetCount();
+
+	const bool bStateChanged = !m_bValid || !SameState(state, m_State);
+	result.m_bFullRedraw = bStateChanged || count != m_Casters.GetCount() || versions.size() != count || m_Versions.size() != count;
+
+	if (bStateChanged)
+	{
+		m_State = state;
+		m_Basis = ShadowCascades::MakeLightBasis(state.m_LightDirection);
+		m_Basis.ToLightSpace(state.m_Eye, m_EyeLS);
+	}
+
+	Rect& dirty = result.m_DirtyRect;
+	if (result.m_bFullRedraw)
+	{
+		dirty.m_Right = state.m_Width;
+		dirty.m_Bottom = state.m_Height;
+	}
+	else
+	{
+		// The light hasn't changed, so where a caster was last frame still maps to the same texels
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const bool bMoved = casters.m_X[i] != m_Casters.m_X[i] || casters.m_Y[i] != m_Casters.m_Y[i] || casters.m_Z[i] != m_Casters.m_Z[i] ||
+				casters.m_Radius[i] != m_Casters.m_Radius[i];
+			if (!bMoved && versions[i] == m_Versions[i])
+				continue;
+
+			++result.m_DirtyCasters;
+			float view[3];
+			ToView(m_Basis, m_EyeLS, m_Casters.m_X[i], m_Casters.m_Y[i], m_Casters.m_Z[i], view);
+			Union(dirty, Footprint(state, view, m_Casters.m_Radius[i]));
+			ToView(m_Basis, m_EyeLS, casters.m_X[i], casters.m_Y[i], casters.m_Z[i], view);
+			Union(dirty, Footprint(state, view, casters.m_Radius[i]));
+		}
+
+		if (!dirty.IsEmpty())
+		{
+			dirty.m_Left = dirty.m_Left / kTileSize * kTileSize;
+			dirty.m_Top = dirty.m_Top / kTileSize * kTileSize;
+			dirty.m_Right = std::min((dirty.m_Right + kTileSize - 1) / kTileSize * kTileSize, state.m_Width);
+			dirty.m_Bottom = std::min((dirty.m_Bottom + kTileSize - 1) / kTileSize * kTileSize, state.m_Height);
+		}
+	}
+
+	// Everything touching the cleared texels has to go back in, whether it moved or not
+	m_Drawn.assign(count, 0);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		float view[3];
+		ToView(m_Basis, m_EyeLS, casters.m_X[i], casters.m_Y[i], casters.m_Z[i], view);
+		const Rect footprint = Footprint(state, view, casters.m_Radius[i]);
+		if (footprint.IsEmpty())
+			continue;
+
+		++result.m_CastersInView;
+		if (Overlaps(footprint, dirty))
+		{
+			m_Drawn[i] = 1;
+			++result.m_CastersDrawn;
+		}
+	}
+	result.m_CastersSkipped = result.m_CastersInView - result.m_CastersDrawn;
+
+	if (!dirty.IsEmpty())
+	{
+		result.m_DirtyView[0] = ((float)dirty.m_Left / state.m_Width - 0.5f) * state.m_Bounds[0];
+		result.m_DirtyView[1] = ((float)dirty.m_Right / state.m_Width - 0.5f) * state.m_Bounds[0];
+		result.m_DirtyView[2] = (0.5f - (float)dirty.m_Bottom / state.m_Height) * state.m_Bounds[1];
+		result.m_DirtyView[3] = (0.5f - (float)dirty.m_Top / state.m_Height) * state.m_Bounds[1];
+	}
+
+	m_Casters = casters;
+	m_Versions = versions;
+	m_bValid = true;
+
+	++m_Stats.m_Frames;
+	if (result.m_bFullRedraw)
+		++m_Stats.m_FullRedraws;
+	else if (!dirty.IsEmpty())
+		++m_Stats.m_PartialRedraws;
+	else
+		++m_Stats.m_CachedFrames;
+	m_Stats.m_CastersDrawn += result.m_CastersDrawn;
+	m_Stats.m_CastersSkipped += result.m_CastersSkipped;
+	m_Stats.m_LastSkipped = result.m_CastersSkipped;
+	return result;
+}
+
+//===============================================================================
+
+namespace
+{
+	// The stand-in shadow map holds, for each texel center a sphere covers, the height of the sphere's surface toward the light
+	class ProxyMap
+	{
+	public:
+		ProxyMap(const ShadowCache::ViewState& state) : m_State(state), m_Depths((size_t)state.m_Width * state.m_Height, -1.0f)
+		{
+			m_Basis = ShadowCascades::MakeLightBasis(state.m_LightDirection);
+			m_Basis.ToLightSpace(state.m_Eye, m_EyeLS);
+		}
+
+		void Clear(const ShadowCache::Rect& rect)
+		{
+			for (uint32_t y = rect.m_Top; y < rect.m_Bottom; ++y)
+				std::fill(&m_Depths[(size_t)y * m_State.m_Width + rect.m_Left], &m_Depths[(size_t)y * m_State.m_Width + rect.m_Right], -1.0f);
+		}
+
+		// Only the texels inside scissor are written, as the GPU would with the scissor set to the dirty rect
+		void Draw(const ShadowCascades::CasterBounds& casters, uint32_t i, const ShadowCache::Rect& scissor)
+		{
+			float view[3];
+			ToView(m_Basis, m_EyeLS, casters.m_X[i], casters.m_Y[i], casters.m_Z[i], view);
+			const float radius = casters.m_Radius[i];
+
+			if (view[2] - radius > m_State.m_Bounds[2] || view[2] + radius < 0.0f)
+				return;
+
+			// Texel centers within the sphere's square, worked out apart from Footprint() so a mistake there can't hide itself
+			const float width = (float)m_State.m_Width, height = (float)m_State.m_Height;
+			const float firstX = std::ceil(((view[0] - radius) / m_State.m_Bounds[0] + 0.5f) * width - 0.5f);
+			const float lastX = std::floor(((view[0] + radius) / m_State.m_Bounds[0] + 0.5f) * width - 0.5f);
+			const float firstY = std::ceil((0.5f - (view[1] + radius) / m_State.m_Bounds[1]) * height - 0.5f);
+			const float lastY = std::floor((0.5f - (view[1] - radius) / m_State.m_Bounds[1]) * height - 0.5f);
+
+			const uint32_t left = std::max((uint32_t)std::min(std::max(firstX, 0.0f), width), scissor.m_Left);
+			const uint32_t right = std::min((uint32_t)std::min(std::max(lastX + 1.0f, 0.0f), width), scissor.m_Right);
+			const uint32_t top = std::max((uint32_t)std::min(std::max(firstY, 0.0f), height), scissor.m_Top);
+			const uint32_t bottom = std::min((uint32_t)std::min(std::max(lastY + 1.0f, 0.0f), height), scissor.m_Bottom);
+
+			for (uint32_t y = top; y < bottom; ++y)
+			{
+				const float texelY = (0.5f - (y + 0.5f) / m_State.m_Height) * m_State.m_Bounds[1] - view[1];
+				for (uint32_t x = left; x < right; ++x)
+				{
+					const float texelX = ((x + 0.5f) / m_State.m_Width - 0.5f) * m_State.m_Bounds[0] - view[0];
+					const float distanceSq = texelX * texelX + texelY * texelY;
+					if (distanceSq > radius * radius)
+						continue;
+
+					const float depth = std::min(std::max(view[2] + std::sqrt(radius * radius - distanceSq), 0.0f), m_State.m_Bounds[2]);
+					float& texel = m_Depths[(size_t)y * m_State.m_Width + x];
+					texel = std::max(texel, depth);
+				}
+			}
+		}
+
+		bool Matches(const ProxyMap& other) const
+		{
+			return m_Depths.size() == other.m_Depths.size() && std::memcmp(m_Depths.data(), other.m_Depths.data(), m_Depths.size() * sizeof(float)) == 0;
+		}
+
+	private:
+		ShadowCache::ViewState m_State;
+		ShadowCascades::LightBasis m_Basis;
+		float m_EyeLS[3];
+		std::vector<float> m_Depths;
+	};
+
+	ShadowCache::ViewState MakeState(float orientation, float inclination)
+	{
+		// The sun as RTUA works it out, and its single shadow camera with the far bounding plane through the origin
+		ShadowCache::ViewState state = {};
+		state.m_LightDirection[0] = -std::cos(orientation) * std::cos(inclination);
+		state.m_LightDirection[1] = -std::sin(inclination);
+		state.m_LightDirection[2] = -std::sin(orientation) * std::cos(inclination);
+		state.m_Bounds[0] = 5000.0f;
+		state.m_Bounds[1] = 3000.0f;
+		state.m_Bounds[2] = 3000.0f;
+		state.m_Width = 256;
+		state.m_Height = 256;
+		return state;
+	}
+}
+
+ShadowCache::BenchmarkResult ShadowCache::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	const float sceneMin[3] = { -1800.0f, -100.0f, -1100.0f };
+	const float sceneMax[3] = { 1800.0f, 1400.0f, 1100.0f };
+
+	CounterRNG::Stream random(desc.m_Seed);
+	ShadowCascades::CasterBounds casters;
+	for (uint32_t i = 0; i < desc.m_Casters; ++i)
+	{
+		float position[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			position[axis] = random.NextFloat(sceneMin[axis], sceneMax[axis]);
+		casters.Add(position[0], position[1], position[2], random.NextFloat(10.0f, 120.0f));
+	}
+	std::vector<uint32_t> versions(desc.m_Casters, 0);
+
+	float orientation = random.NextFloat(6.2831853f);
+	ViewState state = MakeState(orientation, 0.6f);
+
+	View view;
+	ProxyMap cached(state);
+	double fullSeconds = 0.0, cachedSeconds = 0.0;
+	uint64_t inView = 0, drawn = 0;
+
+	for (uint32_t frame = 0; frame < desc.m_Frames; ++frame)
+	{
+		const bool bRelight = frame > 0 && desc.m_RelightInterval != 0 && frame % desc.m_RelightInterval == 0;
+		if (bRelight)
+		{
+			orientation += 0.05f;
+			state = MakeState(orientation, 0.6f);
+			cached = ProxyMap(state);
+		}
+
+		// Some frames nothing moves at all. Half of those that do move are only turned in place, which the spheres can't show
+		const uint32_t moving = desc.m_Casters > 0 ? (uint32_t)random.NextInt(0, (int32_t)desc.m_MovingCasters) : 0;
+		for (uint32_t m = 0; m < moving; ++m)
+		{
+			const uint32_t i = (uint32_t)random.NextInt(0, (int32_t)desc.m_Casters - 1);
+			if (random.NextUint() & 1)
+			{
+				casters.m_X[i] += random.NextFloat(-60.0f, 60.0f);
+				casters.m_Z[i] += random.NextFloat(-60.0f, 60.0f);
+			}
+			++versions[i];
+		}
+
+		const FrameResult frameResult = view.Update(state, casters, versions);
+		inView += frameResult.m_CastersInView;
+		drawn += frameResult.m_CastersDrawn;
+
+		// Nothing moved and the sun stayed put, so nothing should be drawn. A new sun has to redraw the lot
+		if (moving == 0 && !bRelight && frame > 0)
+			result.m_bValid = result.m_bValid && frameResult.m_DirtyRect.IsEmpty() && frameResult.m_CastersDrawn == 0;
+		if (bRelight || frame == 0)
+			result.m_bValid = result.m_bValid && frameResult.m_bFullRedraw;
+		result.m_bValid = result.m_bValid && frameResult.m_CastersDrawn + frameResult.m_CastersSkipped == frameResult.m_CastersInView;
+
+		Rect whole;
+		whole.m_Right = state.m_Width;
+		whole.m_Bottom = state.m_Height;
+
+		auto start = std::chrono::steady_clock::now();
+		ProxyMap full(state);
+		for (uint32_t i = 0; i < casters.GetCount(); ++i)
+			full.Draw(casters, i, whole);
+		fullSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		if (!frameResult.m_DirtyRect.IsEmpty())
+		{
+			cached.Clear(frameResult.m_DirtyRect);
+			for (uint32_t i = 0; i < casters.GetCount(); ++i)
+			{
+				if (view.IsDrawn(i))
+					cached.Draw(casters, i, frameResult.m_DirtyRect);
+			}
+		}
+		cachedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		result.m_bValid = result.m_bValid && cached.Matches(full);
+	}
+
+	const double frames = std::max(desc.m_Frames, 1u);
+	result.m_Stats = view.GetStats();
+	result.m_AverageInView = inView / frames;
+	result.m_AverageDrawn = drawn / frames;
+	result.m_FullMs = fullSeconds * 1e3 / frames;
+	result.m_CachedMs = cachedSeconds * 1e3 / frames;
+	return result;
+}
@@ -0,0 +1,452 @@
+//===============================================================================
+// desc: Cascaded sun shadows. The view is split with the practical split scheme (a blend of logarithmic and uniform splits), each slice is
+//       wrapped in a sphere so its cascade keeps the same size however the camera turns, and ShadowCamera snaps each cascade to texels the way
+//       it always has. Casters are culled for every cascade at once, in one SIMD pass over their bounding spheres, against each cascade's box
+//       extruded back toward the sun.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ShadowCascades.h"
+#include "AZB_CounterRNG.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AZB_CASCADES_SSE2 1
+#include <emmintrin.h>
+#else
+#define AZB_CASCADES_SSE2 0
+#endif
+
+namespace
+{
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void Cross(const float a[3], const float b[3], float out[3])
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	void Normalize(float v[3])
+	{
+		const float rcpLength = 1.0f / std::sqrt(Dot(v, v));
+		v[0] *= rcpLength; v[1] *= rcpLength; v[2] *= rcpLength;
+	}
+
+	// Squared distance from a point to a box, against its squared radius. Positive means the sphere misses
+	double Margin(double x, double y, double z, double radius, const ShadowCascades::Cascade& cascade)
+	{
+		const double dx = std::max(std::max(cascade.m_CullMin[0] - x, x - cascade.m_CullMax[0]), 0.0);
+		const double dy = std::max(std::max(cascade.m_CullMin[1] - y, y - cascade.m_CullMax[1]), 0.0);
+		const double dz = std::max(std::max(cascade.m_CullMin[2] - z, z - cascade.m_CullMax[2]), 0.0);
+		return dx * dx + dy * dy + dz * dz - radius * radius;
+	}
+
+	void ToLightSpace(const ShadowCascades::LightBasis& basis, double x, double y, double z, double light[3])
+	{
+		light[0] = x * basis.m_Right[0] + y * basis.m_Right[1] + z * basis.m_Right[2];
+		light[1] = x * basis.m_Up[0] + y * basis.m_Up[1] + z * basis.m_Up[2];
+		light[2] = x * basis.m_Back[0] + y * basis.m_Back[1] + z * basis.m_Back[2];
+	}
+
+	uint8_t CasterMask(const ShadowCascades::CasterBounds& casters, uint32_t i, const ShadowCascades::LightBasis& basis,
+		const ShadowCascades::Cascade* cascades, uint32_t cascadeCount)
+	{
+		const float world[3] = { casters.m_X[i], casters.m_Y[i], casters.m_Z[i] };
+		float light[3];
+		basis.ToLightSpace(world, light);
+
+		uint8_t mask = 0;
+		for (uint32_t c = 0; c < cascadeCount; ++c)
+		{
+			const float dx = std::max(std::max(cascades[c].m_CullMin[0] - light[0], light[0] - cascades[c].m_CullMax[0]), 0.0f);
+			const float dy = std::max(std::max(cascades[c].m_CullMin[1] - light[1], light[1] - cascades[c].m_CullMax[1]), 0.0f);
+			const float dz = std::max(std::max(cascades[c].m_CullMin[2] - light[2], light[2] - cascades[c].m_CullMax[2]), 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= casters.m_Radius[i] * casters.m_Radius[i])
+				mask |= (uint8_t)(1u << c);
+		}
+		return mask;
+	}
+}
+
+//===============================================================================
+
+void ShadowCascades::LightBasis::ToLightSpace(const float world[3], float light[3]) const
+{
+	light[0] = Dot(world, m_Right);
+	light[1] = Dot(world, m_Up);
+	light[2] = Dot(world, m_Back);
+}
+
+ShadowCascades::LightBasis ShadowCascades::MakeLightBasis(const float lightDirection[3])
+{
+	// Mirrors BaseCamera::SetLookDirection, fallbacks and all, with Z as the up hint the way ShadowCamera passes it
+	float forward[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+	if (Dot(forward, forward) < 0.000001f)
+	{
+		forward[0] = 0.0f; forward[1] = 0.0f; forward[2] = -1.0f;
+	}
+	else
+		Normalize(forward);
+
+	const float upHint[3] = { 0.0f, 0.0f, 1.0f };
+	LightBasis basis;
+	Cross(forward, upHint, basis.m_Right);
+	if (Dot(basis.m_Right, basis.m_Right) < 0.000001f)
+	{
+		// Forward turned a quarter turn about Y
+		basis.m_Right[0] = -forward[2];
+		basis.m_Right[1] = forward[1];
+		basis.m_Right[2] = forward[0];
+	}
+	Normalize(basis.m_Right);
+	Cross(basis.m_Right, forward, basis.m_Up);
+
+	basis.m_Back[0] = -forward[0];
+	basis.m_Back[1] = -forward[1];
+	basis.m_Back[2] = -forward[2];
+	return basis;
+}
+
+void ShadowCascades::ComputeSplits(float nearDist, float farDist, uint32_t count, float lambda, float splits[kMaxCascades + 1])
+{
+	count = std::min(std::max(count, 1u), kMaxCascades);
+	nearDist = std::max(nearDist, 0.001f);
+
+	splits[0] = nearDist;
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		const float fraction = (float)i / count;
+		const float logSplit = nearDist * std::pow(farDist / nearDist, fraction);
+		const float uniformSplit = nearDist + (farDist - nearDist) * fraction;
+		splits[i] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+	}
+	splits[count] = farDist;
+}
+
+uint32_t ShadowCascades::FitCascades(const ViewDesc& view, const float lightDirection[3], const Settings& settings, Cascade cascades[kMaxCascades])
+{
+	const uint32_t count = std::min(std::max(settings.m_Cascades, 1u), kMaxCascades);
+	const float farDist = std::max(std::min(view.m_Far, settings.m_ShadowDistance), view.m_Near + 1.0f);
+
+	float splits[kMaxCascades + 1];
+	ComputeSplits(view.m_Near, farDist, count, settings.m_Lambda, splits);
+
+	float forward[3] = { view.m_Forward[0], view.m_Forward[1], view.m_Forward[2] };
+	Normalize(forward);
+	float travel[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+	Normalize(travel);
+	const LightBasis basis = MakeLightBasis(travel);
+
+	// Squared radial spread per unit of distance, out to a corner of the view
+	const float spreadSq = view.m_TanHalfFovX * view.m_TanHalfFovX + view.m_TanHalfFovY * view.m_TanHalfFovY;
+	const float texelsZ = (float)((1u << settings.m_BufferPrecision) - 1);
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Cascade& cascade = cascades[i];
+		const float n = splits[i];
+		const float f = splits[i + 1];
+
+		// The smallest sphere through both ends of the slice, centered on the view axis. Its radius only depends on the splits and the FOV, so the
+		// cascade stays the same size as the camera turns, and only moves in whole texels once snapped
+		const float center = std::min((n + f) * (1.0f + spreadSq) * 0.5f, f);
+		const float radius = std::sqrt(std::max((center - n) * (center - n) + n * n * spreadSq, (f - center) * (f - center) + f * f * spreadSq));
+
+		float sphere[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			sphere[axis] = view.m_Position[axis] + forward[axis] * center;
+
+		cascade.m_SplitNear = n;
+		cascade.m_SplitFar = f;
+
+		// The far plane is the side of the sphere away from the sun, and the depth runs back past the near side by the extrusion
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			cascade.m_Center[axis] = sphere[axis] + travel[axis] * radius;
+		cascade.m_Bounds[0] = 2.0f * radius;
+		cascade.m_Bounds[1] = 2.0f * radius;
+		cascade.m_Bounds[2] = 2.0f * radius + settings.m_Extrusion;
+
+		// UpdateMatrix floors the light space center to a texel, so the cascade can land up to a texel below where it was asked to be
+		float sphereLS[3];
+		basis.ToLightSpace(sphere, sphereLS);
+		const float texelXY = cascade.m_Bounds[0] / settings.m_BufferSize;
+		const float texelZ = cascade.m_Bounds[2] / texelsZ;
+		cascade.m_CullMin[0] = sphereLS[0] - radius - texelXY;
+		cascade.m_CullMin[1] = sphereLS[1] - radius - texelXY;
+		cascade.m_CullMin[2] = sphereLS[2] - radius - texelZ;
+		cascade.m_CullMax[0] = sphereLS[0] + radius;
+		cascade.m_CullMax[1] = sphereLS[1] + radius;
+		cascade.m_CullMax[2] = sphereLS[2] + radius + settings.m_Extrusion;
+	}
+	return count;
+}
+
+ShadowCascades::Cascade ShadowCascades::MakeFixedCascade(const float lightDirection[3], const float center[3], const float bounds[3],
+	uint32_t bufferSize, uint32_t bufferPrecision)
+{
+	Cascade cascade;
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		cascade.m_Center[axis] = center[axis];
+		cascade.m_Bounds[axis] = bounds[axis];
+	}
+
+	float centerLS[3];
+	MakeLightBasis(lightDirection).ToLightSpace(center, centerLS);
+	const float texelX = bounds[0] / bufferSize;
+	const float texelY = bounds[1] / bufferSize;
+	const float texelZ = bounds[2] / (float)((1u << bufferPrecision) - 1);
+	cascade.m_CullMin[0] = centerLS[0] - bounds[0] * 0.5f - texelX;
+	cascade.m_CullMin[1] = centerLS[1] - bounds[1] * 0.5f - texelY;
+	cascade.m_CullMin[2] = centerLS[2] - texelZ;
+	cascade.m_CullMax[0] = centerLS[0] + bounds[0] * 0.5f;
+	cascade.m_CullMax[1] = centerLS[1] + bounds[1] * 0.5f;
+	cascade.m_CullMax[2] = centerLS[2] + bounds[2];
+	return cascade;
+}
+
+//===============================================================================
+
+void ShadowCascades::CasterBounds::Clear(void)
+{
+	m_X.clear();
+	m_Y.clear();
+	m_Z.clear();
+	m_Radius.clear();
+}
+
+void ShadowCascades::CasterBounds::Add(float x, float y, float z, float radius)
+{
+	m_X.push_back(x);
+	m_Y.push_back(y);
+	m_Z.push_back(z);
+	m_Radius.push_back(radius);
+}
+
+void ShadowCascades::CullCasters(const CasterBounds& casters, const LightBasis& basis, const Cascade* cascades, uint32_t cascadeCount, std::vector<uint8_t>& masks)
+{
+	cascadeCount = std::min(cascadeCount, kMaxCullBoxes);
+	const uint32_t count = casters.GetCount();
+	masks.assign(count, 0);
+
+	uint32_t i = 0;
+#if AZB_CASCADES_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 right0 = _mm_set1_ps(basis.m_Right[0]), right1 = _mm_set1_ps(basis.m_Right[1]), right2 = _mm_set1_ps(basis.m_Right[2]);
+	const __m128 up0 = _mm_set1_ps(basis.m_Up[0]), up1 = _mm_set1_ps(basis.m_Up[1]), up2 = _mm_set1_ps(basis.m_Up[2]);
+	const __m128 back0 = _mm_set1_ps(basis.m_Back[0]), back1 = _mm_set1_ps(basis.m_Back[1]), back2 = _mm_set1_ps(basis.m_Back[2]);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&casters.m_X[i]);
+		const __m128 y = _mm_loadu_ps(&casters.m_Y[i]);
+		const __m128 z = _mm_loadu_ps(&casters.m_Z[i]);
+		const __m128 radius = _mm_loadu_ps(&casters.m_Radius[i]);
+		const __m128 radiusSq = _mm_mul_ps(radius, radius);
+
+		// Into light space once, however many cascades there are
+		const __m128 lightX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, right0), _mm_mul_ps(y, right1)), _mm_mul_ps(z, right2));
+		const __m128 lightY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, up0), _mm_mul_ps(y, up1)), _mm_mul_ps(z, up2));
+		const __m128 lightZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, back0), _mm_mul_ps(y, back1)), _mm_mul_ps(z, back2));
+
+		uint32_t lanes[4] = {};
+		for (uint32_t c = 0; c < cascadeCount; ++c)
+		{
+			const Cascade& cascade = cascades[c];
+			const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(cascade.m_CullMin[0]), lightX), _mm_sub_ps(lightX, _mm_set1_ps(cascade.m_CullMax[0]))), zero);
+			const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(cascade.m_CullMin[1]), lightY), _mm_sub_ps(lightY, _mm_set1_ps(cascade.m_CullMax[1]))), zero);
+			const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(cascade.m_CullMin[2]), lightZ), _mm_sub_ps(lightZ, _mm_set1_ps(cascade.m_CullMax[2]))), zero);
+			const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			const uint32_t hits = (uint32_t)_mm_movemask_ps(_mm_cmple_ps(distanceSq, radiusSq));
+			for (uint32_t lane = 0; lane < 4; ++lane)
+				lanes[lane] |= ((hits >> lane) & 1u) << c;
+		}
+
+		for (uint32_t lane = 0; lane < 4; ++lane)
+			masks[i + lane] = (uint8_t)lanes[lane];
+	}
+#endif
+
+	for (; i < count; ++i)
+		masks[i] = CasterMask(casters, i, basis, cascades, cascadeCount);
+}
+
+void ShadowCascades::CullCastersReference(const CasterBounds& casters, const LightBasis& basis, const Cascade* cascades, uint32_t cascadeCount, std::vector<uint8_t>& masks)
+{
+	cascadeCount = std::min(cascadeCount, kMaxCullBoxes);
+	const uint32_t count = casters.GetCount();
+	masks.assign(count, 0);
+
+	for (uint32_t c = 0; c < cascadeCount; ++c)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			double light[3];
+			ToLightSpace(basis, casters.m_X[i], casters.m_Y[i], casters.m_Z[i], light);
+			if (Margin(light[0], light[1], light[2], casters.m_Radius[i], cascades[c]) <= 0.0)
+				masks[i] |= (uint8_t)(1u << c);
+		}
+	}
+}
+
+void ShadowCascades::CountCasters(const std::vector<uint8_t>& masks, uint32_t cascadeCount, uint32_t counts[kMaxCullBoxes])
+{
+	for (uint32_t c = 0; c < kMaxCullBoxes; ++c)
+		counts[c] = 0;
+
+	cascadeCount = std::min(cascadeCount, kMaxCullBoxes);
+	for (uint8_t mask : masks)
+	{
+		for (uint32_t c = 0; c < cascadeCount; ++c)
+			counts[c] += (mask >> c) & 1u;
+	}
+}
+
+//===============================================================================
+
+ShadowCascades::BenchmarkResult ShadowCascades::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	// Sponza's extents, and the single shadow camera RTUA renders it with
+	const float sceneMin[3] = { -1800.0f, -100.0f, -1100.0f };
+	const float sceneMax[3] = { 1800.0f, 1400.0f, 1100.0f };
+	const float fixedCenter[3] = { 0.0f, 0.0f, 0.0f };
+	const float fixedBounds[3] = { 5000.0f, 3000.0f, 3000.0f };
+	const float kPi = 3.14159265359f;
+
+	Settings settings;
+
+	CounterRNG::Stream random(desc.m_Seed);
+	CasterBounds casters;
+	for (uint32_t i = 0; i < desc.m_Casters; ++i)
+	{
+		float position[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			position[axis] = random.NextFloat(sceneMin[axis], sceneMax[axis]);
+		casters.Add(position[0], position[1], position[2], random.NextFloat(20.0f, 220.0f));
+	}
+
+	std::vector<uint8_t> masks, referenceMasks;
+	double simdSeconds = 0.0, referenceSeconds = 0.0;
+	uint64_t totals[kMaxCullBoxes] = {};
+	uint64_t anyCascade = 0;
+
+	for (uint32_t v = 0; v < desc.m_Views; ++v)
+	{
+		// A 16:9 camera at 45 degrees, looking roughly level from somewhere in the scene, with the sun from anywhere above the horizon
+		ViewDesc view;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			view.m_Position[axis] = random.NextFloat(sceneMin[axis], sceneMax[axis]);
+		const float yaw = random.NextFloat(2.0f * kPi);
+		const float pitch = random.NextFloat(-0.3f, 0.3f);
+		view.m_Forward[0] = std::cos(yaw) * std::cos(pitch);
+		view.m_Forward[1] = std::sin(pitch);
+		view.m_Forward[2] = std::sin(yaw) * std::cos(pitch);
+		view.m_TanHalfFovY = std::tan(kPi / 8.0f);
+		view.m_TanHalfFovX = view.m_TanHalfFovY * 16.0f / 9.0f;
+		view.m_Near = 1.0f;
+		view.m_Far = 10000.0f;
+
+		const float orientation = random.NextFloat(2.0f * kPi);
+		const float inclination = random.NextFloat(0.1f, 1.0f) * kPi * 0.5f;
+		const float lightDirection[3] = { -std::cos(orientation) * std::cos(inclination), -std::sin(inclination), -std::sin(orientation) * std::cos(inclination) };
+
+		Cascade boxes[kMaxCascades + 1];
+		const uint32_t cascadeCount = FitCascades(view, lightDirection, settings, boxes);
+		boxes[cascadeCount] = MakeFixedCascade(lightDirection, fixedCenter, fixedBounds, settings.m_BufferSize, settings.m_BufferPrecision);
+		const uint32_t boxCount = cascadeCount + 1;
+		result.m_Cascades = cascadeCount;
+
+		const LightBasis basis = MakeLightBasis(lightDirection);
+
+		auto start = std::chrono::steady_clock::now();
+		CullCasters(casters, basis, boxes, boxCount, masks);
+		simdSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		start = std::chrono::steady_clock::now();
+		CullCastersReference(casters, basis, boxes, boxCount, referenceMasks);
+		referenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Float and double can only disagree over a sphere that all but touches a box
+		for (uint32_t i = 0; i < casters.GetCount(); ++i)
+		{
+			const uint8_t differences = masks[i] ^ referenceMasks[i];
+			for (uint32_t c = 0; c < boxCount && differences != 0; ++c)
+			{
+				if (((differences >> c) & 1u) == 0)
+					continue;
+
+				double light[3];
+				ToLightSpace(basis, casters.m_X[i], casters.m_Y[i], casters.m_Z[i], light);
+				const double radiusSq = (double)casters.m_Radius[i] * casters.m_Radius[i];
+				if (std::fabs(Margin(light[0], light[1], light[2], casters.m_Radius[i], boxes[c])) > 1e-4 * std::max(radiusSq, 1.0))
+					result.m_bValid = false;
+			}
+		}
+
+		// Every corner of each slice has to be inside its cascade wherever UpdateMatrix snaps it, and the slices have to follow on from each other
+		float right[3];
+		const float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+		float forward[3] = { view.m_Forward[0], view.m_Forward[1], view.m_Forward[2] };
+		Normalize(forward);
+		Cross(forward, worldUp, right);
+		Normalize(right);
+		float up[3];
+		Cross(right, forward, up);
+
+		for (uint32_t c = 0; c < cascadeCount; ++c)
+		{
+			const Cascade& cascade = boxes[c];
+			result.m_bValid = result.m_bValid && cascade.m_SplitNear < cascade.m_SplitFar && (c == 0 || cascade.m_SplitNear == boxes[c - 1].m_SplitFar);
+
+			const float texel[3] = { cascade.m_Bounds[0] / settings.m_BufferSize, cascade.m_Bounds[1] / settings.m_BufferSize,
+				cascade.m_Bounds[2] / (float)((1u << settings.m_BufferPrecision) - 1) };
+			const float tolerance = cascade.m_Bounds[0] * 1e-5f;
+
+			for (uint32_t corner = 0; corner < 8; ++corner)
+			{
+				const float distance = (corner & 4) ? cascade.m_SplitFar : cascade.m_SplitNear;
+				const float sideX = ((corner & 1) ? 1.0f : -1.0f) * distance * view.m_TanHalfFovX;
+				const float sideY = ((corner & 2) ? 1.0f : -1.0f) * distance * view.m_TanHalfFovY;
+
+				float world[3], light[3];
+				for (uint32_t axis = 0; axis < 3; ++axis)
+					world[axis] = view.m_Position[axis] + forward[axis] * distance + right[axis] * sideX + up[axis] * sideY;
+				basis.ToLightSpace(world, light);
+
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					result.m_bValid = result.m_bValid && light[axis] >= cascade.m_CullMin[axis] + texel[axis] - tolerance &&
+						light[axis] <= cascade.m_CullMax[axis] + tolerance;
+				}
+			}
+		}
+
+		uint32_t counts[kMaxCullBoxes];
+		CountCasters(masks, boxCount, counts);
+		for (uint32_t c = 0; c < boxCount; ++c)
+			totals[c] += counts[c];
+
+		const uint8_t cascadeBits = (uint8_t)((1u << cascadeCount) - 1);
+		for (uint8_t mask : masks)
+			anyCascade += (mask & cascadeBits) != 0;
+	}
+
+	const double views = std::max(desc.m_Views, 1u);
+	for (uint32_t c = 0; c < result.m_Cascades; ++c)
+		result.m_AverageCasters[c] = totals[c] / views;
+	result.m_AverageFixed = totals[result.m_Cascades] / views;
+	result.m_AverageAnyCascade = anyCascade / views;
+	result.m_SimdUs = simdSeconds * 1e6 / views;
+	result.m_ReferenceUs = referenceSeconds * 1e6 / views;
+	return result;
+}
@@ -0,0 +1,454 @@
+//===============================================================================
+// desc: Generational handles over a fixed set of slots, for ParticleEffectManager. Any thread can reserve a slot and publish it without locking,
+//       and the owner drains everything published once a frame. Live slots are packed so removing one is a swap with the last, and a removed
+//       slot's generation moves on so old handles to it stop resolving, while the slot itself waits on a fence before it can be reused.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_SlotMap.h"
+#include "AZB_CounterRNG.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	constexpr uint32_t kNone = UINT32_MAX;
+	constexpr uint32_t kGenerationMask = (1u << SlotMap::kGenerationBits) - 1;
+
+	uint64_t MakeTagged(uint32_t slot, uint64_t previous)
+	{
+		return (((previous >> 32) + 1) << 32) | slot;
+	}
+}
+
+SlotMap::Map::Map(IFence& fence, uint32_t capacity) :
+	m_Fence(fence),
+	m_Capacity(std::max(std::min(capacity, kMaxSlots), 1u)),
+	m_Words(new std::atomic<uint32_t>[m_Capacity]),
+	m_NextFree(new std::atomic<uint32_t>[m_Capacity]),
+	m_NextPublished(new std::atomic<uint32_t>[m_Capacity]),
+	m_FreeHead(0),
+	m_PublishedHead(kNone),
+	m_Reserved(0),
+	m_Rejected(0)
+{
+	for (uint32_t slot = 0; slot < m_Capacity; ++slot)
+	{
+		m_Words[slot].store(MakeWord(0, kFree), std::memory_order_relaxed);
+		m_NextFree[slot].store(slot + 1 < m_Capacity ? slot + 1 : kNone, std::memory_order_relaxed);
+		m_NextPublished[slot].store(kNone, std::memory_order_relaxed);
+	}
+	m_LiveIndex.resize(m_Capacity, kNone);
+	m_Live.reserve(m_Capacity);
+}
+
+SlotMap::Handle SlotMap::Map::Reserve(void)
+{
+	uint32_t slot;
+	uint64_t head = m_FreeHead.load(std::memory_order_acquire);
+	for (;;)
+	{
+		slot = (uint32_t)head;
+		if (slot == kNone)
+		{
+			m_Rejected.fetch_add(1, std::memory_order_relaxed);
+			return kInvalidHandle;
+		}
+
+		// slot may be reserved and freed again by someone else while we read this, but then the tag will have moved on and the swap fails
+		const uint32_t next = m_NextFree[slot].load(std::memory_order_relaxed);
+		if (m_FreeHead.compare_exchange_weak(head, MakeTagged(next, head), std::memory_order_acquire, std::memory_order_acquire))
+			break;
+	}
+
+	const uint32_t generation = m_Words[slot].load(std::memory_order_relaxed) >> 2;
+	m_Words[slot].store(MakeWord(generation, kReserved), std::memory_order_release);
+	m_Reserved.fetch_add(1, std::memory_order_relaxed);
+	return (generation << kSlotBits) | slot;
+}
+
+void SlotMap::Map::Publish(Handle handle)
+{
+	assert(IsValid(handle));
+	const uint32_t slot = GetSlot(handle);
+
+	// Whatever the caller wrote into the slot's storage is released along with it
+	uint32_t head = m_PublishedHead.load(std::memory_order_relaxed);
+	do
+	{
+		m_NextPublished[slot].store(head, std::memory_order_relaxed);
+	} while (!m_PublishedHead.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void SlotMap::Map::PushFree(uint32_t slot)
+{
+	uint64_t head = m_FreeHead.load(std::memory_order_relaxed);
+	do
+	{
+		m_NextFree[slot].store((uint32_t)head, std::memory_order_relaxed);
+	} while (!m_FreeHead.compare_exchange_weak(head, MakeTagged(slot, head), std::memory_order_release, std::memory_order_relaxed));
+}
+
+void SlotMap::Map::Recycle(void)
+{
+	// One fence value covers a whole frame's worth of despawns, so only ask about each one once
+	uint64_t knownComplete = 0;
+	bool bKnown = false;
+	while (!m_Retired.empty())
+	{
+		const uint64_t fenceValue = m_Retired.front().first;
+		if (!bKnown || fenceValue != knownComplete)
+		{
+			if (!m_Fence.IsFenceComplete(fenceValue))
+				break;
+			knownComplete = fenceValue;
+			bKnown = true;
+		}
+
+		const uint32_t slot = m_Retired.front().second;
+		m_Retired.pop_front();
+		m_Words[slot].store(MakeWord(m_Words[slot].load(std::memory_order_relaxed) >> 2, kFree), std::memory_order_relaxed);
+		PushFree(slot);
+		++m_OwnerStats.m_Recycled;
+	}
+}
+
+void SlotMap::Map::Drain(std::vector<uint32_t>& drained)
+{
+	// Nothing is ever taken off the middle of the published list, only swapped out whole, so there's no ABA to worry about
+	uint32_t slot = m_PublishedHead.exchange(kNone, std::memory_order_acquire);
+
+	// Pushed newest first, so walk it into scratch and go live from the back
+	m_DrainScratch.clear();
+	for (; slot != kNone; slot = m_NextPublished[slot].load(std::memory_order_relaxed))
+		m_DrainScratch.push_back(slot);
+
+	for (auto it = m_DrainScratch.rbegin(); it != m_DrainScratch.rend(); ++it)
+	{
+		const uint32_t word = m_Words[*it].load(std::memory_order_relaxed);
+		assert((word & 3) == kReserved);
+		m_Words[*it].store(MakeWord(word >> 2, kLive), std::memory_order_release);
+		m_LiveIndex[*it] = (uint32_t)m_Live.size();
+		m_Live.push_back(*it);
+		drained.push_back(*it);
+	}
+
+	m_OwnerStats.m_Drained += m_DrainScratch.size();
+	m_OwnerStats.m_PeakLive = std::max(m_OwnerStats.m_PeakLive, (uint32_t)m_Live.size());
+}
+
+void SlotMap::Map::Despawn(uint32_t liveIndex, uint64_t fenceValue)
+{
+	assert(liveIndex < m_Live.size());
+	const uint32_t slot = m_Live[liveIndex];
+
+	// Generation first, so the handle is dead before anything else changes
+	const uint32_t generation = ((m_Words[slot].load(std::memory_order_relaxed) >> 2) + 1) & kGenerationMask;
+	m_Words[slot].store(MakeWord(generation, kRetired), std::memory_order_release);
+
+	const uint32_t last = m_Live.back();
+	m_Live[liveIndex] = last;
+	m_LiveIndex[last] = liveIndex;
+	m_Live.pop_back();
+	m_LiveIndex[slot] = kNone;
+
+	m_Retired.emplace_back(fenceValue, slot);
+	++m_OwnerStats.m_Despawned;
+}
+
+void SlotMap::Map::Clear(void)
+{
+	for (uint32_t slot = 0; slot < m_Capacity; ++slot)
+	{
+		const uint32_t word = m_Words[slot].load(std::memory_order_relaxed);
+		const uint32_t generation = (word & 3) == kFree ? (word >> 2) : ((word >> 2) + 1) & kGenerationMask;
+		m_Words[slot].store(MakeWord(generation, kFree), std::memory_order_relaxed);
+		m_NextFree[slot].store(slot + 1 < m_Capacity ? slot + 1 : kNone, std::memory_order_relaxed);
+		m_LiveIndex[slot] = kNone;
+	}
+
+	m_FreeHead.store(MakeTagged(0, m_FreeHead.load(std::memory_order_relaxed)), std::memory_order_release);
+	m_PublishedHead.store(kNone, std::memory_order_release);
+	m_Live.clear();
+	m_Retired.clear();
+}
+
+bool SlotMap::Map::IsValid(Handle handle) const
+{
+	const uint32_t slot = GetSlot(handle);
+	if (handle == kInvalidHandle || slot >= m_Capacity)
+		return false;
+
+	const uint32_t word = m_Words[slot].load(std::memory_order_acquire);
+	const uint32_t state = word & 3;
+	return (state == kReserved || state == kLive) && (word >> 2) == GetGeneration(handle);
+}
+
+uint32_t SlotMap::Map::FindLive(Handle handle) const
+{
+	const uint32_t slot = GetSlot(handle);
+	if (handle == kInvalidHandle || slot >= m_Capacity)
+		return kNone;
+
+	return m_Words[slot].load(std::memory_order_relaxed) == MakeWord(GetGeneration(handle), kLive) ? m_LiveIndex[slot] : kNone;
+}
+
+SlotMap::Handle SlotMap::Map::GetLiveHandle(uint32_t liveIndex) const
+{
+	const uint32_t slot = m_Live[liveIndex];
+	return ((m_Words[slot].load(std::memory_order_relaxed) >> 2) << kSlotBits) | slot;
+}
+
+SlotMap::Stats SlotMap::Map::GetStats(void) const
+{
+	Stats stats = m_OwnerStats;
+	stats.m_Reserved = m_Reserved.load(std::memory_order_relaxed);
+	stats.m_Rejected = m_Rejected.load(std::memory_order_relaxed);
+	return stats;
+}
+
+//===============================================================================
+
+namespace
+{
+	struct BenchmarkEffect
+	{
+		uint32_t m_Id = 0;					// Spawning thread in the top byte, its count below
+		uint32_t m_LifeFrames = 0;
+		SlotMap::Handle m_Handle = SlotMap::kInvalidHandle;
+		uint32_t m_BornFrame = kNone;		// Set by the frame loop when it first sees the effect
+		uint64_t m_RetiredFence = 0;
+		std::atomic<bool> m_bInUse{ false };
+	};
+
+	// Stands in for the GPU, which is done with a frame a fixed number of frames after it was submitted
+	class SimulatedFence : public SlotMap::IFence
+	{
+	public:
+		virtual bool IsFenceComplete(uint64_t fenceValue) override { return fenceValue <= m_Completed.load(std::memory_order_acquire); }
+		void SetCompleted(uint64_t fenceValue) { m_Completed.store(fenceValue, std::memory_order_release); }
+
+	private:
+		std::atomic<uint64_t> m_Completed{ 0 };
+	};
+
+	// Each thread spawns its share of the effects, no faster than the frame loop has got through its share of frames. spawn() takes an id and
+	// a lifetime and returns false if there was no room, in which case it's tried again later
+	template <typename SpawnFunc>
+	void RunSpawners(const SlotMap::BenchmarkDesc& desc, const std::atomic<uint32_t>& frame, std::atomic<uint32_t>& finished,
+		std::vector<std::thread>& threads, SpawnFunc spawn)
+	{
+		const uint64_t total = (uint64_t)desc.m_Frames * desc.m_SpawnsPerFrame;
+		for (uint32_t thread = 0; thread < desc.m_Threads; ++thread)
+		{
+			threads.emplace_back([&desc, &frame, &finished, total, thread, spawn]() mutable
+			{
+				CounterRNG::Stream random(desc.m_Seed, thread);
+				const uint64_t share = total / desc.m_Threads + (thread < total % desc.m_Threads ? 1 : 0);
+				for (uint64_t count = 0; count < share; )
+				{
+					const uint64_t allowed = std::min(share, ((uint64_t)frame.load(std::memory_order_acquire) + 1) * share / std::max(desc.m_Frames, 1u));
+					if (count >= allowed)
+					{
+						std::this_thread::yield();
+						continue;
+					}
+
+					const uint32_t id = (thread << 24) | (uint32_t)count;
+					const uint32_t life = (uint32_t)random.NextInt(1, (int32_t)std::max(desc.m_MaxLifeFrames, 1u));
+					if (spawn(id, life))
+						++count;
+					else
+						std::this_thread::yield();
+				}
+				finished.fetch_add(1, std::memory_order_release);
+			});
+		}
+	}
+
+	void RunSlotMap(const SlotMap::BenchmarkDesc& desc, SlotMap::BenchmarkResult& result)
+	{
+		SimulatedFence fence;
+		SlotMap::Map map(fence, desc.m_Capacity);
+		std::vector<BenchmarkEffect> effects(map.GetCapacity());
+
+		std::atomic<bool> bSpawnersValid(true);
+		std::atomic<uint32_t> frame(0);
+		std::atomic<uint32_t> finished(0);
+		std::vector<std::thread> threads;
+
+		std::chrono::steady_clock::duration checkTime(0);
+		const auto start = std::chrono::steady_clock::now();
+		RunSpawners(desc, frame, finished, threads, [&map, &effects, &fence, &bSpawnersValid](uint32_t id, uint32_t life)
+		{
+			const SlotMap::Handle handle = map.Reserve();
+			if (handle == SlotMap::kInvalidHandle)
+				return false;
+
+			// Never handed out twice, and never before the GPU is done with it
+			BenchmarkEffect& effect = effects[SlotMap::GetSlot(handle)];
+			bool bValid = map.IsValid(handle);
+			bValid &= !effect.m_bInUse.exchange(true, std::memory_order_acquire);
+			bValid &= fence.IsFenceComplete(effect.m_RetiredFence);
+			if (!bValid)
+				bSpawnersValid.store(false, std::memory_order_relaxed);
+
+			effect.m_Id = id;
+			effect.m_LifeFrames = life;
+			effect.m_Handle = handle;
+			effect.m_BornFrame = kNone;
+			map.Publish(handle);
+			return true;
+		});
+
+		bool bValid = true;
+		std::vector<uint32_t> drained;
+		std::deque<SlotMap::Handle> stale;
+		const size_t kMaxStale = 4096;
+		uint32_t f = 0;
+		for (;; ++f)
+		{
+			const bool bSpawnersDone = finished.load(std::memory_order_acquire) == desc.m_Threads;
+			const uint64_t fenceValue = (uint64_t)f + 1;
+			fence.SetCompleted(fenceValue > desc.m_FramesInFlight ? fenceValue - desc.m_FramesInFlight : 0);
+
+			map.Recycle();
+			drained.clear();
+			map.Drain(drained);
+			for (uint32_t slot : drained)
+			{
+				BenchmarkEffect& effect = effects[slot];
+				bValid &= SlotMap::GetSlot(effect.m_Handle) == slot && map.FindLive(effect.m_Handle) != kNone;
+				effect.m_BornFrame = f;
+			}
+
+			// Expire, keeping the same index when the last effect is swapped into it
+			for (uint32_t i = 0; i < map.GetLiveCount(); )
+			{
+				BenchmarkEffect& effect = effects[map.GetLiveSlot(i)];
+				if (f - effect.m_BornFrame < effect.m_LifeFrames)
+				{
+					++i;
+					continue;
+				}
+
+				bValid &= map.FindLive(effect.m_Handle) == i;
+				stale.push_back(effect.m_Handle);
+				effect.m_RetiredFence = fenceValue;
+				effect.m_bInUse.store(false, std::memory_order_release);
+				map.Despawn(i, fenceValue);
+			}
+			while (stale.size() > kMaxStale)
+				stale.pop_front();
+
+			// Every handle still out there finds its own effect, and none of the old ones find anything. Not part of the time
+			const auto checkStart = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < map.GetLiveCount(); ++i)
+			{
+				const SlotMap::Handle handle = map.GetLiveHandle(i);
+				bValid &= handle == effects[map.GetLiveSlot(i)].m_Handle && map.FindLive(handle) == i;
+			}
+			for (SlotMap::Handle handle : stale)
+				bValid &= !map.IsValid(handle) && map.FindLive(handle) == kNone;
+			result.m_StaleChecks += stale.size();
+			checkTime += std::chrono::steady_clock::now() - checkStart;
+
+			frame.store(f + 1, std::memory_order_release);
+			if (bSpawnersDone && f >= desc.m_Frames && map.GetLiveCount() == 0)
+				break;
+			std::this_thread::yield();
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		result.m_SlotMapMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start - checkTime).count();
+
+		result.m_FramesRun = f + 1;
+		result.m_Stats = map.GetStats();
+		const uint64_t total = (uint64_t)desc.m_Frames * desc.m_SpawnsPerFrame;
+		bValid &= result.m_Stats.m_Reserved == total && result.m_Stats.m_Drained == total && result.m_Stats.m_Despawned == total;
+		result.m_SpawnsPerSecond = total / std::max(result.m_SlotMapMs * 1e-3, 1e-9);
+		result.m_bValid = bValid && bSpawnersValid.load();
+	}
+
+	// How ParticleEffectManager used to do it - a new effect for every spawn under a lock, addressed by where it sits in the active list, which
+	// is erased from in place and skips whatever was moved into the gap
+	void RunVector(const SlotMap::BenchmarkDesc& desc, SlotMap::BenchmarkResult& result)
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<BenchmarkEffect>> pool;
+		std::vector<BenchmarkEffect*> active;
+
+		std::atomic<uint32_t> frame(0);
+		std::atomic<uint32_t> finished(0);
+		std::vector<std::thread> threads;
+
+		std::chrono::steady_clock::duration checkTime(0);
+		const auto start = std::chrono::steady_clock::now();
+		RunSpawners(desc, frame, finished, threads, [&mutex, &pool, &active](uint32_t id, uint32_t life)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			BenchmarkEffect* effect = new BenchmarkEffect;
+			effect->m_Id = id;
+			effect->m_LifeFrames = life;
+			pool.emplace_back(effect);
+			active.push_back(effect);
+			effect->m_Handle = (SlotMap::Handle)active.size() - 1;
+			return true;
+		});
+
+		uint32_t f = 0;
+		for (;; ++f)
+		{
+			const bool bSpawnersDone = finished.load(std::memory_order_acquire) == desc.m_Threads;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (uint32_t i = 0; i < active.size(); ++i)
+				{
+					BenchmarkEffect* effect = active[i];
+					if (effect->m_BornFrame == kNone)
+						effect->m_BornFrame = f;
+					if (f - effect->m_BornFrame >= effect->m_LifeFrames)
+						active.erase(active.begin() + i);
+				}
+
+				const auto checkStart = std::chrono::steady_clock::now();
+				for (BenchmarkEffect* effect : active)
+				{
+					if (effect->m_Handle >= active.size() || active[effect->m_Handle] != effect)
+						++result.m_VectorMisdirected;
+				}
+				checkTime += std::chrono::steady_clock::now() - checkStart;
+			}
+
+			frame.store(f + 1, std::memory_order_release);
+			bool bEmpty;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				bEmpty = active.empty();
+			}
+			if (bSpawnersDone && f >= desc.m_Frames && bEmpty)
+				break;
+			std::this_thread::yield();
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		result.m_VectorMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start - checkTime).count();
+	}
+}
+
+SlotMap::BenchmarkResult SlotMap::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+	if (desc.m_Threads == 0 || desc.m_Threads > 255)
+	{
+		result.m_bValid = false;
+		return result;
+	}
+
+	RunSlotMap(desc, result);
+	RunVector(desc, result);
+	return result;
+}
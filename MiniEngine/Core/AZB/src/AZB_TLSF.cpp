@@ -0,0 +1,753 @@
+//===============================================================================
+// desc: A two-level segregated fit (TLSF) sub-allocator for carving arbitrarily sized, long-lived buffers (vertex/index data, constants) out of one
+//       large heap, without the power-of-two rounding and 64KB floor of BuddyAllocator. Allocation and freeing are O(1), and it can plan moves that
+//       compact the heap. It only deals in offsets - what they're offsets into is up to the caller - so there are no D3D types here.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TLSF.h"
+#include "AZB_BuddyBitmap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	uint32_t LowestSetBit(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctzll(value);
+#endif
+	}
+
+	uint32_t HighestSetBit(uint64_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return (uint32_t)index;
+#else
+		return 63u - (uint32_t)__builtin_clzll(value);
+#endif
+	}
+
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	FILE* OpenFile(const std::wstring& fileName, bool bWrite)
+	{
+#if defined(_WIN32)
+		FILE* file = nullptr;
+		return _wfopen_s(&file, fileName.c_str(), bWrite ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+		return std::fopen(std::string(fileName.begin(), fileName.end()).c_str(), bWrite ? "wb" : "rb");
+#endif
+	}
+}
+
+//===============================================================================
+
+TLSF::Allocator::Allocator(uint64_t heapBytes, uint32_t granularity)
+{
+	m_GranularityLog2 = LowestSetBit(std::max(granularity, 1u));
+	m_HeapBytes = heapBytes & ~((1ull << m_GranularityLog2) - 1);
+
+	// Enough records for a decent number of allocations before the vector ever has to grow
+	m_Blocks.reserve(1024);
+	m_Handles.reserve(512);
+	Reset();
+}
+
+void TLSF::Allocator::Reset(void)
+{
+	m_Blocks.clear();
+	m_Handles.clear();
+	m_UnusedBlocks = kNone;
+	m_UnusedHandles = kNone;
+
+	m_FirstLevelMap = 0;
+	std::fill(std::begin(m_SecondLevelMap), std::end(m_SecondLevelMap), 0u);
+	std::fill(&m_FreeHeads[0][0], &m_FreeHeads[0][0] + kFirstLevelCount * kSecondLevelCount, kNone);
+	m_FreeBlockCount = 0;
+	m_UsedBytes = 0;
+	m_Allocations = 0;
+
+	if (m_HeapBytes == 0)
+		return;
+
+	const uint32_t block = NewBlock();
+	m_Blocks[block].m_Offset = 0;
+	m_Blocks[block].m_Size = m_HeapBytes;
+	InsertFree(block);
+}
+
+void TLSF::Allocator::Mapping(uint64_t units, uint32_t& firstLevel, uint32_t& secondLevel) const
+{
+	// Small blocks get a class each. Above that, the first level is the power of two and the second the next five bits down
+	if (units < kSecondLevelCount)
+	{
+		firstLevel = 0;
+		secondLevel = (uint32_t)units;
+	}
+	else
+	{
+		const uint32_t highBit = HighestSetBit(units);
+		firstLevel = highBit - kSecondLevelLog2 + 1;
+		secondLevel = (uint32_t)(units >> (highBit - kSecondLevelLog2)) - kSecondLevelCount;
+	}
+}
+
+uint32_t TLSF::Allocator::FindFreeBlock(uint64_t units) const
+{
+	// Round up to the next class boundary, so anything in the class found is big enough without searching the list
+	if (units >= kSecondLevelCount)
+		units += (1ull << (HighestSetBit(units) - kSecondLevelLog2)) - 1;
+
+	uint32_t firstLevel, secondLevel;
+	Mapping(units, firstLevel, secondLevel);
+	if (firstLevel >= kFirstLevelCount)
+		return kNone;
+
+	uint32_t secondLevelMap = m_SecondLevelMap[firstLevel] & (~0u << secondLevel);
+	if (secondLevelMap == 0)
+	{
+		// Nothing in this power of two, so take the smallest class of any larger one
+		const uint64_t firstLevelMap = firstLevel + 1 < 64 ? m_FirstLevelMap & (~0ull << (firstLevel + 1)) : 0;
+		if (firstLevelMap == 0)
+			return kNone;
+
+		firstLevel = LowestSetBit(firstLevelMap);
+		secondLevelMap = m_SecondLevelMap[firstLevel];
+	}
+
+	return m_FreeHeads[firstLevel][LowestSetBit(secondLevelMap)];
+}
+
+void TLSF::Allocator::InsertFree(uint32_t block)
+{
+	uint32_t firstLevel, secondLevel;
+	Mapping(m_Blocks[block].m_Size >> m_GranularityLog2, firstLevel, secondLevel);
+
+	const uint32_t head = m_FreeHeads[firstLevel][secondLevel];
+	m_Blocks[block].m_Handle = kNone;
+	m_Blocks[block].m_PrevFree = kNone;
+	m_Blocks[block].m_NextFree = head;
+	if (head != kNone)
+		m_Blocks[head].m_PrevFree = block;
+
+	m_FreeHeads[firstLevel][secondLevel] = block;
+	m_SecondLevelMap[firstLevel] |= 1u << secondLevel;
+	m_FirstLevelMap |= 1ull << firstLevel;
+	++m_FreeBlockCount;
+}
+
+void TLSF::Allocator::RemoveFree(uint32_t block)
+{
+	uint32_t firstLevel, secondLevel;
+	Mapping(m_Blocks[block].m_Size >> m_GranularityLog2, firstLevel, secondLevel);
+
+	const uint32_t prev = m_Blocks[block].m_PrevFree;
+	const uint32_t next = m_Blocks[block].m_NextFree;
+	if (prev != kNone)
+		m_Blocks[prev].m_NextFree = next;
+	if (next != kNone)
+		m_Blocks[next].m_PrevFree = prev;
+
+	if (m_FreeHeads[firstLevel][secondLevel] == block)
+	{
+		m_FreeHeads[firstLevel][secondLevel] = next;
+		if (next == kNone)
+		{
+			m_SecondLevelMap[firstLevel] &= ~(1u << secondLevel);
+			if (m_SecondLevelMap[firstLevel] == 0)
+				m_FirstLevelMap &= ~(1ull << firstLevel);
+		}
+	}
+	--m_FreeBlockCount;
+}
+
+uint32_t TLSF::Allocator::NewBlock(void)
+{
+	uint32_t block = m_UnusedBlocks;
+	if (block != kNone)
+		m_UnusedBlocks = m_Blocks[block].m_NextFree;
+	else
+	{
+		block = (uint32_t)m_Blocks.size();
+		m_Blocks.emplace_back();
+	}
+
+	Block& record = m_Blocks[block];
+	record.m_PrevPhysical = kNone;
+	record.m_NextPhysical = kNone;
+	record.m_PrevFree = kNone;
+	record.m_NextFree = kNone;
+	record.m_Handle = kNone;
+	record.m_AlignmentLog2 = 0;
+	return block;
+}
+
+void TLSF::Allocator::ReleaseBlock(uint32_t block)
+{
+	m_Blocks[block].m_Handle = kNone;
+	m_Blocks[block].m_Size = 0;
+	m_Blocks[block].m_NextFree = m_UnusedBlocks;
+	m_UnusedBlocks = block;
+}
+
+uint32_t TLSF::Allocator::SplitFront(uint32_t block, uint64_t size)
+{
+	// NewBlock() can grow m_Blocks, so no references held across it
+	const uint32_t front = NewBlock();
+	const uint32_t prev = m_Blocks[block].m_PrevPhysical;
+
+	m_Blocks[front].m_Offset = m_Blocks[block].m_Offset;
+	m_Blocks[front].m_Size = size;
+	m_Blocks[front].m_PrevPhysical = prev;
+	m_Blocks[front].m_NextPhysical = block;
+	if (prev != kNone)
+		m_Blocks[prev].m_NextPhysical = front;
+
+	m_Blocks[block].m_PrevPhysical = front;
+	m_Blocks[block].m_Offset += size;
+	m_Blocks[block].m_Size -= size;
+	return front;
+}
+
+void TLSF::Allocator::FreeBlock(uint32_t block)
+{
+	// Free neighbours are merged in, so a free block never sits next to another
+	const uint32_t prev = m_Blocks[block].m_PrevPhysical;
+	if (prev != kNone && m_Blocks[prev].m_Handle == kNone)
+	{
+		RemoveFree(prev);
+		m_Blocks[block].m_Offset = m_Blocks[prev].m_Offset;
+		m_Blocks[block].m_Size += m_Blocks[prev].m_Size;
+		m_Blocks[block].m_PrevPhysical = m_Blocks[prev].m_PrevPhysical;
+		if (m_Blocks[block].m_PrevPhysical != kNone)
+			m_Blocks[m_Blocks[block].m_PrevPhysical].m_NextPhysical = block;
+		ReleaseBlock(prev);
+	}
+
+	const uint32_t next = m_Blocks[block].m_NextPhysical;
+	if (next != kNone && m_Blocks[next].m_Handle == kNone)
+	{
+		RemoveFree(next);
+		m_Blocks[block].m_Size += m_Blocks[next].m_Size;
+		m_Blocks[block].m_NextPhysical = m_Blocks[next].m_NextPhysical;
+		if (m_Blocks[block].m_NextPhysical != kNone)
+			m_Blocks[m_Blocks[block].m_NextPhysical].m_PrevPhysical = block;
+		ReleaseBlock(next);
+	}
+
+	InsertFree(block);
+}
+
+uint32_t TLSF::Allocator::NewHandle(uint32_t block)
+{
+	uint32_t handle = m_UnusedHandles;
+	if (handle != kNone)
+	{
+		m_UnusedHandles = m_Handles[handle];
+		m_Handles[handle] = block;
+	}
+	else
+	{
+		handle = (uint32_t)m_Handles.size();
+		m_Handles.push_back(block);
+	}
+
+	m_Blocks[block].m_Handle = handle;
+	return handle;
+}
+
+uint32_t TLSF::Allocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	const uint64_t granularity = 1ull << m_GranularityLog2;
+	size = AlignUp(std::max(size, (uint64_t)1), granularity);
+	alignment = std::max(alignment, granularity);
+
+	// Looking for enough to align the start within the block as well. Everything's a multiple of the granularity, so that much is always aligned
+	const uint64_t searchSize = size + alignment - granularity;
+	if (searchSize > m_HeapBytes)
+		return kInvalidAllocation;
+
+	uint32_t block = FindFreeBlock(searchSize >> m_GranularityLog2);
+	if (block == kNone)
+		return kInvalidAllocation;
+	RemoveFree(block);
+
+	// Padding to the alignment goes back as a free block of its own. What's before it is never free, so there's nothing to merge with
+	const uint64_t padding = AlignUp(m_Blocks[block].m_Offset, alignment) - m_Blocks[block].m_Offset;
+	if (padding > 0)
+		InsertFree(SplitFront(block, padding));
+
+	// Same for whatever's left over at the end
+	if (m_Blocks[block].m_Size > size)
+	{
+		const uint32_t allocated = SplitFront(block, size);
+		InsertFree(block);
+		block = allocated;
+	}
+
+	m_Blocks[block].m_AlignmentLog2 = LowestSetBit(alignment);
+	m_UsedBytes += size;
+	++m_Allocations;
+	return NewHandle(block);
+}
+
+void TLSF::Allocator::Free(uint32_t allocation)
+{
+	if (allocation == kInvalidAllocation)
+		return;
+
+	const uint32_t block = m_Handles[allocation];
+	m_UsedBytes -= m_Blocks[block].m_Size;
+	--m_Allocations;
+	FreeBlock(block);
+
+	m_Handles[allocation] = m_UnusedHandles;
+	m_UnusedHandles = allocation;
+}
+
+TLSF::Stats TLSF::Allocator::GetStats(void) const
+{
+	Stats stats;
+	stats.m_HeapBytes = m_HeapBytes;
+	stats.m_UsedBytes = m_UsedBytes;
+	stats.m_FreeBytes = m_HeapBytes - m_UsedBytes;
+	stats.m_Allocations = m_Allocations;
+	stats.m_FreeBlocks = m_FreeBlockCount;
+
+	// The largest block is somewhere in the highest non-empty class
+	if (m_FirstLevelMap != 0)
+	{
+		const uint32_t firstLevel = HighestSetBit(m_FirstLevelMap);
+		const uint32_t secondLevel = HighestSetBit(m_SecondLevelMap[firstLevel]);
+		for (uint32_t block = m_FreeHeads[firstLevel][secondLevel]; block != kNone; block = m_Blocks[block].m_NextFree)
+			stats.m_LargestFreeBlock = std::max(stats.m_LargestFreeBlock, m_Blocks[block].m_Size);
+	}
+	return stats;
+}
+
+uint32_t TLSF::Allocator::Defragment(std::vector<Move>& moves, const DefragmentDesc& desc)
+{
+	// Highest offset first, so each move has the best chance of landing below where it started
+	std::vector<uint32_t> allocations;
+	allocations.reserve(m_Allocations);
+	for (const Block& block : m_Blocks)
+	{
+		if (block.m_Handle != kNone)
+			allocations.push_back(block.m_Handle);
+	}
+	std::sort(allocations.begin(), allocations.end(), [this](uint32_t a, uint32_t b) { return GetOffset(a) > GetOffset(b); });
+
+	uint32_t moved = 0;
+	uint64_t movedBytes = 0;
+	for (const uint32_t allocation : allocations)
+	{
+		const uint32_t block = m_Handles[allocation];
+		const uint64_t size = m_Blocks[block].m_Size;
+		const uint64_t offset = m_Blocks[block].m_Offset;
+		if (moved >= desc.m_MaxMoves)
+			break;
+		if (movedBytes + size > desc.m_MaxBytes)
+			continue;
+
+		// Allocate the new home before letting go of the old one, so the copy never overlaps itself
+		const uint32_t target = Allocate(size, 1ull << m_Blocks[block].m_AlignmentLog2);
+		if (target == kInvalidAllocation)
+			continue;
+
+		if (GetOffset(target) >= offset)
+		{
+			Free(target);
+			continue;
+		}
+
+		// Swap which block each handle points at, then free what is now the old location
+		const uint32_t targetBlock = m_Handles[target];
+		m_Handles[allocation] = targetBlock;
+		m_Blocks[targetBlock].m_Handle = allocation;
+		m_Handles[target] = block;
+		m_Blocks[block].m_Handle = target;
+
+		moves.push_back({ allocation, offset, m_Blocks[targetBlock].m_Offset, size });
+		Free(target);
+
+		++moved;
+		movedBytes += size;
+	}
+	return moved;
+}
+
+//===============================================================================
+
+namespace
+{
+	std::mutex s_TraceMutex;
+	std::vector<TLSF::TraceEvent> s_TraceEvents;
+	std::atomic<bool> s_bTracing(false);
+	uint32_t s_NextTraceId = 0;
+
+	constexpr char kTraceMagic[4] = { 'A', 'Z', 'B', 'A' };
+	constexpr uint32_t kTraceVersion = 1;
+
+	static_assert(sizeof(TLSF::TraceEvent) == 16, "Trace events are written to disk as they are");
+}
+
+void TLSF::StartTrace(void)
+{
+	std::lock_guard<std::mutex> lock(s_TraceMutex);
+	s_TraceEvents.clear();
+	s_NextTraceId = 0;
+	s_bTracing.store(true, std::memory_order_relaxed);
+}
+
+bool TLSF::IsTracing(void)
+{
+	return s_bTracing.load(std::memory_order_relaxed);
+}
+
+uint32_t TLSF::TraceAllocate(uint64_t size, uint64_t alignment)
+{
+	if (!IsTracing())
+		return 0;
+
+	std::lock_guard<std::mutex> lock(s_TraceMutex);
+	const uint32_t id = ++s_NextTraceId;
+	s_TraceEvents.push_back({ size, id, (uint16_t)(alignment ? LowestSetBit(alignment) : 0), TRACE_ALLOCATE });
+	return id;
+}
+
+void TLSF::TraceFree(uint32_t id)
+{
+	if (id == 0 || !IsTracing())
+		return;
+
+	std::lock_guard<std::mutex> lock(s_TraceMutex);
+	s_TraceEvents.push_back({ 0, id, 0, TRACE_FREE });
+}
+
+bool TLSF::StopTrace(const std::wstring& fileName)
+{
+	std::vector<TraceEvent> events;
+	{
+		std::lock_guard<std::mutex> lock(s_TraceMutex);
+		s_bTracing.store(false, std::memory_order_relaxed);
+		events.swap(s_TraceEvents);
+	}
+
+	FILE* file = OpenFile(fileName, true);
+	if (!file)
+		return false;
+
+	const uint32_t count = (uint32_t)events.size();
+	bool bSuccess = fwrite(kTraceMagic, sizeof(kTraceMagic), 1, file) == 1 && fwrite(&kTraceVersion, sizeof(kTraceVersion), 1, file) == 1 &&
+		fwrite(&count, sizeof(count), 1, file) == 1;
+	if (bSuccess && count > 0)
+		bSuccess = fwrite(events.data(), sizeof(TraceEvent), count, file) == count;
+	return fclose(file) == 0 && bSuccess;
+}
+
+bool TLSF::LoadTrace(const std::wstring& fileName, std::vector<TraceEvent>& events)
+{
+	events.clear();
+	FILE* file = OpenFile(fileName, false);
+	if (!file)
+		return false;
+
+	char magic[4];
+	uint32_t version = 0, count = 0;
+	bool bSuccess = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, kTraceMagic, sizeof(magic)) == 0 &&
+		fread(&version, sizeof(version), 1, file) == 1 && version == kTraceVersion && fread(&count, sizeof(count), 1, file) == 1;
+	if (bSuccess)
+	{
+		events.resize(count);
+		bSuccess = count == 0 || fread(events.data(), sizeof(TraceEvent), count, file) == count;
+	}
+	fclose(file);
+
+	if (!bSuccess)
+		events.clear();
+	return bSuccess;
+}
+
+void TLSF::GenerateSyntheticTrace(std::vector<TraceEvent>& events, uint32_t models, uint32_t seed)
+{
+	constexpr uint32_t kMaxLiveModels = 8;
+
+	events.clear();
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::vector<std::vector<uint32_t>> live;
+	uint32_t nextId = 0;
+
+	auto allocate = [&](std::vector<uint32_t>& model, uint64_t size, uint16_t alignmentLog2)
+	{
+		events.push_back({ size, ++nextId, alignmentLog2, TRACE_ALLOCATE });
+		model.push_back(nextId);
+	};
+
+	for (uint32_t i = 0; i < models; ++i)
+	{
+		// Unload something at random, or to make room
+		if (!live.empty() && (live.size() >= kMaxLiveModels || unit(random) < 0.35f))
+		{
+			const size_t victim = random() % live.size();
+			for (const uint32_t id : live[victim])
+				events.push_back({ 0, id, 0, TRACE_FREE });
+			live[victim].swap(live.back());
+			live.pop_back();
+		}
+
+		// Laid out the way LoadModel records it: per mesh vertex, depth-only vertex and index data, then the material constants
+		live.emplace_back();
+		const uint32_t meshes = 1 + random() % 48;
+		for (uint32_t mesh = 0; mesh < meshes; ++mesh)
+		{
+			const uint64_t vertices = (uint64_t)(64.f * powf(2048.f, unit(random)));
+			const uint64_t indices = vertices * (3 + random() % 4) / 2;
+			allocate(live.back(), vertices * 32, 4);
+			allocate(live.back(), vertices * 12, 4);
+			allocate(live.back(), indices * (vertices > 0xFFFF ? 4 : 2), 4);
+		}
+		allocate(live.back(), (1 + random() % 16) * 256, 8);
+	}
+}
+
+namespace
+{
+	// The trace with ids swapped for dense slots, so replaying it is just indexing
+	struct Operation
+	{
+		uint64_t m_Size;
+		uint32_t m_Slot;
+		uint16_t m_AlignmentLog2;
+		bool m_bAllocate;
+	};
+
+	struct BuddyReplay
+	{
+		Buddy::BitmapAllocator m_Allocator;
+		uint32_t m_MinBlockLog2;
+
+		BuddyReplay(uint64_t heapBytes, uint32_t minBlock) :
+			m_Allocator(HighestSetBit(std::max(heapBytes / std::max(minBlock, 1u), (uint64_t)1))), m_MinBlockLog2(LowestSetBit(std::max(minBlock, 1u))) {}
+
+		// Same rounding as BuddyAllocator - up to whole minimum blocks, then up to a power of two of them
+		uint32_t GetOrder(uint64_t size) const
+		{
+			const uint64_t units = std::max((size + ((uint64_t)1 << m_MinBlockLog2) - 1) >> m_MinBlockLog2, (uint64_t)1);
+			return HighestSetBit(units) + ((units & (units - 1)) ? 1 : 0);
+		}
+	};
+}
+
+TLSF::BenchmarkResult TLSF::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	std::vector<TraceEvent> events;
+	if (desc.m_TraceFile.empty() || !LoadTrace(desc.m_TraceFile, events) || events.empty())
+	{
+		GenerateSyntheticTrace(events, desc.m_SyntheticModels, desc.m_Seed);
+		result.m_bSynthetic = true;
+	}
+	result.m_Events = (uint32_t)events.size();
+
+	// Frees without a matching allocation (e.g. a trace stopped and started mid-session) are dropped
+	std::vector<Operation> operations;
+	operations.reserve(events.size());
+	std::unordered_map<uint32_t, uint32_t> slots;
+	uint32_t slotCount = 0;
+	for (const TraceEvent& event : events)
+	{
+		if (event.m_Type == TRACE_ALLOCATE)
+		{
+			slots[event.m_Id] = slotCount;
+			operations.push_back({ event.m_Size, slotCount++, event.m_AlignmentLog2, true });
+		}
+		else
+		{
+			auto it = slots.find(event.m_Id);
+			if (it == slots.end())
+				continue;
+			operations.push_back({ 0, it->second, 0, false });
+			slots.erase(it);
+		}
+	}
+
+	// First an untimed pass through each, for how much space they use and where TLSF is most fragmented
+	size_t worstOperation = operations.size();
+	{
+		Allocator tlsf(desc.m_HeapBytes, desc.m_Granularity);
+		BuddyReplay buddy(desc.m_HeapBytes, desc.m_BuddyMinBlock);
+		std::vector<uint32_t> tlsfHandles(slotCount, kInvalidAllocation);
+		std::vector<size_t> buddyOffsets(slotCount, Buddy::kInvalidOffset);
+		std::vector<uint64_t> sizes(slotCount, 0);
+
+		uint64_t requested = 0;
+		uint64_t buddyUsed = 0;
+		for (size_t i = 0; i < operations.size(); ++i)
+		{
+			const Operation& operation = operations[i];
+			if (operation.m_bAllocate)
+			{
+				const uint32_t order = buddy.GetOrder(operation.m_Size);
+				sizes[operation.m_Slot] = operation.m_Size;
+				requested += operation.m_Size;
+
+				tlsfHandles[operation.m_Slot] = tlsf.Allocate(operation.m_Size, 1ull << operation.m_AlignmentLog2);
+				result.m_TlsfFailures += tlsfHandles[operation.m_Slot] == kInvalidAllocation;
+
+				buddyOffsets[operation.m_Slot] = buddy.m_Allocator.Allocate(order);
+				if (buddyOffsets[operation.m_Slot] == Buddy::kInvalidOffset)
+					++result.m_BuddyFailures;
+				else
+					buddyUsed += 1ull << (order + buddy.m_MinBlockLog2);
+
+				if (requested > result.m_PeakRequestedBytes)
+				{
+					result.m_PeakRequestedBytes = requested;
+					result.m_TlsfPeakUsedBytes = tlsf.GetStats().m_UsedBytes;
+					result.m_BuddyPeakUsedBytes = buddyUsed;
+				}
+			}
+			else
+			{
+				const uint32_t sizeOrder = buddy.GetOrder(sizes[operation.m_Slot]);
+				requested -= sizes[operation.m_Slot];
+
+				tlsf.Free(tlsfHandles[operation.m_Slot]);
+				tlsfHandles[operation.m_Slot] = kInvalidAllocation;
+
+				if (buddyOffsets[operation.m_Slot] != Buddy::kInvalidOffset)
+				{
+					buddy.m_Allocator.Free(buddyOffsets[operation.m_Slot], sizeOrder);
+					buddyUsed -= 1ull << (sizeOrder + buddy.m_MinBlockLog2);
+				}
+				buddyOffsets[operation.m_Slot] = Buddy::kInvalidOffset;
+			}
+
+			const float fragmentation = tlsf.GetStats().GetFragmentation();
+			if (fragmentation > result.m_WorstFragmentation)
+			{
+				result.m_WorstFragmentation = fragmentation;
+				worstOperation = i;
+			}
+		}
+	}
+
+	// Then replay up to that worst point again and see what defragmenting does for it
+	if (worstOperation < operations.size())
+	{
+		Allocator tlsf(desc.m_HeapBytes, desc.m_Granularity);
+		std::vector<uint32_t> handles(slotCount, kInvalidAllocation);
+		for (size_t i = 0; i <= worstOperation; ++i)
+		{
+			const Operation& operation = operations[i];
+			if (operation.m_bAllocate)
+				handles[operation.m_Slot] = tlsf.Allocate(operation.m_Size, 1ull << operation.m_AlignmentLog2);
+			else
+				tlsf.Free(handles[operation.m_Slot]);
+		}
+
+		std::vector<Move> moves;
+		result.m_DefragmentMoves = tlsf.Defragment(moves);
+		for (const Move& move : moves)
+			result.m_DefragmentBytes += move.m_Size;
+		result.m_DefragmentedFragmentation = tlsf.GetStats().GetFragmentation();
+	}
+
+	// Timed passes. Whatever the trace leaves allocated is freed at the end of each, and counted
+	const uint32_t iterations = std::max(desc.m_Iterations, 1u);
+	{
+		Allocator tlsf(desc.m_HeapBytes, desc.m_Granularity);
+		std::vector<uint32_t> handles(slotCount, kInvalidAllocation);
+		uint64_t count = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			for (const Operation& operation : operations)
+			{
+				if (operation.m_bAllocate)
+					handles[operation.m_Slot] = tlsf.Allocate(operation.m_Size, 1ull << operation.m_AlignmentLog2);
+				else
+				{
+					tlsf.Free(handles[operation.m_Slot]);
+					handles[operation.m_Slot] = kInvalidAllocation;
+				}
+			}
+			count += operations.size();
+
+			for (uint32_t& handle : handles)
+			{
+				if (handle != kInvalidAllocation)
+				{
+					tlsf.Free(handle);
+					handle = kInvalidAllocation;
+					++count;
+				}
+			}
+		}
+		const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		result.m_TlsfNsPerOp = elapsed / std::max((double)count, 1.0);
+	}
+	{
+		BuddyReplay buddy(desc.m_HeapBytes, desc.m_BuddyMinBlock);
+		std::vector<size_t> offsets(slotCount, Buddy::kInvalidOffset);
+		std::vector<uint32_t> orders(slotCount, 0);
+		uint64_t count = 0;
+
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t iteration = 0; iteration < iterations; ++iteration)
+		{
+			for (const Operation& operation : operations)
+			{
+				if (operation.m_bAllocate)
+				{
+					orders[operation.m_Slot] = buddy.GetOrder(operation.m_Size);
+					offsets[operation.m_Slot] = buddy.m_Allocator.Allocate(orders[operation.m_Slot]);
+				}
+				else if (offsets[operation.m_Slot] != Buddy::kInvalidOffset)
+				{
+					buddy.m_Allocator.Free(offsets[operation.m_Slot], orders[operation.m_Slot]);
+					offsets[operation.m_Slot] = Buddy::kInvalidOffset;
+				}
+			}
+			count += operations.size();
+
+			for (size_t slot = 0; slot < offsets.size(); ++slot)
+			{
+				if (offsets[slot] != Buddy::kInvalidOffset)
+				{
+					buddy.m_Allocator.Free(offsets[slot], orders[slot]);
+					offsets[slot] = Buddy::kInvalidOffset;
+					++count;
+				}
+			}
+		}
+		const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		result.m_BuddyNsPerOp = elapsed / std::max((double)count, 1.0);
+	}
+
+	return result;
+}
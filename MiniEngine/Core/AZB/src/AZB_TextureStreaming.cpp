@@ -0,0 +1,460 @@
+//===============================================================================
+// desc: Mip-level texture streaming policy. Textures start with only their coarse mips resident, the renderer reports which mip each one actually needs
+//       (from its on-screen size and the current LOD bias), and the residency manager decides what to stream in or out each frame under a memory budget.
+//       Nothing in here touches the GPU - the texture manager carries out the requests - so the policy can be driven and checked headless.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TextureStreaming.h"
+#include "AZB_CounterRNG.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+//===============================================================================
+
+float TextureStreaming::EstimateMip(uint32_t width, uint32_t height, float screenPixels, float lodBias)
+{
+	// Camera inside the bounds, or something equally huge on screen - wants everything
+	if (!(screenPixels > 0.f) || std::isinf(screenPixels))
+		return 0.f;
+
+	// Assumes the texture is stretched once across the object, so one texel per pixel is mip 0 at full width
+	const float texels = (float)std::max(std::max(width, height), 1u);
+	return std::max(std::log2(texels / screenPixels) + lodBias, 0.f);
+}
+
+//===============================================================================
+
+TextureStreaming::ResidencyManager::ResidencyManager(uint64_t budgetBytes) : m_BudgetBytes(budgetBytes)
+{
+}
+
+uint32_t TextureStreaming::ResidencyManager::Register(const TextureDesc& desc, uint32_t residentMip)
+{
+	uint32_t handle;
+	if (!m_FreeHandles.empty())
+	{
+		handle = m_FreeHandles.back();
+		m_FreeHandles.pop_back();
+	}
+	else
+	{
+		handle = (uint32_t)m_Entries.size();
+		m_Entries.emplace_back();
+	}
+
+	Entry& entry = m_Entries[handle];
+	entry = Entry();
+	entry.m_Desc = desc;
+	entry.m_Desc.m_MipCount = std::min(std::max(desc.m_MipCount, 1u), kMaxMips);
+	entry.m_Desc.m_BaseMip = std::min(desc.m_BaseMip, entry.m_Desc.m_MipCount - 1);
+
+	entry.m_BytesFrom[entry.m_Desc.m_MipCount] = 0;
+	for (uint32_t mip = entry.m_Desc.m_MipCount; mip-- > 0;)
+		entry.m_BytesFrom[mip] = entry.m_BytesFrom[mip + 1] + entry.m_Desc.m_MipBytes[mip];
+
+	entry.m_ResidentMip = entry.m_TargetMip = std::min(residentMip, entry.m_Desc.m_MipCount - 1);
+	entry.m_RequestedMip = (float)entry.m_Desc.m_BaseMip;
+	entry.m_bAlive = true;
+
+	m_CommittedBytes += entry.m_BytesFrom[entry.m_TargetMip];
+	return handle;
+}
+
+void TextureStreaming::ResidencyManager::Unregister(uint32_t handle)
+{
+	if (handle >= m_Entries.size() || !m_Entries[handle].m_bAlive)
+		return;
+
+	Entry& entry = m_Entries[handle];
+	m_CommittedBytes -= entry.m_BytesFrom[entry.m_TargetMip];
+	if (entry.m_bInFlight)
+		--m_InFlight;
+
+	entry.m_bAlive = false;
+	m_FreeHandles.push_back(handle);
+}
+
+void TextureStreaming::ResidencyManager::Request(uint32_t handle, float mip)
+{
+	if (handle >= m_Entries.size())
+		return;
+
+	Entry& entry = m_Entries[handle];
+	if (entry.m_LastRequestFrame != m_Frame)
+	{
+		entry.m_LastRequestFrame = m_Frame;
+		entry.m_RequestedMip = mip;
+	}
+	else
+	{
+		entry.m_RequestedMip = std::min(entry.m_RequestedMip, mip);
+	}
+}
+
+uint32_t TextureStreaming::ResidencyManager::GetWantedMip(const Entry& entry) const
+{
+	if (entry.m_LastRequestFrame != m_Frame)
+		return entry.m_Desc.m_BaseMip;
+
+	// Round down - the sampler blends towards the finer of the two mips either side
+	const float mip = std::max(std::floor(entry.m_RequestedMip), 0.f);
+	return std::min((uint32_t)mip, entry.m_Desc.m_BaseMip);
+}
+
+void TextureStreaming::ResidencyManager::Issue(uint32_t handle, uint32_t toMip, std::vector<StreamRequest>& requests)
+{
+	Entry& entry = m_Entries[handle];
+
+	StreamRequest request;
+	request.m_Handle = handle;
+	request.m_FromMip = entry.m_ResidentMip;
+	request.m_ToMip = toMip;
+	requests.push_back(request);
+
+	m_CommittedBytes = m_CommittedBytes - entry.m_BytesFrom[entry.m_TargetMip] + entry.m_BytesFrom[toMip];
+	entry.m_TargetMip = toMip;
+	entry.m_bInFlight = true;
+	++m_InFlight;
+}
+
+void TextureStreaming::ResidencyManager::Update(std::vector<StreamRequest>& requests, uint32_t maxInFlight)
+{
+	// Most starved (missing the most levels) first. Ties go to the lower handle so the order is deterministic
+	typedef std::pair<uint32_t, uint32_t> Priority;
+	struct LowerPriority
+	{
+		bool operator()(const Priority& a, const Priority& b) const { return a.first != b.first ? a.first < b.first : a.second > b.second; }
+	};
+	std::priority_queue<Priority, std::vector<Priority>, LowerPriority> loads;
+
+	// Anything holding finer mips than it currently needs can give them back, the longest unrequested first
+	std::vector<uint32_t> evictable;
+
+	for (uint32_t handle = 0; handle < (uint32_t)m_Entries.size(); ++handle)
+	{
+		const Entry& entry = m_Entries[handle];
+		if (!entry.m_bAlive || entry.m_bInFlight)
+			continue;
+
+		const uint32_t wanted = GetWantedMip(entry);
+		if (wanted < entry.m_ResidentMip)
+			loads.push(Priority(entry.m_ResidentMip - wanted, handle));
+		else if (wanted > entry.m_ResidentMip)
+			evictable.push_back(handle);
+	}
+
+	std::sort(evictable.begin(), evictable.end(), [this](uint32_t a, uint32_t b)
+	{
+		const Entry& entryA = m_Entries[a];
+		const Entry& entryB = m_Entries[b];
+		if (entryA.m_LastRequestFrame != entryB.m_LastRequestFrame)
+			return entryA.m_LastRequestFrame < entryB.m_LastRequestFrame;
+
+		// Then whoever frees the most
+		const uint64_t freedA = entryA.m_BytesFrom[entryA.m_ResidentMip] - entryA.m_BytesFrom[GetWantedMip(entryA)];
+		const uint64_t freedB = entryB.m_BytesFrom[entryB.m_ResidentMip] - entryB.m_BytesFrom[GetWantedMip(entryB)];
+		return freedA != freedB ? freedA > freedB : a < b;
+	});
+
+	size_t nextEviction = 0;
+	auto evictUntil = [&](uint64_t limit)
+	{
+		while (m_CommittedBytes > limit && nextEviction < evictable.size() && m_InFlight < maxInFlight)
+		{
+			const uint32_t handle = evictable[nextEviction++];
+			Issue(handle, GetWantedMip(m_Entries[handle]), requests);
+		}
+	};
+
+	// A lowered budget is honoured even if nothing new is wanted
+	evictUntil(m_BudgetBytes);
+
+	m_LastOverBudget = 0;
+	while (!loads.empty() && m_InFlight < maxInFlight)
+	{
+		const uint32_t handle = loads.top().second;
+		loads.pop();
+
+		const Entry& entry = m_Entries[handle];
+		const uint32_t wanted = GetWantedMip(entry);
+		const uint64_t growth = entry.m_BytesFrom[wanted] - entry.m_BytesFrom[entry.m_TargetMip];
+
+		if (m_CommittedBytes + growth > m_BudgetBytes)
+		{
+			evictUntil(m_BudgetBytes > growth ? m_BudgetBytes - growth : 0);
+
+			// The evictions took the last free slots - this one goes first next frame instead
+			if (m_InFlight >= maxInFlight)
+				break;
+		}
+
+		// Take as many of the wanted levels as fit, coarsest first
+		uint32_t toMip = entry.m_ResidentMip;
+		while (toMip > wanted && m_CommittedBytes - entry.m_BytesFrom[entry.m_TargetMip] + entry.m_BytesFrom[toMip - 1] <= m_BudgetBytes)
+			--toMip;
+
+		if (toMip != wanted)
+			++m_LastOverBudget;
+		if (toMip < entry.m_ResidentMip)
+			Issue(handle, toMip, requests);
+	}
+
+	++m_Frame;
+}
+
+void TextureStreaming::ResidencyManager::OnStreamComplete(uint32_t handle, uint32_t residentMip)
+{
+	if (handle >= m_Entries.size() || !m_Entries[handle].m_bAlive || !m_Entries[handle].m_bInFlight)
+		return;
+
+	Entry& entry = m_Entries[handle];
+	residentMip = std::min(residentMip, entry.m_Desc.m_MipCount - 1);
+
+	m_CommittedBytes = m_CommittedBytes - entry.m_BytesFrom[entry.m_TargetMip] + entry.m_BytesFrom[residentMip];
+	entry.m_ResidentMip = entry.m_TargetMip = residentMip;
+	entry.m_bInFlight = false;
+	--m_InFlight;
+}
+
+TextureStreaming::ResidencyStats TextureStreaming::ResidencyManager::GetStats(void) const
+{
+	ResidencyStats stats;
+	stats.m_BudgetBytes = m_BudgetBytes;
+	stats.m_CommittedBytes = m_CommittedBytes;
+	stats.m_InFlight = m_InFlight;
+	stats.m_OverBudgetTextures = m_LastOverBudget;
+
+	// Update() has already moved on a frame, so look at what was requested during the previous one
+	for (const Entry& entry : m_Entries)
+	{
+		if (!entry.m_bAlive)
+			continue;
+
+		++stats.m_Textures;
+		const uint32_t wanted = entry.m_LastRequestFrame + 1 == m_Frame
+			? std::min((uint32_t)std::max(std::floor(entry.m_RequestedMip), 0.f), entry.m_Desc.m_BaseMip)
+			: entry.m_Desc.m_BaseMip;
+		stats.m_WantedBytes += entry.m_BytesFrom[wanted];
+	}
+	return stats;
+}
+
+//===============================================================================
+
+namespace
+{
+	// What the self test expects the manager to hold for each texture, kept alongside it
+	struct MirrorTexture
+	{
+		TextureStreaming::TextureDesc m_Desc;
+		uint64_t m_BytesFrom[TextureStreaming::kMaxMips + 1];
+		uint32_t m_Handle = TextureStreaming::kInvalidHandle;
+		uint32_t m_ResidentMip = 0;
+		uint32_t m_TargetMip = 0;
+		uint64_t m_LastRequestFrame = 0;
+		uint32_t m_CompleteFrame = 0;		// When the stream in flight finishes, if there is one
+		bool m_bInFlight = false;
+	};
+
+	// Square and 4 bytes a texel, with the coarsest four levels resident from the start
+	TextureStreaming::TextureDesc MakeTexture(CounterRNG::Stream& random)
+	{
+		TextureStreaming::TextureDesc desc;
+		desc.m_MipCount = (uint32_t)random.NextInt(6, 12);
+		for (uint32_t mip = 0; mip < desc.m_MipCount; ++mip)
+		{
+			const uint64_t size = 1ull << (desc.m_MipCount - 1 - mip);
+			desc.m_MipBytes[mip] = size * size * 4;
+		}
+		desc.m_BaseMip = desc.m_MipCount - 4;
+		return desc;
+	}
+
+	void RegisterMirror(TextureStreaming::ResidencyManager& manager, MirrorTexture& texture)
+	{
+		const TextureStreaming::TextureDesc& desc = texture.m_Desc;
+		texture.m_BytesFrom[desc.m_MipCount] = 0;
+		for (uint32_t mip = desc.m_MipCount; mip-- > 0;)
+			texture.m_BytesFrom[mip] = texture.m_BytesFrom[mip + 1] + desc.m_MipBytes[mip];
+
+		texture.m_Handle = manager.Register(desc, desc.m_BaseMip);
+		texture.m_ResidentMip = texture.m_TargetMip = desc.m_BaseMip;
+		texture.m_LastRequestFrame = 0;
+		texture.m_bInFlight = false;
+	}
+}
+
+TextureStreaming::SelfTestResult TextureStreaming::RunSelfTest(const SelfTestDesc& desc)
+{
+	SelfTestResult result;
+	CounterRNG::Stream random(desc.m_Seed);
+
+	ResidencyManager manager;
+	std::vector<MirrorTexture> textures(std::max(desc.m_Textures, 1u));
+	uint64_t baseBytes = 0, fullBytes = 0;
+	for (MirrorTexture& texture : textures)
+	{
+		texture.m_Desc = MakeTexture(random);
+		RegisterMirror(manager, texture);
+		baseBytes += texture.m_BytesFrom[texture.m_Desc.m_BaseMip];
+		fullBytes += texture.m_BytesFrom[0];
+	}
+
+	// Room for about a third of everything, so there's always something to evict
+	const uint64_t budget = baseBytes + (fullBytes - baseBytes) / 3;
+	manager.SetBudget(budget);
+	result.m_BudgetBytes = budget;
+
+	// Half the textures are on screen and want their finest levels, more than the budget holds, so loads have to stop short. Which half moves
+	// on every so often, leaving the old ones to be evicted
+	const uint32_t textureCount = (uint32_t)textures.size();
+	const uint32_t hotCount = std::max(textureCount / 2, 1u);
+
+	std::vector<uint32_t> byHandle;
+	std::vector<float> requested(textures.size());
+	std::vector<bool> asked(textures.size());
+	std::vector<StreamRequest> requests;
+
+	for (uint32_t frame = 1; frame <= desc.m_Frames; ++frame)
+	{
+		// Finish whatever's due. A tenth of loads fail and leave the texture where it was
+		for (MirrorTexture& texture : textures)
+		{
+			if (!texture.m_bInFlight || texture.m_CompleteFrame > frame)
+				continue;
+
+			const bool bLoad = texture.m_TargetMip < texture.m_ResidentMip;
+			const bool bFailed = bLoad && random.NextInt(9) == 0;
+			result.m_FailedLoads += bFailed ? 1 : 0;
+
+			const uint32_t residentMip = bFailed ? texture.m_ResidentMip : texture.m_TargetMip;
+			manager.OnStreamComplete(texture.m_Handle, residentMip);
+			texture.m_ResidentMip = texture.m_TargetMip = residentMip;
+			texture.m_bInFlight = false;
+		}
+
+		// Now and then a texture goes away mid-upload, its completion is dropped, and another takes its place
+		for (MirrorTexture& texture : textures)
+		{
+			if (!texture.m_bInFlight || random.NextInt(39) != 0)
+				continue;
+
+			manager.Unregister(texture.m_Handle);
+			texture.m_Desc = MakeTexture(random);
+			RegisterMirror(manager, texture);
+			++result.m_Cancels;
+		}
+
+		// The rest are asked for now and then, some more than once a frame
+		const uint32_t hotFirst = (frame / 200) * (textureCount / 4);
+		for (uint32_t i = 0; i < textureCount; ++i)
+		{
+			MirrorTexture& texture = textures[i];
+			asked[i] = false;
+
+			const bool bHot = (i + textureCount - hotFirst % textureCount) % textureCount < hotCount;
+			uint32_t asks = bHot ? 1 : (random.NextInt(3) == 0 ? (uint32_t)random.NextInt(1, 2) : 0);
+			for (; asks > 0; --asks)
+			{
+				const float mip = bHot ? random.NextFloat(0.0f, 1.5f) : random.NextFloat(-1.0f, (float)texture.m_Desc.m_BaseMip + 1.0f);
+				manager.Request(texture.m_Handle, mip);
+				requested[i] = asked[i] ? std::min(requested[i], mip) : mip;
+				asked[i] = true;
+			}
+		}
+
+		// What Update() should want of each, and which could give some back
+		auto wantedMip = [&](uint32_t i)
+		{
+			const MirrorTexture& texture = textures[i];
+			if (!asked[i])
+				return texture.m_Desc.m_BaseMip;
+			return std::min((uint32_t)std::max(std::floor(requested[i]), 0.0f), texture.m_Desc.m_BaseMip);
+		};
+
+		const ResidencyStats before = manager.GetStats();
+
+		byHandle.assign(textures.size() * 2 + 1, kInvalidHandle);
+		for (uint32_t i = 0; i < (uint32_t)textures.size(); ++i)
+		{
+			if (textures[i].m_Handle >= byHandle.size())
+				byHandle.resize(textures[i].m_Handle + 1, kInvalidHandle);
+			byHandle[textures[i].m_Handle] = i;
+			if (asked[i])
+				textures[i].m_LastRequestFrame = frame;
+		}
+
+		requests.clear();
+		manager.Update(requests, desc.m_MaxInFlight);
+
+		bool bLoaded = false;
+		uint64_t latestEvicted = 0;
+		std::vector<bool> evicted(textures.size(), false);
+		for (const StreamRequest& request : requests)
+		{
+			const uint32_t i = request.m_Handle < byHandle.size() ? byHandle[request.m_Handle] : kInvalidHandle;
+			result.Check(i != kInvalidHandle, "a stream was issued for a texture that's gone");
+			if (i == kInvalidHandle)
+				continue;
+
+			MirrorTexture& texture = textures[i];
+			result.Check(!texture.m_bInFlight, "a second stream was issued for a texture with one in flight");
+			result.Check(request.m_FromMip == texture.m_ResidentMip, "a stream started from a mip that wasn't resident");
+			result.Check(request.m_ToMip >= wantedMip(i), "a stream went finer than the texture was asked for");
+
+			if (request.IsLoad())
+			{
+				bLoaded = true;
+				++result.m_Loads;
+			}
+			else
+			{
+				// Never coarser than the texture is being asked for this frame
+				result.Check(request.m_ToMip == wantedMip(i), "an eviction took more than the texture's requests let it");
+				latestEvicted = std::max(latestEvicted, texture.m_LastRequestFrame);
+				evicted[i] = true;
+				++result.m_Evictions;
+			}
+
+			texture.m_TargetMip = request.m_ToMip;
+			texture.m_bInFlight = true;
+			texture.m_CompleteFrame = frame + (uint32_t)random.NextInt(1, 4);
+		}
+
+		// Anything that could have been evicted but wasn't must have been asked for at least as recently as everything that was
+		for (uint32_t i = 0; i < (uint32_t)textures.size(); ++i)
+		{
+			const MirrorTexture& texture = textures[i];
+			const bool bEvictable = !texture.m_bInFlight && wantedMip(i) > texture.m_ResidentMip;
+			if (bEvictable && !evicted[i])
+				result.Check(texture.m_LastRequestFrame >= latestEvicted, "a texture was evicted ahead of one asked for less recently");
+		}
+
+		// Everything committed is accounted for by what's resident or on its way, with nothing left behind by cancels or failed loads
+		uint64_t committed = 0;
+		uint32_t inFlight = 0;
+		for (const MirrorTexture& texture : textures)
+		{
+			committed += texture.m_BytesFrom[texture.m_TargetMip];
+			inFlight += texture.m_bInFlight ? 1 : 0;
+		}
+
+		const ResidencyStats after = manager.GetStats();
+		result.Check(after.m_CommittedBytes == committed, "committed bytes drifted from what's resident and in flight");
+		result.Check(after.m_InFlight == inFlight && inFlight <= desc.m_MaxInFlight, "streams in flight were miscounted");
+		result.Check(!bLoaded || after.m_CommittedBytes <= budget, "a load took the committed bytes over budget");
+		result.Check(after.m_CommittedBytes <= std::max(before.m_CommittedBytes, budget), "an update grew the committed bytes past the budget");
+		result.m_PeakCommittedBytes = std::max(result.m_PeakCommittedBytes, after.m_CommittedBytes);
+	}
+
+	// Once everything's gone, nothing's committed
+	for (MirrorTexture& texture : textures)
+		manager.Unregister(texture.m_Handle);
+	const ResidencyStats last = manager.GetStats();
+	result.Check(last.m_CommittedBytes == 0 && last.m_InFlight == 0 && last.m_Textures == 0, "bytes or streams were left over with every texture gone");
+
+	result.Check(result.m_Loads > 0 && result.m_Evictions > 0 && result.m_Cancels > 0, "the run never loaded, evicted or cancelled anything");
+	return result;
+}
@@ -0,0 +1,294 @@
+//===============================================================================
+// desc: Per-thread CPU profiling scopes for worker threads. Each thread builds its own private scope tree behind a thread-local stack, so the hot path never
+//       takes a lock or touches another thread's data. Completed scopes are handed to the profiler through a lock-free queue and merged on its thread.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ThreadProfiler.h"
+#include "AZB_TimeSeries.h"	// For the SPSC ring buffer
+#include "AZB_Trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//===============================================================================
+
+namespace
+{
+	// Enough for a busy loader thread to go a few frames without being drained
+	constexpr uint32_t kSamplesPerThread = 4096;
+
+	struct ThreadState
+	{
+		ThreadProfiler::ScopeNode m_Root;
+		ThreadProfiler::ScopeNode* m_Current = &m_Root;
+		std::vector<std::unique_ptr<ThreadProfiler::ScopeNode>> m_Nodes;	// Owning storage for everything below the root
+		PerfHistory::SpscRingBuffer<ThreadProfiler::ScopeSample, kSamplesPerThread> m_Samples;
+	};
+
+	// Only locked when a thread records its first scope, when it exits and once per drain
+	std::mutex s_RegistryMutex;
+	std::vector<std::unique_ptr<ThreadState>> s_Threads;
+	std::vector<ThreadState*> s_FreeThreads;		// Left behind by threads that have exited, for the next new thread to take over
+
+	std::atomic<uint64_t> s_DroppedSamples(0);
+
+	ThreadState* RegisterThread(void)
+	{
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+
+		// A state taken over keeps its index, name and nodes, so the merged tree keeps one "Worker N" per thread that's alive at once rather
+		// than one per thread that's ever lived. Samples its last owner left queued still drain as normal
+		if (!s_FreeThreads.empty())
+		{
+			ThreadState* state = s_FreeThreads.back();
+			s_FreeThreads.pop_back();
+			return state;
+		}
+
+		s_Threads.emplace_back(new ThreadState);
+
+		ThreadState* state = s_Threads.back().get();
+		state->m_Root.m_ThreadIndex = (uint32_t)s_Threads.size() - 1;
+		state->m_Root.m_Name = L"Worker " + std::to_wstring(state->m_Root.m_ThreadIndex);
+		return state;
+	}
+
+	void ReleaseThread(ThreadState* state)
+	{
+		// Scopes still open when the thread exited are dropped, so the next owner starts at the root
+		state->m_Current = &state->m_Root;
+
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+		s_FreeThreads.push_back(state);
+	}
+
+	// Hands the thread's state back when the thread exits
+	struct ThreadSlot
+	{
+		ThreadState* m_State = nullptr;
+
+		~ThreadSlot(void)
+		{
+			if (m_State != nullptr)
+				ReleaseThread(m_State);
+		}
+	};
+	thread_local ThreadSlot t_Slot;
+}
+
+//===============================================================================
+
+void ThreadProfiler::BeginScope(const std::wstring& name, int64_t tick)
+{
+	ThreadState* state = t_Slot.m_State;
+	if (state == nullptr)
+		state = t_Slot.m_State = RegisterThread();
+
+	ScopeNode* parent = state->m_Current;
+	auto iter = parent->m_Children.find(name);
+
+	ScopeNode* node;
+	if (iter != parent->m_Children.end())
+	{
+		node = iter->second;
+	}
+	else
+	{
+		// First time down this path. The consumer only ever sees the node through a released sample, so plain writes are fine here
+		state->m_Nodes.emplace_back(new ScopeNode);
+		node = state->m_Nodes.back().get();
+		node->m_Name = name;
+		node->m_Parent = parent;
+		node->m_ThreadIndex = state->m_Root.m_ThreadIndex;
+		parent->m_Children[name] = node;
+	}
+
+	node->m_StartTick = tick;
+	state->m_Current = node;
+}
+
+void ThreadProfiler::EndScope(int64_t tick)
+{
+	ThreadState* state = t_Slot.m_State;
+	if (state == nullptr || state->m_Current == &state->m_Root)
+		return;	// Unbalanced End - ignore rather than walk off the top of the tree
+
+	ScopeNode* node = state->m_Current;
+	state->m_Current = node->m_Parent;
+
+	ScopeSample sample = { node, node->m_StartTick, tick };
+	if (!state->m_Samples.Push(sample))
+		s_DroppedSamples.fetch_add(1, std::memory_order_relaxed);
+
+	if (Trace::IsCapturing())
+	{
+		if (node->m_TraceNameId == 0)
+			node->m_TraceNameId = Trace::RegisterName(node->m_Name);
+		Trace::RecordScope(Trace::TRACK_CPU, node->m_TraceNameId, sample.m_StartTick, sample.m_EndTick);
+	}
+}
+
+void ThreadProfiler::Drain(const std::function<void(const ScopeSample&)>& onSample)
+{
+	std::vector<ThreadState*> threads;
+	{
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+		threads.reserve(s_Threads.size());
+		for (auto& state : s_Threads)
+			threads.push_back(state.get());
+	}
+
+	ScopeSample sample;
+	for (ThreadState* state : threads)
+	{
+		while (state->m_Samples.Pop(sample))
+			onSample(sample);
+	}
+}
+
+uint32_t ThreadProfiler::GetThreadCount(void)
+{
+	std::lock_guard<std::mutex> lock(s_RegistryMutex);
+	return (uint32_t)(s_Threads.size() - s_FreeThreads.size());
+}
+
+uint64_t ThreadProfiler::GetDroppedSampleCount(void)
+{
+	return s_DroppedSamples.load(std::memory_order_relaxed);
+}
+
+//===============================================================================
+
+namespace
+{
+	// Levels below the thread's root, found by walking up
+	uint32_t GetDepth(const ThreadProfiler::ScopeNode* node)
+	{
+		uint32_t depth = 0;
+		for (; node->m_Parent != nullptr; node = node->m_Parent)
+			++depth;
+		return depth;
+	}
+}
+
+ThreadProfiler::BenchmarkResult ThreadProfiler::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+	if (desc.m_Threads == 0 || desc.m_MaxDepth == 0)
+	{
+		result.m_bValid = false;
+		return result;
+	}
+
+	// One name per depth, so where a sample sits in its tree can be checked against where it was opened. The last is opened from the root once
+	// a thread has closed everything else, so it only lands at depth 1 if the thread really did get back there
+	std::vector<std::wstring> names;
+	for (uint32_t depth = 1; depth <= desc.m_MaxDepth; ++depth)
+		names.push_back(L"Depth " + std::to_wstring(depth));
+	const std::wstring kFinalName = L"Back at the root";
+
+	// Start from empty queues, and count drops from here
+	Drain([](const ScopeSample&) {});
+	const uint64_t droppedBefore = GetDroppedSampleCount();
+	const uint32_t threadsBefore = GetThreadCount();
+
+	std::atomic<uint32_t> producersLeft(desc.m_Threads);
+	std::atomic<uint64_t> produced(0);
+	std::atomic<int64_t> producerNs(0);
+
+	bool bDepthsHold = true;
+	bool bTicksHold = true;
+	uint32_t finalSamples = 0;
+	auto onSample = [&](const ScopeSample& sample)
+	{
+		++result.m_Drained;
+		const uint32_t depth = GetDepth(sample.m_Node);
+		result.m_DeepestSample = std::max(result.m_DeepestSample, depth);
+		if (sample.m_Node->m_Name == kFinalName)
+		{
+			++finalSamples;
+			bDepthsHold &= depth == 1;
+		}
+		else
+		{
+			bDepthsHold &= depth >= 1 && depth <= desc.m_MaxDepth && sample.m_Node->m_Name == names[depth - 1];
+		}
+		bTicksHold &= sample.m_EndTick > sample.m_StartTick;
+	};
+
+	// The consumer drains as the profiler would, alongside the producers, then once more after the last of them is done
+	std::thread consumer([&]()
+	{
+		while (producersLeft.load(std::memory_order_acquire) != 0)
+		{
+			Drain(onSample);
+			++result.m_Drains;
+			std::this_thread::sleep_for(std::chrono::microseconds(desc.m_DrainIntervalUs));
+		}
+		Drain(onSample);
+		++result.m_Drains;
+	});
+
+	std::vector<std::thread> producers;
+	for (uint32_t thread = 0; thread < desc.m_Threads; ++thread)
+	{
+		producers.emplace_back([&, thread]()
+		{
+			uint64_t state = desc.m_Seed * 0x9E3779B97F4A7C15ull + thread + 1;
+			int64_t tick = 0;
+			uint32_t depth = 0;
+			uint64_t ended = 0;
+
+			const auto start = std::chrono::steady_clock::now();
+			for (uint32_t scope = 0; scope < desc.m_ScopesPerThread; ++scope)
+			{
+				// Down three times in four, always down from the root and always up from the bottom
+				state ^= state << 13;
+				state ^= state >> 7;
+				state ^= state << 17;
+				if (depth == 0 || (depth < desc.m_MaxDepth && (state & 3) != 0))
+				{
+					BeginScope(names[depth++], ++tick);
+				}
+				else
+				{
+					EndScope(++tick);
+					--depth;
+					++ended;
+				}
+			}
+
+			// Close whatever's still open, then check this thread really is back at its root
+			for (; depth > 0; --depth, ++ended)
+				EndScope(++tick);
+			BeginScope(kFinalName, ++tick);
+			EndScope(++tick);
+			++ended;
+			const auto end = std::chrono::steady_clock::now();
+
+			produced.fetch_add(ended, std::memory_order_relaxed);
+			producerNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+			producersLeft.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	for (std::thread& producer : producers)
+		producer.join();
+	consumer.join();
+
+	result.m_Produced = produced.load();
+	result.m_Dropped = GetDroppedSampleCount() - droppedBefore;
+	result.m_NsPerScope = result.m_Produced != 0 ? (double)producerNs.load() / (double)result.m_Produced : 0.0;
+
+	result.Check(result.m_Produced == result.m_Drained + result.m_Dropped, "a scope was neither drained nor counted as dropped");
+	result.Check(bDepthsHold, "a sample came out at a different depth to the one its scope was opened at");
+	result.Check(bTicksHold, "a sample ended before it started");
+	result.Check(finalSamples <= desc.m_Threads && (finalSamples == desc.m_Threads || result.m_Dropped != 0), "a thread's last scope went missing");
+	result.Check(GetThreadCount() == threadsBefore, "an exited thread's state wasn't handed back");
+	return result;
+}
@@ -0,0 +1,1389 @@
+//===============================================================================
+// desc: A CPU implementation of PostEffects::ProcessHDR - bloom extract and luma, the bloom downsample and blur chain, tone mapping, the luma
+//       histogram and exposure adaptation - doing the same math as the shaders, in the same order, through the same buffer formats. It runs
+//       over HDR frames captured from the engine, so exposure can be adapted, frozen or replayed from another run without a GPU in the loop,
+//       and two upscalers can be compared with the exposure differences between them taken out.
+//       Two things keep it from matching a GPU to the bit: bilinear weights are full floats where samplers use a few bits of fraction, and
+//       log2 and exp2 are the C library's where the GPU's are approximations. A luma right on the edge of a bin can land one bin over.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_ToneMapReference.h"
+#include "AZB_CounterRNG.h"
+#include "AZB_HalfFloat.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	using namespace ToneMapReference;
+
+	// Extract and tone map jobs are square tiles of this many pixels a side
+	constexpr uint32_t kTileSize = 64;
+
+	// Blur jobs are runs of rows, since the blurs are done one direction at a time
+	constexpr uint32_t kBlurRowsPerJob = 16;
+
+	// The 9 tap blur reaches this far either side, so a blur reads this far outside its buffer
+	constexpr int32_t kBlurRadius = 4;
+
+	const char kFrameFileMagic[4] = { 'H', 'D', 'R', 'F' };
+	const uint32_t kFrameFileVersion = 2;
+
+	// Version 1 ended at the frame count and only held R11G11B10_FLOAT, which is still how one of those loads
+	struct FrameFileHeader
+	{
+		char m_Magic[4];
+		uint32_t m_Version;
+		uint32_t m_Width;
+		uint32_t m_Height;
+		uint32_t m_FrameCount;
+		uint32_t m_Format;
+	};
+	static_assert(sizeof(FrameFileHeader) == 24, "FrameFileHeader is written as-is, so its layout mustn't change");
+
+	// Capture resolutions go no higher than this, so a corrupt header can't ask for gigabytes
+	constexpr uint32_t kMaxFrameDimension = 16384;
+
+	FILE* OpenFile(const std::wstring& fileName, bool bWrite)
+	{
+#if defined(_WIN32)
+		FILE* file = nullptr;
+		return _wfopen_s(&file, fileName.c_str(), bWrite ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+		return std::fopen(std::string(fileName.begin(), fileName.end()).c_str(), bWrite ? "wb" : "rb");
+#endif
+	}
+
+	uint32_t DivideUp(uint32_t value, uint32_t divisor)
+	{
+		return (value + divisor - 1) / divisor;
+	}
+
+	void EnsureSize(Image& image, uint32_t width, uint32_t height)
+	{
+		if (image.m_Width != width || image.m_Height != height)
+			image.Resize(width, height);
+	}
+
+	//===============================================================================
+	// Small floats
+
+	using HalfFloat::AsUint;
+	using HalfFloat::AsFloat;
+	using HalfFloat::DecodeMagnitude;
+	using HalfFloat::EncodeMagnitude;
+	using HalfFloat::FloatToHalf;
+	using HalfFloat::HalfToFloat;
+	using HalfFloat::RoundToHalf;
+
+	// Every value an 11 and a 10 bit float can hold, since decoding is most of what reading a buffer costs
+	struct DecodeTables
+	{
+		float m_Float11[1 << 11];
+		float m_Float10[1 << 10];
+
+		DecodeTables(void)
+		{
+			for (uint32_t i = 0; i < (1u << 11); ++i)
+				m_Float11[i] = DecodeMagnitude(i, 6);
+			for (uint32_t i = 0; i < (1u << 10); ++i)
+				m_Float10[i] = DecodeMagnitude(i, 5);
+		}
+	};
+
+	const DecodeTables& GetDecodeTables(void)
+	{
+		static const DecodeTables tables;
+		return tables;
+	}
+
+	uint32_t EncodeChannel(float value, uint32_t mantissaBits)
+	{
+		if (!(value > 0.0f))
+			return 0;
+		const uint32_t largest = (30u << mantissaBits) | ((1u << mantissaBits) - 1);
+		return std::min(EncodeMagnitude(AsUint(value), mantissaBits), largest);
+	}
+
+	//===============================================================================
+	// Shader helpers. Processor and the reference share these, so they can only differ in how they walk the buffers
+
+	const float kLumaWeights[3] = { 0.212671f, 0.715160f, 0.072169f };
+	const float kBlurWeights[5] = { 70.0f / 256.0f, 56.0f / 256.0f, 28.0f / 256.0f, 8.0f / 256.0f, 1.0f / 256.0f };
+
+	// REC709toREC2020, a row at a time
+	const float kRec709ToRec2020[3][3] =
+	{
+		{ 0.627402f, 0.329292f, 0.043306f },
+		{ 0.069095f, 0.919544f, 0.011360f },
+		{ 0.016394f, 0.088028f, 0.895578f },
+	};
+
+	float RGBToLuminance(const float rgb[3])
+	{
+		return rgb[0] * kLumaWeights[0] + rgb[1] * kLumaWeights[1] + rgb[2] * kLumaWeights[2];
+	}
+
+	// HLSL's lerp
+	float Lerp(float a, float b, float t)
+	{
+		return a + (b - a) * t;
+	}
+
+	float Saturate(float value)
+	{
+		return std::min(std::max(value, 0.0f), 1.0f);
+	}
+
+	// The UAV store of a float3 to R11G11B10_FLOAT, and reading it back
+	void Store(Image& image, uint32_t x, uint32_t y, const float rgb[3])
+	{
+		UnpackR11G11B10(PackR11G11B10(rgb), image.GetPixel(x, y));
+	}
+
+	// Texture Load, with anything outside the texture reading as 0
+	void Load(const Image& image, int32_t x, int32_t y, float rgb[3])
+	{
+		if (x < 0 || y < 0 || x >= (int32_t)image.m_Width || y >= (int32_t)image.m_Height)
+		{
+			rgb[0] = rgb[1] = rgb[2] = 0.0f;
+			return;
+		}
+		std::memcpy(rgb, image.GetPixel((uint32_t)x, (uint32_t)y), sizeof(float) * 3);
+	}
+
+	// std::floor is a library call on plain SSE2, and this is on every sample
+	int32_t FloorToInt(float value)
+	{
+		const int32_t truncated = (int32_t)value;
+		return (float)truncated > value ? truncated - 1 : truncated;
+	}
+
+	enum AddressMode { kClamp, kBorder };
+
+	// SampleLevel at mip 0 through a linear sampler. Border is transparent black, as SamplerLinearBorderDesc has it
+	void Sample(const Image& image, float u, float v, AddressMode mode, float rgb[3])
+	{
+		const float x = u * (float)image.m_Width - 0.5f;
+		const float y = v * (float)image.m_Height - 0.5f;
+		const int32_t left = FloorToInt(x);
+		const int32_t top = FloorToInt(y);
+		const float fx = x - (float)left;
+		const float fy = y - (float)top;
+
+		// Most samples land well inside, so they can skip the addressing
+		if (left >= 0 && top >= 0 && left + 1 < (int32_t)image.m_Width && top + 1 < (int32_t)image.m_Height)
+		{
+			const float* upper = image.GetPixel((uint32_t)left, (uint32_t)top);
+			const float* lower = upper + (size_t)image.m_Width * 3;
+			for (uint32_t c = 0; c < 3; ++c)
+				rgb[c] = Lerp(Lerp(upper[c], upper[c + 3], fx), Lerp(lower[c], lower[c + 3], fx), fy);
+			return;
+		}
+
+		float texels[4][3];
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			int32_t tx = left + (int32_t)(i & 1);
+			int32_t ty = top + (int32_t)(i >> 1);
+			if (mode == kClamp)
+			{
+				tx = std::min(std::max(tx, 0), (int32_t)image.m_Width - 1);
+				ty = std::min(std::max(ty, 0), (int32_t)image.m_Height - 1);
+			}
+			Load(image, tx, ty, texels[i]);
+		}
+
+		for (uint32_t c = 0; c < 3; ++c)
+			rgb[c] = Lerp(Lerp(texels[0][c], texels[1][c], fx), Lerp(texels[2][c], texels[3][c], fx), fy);
+	}
+
+	// The quantised log luma both extract shaders write to LumaResult
+	uint8_t EncodeLuma(float luma, const ExposureState& exposure)
+	{
+		// Prevent log(0) and put only pure black pixels in Histogram[0]
+		if (luma == 0.0f)
+			return 0;
+
+		const float minLog = exposure.m_Values[4];
+		const float rcpLogRange = exposure.m_Values[7];
+		const float logLuma = Saturate((std::log2(luma) - minLog) * rcpLogRange);
+		return (uint8_t)(uint32_t)(logLuma * 254.0f + 1.0f);
+	}
+
+	void SampleQuad(const Image& scene, float u, float v, float offsetU, float offsetV, float colors[4][3])
+	{
+		Sample(scene, u - offsetU, v - offsetV, kClamp, colors[0]);
+		Sample(scene, u + offsetU, v - offsetV, kClamp, colors[1]);
+		Sample(scene, u - offsetU, v + offsetV, kClamp, colors[2]);
+		Sample(scene, u + offsetU, v + offsetV, kClamp, colors[3]);
+	}
+
+	// BloomExtractAndDownsampleHdrCS for one thread
+	void ExtractBloomPixel(const Image& scene, uint32_t x, uint32_t y, float inverseWidth, float inverseHeight, float threshold,
+		const ExposureState& exposure, float bloom[3], uint8_t& luma)
+	{
+		const float u = ((float)x + 0.5f) * inverseWidth;
+		const float v = ((float)y + 0.5f) * inverseHeight;
+		float colors[4][3];
+		SampleQuad(scene, u, v, inverseWidth * 0.25f, inverseHeight * 0.25f, colors);
+
+		const float kSmallEpsilon = 0.0001f;
+		const float kShimmerFilterInverseStrength = 1.0f;
+		const float scaledThreshold = threshold * exposure.m_Values[1];
+
+		float lumas[4], weights[4];
+		for (uint32_t i = 0; i < 4; ++i)
+			lumas[i] = RGBToLuminance(colors[i]);
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			const float scale = std::max(kSmallEpsilon, lumas[i] - scaledThreshold) / (lumas[i] + kSmallEpsilon);
+			for (uint32_t c = 0; c < 3; ++c)
+				colors[i][c] *= scale;
+		}
+		for (uint32_t i = 0; i < 4; ++i)
+			weights[i] = 1.0f / (lumas[i] + kShimmerFilterInverseStrength);
+
+		const float weightSum = weights[0] + weights[1] + weights[2] + weights[3];
+		for (uint32_t c = 0; c < 3; ++c)
+			bloom[c] = (colors[0][c] * weights[0] + colors[1][c] * weights[1] + colors[2][c] * weights[2] + colors[3][c] * weights[3]) / weightSum;
+
+		luma = EncodeLuma((lumas[0] + lumas[1] + lumas[2] + lumas[3]) * 0.25f, exposure);
+	}
+
+	// ExtractLumaCS for one thread. It samples from the top left corner of its pixel rather than the centre, as the shader does
+	uint8_t ExtractLumaPixel(const Image& scene, uint32_t x, uint32_t y, float inverseWidth, float inverseHeight, const ExposureState& exposure)
+	{
+		float colors[4][3];
+		SampleQuad(scene, (float)x * inverseWidth, (float)y * inverseHeight, inverseWidth * 0.25f, inverseHeight * 0.25f, colors);
+
+		float sum[3];
+		for (uint32_t c = 0; c < 3; ++c)
+			sum[c] = colors[0][c] + colors[1][c] + colors[2][c] + colors[3][c];
+		return EncodeLuma(RGBToLuminance(sum) * 0.25f, exposure);
+	}
+
+	// 0.25f * (a + b + c + d), left to right as the shader adds them
+	void Average4(const float a[3], const float b[3], const float c[3], const float d[3], float scale, float result[3])
+	{
+		for (uint32_t i = 0; i < 3; ++i)
+			result[i] = scale * (a[i] + b[i] + c[i] + d[i]);
+	}
+
+	// BlurPixels, on one channel of 9 taps
+	float Blur9(const float* taps, size_t stride)
+	{
+		const float a = taps[0], b = taps[stride], c = taps[stride * 2], d = taps[stride * 3], e = taps[stride * 4];
+		const float f = taps[stride * 5], g = taps[stride * 6], h = taps[stride * 7], i = taps[stride * 8];
+		return kBlurWeights[0] * e + kBlurWeights[1] * (d + f) + kBlurWeights[2] * (c + g) + kBlurWeights[3] * (b + h) + kBlurWeights[4] * (a + i);
+	}
+
+	// UpsampleAndBlurCS's blend of the higher resolution buffer with the lower
+	void UpsamplePixel(const Image& higher, const Image& lower, float factor, int32_t x, int32_t y, float u, float v, float rgb[3])
+	{
+		float higherPixel[3], lowerPixel[3];
+		Load(higher, x, y, higherPixel);
+		Sample(lower, u, v, kBorder, lowerPixel);
+		for (uint32_t c = 0; c < 3; ++c)
+			rgb[c] = Lerp(higherPixel[c], lowerPixel[c], factor);
+	}
+
+	float ToneMapStanard(float value)
+	{
+		const float k = std::sqrt(4.0f / 27.0f);
+		const float y = value * std::sqrt(value);
+		return y / (y + k);
+	}
+
+	// ToneMapCS or ToneMapHDRCS for one thread, returning the colour and the log luminance
+	float ToneMapPixel(const float scene[3], const float bloom[3], const Settings& settings, float exposure, float output[3])
+	{
+		float hdr[3];
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			hdr[c] = scene[c] + settings.m_BloomStrength * bloom[c];
+			hdr[c] *= exposure;
+		}
+
+		if (settings.m_bHDROutput)
+		{
+			const float paperWhiteRatio = settings.m_HDRPaperWhite / settings.m_MaxDisplayLuminance;
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				const float rec2020 = kRec709ToRec2020[c][0] * hdr[0] + kRec709ToRec2020[c][1] * hdr[1] + kRec709ToRec2020[c][2] * hdr[2];
+				output[c] = ToneMapStanard(rec2020 * paperWhiteRatio) * settings.m_MaxDisplayLuminance;
+			}
+		}
+		else
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				output[c] = ToneMapStanard(hdr[c]);
+		}
+
+		// RGBToLogLuminance, with its default gamma of 4
+		return std::log2(Lerp(1.0f, 16.0f, RGBToLuminance(output))) / 4.0f;
+	}
+
+	// The R8_UNORM store
+	uint8_t StoreUnorm8(float value)
+	{
+		return (uint8_t)(Saturate(value) * 255.0f + 0.5f);
+	}
+
+	void UpdateExposure(const FrameResult& result, uint32_t lumaPixels, const Settings& settings, ExposureState& exposure)
+	{
+		if (settings.m_bFreezeExposure)
+			return;
+
+		if (settings.m_bEnableAdaptation)
+			AdaptExposure(result.m_Histogram, lumaPixels, settings, exposure);
+		else
+			exposure = ExposureState::Initial(settings.m_Exposure);
+	}
+}
+
+//===============================================================================
+
+uint32_t ToneMapReference::PackR11G11B10(const float rgb[3])
+{
+	return EncodeChannel(rgb[0], 6) | (EncodeChannel(rgb[1], 6) << 11) | (EncodeChannel(rgb[2], 5) << 22);
+}
+
+void ToneMapReference::UnpackR11G11B10(uint32_t packed, float rgb[3])
+{
+	const DecodeTables& tables = GetDecodeTables();
+	rgb[0] = tables.m_Float11[packed & 0x7FF];
+	rgb[1] = tables.m_Float11[(packed >> 11) & 0x7FF];
+	rgb[2] = tables.m_Float10[packed >> 22];
+}
+
+void ToneMapReference::GetBloomSize(uint32_t sceneWidth, uint32_t sceneHeight, uint32_t& bloomWidth, uint32_t& bloomHeight)
+{
+	bloomWidth = sceneWidth > 2560 ? 1280 : 640;
+	bloomHeight = sceneHeight > 1440 ? 768 : 384;
+}
+
+ToneMapReference::ExposureState ToneMapReference::ExposureState::Initial(float exposure)
+{
+	ExposureState state =
+	{ {
+		exposure, 1.0f / exposure, exposure, 0.0f,
+		kInitialMinLog, kInitialMaxLog, kInitialMaxLog - kInitialMinLog, 1.0f / (kInitialMaxLog - kInitialMinLog)
+	} };
+	return state;
+}
+
+void ToneMapReference::AdaptExposure(const uint32_t histogram[kHistogramBins], uint32_t pixelCount, const Settings& settings, ExposureState& exposure)
+{
+	// Every thread adds in the one i along, doubling i each time, so each ends up with the whole sum but added in its own order. Thread 0's
+	// is the one written out
+	float weightedSums[kHistogramBins];
+	float accumulated[kHistogramBins];
+	for (uint32_t i = 0; i < kHistogramBins; ++i)
+		weightedSums[i] = (float)i * (float)histogram[i];
+
+	for (uint32_t step = 1; step < kHistogramBins; step *= 2)
+	{
+		std::memcpy(accumulated, weightedSums, sizeof(accumulated));
+		for (uint32_t i = 0; i < kHistogramBins; ++i)
+			weightedSums[i] += accumulated[(i + step) % kHistogramBins];
+	}
+
+	const float weightedSum = weightedSums[0];
+	if (weightedSum == 0.0f)
+		return;
+
+	float* values = exposure.m_Values;
+	float minLog = values[4];
+	float maxLog = values[5];
+	const float logRange = values[6];
+	const float rcpLogRange = values[7];
+
+	// Black pixels are left out of the average
+	const float weightedHistAvg = weightedSum / (float)std::max(1u, pixelCount - histogram[0]) - 1.0f;
+	const float logAvgLuminance = std::exp2(weightedHistAvg / 254.0f * logRange + minLog);
+	const float targetExposure = settings.m_TargetLuminance / logAvgLuminance;
+
+	float newExposure = Lerp(values[0], targetExposure, settings.m_AdaptationRate);
+	newExposure = std::min(std::max(newExposure, settings.m_MinExposure), settings.m_MaxExposure);
+
+	values[0] = newExposure;
+	values[1] = 1.0f / newExposure;
+	values[2] = newExposure;
+	values[3] = weightedHistAvg;
+
+	// The range is meant to drift towards the average, but the shader scales the bias by the reciprocal of the range, so it barely moves.
+	// Kept as it is, since it's the GPU being matched
+	const float biasToCenter = (std::floor(weightedHistAvg) - 128.0f) / 255.0f;
+	if (std::fabs(biasToCenter) > 0.1f)
+	{
+		minLog += biasToCenter * rcpLogRange;
+		maxLog += biasToCenter * rcpLogRange;
+	}
+
+	values[4] = minLog;
+	values[5] = maxLog;
+	values[6] = logRange;
+	values[7] = 1.0f / logRange;
+}
+
+//===============================================================================
+
+ToneMapReference::Processor::Processor(uint32_t workerThreads) : m_Pool(workerThreads)
+{
+}
+
+void ToneMapReference::Processor::ProcessFrame(const Image& hdr, const Settings& settings, ExposureState& exposure, FrameResult& result)
+{
+	m_Scene = &hdr;
+	m_Settings = &settings;
+	m_Exposure = exposure;
+	m_Result = &result;
+	result.m_Exposure = exposure;
+
+	uint32_t bloomWidth, bloomHeight;
+	GetBloomSize(hdr.m_Width, hdr.m_Height, bloomWidth, bloomHeight);
+
+	result.m_LumaLR.assign((size_t)bloomWidth * bloomHeight, 0);
+	std::memset(result.m_Histogram, 0, sizeof(result.m_Histogram));
+
+	if (settings.m_bEnableBloom)
+	{
+		for (uint32_t level = 0; level < 5; ++level)
+		{
+			EnsureSize(m_BloomBuffers[level][0], bloomWidth >> level, bloomHeight >> level);
+			EnsureSize(m_BloomBuffers[level][1], bloomWidth >> level, bloomHeight >> level);
+		}
+	}
+
+	// The bloom extract writes the luma as it goes. Without bloom, the luma is only extracted for adaptation. The histogram is counted in
+	// tiles alongside, then the tiles are added up
+	if (settings.m_bEnableBloom || settings.m_bEnableAdaptation)
+	{
+		m_TilesX = DivideUp(bloomWidth, kTileSize);
+		const uint32_t jobCount = m_TilesX * DivideUp(bloomHeight, kTileSize);
+		m_TileHistograms.assign((size_t)jobCount * kHistogramBins, 0);
+		Run(kExtractPhase, jobCount);
+
+		for (uint32_t job = 0; job < jobCount; ++job)
+		{
+			for (uint32_t bin = 0; bin < kHistogramBins; ++bin)
+				result.m_Histogram[bin] += m_TileHistograms[(size_t)job * kHistogramBins + bin];
+		}
+	}
+
+	if (settings.m_bEnableBloom)
+	{
+		// Each job is a row of the 8x8 blocks the downsample dispatches in
+		Run(kDownsamplePhase, (bloomHeight / 2) / 8);
+
+		// High quality sums 5 octaves with a 2x frequency scale, low quality sums 3 with a 4x frequency scale
+		if (settings.m_bHighQualityBloom)
+		{
+			const float upsampleBlendFactor = settings.m_BloomUpsampleFactor;
+			Blur(m_BloomBuffers[4][0], nullptr, 1.0f, m_BloomBuffers[4][1]);
+			for (int32_t level = 3; level >= 0; --level)
+				Blur(m_BloomBuffers[level][0], &m_BloomBuffers[level + 1][1], upsampleBlendFactor, m_BloomBuffers[level][1]);
+		}
+		else
+		{
+			const float upsampleBlendFactor = settings.m_BloomUpsampleFactor * 2.0f / 3.0f;
+			Blur(m_BloomBuffers[4][0], nullptr, 1.0f, m_BloomBuffers[4][1]);
+			Blur(m_BloomBuffers[2][0], &m_BloomBuffers[4][1], upsampleBlendFactor, m_BloomBuffers[2][1]);
+			Blur(m_BloomBuffers[0][0], &m_BloomBuffers[2][1], upsampleBlendFactor, m_BloomBuffers[0][1]);
+		}
+		result.m_Bloom = m_BloomBuffers[0][1];
+	}
+	else
+	{
+		result.m_Bloom = Image();
+	}
+
+	EnsureSize(result.m_Output, hdr.m_Width, hdr.m_Height);
+	result.m_Luma.resize((size_t)hdr.m_Width * hdr.m_Height);
+	m_TilesX = DivideUp(hdr.m_Width, kTileSize);
+	Run(kToneMapPhase, m_TilesX * DivideUp(hdr.m_Height, kTileSize));
+
+	// Last, so the bright pass used the same exposure as tone mapping
+	UpdateExposure(result, bloomWidth * bloomHeight, settings, exposure);
+
+	m_Scene = nullptr;
+	m_Settings = nullptr;
+	m_Result = nullptr;
+}
+
+void ToneMapReference::Processor::Blur(Image& higher, const Image* lower, float upsampleBlendFactor, Image& output)
+{
+	m_BlurHigher = &higher;
+	m_BlurLower = lower;
+	m_BlurFactor = upsampleBlendFactor;
+	m_BlurOutput = &output;
+
+	// The input is kept with a border as wide as the blur, since UpsampleAndBlurCS's border pixels aren't necessarily black
+	const uint32_t paddedHeight = higher.m_Height + kBlurRadius * 2;
+	EnsureSize(output, higher.m_Width, higher.m_Height);
+	EnsureSize(m_BlurInput, higher.m_Width + kBlurRadius * 2, paddedHeight);
+	EnsureSize(m_BlurHorizontal, higher.m_Width, paddedHeight);
+
+	Run(kBlurLoadPhase, DivideUp(paddedHeight, kBlurRowsPerJob));
+	Run(kBlurHorizontalPhase, DivideUp(paddedHeight, kBlurRowsPerJob));
+	Run(kBlurVerticalPhase, DivideUp(higher.m_Height, kBlurRowsPerJob));
+}
+
+void ToneMapReference::Processor::Run(Phase phase, uint32_t jobCount)
+{
+	m_Phase = phase;
+	m_Pool.Run(jobCount, [this](uint32_t job) { ProcessJob(job); });
+}
+
+void ToneMapReference::Processor::ProcessJob(uint32_t job)
+{
+	const Settings& settings = *m_Settings;
+	FrameResult& result = *m_Result;
+
+	switch (m_Phase)
+	{
+	case kExtractPhase:
+	{
+		uint32_t bloomWidth, bloomHeight;
+		GetBloomSize(m_Scene->m_Width, m_Scene->m_Height, bloomWidth, bloomHeight);
+		const float inverseWidth = 1.0f / (float)bloomWidth;
+		const float inverseHeight = 1.0f / (float)bloomHeight;
+
+		const uint32_t x0 = (job % m_TilesX) * kTileSize, y0 = (job / m_TilesX) * kTileSize;
+		const uint32_t x1 = std::min(x0 + kTileSize, bloomWidth), y1 = std::min(y0 + kTileSize, bloomHeight);
+		uint32_t* histogram = &m_TileHistograms[(size_t)job * kHistogramBins];
+
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			for (uint32_t x = x0; x < x1; ++x)
+			{
+				uint8_t luma;
+				if (settings.m_bEnableBloom)
+				{
+					float bloom[3];
+					ExtractBloomPixel(*m_Scene, x, y, inverseWidth, inverseHeight, settings.m_BloomThreshold, m_Exposure, bloom, luma);
+					Store(m_BloomBuffers[0][0], x, y, bloom);
+				}
+				else
+				{
+					luma = ExtractLumaPixel(*m_Scene, x, y, inverseWidth, inverseHeight, m_Exposure);
+				}
+				result.m_LumaLR[(size_t)y * bloomWidth + x] = luma;
+				++histogram[luma];
+			}
+		}
+		break;
+	}
+
+	case kDownsamplePhase:
+	{
+		// Each 8x8 block of the half size buffer is sampled unquantised, then averaged down 2x2 at a time to a single pixel
+		const Image& source = m_BloomBuffers[0][0];
+		const float inverseWidth = 1.0f / (float)source.m_Width;
+		const float inverseHeight = 1.0f / (float)source.m_Height;
+		const bool bHighQuality = settings.m_bHighQualityBloom;
+		const uint32_t blockY = job * 8;
+
+		for (uint32_t blockX = 0; blockX < source.m_Width / 2; blockX += 8)
+		{
+			float half[8][8][3], quarter[4][4][3], eighth[2][2][3], sixteenth[3];
+			for (uint32_t y = 0; y < 8; ++y)
+			{
+				for (uint32_t x = 0; x < 8; ++x)
+				{
+					const float u = ((float)(blockX + x) * 2.0f + 1.0f) * inverseWidth;
+					const float v = ((float)(blockY + y) * 2.0f + 1.0f) * inverseHeight;
+					Sample(source, u, v, kClamp, half[y][x]);
+					if (bHighQuality)
+						Store(m_BloomBuffers[1][0], blockX + x, blockY + y, half[y][x]);
+				}
+			}
+
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				for (uint32_t x = 0; x < 4; ++x)
+				{
+					Average4(half[y * 2][x * 2], half[y * 2][x * 2 + 1], half[y * 2 + 1][x * 2], half[y * 2 + 1][x * 2 + 1], 0.25f, quarter[y][x]);
+					Store(m_BloomBuffers[2][0], blockX / 2 + x, blockY / 2 + y, quarter[y][x]);
+				}
+			}
+
+			// Low quality leaves out the eighth size buffer and scales once, at the end
+			for (uint32_t y = 0; y < 2; ++y)
+			{
+				for (uint32_t x = 0; x < 2; ++x)
+				{
+					Average4(quarter[y * 2][x * 2], quarter[y * 2][x * 2 + 1], quarter[y * 2 + 1][x * 2], quarter[y * 2 + 1][x * 2 + 1],
+						bHighQuality ? 0.25f : 1.0f, eighth[y][x]);
+					if (bHighQuality)
+						Store(m_BloomBuffers[3][0], blockX / 4 + x, blockY / 4 + y, eighth[y][x]);
+				}
+			}
+
+			Average4(eighth[0][0], eighth[0][1], eighth[1][0], eighth[1][1], bHighQuality ? 0.25f : 0.0625f, sixteenth);
+			Store(m_BloomBuffers[4][0], blockX / 8, blockY / 8, sixteenth);
+		}
+		break;
+	}
+
+	case kBlurLoadPhase:
+	{
+		// What each thread puts in LDS, rounded to half as it goes in. UpsampleAndBlurCS works out where to sample from the even pixel of
+		// each pair, so the odd one's UV is a step on from that rather than its own centre
+		const Image& higher = *m_BlurHigher;
+		const float inverseWidth = 1.0f / (float)higher.m_Width;
+		const float inverseHeight = 1.0f / (float)higher.m_Height;
+		const uint32_t row0 = job * kBlurRowsPerJob, row1 = std::min(row0 + kBlurRowsPerJob, m_BlurInput.m_Height);
+
+		for (uint32_t row = row0; row < row1; ++row)
+		{
+			const int32_t y = (int32_t)row - kBlurRadius;
+			const int32_t evenY = y & ~1;
+			const float v = (y & 1) != 0 ? ((float)evenY + 0.5f) * inverseHeight + inverseHeight : ((float)y + 0.5f) * inverseHeight;
+
+			for (uint32_t column = 0; column < m_BlurInput.m_Width; ++column)
+			{
+				const int32_t x = (int32_t)column - kBlurRadius;
+				float pixel[3];
+				if (m_BlurLower != nullptr)
+				{
+					const int32_t evenX = x & ~1;
+					const float u = (x & 1) != 0 ? ((float)evenX + 0.5f) * inverseWidth + inverseWidth : ((float)x + 0.5f) * inverseWidth;
+					UpsamplePixel(higher, *m_BlurLower, m_BlurFactor, x, y, u, v, pixel);
+				}
+				else
+				{
+					Load(higher, x, y, pixel);
+				}
+
+				float* input = m_BlurInput.GetPixel(column, row);
+				for (uint32_t c = 0; c < 3; ++c)
+					input[c] = RoundToHalf(pixel[c]);
+			}
+		}
+		break;
+	}
+
+	case kBlurHorizontalPhase:
+	{
+		const uint32_t row0 = job * kBlurRowsPerJob, row1 = std::min(row0 + kBlurRowsPerJob, m_BlurHorizontal.m_Height);
+		for (uint32_t row = row0; row < row1; ++row)
+		{
+			for (uint32_t x = 0; x < m_BlurHorizontal.m_Width; ++x)
+			{
+				const float* taps = m_BlurInput.GetPixel(x, row);
+				float* blurred = m_BlurHorizontal.GetPixel(x, row);
+				for (uint32_t c = 0; c < 3; ++c)
+					blurred[c] = Blur9(taps + c, 3);
+			}
+		}
+		break;
+	}
+
+	case kBlurVerticalPhase:
+	{
+		Image& output = *m_BlurOutput;
+		const size_t rowStride = (size_t)m_BlurHorizontal.m_Width * 3;
+		const uint32_t y0 = job * kBlurRowsPerJob, y1 = std::min(y0 + kBlurRowsPerJob, output.m_Height);
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			for (uint32_t x = 0; x < output.m_Width; ++x)
+			{
+				const float* taps = m_BlurHorizontal.GetPixel(x, y);
+				float blurred[3];
+				for (uint32_t c = 0; c < 3; ++c)
+					blurred[c] = Blur9(taps + c, rowStride);
+				Store(output, x, y, blurred);
+			}
+		}
+		break;
+	}
+
+	case kToneMapPhase:
+	{
+		const Image& scene = *m_Scene;
+		const float rcpWidth = 1.0f / (float)scene.m_Width;
+		const float rcpHeight = 1.0f / (float)scene.m_Height;
+		const float exposure = m_Exposure.m_Values[0];
+
+		const uint32_t x0 = (job % m_TilesX) * kTileSize, y0 = (job / m_TilesX) * kTileSize;
+		const uint32_t x1 = std::min(x0 + kTileSize, scene.m_Width), y1 = std::min(y0 + kTileSize, scene.m_Height);
+		for (uint32_t y = y0; y < y1; ++y)
+		{
+			for (uint32_t x = x0; x < x1; ++x)
+			{
+				// Without bloom the shader samples a black texture instead
+				float bloom[3] = { 0.0f, 0.0f, 0.0f };
+				if (settings.m_bEnableBloom)
+					Sample(m_BloomBuffers[0][1], ((float)x + 0.5f) * rcpWidth, ((float)y + 0.5f) * rcpHeight, kClamp, bloom);
+
+				float output[3];
+				const float luma = ToneMapPixel(scene.GetPixel(x, y), bloom, settings, exposure, output);
+				Store(result.m_Output, x, y, output);
+				result.m_Luma[(size_t)y * scene.m_Width + x] = StoreUnorm8(luma);
+			}
+		}
+		break;
+	}
+	}
+}
+
+//===============================================================================
+
+namespace
+{
+	// BlurCS when lower is null, otherwise UpsampleAndBlurCS, a group at a time
+	void BlurReference(const Image& higher, const Image* lower, float upsampleBlendFactor, Image& output)
+	{
+		const float inverseDimensions[2] = { 1.0f / (float)higher.m_Width, 1.0f / (float)higher.m_Height };
+		uint32_t cacheR[128], cacheG[128], cacheB[128];
+
+		auto store2Pixels = [&](uint32_t index, const float pixel1[3], const float pixel2[3])
+		{
+			cacheR[index] = FloatToHalf(pixel1[0]) | FloatToHalf(pixel2[0]) << 16;
+			cacheG[index] = FloatToHalf(pixel1[1]) | FloatToHalf(pixel2[1]) << 16;
+			cacheB[index] = FloatToHalf(pixel1[2]) | FloatToHalf(pixel2[2]) << 16;
+		};
+		auto load2Pixels = [&](uint32_t index, float pixel1[3], float pixel2[3])
+		{
+			pixel1[0] = HalfToFloat(cacheR[index] & 0xFFFF);
+			pixel1[1] = HalfToFloat(cacheG[index] & 0xFFFF);
+			pixel1[2] = HalfToFloat(cacheB[index] & 0xFFFF);
+			pixel2[0] = HalfToFloat(cacheR[index] >> 16);
+			pixel2[1] = HalfToFloat(cacheG[index] >> 16);
+			pixel2[2] = HalfToFloat(cacheB[index] >> 16);
+		};
+		auto store1Pixel = [&](uint32_t index, const float pixel[3])
+		{
+			cacheR[index] = AsUint(pixel[0]);
+			cacheG[index] = AsUint(pixel[1]);
+			cacheB[index] = AsUint(pixel[2]);
+		};
+		auto load1Pixel = [&](uint32_t index, float pixel[3])
+		{
+			pixel[0] = AsFloat(cacheR[index]);
+			pixel[1] = AsFloat(cacheG[index]);
+			pixel[2] = AsFloat(cacheB[index]);
+		};
+
+		for (uint32_t groupY = 0; groupY < DivideUp(higher.m_Height, 8); ++groupY)
+		{
+			for (uint32_t groupX = 0; groupX < DivideUp(higher.m_Width, 8); ++groupX)
+			{
+				const int32_t groupUL[2] = { (int32_t)(groupX << 3) - 4, (int32_t)(groupY << 3) - 4 };
+
+				// Load 4 pixels per thread into LDS
+				for (uint32_t threadY = 0; threadY < 8; ++threadY)
+				{
+					for (uint32_t threadX = 0; threadX < 8; ++threadX)
+					{
+						const int32_t threadUL[2] = { (int32_t)(threadX << 1) + groupUL[0], (int32_t)(threadY << 1) + groupUL[1] };
+						const uint32_t destIdx = threadX + (threadY << 4);
+
+						float pixels[4][3];
+						if (lower != nullptr)
+						{
+							const float uvUL[2] = { ((float)threadUL[0] + 0.5f) * inverseDimensions[0], ((float)threadUL[1] + 0.5f) * inverseDimensions[1] };
+							const float uvLR[2] = { uvUL[0] + inverseDimensions[0], uvUL[1] + inverseDimensions[1] };
+							UpsamplePixel(higher, *lower, upsampleBlendFactor, threadUL[0], threadUL[1], uvUL[0], uvUL[1], pixels[0]);
+							UpsamplePixel(higher, *lower, upsampleBlendFactor, threadUL[0] + 1, threadUL[1], uvLR[0], uvUL[1], pixels[1]);
+							UpsamplePixel(higher, *lower, upsampleBlendFactor, threadUL[0], threadUL[1] + 1, uvUL[0], uvLR[1], pixels[2]);
+							UpsamplePixel(higher, *lower, upsampleBlendFactor, threadUL[0] + 1, threadUL[1] + 1, uvLR[0], uvLR[1], pixels[3]);
+						}
+						else
+						{
+							for (uint32_t i = 0; i < 4; ++i)
+								Load(higher, threadUL[0] + (int32_t)(i & 1), threadUL[1] + (int32_t)(i >> 1), pixels[i]);
+						}
+						store2Pixels(destIdx + 0, pixels[0], pixels[1]);
+						store2Pixels(destIdx + 8, pixels[2], pixels[3]);
+					}
+				}
+
+				// Horizontally blur the pixels in the cache. Every thread has loaded before any stores, as BlurCS has a barrier between. The
+				// upsample shader doesn't, but its threads run in lockstep, which comes to the same thing
+				float taps[64][10][3];
+				for (uint32_t thread = 0; thread < 64; ++thread)
+				{
+					const uint32_t threadX = thread & 7, threadY = thread >> 3;
+					const uint32_t leftMostIndex = (threadY << 4) + threadX + (threadX & 4);
+					for (uint32_t i = 0; i < 5; ++i)
+						load2Pixels(leftMostIndex + i, taps[thread][i * 2], taps[thread][i * 2 + 1]);
+				}
+				for (uint32_t thread = 0; thread < 64; ++thread)
+				{
+					const uint32_t threadX = thread & 7, threadY = thread >> 3;
+					const uint32_t outIndex = (threadY << 4) + (threadX << 1);
+					float blurred[2][3];
+					for (uint32_t c = 0; c < 3; ++c)
+					{
+						blurred[0][c] = Blur9(&taps[thread][0][c], 3);
+						blurred[1][c] = Blur9(&taps[thread][1][c], 3);
+					}
+					store1Pixel(outIndex, blurred[0]);
+					store1Pixel(outIndex + 1, blurred[1]);
+				}
+
+				// Vertically blur the pixels and write the result to memory
+				for (uint32_t threadY = 0; threadY < 8; ++threadY)
+				{
+					for (uint32_t threadX = 0; threadX < 8; ++threadX)
+					{
+						const uint32_t topMostIndex = (threadY << 3) + threadX;
+						float column[9][3];
+						for (uint32_t i = 0; i < 9; ++i)
+							load1Pixel(topMostIndex + i * 8, column[i]);
+
+						float blurred[3];
+						for (uint32_t c = 0; c < 3; ++c)
+							blurred[c] = Blur9(&column[0][c], 3);
+
+						const uint32_t x = (groupX << 3) + threadX, y = (groupY << 3) + threadY;
+						if (x < output.m_Width && y < output.m_Height)
+							Store(output, x, y, blurred);
+					}
+				}
+			}
+		}
+	}
+
+	// DownsampleBloomAllCS, or DownsampleBloomCS for low quality, a group at a time
+	void DownsampleReference(Image bloom[5][2], bool bHighQuality)
+	{
+		const Image& source = bloom[0][0];
+		const float inverseDimensions[2] = { 1.0f / (float)source.m_Width, 1.0f / (float)source.m_Height };
+
+		for (uint32_t groupY = 0; groupY < (source.m_Height / 2) / 8; ++groupY)
+		{
+			for (uint32_t groupX = 0; groupX < (source.m_Width / 2) / 8; ++groupX)
+			{
+				float tile[64][3];
+				float avgPixel[64][3];
+
+				auto dispatchThreadID = [&](uint32_t groupIndex, uint32_t& x, uint32_t& y)
+				{
+					x = (groupX << 3) + (groupIndex & 7);
+					y = (groupY << 3) + (groupIndex >> 3);
+				};
+
+				for (uint32_t gi = 0; gi < 64; ++gi)
+				{
+					uint32_t x, y;
+					dispatchThreadID(gi, x, y);
+					const float u = ((float)x * 2.0f + 1.0f) * inverseDimensions[0];
+					const float v = ((float)y * 2.0f + 1.0f) * inverseDimensions[1];
+					Sample(source, u, v, kClamp, avgPixel[gi]);
+					std::memcpy(tile[gi], avgPixel[gi], sizeof(tile[gi]));
+					if (bHighQuality)
+						Store(bloom[1][0], x, y, avgPixel[gi]);
+				}
+
+				for (uint32_t gi = 0; gi < 64; ++gi)
+				{
+					uint32_t x, y;
+					dispatchThreadID(gi, x, y);
+					if (((x | y) & 1) == 0)
+					{
+						Average4(avgPixel[gi], tile[gi + 1], tile[gi + 8], tile[gi + 9], 0.25f, avgPixel[gi]);
+						std::memcpy(tile[gi], avgPixel[gi], sizeof(tile[gi]));
+						Store(bloom[2][0], x >> 1, y >> 1, avgPixel[gi]);
+					}
+				}
+
+				for (uint32_t gi = 0; gi < 64; ++gi)
+				{
+					uint32_t x, y;
+					dispatchThreadID(gi, x, y);
+					if (((x | y) & 3) == 0)
+					{
+						Average4(avgPixel[gi], tile[gi + 2], tile[gi + 16], tile[gi + 18], bHighQuality ? 0.25f : 1.0f, avgPixel[gi]);
+						std::memcpy(tile[gi], avgPixel[gi], sizeof(tile[gi]));
+						if (bHighQuality)
+							Store(bloom[3][0], x >> 2, y >> 2, avgPixel[gi]);
+					}
+				}
+
+				for (uint32_t gi = 0; gi < 64; ++gi)
+				{
+					uint32_t x, y;
+					dispatchThreadID(gi, x, y);
+					if (((x | y) & 7) == 0)
+					{
+						Average4(avgPixel[gi], tile[gi + 4], tile[gi + 32], tile[gi + 36], bHighQuality ? 0.25f : 0.0625f, avgPixel[gi]);
+						Store(bloom[4][0], x >> 3, y >> 3, avgPixel[gi]);
+					}
+				}
+			}
+		}
+	}
+}
+
+void ToneMapReference::ProcessFrameReference(const Image& hdr, const Settings& settings, ExposureState& exposure, FrameResult& result)
+{
+	const ExposureState frameExposure = exposure;
+	result.m_Exposure = exposure;
+
+	uint32_t bloomWidth, bloomHeight;
+	GetBloomSize(hdr.m_Width, hdr.m_Height, bloomWidth, bloomHeight);
+	const float inverseBloomSize[2] = { 1.0f / (float)bloomWidth, 1.0f / (float)bloomHeight };
+
+	result.m_LumaLR.assign((size_t)bloomWidth * bloomHeight, 0);
+	std::memset(result.m_Histogram, 0, sizeof(result.m_Histogram));
+
+	Image bloom[5][2];
+	if (settings.m_bEnableBloom)
+	{
+		for (uint32_t level = 0; level < 5; ++level)
+		{
+			bloom[level][0].Resize(bloomWidth >> level, bloomHeight >> level);
+			bloom[level][1].Resize(bloomWidth >> level, bloomHeight >> level);
+		}
+	}
+
+	if (settings.m_bEnableBloom || settings.m_bEnableAdaptation)
+	{
+		for (uint32_t y = 0; y < bloomHeight; ++y)
+		{
+			for (uint32_t x = 0; x < bloomWidth; ++x)
+			{
+				uint8_t luma;
+				if (settings.m_bEnableBloom)
+				{
+					float pixel[3];
+					ExtractBloomPixel(hdr, x, y, inverseBloomSize[0], inverseBloomSize[1], settings.m_BloomThreshold, frameExposure, pixel, luma);
+					Store(bloom[0][0], x, y, pixel);
+				}
+				else
+				{
+					luma = ExtractLumaPixel(hdr, x, y, inverseBloomSize[0], inverseBloomSize[1], frameExposure);
+				}
+				result.m_LumaLR[(size_t)y * bloomWidth + x] = luma;
+			}
+		}
+
+		// GenerateHistogramCS: a 16 column strip per group, each thread walking down its column 16 rows at a time into a group histogram
+		for (uint32_t groupX = 0; groupX < DivideUp(bloomWidth, 16); ++groupX)
+		{
+			uint32_t tileHistogram[kHistogramBins] = {};
+			for (uint32_t threadY = 0; threadY < 16; ++threadY)
+			{
+				for (uint32_t threadX = 0; threadX < 16; ++threadX)
+				{
+					const uint32_t x = groupX * 16 + threadX;
+					for (uint32_t y = threadY; y < bloomHeight; y += 16)
+						++tileHistogram[x < bloomWidth ? result.m_LumaLR[(size_t)y * bloomWidth + x] : 0];
+				}
+			}
+			for (uint32_t bin = 0; bin < kHistogramBins; ++bin)
+				result.m_Histogram[bin] += tileHistogram[bin];
+		}
+	}
+
+	if (settings.m_bEnableBloom)
+	{
+		DownsampleReference(bloom, settings.m_bHighQualityBloom);
+
+		if (settings.m_bHighQualityBloom)
+		{
+			const float upsampleBlendFactor = settings.m_BloomUpsampleFactor;
+			BlurReference(bloom[4][0], nullptr, 1.0f, bloom[4][1]);
+			BlurReference(bloom[3][0], &bloom[4][1], upsampleBlendFactor, bloom[3][1]);
+			BlurReference(bloom[2][0], &bloom[3][1], upsampleBlendFactor, bloom[2][1]);
+			BlurReference(bloom[1][0], &bloom[2][1], upsampleBlendFactor, bloom[1][1]);
+			BlurReference(bloom[0][0], &bloom[1][1], upsampleBlendFactor, bloom[0][1]);
+		}
+		else
+		{
+			const float upsampleBlendFactor = settings.m_BloomUpsampleFactor * 2.0f / 3.0f;
+			BlurReference(bloom[4][0], nullptr, 1.0f, bloom[4][1]);
+			BlurReference(bloom[2][0], &bloom[4][1], upsampleBlendFactor, bloom[2][1]);
+			BlurReference(bloom[0][0], &bloom[2][1], upsampleBlendFactor, bloom[0][1]);
+		}
+		result.m_Bloom = bloom[0][1];
+	}
+	else
+	{
+		result.m_Bloom = Image();
+	}
+
+	// ToneMapCS
+	result.m_Output.Resize(hdr.m_Width, hdr.m_Height);
+	result.m_Luma.assign((size_t)hdr.m_Width * hdr.m_Height, 0);
+	const float rcpBufferDim[2] = { 1.0f / (float)hdr.m_Width, 1.0f / (float)hdr.m_Height };
+	for (uint32_t groupY = 0; groupY < DivideUp(hdr.m_Height, 8); ++groupY)
+	{
+		for (uint32_t groupX = 0; groupX < DivideUp(hdr.m_Width, 8); ++groupX)
+		{
+			for (uint32_t gi = 0; gi < 64; ++gi)
+			{
+				const uint32_t x = groupX * 8 + (gi & 7), y = groupY * 8 + (gi >> 3);
+				if (x >= hdr.m_Width || y >= hdr.m_Height)
+					continue;
+
+				float bloomSample[3] = { 0.0f, 0.0f, 0.0f };
+				if (settings.m_bEnableBloom)
+					Sample(bloom[0][1], ((float)x + 0.5f) * rcpBufferDim[0], ((float)y + 0.5f) * rcpBufferDim[1], kClamp, bloomSample);
+
+				float output[3];
+				const float luma = ToneMapPixel(hdr.GetPixel(x, y), bloomSample, settings, frameExposure.m_Values[0], output);
+				Store(result.m_Output, x, y, output);
+				result.m_Luma[(size_t)y * hdr.m_Width + x] = StoreUnorm8(luma);
+			}
+		}
+	}
+
+	UpdateExposure(result, bloomWidth * bloomHeight, settings, exposure);
+}
+
+//===============================================================================
+
+void ToneMapReference::PackFrame(const Image& image, std::vector<uint32_t>& packed)
+{
+	packed.resize((size_t)image.m_Width * image.m_Height);
+	for (size_t i = 0; i < packed.size(); ++i)
+		packed[i] = PackR11G11B10(&image.m_RGB[i * 3]);
+}
+
+void ToneMapReference::UnpackFrame(const std::vector<uint32_t>& packed, uint32_t width, uint32_t height, Image& image, FrameFormat format)
+{
+	EnsureSize(image, width, height);
+	if (format == kFrameFormatR10G10B10A2Unorm)
+	{
+		// As a UNORM SRV reads it. Alpha isn't used by anything post effects does
+		for (size_t i = 0; i < (size_t)width * height; ++i)
+		{
+			for (uint32_t channel = 0; channel < 3; ++channel)
+				image.m_RGB[i * 3 + channel] = (float)((packed[i] >> (channel * 10)) & 0x3FF) / 1023.0f;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < (size_t)width * height; ++i)
+			UnpackR11G11B10(packed[i], &image.m_RGB[i * 3]);
+	}
+}
+
+bool ToneMapReference::LoadFrames(const std::wstring& fileName, FrameSequence& sequence)
+{
+	sequence = FrameSequence();
+
+	FILE* file = OpenFile(fileName, false);
+	if (file == nullptr)
+		return false;
+
+	FrameFileHeader header = {};
+	bool bValid = std::fread(&header, offsetof(FrameFileHeader, m_Format), 1, file) == 1 &&
+		std::memcmp(header.m_Magic, kFrameFileMagic, sizeof(kFrameFileMagic)) == 0 && (header.m_Version == 1 || header.m_Version == kFrameFileVersion);
+	if (bValid && header.m_Version == kFrameFileVersion)
+		bValid = std::fread(&header.m_Format, sizeof(header.m_Format), 1, file) == 1;
+	bValid = bValid && header.m_Width > 0 && header.m_Height > 0 && header.m_Width <= kMaxFrameDimension && header.m_Height <= kMaxFrameDimension &&
+		header.m_Format < kFrameFormatCount;
+
+	// Frames are read one at a time, so a count that's more than the file holds runs out rather than allocating it all up front
+	const size_t pixelCount = (size_t)header.m_Width * header.m_Height;
+	for (uint32_t frame = 0; bValid && frame < header.m_FrameCount; ++frame)
+	{
+		std::vector<uint32_t> packed(pixelCount);
+		bValid = std::fread(packed.data(), sizeof(uint32_t), pixelCount, file) == pixelCount;
+		if (bValid)
+			sequence.m_Frames.push_back(std::move(packed));
+	}
+	std::fclose(file);
+
+	if (!bValid)
+	{
+		sequence = FrameSequence();
+		return false;
+	}
+
+	sequence.m_Width = header.m_Width;
+	sequence.m_Height = header.m_Height;
+	sequence.m_Format = (FrameFormat)header.m_Format;
+	return true;
+}
+
+bool ToneMapReference::FrameWriter::Open(const std::wstring& fileName, uint32_t width, uint32_t height, FrameFormat format)
+{
+	Close();
+	if (width == 0 || height == 0 || width > kMaxFrameDimension || height > kMaxFrameDimension || format >= kFrameFormatCount)
+		return false;
+
+	m_File = OpenFile(fileName, true);
+	if (m_File == nullptr)
+		return false;
+
+	m_Width = width;
+	m_Height = height;
+	m_Format = format;
+	m_FrameCount = 0;
+
+	FrameFileHeader header = {};
+	std::memcpy(header.m_Magic, kFrameFileMagic, sizeof(kFrameFileMagic));
+	header.m_Version = kFrameFileVersion;
+	header.m_Width = width;
+	header.m_Height = height;
+	header.m_Format = format;
+	m_bFailed = std::fwrite(&header, sizeof(header), 1, m_File) != 1;
+	return !m_bFailed;
+}
+
+bool ToneMapReference::FrameWriter::Write(const uint32_t* packed)
+{
+	if (m_File == nullptr || m_bFailed)
+		return false;
+
+	const size_t pixelCount = (size_t)m_Width * m_Height;
+	m_bFailed = std::fwrite(packed, sizeof(uint32_t), pixelCount, m_File) != pixelCount;
+	if (!m_bFailed)
+		++m_FrameCount;
+	return !m_bFailed;
+}
+
+bool ToneMapReference::FrameWriter::Close(void)
+{
+	if (m_File == nullptr)
+		return false;
+
+	// The count goes in last, so a capture cut short by a failed write still loads as the frames that made it
+	bool bSuccess = std::fseek(m_File, offsetof(FrameFileHeader, m_FrameCount), SEEK_SET) == 0 &&
+		std::fwrite(&m_FrameCount, sizeof(m_FrameCount), 1, m_File) == 1;
+	bSuccess = std::fclose(m_File) == 0 && bSuccess && !m_bFailed;
+	m_File = nullptr;
+	return bSuccess;
+}
+
+//===============================================================================
+
+namespace
+{
+	// A dim interior opening onto a bright exterior, with small bright lights scattered over both - some a pixel or two across at full
+	// resolution, so a lower resolution catches them differently from one frame to the next
+	class SyntheticScene
+	{
+	public:
+		static constexpr float kWorldWidth = 3.0f;
+		static constexpr float kWorldHeight = 0.5625f;
+		static constexpr float kCellSize = 0.0625f;
+
+		explicit SyntheticScene(uint64_t seed)
+		{
+			m_CellsX = (uint32_t)(kWorldWidth / kCellSize);
+			m_CellsY = (uint32_t)(kWorldHeight / kCellSize) + 1;
+			m_Lights.resize((size_t)m_CellsX * m_CellsY);
+
+			// A stream per cell, so the lights don't depend on the order they're made in
+			for (uint32_t cell = 0; cell < (uint32_t)m_Lights.size(); ++cell)
+			{
+				CounterRNG::Stream random(seed, cell);
+				Light& light = m_Lights[cell];
+				light.m_bPresent = random.NextFloat() < 0.4f;
+				light.m_Radius = random.NextFloat(0.0008f, 0.006f);
+				light.m_Center[0] = random.NextFloat(light.m_Radius, kCellSize - light.m_Radius);
+				light.m_Center[1] = random.NextFloat(light.m_Radius, kCellSize - light.m_Radius);
+				const float intensity = random.NextFloat(20.0f, 400.0f);
+				for (uint32_t c = 0; c < 3; ++c)
+					light.m_Radiance[c] = intensity * random.NextFloat(0.6f, 1.0f);
+			}
+		}
+
+		void GetRadiance(float worldX, float worldY, float rgb[3]) const
+		{
+			const float t = std::min(std::max((worldX - 1.2f) / 0.6f, 0.0f), 1.0f);
+			const float daylight = t * t * (3.0f - 2.0f * t);
+
+			// Fine detail, finer than the low resolution run resolves
+			const bool bChecker = (((int32_t)std::floor(worldX * 160.0f) + (int32_t)std::floor(worldY * 160.0f)) & 1) != 0;
+			const float albedo = bChecker ? 0.9f : 0.25f;
+
+			const float interior[3] = { 0.03f, 0.025f, 0.02f };
+			const float exterior[3] = { 2.2f, 2.6f, 3.2f };
+			for (uint32_t c = 0; c < 3; ++c)
+				rgb[c] = (interior[c] + (exterior[c] - interior[c]) * daylight) * albedo;
+
+			const int32_t cellX = (int32_t)std::floor(worldX / kCellSize);
+			const int32_t cellY = (int32_t)std::floor(worldY / kCellSize);
+			if (cellX < 0 || cellY < 0 || cellX >= (int32_t)m_CellsX || cellY >= (int32_t)m_CellsY)
+				return;
+
+			const Light& light = m_Lights[(size_t)cellY * m_CellsX + cellX];
+			const float dx = worldX - ((float)cellX * kCellSize + light.m_Center[0]);
+			const float dy = worldY - ((float)cellY * kCellSize + light.m_Center[1]);
+			if (light.m_bPresent && dx * dx + dy * dy < light.m_Radius * light.m_Radius)
+			{
+				for (uint32_t c = 0; c < 3; ++c)
+					rgb[c] += light.m_Radiance[c];
+			}
+		}
+
+		// The camera pans from the interior out into daylight, one world unit across the frame
+		void Render(float cameraX, uint32_t width, uint32_t height, Image& image) const
+		{
+			EnsureSize(image, width, height);
+			const float pixelSize = 1.0f / (float)width;
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+					GetRadiance(cameraX + ((float)x + 0.5f) * pixelSize, ((float)y + 0.5f) * pixelSize, image.GetPixel(x, y));
+			}
+		}
+
+	private:
+		struct Light
+		{
+			bool m_bPresent;
+			float m_Center[2];
+			float m_Radius;
+			float m_Radiance[3];
+		};
+
+		uint32_t m_CellsX;
+		uint32_t m_CellsY;
+		std::vector<Light> m_Lights;
+	};
+
+	// Bilinear, from the centre of each destination pixel - what an upscaler does at its simplest
+	void Resample(const Image& source, uint32_t width, uint32_t height, Image& destination)
+	{
+		EnsureSize(destination, width, height);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+				Sample(source, ((float)x + 0.5f) / (float)width, ((float)y + 0.5f) / (float)height, kClamp, destination.GetPixel(x, y));
+		}
+	}
+
+	// Through the scene buffer's format, as a capture would be
+	void Quantise(Image& image)
+	{
+		for (size_t i = 0; i < image.m_RGB.size(); i += 3)
+			UnpackR11G11B10(PackR11G11B10(&image.m_RGB[i]), &image.m_RGB[i]);
+	}
+
+	bool Matches(const Image& a, const Image& b)
+	{
+		return a.m_Width == b.m_Width && a.m_Height == b.m_Height && std::memcmp(a.m_RGB.data(), b.m_RGB.data(), a.m_RGB.size() * sizeof(float)) == 0;
+	}
+
+	bool Matches(const ExposureState& a, const ExposureState& b)
+	{
+		return std::memcmp(a.m_Values, b.m_Values, sizeof(a.m_Values)) == 0;
+	}
+
+	bool Matches(const FrameResult& a, const FrameResult& b)
+	{
+		return Matches(a.m_Output, b.m_Output) && a.m_Luma == b.m_Luma && a.m_LumaLR == b.m_LumaLR &&
+			std::memcmp(a.m_Histogram, b.m_Histogram, sizeof(a.m_Histogram)) == 0 && Matches(a.m_Bloom, b.m_Bloom) && Matches(a.m_Exposure, b.m_Exposure);
+	}
+
+	double MeanAbsoluteDifference(const Image& a, const Image& b)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < a.m_RGB.size(); ++i)
+			sum += std::fabs((double)a.m_RGB[i] - (double)b.m_RGB[i]);
+		return a.m_RGB.empty() ? 0.0 : sum / (double)a.m_RGB.size();
+	}
+}
+
+ToneMapReference::BenchmarkResult ToneMapReference::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+
+	Processor processor;
+	result.m_Workers = processor.GetWorkerCount();
+
+	FrameSequence capture, upscaled;
+	result.m_bFromCapture = !desc.m_CaptureFile.empty() && LoadFrames(desc.m_CaptureFile, capture) && !capture.m_Frames.empty();
+	result.m_bUpscaledFromCapture = result.m_bFromCapture && !desc.m_UpscaledCaptureFile.empty() && LoadFrames(desc.m_UpscaledCaptureFile, upscaled) &&
+		!upscaled.m_Frames.empty() && upscaled.m_Width == capture.m_Width && upscaled.m_Height == capture.m_Height;
+	result.m_CaptureFrames = (uint32_t)capture.m_Frames.size();
+
+	const uint32_t width = result.m_bFromCapture ? capture.m_Width : desc.m_Width;
+	const uint32_t height = result.m_bFromCapture ? capture.m_Height : desc.m_Height;
+	uint32_t frames = result.m_bFromCapture ? std::min(desc.m_Frames, (uint32_t)capture.m_Frames.size()) : desc.m_Frames;
+	if (result.m_bUpscaledFromCapture)
+		frames = std::min(frames, (uint32_t)upscaled.m_Frames.size());
+	const uint32_t lowWidth = std::max((uint32_t)((float)width * desc.m_LowResolutionScale + 0.5f), 8u);
+	const uint32_t lowHeight = std::max((uint32_t)((float)height * desc.m_LowResolutionScale + 0.5f), 8u);
+
+	const SyntheticScene scene(desc.m_Seed);
+
+	Settings replaySettings = desc.m_Settings;
+	replaySettings.m_bFreezeExposure = true;
+
+	ExposureState exposure[2] = { ExposureState::Initial(desc.m_Settings.m_Exposure), ExposureState::Initial(desc.m_Settings.m_Exposure) };
+	ExposureState referenceExposure[2] = { exposure[0], exposure[1] };
+
+	Image full, low, lowRendered;
+	FrameResult processed[2], reference, replayed;
+	double processorSeconds = 0.0, referenceSeconds = 0.0;
+
+	for (uint32_t frame = 0; frame < frames && result.m_bValid; ++frame)
+	{
+		if (result.m_bUpscaledFromCapture)
+		{
+			// Both runs came off the GPU, so neither needs quantising
+			UnpackFrame(capture.m_Frames[frame], width, height, full, capture.m_Format);
+			UnpackFrame(upscaled.m_Frames[frame], width, height, low, upscaled.m_Format);
+		}
+		else
+		{
+			if (result.m_bFromCapture)
+			{
+				UnpackFrame(capture.m_Frames[frame], width, height, full, capture.m_Format);
+				Resample(full, lowWidth, lowHeight, lowRendered);
+			}
+			else
+			{
+				const float cameraX = 2.0f * (float)frame / (float)std::max(frames - 1, 1u);
+				scene.Render(cameraX, width, height, full);
+				scene.Render(cameraX, lowWidth, lowHeight, lowRendered);
+				Quantise(full);
+			}
+			Resample(lowRendered, width, height, low);
+			Quantise(low);
+		}
+
+		const Image* inputs[2] = { &full, &low };
+		for (uint32_t run = 0; run < 2 && result.m_bValid; ++run)
+		{
+			auto start = std::chrono::steady_clock::now();
+			processor.ProcessFrame(*inputs[run], desc.m_Settings, exposure[run], processed[run]);
+			processorSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			start = std::chrono::steady_clock::now();
+			ProcessFrameReference(*inputs[run], desc.m_Settings, referenceExposure[run], reference);
+			referenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			result.m_bValid = Matches(processed[run], reference) && Matches(exposure[run], referenceExposure[run]);
+		}
+		if (!result.m_bValid)
+			break;
+
+		// Replaying the full resolution run's exposure over its own frame has to give back that frame, and over the low resolution frame has
+		// to leave the recorded exposure exactly as it was
+		ExposureState replayExposure = processed[0].m_Exposure;
+		processor.ProcessFrame(full, replaySettings, replayExposure, replayed);
+		result.m_bValid = Matches(replayed, processed[0]) && Matches(replayExposure, processed[0].m_Exposure);
+
+		processor.ProcessFrame(low, replaySettings, replayExposure, replayed);
+		result.m_bValid = result.m_bValid && Matches(replayExposure, processed[0].m_Exposure) && Matches(replayed.m_Exposure, processed[0].m_Exposure);
+
+		result.m_MaxExposureDivergence = std::max(result.m_MaxExposureDivergence,
+			std::fabs(std::log2(processed[0].m_Exposure.GetExposure() / processed[1].m_Exposure.GetExposure())));
+		result.m_AdaptedOutputError += MeanAbsoluteDifference(processed[0].m_Output, processed[1].m_Output);
+		result.m_ReplayedOutputError += MeanAbsoluteDifference(processed[0].m_Output, replayed.m_Output);
+		++result.m_FramesRun;
+	}
+
+	const double runs = (double)std::max(result.m_FramesRun, 1u);
+	result.m_ProcessorMs = processorSeconds * 1000.0 / (runs * 2.0);
+	result.m_ReferenceMs = referenceSeconds * 1000.0 / (runs * 2.0);
+	result.m_AdaptedOutputError /= runs;
+	result.m_ReplayedOutputError /= runs;
+	return result;
+}
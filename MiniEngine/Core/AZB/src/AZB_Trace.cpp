@@ -0,0 +1,443 @@
+//===============================================================================
+// desc: A streaming timeline exporter for the engine profiler. Every timed scope is recorded into a lock-free buffer owned by the thread that ran it,
+//       and a background thread drains those buffers to disk as either Chrome trace JSON (chrome://tracing, ui.perfetto.dev) or a compact binary stream.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_Trace.h"
+#include "AZB_TimeSeries.h"	// For the SPSC ring buffer
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//===============================================================================
+
+namespace Trace
+{
+	namespace Internal
+	{
+		std::atomic<bool> s_bCapturing(false);
+	}
+}
+
+namespace
+{
+	// 24 bytes per scope. Raw ticks so the producer never has to do any maths
+	struct Event
+	{
+		int64_t m_StartTick;
+		int64_t m_EndTick;
+		uint32_t m_NameId;
+		uint8_t m_Track;
+	};
+
+	// Roughly 16 frames worth of a busy thread. The writer wakes far more often than that so this should only overflow if the disk stalls
+	constexpr uint32_t kEventsPerThread = 8192;
+	constexpr uint32_t kBinaryVersion = 1;
+	constexpr uint32_t kWriterIntervalMs = 5;
+	constexpr uint32_t kGpuProcessId = 2;
+	constexpr uint32_t kCpuProcessId = 1;
+
+	struct ThreadBuffer
+	{
+		uint32_t m_ThreadId = 0;
+		uint32_t m_AnnouncedCapture = 0;	// Only touched by the writer thread
+		PerfHistory::SpscRingBuffer<Event, kEventsPerThread> m_Events;
+	};
+
+	// Buffers are owned here and live until shutdown - a thread's events can still be drained after it exits
+	std::mutex s_RegistryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> s_Threads;
+	thread_local ThreadBuffer* t_Buffer = nullptr;
+
+	std::mutex s_NameMutex;
+	std::vector<std::string> s_Names;	// Index is nameId - 1
+
+	std::atomic<uint64_t> s_DroppedEvents(0);
+
+	// Writer state. Only the writer thread touches the file once it has started
+	std::thread s_Writer;
+	std::mutex s_WriterMutex;
+	std::condition_variable s_WriterWake;
+	bool s_bStopRequested = false;
+
+	std::ofstream s_File;
+	Trace::eFormat s_Format = Trace::CHROME_JSON;
+	int64_t s_BaseTick = 0;
+	double s_MicrosecondsPerTick = 0.0;
+	uint32_t s_CaptureIndex = 0;
+
+	// Writer thread private
+	size_t s_NamesWritten = 0;
+	std::vector<std::string> s_JsonNames;	// Pre-escaped
+	bool s_bFirstJsonEvent = true;
+	std::string s_Scratch;
+
+	ThreadBuffer* RegisterThread(void)
+	{
+		std::lock_guard<std::mutex> lock(s_RegistryMutex);
+		s_Threads.emplace_back(new ThreadBuffer);
+		ThreadBuffer* buffer = s_Threads.back().get();
+		buffer->m_ThreadId = (uint32_t)s_Threads.size() - 1;
+		return buffer;
+	}
+
+	// wchar_t is UTF-16 on Windows and UTF-32 elsewhere, so handle surrogate pairs when they turn up
+	std::string ToUTF8(const std::wstring& in)
+	{
+		std::string out;
+		out.reserve(in.size());
+		for (size_t i = 0; i < in.size(); ++i)
+		{
+			uint32_t c = (uint32_t)in[i];
+			if (c >= 0xD800 && c <= 0xDBFF && i + 1 < in.size())
+			{
+				uint32_t low = (uint32_t)in[i + 1];
+				if (low >= 0xDC00 && low <= 0xDFFF)
+				{
+					c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+					++i;
+				}
+			}
+
+			if (c < 0x80)
+				out += (char)c;
+			else if (c < 0x800)
+			{
+				out += (char)(0xC0 | (c >> 6));
+				out += (char)(0x80 | (c & 0x3F));
+			}
+			else if (c < 0x10000)
+			{
+				out += (char)(0xE0 | (c >> 12));
+				out += (char)(0x80 | ((c >> 6) & 0x3F));
+				out += (char)(0x80 | (c & 0x3F));
+			}
+			else
+			{
+				out += (char)(0xF0 | (c >> 18));
+				out += (char)(0x80 | ((c >> 12) & 0x3F));
+				out += (char)(0x80 | ((c >> 6) & 0x3F));
+				out += (char)(0x80 | (c & 0x3F));
+			}
+		}
+		return out;
+	}
+
+	std::string EscapeJSON(const std::string& in)
+	{
+		std::string out;
+		out.reserve(in.size() + 2);
+		for (char c : in)
+		{
+			if (c == '"' || c == '\\')
+			{
+				out += '\\';
+				out += c;
+			}
+			else if ((unsigned char)c < 0x20)
+			{
+				char hex[8];
+				snprintf(hex, sizeof(hex), "\\u%04x", (unsigned)c);
+				out += hex;
+			}
+			else
+				out += c;
+		}
+		return out;
+	}
+
+	template <typename T>
+	void AppendRaw(std::string& out, const T& value)
+	{
+		out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void AppendBinaryString(std::string& out, uint8_t kind, uint32_t id, const std::string& text)
+	{
+		const uint16_t length = (uint16_t)std::min<size_t>(text.size(), 0xFFFF);
+		AppendRaw(out, kind);
+		AppendRaw(out, id);
+		AppendRaw(out, length);
+		out.append(text.data(), length);
+	}
+
+	void AppendJsonSeparator(std::string& out)
+	{
+		if (!s_bFirstJsonEvent)
+			out += ",\n";
+		s_bFirstJsonEvent = false;
+	}
+
+	void AppendJsonMetadata(std::string& out, const char* type, uint32_t pid, uint32_t tid, const std::string& name)
+	{
+		char line[256];
+		snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", type, pid, tid, EscapeJSON(name).c_str());
+		AppendJsonSeparator(out);
+		out += line;
+	}
+
+	void WriteHeader(void)
+	{
+		s_Scratch.clear();
+		if (s_Format == Trace::BINARY)
+		{
+			const double ticksPerSecond = 1.0e6 / s_MicrosecondsPerTick;
+			s_Scratch.append("AZBT", 4);
+			AppendRaw(s_Scratch, kBinaryVersion);
+			AppendRaw(s_Scratch, ticksPerSecond);
+			AppendRaw(s_Scratch, s_BaseTick);
+		}
+		else
+		{
+			s_Scratch += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			AppendJsonMetadata(s_Scratch, "process_name", kCpuProcessId, 0, "CPU");
+			AppendJsonMetadata(s_Scratch, "process_name", kGpuProcessId, 0, "GPU");
+			AppendJsonMetadata(s_Scratch, "thread_name", kGpuProcessId, 0, "Direct Queue");
+		}
+		s_File.write(s_Scratch.data(), s_Scratch.size());
+	}
+
+	// Pull everything published so far out of the thread buffers and onto disk
+	void Drain(void)
+	{
+		s_Scratch.clear();
+
+		// Pick up any names registered since the last drain
+		{
+			std::lock_guard<std::mutex> lock(s_NameMutex);
+			for (; s_NamesWritten < s_Names.size(); ++s_NamesWritten)
+			{
+				if (s_Format == Trace::BINARY)
+					AppendBinaryString(s_Scratch, 0, (uint32_t)s_NamesWritten + 1, s_Names[s_NamesWritten]);
+				else
+					s_JsonNames.push_back(EscapeJSON(s_Names[s_NamesWritten]));
+			}
+		}
+
+		std::vector<ThreadBuffer*> threads;
+		{
+			std::lock_guard<std::mutex> lock(s_RegistryMutex);
+			threads.reserve(s_Threads.size());
+			for (auto& buffer : s_Threads)
+				threads.push_back(buffer.get());
+		}
+
+		for (ThreadBuffer* buffer : threads)
+		{
+			Event ev;
+			while (buffer->m_Events.Pop(ev))
+			{
+				// Anything left over from a previous capture (or recorded before this one began) is discarded
+				if (ev.m_EndTick < s_BaseTick)
+					continue;
+
+				if (buffer->m_AnnouncedCapture != s_CaptureIndex)
+				{
+					buffer->m_AnnouncedCapture = s_CaptureIndex;
+					const std::string threadName = "Thread " + std::to_string(buffer->m_ThreadId);
+					if (s_Format == Trace::BINARY)
+						AppendBinaryString(s_Scratch, 1, buffer->m_ThreadId, threadName);
+					else
+						AppendJsonMetadata(s_Scratch, "thread_name", kCpuProcessId, buffer->m_ThreadId, threadName);
+				}
+
+				const uint32_t threadId = ev.m_Track == Trace::TRACK_GPU ? 0 : buffer->m_ThreadId;
+				if (s_Format == Trace::BINARY)
+				{
+					const uint8_t kind = 2;
+					AppendRaw(s_Scratch, kind);
+					AppendRaw(s_Scratch, ev.m_Track);
+					AppendRaw(s_Scratch, threadId);
+					AppendRaw(s_Scratch, ev.m_NameId);
+					AppendRaw(s_Scratch, ev.m_StartTick);
+					AppendRaw(s_Scratch, ev.m_EndTick);
+				}
+				else
+				{
+					const char* name = (ev.m_NameId > 0 && ev.m_NameId <= s_JsonNames.size()) ? s_JsonNames[ev.m_NameId - 1].c_str() : "Unknown";
+					const double start = (double)(ev.m_StartTick - s_BaseTick) * s_MicrosecondsPerTick;
+					const double duration = (double)(ev.m_EndTick - ev.m_StartTick) * s_MicrosecondsPerTick;
+
+					char line[512];
+					snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						name, ev.m_Track == Trace::TRACK_GPU ? kGpuProcessId : kCpuProcessId, threadId, start, duration);
+					AppendJsonSeparator(s_Scratch);
+					s_Scratch += line;
+				}
+			}
+		}
+
+		if (!s_Scratch.empty())
+			s_File.write(s_Scratch.data(), s_Scratch.size());
+	}
+
+	void WriterThread(void)
+	{
+		WriteHeader();
+
+		std::unique_lock<std::mutex> lock(s_WriterMutex);
+		while (!s_bStopRequested)
+		{
+			s_WriterWake.wait_for(lock, std::chrono::milliseconds(kWriterIntervalMs));
+			lock.unlock();
+			Drain();
+			lock.lock();
+		}
+		lock.unlock();
+
+		// Producers have stopped by now so this picks up the stragglers
+		Drain();
+
+		if (s_Format == Trace::CHROME_JSON)
+			s_File << "\n]}\n";
+	}
+}
+
+//===============================================================================
+
+bool Trace::Start(const std::string& fileName, eFormat format, int64_t baseTick, double ticksPerSecond)
+{
+	if (IsCapturing() || s_Writer.joinable() || ticksPerSecond <= 0.0)
+		return false;
+
+	// Binary mode for both so the JSON isn't subject to newline translation either
+	s_File.open(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!s_File.is_open())
+		return false;
+
+	s_Format = format;
+	s_BaseTick = baseTick;
+	s_MicrosecondsPerTick = 1.0e6 / ticksPerSecond;
+	++s_CaptureIndex;
+	s_NamesWritten = 0;
+	s_JsonNames.clear();
+	s_bFirstJsonEvent = true;
+	s_bStopRequested = false;
+	s_DroppedEvents.store(0, std::memory_order_relaxed);
+
+	s_Writer = std::thread(WriterThread);
+	Internal::s_bCapturing.store(true, std::memory_order_release);
+	return true;
+}
+
+void Trace::Stop(void)
+{
+	Internal::s_bCapturing.store(false, std::memory_order_release);
+	if (!s_Writer.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(s_WriterMutex);
+		s_bStopRequested = true;
+	}
+	s_WriterWake.notify_one();
+	s_Writer.join();
+
+	s_File.close();
+}
+
+uint32_t Trace::RegisterName(const std::wstring& name)
+{
+	std::lock_guard<std::mutex> lock(s_NameMutex);
+	s_Names.push_back(ToUTF8(name));
+	return (uint32_t)s_Names.size();
+}
+
+void Trace::RecordScope(eTrack track, uint32_t nameId, int64_t startTick, int64_t endTick)
+{
+	if (!IsCapturing())
+		return;
+
+	ThreadBuffer* buffer = t_Buffer;
+	if (buffer == nullptr)
+		buffer = t_Buffer = RegisterThread();
+
+	Event ev;
+	ev.m_StartTick = startTick;
+	ev.m_EndTick = endTick;
+	ev.m_NameId = nameId;
+	ev.m_Track = (uint8_t)track;
+
+	if (!buffer->m_Events.Push(ev))
+		s_DroppedEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t Trace::GetDroppedEventCount(void)
+{
+	return s_DroppedEvents.load(std::memory_order_relaxed);
+}
+
+//===============================================================================
+
+namespace
+{
+	// The tick read a profiled scope makes. steady_clock is QueryPerformanceCounter on Windows, which is what SystemTime reads
+	inline int64_t ReadTick(void)
+	{
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+
+	// Average nanoseconds per scope over every burst, giving the writer time to wake between them
+	double TimeScopes(const Trace::BenchmarkDesc& desc, uint32_t nameId)
+	{
+		double seconds = 0.0;
+		for (uint32_t burst = 0; burst < desc.m_Bursts; ++burst)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			for (uint32_t scope = 0; scope < desc.m_ScopesPerBurst; ++scope)
+			{
+				const int64_t startTick = ReadTick();
+				const int64_t endTick = ReadTick();
+				if (Trace::IsCapturing())
+					Trace::RecordScope(Trace::TRACK_CPU, nameId, startTick, endTick);
+			}
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(kWriterIntervalMs + 1));
+		}
+		return seconds * 1.0e9 / std::max(1.0, (double)desc.m_Bursts * desc.m_ScopesPerBurst);
+	}
+}
+
+Trace::BenchmarkResult Trace::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+	result.m_Scopes = (uint64_t)desc.m_Bursts * desc.m_ScopesPerBurst;
+	if (IsCapturing())
+	{
+		result.Check(false, "a capture was already running");
+		return result;
+	}
+
+	// The tick read alone, since it's most of a scope and varies a lot between machines (and more under virtualisation)
+	const auto tickStart = std::chrono::steady_clock::now();
+	volatile int64_t sink = 0;
+	for (uint64_t read = 0; read < result.m_Scopes; ++read)
+		sink ^= ReadTick();
+	result.m_TickNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - tickStart).count() / std::max<uint64_t>(1, result.m_Scopes);
+
+	const uint32_t nameId = RegisterName(L"Trace benchmark");
+	result.m_DisabledNs = TimeScopes(desc, nameId);
+
+	const double ticksPerSecond = (double)std::chrono::steady_clock::period::den / (double)std::chrono::steady_clock::period::num;
+	if (!Start(desc.m_TraceFile, BINARY, ReadTick(), ticksPerSecond))
+	{
+		result.Check(false, "couldn't start a capture");
+		return result;
+	}
+	result.m_EnabledNs = TimeScopes(desc, nameId);
+	result.m_Dropped = GetDroppedEventCount();
+	Stop();
+	std::remove(desc.m_TraceFile.c_str());
+
+	result.Check(result.m_DisabledNs <= desc.m_BudgetNs, "a scope went over budget with capture off");
+	result.Check(result.m_EnabledNs <= desc.m_BudgetNs, "a scope went over budget while capturing");
+	return result;
+}
@@ -0,0 +1,94 @@
+//===============================================================================
+// desc: A few worker threads kept around between runs, for CPU work that happens every frame or in passes like a chain of dispatches. Run()
+//       shares jobs out between the workers and the calling thread and only returns once every job has finished, so each pass can read
+//       whatever the one before it wrote.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::Pool::Pool(uint32_t workerThreads) : m_NextJob(0)
+{
+	if (workerThreads == 0)
+		workerThreads = std::min(std::max(std::thread::hardware_concurrency(), 1u) - 1, 7u);
+
+	for (uint32_t i = 0; i < workerThreads; ++i)
+		m_Workers.emplace_back(&Pool::WorkerLoop, this);
+}
+
+WorkerPool::Pool::~Pool(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bQuit = true;
+	}
+	m_WorkReady.notify_all();
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+void WorkerPool::Pool::RunJobs(uint32_t jobCount, JobCallback callback, const void* context)
+{
+	if (jobCount == 0)
+		return;
+
+	m_Callback = callback;
+	m_Context = context;
+	m_JobCount = jobCount;
+	m_NextJob.store(0, std::memory_order_relaxed);
+
+	if (m_Workers.empty() || jobCount == 1)
+	{
+		ProcessJobs();
+	}
+	else
+	{
+		// The job and its count are published by the lock, and everything the workers wrote comes back through it
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_BusyWorkers = (uint32_t)m_Workers.size();
+			++m_Generation;
+		}
+		m_WorkReady.notify_all();
+
+		ProcessJobs();
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_WorkDone.wait(lock, [this] { return m_BusyWorkers == 0; });
+	}
+
+	m_Callback = nullptr;
+	m_Context = nullptr;
+}
+
+void WorkerPool::Pool::WorkerLoop(void)
+{
+	uint64_t seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WorkReady.wait(lock, [&] { return m_bQuit || m_Generation != seenGeneration; });
+			if (m_bQuit)
+				return;
+			seenGeneration = m_Generation;
+		}
+
+		ProcessJobs();
+
+		bool bLast;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			bLast = --m_BusyWorkers == 0;
+		}
+		if (bLast)
+			m_WorkDone.notify_one();
+	}
+}
+
+void WorkerPool::Pool::ProcessJobs(void)
+{
+	for (uint32_t job = m_NextJob.fetch_add(1, std::memory_order_relaxed); job < m_JobCount; job = m_NextJob.fetch_add(1, std::memory_order_relaxed))
+		m_Callback(m_Context, job);
+}
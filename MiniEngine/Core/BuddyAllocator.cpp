@@ -11,6 +11,16 @@
 // Author(s):  Jack Elliott
 //
 
+//===============================================================================
+// desc: Allocates blocks from a fixed range using buddy allocation method
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: AllocateBlock() and DeallocateBlock() now forward to Buddy::BitmapAllocator
+*/
+
 #include "pch.h"
 #include "BuddyAllocator.h"
 #include "GraphicsCore.h"
@@ -71,6 +81,11 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
 
     m_maxOrder = UnitSizeToOrder(SizeToUnitSize(maxBlockSize));
 
+#if AZB_MOD
+    // [AZB]: Sized up front - nothing is allocated per block after this
+    m_pFreeBlocks = Buddy::CreateBlockAllocator(Buddy::ALLOCATOR_BITMAP, m_maxOrder);
+#endif
+
     Reset();
 }
 
@@ -108,6 +123,15 @@ void BuddyAllocator::Destroy()
 
 size_t BuddyAllocator::AllocateBlock(UINT order)
 {
+#if AZB_MOD
+    // [AZB]: Same lowest-block-first order as below. Still throws so Allocate() can fall back to the NULL block as before
+    const size_t offset = m_pFreeBlocks->Allocate(order);
+    if (offset == Buddy::kInvalidOffset)
+    {
+        throw(std::bad_alloc());
+    }
+    return offset;
+#else
     size_t offset;
 
     if (order > m_maxOrder)
@@ -140,10 +164,15 @@ size_t BuddyAllocator::AllocateBlock(UINT order)
     }
 
     return offset;
+#endif
 }
 
 void BuddyAllocator::DeallocateBlock(size_t offset, UINT order)
 {
+#if AZB_MOD
+    // [AZB]: Merges with free buddies the same way, but can no longer fail
+    m_pFreeBlocks->Free(offset, order);
+#else
     // See if the buddy block is free  
     size_t size = OrderToUnitSize(order);
 
@@ -163,6 +192,7 @@ void BuddyAllocator::DeallocateBlock(size_t offset, UINT order)
         // Add the block to the free list  
         m_freeBlocks[order].insert(offset); // throw(std::bad_alloc) 
     }
+#endif
 }
 
 BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData)
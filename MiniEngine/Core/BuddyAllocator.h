@@ -19,6 +19,15 @@
 //  
 
 #pragma once
+//===============================================================================
+// desc: Allocates blocks from a fixed range using buddy allocation method
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Moved the free block bookkeeping behind Buddy::IBlockAllocator and switched it to the bitmap allocator
+*/
 
 #include "GpuBuffer.h"
 #include <vector>
@@ -26,6 +35,19 @@
 #include <mutex>
 #include <set>
 
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+
+#if AZB_MOD
+// [AZB]: Free block tracking with no D3D in it, so the heap here is just whatever the offsets are applied to
+#include "AZB_BuddyBitmap.h"
+#include <memory>
+#endif
+
 // Unfortunately the api restricts the minimum size of a placed buffer resource to 64k
 #define MIN_PLACED_BUFFER_SIZE (64 * 1024)
 
@@ -96,12 +118,17 @@ public:
 
     inline void Reset()
     {
+#if AZB_MOD
+        // [AZB]: One free block of max order, same as below
+        m_pFreeBlocks->Reset();
+#else
         // Clear the free blocks collection  
         m_freeBlocks.clear();
 
         // Initialize the pool with a free inner block of max inner block size  
         m_freeBlocks.resize(m_maxOrder + 1);
         m_freeBlocks[m_maxOrder].insert((size_t)0);
+#endif
     }
 
     void CleanUpAllocations();
@@ -113,7 +140,12 @@ private:
     const D3D12_HEAP_TYPE m_heapType;
 
     std::queue<BuddyBlock*> m_deferredDeletionQueue;
+#if AZB_MOD
+    // [AZB]: Bitmap per order instead of a std::set, so allocating and freeing no longer touch the heap
+    std::unique_ptr<Buddy::IBlockAllocator> m_pFreeBlocks;
+#else
     std::vector<std::set<size_t>> m_freeBlocks;
+#endif
     UINT m_maxOrder;
     const size_t m_baseOffset;
     const size_t m_maxBlockSize;
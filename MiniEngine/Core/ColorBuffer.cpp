@@ -11,6 +11,16 @@
 // Author:  James Stanard 
 //
 
+//===============================================================================
+// desc: Colour render targets, including the swap chain's back buffers
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: CreateFromSwapChain() keeps the buffer's existing RTV so resizing the swap chain no longer leaks one per back buffer
+*/
+
 #include "pch.h"
 #include "ColorBuffer.h"
 #include "GraphicsCommon.h"
@@ -106,7 +116,13 @@ void ColorBuffer::CreateFromSwapChain( const std::wstring& Name, ID3D12Resource*
     //m_UAVHandle[0] = Graphics::AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
     //Graphics::g_Device->CreateUnorderedAccessView(m_pResource.Get(), nullptr, nullptr, m_UAVHandle[0]);
 
+#if AZB_MOD
+    // [AZB]: Display::Resize() calls this again for every back buffer. Destroy() leaves the handle alone, so rewrite it in place
+    if (m_RTVHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+        m_RTVHandle = Graphics::AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+#else
     m_RTVHandle = Graphics::AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+#endif
     Graphics::g_Device->CreateRenderTargetView(m_pResource.Get(), nullptr, m_RTVHandle);
 }
 
@@ -11,14 +11,35 @@
 // Author:  James Stanard
 //
 
+//===============================================================================
+// desc: A pool of command allocators for one command list type, reused once the GPU is done with them
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: RequestAllocator() and DiscardAllocator() go through FencedPool::Pool, and only creating an allocator takes a lock
+   [AZB] 18/10/26: RequestAllocator() never comes back empty - the pool keeps creating past its cap, and takes back what exiting threads held
+*/
+
 #include "pch.h"
 #include "CommandAllocatorPool.h"
 
+#if AZB_MOD
+CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type) :
+    m_cCommandListType(Type),
+    m_Device(nullptr),
+    m_Factory(*this),
+    m_Pool(m_CompletedFence, m_Factory)
+{
+}
+#else
 CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type) :
     m_cCommandListType(Type),
     m_Device(nullptr)
 {
 }
+#endif
 
 CommandAllocatorPool::~CommandAllocatorPool()
 {
@@ -30,6 +51,55 @@ void CommandAllocatorPool::Create(ID3D12Device * pDevice)
     m_Device = pDevice;
 }
 
+#if AZB_MOD
+void CommandAllocatorPool::Shutdown()
+{
+    for (uint32_t i = 0; i < m_Pool.GetCount(); ++i)
+        static_cast<ID3D12CommandAllocator*>(m_Pool.GetPooled(i))->Release();
+
+    m_Pool.Clear();
+}
+
+void CommandAllocatorPool::CompletedFence::Update(uint64_t CompletedFenceValue)
+{
+    uint64_t Known = m_CompletedValue.load(std::memory_order_relaxed);
+    while (Known < CompletedFenceValue && !m_CompletedValue.compare_exchange_weak(Known, CompletedFenceValue, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+}
+
+// [AZB]: Called under the pool's creation lock, so the count in the name is stable
+void* CommandAllocatorPool::AllocatorFactory::Create(uint32_t Index)
+{
+    ID3D12CommandAllocator* pAllocator = nullptr;
+    ASSERT_SUCCEEDED(m_Owner.m_Device->CreateCommandAllocator(m_Owner.m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
+    wchar_t AllocatorName[32];
+    swprintf(AllocatorName, 32, L"CommandAllocator %u", Index);
+    pAllocator->SetName(AllocatorName);
+    return pAllocator;
+}
+
+void CommandAllocatorPool::AllocatorFactory::Reset(void* Allocator)
+{
+    ASSERT_SUCCEEDED(static_cast<ID3D12CommandAllocator*>(Allocator)->Reset());
+}
+
+ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t CompletedFenceValue)
+{
+    // [AZB]: Usually the calling thread's own allocator from a few submissions back, found without locking
+    m_CompletedFence.Update(CompletedFenceValue);
+
+    ID3D12CommandAllocator* pAllocator = static_cast<ID3D12CommandAllocator*>(m_Pool.Request());
+    ASSERT(pAllocator != nullptr, "Failed to create a command allocator");
+    return pAllocator;
+}
+
+void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator)
+{
+    // That fence value indicates we are free to reset the allocator
+    m_Pool.Discard(FenceValue, Allocator);
+}
+#else
 void CommandAllocatorPool::Shutdown()
 {
     for (size_t i = 0; i < m_AllocatorPool.size(); ++i)
@@ -76,3 +146,4 @@ void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAl
     // That fence value indicates we are free to reset the allocator
     m_ReadyAllocators.push(std::make_pair(FenceValue, Allocator));
 }
+#endif
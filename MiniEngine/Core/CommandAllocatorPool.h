@@ -12,12 +12,32 @@
 //
 
 #pragma once
+//===============================================================================
+// desc: A pool of command allocators for one command list type, reused once the GPU is done with them
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Allocators are pooled through FencedPool::Pool rather than a mutex-guarded queue, and go back to the thread that last used them
+*/
 
 #include <vector>
 #include <queue>
 #include <mutex>
 #include <stdint.h>
 
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+
+#if AZB_MOD
+#include "AZB_FencedPool.h"
+#endif
+
 class CommandAllocatorPool
 {
 public:
@@ -30,13 +50,47 @@ public:
     ID3D12CommandAllocator* RequestAllocator(uint64_t CompletedFenceValue);
     void DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator);
 
+#if AZB_MOD
+    inline size_t Size() { return m_Pool.GetCount(); }
+
+    FencedPool::Stats GetStats(void) const { return m_Pool.GetStats(); }
+#else
     inline size_t Size() { return m_AllocatorPool.size(); }
+#endif
 
 private:
     const D3D12_COMMAND_LIST_TYPE m_cCommandListType;
 
     ID3D12Device* m_Device;
+#if AZB_MOD
+    // [AZB]: Answers from the latest completed value handed to RequestAllocator(), rather than asking the D3D fence again
+    class CompletedFence : public FencedPool::IFence
+    {
+    public:
+        virtual bool IsFenceComplete(uint64_t FenceValue) override { return FenceValue <= m_CompletedValue.load(std::memory_order_acquire); }
+        void Update(uint64_t CompletedFenceValue);
+
+    private:
+        std::atomic<uint64_t> m_CompletedValue{ 0 };
+    };
+
+    class AllocatorFactory : public FencedPool::IFactory
+    {
+    public:
+        explicit AllocatorFactory(CommandAllocatorPool& Owner) : m_Owner(Owner) {}
+        virtual void* Create(uint32_t Index) override;
+        virtual void Reset(void* Allocator) override;
+
+    private:
+        CommandAllocatorPool& m_Owner;
+    };
+
+    CompletedFence m_CompletedFence;
+    AllocatorFactory m_Factory;
+    FencedPool::Pool m_Pool;
+#else
     std::vector<ID3D12CommandAllocator*> m_AllocatorPool;
     std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_ReadyAllocators;
     std::mutex m_AllocatorMutex;
+#endif
 };
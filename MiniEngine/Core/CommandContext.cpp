@@ -312,6 +312,14 @@ void GraphicsContext::ClearDepth( DepthBuffer& Target )
     m_CommandList->ClearDepthStencilView(Target.GetDSV(), D3D12_CLEAR_FLAG_DEPTH, Target.GetClearDepth(), Target.GetClearStencil(), 0, nullptr );
 }
 
+#if AZB_MOD
+void GraphicsContext::ClearDepth( DepthBuffer& Target, const D3D12_RECT& Rect )
+{
+    FlushResourceBarriers();
+    m_CommandList->ClearDepthStencilView(Target.GetDSV(), D3D12_CLEAR_FLAG_DEPTH, Target.GetClearDepth(), Target.GetClearStencil(), 1, &Rect );
+}
+#endif
+
 void GraphicsContext::ClearStencil( DepthBuffer& Target )
 {
     FlushResourceBarriers();
@@ -479,6 +487,18 @@ void CommandContext::InitializeTexture( GpuResource& Dest, UINT NumSubresources,
     InitContext.Finish(true);
 }
 
+#if AZB_MOD
+void CommandContext::UploadTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[] )
+{
+    UINT64 uploadBufferSize = GetRequiredIntermediateSize(Dest.GetResource(), 0, NumSubresources);
+
+    // [AZB]: Several textures share this context's upload pages, so the copy has to start at this allocation's offset rather than 0
+    DynAlloc mem = m_CpuLinearAllocator.Allocate((size_t)uploadBufferSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    UpdateSubresources(m_CommandList, Dest.GetResource(), mem.Buffer.GetResource(), mem.Offset, 0, NumSubresources, SubData);
+    TransitionResource(Dest, D3D12_RESOURCE_STATE_GENERIC_READ);
+}
+#endif
+
 void CommandContext::CopySubresource(GpuResource& Dest, UINT DestSubIndex, GpuResource& Src, UINT SrcSubIndex)
 {
     FlushResourceBarriers();
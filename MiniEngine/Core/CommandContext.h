@@ -171,6 +171,9 @@ public:
     // [AZB]: DLSS modifies the command context and descriptor heaps when executing, so I've created public accessors so that state can be saved and restored!
     //ID3D12DescriptorHeap** GetCurrentDescriptorHeaps() const;
     ID3D12DescriptorHeap* GetCurrentDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE type) const;
+
+    // [AZB]: Same as InitializeTexture, but records into this context rather than submitting and waiting - lets the async loader upload a whole batch in one go
+    void UploadTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[] );
 #endif
 
 protected:
@@ -216,6 +219,10 @@ public:
     void ClearColor( ColorBuffer& Target, D3D12_RECT* Rect = nullptr);
     void ClearColor(ColorBuffer& Target, float Colour[4], D3D12_RECT* Rect = nullptr);
     void ClearDepth( DepthBuffer& Target );
+#if AZB_MOD
+    // [AZB]: Clears only Rect, so a cached shadow map can be redrawn where it's changed and kept everywhere else
+    void ClearDepth( DepthBuffer& Target, const D3D12_RECT& Rect );
+#endif
     void ClearStencil( DepthBuffer& Target );
     void ClearDepthAndStencil( DepthBuffer& Target );
 
@@ -33,6 +33,8 @@ typedef public std::unique_ptr<void, handle_closer> ScopedHandle;
 inline HANDLE safe_handle( HANDLE h ) { return (h == INVALID_HANDLE_VALUE) ? 0 : h; }
 
 
+#if !AZB_MOD
+// [AZB]: CreateDDSTextureFromFile maps the file through DDSReader instead
 //--------------------------------------------------------------------------------------
 static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
                                         std::unique_ptr<uint8_t[]>& ddsData,
@@ -154,6 +156,7 @@ static HRESULT LoadTextureDataFromFile( _In_z_ const wchar_t* fileName,
 
     return S_OK;
 }
+#endif
 
 
 //--------------------------------------------------------------------------------------
@@ -966,27 +969,27 @@ static HRESULT CreateD3DResources( _In_ ID3D12Device* d3dDevice,
 }
 
 //--------------------------------------------------------------------------------------
-static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
-                                     _In_ const DDS_HEADER* header,
-                                     _In_reads_bytes_(bitSize) const uint8_t* bitData,
-                                     _In_ size_t bitSize,
-                                     _In_ size_t maxsize,
-                                     _In_ bool forceSRGB,
-                                     _Outptr_opt_ ID3D12Resource** texture,
-                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+// Validates the header and works out the resource description. Pulled out of CreateTextureFromDDS so it can be reused without a device
+static HRESULT GetDDSTextureInfo( _In_ const DDS_HEADER* header,
+                                  _Out_ UINT& width,
+                                  _Out_ UINT& height,
+                                  _Out_ UINT& depth,
+                                  _Out_ size_t& mipCount,
+                                  _Out_ UINT& arraySize,
+                                  _Out_ DXGI_FORMAT& format,
+                                  _Out_ uint32_t& resDim,
+                                  _Out_ bool& isCubeMap )
 {
-    HRESULT hr = S_OK;
+    width = header->width;
+    height = header->height;
+    depth = header->depth;
 
-    UINT width = header->width;
-    UINT height = header->height;
-    UINT depth = header->depth;
+    resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+    arraySize = 1;
+    format = DXGI_FORMAT_UNKNOWN;
+    isCubeMap = false;
 
-    uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
-    UINT arraySize = 1;
-    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-    bool isCubeMap = false;
-
-    size_t mipCount = header->mipMapCount;
+    mipCount = header->mipMapCount;
     if (0 == mipCount)
     {
         mipCount = 1;
@@ -1142,6 +1145,34 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
+                                     _In_ const DDS_HEADER* header,
+                                     _In_reads_bytes_(bitSize) const uint8_t* bitData,
+                                     _In_ size_t bitSize,
+                                     _In_ size_t maxsize,
+                                     _In_ bool forceSRGB,
+                                     _Outptr_opt_ ID3D12Resource** texture,
+                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+{
+    HRESULT hr = S_OK;
+
+    UINT width, height, depth, arraySize;
+    size_t mipCount;
+    DXGI_FORMAT format;
+    uint32_t resDim;
+    bool isCubeMap;
+
+    hr = GetDDSTextureInfo( header, width, height, depth, mipCount, arraySize, format, resDim, isCubeMap );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
     {
         // Create the texture
         UINT subresourceCount = static_cast<UINT>(mipCount) * arraySize;
@@ -1222,31 +1253,15 @@ static DDS_ALPHA_MODE GetAlphaMode( _In_ const DDS_HEADER* header )
 }
 
 
-_Use_decl_annotations_
-HRESULT CreateDDSTextureFromMemory(
-    ID3D12Device* d3dDevice,
-    const uint8_t* ddsData,
-    size_t ddsDataSize,
-    size_t maxsize,
-    bool forceSRGB,
-    ID3D12Resource** texture,
-    D3D12_CPU_DESCRIPTOR_HANDLE textureView,
-    DDS_ALPHA_MODE* alphaMode )
+//--------------------------------------------------------------------------------------
+// Checks the magic value and header sizes of a DDS file already in memory, and finds where the pixel data starts
+static HRESULT ValidateDDSMemory( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                  _In_ size_t ddsDataSize,
+                                  _Out_ const DDS_HEADER*& header,
+                                  _Out_ size_t& offset )
 {
-    if ( texture )
-    {
-        *texture = nullptr;
-    }
-
-    if ( alphaMode )
-    {
-        *alphaMode = DDS_ALPHA_MODE_UNKNOWN;
-    }
-
-    if (!d3dDevice || !ddsData)
-    {
-        return E_INVALIDARG;
-    }
+    header = nullptr;
+    offset = 0;
 
     // Validate DDS file in memory
     if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
@@ -1260,7 +1275,7 @@ HRESULT CreateDDSTextureFromMemory(
         return E_FAIL;
     }
 
-    auto header = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+    header = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
 
     // Verify header to validate DDS file
     if (header->size != sizeof(DDS_HEADER) ||
@@ -1269,7 +1284,7 @@ HRESULT CreateDDSTextureFromMemory(
         return E_FAIL;
     }
 
-    size_t offset = sizeof(DDS_HEADER) + sizeof(uint32_t);
+    offset = sizeof(DDS_HEADER) + sizeof(uint32_t);
 
     // Check for extensions
     if (header->ddspf.flags & DDS_FOURCC)
@@ -1282,7 +1297,45 @@ HRESULT CreateDDSTextureFromMemory(
     if (ddsDataSize < offset)
         return E_FAIL;
 
-    HRESULT hr = CreateTextureFromDDS( d3dDevice,
+    return S_OK;
+}
+
+
+_Use_decl_annotations_
+HRESULT CreateDDSTextureFromMemory(
+    ID3D12Device* d3dDevice,
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    size_t maxsize,
+    bool forceSRGB,
+    ID3D12Resource** texture,
+    D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+    DDS_ALPHA_MODE* alphaMode )
+{
+    if ( texture )
+    {
+        *texture = nullptr;
+    }
+
+    if ( alphaMode )
+    {
+        *alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+    }
+
+    if (!d3dDevice || !ddsData)
+    {
+        return E_INVALIDARG;
+    }
+
+    const DDS_HEADER* header = nullptr;
+    size_t offset = 0;
+    HRESULT hr = ValidateDDSMemory( ddsData, ddsDataSize, header, offset );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    hr = CreateTextureFromDDS( d3dDevice,
                                        header, ddsData + offset, ddsDataSize - offset, maxsize,
                                        forceSRGB, texture, textureView );
     if ( SUCCEEDED(hr) )
@@ -1325,6 +1378,25 @@ HRESULT CreateDDSTextureFromFile(
         return E_INVALIDARG;
     }
 
+#if AZB_MOD
+    // [AZB]: Map the file instead of reading it into a buffer - the upload copies straight out of the file cache
+    DDSReader::MappedFile mappedFile;
+    if (!mappedFile.Open( fileName ))
+    {
+        return HRESULT_FROM_WIN32( ERROR_FILE_NOT_FOUND );
+    }
+
+    const DDS_HEADER* header = nullptr;
+    size_t offset = 0;
+    HRESULT hr = ValidateDDSMemory( mappedFile.GetData(), mappedFile.GetSize(), header, offset );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    const uint8_t* bitData = mappedFile.GetData() + offset;
+    size_t bitSize = mappedFile.GetSize() - offset;
+#else
     DDS_HEADER* header = nullptr;
     uint8_t* bitData = nullptr;
     size_t bitSize = 0;
@@ -1335,6 +1407,7 @@ HRESULT CreateDDSTextureFromFile(
     {
         return hr;
     }
+#endif
 
     hr = CreateTextureFromDDS( d3dDevice,
                                header, bitData, bitSize, maxsize,
@@ -1348,3 +1421,178 @@ HRESULT CreateDDSTextureFromFile(
 
     return hr;
 }
+
+#if AZB_MOD
+//--------------------------------------------------------------------------------------
+// [AZB]: Lays out the subresources for the layout's current maxsize. Only the mips that survive maxsize are kept, which the original path didn't account for when uploading
+static HRESULT FillLayoutInitData( DDSTextureLayout& layout )
+{
+    layout.subresources.resize( layout.mipCount * layout.arraySize );
+
+    HRESULT hr = FillInitData( layout.width, layout.height, layout.depth, layout.mipCount, layout.arraySize, layout.format, layout.maxsize,
+                               layout.bitSize, layout.bitData, layout.twidth, layout.theight, layout.tdepth, layout.skipMip, layout.subresources.data() );
+    if (FAILED(hr))
+    {
+        layout.subresources.clear();
+        layout.uploadBytes = 0;
+        return hr;
+    }
+
+    const size_t usedMips = layout.mipCount - layout.skipMip;
+    layout.subresources.resize( usedMips * layout.arraySize );
+
+    // Rough size of the upload - only used to keep batches to a sensible size, so row alignment is ignored
+    layout.uploadBytes = 0;
+    for (size_t i = 0; i < layout.subresources.size(); ++i)
+    {
+        size_t d = (layout.resDim == D3D12_RESOURCE_DIMENSION_TEXTURE3D) ? std::max<size_t>( layout.tdepth >> (i % usedMips), 1 ) : 1;
+        layout.uploadBytes += static_cast<size_t>( layout.subresources[i].SlicePitch ) * d;
+    }
+
+    return S_OK;
+}
+
+
+_Use_decl_annotations_
+HRESULT ParseDDSTextureFromMemory(
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    size_t maxsize,
+    DDSTextureLayout& layout )
+{
+    layout = DDSTextureLayout();
+
+    if (!ddsData)
+    {
+        return E_INVALIDARG;
+    }
+
+    const DDS_HEADER* header = nullptr;
+    size_t offset = 0;
+    HRESULT hr = ValidateDDSMemory( ddsData, ddsDataSize, header, offset );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    hr = GetDDSTextureInfo( header, layout.width, layout.height, layout.depth, layout.mipCount, layout.arraySize,
+                            layout.format, layout.resDim, layout.isCubeMap );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    layout.alphaMode = GetAlphaMode( header );
+    layout.bitData = ddsData + offset;
+    layout.bitSize = ddsDataSize - offset;
+    layout.maxsize = maxsize;
+
+    return FillLayoutInitData( layout );
+}
+
+
+_Use_decl_annotations_
+HRESULT BuildDDSTextureLayout(
+    const DDSReader::DDSFile& file,
+    size_t maxsize,
+    DDSTextureLayout& layout )
+{
+    layout = DDSTextureLayout();
+
+    if (file.GetSubresourceCount() == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    layout.resDim = file.GetDimension();
+    layout.width = file.GetWidth();
+    layout.height = file.GetHeight();
+    layout.depth = file.GetDepth();
+    layout.mipCount = file.GetMipCount();
+    layout.arraySize = file.GetArraySize();
+    layout.format = static_cast<DXGI_FORMAT>( file.GetFormat() );
+    layout.isCubeMap = file.IsCubeMap();
+    layout.alphaMode = static_cast<DDS_ALPHA_MODE>( file.GetAlphaMode() );
+    layout.bitData = file.GetBitData();
+    layout.bitSize = file.GetBitSize();
+    layout.maxsize = maxsize;
+
+    // Skip any top mips over maxsize, as FillInitData does
+    uint32_t skipMip = 0;
+    if (maxsize && layout.mipCount > 1)
+    {
+        while (skipMip + 1 < file.GetMipCount())
+        {
+            const DDSReader::SubresourceView& top = file.GetSubresource( skipMip, 0 );
+            if (top.m_Width <= maxsize && top.m_Height <= maxsize && top.m_Depth <= maxsize)
+                break;
+            ++skipMip;
+        }
+    }
+
+    const DDSReader::SubresourceView& top = file.GetSubresource( skipMip, 0 );
+    layout.skipMip = skipMip;
+    layout.twidth = top.m_Width;
+    layout.theight = top.m_Height;
+    layout.tdepth = top.m_Depth;
+
+    layout.subresources.reserve( (file.GetMipCount() - skipMip) * file.GetArraySize() );
+    for (uint32_t slice = 0; slice < file.GetArraySize(); ++slice)
+    {
+        for (uint32_t mip = skipMip; mip < file.GetMipCount(); ++mip)
+        {
+            const DDSReader::SubresourceView& view = file.GetSubresource( mip, slice );
+
+            D3D12_SUBRESOURCE_DATA data;
+            data.pData = view.m_Data;
+            data.RowPitch = static_cast<LONG_PTR>( view.m_RowPitch );
+            data.SlicePitch = static_cast<LONG_PTR>( view.m_SlicePitch );
+            layout.subresources.push_back( data );
+
+            layout.uploadBytes += view.m_SlicePitch * view.m_Depth;
+        }
+    }
+
+    return S_OK;
+}
+
+
+_Use_decl_annotations_
+HRESULT CreateDDSTextureFromLayout(
+    ID3D12Device* d3dDevice,
+    DDSTextureLayout& layout,
+    bool forceSRGB,
+    ID3D12Resource** texture,
+    D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+{
+    if ( texture )
+    {
+        *texture = nullptr;
+    }
+
+    if (!d3dDevice || !texture || layout.subresources.empty())
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = CreateD3DResources( d3dDevice, layout.resDim, layout.twidth, layout.theight, layout.tdepth, layout.mipCount - layout.skipMip,
+                                     layout.arraySize, layout.format, forceSRGB, layout.isCubeMap, texture, textureView );
+
+    if ( FAILED(hr) && !layout.maxsize && (layout.mipCount > 1) )
+    {
+        // Retry with a maxsize determined by feature level, same as CreateTextureFromDDS
+        layout.maxsize = (layout.resDim == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+                            ? 2048 /*D3D10_REQ_TEXTURE3D_U_V_OR_W_DIMENSION*/
+                            : 8192 /*D3D10_REQ_TEXTURE2D_U_OR_V_DIMENSION*/;
+
+        hr = FillLayoutInitData( layout );
+        if ( SUCCEEDED(hr) )
+        {
+            hr = CreateD3DResources( d3dDevice, layout.resDim, layout.twidth, layout.theight, layout.tdepth, layout.mipCount - layout.skipMip,
+                                     layout.arraySize, layout.format, forceSRGB, layout.isCubeMap, texture, textureView );
+        }
+    }
+
+    return hr;
+}
+#endif
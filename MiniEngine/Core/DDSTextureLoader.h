@@ -27,6 +27,22 @@
 #include <stdint.h>
 #pragma warning(pop)
 
+//===============================================================================
+// desc: Split so that parsing can happen off the render thread, with resource creation and upload left to whoever owns the command list
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_Utils.h"
+#include "AZB_DDSReader.h"
+
+#include <vector>
+
+/*
+   Change Log:
+
+   [AZB] 18/10/26: Split DDS loading into a device-free parse step and a create step that doesn't upload, for the async texture pipeline
+   [AZB] 18/10/26: Layouts can be built straight from a memory-mapped DDSReader::DDSFile, and CreateDDSTextureFromFile maps rather than reads
+*/
+
 enum DDS_ALPHA_MODE
 {
     DDS_ALPHA_MODE_UNKNOWN       = 0,
@@ -56,3 +72,53 @@ HRESULT __cdecl CreateDDSTextureFromFile( _In_ ID3D12Device* d3dDevice,
                                             );
 
 size_t BitsPerPixel(_In_ DXGI_FORMAT fmt);
+
+#if AZB_MOD
+// [AZB]: Everything needed to create and fill a texture, worked out from the file alone. The subresources point into the caller's buffer, so that must outlive the layout
+struct DDSTextureLayout
+{
+    uint32_t resDim = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+    UINT width = 0;
+    UINT height = 0;
+    UINT depth = 0;
+    size_t mipCount = 0;
+    UINT arraySize = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    bool isCubeMap = false;
+    DDS_ALPHA_MODE alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+
+    // Source pixels and the top mip that actually fits under maxsize
+    const uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+    size_t maxsize = 0;
+    size_t twidth = 0;
+    size_t theight = 0;
+    size_t tdepth = 0;
+    size_t skipMip = 0;
+
+    std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+    size_t uploadBytes = 0;
+};
+
+// [AZB]: CPU only - validates the header and lays out every subresource. Safe to call from any thread
+HRESULT __cdecl ParseDDSTextureFromMemory( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                           _In_ size_t ddsDataSize,
+                                           _In_ size_t maxsize,
+                                           _Out_ DDSTextureLayout& layout
+                                         );
+
+// [AZB]: Same result as above, but from a file DDSReader has already validated - the subresources are its views, so nothing is checked or walked twice
+HRESULT __cdecl BuildDDSTextureLayout( _In_ const DDSReader::DDSFile& file,
+                                       _In_ size_t maxsize,
+                                       _Out_ DDSTextureLayout& layout
+                                     );
+
+// [AZB]: Creates the resource (in COPY_DEST) and its SRV but records no upload - the caller copies layout.subresources in through its own context.
+//        May re-lay out the subresources with a smaller maxsize if the device rejects the full size texture
+HRESULT __cdecl CreateDDSTextureFromLayout( _In_ ID3D12Device* d3dDevice,
+                                            _Inout_ DDSTextureLayout& layout,
+                                            _In_ bool forceSRGB,
+                                            _Outptr_ ID3D12Resource** texture,
+                                            _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView
+                                          );
+#endif
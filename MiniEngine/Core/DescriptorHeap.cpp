@@ -11,6 +11,16 @@
 // Author:  James Stanard 
 //
 
+//===============================================================================
+// desc: CPU descriptor allocation, and shader-visible descriptor heaps
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: DescriptorAllocator::Allocate() goes through DescriptorPool::Allocator, and Free() hands descriptors back to it
+*/
+
 #include "pch.h"
 #include "DescriptorHeap.h"
 #include "GraphicsCore.h"
@@ -24,8 +34,57 @@ using namespace Graphics;
 std::mutex DescriptorAllocator::sm_AllocationMutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DescriptorAllocator::sm_DescriptorHeapPool;
 
+#if AZB_MOD
+bool DescriptorAllocator::sm_bDestroyed = false;
+
+namespace
+{
+    // [AZB]: Freed descriptors are stamped with a graphics queue fence, which is what CPU descriptors end up being read for
+    class CommandManagerFence : public DescriptorPool::IFence
+    {
+    public:
+        virtual bool IsFenceComplete(uint64_t FenceValue) override { return g_CommandManager.IsFenceComplete(FenceValue); }
+    };
+
+    CommandManagerFence s_CommandManagerFence;
+}
+
+// [AZB]: Heaps still come from RequestNewHeap(), so they live in sm_DescriptorHeapPool as before
+class DescriptorAllocator::HeapSource : public DescriptorPool::IHeapSource
+{
+public:
+    explicit HeapSource(D3D12_DESCRIPTOR_HEAP_TYPE Type) : m_Type(Type) {}
+
+    virtual uint64_t CreateHeap(uint32_t DescriptorCount) override
+    {
+        ASSERT(DescriptorCount <= sm_NumDescriptorsPerHeap, "Asked for more contiguous descriptors than a heap holds");
+        return RequestNewHeap(m_Type)->GetCPUDescriptorHandleForHeapStart().ptr;
+    }
+
+    virtual uint32_t GetDescriptorSize(void) override { return g_Device->GetDescriptorHandleIncrementSize(m_Type); }
+
+private:
+    D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
+};
+
+DescriptorAllocator::DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) :
+    m_Type(Type),
+    m_HeapSource(new HeapSource(Type))
+{
+    // [AZB]: Nothing touches the device until the first allocation, so these can still be constructed statically
+    m_Pool.reset(new DescriptorPool::Allocator(*m_HeapSource, s_CommandManagerFence, sm_NumDescriptorsPerHeap));
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+}
+#endif
+
 void DescriptorAllocator::DestroyAll(void)
 {
+#if AZB_MOD
+    sm_bDestroyed = true;
+#endif
     sm_DescriptorHeapPool.clear();
 }
 
@@ -45,6 +104,24 @@ ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_
     return pHeap.Get();
 }
 
+#if AZB_MOD
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
+{
+    // [AZB]: Usually straight out of this thread's magazine. sm_AllocationMutex is only taken if a new heap is needed
+    D3D12_CPU_DESCRIPTOR_HANDLE ret;
+    ret.ptr = (SIZE_T)m_Pool->Allocate(Count);
+    ASSERT(ret.ptr != DescriptorPool::kInvalidDescriptor, "Failed to allocate descriptors");
+    return ret;
+}
+
+void DescriptorAllocator::Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+{
+    if (sm_bDestroyed || Handle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+        return;
+
+    m_Pool->Free(Handle.ptr, Count, g_CommandManager.GetGraphicsQueue().GetNextFenceValue());
+}
+#else
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
 {
     if (m_CurrentHeap == nullptr || m_RemainingFreeHandles < Count)
@@ -62,6 +139,7 @@ D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
     m_RemainingFreeHandles -= Count;
     return ret;
 }
+#endif
 
 //
 // DescriptorHeap implementation
@@ -12,26 +12,62 @@
 //
 
 #pragma once
+//===============================================================================
+// desc: CPU descriptor allocation, and shader-visible descriptor heaps
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: DescriptorAllocator hands out descriptors through per-thread magazines and can take them back, with reuse held off by a fence
+*/
 
 #include <mutex>
 #include <vector>
 #include <queue>
 #include <string>
 
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+
+#if AZB_MOD
+#include "AZB_DescriptorPool.h"
+#include <memory>
+#endif
+
 // This is an unbounded resource descriptor allocator.  It is intended to provide space for CPU-visible
 // resource descriptors as resources are created.  For those that need to be made shader-visible, they
 // will need to be copied to a DescriptorHeap or a DynamicDescriptorHeap.
 class DescriptorAllocator
 {
 public:
+#if AZB_MOD
+    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type);
+    ~DescriptorAllocator();
+#else
     DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) : 
         m_Type(Type), m_CurrentHeap(nullptr), m_DescriptorSize(0)
     {
         m_CurrentHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
     }
+#endif
 
+#if AZB_MOD
+    // [AZB]: Safe to call from any thread, as the async texture loader's submitter does. Without AZB_MOD it's the render thread's alone
+#endif
     D3D12_CPU_DESCRIPTOR_HANDLE Allocate( uint32_t Count );
 
+#if AZB_MOD
+    // [AZB]: Count must match what the handle was allocated with. It's reused once the GPU is past everything submitted so far
+    void Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count );
+
+    DescriptorPool::Stats GetStats(void) const { return m_Pool->GetStats(); }
+#endif
+
     static void DestroyAll(void);
 
 protected:
@@ -42,10 +78,19 @@ protected:
     static ID3D12DescriptorHeap* RequestNewHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type );
 
     D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
+#if AZB_MOD
+    // [AZB]: Set by DestroyAll(). Views still being released after it, as statics go out of scope, are ignored rather than freed into a dead pool
+    static bool sm_bDestroyed;
+
+    class HeapSource;
+    std::unique_ptr<HeapSource> m_HeapSource;
+    std::unique_ptr<DescriptorPool::Allocator> m_Pool;
+#else
     ID3D12DescriptorHeap* m_CurrentHeap;
     D3D12_CPU_DESCRIPTOR_HANDLE m_CurrentHandle;
     uint32_t m_DescriptorSize;
     uint32_t m_RemainingFreeHandles;
+#endif
 };
 
 // This handle refers to a descriptor or a descriptor table (contiguous descriptors) that is shader visible.
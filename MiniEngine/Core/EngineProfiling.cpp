@@ -19,6 +19,11 @@
 #include "GameInput.h"
 #include "GpuTimeManager.h"
 #include "CommandContext.h"
+#if AZB_MOD
+#include "AZB_Trace.h"
+#include "AZB_ThreadProfiler.h"
+#include <thread>
+#endif
 #include <vector>
 #include <unordered_map>
 #include <array>
@@ -32,6 +37,19 @@ using namespace std;
 namespace EngineProfiling
 {
     bool Paused = false;
+
+#if AZB_MOD
+    // [AZB]: Written once per frame from UpdateTimes(), read by whoever wants a history (usually the GUI)
+    FrameTimeSeries s_CpuTimeHistory;
+    FrameTimeSeries s_GpuTimeHistory;
+    FrameTimeSeries s_FrameRateHistory;
+
+    // [AZB]: Static init happens on the main thread. Any other thread gets routed to its own timing tree
+    const std::thread::id s_MainThreadId = std::this_thread::get_id();
+
+    FrameStats::FrameTimeAnalyzer s_FrameTimeAnalysis;
+    uint32_t s_FrameTimeSettleFrames = 0;
+#endif
 }
 
 class StatHistory
@@ -288,6 +306,9 @@ public:
             return;
 
         m_GpuTimer.Start(*Context);
+#if AZB_MOD
+        m_GpuTimerStarted = true;
+#endif
 
         Context->PIXBeginEvent(m_Name.c_str());
     }
@@ -295,6 +316,13 @@ public:
     void StopTiming( CommandContext* Context )
     {
         m_EndTick = SystemTime::GetCurrentTick();
+
+#if AZB_MOD
+        // [AZB]: Both ticks are already in hand so this is just a push into the thread's trace buffer
+        if (Trace::IsCapturing())
+            Trace::RecordScope(Trace::TRACK_CPU, GetTraceNameId(), m_StartTick, m_EndTick);
+#endif
+
         if (Context == nullptr)
             return;
 
@@ -311,12 +339,36 @@ public:
         }
         if (EngineProfiling::Paused)
         {
+#if AZB_MOD
+            m_AccumulatedTicks = 0;
+#endif
             for (auto node : m_Children)
                 node->GatherTimes(FrameIndex);
             return;
         }
+#if AZB_MOD
+        // [AZB]: Scopes merged in from worker threads arrive as a total for the frame rather than a start and end
+        m_CpuTime.RecordStat(FrameIndex, 1000.0f * (float)(SystemTime::TimeBetweenTicks(m_StartTick, m_EndTick) + SystemTime::TicksToSeconds(m_AccumulatedTicks)));
+        m_AccumulatedTicks = 0;
+#else
         m_CpuTime.RecordStat(FrameIndex, 1000.0f * (float)SystemTime::TimeBetweenTicks(m_StartTick, m_EndTick));
+#endif
+#if AZB_MOD
+        // [AZB]: Scopes merged in from worker threads, or only ever timed without a context, have no timestamps behind their timer to read
+        m_GpuTime.RecordStat(FrameIndex, m_GpuTimerStarted ? 1000.0f * m_GpuTimer.GetTime() : 0.0f);
+#else
         m_GpuTime.RecordStat(FrameIndex, 1000.0f * m_GpuTimer.GetTime());
+#endif
+
+#if AZB_MOD
+        // [AZB]: GPU timestamps only become readable here, a few frames after the scope was recorded
+        int64_t GpuStartTick, GpuEndTick;
+        if (Trace::IsCapturing() && m_Parent != nullptr && m_GpuTimerStarted
+            && GpuTimeManager::GetCpuTimeStamps(m_GpuTimer.GetTimerIndex(), GpuStartTick, GpuEndTick))
+        {
+            Trace::RecordScope(Trace::TRACK_GPU, GetTraceNameId(), GpuStartTick, GpuEndTick);
+        }
+#endif
 
         for (auto node : m_Children)
             node->GatherTimes(FrameIndex);
@@ -331,6 +383,11 @@ public:
         gpuTime = 0.0f;
         for (auto iter = m_Children.begin(); iter != m_Children.end(); ++iter)
         {
+#if AZB_MOD
+            // [AZB]: Worker threads run alongside the frame rather than as part of it
+            if ((*iter)->m_IsThreadRoot)
+                continue;
+#endif
             cpuTime += (*iter)->m_CpuTime.GetLast();
             gpuTime += (*iter)->m_GpuTime.GetLast();
         }
@@ -343,6 +400,10 @@ public:
     {
         uint32_t FrameIndex = (uint32_t)Graphics::GetFrameCount();
 
+#if AZB_MOD
+        MergeThreadScopes();
+#endif
+
         GpuTimeManager::BeginReadBack();
         sm_RootScope.GatherTimes(FrameIndex);
         s_FrameDelta.RecordStat(FrameIndex, GpuTimeManager::GetTime(0));
@@ -354,11 +415,30 @@ public:
         s_TotalGpuTime.RecordStat(FrameIndex, TotalGpuTime);
 
         GraphRenderer::Update(XMFLOAT2(TotalCpuTime, TotalGpuTime), 0, GraphType::Global);
+
+#if AZB_MOD
+        // [AZB]: Push this frame's raw timings out to any history consumers. If nobody is draining a series the samples are simply dropped
+        float FrameDelta = s_FrameDelta.GetLast();
+        EngineProfiling::s_CpuTimeHistory.Publish(TotalCpuTime);
+        EngineProfiling::s_GpuTimeHistory.Publish(TotalGpuTime);
+        EngineProfiling::s_FrameRateHistory.Publish(FrameDelta > 0.0f ? 1.0f / FrameDelta : 0.0f);
+
+        if (EngineProfiling::s_FrameTimeSettleFrames > 0)
+            --EngineProfiling::s_FrameTimeSettleFrames;
+        else
+            EngineProfiling::s_FrameTimeAnalysis.Push(1000.0f * FrameDelta);
+#endif
     }
 
     static float GetTotalCpuTime(void) { return s_TotalCpuTime.GetAvg(); }
     static float GetTotalGpuTime(void) { return s_TotalGpuTime.GetAvg(); }
     static float GetFrameDelta(void) { return s_FrameDelta.GetAvg(); }
+#if AZB_MOD
+    // [AZB]: Unsmoothed values of the last gathered frame
+    static float GetLastCpuTime(void) { return s_TotalCpuTime.GetLast(); }
+    static float GetLastGpuTime(void) { return s_TotalGpuTime.GetLast(); }
+    static float GetLastFrameDelta(void) { return s_FrameDelta.GetLast(); }
+#endif
 
     static void Display( TextContext& Text, float x )
     {
@@ -378,6 +458,49 @@ public:
     }
     bool IsGraphed(){ return m_IsGraphed;}
 
+#if AZB_MOD
+    // [AZB]: Fold everything worker threads completed since last frame into the main tree. Each worker gets its own top-level node
+    static void MergeThreadScopes( void )
+    {
+        ThreadProfiler::Drain([](const ThreadProfiler::ScopeSample& Sample)
+        {
+            int64_t Ticks = Sample.m_EndTick - Sample.m_StartTick;
+            GetMergedNode(Sample.m_Node)->m_AccumulatedTicks += Ticks;
+
+            // The worker's own node shows the total of its top-level scopes
+            if (Sample.m_Node->m_Parent->m_Parent == nullptr)
+                GetMergedNode(Sample.m_Node->m_Parent)->m_AccumulatedTicks += Ticks;
+        });
+    }
+
+    static NestedTimingTree* GetMergedNode( ThreadProfiler::ScopeNode* Node )
+    {
+        if (Node->m_pUserData == nullptr)
+        {
+            NestedTimingTree* Merged;
+            if (Node->m_Parent == nullptr)
+            {
+                Merged = sm_RootScope.GetChild(Node->m_Name);
+                Merged->m_IsThreadRoot = true;
+            }
+            else
+            {
+                Merged = GetMergedNode(Node->m_Parent)->GetChild(Node->m_Name);
+            }
+            Node->m_pUserData = Merged;
+        }
+        return static_cast<NestedTimingTree*>(Node->m_pUserData);
+    }
+
+    // [AZB]: Registered lazily on the first traced use, after that it's a plain read
+    uint32_t GetTraceNameId(void)
+    {
+        if (m_TraceNameId == 0)
+            m_TraceNameId = Trace::RegisterName(m_Name);
+        return m_TraceNameId;
+    }
+#endif
+
 private:
 
     void DisplayNode( TextContext& Text, float x, float indent );
@@ -401,6 +524,12 @@ private:
     GpuTimer m_GpuTimer;
     bool m_IsGraphed;
     GraphHandle m_GraphHandle;
+#if AZB_MOD
+    uint32_t m_TraceNameId = 0;
+    int64_t m_AccumulatedTicks = 0;
+    bool m_IsThreadRoot = false;
+    bool m_GpuTimerStarted = false;
+#endif
     static StatHistory s_TotalCpuTime;
     static StatHistory s_TotalGpuTime;
     static StatHistory s_FrameDelta;
@@ -439,11 +568,30 @@ namespace EngineProfiling
 
     void BeginBlock(const wstring& name, CommandContext* Context)
     {
+#if AZB_MOD
+        // [AZB]: Workers keep their own tree, which gets merged in at Update(). GPU timers aren't thread-safe to allocate so those scopes are CPU only (PIX markers still go through)
+        if (std::this_thread::get_id() != s_MainThreadId)
+        {
+            if (Context != nullptr)
+                Context->PIXBeginEvent(name.c_str());
+            ThreadProfiler::BeginScope(name, SystemTime::GetCurrentTick());
+            return;
+        }
+#endif
         NestedTimingTree::PushProfilingMarker(name, Context);
     }
 
     void EndBlock(CommandContext* Context)
     {
+#if AZB_MOD
+        if (std::this_thread::get_id() != s_MainThreadId)
+        {
+            ThreadProfiler::EndScope(SystemTime::GetCurrentTick());
+            if (Context != nullptr)
+                Context->PIXEndEvent();
+            return;
+        }
+#endif
         NestedTimingTree::PopProfilingMarker(Context);
     }
 
@@ -468,6 +616,64 @@ namespace EngineProfiling
     {
         return 1.0f / NestedTimingTree::GetFrameDelta();
     }
+
+    const float GetLastCPUTime()
+    {
+        return NestedTimingTree::GetLastCpuTime();
+    }
+
+    const float GetLastGPUTime()
+    {
+        return NestedTimingTree::GetLastGpuTime();
+    }
+
+    const float GetLastFrameTime()
+    {
+        // Frame delta is recorded in seconds
+        return 1000.0f * NestedTimingTree::GetLastFrameDelta();
+    }
+
+    FrameTimeSeries& GetCPUTimeHistory()
+    {
+        return s_CpuTimeHistory;
+    }
+
+    FrameTimeSeries& GetGPUTimeHistory()
+    {
+        return s_GpuTimeHistory;
+    }
+
+    FrameTimeSeries& GetFrameRateHistory()
+    {
+        return s_FrameRateHistory;
+    }
+
+    bool StartTrace(const std::string& fileName, bool bBinary)
+    {
+        // Everything is written in raw performance counter ticks relative to now
+        return Trace::Start(fileName, bBinary ? Trace::BINARY : Trace::CHROME_JSON, SystemTime::GetCurrentTick(), 1.0 / SystemTime::TicksToSeconds(1));
+    }
+
+    void StopTrace()
+    {
+        Trace::Stop();
+    }
+
+    bool IsTracing()
+    {
+        return Trace::IsCapturing();
+    }
+
+    const FrameStats::FrameTimeAnalyzer& GetFrameTimeAnalysis()
+    {
+        return s_FrameTimeAnalysis;
+    }
+
+    void ResetFrameTimeAnalysis(uint32_t SettleFrames)
+    {
+        s_FrameTimeAnalysis.Reset();
+        s_FrameTimeSettleFrames = SettleFrames;
+    }
 #endif
 
     void DisplayFrameRate( TextContext& Text )
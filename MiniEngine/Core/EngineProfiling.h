@@ -21,11 +21,18 @@
 // modified: Aliyaan Zulfiqar
 //===============================================================================
 #include "AZB_Utils.h"
+#include "AZB_TimeSeries.h"
+#include "AZB_FrameStats.h"
 
 /*
    Change Log:
 
    [AZB] 21/10/24: Implemented accessors to pass performance metrics from app to ImGui 
+   [AZB] 18/10/26: Added unsmoothed per-frame accessors so the benchmark runner can build real distributions
+   [AZB] 18/10/26: Profiler now publishes per-frame samples into lock-free time series rather than the GUI polling it
+   [AZB] 18/10/26: Added timeline trace capture of every profiled scope for offline analysis
+   [AZB] 18/10/26: BeginBlock/EndBlock are now safe to call from worker threads, which get their own timing trees
+   [AZB] 18/10/26: Added streaming frame-time distribution analysis (quantiles, jitter, stutters, lows)
 */
 
 
@@ -48,6 +55,27 @@ namespace EngineProfiling
     const float GetCPUTime();
     const float GetGPUTime();
     const float GetFrameRate();
+
+    // [AZB]: The above are averaged over recent history - these return the raw values of the most recently completed frame (in ms)
+    const float GetLastCPUTime();
+    const float GetLastGPUTime();
+    const float GetLastFrameTime();
+
+    // [AZB]: Raw per-frame history, published by the profiler at the end of every Update(). Each series has a single consumer which should call Update() on it once per frame
+    typedef PerfHistory::TimeSeries<1000> FrameTimeSeries;
+    FrameTimeSeries& GetCPUTimeHistory();
+    FrameTimeSeries& GetGPUTimeHistory();
+    FrameTimeSeries& GetFrameRateHistory();
+
+    // [AZB]: Stream every CPU and GPU scope to disk until StopTrace() is called. JSON opens in chrome://tracing or ui.perfetto.dev, the binary format is described in AZB_Trace.h
+    bool StartTrace(const std::string& fileName, bool bBinary = false);
+    void StopTrace();
+    bool IsTracing();
+
+    // [AZB]: Frame-time distribution since the last reset, updated every frame. Reset whenever the pipeline changes so each config gets its own numbers,
+    // optionally skipping a few frames first so the hitch from the change itself isn't counted
+    const FrameStats::FrameTimeAnalyzer& GetFrameTimeAnalysis();
+    void ResetFrameTimeAnalysis(uint32_t SettleFrames = 0);
 #endif
 }
 
@@ -23,6 +23,7 @@
    [AZB] 21/10/24: Implemented mouse accessor to enable swapping of input focus between ImGui and application
    [AZB] 22/10/24: Tweaked ImGui implementation and added comments ready for DLSS
    [AZB] 13/11/24: Tweaked postFX to dynamically take in a colorbuffer
+   [AZB] 18/10/26: Make sure any running trace capture is flushed and closed on shutdown
 */
 
 #include "pch.h"
@@ -217,6 +218,7 @@ namespace GameCore
         // [AZB]: Cleanup our classes first!
 #if AZB_MOD
         RTUA_GUI::Terminate();
+        EngineProfiling::StopTrace();
 #endif
         // [AZB]: DLSS gets cleaned up inside Graphics::Shutdown
 
@@ -11,6 +11,16 @@
 // Author:  James Stanard 
 //
 
+//===============================================================================
+// desc: Linear GPU buffers and the views created over them
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: CreateConstantBufferView() keeps one descriptor per buffer rather than allocating another every call
+*/
+
 #include "pch.h"
 #include "GpuBuffer.h"
 #include "GraphicsCore.h"
@@ -138,11 +148,43 @@ D3D12_CPU_DESCRIPTOR_HANDLE GpuBuffer::CreateConstantBufferView(uint32_t Offset,
     CBVDesc.BufferLocation = m_GpuVirtualAddress + (size_t)Offset;
     CBVDesc.SizeInBytes = Size;
 
+#if AZB_MOD
+    // [AZB]: Asking for the same range again is free. A new range rewrites the cached descriptor in a fresh slot, and the
+    //        old one is only reused once the GPU has finished with anything it was copied into
+    if (m_CBV.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+    {
+        if (m_CBVOffset == Offset && m_CBVSize == Size)
+            return m_CBV;
+
+        FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_CBV);
+    }
+
+    m_CBV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    m_CBVOffset = Offset;
+    m_CBVSize = Size;
+    g_Device->CreateConstantBufferView(&CBVDesc, m_CBV);
+    return m_CBV;
+#else
     D3D12_CPU_DESCRIPTOR_HANDLE hCBV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
     g_Device->CreateConstantBufferView(&CBVDesc, hCBV);
     return hCBV;
+#endif
 }
 
+#if AZB_MOD
+void GpuBuffer::Destroy()
+{
+    // [AZB]: The view points at the old allocation, so it can't be kept across a Create() the way m_SRV/m_UAV are
+    if (m_CBV.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+    {
+        FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_CBV);
+        m_CBV.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+    }
+
+    GpuResource::Destroy();
+}
+#endif
+
 D3D12_RESOURCE_DESC GpuBuffer::DescribeBuffer(void)
 {
     ASSERT(m_BufferSize != 0);
@@ -11,10 +11,21 @@
 // Author:  James Stanard 
 //
 
+//===============================================================================
+// desc: Linear GPU buffers and the views created over them
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: CreateConstantBufferView() keeps one descriptor per buffer rather than allocating another every call
+*/
+
 #pragma once
 
 #include "pch.h"
 #include "GpuResource.h"
+#include "AZB_Utils.h"
 
 class CommandContext;
 class EsramAllocator;
@@ -25,6 +36,11 @@ class GpuBuffer : public GpuResource
 public:
     virtual ~GpuBuffer() { Destroy(); }
 
+#if AZB_MOD
+    // [AZB]: Hands the cached constant buffer view back to the descriptor allocator
+    virtual void Destroy() override;
+#endif
+
     // Create a buffer.  If initial data is provided, it will be copied into the buffer using the default command context.
     void Create( const std::wstring& name, uint32_t NumElements, uint32_t ElementSize,
         const void* initialData = nullptr );
@@ -45,6 +61,9 @@ public:
 
     D3D12_GPU_VIRTUAL_ADDRESS RootConstantBufferView(void) const { return m_GpuVirtualAddress; }
 
+#if AZB_MOD
+    // [AZB]: The returned handle stays valid until the buffer is destroyed or a different range is requested
+#endif
     D3D12_CPU_DESCRIPTOR_HANDLE CreateConstantBufferView( uint32_t Offset, uint32_t Size ) const;
 
     D3D12_VERTEX_BUFFER_VIEW VertexBufferView(size_t Offset, uint32_t Size, uint32_t Stride) const;
@@ -72,6 +91,11 @@ protected:
         m_ResourceFlags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
         m_UAV.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
         m_SRV.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+#if AZB_MOD
+        m_CBV.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+        m_CBVOffset = 0;
+        m_CBVSize = 0;
+#endif
     }
 
     D3D12_RESOURCE_DESC DescribeBuffer(void);
@@ -80,6 +104,13 @@ protected:
     D3D12_CPU_DESCRIPTOR_HANDLE m_UAV;
     D3D12_CPU_DESCRIPTOR_HANDLE m_SRV;
 
+#if AZB_MOD
+    // [AZB]: Filled lazily by CreateConstantBufferView(), which is const, hence mutable
+    mutable D3D12_CPU_DESCRIPTOR_HANDLE m_CBV;
+    mutable uint32_t m_CBVOffset;
+    mutable uint32_t m_CBVSize;
+#endif
+
     size_t m_BufferSize;
     uint32_t m_ElementCount;
     uint32_t m_ElementSize;
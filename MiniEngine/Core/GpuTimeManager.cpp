@@ -16,6 +16,7 @@
 #include "GraphicsCore.h"
 #include "CommandContext.h"
 #include "CommandListManager.h"
+#include "SystemTime.h"
 
 namespace
 {
@@ -28,6 +29,11 @@ namespace
     uint64_t sm_ValidTimeStart = 0;
     uint64_t sm_ValidTimeEnd = 0;
     double sm_GpuTickDelta = 0.0;
+#if AZB_MOD
+    // [AZB]: Matching GPU and CPU timestamps, refreshed every readback so drift between the two clocks never builds up
+    uint64_t sm_CalibrationGpuTick = 0;
+    uint64_t sm_CalibrationCpuTick = 0;
+#endif
 }
 
 void GpuTimeManager::Initialize(uint32_t MaxNumTimers)
@@ -103,6 +109,10 @@ void GpuTimeManager::BeginReadBack(void)
     Range.End = (sm_NumTimers * 2) * sizeof(uint64_t);
     ASSERT_SUCCEEDED(sm_ReadBackBuffer->Map(0, &Range, reinterpret_cast<void**>(&sm_TimeStampBuffer)));
 
+#if AZB_MOD
+    Graphics::g_CommandManager.GetCommandQueue()->GetClockCalibration(&sm_CalibrationGpuTick, &sm_CalibrationCpuTick);
+#endif
+
     sm_ValidTimeStart = sm_TimeStampBuffer[0];
     sm_ValidTimeEnd = sm_TimeStampBuffer[1];
 
@@ -141,3 +151,23 @@ float GpuTimeManager::GetTime(uint32_t TimerIdx)
 
     return static_cast<float>(sm_GpuTickDelta * (TimeStamp2 - TimeStamp1));
 }
+
+#if AZB_MOD
+bool GpuTimeManager::GetCpuTimeStamps(uint32_t TimerIdx, int64_t& StartTick, int64_t& EndTick)
+{
+    ASSERT(sm_TimeStampBuffer != nullptr, "Time stamp readback buffer is not mapped");
+    ASSERT(TimerIdx < sm_NumTimers, "Invalid GPU timer index");
+
+    uint64_t TimeStamp1 = sm_TimeStampBuffer[TimerIdx * 2];
+    uint64_t TimeStamp2 = sm_TimeStampBuffer[TimerIdx * 2 + 1];
+
+    if (TimeStamp1 < sm_ValidTimeStart || TimeStamp2 > sm_ValidTimeEnd || TimeStamp2 <= TimeStamp1 )
+        return false;
+
+    // Timestamps are usually from before the calibration point, so keep the offsets signed
+    const double GpuToCpuTicks = sm_GpuTickDelta / SystemTime::TicksToSeconds(1);
+    StartTick = (int64_t)sm_CalibrationCpuTick + (int64_t)((double)(int64_t)(TimeStamp1 - sm_CalibrationGpuTick) * GpuToCpuTicks);
+    EndTick = (int64_t)sm_CalibrationCpuTick + (int64_t)((double)(int64_t)(TimeStamp2 - sm_CalibrationGpuTick) * GpuToCpuTicks);
+    return true;
+}
+#endif
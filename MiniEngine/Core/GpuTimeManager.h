@@ -36,4 +36,10 @@ namespace GpuTimeManager
 
     // Returns the time in milliseconds between start and stop queries
     float GetTime(uint32_t TimerIdx);
+
+#if AZB_MOD
+    // [AZB]: The raw start and stop timestamps of a timer, translated onto the CPU's performance counter timeline so they can sit alongside CPU scopes in a trace.
+    // Same validity rules as GetTime() - returns false if the timer wasn't written during the frame being read back
+    bool GetCpuTimeStamps(uint32_t TimerIdx, int64_t& StartTick, int64_t& EndTick);
+#endif
 }
@@ -12,6 +12,15 @@
 //
 
 #pragma once
+//===============================================================================
+// desc: Graphics device setup and shutdown, and the globals that go with it
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Added FreeDescriptor() to go with AllocateDescriptor()
+*/
 
 #include "PipelineState.h"
 #include "DescriptorHeap.h"
@@ -49,4 +58,12 @@ namespace Graphics
     {
         return g_DescriptorAllocator[Type].Allocate(Count);
     }
+
+#if AZB_MOD
+    // [AZB]: Count must match the AllocateDescriptor() call. Safe to call while the GPU may still be using the descriptors
+    inline void FreeDescriptor( D3D12_DESCRIPTOR_HEAP_TYPE Type, D3D12_CPU_DESCRIPTOR_HANDLE Handle, UINT Count = 1 )
+    {
+        g_DescriptorAllocator[Type].Free(Handle, Count);
+    }
+#endif
 }
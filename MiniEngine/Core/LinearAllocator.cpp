@@ -12,6 +12,16 @@
 //             Alex Nankervis
 //
 
+//===============================================================================
+// desc: This is a dynamic graphics memory allocator for DX12
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: RequestPage(), DiscardPages() and FreeLargePages() go through PageRecycling::Recycler rather than locking m_Mutex
+*/
+
 #include "pch.h"
 #include "LinearAllocator.h"
 #include "GraphicsCore.h"
@@ -23,7 +33,39 @@ using namespace std;
 
 LinearAllocatorType LinearAllocatorPageManager::sm_AutoType = kGpuExclusive;
 
+#if AZB_MOD
+namespace
+{
+    // [AZB]: What the recycler checks retired pages against. Defined ahead of sm_PageManager so it's constructed first
+    class CommandManagerFence : public PageRecycling::IFence
+    {
+    public:
+        virtual bool IsFenceComplete(uint64_t FenceValue) override { return g_CommandManager.IsFenceComplete(FenceValue); }
+    };
+
+    CommandManagerFence s_CommandManagerFence;
+
+    // [AZB]: Pages are handed over in small batches like this, as LinearAllocationPage* can't just be reinterpreted as Node*
+    constexpr size_t kRetireBatch = 32;
+
+    template <typename RetireFunc>
+    void RetireInBatches(const vector<LinearAllocationPage*>& Pages, RetireFunc Retire)
+    {
+        PageRecycling::Node* Nodes[kRetireBatch];
+        for (size_t Start = 0; Start < Pages.size(); Start += kRetireBatch)
+        {
+            const size_t Count = std::min(kRetireBatch, Pages.size() - Start);
+            for (size_t i = 0; i < Count; ++i)
+                Nodes[i] = Pages[Start + i];
+            Retire(Nodes, Count);
+        }
+    }
+}
+
+LinearAllocatorPageManager::LinearAllocatorPageManager() : m_Recycler(s_CommandManagerFence)
+#else
 LinearAllocatorPageManager::LinearAllocatorPageManager()
+#endif
 {
     m_AllocationType = sm_AutoType;
     sm_AutoType = (LinearAllocatorType)(sm_AutoType + 1);
@@ -34,6 +76,17 @@ LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
 
 LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
 {
+#if AZB_MOD
+    // [AZB]: Usually a thread-local or lock-free pop. Only making a new page takes the lock, and the page is created outside it
+    if (PageRecycling::Node* Recycled = m_Recycler.Acquire())
+        return static_cast<LinearAllocationPage*>(Recycled);
+
+    LinearAllocationPage* NewPage = CreateNewPage();
+
+    lock_guard<mutex> LockGuard(m_Mutex);
+    m_PagePool.emplace_back(NewPage);
+    return NewPage;
+#else
     lock_guard<mutex> LockGuard(m_Mutex);
 
     while (!m_RetiredPages.empty() && g_CommandManager.IsFenceComplete(m_RetiredPages.front().first))
@@ -56,17 +109,37 @@ LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
     }
 
     return PagePtr;
+#endif
 }
 
 void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
 {
+#if AZB_MOD
+    // [AZB]: Lock-free push. The fence isn't looked at until someone runs out of pages
+    RetireInBatches(UsedPages, [&](PageRecycling::Node* const* Nodes, size_t Count) { m_Recycler.Retire(FenceValue, Nodes, Count); });
+#else
     lock_guard<mutex> LockGuard(m_Mutex);
     for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
         m_RetiredPages.push(make_pair(FenceValue, *iter));
+#endif
 }
 
 void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages )
 {
+#if AZB_MOD
+    // [AZB]: Destroy whichever earlier large pages the GPU is done with. If another thread is already checking, they're left for next time
+    PageRecycling::Node* Deletable = m_Recycler.CollectDeletable();
+    while (Deletable != nullptr)
+    {
+        PageRecycling::Node* Next = Deletable->m_pNextRecycled.load(std::memory_order_relaxed);
+        delete static_cast<LinearAllocationPage*>(Deletable);
+        Deletable = Next;
+    }
+
+    for (LinearAllocationPage* Page : LargePages)
+        Page->Unmap();
+    RetireInBatches(LargePages, [&](PageRecycling::Node* const* Nodes, size_t Count) { m_Recycler.RetireForDeletion(FenceValue, Nodes, Count); });
+#else
     lock_guard<mutex> LockGuard(m_Mutex);
 
     while (!m_DeletionQueue.empty() && g_CommandManager.IsFenceComplete(m_DeletionQueue.front().first))
@@ -80,6 +153,7 @@ void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vect
         (*iter)->Unmap();
         m_DeletionQueue.push(make_pair(FenceValue, *iter));
     }
+#endif
 }
 
 LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize  )
@@ -21,12 +21,32 @@
 // scheduled for reuse after the fence has cleared.
 
 #pragma once
+//===============================================================================
+// desc: This is a dynamic graphics memory allocator for DX12
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Page requests and retirement no longer share a mutex - pages are recycled through PageRecycling::Recycler instead
+*/
 
 #include "GpuResource.h"
 #include <vector>
 #include <queue>
 #include <mutex>
 
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+
+#if AZB_MOD
+#include "AZB_PageRecycler.h"
+#endif
+
 // Constant blocks must be multiples of 16 constants @ 16 bytes each
 #define DEFAULT_ALIGN 256
 
@@ -43,7 +63,12 @@ struct DynAlloc
     D3D12_GPU_VIRTUAL_ADDRESS GpuAddress;	// The GPU-visible address
 };
 
+#if AZB_MOD
+// [AZB]: Pages link themselves into the recycler's lists, so retiring them doesn't allocate
+class LinearAllocationPage : public GpuResource, public PageRecycling::Node
+#else
 class LinearAllocationPage : public GpuResource
+#endif
 {
 public:
     LinearAllocationPage(ID3D12Resource* pResource, D3D12_RESOURCE_STATES Usage) : GpuResource()
@@ -111,7 +136,12 @@ public:
     // "large" pages.
     void FreeLargePages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
 
+#if AZB_MOD
+    // [AZB]: Forget the recycled pages before they're destroyed, as some may still be cached on other threads
+    void Destroy( void ) { m_Recycler.Clear(); m_PagePool.clear(); }
+#else
     void Destroy( void ) { m_PagePool.clear(); }
+#endif
 
 private:
 
@@ -119,9 +149,15 @@ private:
 
     LinearAllocatorType m_AllocationType;
     std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
+#if AZB_MOD
+    // [AZB]: Retired pages, checked against their fences in batches, and handed back through per-thread caches and a lock-free pool.
+    //        m_Mutex now only guards m_PagePool, which is only touched when a brand new page is made
+    PageRecycling::Recycler m_Recycler;
+#else
     std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
     std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
     std::queue<LinearAllocationPage*> m_AvailablePages;
+#endif
     std::mutex m_Mutex;
 };
 
@@ -20,6 +20,7 @@
    Change Log:
    [AZB] 19/11/24: Added an extra step to call my helper CS to decode MVs into a format ready for DLSS!
    [AZB] 19/11/24: Moving my motion vector stuff into it's own namespace!
+   [AZB] 18/10/26: The inputs to DoF and motion blur can be captured to disk a frame at a time, for the CPU post effects reference to run over
 
 */
 
@@ -45,6 +46,11 @@
 #include "CompiledShaders/TemporalBlendCS.h"
 #include "CompiledShaders/BoundNeighborhoodCS.h"
 
+#if AZB_MOD
+#include "AZB_PostFXReference.h"
+#include "ReadbackBuffer.h"
+#endif
+
 using namespace Graphics;
 using namespace Math;
 
@@ -57,6 +63,19 @@ namespace MotionBlur
     ComputePSO s_MotionBlurFinalPassCS(L"Motion Blur: Motion Blur Final Pass CS");
     GraphicsPSO s_MotionBlurFinalPassPS(L"Motion Blur: Motion Blur Final Pass PS");
     ComputePSO s_CameraVelocityCS[2] = { { L"Motion Blur: Camera Velocity CS" },{ L"Motion Blur: Camera Velocity Linear Z CS" } };
+
+#if AZB_MOD
+    // [AZB]: Frames are read back and written out as they're rendered, until the count runs down
+    void CapturePostFXFrame(CommandContext& BaseContext, float farClip);
+    void EndPostFXCapture(void);
+
+    PostFXReference::InputWriter s_PostFXCapture;
+    std::wstring s_PostFXCaptureFile;
+    uint32_t s_PostFXCaptureFramesLeft = 0;
+    std::vector<uint16_t> s_PostFXCaptureDepth;
+    std::vector<uint32_t> s_PostFXCaptureColor;
+    std::vector<uint32_t> s_PostFXCaptureVelocity;
+#endif
 }
 
 void MotionBlur::Initialize( void )
@@ -95,6 +114,9 @@ void MotionBlur::Initialize( void )
 
 void MotionBlur::Shutdown( void )
 {
+#if AZB_MOD
+    EndPostFXCapture();
+#endif
 }
 
 // Linear Z ends up being faster since we haven't officially decompressed the depth buffer.  You 
@@ -151,7 +173,103 @@ void MotionBlur::GenerateCameraVelocityBuffer( CommandContext& BaseContext, cons
     Context.SetDynamicDescriptor(1, 0, UseLinearZ ? LinearDepth.GetSRV() : g_SceneDepthBuffer.GetDepthSRV());
     Context.SetDynamicDescriptor(2, 0, g_VelocityBuffer.GetUAV());
     Context.Dispatch2D(Width, Height);
+
+#if AZB_MOD
+    // [AZB]: Everything DoF and motion blur would read is in place by now, before the upscaler gets to the scene colour
+    if (s_PostFXCaptureFramesLeft > 0)
+        CapturePostFXFrame(BaseContext, farClip);
+#endif
+}
+
+#if AZB_MOD
+void MotionBlur::BeginPostFXCapture(const std::wstring& fileName, uint32_t frameCount)
+{
+    EndPostFXCapture();
+
+    // The file's opened on the first frame, once the size of the buffers is known
+    s_PostFXCaptureFile = fileName;
+    s_PostFXCaptureFramesLeft = frameCount;
+}
+
+bool MotionBlur::IsCapturingPostFX(void)
+{
+    return s_PostFXCaptureFramesLeft > 0;
+}
+
+void MotionBlur::EndPostFXCapture(void)
+{
+    if (s_PostFXCapture.IsOpen())
+    {
+        const uint32_t frameCount = s_PostFXCapture.GetFrameCount();
+        if (s_PostFXCapture.Close())
+            Utility::Printf("Post effects capture: %u frames written\n", frameCount);
+        else
+            Utility::Printf("Post effects capture: failed writing frames, only the first %u will load\n", frameCount);
+    }
+    s_PostFXCaptureFramesLeft = 0;
+}
+
+void MotionBlur::CapturePostFXFrame(CommandContext& BaseContext, float farClip)
+{
+    ColorBuffer& LinearDepth = g_LinearDepth[ TemporalEffects::GetFrameIndexMod2() ];
+    if (LinearDepth.GetFormat() != DXGI_FORMAT_R16_UNORM || g_SceneColorBuffer.GetFormat() != DXGI_FORMAT_R11G11B10_FLOAT ||
+        g_VelocityBuffer.GetFormat() != DXGI_FORMAT_R32_UINT)
+    {
+        Utility::Printf("Post effects capture: buffers aren't R16_UNORM, R11G11B10_FLOAT and R32_UINT, stopping\n");
+        EndPostFXCapture();
+        return;
+    }
+
+    const uint32_t width = g_SceneColorBuffer.GetWidth();
+    const uint32_t height = g_SceneColorBuffer.GetHeight();
+    if (!s_PostFXCapture.IsOpen())
+    {
+        if (!s_PostFXCapture.Open(s_PostFXCaptureFile, width, height))
+        {
+            Utility::Printf("Post effects capture: couldn't open %ls\n", s_PostFXCaptureFile.c_str());
+            s_PostFXCaptureFramesLeft = 0;
+            return;
+        }
+    }
+    else if (s_PostFXCapture.GetWidth() != width || s_PostFXCapture.GetHeight() != height)
+    {
+        Utility::Printf("Post effects capture: resolution changed, stopping\n");
+        EndPostFXCapture();
+        return;
+    }
+
+    // Copied out on the context that generated the velocity, after it, and waited on
+    ReadbackBuffer depthReadback, colorReadback, velocityReadback;
+    const uint32_t depthPitch = BaseContext.ReadbackTexture(depthReadback, LinearDepth);
+    const uint32_t colorPitch = BaseContext.ReadbackTexture(colorReadback, g_SceneColorBuffer);
+    const uint32_t velocityPitch = BaseContext.ReadbackTexture(velocityReadback, g_VelocityBuffer);
+    BaseContext.Flush(true);
+
+    // Rows are padded out to the copy pitch, so they're taken one at a time
+    s_PostFXCaptureDepth.resize((size_t)width * height);
+    s_PostFXCaptureColor.resize((size_t)width * height);
+    s_PostFXCaptureVelocity.resize((size_t)width * height);
+
+    const uint8_t* memory = (const uint8_t*)depthReadback.Map();
+    for (uint32_t y = 0; y < height; ++y)
+        memcpy(&s_PostFXCaptureDepth[(size_t)y * width], memory + (size_t)y * depthPitch, width * sizeof(uint16_t));
+    depthReadback.Unmap();
+
+    memory = (const uint8_t*)colorReadback.Map();
+    for (uint32_t y = 0; y < height; ++y)
+        memcpy(&s_PostFXCaptureColor[(size_t)y * width], memory + (size_t)y * colorPitch, width * sizeof(uint32_t));
+    colorReadback.Unmap();
+
+    memory = (const uint8_t*)velocityReadback.Map();
+    for (uint32_t y = 0; y < height; ++y)
+        memcpy(&s_PostFXCaptureVelocity[(size_t)y * width], memory + (size_t)y * velocityPitch, width * sizeof(uint32_t));
+    velocityReadback.Unmap();
+
+    if (!s_PostFXCapture.Write(s_PostFXCaptureDepth.data(), s_PostFXCaptureColor.data(), s_PostFXCaptureVelocity.data(), farClip) ||
+        --s_PostFXCaptureFramesLeft == 0)
+        EndPostFXCapture();
 }
+#endif
 
 
 void MotionBlur::RenderCameraBlur( CommandContext& BaseContext, const Camera& camera, bool UseLinearZ )
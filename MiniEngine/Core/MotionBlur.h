@@ -15,6 +15,9 @@
 
 #include "EngineTuning.h"
 
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+
 // Forward declarations
 namespace Math { class Matrix4; class Camera; }
 class ColorBuffer;
@@ -38,4 +41,11 @@ namespace MotionBlur
     // Generate proper motion blur that takes into account the velocity of each pixel.  Requires a pre-generated
     // velocity buffer (R16G16_FLOAT preferred.)
     void RenderObjectBlur( CommandContext& Context, ColorBuffer& velocityBuffer );
+
+#if AZB_MOD
+    // [AZB]: Writes the linear depth, scene colour and velocity of the next frameCount frames to fileName, as they stand once camera velocity is
+    //        generated, for PostFXReference to run DoF and motion blur over offline. Each frame waits on three readbacks, so this is for capturing only
+    void BeginPostFXCapture(const std::wstring& fileName, uint32_t frameCount);
+    bool IsCapturingPostFX(void);
+#endif
 }
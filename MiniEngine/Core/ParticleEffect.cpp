@@ -93,8 +93,18 @@ void ParticleEffect::LoadDeviceResources(ID3D12Device* device)
     m_RandomStateBuffer.Create(L"ParticleSystem::SpawnDataBuffer", m_EffectProperties.EmitProperties.MaxParticles, sizeof(ParticleSpawnData), pSpawnData);
     _freea(pSpawnData);
 
+#if AZB_MOD
+    // [AZB]: A recycled effect keeps its state buffers if they're the right size. What's left in them doesn't matter, since the dispatch args
+    // below start it off with no particles
+    if (m_StateBuffers[0].GetElementCount() != m_EffectProperties.EmitProperties.MaxParticles)
+    {
+        m_StateBuffers[0].Create(L"ParticleSystem::Buffer0", m_EffectProperties.EmitProperties.MaxParticles, sizeof(ParticleMotion));
+        m_StateBuffers[1].Create(L"ParticleSystem::Buffer1", m_EffectProperties.EmitProperties.MaxParticles, sizeof(ParticleMotion));
+    }
+#else
     m_StateBuffers[0].Create(L"ParticleSystem::Buffer0", m_EffectProperties.EmitProperties.MaxParticles, sizeof(ParticleMotion));
     m_StateBuffers[1].Create(L"ParticleSystem::Buffer1", m_EffectProperties.EmitProperties.MaxParticles, sizeof(ParticleMotion));
+#endif
     m_CurrentStateBuffer = 0;
 
     //DispatchIndirect args buffer / number of thread groups
@@ -164,3 +174,11 @@ void ParticleEffect::Reset()
 {
     m_EffectProperties = m_OriginalEffectProperties;
 }
+
+#if AZB_MOD
+void ParticleEffect::Recycle(ParticleEffectProperties& effectProperties)
+{
+    m_ElapsedTime = 0.0;
+    m_EffectProperties = effectProperties;
+}
+#endif
@@ -26,6 +26,10 @@ public:
     float GetLifetime(){ return m_EffectProperties.TotalActiveLifetime; }
     float GetElapsedTime(){ return m_ElapsedTime; }
     void Reset();
+#if AZB_MOD
+    // [AZB]: Hands a pooled effect over to new properties. LoadDeviceResources() has to be called again before it's next updated
+    void Recycle(ParticleEffectProperties& effectProperties);
+#endif
 
 private:
 
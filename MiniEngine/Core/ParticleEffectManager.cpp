@@ -80,6 +80,8 @@
 /*
    Change Log:
    [AZB] 13/11/24: Added a check to apply post-processing to DLSS_OutputBuffer and not the main color buffer when DLSS enabled!
+   [AZB] 18/10/26: Added MakeSimDesc, to run an effect through the CPU particle backend
+   [AZB] 18/10/26: Effects live in a generational slot map, spawned through a lock-free queue and recycled once the GPU is done with them
 
 */
 
@@ -97,6 +99,7 @@
 // [AZB]: These will only be included if the global modificiation macro is defined as true (=1)
 #if AZB_MOD
 #include "AZB_DLSS.h"
+#include "AZB_SlotMap.h"
 #endif
 
 
@@ -182,8 +185,25 @@ namespace
     D3D12_CPU_DESCRIPTOR_HANDLE TextureArraySRV;
     std::vector<std::wstring> TextureNameArray;
 
+#if AZB_MOD
+    // [AZB]: Effects used to be addressed by where they sat in ParticleEffectsActive, which moved under them whenever an earlier one expired.
+    // Now each gets a slot, and a handle that only resolves while it's alive. The ParticleEffect in a slot is kept for whoever lands there next
+    constexpr uint32_t kMaxEffects = 4096;
+
+    class CommandManagerFence : public SlotMap::IFence
+    {
+    public:
+        virtual bool IsFenceComplete(uint64_t FenceValue) override { return g_CommandManager.IsFenceComplete(FenceValue); }
+    };
+
+    CommandManagerFence s_CommandManagerFence;
+    SlotMap::Map s_EffectSlots(s_CommandManagerFence, kMaxEffects);
+    std::vector<std::unique_ptr<ParticleEffect>> ParticleEffectsPool;   // One per slot, made the first time the slot is used
+    std::vector<uint32_t> s_SpawnedSlots;
+#else
     std::vector<std::unique_ptr<ParticleEffect>> ParticleEffectsPool;
     std::vector<ParticleEffect*> ParticleEffectsActive;
+#endif
 
     static bool s_InitComplete = false; 
     UINT TotalElapsedFrames;
@@ -554,6 +574,9 @@ void ParticleEffectManager::Initialize( uint32_t MaxDisplayWidth, uint32_t MaxDi
         s_RNG.SetSeed(1);
     
     TotalElapsedFrames = 0;
+#if AZB_MOD
+    ParticleEffectsPool.resize(s_EffectSlots.GetCapacity());
+#endif
     s_InitComplete = true;
 }
 
@@ -586,6 +609,30 @@ void ParticleEffectManager::Shutdown( void )
     TextureArray.Destroy();
 }
 
+#if AZB_MOD
+static_assert(SlotMap::kInvalidHandle == EFFECTS_ERROR, "A full slot map has to look like any other failure to callers");
+
+// [AZB]: Any thread, without locking. The effect is queued to go live at the start of the next Update()
+EffectHandle ParticleEffectManager::InstantiateEffect( ParticleEffectProperties& effectProperties )
+{
+    if (!s_InitComplete)
+        return EFFECTS_ERROR;
+
+    SlotMap::Handle handle = s_EffectSlots.Reserve();
+    if (handle == SlotMap::kInvalidHandle)
+        return EFFECTS_ERROR;
+
+    // [AZB]: Nobody else touches the slot until it's published, and the GPU was done with whatever had it last before it was freed
+    std::unique_ptr<ParticleEffect>& effect = ParticleEffectsPool[SlotMap::GetSlot(handle)];
+    if (effect)
+        effect->Recycle(effectProperties);
+    else
+        effect.reset(new ParticleEffect(effectProperties));
+
+    s_EffectSlots.Publish(handle);
+    return handle;
+}
+#else
 //Returns index into Active
 EffectHandle ParticleEffectManager::InstantiateEffect( ParticleEffectProperties& effectProperties )
 {
@@ -603,6 +650,7 @@ EffectHandle ParticleEffectManager::InstantiateEffect( ParticleEffectProperties&
     ParticleEffectsActive[index]->LoadDeviceResources(Graphics::g_Device);
     return index;	
 }
+#endif
 
 //---------------------------------------------------------------------
 //
@@ -612,8 +660,24 @@ EffectHandle ParticleEffectManager::InstantiateEffect( ParticleEffectProperties&
 
 void ParticleEffectManager::Update(ComputeContext& Context, float timeDelta )
 {
+#if AZB_MOD
+    // [AZB]: Slots the GPU is done with are freed, and whatever was spawned since last frame goes live. Done ahead of the early outs, so spawns
+    // don't pile up while particles are off or paused
+    if (s_InitComplete)
+    {
+        s_EffectSlots.Recycle();
+        s_SpawnedSlots.clear();
+        s_EffectSlots.Drain(s_SpawnedSlots);
+        for (uint32_t slot : s_SpawnedSlots)
+            ParticleEffectsPool[slot]->LoadDeviceResources(Graphics::g_Device);
+    }
+
+    if (!Enable || !s_InitComplete || s_EffectSlots.GetLiveCount() == 0)
+        return;
+#else
     if (!Enable || !s_InitComplete || ParticleEffectsActive.size() == 0)
         return;
+#endif
 
     ScopedTimer _prof(L"Particle Update", Context);
 
@@ -625,14 +689,34 @@ void ParticleEffectManager::Update(ComputeContext& Context, float timeDelta )
 
     Context.ResetCounter(SpriteVertexBuffer);
 
+#if AZB_MOD
+    if (s_EffectSlots.GetLiveCount() == 0)
+        return;
+#else
     if (ParticleEffectsActive.size() == 0)
         return;
+#endif
 
     Context.SetRootSignature(RootSig);
     Context.SetConstants(0, timeDelta);
     Context.TransitionResource(SpriteVertexBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
     Context.SetDynamicDescriptor(3, 0, SpriteVertexBuffer.GetUAV());
 
+#if AZB_MOD
+    // [AZB]: An expired effect has the last live one swapped into its place, which hasn't been updated yet, so the same index goes round again.
+    // Its slot can't be reused until the GPU has run what was just recorded for it, which goes out on the graphics queue with the rest of the frame
+    const uint64_t RetireFence = g_CommandManager.GetGraphicsQueue().GetNextFenceValue();
+    for (uint32_t i = 0; i < s_EffectSlots.GetLiveCount(); )
+    {
+        ParticleEffect* effect = ParticleEffectsPool[s_EffectSlots.GetLiveSlot(i)].get();
+        effect->Update(Context, timeDelta);
+
+        if (effect->GetLifetime() <= effect->GetElapsedTime())
+            s_EffectSlots.Despawn(i, RetireFence);
+        else
+            ++i;
+    }
+#else
     for (UINT i = 0; i < ParticleEffectsActive.size(); ++i)
     {	
         ParticleEffectsActive[i]->Update(Context, timeDelta);
@@ -647,6 +731,7 @@ void ParticleEffectManager::Update(ComputeContext& Context, float timeDelta )
             s_EraseEffectMutex.unlock();
         }
     }
+#endif
 
     SetFinalBuffers(Context);
 }
@@ -660,8 +745,13 @@ void ParticleEffectManager::Update(ComputeContext& Context, float timeDelta )
 
 void ParticleEffectManager::Render( CommandContext& Context, const Camera& Camera, ColorBuffer& ColorTarget, DepthBuffer& DepthTarget, ColorBuffer& LinearDepth)
 {
+#if AZB_MOD
+    if (!Enable || !s_InitComplete || s_EffectSlots.GetLiveCount() == 0)
+        return;
+#else
     if (!Enable || !s_InitComplete || ParticleEffectsActive.size() == 0)
         return;
+#endif
 
     uint32_t Width = (uint32_t)ColorTarget.GetWidth();
     uint32_t Height = (uint32_t)ColorTarget.GetHeight();
@@ -740,11 +830,38 @@ void ParticleEffectManager::Render( CommandContext& Context, const Camera& Camer
 
 void ParticleEffectManager::ClearAll()
 {
+#if AZB_MOD
+    // [AZB]: Every slot goes straight back, so this is only for when the GPU is idle. The pool keeps its size, but Shutdown() relies on the
+    // effects themselves going, to free their buffers
+    s_EffectSlots.Clear();
+    for (std::unique_ptr<ParticleEffect>& effect : ParticleEffectsPool)
+        effect.reset();
+#else
     ParticleEffectsActive.clear();
     ParticleEffectsPool.clear();
+#endif
     TextureNameArray.clear();
 }
 
+#if AZB_MOD
+// [AZB]: A handle to an effect that's expired, or hasn't gone live yet, finds nothing rather than whichever effect has taken its place
+void ParticleEffectManager::ResetEffect(EffectHandle EffectID)
+{
+    if (!s_InitComplete || PauseSim || s_EffectSlots.FindLive(EffectID) == UINT32_MAX)
+        return;
+
+    ParticleEffectsPool[SlotMap::GetSlot(EffectID)]->Reset();
+}
+
+
+float ParticleEffectManager::GetCurrentLife(EffectHandle EffectID)
+{
+    if (!s_InitComplete || PauseSim || s_EffectSlots.FindLive(EffectID) == UINT32_MAX)
+        return -1.0;
+
+    return ParticleEffectsPool[SlotMap::GetSlot(EffectID)]->GetElapsedTime();
+}
+#else
 void ParticleEffectManager::ResetEffect(EffectHandle EffectID)
 {
     if (!s_InitComplete || ParticleEffectsActive.size() == 0 || PauseSim || EffectID >= ParticleEffectsActive.size())
@@ -761,3 +878,45 @@ float ParticleEffectManager::GetCurrentLife(EffectHandle EffectID)
     
     return ParticleEffectsActive[EffectID]->GetElapsedTime();
 }
+#endif
+
+#if AZB_MOD
+static_assert(sizeof(ParticleSim::SpriteVertex) == sizeof(ParticleVertex), "CPU sprites have to copy straight into SpriteVertexBuffer");
+
+ParticleSim::EffectDesc ParticleEffectManager::MakeSimDesc(const ParticleEffectProperties& effectProperties)
+{
+    const EmissionProperties& emit = effectProperties.EmitProperties;
+
+    ParticleSim::EffectDesc desc;
+    desc.m_EmitPosition[0] = emit.EmitPosW.x; desc.m_EmitPosition[1] = emit.EmitPosW.y; desc.m_EmitPosition[2] = emit.EmitPosW.z;
+    desc.m_EmitDirection[0] = emit.EmitDirW.x; desc.m_EmitDirection[1] = emit.EmitDirW.y; desc.m_EmitDirection[2] = emit.EmitDirW.z;
+    desc.m_EmitRight[0] = emit.EmitRightW.x; desc.m_EmitRight[1] = emit.EmitRightW.y; desc.m_EmitRight[2] = emit.EmitRightW.z;
+    desc.m_EmitUp[0] = emit.EmitUpW.x; desc.m_EmitUp[1] = emit.EmitUpW.y; desc.m_EmitUp[2] = emit.EmitUpW.z;
+    desc.m_EmitSpeed = emit.EmitSpeed;
+    desc.m_EmitterVelocitySensitivity = emit.EmitterVelocitySensitivity;
+    desc.m_Restitution = emit.Restitution;
+    desc.m_Gravity[0] = emit.Gravity.x; desc.m_Gravity[1] = emit.Gravity.y; desc.m_Gravity[2] = emit.Gravity.z;
+    desc.m_MaxParticles = emit.MaxParticles;
+    desc.m_TextureID = emit.TextureID;
+
+    desc.m_EmitRate = effectProperties.EmitRate;
+    desc.m_LifeMinMax[0] = effectProperties.LifeMinMax.x; desc.m_LifeMinMax[1] = effectProperties.LifeMinMax.y;
+    desc.m_MassMinMax[0] = effectProperties.MassMinMax.x; desc.m_MassMinMax[1] = effectProperties.MassMinMax.y;
+    desc.m_Size[0] = effectProperties.Size.GetX(); desc.m_Size[1] = effectProperties.Size.GetY();
+    desc.m_Size[2] = effectProperties.Size.GetZ(); desc.m_Size[3] = effectProperties.Size.GetW();
+    desc.m_Spread[0] = effectProperties.Spread.x; desc.m_Spread[1] = effectProperties.Spread.y; desc.m_Spread[2] = effectProperties.Spread.z;
+    desc.m_Velocity[0] = effectProperties.Velocity.GetX(); desc.m_Velocity[1] = effectProperties.Velocity.GetY();
+    desc.m_Velocity[2] = effectProperties.Velocity.GetZ(); desc.m_Velocity[3] = effectProperties.Velocity.GetW();
+
+    const Color* colors[4] = { &effectProperties.MinStartColor, &effectProperties.MaxStartColor, &effectProperties.MinEndColor, &effectProperties.MaxEndColor };
+    float* descColors[4] = { desc.m_MinStartColor, desc.m_MaxStartColor, desc.m_MinEndColor, desc.m_MaxEndColor };
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        descColors[i][0] = colors[i]->R(); descColors[i][1] = colors[i]->G();
+        descColors[i][2] = colors[i]->B(); descColors[i][3] = colors[i]->A();
+    }
+
+    desc.m_TotalActiveLifetime = effectProperties.TotalActiveLifetime;
+    return desc;
+}
+#endif
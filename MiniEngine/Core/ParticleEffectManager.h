@@ -13,12 +13,33 @@
 //
 
 #pragma once
+//===============================================================================
+// desc: Owns every particle effect, and runs their simulation and rendering on the GPU
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Effect properties can be handed to the CPU particle backend
+   [AZB] 18/10/26: Effect handles are generational, and stop resolving once their effect expires
+*/
 
 #include "ParticleEffectProperties.h"
 #include "ParticleEffect.h"
 #include "CommandContext.h"
 #include "Math/Random.h"
 
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+
+#if AZB_MOD
+#include "AZB_ParticleSim.h"
+#endif
+
 namespace Math
 {
     class Camera;
@@ -33,12 +54,17 @@ namespace ParticleEffectManager
     void Update(ComputeContext& Context, float timeDelta );
 
     typedef uint32_t EffectHandle;
+    // [AZB]: Can be called from any thread. The effect goes live at the next Update(), and ResetEffect() and GetCurrentLife() ignore it until then
     EffectHandle InstantiateEffect( ParticleEffectProperties& effectProperties );
     void Update(ComputeContext& Context, float timeDelta );
     void Render(CommandContext& Context, const Math::Camera& Camera, ColorBuffer& ColorTarget, DepthBuffer& DepthTarget, ColorBuffer& LinearDepth);
     void ResetEffect(EffectHandle EffectID);
     float GetCurrentLife(EffectHandle EffectID);
     void RegisterTexture(uint32_t index, const Texture& texture);
+#if AZB_MOD
+    // [AZB]: The same effect for ParticleSim, which emits and updates it on the CPU exactly as the compute shaders do
+    ParticleSim::EffectDesc MakeSimDesc(const ParticleEffectProperties& effectProperties);
+#endif
 
     extern BoolVar Enable;
     extern BoolVar PauseSim;
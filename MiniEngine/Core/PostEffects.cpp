@@ -75,6 +75,9 @@
    [AZB] 22/10/24: DLSS implementation continued, attempting to create the feature at start of Render()
    [AZB] 24/10/24: DLSS moved to TemporalEffects
    [AZB] 13/11/24: Refactoring so that the input color buffer can be dynamically passed in, acting on either the main scene colour buffer or the DLSS output buffer!
+   [AZB] 18/10/26: HDR input can be captured to disk a frame at a time, for the CPU tone mapping reference to run over
+   [AZB] 18/10/26: HDR capture takes the DLSS output's R10G10B10A2_UNORM as well as the scene buffer, so upscaled runs can be captured
+   [AZB] 18/10/26: Exposure can be recorded as it adapts and replayed into a later run in place of adapting, so two runs see the same exposure
 
 */
 
@@ -82,6 +85,9 @@
 
 #if AZB_MOD
 #include "AZB_DLSS.h"
+#include "AZB_ToneMapReference.h"
+#include "AZB_ExposureStream.h"
+#include "ReadbackBuffer.h"
 #endif
 
 using namespace Graphics;
@@ -162,6 +168,31 @@ namespace PostEffects
     void ProcessLDR(CommandContext&, ColorBuffer& inputBuffer);
     void GenerateBloom(ComputeContext&, ColorBuffer& inputBuffer);
     void ExtractLuma(ComputeContext&, ColorBuffer& inputBuffer);
+
+    // [AZB]: Frames are read back and written out as they're rendered, until the count runs down
+    void CaptureHDRFrame(ColorBuffer& inputBuffer);
+    void EndHDRCapture(void);
+
+    ToneMapReference::FrameWriter s_HDRCapture;
+    std::wstring s_HDRCaptureFile;
+    uint32_t s_HDRCaptureFramesLeft = 0;
+    std::vector<uint32_t> s_HDRCapturePixels;
+
+    // [AZB]: Each frame's exposure is copied out after it's adapted and written to the recording once the GPU's done with it, oldest first
+    void ReplayExposure(ComputeContext& Context);
+    void RecordExposure(void);
+    void DrainExposureReadbacks(bool bWait);
+
+    const uint32_t kExposureReadbackSlots = 4;
+
+    ExposureStream::Writer s_ExposureRecording;
+    ExposureStream::Player s_ExposureReplay;
+    ReadbackBuffer s_ExposureReadback;
+    uint64_t s_ExposureReadbackFences[kExposureReadbackSlots] = {};
+    uint32_t s_ExposureReadbackHead = 0;
+    uint32_t s_ExposureReadbackCount = 0;
+    bool s_bExposureUpdated = false;
+    bool s_bExposureReplayEnded = false;
 #endif
 }
 
@@ -233,6 +264,12 @@ void PostEffects::Shutdown( void )
 {
     g_Exposure.Destroy();
 
+#if AZB_MOD
+    EndHDRCapture();
+    EndExposureRecording();
+    EndExposureReplay();
+#endif
+
     FXAA::Shutdown();
     MotionBlur::Shutdown();
     DepthOfField::Shutdown();
@@ -375,8 +412,19 @@ void PostEffects::UpdateExposure( ComputeContext& Context )
 {
     ScopedTimer _prof(L"Update Exposure", Context);
 
+#if AZB_MOD
+    s_bExposureUpdated = true;
+#endif
+
     if (!EnableAdaptation)
     {
+#if AZB_MOD
+        if (s_ExposureReplay.IsLoaded())
+        {
+            ReplayExposure(Context);
+            return;
+        }
+#endif
         __declspec(align(16)) float initExposure[] =
         {
             Exposure, 1.0f / Exposure, Exposure, 0.0f,
@@ -398,6 +446,15 @@ void PostEffects::UpdateExposure( ComputeContext& Context )
     Context.SetConstants(0, g_LumaLR.GetHeight());
     Context.Dispatch2D(g_LumaLR.GetWidth(), g_LumaLR.GetHeight(), 16, g_LumaLR.GetHeight());
 
+#if AZB_MOD
+    // [AZB]: A replayed frame still gets its histogram, to be drawn or compared, but its exposure comes from the recording
+    if (s_ExposureReplay.IsLoaded())
+    {
+        ReplayExposure(Context);
+        return;
+    }
+#endif
+
     __declspec(align(16)) struct
     {
         float TargetLuminance;
@@ -564,6 +621,12 @@ void PostEffects::Render( void )
     }
 
     Context.Finish();
+
+#if AZB_MOD
+    // [AZB]: Queued behind the frame, so the copy sees exposure as this frame left it
+    if (s_ExposureRecording.IsOpen())
+        RecordExposure();
+#endif
 }
 
 
@@ -803,6 +866,10 @@ void PostEffects::CopyBackPostBuffer(ComputeContext& Context, ColorBuffer& input
 
 void PostEffects::Render(ColorBuffer& inputBuffer)
 {
+    // [AZB]: Before anything here writes to it, as tone mapping does in place
+    if (s_HDRCaptureFramesLeft > 0)
+        CaptureHDRFrame(inputBuffer);
+
     ComputeContext& Context = ComputeContext::Begin(L"Post Effects");
 
     Context.SetRootSignature(PostEffectsRS);
@@ -844,6 +911,205 @@ void PostEffects::Render(ColorBuffer& inputBuffer)
     }
 
     Context.Finish();
+
+    // [AZB]: Queued behind the frame, so the copy sees exposure as this frame left it
+    if (s_ExposureRecording.IsOpen())
+        RecordExposure();
+}
+
+void PostEffects::BeginHDRCapture(const std::wstring& fileName, uint32_t frameCount)
+{
+    EndHDRCapture();
+
+    // The file's opened on the first frame, once the size of what's being captured is known
+    s_HDRCaptureFile = fileName;
+    s_HDRCaptureFramesLeft = frameCount;
+}
+
+bool PostEffects::IsCapturingHDR(void)
+{
+    return s_HDRCaptureFramesLeft > 0;
+}
+
+void PostEffects::EndHDRCapture(void)
+{
+    if (s_HDRCapture.IsOpen())
+    {
+        const uint32_t frameCount = s_HDRCapture.GetFrameCount();
+        if (s_HDRCapture.Close())
+            Utility::Printf("HDR capture: %u frames written\n", frameCount);
+        else
+            Utility::Printf("HDR capture: failed writing frames, only the first %u will load\n", frameCount);
+    }
+    s_HDRCaptureFramesLeft = 0;
+}
+
+void PostEffects::CaptureHDRFrame(ColorBuffer& inputBuffer)
+{
+    // The scene buffer, or DLSS's output when it's upscaled. The file says which, so either is read back as the shaders read it
+    ToneMapReference::FrameFormat format;
+    if (inputBuffer.GetFormat() == DXGI_FORMAT_R11G11B10_FLOAT)
+        format = ToneMapReference::kFrameFormatR11G11B10Float;
+    else if (inputBuffer.GetFormat() == DXGI_FORMAT_R10G10B10A2_UNORM)
+        format = ToneMapReference::kFrameFormatR10G10B10A2Unorm;
+    else
+    {
+        Utility::Printf("HDR capture: input is neither R11G11B10_FLOAT nor R10G10B10A2_UNORM, stopping\n");
+        EndHDRCapture();
+        return;
+    }
+
+    const uint32_t width = (uint32_t)inputBuffer.GetWidth();
+    const uint32_t height = inputBuffer.GetHeight();
+    if (!s_HDRCapture.IsOpen())
+    {
+        if (!s_HDRCapture.Open(s_HDRCaptureFile, width, height, format))
+        {
+            Utility::Printf("HDR capture: couldn't open %ls\n", s_HDRCaptureFile.c_str());
+            s_HDRCaptureFramesLeft = 0;
+            return;
+        }
+        Utility::Printf("HDR capture: %ux%u %s frames to %ls\n", width, height,
+            format == ToneMapReference::kFrameFormatR11G11B10Float ? "R11G11B10_FLOAT" : "R10G10B10A2_UNORM", s_HDRCaptureFile.c_str());
+    }
+    else if (s_HDRCapture.GetWidth() != width || s_HDRCapture.GetHeight() != height || s_HDRCapture.GetFormat() != format)
+    {
+        Utility::Printf("HDR capture: resolution or format changed, stopping\n");
+        EndHDRCapture();
+        return;
+    }
+
+    // The same synchronous readback PixelBuffer::ExportToFile does
+    ReadbackBuffer readback;
+    CommandContext& Context = CommandContext::Begin(L"Capture HDR frame");
+    const uint32_t rowPitch = Context.ReadbackTexture(readback, inputBuffer);
+    Context.Finish(true);
+
+    // Rows are padded out to the copy pitch, so they're taken one at a time
+    const uint8_t* memory = (const uint8_t*)readback.Map();
+    s_HDRCapturePixels.resize((size_t)width * height);
+    for (uint32_t y = 0; y < height; ++y)
+        memcpy(&s_HDRCapturePixels[(size_t)y * width], memory + (size_t)y * rowPitch, width * sizeof(uint32_t));
+    readback.Unmap();
+
+    if (!s_HDRCapture.Write(s_HDRCapturePixels.data()) || --s_HDRCaptureFramesLeft == 0)
+        EndHDRCapture();
+}
+
+bool PostEffects::BeginExposureRecording(const std::wstring& fileName)
+{
+    EndExposureRecording();
+    if (!s_ExposureRecording.Open(fileName))
+        return false;
+
+    s_ExposureReadback.Create(L"Exposure Readback", kExposureReadbackSlots * 8, sizeof(float));
+    s_ExposureReadbackHead = 0;
+    s_ExposureReadbackCount = 0;
+    s_bExposureUpdated = false;
+    return true;
+}
+
+void PostEffects::EndExposureRecording(void)
+{
+    if (!s_ExposureRecording.IsOpen())
+        return;
+
+    DrainExposureReadbacks(true);
+    s_ExposureReadback.Destroy();
+
+    const uint32_t frameCount = s_ExposureRecording.GetFrameCount();
+    const uint64_t byteCount = s_ExposureRecording.GetByteCount();
+    if (s_ExposureRecording.Close())
+        Utility::Printf("Exposure recording: %u frames written in %llu bytes\n", frameCount, (unsigned long long)byteCount);
+    else
+        Utility::Printf("Exposure recording: failed writing frames, the recording won't load\n");
+}
+
+bool PostEffects::IsRecordingExposure(void)
+{
+    return s_ExposureRecording.IsOpen();
+}
+
+bool PostEffects::BeginExposureReplay(const std::wstring& fileName)
+{
+    s_bExposureReplayEnded = false;
+    return s_ExposureReplay.Load(fileName);
+}
+
+void PostEffects::EndExposureReplay(void)
+{
+    s_ExposureReplay.Clear();
+}
+
+bool PostEffects::IsReplayingExposure(void)
+{
+    return s_ExposureReplay.IsLoaded();
+}
+
+void PostEffects::ReplayExposure(ComputeContext& Context)
+{
+    ExposureStream::ExposureState state;
+    if (!s_ExposureReplay.Next(state) && !s_bExposureReplayEnded)
+    {
+        Utility::Printf("Exposure replay: all %u frames played, holding the last\n", s_ExposureReplay.GetFrameCount());
+        s_bExposureReplayEnded = true;
+    }
+
+    __declspec(align(16)) float values[8];
+    memcpy(values, state.m_Values, sizeof(values));
+    Context.WriteBuffer(g_Exposure, 0, values, sizeof(values));
+    Context.TransitionResource(g_Exposure, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+}
+
+void PostEffects::RecordExposure(void)
+{
+    // Frames that didn't go through ProcessHDR didn't adapt, and a replay wouldn't step over them either
+    if (!s_bExposureUpdated)
+        return;
+    s_bExposureUpdated = false;
+
+    DrainExposureReadbacks(false);
+    if (s_ExposureReadbackCount == kExposureReadbackSlots)
+        DrainExposureReadbacks(true);
+    if (!s_ExposureRecording.IsOpen())
+        return;
+
+    const uint32_t slot = (s_ExposureReadbackHead + s_ExposureReadbackCount) % kExposureReadbackSlots;
+    CommandContext& Context = CommandContext::Begin(L"Record Exposure");
+    Context.TransitionResource(g_Exposure, D3D12_RESOURCE_STATE_COPY_SOURCE, true);
+    Context.CopyBufferRegion(s_ExposureReadback, slot * sizeof(ExposureStream::ExposureState), g_Exposure, 0, sizeof(ExposureStream::ExposureState));
+    Context.TransitionResource(g_Exposure, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    s_ExposureReadbackFences[slot] = Context.Finish();
+    ++s_ExposureReadbackCount;
+}
+
+void PostEffects::DrainExposureReadbacks(bool bWait)
+{
+    while (s_ExposureReadbackCount > 0)
+    {
+        const uint64_t fence = s_ExposureReadbackFences[s_ExposureReadbackHead];
+        if (!g_CommandManager.IsFenceComplete(fence))
+        {
+            if (!bWait)
+                break;
+            g_CommandManager.WaitForFence(fence);
+        }
+
+        const ExposureStream::ExposureState* states = (const ExposureStream::ExposureState*)s_ExposureReadback.Map();
+        const bool bWritten = s_ExposureRecording.Append(states[s_ExposureReadbackHead]);
+        s_ExposureReadback.Unmap();
+
+        s_ExposureReadbackHead = (s_ExposureReadbackHead + 1) % kExposureReadbackSlots;
+        --s_ExposureReadbackCount;
+
+        if (!bWritten)
+        {
+            Utility::Printf("Exposure recording: couldn't write frame %u, stopping\n", s_ExposureRecording.GetFrameCount());
+            s_ExposureReadbackCount = 0;
+            s_ExposureRecording.Close();
+            s_ExposureReadback.Destroy();
+        }
+    }
 }
 
 #endif
\ No newline at end of file
@@ -54,5 +54,21 @@ namespace PostEffects
     void CopyBackPostBuffer( ComputeContext& Context, ColorBuffer& inputBuffer);
     void Render(ColorBuffer& inputBuffer);
 
+    // [AZB]: Writes the HDR input of the next frameCount frames to fileName, for ToneMapReference to run over offline. Each frame waits on a readback,
+    //        so this is for capturing and not for anything being timed
+    void BeginHDRCapture(const std::wstring& fileName, uint32_t frameCount);
+    bool IsCapturingHDR(void);
+
+    // [AZB]: Writes g_Exposure to fileName after every frame adapts it, read back a few frames behind so nothing waits on the GPU. Ends with
+    //        EndExposureRecording() or at shutdown
+    bool BeginExposureRecording(const std::wstring& fileName);
+    void EndExposureRecording(void);
+    bool IsRecordingExposure(void);
+
+    // [AZB]: Feeds a recording back into g_Exposure a frame at a time in place of adapting, holding the last frame once it runs out
+    bool BeginExposureReplay(const std::wstring& fileName);
+    void EndExposureReplay(void);
+    bool IsReplayingExposure(void);
+
 #endif
 }
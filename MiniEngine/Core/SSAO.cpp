@@ -30,6 +30,21 @@
 #include "CompiledShaders/AoBlurUpsampleCS.h"
 #include "CompiledShaders/AoBlurUpsamplePreMinCS.h"
 
+//===============================================================================
+// desc: Screen space ambient occlusion, rendered over a hierarchy of downsampled and deinterleaved depth
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Scene depth can be captured to disk a frame at a time, for the CPU SSAO reference to run over
+*/
+
+#if AZB_MOD
+#include "AZB_SSAOReference.h"
+#include "ReadbackBuffer.h"
+#endif
+
 using namespace Graphics;
 using namespace Math;
 
@@ -67,6 +82,12 @@ namespace SSAO
     IntVar HierarchyDepth("Graphics/SSAO/Hierarchy Depth", 3, 1, 4);
 
     void LinearizeZ(ComputeContext& Context, DepthBuffer& Depth, ColorBuffer& LinearDepth, float zMagic);
+
+#if AZB_MOD
+    // [AZB]: Frames are read back and written out as they're rendered, until the count runs down
+    void CaptureDepthFrame(GraphicsContext& GfxContext, float zMagic, float FovTangent);
+    void EndDepthCapture(void);
+#endif
 }
 
 namespace
@@ -82,6 +103,13 @@ namespace
     ComputePSO s_DebugSSAOCS(L"SSAO: Debug CS");
 
     float SampleThickness[12];	// Pre-computed sample thicknesses
+
+#if AZB_MOD
+    SSAOReference::DepthWriter s_DepthCapture;
+    std::wstring s_DepthCaptureFile;
+    uint32_t s_DepthCaptureFramesLeft = 0;
+    std::vector<float> s_DepthCapturePixels;
+#endif
 }
 
 void SSAO::Initialize( void )
@@ -129,6 +157,9 @@ void SSAO::Initialize( void )
 
 void SSAO::Shutdown(void)
 {
+#if AZB_MOD
+    EndDepthCapture();
+#endif
 }
 
 namespace SSAO
@@ -328,6 +359,12 @@ void SSAO::Render( GraphicsContext& GfxContext, const float* ProjMat, float Near
 
     const float zMagic = (FarClipDist - NearClipDist) / NearClipDist;
 
+#if AZB_MOD
+    // [AZB]: Captured whether or not SSAO is on, since the reference only needs the depth
+    if (s_DepthCaptureFramesLeft > 0)
+        CaptureDepthFrame(GfxContext, zMagic, 1.0f / ProjMat[0]);
+#endif
+
     if (!Enable)
     {
         ScopedTimer _prof(L"Generate SSAO", GfxContext);
@@ -540,3 +577,76 @@ void SSAO::Render( GraphicsContext& GfxContext, const float* ProjMat, float Near
         CC.Dispatch2D(g_SSAOFullScreen.GetWidth(), g_SSAOFullScreen.GetHeight());
     }
 }
+
+#if AZB_MOD
+void SSAO::BeginDepthCapture(const std::wstring& fileName, uint32_t frameCount)
+{
+    EndDepthCapture();
+
+    // The file's opened on the first frame, once the size of the depth buffer is known
+    s_DepthCaptureFile = fileName;
+    s_DepthCaptureFramesLeft = frameCount;
+}
+
+bool SSAO::IsCapturingDepth(void)
+{
+    return s_DepthCaptureFramesLeft > 0;
+}
+
+void SSAO::EndDepthCapture(void)
+{
+    if (s_DepthCapture.IsOpen())
+    {
+        const uint32_t frameCount = s_DepthCapture.GetFrameCount();
+        if (s_DepthCapture.Close())
+            Utility::Printf("Depth capture: %u frames written\n", frameCount);
+        else
+            Utility::Printf("Depth capture: failed writing frames, only the first %u will load\n", frameCount);
+    }
+    s_DepthCaptureFramesLeft = 0;
+}
+
+void SSAO::CaptureDepthFrame(GraphicsContext& GfxContext, float zMagic, float FovTangent)
+{
+    DepthBuffer& Depth = g_SceneDepthBuffer;
+    if (Depth.GetFormat() != DXGI_FORMAT_D32_FLOAT)
+    {
+        Utility::Printf("Depth capture: scene depth isn't D32_FLOAT, stopping\n");
+        EndDepthCapture();
+        return;
+    }
+
+    const uint32_t width = (uint32_t)Depth.GetWidth();
+    const uint32_t height = Depth.GetHeight();
+    if (!s_DepthCapture.IsOpen())
+    {
+        if (!s_DepthCapture.Open(s_DepthCaptureFile, width, height))
+        {
+            Utility::Printf("Depth capture: couldn't open %ls\n", s_DepthCaptureFile.c_str());
+            s_DepthCaptureFramesLeft = 0;
+            return;
+        }
+    }
+    else if (s_DepthCapture.GetWidth() != width || s_DepthCapture.GetHeight() != height)
+    {
+        Utility::Printf("Depth capture: resolution changed, stopping\n");
+        EndDepthCapture();
+        return;
+    }
+
+    // Copied out on the graphics context, after the depth pass recorded on it, and waited on
+    ReadbackBuffer readback;
+    const uint32_t rowPitch = GfxContext.ReadbackTexture(readback, Depth);
+    GfxContext.Flush(true);
+
+    // Rows are padded out to the copy pitch, so they're taken one at a time
+    const uint8_t* memory = (const uint8_t*)readback.Map();
+    s_DepthCapturePixels.resize((size_t)width * height);
+    for (uint32_t y = 0; y < height; ++y)
+        memcpy(&s_DepthCapturePixels[(size_t)y * width], memory + (size_t)y * rowPitch, width * sizeof(float));
+    readback.Unmap();
+
+    if (!s_DepthCapture.Write(s_DepthCapturePixels.data(), zMagic, FovTangent) || --s_DepthCaptureFramesLeft == 0)
+        EndDepthCapture();
+}
+#endif
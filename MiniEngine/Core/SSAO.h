@@ -12,6 +12,22 @@
 //
 
 #pragma once
+//===============================================================================
+// desc: Screen space ambient occlusion, rendered over a hierarchy of downsampled and deinterleaved depth
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Depth can be captured a frame at a time, for the CPU SSAO reference to run over
+*/
+
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
 
 namespace Math { class Camera;  }
 class GraphicsContext;
@@ -30,4 +46,11 @@ namespace SSAO
     extern BoolVar DebugDraw;
     extern BoolVar AsyncCompute;
     extern BoolVar ComputeLinearZ;
+
+#if AZB_MOD
+    // [AZB]: Writes the scene depth of the next frameCount frames to fileName, with the projection each was drawn with, for SSAOReference to run
+    //        over offline. Each frame waits on a readback, so this is for capturing and not for anything being timed
+    void BeginDepthCapture(const std::wstring& fileName, uint32_t frameCount);
+    bool IsCapturingDepth(void);
+#endif
 }
@@ -14,6 +14,16 @@
 #include "pch.h"
 #include "ShadowCamera.h"
 
+//===============================================================================
+// desc: An orthographic camera for the sun's shadow map, snapped to whole texels
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Added UpdateCascade, which sets the camera up for one cascade through the same texel snapping as UpdateMatrix
+*/
+
 using namespace Math;
 
 void ShadowCamera::UpdateMatrix(
@@ -46,3 +56,13 @@ void ShadowCamera::UpdateMatrix(
     // Transform from clip space to texture space
     m_ShadowMatrix = Matrix4( AffineTransform( Matrix3::MakeScale( 0.5f, -0.5f, 1.0f ), Vector3(0.5f, 0.5f, 0.0f) ) ) * m_ViewProjMatrix;
 }
+
+#if AZB_MOD
+void ShadowCamera::UpdateCascade(
+    Vector3 LightDirection, const ShadowCascades::Cascade& Cascade,
+    uint32_t BufferWidth, uint32_t BufferHeight, uint32_t BufferPrecision )
+{
+    UpdateMatrix(LightDirection, Vector3(Cascade.m_Center[0], Cascade.m_Center[1], Cascade.m_Center[2]),
+        Vector3(Cascade.m_Bounds[0], Cascade.m_Bounds[1], Cascade.m_Bounds[2]), BufferWidth, BufferHeight, BufferPrecision);
+}
+#endif
@@ -12,10 +12,30 @@
 //
 
 #pragma once
+//===============================================================================
+// desc: An orthographic camera for the sun's shadow map, snapped to whole texels
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Can be set up as one cascade of a cascaded shadow map
+*/
 
 #include "Camera.h"
 #include "VectorMath.h"
 
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+
+#if AZB_MOD
+#include "AZB_ShadowCascades.h"
+#endif
+
 class ShadowCamera : public Math::BaseCamera
 {
 public:
@@ -31,6 +51,18 @@ public:
         uint32_t BufferPrecision	// Bit depth of shadow buffer--usually 16 or 24
         );
 
+#if AZB_MOD
+    // [AZB]: Covers one cascade from ShadowCascades::FitCascades. Goes through UpdateMatrix, so the cascade is snapped to texels just the same.
+    //        Only the -cascadestats report uses it so far, as no pass renders a cascade yet
+    void UpdateCascade(
+        Math::Vector3 LightDirection,
+        const ShadowCascades::Cascade& Cascade,
+        uint32_t BufferWidth,
+        uint32_t BufferHeight,
+        uint32_t BufferPrecision
+        );
+#endif
+
     // Used to transform world space to texture space for shadow sampling
     const Math::Matrix4& GetShadowMatrix() const { return m_ShadowMatrix; }
 
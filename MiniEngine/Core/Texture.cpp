@@ -11,6 +11,16 @@
 // Author(s):  James Stanard 
 //
 
+//===============================================================================
+// desc: Texture creation from memory and from files
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Create2D() and CreateCube() keep the texture's existing descriptor rather than allocating another every time
+*/
+
 #include "pch.h"
 #include "Texture.h"
 #include "DDSTextureLoader.h"
@@ -35,7 +45,12 @@ static UINT BytesPerPixel( DXGI_FORMAT Format )
 
 void Texture::Create2D( size_t RowPitchBytes, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
 {
+#if AZB_MOD
+    // [AZB]: Texture::Destroy() would drop the descriptor, only for a new one to be allocated below
+    GpuResource::Destroy();
+#else
     Destroy();
+#endif
 
     m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
 
@@ -81,7 +96,11 @@ void Texture::Create2D( size_t RowPitchBytes, size_t Width, size_t Height, DXGI_
 
 void Texture::CreateCube( size_t RowPitchBytes, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
 {
+#if AZB_MOD
+    GpuResource::Destroy();
+#else
     Destroy();
+#endif
 
     m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
 
@@ -21,6 +21,14 @@
 #include "CommandContext.h"
 #include <map>
 #include <thread>
+#if AZB_MOD
+#include <algorithm>
+#include <deque>
+#endif
+#if AZB_MOD
+#include "AZB_AsyncLoader.h"
+#include "AZB_DDSReader.h"
+#endif
 
 using namespace std;
 using namespace Graphics;
@@ -43,6 +51,44 @@ public:
     void WaitForLoad(void) const;
     void CreateFromMemory(ByteArray memory, eDefaultTexture fallback, bool sRGB);
 
+#if AZB_MOD
+    // [AZB]: Submitter thread only. Creates the resource and records its upload into the batch's context - the texture isn't usable until the
+    //        context has finished and m_LoadDone is signalled
+    void CreateFromLayout(CommandContext& context, bool bFileFound, DDSTextureLayout& layout, HRESULT parseResult, eDefaultTexture fallback, bool sRGB);
+
+    // [AZB]: Submitter thread only. Builds a replacement resource whose top mip is layout.skipMip into m_pStreamedResource, for the render
+    //        thread to swap in. Leaves it null on failure
+    void CreateStreamedMips(CommandContext& context, DDSTextureLayout& layout, HRESULT parseResult);
+
+    // [AZB]: Render thread only. Puts the finished m_pStreamedResource in place and points every copy of the SRV at it
+    void SwapStreamedMips(void);
+
+    // [AZB]: Set before the texture is published in the cache, so anyone who can find it can wait on it
+    std::shared_future<void> m_LoadDone;
+
+    // [AZB]: Streaming state. The source fields are set before the texture is published, the description by the submitter before it hands the texture
+    //        to the render thread, and everything else belongs to the render thread - apart from the m_Streamed* members, which are filled in
+    //        by the submitter while a restream is in flight
+    wstring m_FilePath;
+    eDefaultTexture m_Fallback = kMagenta2D;
+    bool m_ForceSRGB = false;
+
+    TextureStreaming::TextureDesc m_StreamDesc;
+    uint32_t m_FullWidth = 0;
+    uint32_t m_FullHeight = 0;
+    uint32_t m_ResidentMip = 0;
+    uint32_t m_StreamHandle = TextureStreaming::kInvalidHandle;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_DescriptorCopies;
+
+    std::shared_future<void> m_StreamDone;
+    D3D12_CPU_DESCRIPTOR_HANDLE m_hStreamedDescriptor;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_pStreamedResource;
+
+    // [AZB]: False while m_hCpuDescriptorHandle is a default texture's, which mustn't be freed along with this one
+    bool m_bOwnsDescriptor = false;
+    uint32_t m_StreamedMip = 0;
+#endif
+
 private:
 
     bool IsValid(void) const { return m_IsValid; }
@@ -59,18 +105,222 @@ namespace TextureManager
     wstring s_RootPath = L"";
     map<wstring, std::unique_ptr<ManagedTexture>> s_TextureCache;
 
+#if AZB_MOD
+    // [AZB]: One texture's trip through the load pipeline
+    class TextureLoadRequest : public AsyncLoad::Request
+    {
+    public:
+        ManagedTexture* m_Texture = nullptr;
+        wstring m_FilePath;
+        eDefaultTexture m_Fallback = kMagenta2D;
+        bool m_ForceSRGB = false;
+
+        // Streamed loads stop at m_MaxSize. Restreams replace the resource of a texture that is already loaded
+        size_t m_MaxSize = 0;
+        bool m_bStreamed = false;
+        bool m_bRestream = false;
+        bool m_bStreamable = false;
+        TextureStreaming::TextureDesc m_StreamDesc;
+
+        // The layout's subresources point straight into the mapping, so it stays open until the upload has finished
+        DDSReader::MappedFile m_File;
+        DDSTextureLayout m_Layout;
+        HRESULT m_ParseResult = E_FAIL;
+    };
+
+    // [AZB]: Streamed textures the submitter has finished with - newly loaded ones to register and finished restreams to swap in
+    mutex s_StreamMutex;
+    vector<ManagedTexture*> s_StreamEvents;
+
+    // [AZB]: Reads on the reader pool, parses on the workers, then creates and uploads a whole batch through a single command context
+    class TextureLoadSink : public AsyncLoad::Sink
+    {
+    public:
+        virtual void Read( AsyncLoad::Request& request ) override
+        {
+            TextureLoadRequest& texRequest = static_cast<TextureLoadRequest&>(request);
+            if (texRequest.m_File.Open(texRequest.m_FilePath))
+                texRequest.m_File.Prefetch();	// Do the actual disk reads here rather than on the workers
+        }
+
+        virtual void Prepare( AsyncLoad::Request& request ) override
+        {
+            TextureLoadRequest& texRequest = static_cast<TextureLoadRequest&>(request);
+            if (!texRequest.m_File.IsOpen())
+                return;
+
+            DDSReader::DDSFile file;
+            DDSReader::eResult result = file.Parse(texRequest.m_File.GetData(), texRequest.m_File.GetSize());
+            if (result == DDSReader::RESULT_OK)
+            {
+                // Only plain 2D textures with a mip chain are streamed, everything else is loaded in full
+                texRequest.m_bStreamable = texRequest.m_bStreamed && file.GetDimension() == DDSReader::DIMENSION_TEXTURE2D
+                    && file.GetArraySize() == 1 && file.GetMipCount() > 1;
+                texRequest.m_ParseResult = BuildDDSTextureLayout(file, texRequest.m_bStreamable ? texRequest.m_MaxSize : 0, texRequest.m_Layout);
+
+                if (texRequest.m_bStreamable)
+                {
+                    TextureStreaming::TextureDesc& desc = texRequest.m_StreamDesc;
+                    desc.m_MipCount = std::min(file.GetMipCount(), TextureStreaming::kMaxMips);
+                    for (uint32_t mip = 0; mip < desc.m_MipCount; ++mip)
+                    {
+                        const DDSReader::SubresourceView& view = file.GetSubresource(mip, 0);
+                        desc.m_MipBytes[mip] = (uint64_t)view.m_SlicePitch * view.m_Depth;
+                    }
+                    desc.m_BaseMip = (uint32_t)texRequest.m_Layout.skipMip;
+                }
+            }
+            else if (result == DDSReader::RESULT_UNSUPPORTED_FORMAT)
+            {
+                // The packed and odd legacy formats only the full loader knows about
+                texRequest.m_ParseResult = ParseDDSTextureFromMemory(texRequest.m_File.GetData(), texRequest.m_File.GetSize(), 0, texRequest.m_Layout);
+            }
+            else
+            {
+                Utility::Printf(L"Failed to parse %s: %S\n", texRequest.m_FilePath.c_str(), DDSReader::GetResultString(result));
+            }
+
+            if (SUCCEEDED(texRequest.m_ParseResult))
+                request.m_UploadBytes = texRequest.m_Layout.uploadBytes;
+        }
+
+        virtual void Submit( const vector<AsyncLoad::RequestPtr>& batch ) override
+        {
+            CommandContext& context = CommandContext::Begin(L"Texture Upload");
+
+            for (const AsyncLoad::RequestPtr& request : batch)
+            {
+                TextureLoadRequest& texRequest = static_cast<TextureLoadRequest&>(*request);
+                ManagedTexture& texture = *texRequest.m_Texture;
+
+                if (texRequest.m_bRestream)
+                {
+                    texture.CreateStreamedMips(context, texRequest.m_Layout, texRequest.m_bStreamable ? texRequest.m_ParseResult : E_FAIL);
+                    continue;
+                }
+
+                texture.CreateFromLayout(context, texRequest.m_File.IsOpen(), texRequest.m_Layout, texRequest.m_ParseResult,
+                    texRequest.m_Fallback, texRequest.m_ForceSRGB);
+
+                if (texRequest.m_bStreamable && texture.GetResource() != nullptr)
+                {
+                    // The resource may have come out smaller than asked for if it didn't fit
+                    texture.m_StreamDesc = texRequest.m_StreamDesc;
+                    texture.m_StreamDesc.m_BaseMip = (uint32_t)texRequest.m_Layout.skipMip;
+                    texture.m_ResidentMip = texture.m_StreamDesc.m_BaseMip;
+                    texture.m_FullWidth = texRequest.m_Layout.width;
+                    texture.m_FullHeight = texRequest.m_Layout.height;
+                }
+                else
+                {
+                    texRequest.m_bStreamable = false;
+                }
+            }
+
+            // Wait so the upload pages can be released, and so nothing is signalled as loaded before the GPU has its data
+            context.Finish(true);
+
+            vector<ManagedTexture*> streamed;
+            for (const AsyncLoad::RequestPtr& request : batch)
+            {
+                TextureLoadRequest& texRequest = static_cast<TextureLoadRequest&>(*request);
+                texRequest.m_File.Close();
+
+                if (texRequest.m_bRestream || texRequest.m_bStreamable)
+                    streamed.push_back(texRequest.m_Texture);
+            }
+
+            // New streamed textures get registered, finished restreams swapped in, on the render thread's next UpdateStreaming()
+            if (!streamed.empty())
+            {
+                lock_guard<mutex> Guard(s_StreamMutex);
+                s_StreamEvents.insert(s_StreamEvents.end(), streamed.begin(), streamed.end());
+            }
+        }
+    };
+
+    TextureLoadSink s_LoadSink;
+    std::unique_ptr<AsyncLoad::Pipeline> s_LoadPipeline;
+
+    // [AZB]: Mip streaming. The residency manager, the handle table and the retired resources are only touched by the render thread
+    bool s_bStreamingEnabled = true;
+    const uint32_t kMaxStreamsInFlight = 8;
+    TextureStreaming::ResidencyManager s_Residency;
+    vector<ManagedTexture*> s_StreamedTextures;		// Indexed by residency handle
+
+    // Replaced resources, kept alive until the graphics queue passes the fence that was next when they were swapped out
+    deque<pair<uint64_t, Microsoft::WRL::ComPtr<ID3D12Resource>>> s_RetiredResources;
+#endif
+
     void Initialize( const wstring& TextureLibRoot )
     {
         s_RootPath = TextureLibRoot;
+
+#if AZB_MOD
+        uint32_t streaming = 1;
+        CommandLineArgs::GetInteger(L"texturestreaming", streaming);
+        s_bStreamingEnabled = streaming != 0;
+
+        uint32_t budgetMB = 1024;
+        CommandLineArgs::GetInteger(L"texturebudget", budgetMB);
+        s_Residency.SetBudget((uint64_t)budgetMB * 1024 * 1024);
+#endif
     }
 
     void Shutdown( void )
     {
+#if AZB_MOD
+        // [AZB]: Let anything in flight finish before the textures it's writing to are destroyed. Shutdown can be called more than once
+        s_LoadPipeline.reset();
+
+        s_StreamEvents.clear();
+        s_StreamedTextures.clear();
+        s_RetiredResources.clear();
+        s_Residency = TextureStreaming::ResidencyManager(s_Residency.GetBudget());
+#endif
         s_TextureCache.clear();
     }
 
     mutex s_Mutex;
 
+#if AZB_MOD
+    // [AZB]: Never blocks - the caller waits on the texture, outside the lock, so one slow load no longer holds up every other lookup
+    ManagedTexture* FindOrLoadTexture( const wstring& fileName, eDefaultTexture fallback, bool forceSRGB, bool bStreamed = false )
+    {
+        lock_guard<mutex> Guard(s_Mutex);
+
+        wstring key = fileName;
+        if (forceSRGB)
+            key += L"_sRGB";
+
+        // Search for an existing managed texture
+        auto iter = s_TextureCache.find(key);
+        if (iter != s_TextureCache.end())
+            return iter->second.get();
+
+        ManagedTexture* tex = new ManagedTexture(key);
+        s_TextureCache[key].reset(tex);
+
+        if (s_LoadPipeline == nullptr)
+            s_LoadPipeline.reset(new AsyncLoad::Pipeline(s_LoadSink));
+
+        tex->m_FilePath = s_RootPath + fileName;
+        tex->m_Fallback = fallback;
+        tex->m_ForceSRGB = forceSRGB;
+
+        std::shared_ptr<TextureLoadRequest> request = std::make_shared<TextureLoadRequest>();
+        request->m_Texture = tex;
+        request->m_FilePath = tex->m_FilePath;
+        request->m_Fallback = fallback;
+        request->m_ForceSRGB = forceSRGB;
+        request->m_bStreamed = bStreamed && s_bStreamingEnabled;
+        request->m_MaxSize = kStreamingBaseSize;
+        tex->m_LoadDone = request->GetFuture();
+
+        s_LoadPipeline->Enqueue(request);
+        return tex;
+    }
+#else
     ManagedTexture* FindOrLoadTexture( const wstring& fileName, eDefaultTexture fallback, bool forceSRGB )
     {
         ManagedTexture* tex = nullptr;
@@ -106,6 +356,26 @@ namespace TextureManager
         // This was the first time it was requested, so indicate that the caller must read the file
         return tex;
     }
+#endif
+
+#if AZB_MOD
+    // [AZB]: Render thread. The texture is going away, so drop it from streaming and from any hand-over the render thread hasn't seen yet
+    void ForgetStreamedTexture(ManagedTexture* tex)
+    {
+        {
+            lock_guard<mutex> Guard(s_StreamMutex);
+            vector<ManagedTexture*>& events = s_StreamEvents;
+            events.erase(std::remove(events.begin(), events.end(), tex), events.end());
+        }
+
+        if (tex->m_StreamHandle != TextureStreaming::kInvalidHandle)
+        {
+            s_Residency.Unregister(tex->m_StreamHandle);
+            s_StreamedTextures[tex->m_StreamHandle] = nullptr;
+            tex->m_StreamHandle = TextureStreaming::kInvalidHandle;
+        }
+    }
+#endif
 
     void DestroyTexture(const wstring& key)
     {
@@ -122,6 +392,9 @@ ManagedTexture::ManagedTexture( const wstring& FileName )
     : m_MapKey(FileName), m_IsValid(false), m_IsLoading(true), m_ReferenceCount(0)
 {
     m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+#if AZB_MOD
+    m_hStreamedDescriptor.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+#endif
 }
 
 void ManagedTexture::CreateFromMemory(ByteArray ba, eDefaultTexture fallback, bool forceSRGB)
@@ -134,6 +407,9 @@ void ManagedTexture::CreateFromMemory(ByteArray ba, eDefaultTexture fallback, bo
     {
         // We probably have a texture to load, so let's allocate a new descriptor
         m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+#if AZB_MOD
+        m_bOwnsDescriptor = true;
+#endif
 
         if ( SUCCEEDED( CreateDDSTextureFromMemory( g_Device, (const uint8_t*)ba->data(), ba->size(),
             0, forceSRGB, m_pResource.GetAddressOf(), m_hCpuDescriptorHandle) ) )
@@ -155,6 +431,110 @@ void ManagedTexture::CreateFromMemory(ByteArray ba, eDefaultTexture fallback, bo
     m_IsLoading = false;
 }
 
+#if AZB_MOD
+void ManagedTexture::CreateFromLayout(CommandContext& context, bool bFileFound, DDSTextureLayout& layout, HRESULT parseResult, eDefaultTexture fallback, bool forceSRGB)
+{
+    if (!bFileFound)
+    {
+        m_hCpuDescriptorHandle = GetDefaultTexture(fallback);
+    }
+    else
+    {
+        // We probably have a texture to load, so let's allocate a new descriptor. This is on the submitter, alongside the render thread's
+        // allocations, which DescriptorAllocator's per-thread magazines and pool lock make safe
+        m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        m_bOwnsDescriptor = true;
+
+        if ( SUCCEEDED(parseResult) && SUCCEEDED( CreateDDSTextureFromLayout( g_Device, layout, forceSRGB, m_pResource.GetAddressOf(), m_hCpuDescriptorHandle) ) )
+        {
+            m_pResource->SetName(m_MapKey.c_str());
+            m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
+            context.UploadTexture(*this, (UINT)layout.subresources.size(), layout.subresources.data());
+
+            m_IsValid = true;
+            D3D12_RESOURCE_DESC desc = GetResource()->GetDesc();
+            m_Width = (uint32_t)desc.Width;
+            m_Height = desc.Height;
+            m_Depth = desc.DepthOrArraySize;
+        }
+        else
+        {
+            g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, GetDefaultTexture(fallback),
+                D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        }
+    }
+
+    m_IsLoading = false;
+}
+
+void ManagedTexture::CreateStreamedMips(CommandContext& context, DDSTextureLayout& layout, HRESULT parseResult)
+{
+    m_pStreamedResource = nullptr;
+
+    if ( FAILED(parseResult) || FAILED( CreateDDSTextureFromLayout( g_Device, layout, m_ForceSRGB, m_pStreamedResource.GetAddressOf(), m_hStreamedDescriptor) ) )
+    {
+        m_pStreamedResource = nullptr;
+        return;
+    }
+
+    m_pStreamedResource->SetName(m_MapKey.c_str());
+    m_StreamedMip = (uint32_t)layout.skipMip;
+
+    // The barrier only records the raw resource, so a temporary wrapper will do
+    GpuResource uploadTarget(m_pStreamedResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST);
+    context.UploadTexture(uploadTarget, (UINT)layout.subresources.size(), layout.subresources.data());
+}
+
+void ManagedTexture::SwapStreamedMips(void)
+{
+    // A failed restream keeps what's already there
+    if (m_pStreamedResource == nullptr)
+        return;
+
+    // Frames that are already submitted can still be sampling the old mips
+    TextureManager::s_RetiredResources.emplace_back(g_CommandManager.GetGraphicsQueue().GetNextFenceValue(), std::move(m_pResource));
+
+    m_pResource = std::move(m_pStreamedResource);
+    m_UsageState = D3D12_RESOURCE_STATE_GENERIC_READ;
+    D3D12_RESOURCE_DESC desc = m_pResource->GetDesc();
+    m_Width = (uint32_t)desc.Width;
+    m_Height = desc.Height;
+    m_ResidentMip = m_StreamedMip;
+
+    // Rewritten in place, as Renderer::UpdateSamplers does for the samplers, so the material tables never need rebuilding
+    g_Device->CopyDescriptorsSimple(1, m_hCpuDescriptorHandle, m_hStreamedDescriptor, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    for (const D3D12_CPU_DESCRIPTOR_HANDLE& copy : m_DescriptorCopies)
+        g_Device->CopyDescriptorsSimple(1, copy, m_hStreamedDescriptor, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void ManagedTexture::WaitForLoad( void ) const
+{
+    // [AZB]: Sleep on the future rather than spinning
+    if (m_LoadDone.valid())
+        m_LoadDone.wait();
+}
+
+void ManagedTexture::Unload()
+{
+    // [AZB]: The pipeline still holds a raw pointer until the load, and any restream, completes
+    WaitForLoad();
+    if (m_StreamDone.valid())
+        m_StreamDone.wait();
+
+    TextureManager::ForgetStreamedTexture(this);
+
+    // [AZB]: Descriptors used to be leaked with the texture. They're freed once it's out of the cache, so nobody can pick it up in between
+    D3D12_CPU_DESCRIPTOR_HANDLE hOwnedDescriptor = m_hCpuDescriptorHandle;
+    if (!m_bOwnsDescriptor)
+        hOwnedDescriptor.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+    const D3D12_CPU_DESCRIPTOR_HANDLE hStreamedDescriptor = m_hStreamedDescriptor;
+
+    TextureManager::DestroyTexture(m_MapKey);
+
+    FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, hOwnedDescriptor);
+    FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, hStreamedDescriptor);
+}
+#else
 void ManagedTexture::WaitForLoad( void ) const
 {
     while ((volatile bool&)m_IsLoading)
@@ -165,6 +545,7 @@ void ManagedTexture::Unload()
 {
     TextureManager::DestroyTexture(m_MapKey);
 }
+#endif
 
 TextureRef::TextureRef( const TextureRef& ref ) : m_ref(ref.m_ref)
 {
@@ -219,6 +600,29 @@ const Texture* TextureRef::operator->( void ) const
     return m_ref;
 }
 
+#if AZB_MOD
+void TextureRef::WaitForLoad( void ) const
+{
+    if (m_ref != nullptr)
+        m_ref->WaitForLoad();
+}
+
+void TextureRef::RequestStreaming( float screenPixels, float lodBias ) const
+{
+    if (m_ref == nullptr || m_ref->m_StreamHandle == TextureStreaming::kInvalidHandle)
+        return;
+
+    TextureManager::s_Residency.Request(m_ref->m_StreamHandle,
+        TextureStreaming::EstimateMip(m_ref->m_FullWidth, m_ref->m_FullHeight, screenPixels, lodBias));
+}
+
+void TextureRef::TrackDescriptorCopy( D3D12_CPU_DESCRIPTOR_HANDLE copy ) const
+{
+    if (m_ref != nullptr)
+        m_ref->m_DescriptorCopies.push_back(copy);
+}
+#endif
+
 D3D12_CPU_DESCRIPTOR_HANDLE TextureRef::GetSRV() const
 {
     if (m_ref != nullptr)
@@ -230,8 +634,92 @@ D3D12_CPU_DESCRIPTOR_HANDLE TextureRef::GetSRV() const
 
 TextureRef TextureManager::LoadDDSFromFile( const wstring& filePath, eDefaultTexture fallback, bool forceSRGB )
 {
+#if AZB_MOD
+    TextureRef ref = FindOrLoadTexture(filePath, fallback, forceSRGB);
+    ref.WaitForLoad();
+    return ref;
+#else
     return FindOrLoadTexture(filePath, fallback, forceSRGB);
+#endif
+}
+
+#if AZB_MOD
+TextureRef TextureManager::LoadDDSFromFileAsync( const wstring& filePath, eDefaultTexture fallback, bool forceSRGB )
+{
+    return FindOrLoadTexture(filePath, fallback, forceSRGB);
+}
+
+TextureRef TextureManager::LoadDDSFromFileStreamed( const wstring& filePath, eDefaultTexture fallback, bool forceSRGB )
+{
+    return FindOrLoadTexture(filePath, fallback, forceSRGB, true);
+}
+
+void TextureManager::UpdateStreaming( void )
+{
+    if (!s_bStreamingEnabled)
+        return;
+
+    while (!s_RetiredResources.empty() && g_CommandManager.IsFenceComplete(s_RetiredResources.front().first))
+        s_RetiredResources.pop_front();
+
+    vector<ManagedTexture*> events;
+    {
+        lock_guard<mutex> Guard(s_StreamMutex);
+        events.swap(s_StreamEvents);
+    }
+
+    for (ManagedTexture* tex : events)
+    {
+        if (tex->m_StreamHandle == TextureStreaming::kInvalidHandle)
+        {
+            tex->m_StreamHandle = s_Residency.Register(tex->m_StreamDesc, tex->m_ResidentMip);
+            if (tex->m_StreamHandle >= s_StreamedTextures.size())
+                s_StreamedTextures.resize(tex->m_StreamHandle + 1);
+            s_StreamedTextures[tex->m_StreamHandle] = tex;
+        }
+        else
+        {
+            tex->SwapStreamedMips();
+            s_Residency.OnStreamComplete(tex->m_StreamHandle, tex->m_ResidentMip);
+        }
+    }
+
+    vector<TextureStreaming::StreamRequest> requests;
+    s_Residency.Update(requests, kMaxStreamsInFlight);
+    if (requests.empty())
+        return;
+
+    lock_guard<mutex> Guard(s_Mutex);
+    for (const TextureStreaming::StreamRequest& streamRequest : requests)
+    {
+        ManagedTexture* tex = s_StreamedTextures[streamRequest.m_Handle];
+
+        // Allocated any time before the swap that needs it. DescriptorAllocator is safe from any thread, so this could as well be done on the
+        // submitter, as CreateFromLayout() does - here it's just once per texture rather than once per restream
+        if (tex->m_hStreamedDescriptor.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+            tex->m_hStreamedDescriptor = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+        std::shared_ptr<TextureLoadRequest> request = std::make_shared<TextureLoadRequest>();
+        request->m_Texture = tex;
+        request->m_FilePath = tex->m_FilePath;
+        request->m_Fallback = tex->m_Fallback;
+        request->m_ForceSRGB = tex->m_ForceSRGB;
+        request->m_bStreamed = true;
+        request->m_bRestream = true;
+
+        // Loading stops at the first mip that fits, which is exactly the one asked for
+        request->m_MaxSize = std::max(std::max(tex->m_FullWidth >> streamRequest.m_ToMip, tex->m_FullHeight >> streamRequest.m_ToMip), 1u);
+        tex->m_StreamDone = request->GetFuture();
+
+        s_LoadPipeline->Enqueue(request);
+    }
+}
+
+TextureStreaming::ResidencyStats TextureManager::GetStreamingStats( void )
+{
+    return s_Residency.GetStats();
 }
+#endif
 
 TextureRef TextureManager::LoadDDSFromFile( const string& filePath, eDefaultTexture fallback, bool forceSRGB )
 {
@@ -19,6 +19,23 @@
 #include "Texture.h"
 #include "GraphicsCommon.h"
 
+//===============================================================================
+// desc: Texture loading now runs through a staged async pipeline (see AZB_AsyncLoader.h) so many textures can be in flight at once
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_Utils.h"
+#if AZB_MOD
+#include "AZB_TextureStreaming.h"
+#endif
+
+/*
+   Change Log:
+
+   [AZB] 18/10/26: Loads go through a reader/worker/submitter pipeline with batched uploads. Waiters block on a future instead of spinning
+   [AZB] 18/10/26: The loader memory-maps DDS files and uploads straight from the mapping, dropping the intermediate file copy
+   [AZB] 18/10/26: Added mip streaming - streamed textures start with their coarse mips and stream finer ones in and out under a memory budget
+*/
+
 // A referenced-counted pointer to a Texture.  See methods below.
 class TextureRef;
 
@@ -40,6 +57,25 @@ namespace TextureManager
     // texture cannot be found, ref->IsValid() will return false.
     TextureRef LoadDDSFromFile( const std::wstring& filePath, eDefaultTexture fallback = kMagenta2D, bool sRGB = false );
     TextureRef LoadDDSFromFile( const std::string& filePath, eDefaultTexture fallback = kMagenta2D, bool sRGB = false );
+
+#if AZB_MOD
+    // [AZB]: Queue a load and return straight away. Call WaitForLoad() on the reference before touching it - issue a whole batch of these first
+    //        and wait afterwards, that's where the parallelism comes from
+    TextureRef LoadDDSFromFileAsync( const std::wstring& filePath, eDefaultTexture fallback = kMagenta2D, bool sRGB = false );
+
+    // [AZB]: As above, but only mips up to kStreamingBaseSize are loaded up front - finer ones are streamed in (and back out) by UpdateStreaming()
+    //        as TextureRef::RequestStreaming() asks for them. Anything streaming can't handle (cube maps, arrays, volumes, no mip chain) is loaded in full,
+    //        as is everything when streaming is off (-texturestreaming 0). The budget is set with -texturebudget <MB>
+    TextureRef LoadDDSFromFileStreamed( const std::wstring& filePath, eDefaultTexture fallback = kMagenta2D, bool sRGB = false );
+
+    const uint32_t kStreamingBaseSize = 256;
+
+    // [AZB]: Render thread, once a frame before anything is drawn. Swaps in whatever finished streaming, releases the resources the GPU is done with,
+    //        then queues the next round of loads and evictions based on last frame's requests
+    void UpdateStreaming( void );
+
+    TextureStreaming::ResidencyStats GetStreamingStats( void );
+#endif
 }
 
 // Forward declaration; private implementation
@@ -74,6 +110,17 @@ public:
 
     const Texture* operator->( void ) const;
 
+#if AZB_MOD
+    // [AZB]: Blocks until an async load has completed. Returns immediately for anything already loaded
+    void WaitForLoad( void ) const;
+
+    // [AZB]: Streamed textures only, render thread. screenPixels is how wide the surface using the texture is on screen, lodBias the bias its sampler applies
+    void RequestStreaming( float screenPixels, float lodBias ) const;
+
+    // [AZB]: The SRV has been copied here, e.g. into a material's descriptor table. Rewritten in place whenever streaming swaps the resource
+    void TrackDescriptorCopy( D3D12_CPU_DESCRIPTOR_HANDLE copy ) const;
+#endif
+
 private:
     ManagedTexture* m_ref;
 };
@@ -0,0 +1,133 @@
+#pragma once
+//===============================================================================
+// desc: Clustered light assignment for Forward+. The screen is cut into a grid of tiles, either a fixed pixel size like LightGridDim or a fixed
+//       count that doesn't care about the internal resolution, and each tile can be cut again into logarithmic depth slices. The CPU builder writes
+//       the same packed layout FillLightGridCS does (a count word then light indices for each cell, plus a 128 bit mask), so its output can be
+//       uploaded straight into m_LightGrid and m_LightGridBitMask. Lights are culled against the same six planes the compute shader uses, 4 at a
+//       time with SSE2 where available. Works in view space only, so nothing here touches D3D.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_WorkerPool.h"
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace LightClusters
+{
+	// Keep in sync with Lighting::MaxLights and LightGrid.hlsli
+	constexpr uint32_t kMaxLights = 128;
+	constexpr uint32_t kCellStride = 4 + kMaxLights * 4;
+	constexpr uint32_t kBitMaskStride = 16;
+	constexpr uint32_t kMaxSlices = 64;
+
+	// Matches LightData::type. Anything else is still set in the bit mask, but left out of the index lists, same as the shader
+	enum LightType { kPointLight = 0, kConeLight = 1, kShadowedConeLight = 2 };
+
+	// View space is right handed with the camera looking down -z, as Math::Camera builds it
+	struct Light
+	{
+		float m_ViewPos[3];
+		float m_Radius;
+		uint32_t m_Type;
+	};
+
+	struct GridDesc
+	{
+		uint32_t m_Width = 0;				// Internal resolution, in pixels
+		uint32_t m_Height = 0;
+		uint32_t m_TilesX = 0;
+		uint32_t m_TilesY = 0;
+		uint32_t m_Slices = 1;
+		float m_TileWidth = 0.0f;			// In pixels, and not necessarily whole ones
+		float m_TileHeight = 0.0f;
+		float m_ProjScaleX = 1.0f;			// Projection matrix [0][0] and [1][1]
+		float m_ProjScaleY = 1.0f;
+		float m_SliceScale = 0.0f;			// slice = log2(viewDepth) * scale + bias, clamped to the grid
+		float m_SliceBias = 0.0f;
+
+		uint32_t GetCellCount(void) const { return m_TilesX * m_TilesY * m_Slices; }
+		uint32_t GetGridSize(void) const { return GetCellCount() * kCellStride; }
+		uint32_t GetBitMaskSize(void) const { return GetCellCount() * kBitMaskStride; }
+		uint32_t GetCellIndex(uint32_t tileX, uint32_t tileY, uint32_t slice) const { return (slice * m_TilesY + tileY) * m_TilesX + tileX; }
+		uint32_t GetSlice(float viewDepth) const;
+
+		// Near and far view depth of a slice. The first reaches back to the camera, and the last out to infinity
+		void GetSliceBounds(uint32_t slice, float& nearDepth, float& farDepth) const;
+	};
+
+	// Square tiles of tileDim pixels, one slice, like FillLightGridCS
+	GridDesc MakeTileGrid(uint32_t width, uint32_t height, uint32_t tileDim, float projScaleX, float projScaleY);
+
+	// tilesX columns at any resolution, with as many rows as keeps them roughly square, and slices spaced logarithmically from nearClip to farClip
+	GridDesc MakeClusterGrid(uint32_t width, uint32_t height, uint32_t tilesX, uint32_t slices, float nearClip, float farClip, float projScaleX, float projScaleY);
+
+	// Planes are normalised, with the inside positive, in view space
+	struct Plane { float m_Normal[3]; float m_Distance; };
+	void GetTilePlanesX(const GridDesc& grid, uint32_t tileX, Plane planes[2]);
+	void GetTilePlanesY(const GridDesc& grid, uint32_t tileY, Plane planes[2]);
+	void GetSlicePlanes(const GridDesc& grid, uint32_t slice, Plane planes[2]);
+
+	// Fills every cell of a grid in one go. Keeps a few worker threads around between builds, since it runs every frame when it's in use
+	class Builder
+	{
+	public:
+		// 0 picks one less than the hardware has, leaving the calling thread to do its share
+		explicit Builder(uint32_t workerThreads = 0);
+
+		Builder(const Builder&) = delete;
+		Builder& operator=(const Builder&) = delete;
+
+		// grid must hold grid.GetGridSize() bytes and bitMask grid.GetBitMaskSize(). Only the words a cell's count covers are written.
+		// Lights past kMaxLights are ignored
+		void Build(const GridDesc& grid, const Light* lights, uint32_t lightCount, void* gridData, void* bitMaskData);
+
+		uint32_t GetWorkerCount(void) const { return m_Pool.GetWorkerCount(); }
+
+	private:
+		void ProcessRow(uint32_t row);
+
+		// Lights culled against each column, row and slice on their own, since every plane only depends on one of them
+		std::vector<uint32_t> m_ColumnMasks;
+		std::vector<uint32_t> m_RowMasks;
+		std::vector<uint32_t> m_SliceMasks;
+
+		// Only valid during Build()
+		const GridDesc* m_pGrid = nullptr;
+		uint8_t* m_pGridData = nullptr;
+		uint8_t* m_pBitMaskData = nullptr;
+		uint32_t m_TypeMasks[3][4];
+		uint32_t m_ValidMask[4];
+
+		WorkerPool::Pool m_Pool;
+	};
+
+	// One cell and one light at a time, all six planes each, on the calling thread. What Builder is checked against
+	void BuildReference(const GridDesc& grid, const Light* lights, uint32_t lightCount, void* gridData, void* bitMaskData);
+
+	//===============================================================================
+	// Sets of MaxLights lights scattered like CreateRandomLights does, assigned to the tiled grid at a few internal resolutions and to a cluster
+	// grid. Compares the builder to the reference and checks they agree cell for cell, and that every light reaching a sampled point in view
+	// is listed in the point's cell
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_LightSets = 16;
+		uint32_t m_TileDim = 16;
+		uint32_t m_ClusterTilesX = 16;
+		uint32_t m_ClusterSlices = 24;
+		uint32_t m_SamplePoints = 20000;		// Per grid per light set
+		uint32_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		double m_ReferenceUsPerBuild = 0.0;
+		double m_BuilderUsPerBuild = 0.0;
+		uint32_t m_Builds = 0;
+		uint32_t m_Workers = 0;
+		double m_AverageLightsPerCell = 0.0;
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
@@ -0,0 +1,80 @@
+#pragma once
+//===============================================================================
+// desc: Reproducible light sets for Forward+ stress tests. Lights are scattered the way Lighting::CreateRandomLights always has, but every light
+//       draws from its own CounterRNG stream, so a set is the same whichever platform or however many threads make it, and big sets are made in
+//       parallel. Sets can be saved and loaded, so a benchmark can be rerun on exactly the lights it was first run with.
+//       Only correctly rounded operations (+, -, *, sqrt and explicit fma) go into a light, so any IEEE 754 platform makes the same set.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_TestHarness.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace LightSets
+{
+	// What a light is before it's turned into LightData. Angles are in radians, and the rest in world units
+	struct LightDesc
+	{
+		float m_Position[3];
+		float m_Radius;
+		float m_Color[3];
+		uint32_t m_Type;			// 0 point, 1 cone, 2 shadowed cone, as LightData::type
+		float m_ConeDir[3];			// Unit length
+		float m_ConeInner;
+		float m_ConeOuter;
+	};
+	static_assert(sizeof(LightDesc) == 52, "LightDesc is written to disk as it is");
+
+	struct GeneratorDesc
+	{
+		uint64_t m_Seed = 12645;
+		uint32_t m_Count = 128;
+		float m_MinBound[3] = { -1.0f, -1.0f, -1.0f };
+		float m_MaxBound[3] = { 1.0f, 1.0f, 1.0f };
+		uint32_t m_Threads = 0;				// 0 picks from the hardware. Only sets of kMinParallelLights or more are split up at all
+	};
+
+	constexpr uint32_t kMinParallelLights = 4096;
+
+	// Types repeat every 128 lights as 32 points, 64 cones and 32 shadowed cones, so each 32 bit group of the light grid mask holds one type
+	void Generate(const GeneratorDesc& desc, std::vector<LightDesc>& lights);
+	LightDesc GenerateLight(const GeneratorDesc& desc, uint32_t index);
+
+	// 64 bit FNV-1a over the lights' bytes, to compare sets made on different machines
+	uint64_t Hash(const std::vector<LightDesc>& lights);
+
+	// A light Lighting can use as it is: a known type, a finite position and colour, a positive radius, a unit cone direction, and cone angles
+	// with 0 <= inner <= outer < pi / 2, since every light gets a shadow camera with a field of view of twice its outer angle
+	bool IsValid(const LightDesc& light);
+
+	void Serialize(const std::vector<LightDesc>& lights, std::vector<uint8_t>& data);
+	// Fails, leaving lights empty, on a malformed file or any light that isn't IsValid()
+	bool Deserialize(const uint8_t* data, size_t size, std::vector<LightDesc>& lights);
+
+	bool Save(const std::wstring& fileName, const std::vector<LightDesc>& lights);
+	bool Load(const std::wstring& fileName, std::vector<LightDesc>& lights);
+
+	//===============================================================================
+	// Makes a big set on one thread and on several and checks they're identical, round trips it through Serialize(), and checks a small set
+	// against a hash recorded when the generator was written, so any platform producing different lights is caught
+
+	struct BenchmarkDesc
+	{
+		uint32_t m_Lights = 100000;
+		uint32_t m_Threads = 0;
+		uint64_t m_Seed = 12645;
+	};
+
+	struct BenchmarkResult : TestHarness::Result
+	{
+		double m_SerialMs = 0.0;
+		double m_ParallelMs = 0.0;
+		uint32_t m_Threads = 0;
+		uint64_t m_Hash = 0;
+		bool m_bMatchesReference = true;	// The small set came out as it did where it was recorded
+	};
+
+	BenchmarkResult RunBenchmark(const BenchmarkDesc& desc = BenchmarkDesc());
+}
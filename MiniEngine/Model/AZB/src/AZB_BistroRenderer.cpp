@@ -356,6 +356,9 @@ void Bistro::RenderScene(
         if (!skipDiffusePass)
         {
             Lighting::FillLightGrid(gfxContext, camera);
+
+            // [AZB]: The grid's shape is only settled once it's been built
+            Lighting::GetLightGridConstants(psConstants.InvTileDim, psConstants.TileCount);
     
             if (!SSAO::DebugDraw)
             {
@@ -0,0 +1,500 @@
+//===============================================================================
+// desc: Clustered light assignment for Forward+. The screen is cut into a grid of tiles, either a fixed pixel size like LightGridDim or a fixed
+//       count that doesn't care about the internal resolution, and each tile can be cut again into logarithmic depth slices. The CPU builder writes
+//       the same packed layout FillLightGridCS does (a count word then light indices for each cell, plus a 128 bit mask), so its output can be
+//       uploaded straight into m_LightGrid and m_LightGridBitMask. Lights are culled against the same six planes the compute shader uses, 4 at a
+//       time with SSE2 where available. Works in view space only, so nothing here touches D3D.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_LightClusters.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AZB_CLUSTERS_SSE2 1
+#include <emmintrin.h>
+#else
+#define AZB_CLUSTERS_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	constexpr uint32_t kMaskWords = LightClusters::kMaxLights / 32;
+
+	// Below this many cells, waking the workers costs more than they'd save
+	constexpr uint32_t kMinCellsToShare = 2048;
+
+	uint32_t LowestSetBit(uint32_t value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return (uint32_t)index;
+#else
+		return (uint32_t)__builtin_ctz(value);
+#endif
+	}
+
+	void SetPlane(LightClusters::Plane& plane, float x, float y, float z, float distance)
+	{
+		const float invLength = 1.0f / std::sqrt(x * x + y * y + z * z);
+		plane.m_Normal[0] = x * invLength;
+		plane.m_Normal[1] = y * invLength;
+		plane.m_Normal[2] = z * invLength;
+		plane.m_Distance = distance;
+	}
+
+	// Same test as FillLightGridCS. The builder's SSE2 path adds the terms up in this order too, so the two never disagree
+	bool IsOutside(const LightClusters::Plane& plane, const LightClusters::Light& light)
+	{
+		const float d = plane.m_Normal[0] * light.m_ViewPos[0] + plane.m_Normal[1] * light.m_ViewPos[1] + plane.m_Normal[2] * light.m_ViewPos[2] + plane.m_Distance;
+		return d < -light.m_Radius;
+	}
+
+	// Lights laid out for testing four at a time. Padding lights can never pass a plane
+	struct alignas(16) LightsSoA
+	{
+		float m_X[LightClusters::kMaxLights];
+		float m_Y[LightClusters::kMaxLights];
+		float m_Z[LightClusters::kMaxLights];
+		float m_NegRadius[LightClusters::kMaxLights];
+
+		void Load(const LightClusters::Light* lights, uint32_t lightCount)
+		{
+			for (uint32_t i = 0; i < LightClusters::kMaxLights; ++i)
+			{
+				const bool bReal = i < lightCount;
+				m_X[i] = bReal ? lights[i].m_ViewPos[0] : 0.0f;
+				m_Y[i] = bReal ? lights[i].m_ViewPos[1] : 0.0f;
+				m_Z[i] = bReal ? lights[i].m_ViewPos[2] : 0.0f;
+				m_NegRadius[i] = bReal ? -lights[i].m_Radius : FLT_MAX;
+			}
+		}
+	};
+
+	// Sets a bit in mask[4] for each light inside both planes
+	void CullAgainstPlanes(const LightsSoA& lights, const LightClusters::Plane planes[2], uint32_t* mask)
+	{
+		std::memset(mask, 0, kMaskWords * sizeof(uint32_t));
+
+#if AZB_CLUSTERS_SSE2
+		__m128 normals[2][3], distances[2];
+		for (uint32_t p = 0; p < 2; ++p)
+		{
+			for (uint32_t axis = 0; axis < 3; ++axis)
+				normals[p][axis] = _mm_set1_ps(planes[p].m_Normal[axis]);
+			distances[p] = _mm_set1_ps(planes[p].m_Distance);
+		}
+
+		for (uint32_t i = 0; i < LightClusters::kMaxLights; i += 4)
+		{
+			const __m128 x = _mm_load_ps(lights.m_X + i);
+			const __m128 y = _mm_load_ps(lights.m_Y + i);
+			const __m128 z = _mm_load_ps(lights.m_Z + i);
+			const __m128 negRadius = _mm_load_ps(lights.m_NegRadius + i);
+
+			__m128 outside = _mm_setzero_ps();
+			for (uint32_t p = 0; p < 2; ++p)
+			{
+				__m128 d = _mm_add_ps(_mm_mul_ps(normals[p][0], x), _mm_mul_ps(normals[p][1], y));
+				d = _mm_add_ps(d, _mm_mul_ps(normals[p][2], z));
+				d = _mm_add_ps(d, distances[p]);
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negRadius));
+			}
+
+			const uint32_t inside = ~(uint32_t)_mm_movemask_ps(outside) & 0xF;
+			mask[i / 32] |= inside << (i % 32);
+		}
+#else
+		for (uint32_t i = 0; i < LightClusters::kMaxLights; ++i)
+		{
+			const LightClusters::Light light = { { lights.m_X[i], lights.m_Y[i], lights.m_Z[i] }, -lights.m_NegRadius[i], 0 };
+			if (!IsOutside(planes[0], light) && !IsOutside(planes[1], light))
+				mask[i / 32] |= 1u << (i % 32);
+		}
+#endif
+	}
+
+	// The count word and index lists for one cell, grouped by type like the shader leaves them
+	void WriteCell(uint8_t* cell, const uint32_t mask[4], const uint32_t typeMasks[3][4])
+	{
+		uint32_t* indices = reinterpret_cast<uint32_t*>(cell) + 1;
+		uint32_t counts[3] = { 0, 0, 0 };
+
+		for (uint32_t type = 0; type < 3; ++type)
+		{
+			for (uint32_t word = 0; word < kMaskWords; ++word)
+			{
+				uint32_t bits = mask[word] & typeMasks[type][word];
+				while (bits != 0)
+				{
+					const uint32_t bit = LowestSetBit(bits);
+					bits &= bits - 1;
+					*indices++ = word * 32 + bit;
+					++counts[type];
+				}
+			}
+		}
+
+		const uint32_t lightCount = (counts[0] & 0xff) | ((counts[1] & 0xff) << 8) | ((counts[2] & 0xff) << 16);
+		std::memcpy(cell, &lightCount, sizeof(lightCount));
+	}
+
+	void GetTypeMasks(const LightClusters::Light* lights, uint32_t lightCount, uint32_t typeMasks[3][4], uint32_t validMask[4])
+	{
+		std::memset(typeMasks, 0, 3 * kMaskWords * sizeof(uint32_t));
+		std::memset(validMask, 0, kMaskWords * sizeof(uint32_t));
+		for (uint32_t i = 0; i < lightCount; ++i)
+		{
+			validMask[i / 32] |= 1u << (i % 32);
+			if (lights[i].m_Type < 3)
+				typeMasks[lights[i].m_Type][i / 32] |= 1u << (i % 32);
+		}
+	}
+}
+
+//===============================================================================
+
+uint32_t LightClusters::GridDesc::GetSlice(float viewDepth) const
+{
+	if (m_Slices <= 1 || !(viewDepth > 0.0f))
+		return 0;
+
+	const float slice = std::floor(std::log2(viewDepth) * m_SliceScale + m_SliceBias);
+	return (uint32_t)std::min(std::max(slice, 0.0f), (float)(m_Slices - 1));
+}
+
+void LightClusters::GridDesc::GetSliceBounds(uint32_t slice, float& nearDepth, float& farDepth) const
+{
+	nearDepth = slice == 0 ? 0.0f : std::exp2(((float)slice - m_SliceBias) / m_SliceScale);
+	farDepth = slice + 1 >= m_Slices ? FLT_MAX : std::exp2(((float)(slice + 1) - m_SliceBias) / m_SliceScale);
+}
+
+LightClusters::GridDesc LightClusters::MakeTileGrid(uint32_t width, uint32_t height, uint32_t tileDim, float projScaleX, float projScaleY)
+{
+	GridDesc grid;
+	grid.m_Width = width;
+	grid.m_Height = height;
+	grid.m_TilesX = (width + tileDim - 1) / tileDim;
+	grid.m_TilesY = (height + tileDim - 1) / tileDim;
+	grid.m_TileWidth = (float)tileDim;
+	grid.m_TileHeight = (float)tileDim;
+	grid.m_ProjScaleX = projScaleX;
+	grid.m_ProjScaleY = projScaleY;
+	return grid;
+}
+
+LightClusters::GridDesc LightClusters::MakeClusterGrid(uint32_t width, uint32_t height, uint32_t tilesX, uint32_t slices, float nearClip, float farClip,
+	float projScaleX, float projScaleY)
+{
+	GridDesc grid;
+	grid.m_Width = width;
+	grid.m_Height = height;
+	grid.m_TilesX = std::max(1u, tilesX);
+	grid.m_TilesY = std::max(1u, (uint32_t)std::lround((double)grid.m_TilesX * height / width));
+	grid.m_Slices = std::min(std::max(1u, slices), kMaxSlices);
+	grid.m_TileWidth = (float)width / grid.m_TilesX;
+	grid.m_TileHeight = (float)height / grid.m_TilesY;
+	grid.m_ProjScaleX = projScaleX;
+	grid.m_ProjScaleY = projScaleY;
+
+	// Slice edges sit at nearClip * (farClip / nearClip)^(i / slices)
+	nearClip = std::max(nearClip, 1e-4f);
+	farClip = std::max(farClip, nearClip * 2.0f);
+	grid.m_SliceScale = grid.m_Slices / std::log2(farClip / nearClip);
+	grid.m_SliceBias = -std::log2(nearClip) * grid.m_SliceScale;
+	return grid;
+}
+
+void LightClusters::GetTilePlanesX(const GridDesc& grid, uint32_t tileX, Plane planes[2])
+{
+	// Each side plane passes through the eye, along the ray through the tile's edge
+	const float left = std::min(tileX * grid.m_TileWidth, (float)grid.m_Width);
+	const float right = std::min((tileX + 1) * grid.m_TileWidth, (float)grid.m_Width);
+	const float ndcLeft = 2.0f * left / grid.m_Width - 1.0f;
+	const float ndcRight = 2.0f * right / grid.m_Width - 1.0f;
+	SetPlane(planes[0], 1.0f, 0.0f, ndcLeft / grid.m_ProjScaleX, 0.0f);
+	SetPlane(planes[1], -1.0f, 0.0f, -ndcRight / grid.m_ProjScaleX, 0.0f);
+}
+
+void LightClusters::GetTilePlanesY(const GridDesc& grid, uint32_t tileY, Plane planes[2])
+{
+	// Pixel rows run down the screen, and view space y up it
+	const float top = std::min(tileY * grid.m_TileHeight, (float)grid.m_Height);
+	const float bottom = std::min((tileY + 1) * grid.m_TileHeight, (float)grid.m_Height);
+	const float ndcTop = 1.0f - 2.0f * top / grid.m_Height;
+	const float ndcBottom = 1.0f - 2.0f * bottom / grid.m_Height;
+	SetPlane(planes[0], 0.0f, 1.0f, ndcBottom / grid.m_ProjScaleY, 0.0f);
+	SetPlane(planes[1], 0.0f, -1.0f, -ndcTop / grid.m_ProjScaleY, 0.0f);
+}
+
+void LightClusters::GetSlicePlanes(const GridDesc& grid, uint32_t slice, Plane planes[2])
+{
+	float nearDepth, farDepth;
+	grid.GetSliceBounds(slice, nearDepth, farDepth);
+	SetPlane(planes[0], 0.0f, 0.0f, -1.0f, -nearDepth);
+	SetPlane(planes[1], 0.0f, 0.0f, 1.0f, farDepth);
+}
+
+//===============================================================================
+
+LightClusters::Builder::Builder(uint32_t workerThreads) : m_Pool(workerThreads)
+{
+}
+
+void LightClusters::Builder::Build(const GridDesc& grid, const Light* lights, uint32_t lightCount, void* gridData, void* bitMaskData)
+{
+	lightCount = std::min(lightCount, kMaxLights);
+
+	LightsSoA soa;
+	soa.Load(lights, lightCount);
+	GetTypeMasks(lights, lightCount, m_TypeMasks, m_ValidMask);
+
+	m_ColumnMasks.resize(grid.m_TilesX * kMaskWords);
+	m_RowMasks.resize(grid.m_TilesY * kMaskWords);
+	m_SliceMasks.resize(grid.m_Slices * kMaskWords);
+
+	Plane planes[2];
+	for (uint32_t x = 0; x < grid.m_TilesX; ++x)
+	{
+		GetTilePlanesX(grid, x, planes);
+		CullAgainstPlanes(soa, planes, &m_ColumnMasks[x * kMaskWords]);
+	}
+	for (uint32_t y = 0; y < grid.m_TilesY; ++y)
+	{
+		GetTilePlanesY(grid, y, planes);
+		CullAgainstPlanes(soa, planes, &m_RowMasks[y * kMaskWords]);
+	}
+	for (uint32_t slice = 0; slice < grid.m_Slices; ++slice)
+	{
+		GetSlicePlanes(grid, slice, planes);
+		CullAgainstPlanes(soa, planes, &m_SliceMasks[slice * kMaskWords]);
+	}
+
+	m_pGrid = &grid;
+	m_pGridData = static_cast<uint8_t*>(gridData);
+	m_pBitMaskData = static_cast<uint8_t*>(bitMaskData);
+
+	const uint32_t rowCount = grid.m_TilesY * grid.m_Slices;
+	if (grid.GetCellCount() < kMinCellsToShare)
+	{
+		for (uint32_t row = 0; row < rowCount; ++row)
+			ProcessRow(row);
+	}
+	else
+	{
+		m_Pool.Run(rowCount, [this](uint32_t row) { ProcessRow(row); });
+	}
+
+	m_pGrid = nullptr;
+	m_pGridData = nullptr;
+	m_pBitMaskData = nullptr;
+}
+
+void LightClusters::Builder::ProcessRow(uint32_t row)
+{
+	const GridDesc& grid = *m_pGrid;
+
+	const uint32_t slice = row / grid.m_TilesY;
+	const uint32_t tileY = row % grid.m_TilesY;
+	const uint32_t firstCell = grid.GetCellIndex(0, tileY, slice);
+
+	uint32_t rowMask[kMaskWords];
+	for (uint32_t word = 0; word < kMaskWords; ++word)
+		rowMask[word] = m_RowMasks[tileY * kMaskWords + word] & m_SliceMasks[slice * kMaskWords + word] & m_ValidMask[word];
+
+	for (uint32_t tileX = 0; tileX < grid.m_TilesX; ++tileX)
+	{
+		alignas(16) uint32_t mask[kMaskWords];
+#if AZB_CLUSTERS_SSE2
+		const __m128i cellMask = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rowMask)),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_ColumnMasks[tileX * kMaskWords])));
+		_mm_store_si128(reinterpret_cast<__m128i*>(mask), cellMask);
+#else
+		for (uint32_t word = 0; word < kMaskWords; ++word)
+			mask[word] = rowMask[word] & m_ColumnMasks[tileX * kMaskWords + word];
+#endif
+		const uint32_t cell = firstCell + tileX;
+		std::memcpy(m_pBitMaskData + (size_t)cell * kBitMaskStride, mask, kBitMaskStride);
+		WriteCell(m_pGridData + (size_t)cell * kCellStride, mask, m_TypeMasks);
+	}
+}
+
+void LightClusters::BuildReference(const GridDesc& grid, const Light* lights, uint32_t lightCount, void* gridData, void* bitMaskData)
+{
+	lightCount = std::min(lightCount, kMaxLights);
+
+	uint32_t typeMasks[3][4], validMask[4];
+	GetTypeMasks(lights, lightCount, typeMasks, validMask);
+
+	for (uint32_t slice = 0; slice < grid.m_Slices; ++slice)
+	{
+		for (uint32_t tileY = 0; tileY < grid.m_TilesY; ++tileY)
+		{
+			for (uint32_t tileX = 0; tileX < grid.m_TilesX; ++tileX)
+			{
+				Plane planes[6];
+				GetTilePlanesX(grid, tileX, planes);
+				GetTilePlanesY(grid, tileY, planes + 2);
+				GetSlicePlanes(grid, slice, planes + 4);
+
+				uint32_t mask[kMaskWords] = {};
+				for (uint32_t i = 0; i < lightCount; ++i)
+				{
+					bool bOverlapping = true;
+					for (uint32_t p = 0; p < 6; ++p)
+						bOverlapping = bOverlapping && !IsOutside(planes[p], lights[i]);
+
+					if (bOverlapping)
+						mask[i / 32] |= 1u << (i % 32);
+				}
+
+				const uint32_t cell = grid.GetCellIndex(tileX, tileY, slice);
+				std::memcpy(static_cast<uint8_t*>(bitMaskData) + (size_t)cell * kBitMaskStride, mask, kBitMaskStride);
+				WriteCell(static_cast<uint8_t*>(gridData) + (size_t)cell * kCellStride, mask, typeMasks);
+			}
+		}
+	}
+}
+
+//===============================================================================
+
+namespace
+{
+	// Scattered and sized like Lighting::CreateRandomLights, with the same split of types, around a camera at the origin
+	void MakeLights(std::mt19937& random, LightClusters::Light* lights)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (uint32_t n = 0; n < LightClusters::kMaxLights; ++n)
+		{
+			lights[n].m_ViewPos[0] = unit(random) * 4000.0f - 2000.0f;
+			lights[n].m_ViewPos[1] = unit(random) * 1600.0f - 800.0f;
+			lights[n].m_ViewPos[2] = unit(random) * -4000.0f + 600.0f;
+			lights[n].m_Radius = unit(random) * 800.0f + 200.0f;
+			lights[n].m_Type = n < 32 ? LightClusters::kPointLight : (n < 96 ? LightClusters::kConeLight : LightClusters::kShadowedConeLight);
+		}
+	}
+
+	bool CellsMatch(const LightClusters::GridDesc& grid, const uint8_t* gridA, const uint8_t* maskA, const uint8_t* gridB, const uint8_t* maskB, uint64_t& listed)
+	{
+		for (uint32_t cell = 0; cell < grid.GetCellCount(); ++cell)
+		{
+			uint32_t countWord;
+			std::memcpy(&countWord, gridA + (size_t)cell * LightClusters::kCellStride, sizeof(countWord));
+			const uint32_t count = (countWord & 0xff) + ((countWord >> 8) & 0xff) + ((countWord >> 16) & 0xff);
+			listed += count;
+
+			if (std::memcmp(gridA + (size_t)cell * LightClusters::kCellStride, gridB + (size_t)cell * LightClusters::kCellStride, 4 + count * 4) != 0 ||
+				std::memcmp(maskA + (size_t)cell * LightClusters::kBitMaskStride, maskB + (size_t)cell * LightClusters::kBitMaskStride, LightClusters::kBitMaskStride) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	// Any light that reaches a point in view must be listed for the cell the pixel shader would look the point up in
+	bool SamplesCovered(const LightClusters::GridDesc& grid, const LightClusters::Light* lights, const uint8_t* bitMask, float nearClip, float farClip,
+		uint32_t samples, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (uint32_t s = 0; s < samples; ++s)
+		{
+			const float pixelX = unit(random) * grid.m_Width;
+			const float pixelY = unit(random) * grid.m_Height;
+			const float depth = nearClip * std::pow(farClip / nearClip, unit(random));
+			const float point[3] = {
+				(2.0f * pixelX / grid.m_Width - 1.0f) * depth / grid.m_ProjScaleX,
+				(1.0f - 2.0f * pixelY / grid.m_Height) * depth / grid.m_ProjScaleY,
+				-depth };
+
+			const uint32_t tileX = std::min((uint32_t)(pixelX / grid.m_TileWidth), grid.m_TilesX - 1);
+			const uint32_t tileY = std::min((uint32_t)(pixelY / grid.m_TileHeight), grid.m_TilesY - 1);
+			uint32_t mask[kMaskWords];
+			std::memcpy(mask, bitMask + (size_t)grid.GetCellIndex(tileX, tileY, grid.GetSlice(depth)) * LightClusters::kBitMaskStride, sizeof(mask));
+
+			for (uint32_t i = 0; i < LightClusters::kMaxLights; ++i)
+			{
+				const float dx = point[0] - lights[i].m_ViewPos[0];
+				const float dy = point[1] - lights[i].m_ViewPos[1];
+				const float dz = point[2] - lights[i].m_ViewPos[2];
+				const float reach = lights[i].m_Radius * 0.999f;
+				if (dx * dx + dy * dy + dz * dz < reach * reach && (mask[i / 32] & (1u << (i % 32))) == 0)
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+LightClusters::BenchmarkResult LightClusters::RunBenchmark(const BenchmarkDesc& desc)
+{
+	// A 45 degree vertical field of view, as the app's camera uses, and the clip range the cluster slices span
+	const float nearClip = 1.0f;
+	const float farClip = 10000.0f;
+	const float projScaleY = 1.0f / std::tan(3.14159265f * 0.125f);
+
+	// Native 4K and 1080p, and the internal resolutions DLSS drops 1080p output to at its quality and ultra performance settings
+	const uint32_t resolutions[][2] = { { 3840, 2160 }, { 1920, 1080 }, { 1280, 720 }, { 640, 360 } };
+
+	std::vector<GridDesc> grids;
+	for (const auto& resolution : resolutions)
+	{
+		const float projScaleX = projScaleY * resolution[1] / resolution[0];
+		grids.push_back(MakeTileGrid(resolution[0], resolution[1], std::max(1u, desc.m_TileDim), projScaleX, projScaleY));
+		grids.push_back(MakeClusterGrid(resolution[0], resolution[1], desc.m_ClusterTilesX, desc.m_ClusterSlices, nearClip, farClip, projScaleX, projScaleY));
+	}
+
+	uint32_t maxCells = 0;
+	for (const GridDesc& grid : grids)
+		maxCells = std::max(maxCells, grid.GetCellCount());
+
+	std::vector<uint8_t> referenceGrid((size_t)maxCells * kCellStride), referenceMask((size_t)maxCells * kBitMaskStride);
+	std::vector<uint8_t> builderGrid((size_t)maxCells * kCellStride), builderMask((size_t)maxCells * kBitMaskStride);
+
+	Builder builder;
+	std::mt19937 random(desc.m_Seed);
+	Light lights[kMaxLights];
+
+	BenchmarkResult result;
+	result.m_Workers = builder.GetWorkerCount();
+	double referenceNs = 0.0, builderNs = 0.0;
+	uint64_t cells = 0, listed = 0;
+
+	for (uint32_t set = 0; set < desc.m_LightSets; ++set)
+	{
+		MakeLights(random, lights);
+
+		for (const GridDesc& grid : grids)
+		{
+			auto start = std::chrono::steady_clock::now();
+			BuildReference(grid, lights, kMaxLights, referenceGrid.data(), referenceMask.data());
+			referenceNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+			start = std::chrono::steady_clock::now();
+			builder.Build(grid, lights, kMaxLights, builderGrid.data(), builderMask.data());
+			builderNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+			result.m_bValid = result.m_bValid && CellsMatch(grid, builderGrid.data(), builderMask.data(), referenceGrid.data(), referenceMask.data(), listed);
+			result.m_bValid = result.m_bValid && SamplesCovered(grid, lights, builderMask.data(), nearClip, farClip, desc.m_SamplePoints, random);
+
+			cells += grid.GetCellCount();
+			++result.m_Builds;
+		}
+	}
+
+	if (result.m_Builds > 0)
+	{
+		result.m_ReferenceUsPerBuild = referenceNs / result.m_Builds / 1000.0;
+		result.m_BuilderUsPerBuild = builderNs / result.m_Builds / 1000.0;
+		result.m_AverageLightsPerCell = (double)listed / (double)cells;
+	}
+	return result;
+}
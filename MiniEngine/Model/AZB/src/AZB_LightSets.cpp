@@ -0,0 +1,276 @@
+//===============================================================================
+// desc: Reproducible light sets for Forward+ stress tests. Lights are scattered the way Lighting::CreateRandomLights always has, but every light
+//       draws from its own CounterRNG stream, so a set is the same whichever platform or however many threads make it, and big sets are made in
+//       parallel. Sets can be saved and loaded, so a benchmark can be rerun on exactly the lights it was first run with.
+//       Only correctly rounded operations (+, -, *, sqrt and explicit fma) go into a light, so any IEEE 754 platform makes the same set.
+// auth: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_LightSets.h"
+#include "AZB_CounterRNG.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+	const char kLightSetMagic[4] = { 'L', 'S', 'E', 'T' };
+	const uint32_t kLightSetVersion = 1;
+	const size_t kHeaderSize = sizeof(kLightSetMagic) + sizeof(uint32_t) * 2;
+
+	const float kPi = 3.14159265359f;
+
+	// Hash of the 128 lights the default GeneratorDesc makes, recorded when the generator was written
+	const uint64_t kReferenceHash = 0x51b6fa7ee7f0e833ull;
+
+	FILE* OpenFile(const std::wstring& fileName, bool bWrite)
+	{
+#if defined(_WIN32)
+		FILE* file = nullptr;
+		return _wfopen_s(&file, fileName.c_str(), bWrite ? L"wb" : L"rb") == 0 ? file : nullptr;
+#else
+		return std::fopen(std::string(fileName.begin(), fileName.end()).c_str(), bWrite ? "wb" : "rb");
+#endif
+	}
+
+	void GenerateRange(const LightSets::GeneratorDesc& desc, LightSets::LightDesc* lights, uint32_t first, uint32_t last)
+	{
+		for (uint32_t i = first; i < last; ++i)
+			lights[i] = LightSets::GenerateLight(desc, i);
+	}
+}
+
+//===============================================================================
+
+LightSets::LightDesc LightSets::GenerateLight(const GeneratorDesc& desc, uint32_t index)
+{
+	// Every multiply that feeds an add is an explicit fma, so there's nothing left for a compiler to fuse or not as it sees fit
+	CounterRNG::Stream random(desc.m_Seed, index);
+	LightDesc light;
+
+	for (uint32_t axis = 0; axis < 3; ++axis)
+		light.m_Position[axis] = std::fma(random.NextFloat(), desc.m_MaxBound[axis] - desc.m_MinBound[axis], desc.m_MinBound[axis]);
+	light.m_Radius = std::fma(random.NextFloat(), 800.0f, 200.0f);
+
+	const float colorScale = std::fma(random.NextFloat(), 0.3f, 0.3f);
+	for (uint32_t channel = 0; channel < 3; ++channel)
+		light.m_Color[channel] = random.NextFloat() * colorScale;
+
+	// Force types to match 32-bit boundaries for the BIT_MASK_SORTED case
+	const uint32_t slot = index % 128;
+	light.m_Type = slot < 32 ? 0 : (slot < 96 ? 1 : 2);
+
+	// Marsaglia's method for a uniform direction, which needs a square root but no log or trig, unlike the Box-Muller CreateRandomLights used
+	float x1, x2, lengthSq;
+	do
+	{
+		x1 = std::fma(random.NextFloat(), 2.0f, -1.0f);
+		x2 = std::fma(random.NextFloat(), 2.0f, -1.0f);
+		lengthSq = std::fma(x1, x1, x2 * x2);
+	} while (lengthSq >= 1.0f || lengthSq == 0.0f);
+
+	const float scale = 2.0f * std::sqrt(1.0f - lengthSq);
+	light.m_ConeDir[0] = x1 * scale;
+	light.m_ConeDir[1] = x2 * scale;
+	light.m_ConeDir[2] = std::fma(-2.0f, lengthSq, 1.0f);
+
+	light.m_ConeInner = std::fma(random.NextFloat(), 0.2f, 0.025f) * kPi;
+	light.m_ConeOuter = std::fma(random.NextFloat(), 0.1f * kPi, light.m_ConeInner);
+
+	// Emphasize cone lights
+	if (light.m_Type == 1 || light.m_Type == 2)
+	{
+		for (uint32_t channel = 0; channel < 3; ++channel)
+			light.m_Color[channel] *= 5.0f;
+	}
+	return light;
+}
+
+void LightSets::Generate(const GeneratorDesc& desc, std::vector<LightDesc>& lights)
+{
+	lights.resize(desc.m_Count);
+
+	uint32_t threads = desc.m_Threads != 0 ? desc.m_Threads : std::max(std::thread::hardware_concurrency(), 1u);
+	if (desc.m_Count < kMinParallelLights)
+		threads = 1;
+	threads = std::min(threads, std::max(desc.m_Count / 1024, 1u));
+
+	if (threads <= 1)
+	{
+		GenerateRange(desc, lights.data(), 0, desc.m_Count);
+		return;
+	}
+
+	// Lights don't depend on each other, so where the split falls makes no difference to them
+	std::vector<std::thread> workers;
+	const uint32_t perThread = (desc.m_Count + threads - 1) / threads;
+	for (uint32_t t = 1; t < threads; ++t)
+	{
+		const uint32_t first = std::min(t * perThread, desc.m_Count);
+		const uint32_t last = std::min(first + perThread, desc.m_Count);
+		workers.emplace_back(GenerateRange, std::cref(desc), lights.data(), first, last);
+	}
+	GenerateRange(desc, lights.data(), 0, std::min(perThread, desc.m_Count));
+
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+uint64_t LightSets::Hash(const std::vector<LightDesc>& lights)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(lights.data());
+	for (size_t i = 0; i < lights.size() * sizeof(LightDesc); ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+bool LightSets::IsValid(const LightDesc& light)
+{
+	// Written so that NaN fails every test
+	bool bValid = light.m_Type <= 2 && light.m_Radius > 0.0f && std::isfinite(light.m_Radius);
+	for (uint32_t axis = 0; axis < 3; ++axis)
+		bValid = bValid && std::isfinite(light.m_Position[axis]) && light.m_Color[axis] >= 0.0f && std::isfinite(light.m_Color[axis]);
+
+	const float lengthSq = light.m_ConeDir[0] * light.m_ConeDir[0] + light.m_ConeDir[1] * light.m_ConeDir[1] + light.m_ConeDir[2] * light.m_ConeDir[2];
+	return bValid && std::fabs(lengthSq - 1.0f) < 1e-3f &&
+		light.m_ConeInner >= 0.0f && light.m_ConeOuter >= light.m_ConeInner && light.m_ConeOuter < 0.5f * kPi;
+}
+
+void LightSets::Serialize(const std::vector<LightDesc>& lights, std::vector<uint8_t>& data)
+{
+	const uint32_t count = (uint32_t)lights.size();
+	data.resize(kHeaderSize + lights.size() * sizeof(LightDesc));
+
+	uint8_t* out = data.data();
+	std::memcpy(out, kLightSetMagic, sizeof(kLightSetMagic));
+	std::memcpy(out + sizeof(kLightSetMagic), &kLightSetVersion, sizeof(kLightSetVersion));
+	std::memcpy(out + sizeof(kLightSetMagic) + sizeof(uint32_t), &count, sizeof(count));
+	if (count > 0)
+		std::memcpy(out + kHeaderSize, lights.data(), lights.size() * sizeof(LightDesc));
+}
+
+bool LightSets::Deserialize(const uint8_t* data, size_t size, std::vector<LightDesc>& lights)
+{
+	lights.clear();
+	if (size < kHeaderSize || std::memcmp(data, kLightSetMagic, sizeof(kLightSetMagic)) != 0)
+		return false;
+
+	uint32_t version, count;
+	std::memcpy(&version, data + sizeof(kLightSetMagic), sizeof(version));
+	std::memcpy(&count, data + sizeof(kLightSetMagic) + sizeof(uint32_t), sizeof(count));
+	if (version != kLightSetVersion || size != kHeaderSize + (size_t)count * sizeof(LightDesc))
+		return false;
+
+	lights.resize(count);
+	if (count > 0)
+		std::memcpy(lights.data(), data + kHeaderSize, (size_t)count * sizeof(LightDesc));
+
+	for (const LightDesc& light : lights)
+	{
+		if (!IsValid(light))
+		{
+			lights.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+bool LightSets::Save(const std::wstring& fileName, const std::vector<LightDesc>& lights)
+{
+	std::vector<uint8_t> data;
+	Serialize(lights, data);
+
+	FILE* file = OpenFile(fileName, true);
+	if (!file)
+		return false;
+
+	const bool bSuccess = fwrite(data.data(), 1, data.size(), file) == data.size();
+	return fclose(file) == 0 && bSuccess;
+}
+
+bool LightSets::Load(const std::wstring& fileName, std::vector<LightDesc>& lights)
+{
+	lights.clear();
+	FILE* file = OpenFile(fileName, false);
+	if (!file)
+		return false;
+
+	std::vector<uint8_t> data;
+	uint8_t buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + read);
+	const bool bReadError = ferror(file) != 0;
+	fclose(file);
+
+	return !bReadError && Deserialize(data.data(), data.size(), lights);
+}
+
+//===============================================================================
+
+LightSets::BenchmarkResult LightSets::RunBenchmark(const BenchmarkDesc& desc)
+{
+	BenchmarkResult result;
+	result.m_bValid = CounterRNG::SelfTest();
+
+	GeneratorDesc generator;
+	generator.m_Seed = desc.m_Seed;
+	generator.m_Count = desc.m_Lights;
+	generator.m_MinBound[0] = -1800.0f; generator.m_MinBound[1] = -100.0f; generator.m_MinBound[2] = -1100.0f;
+	generator.m_MaxBound[0] = 1800.0f; generator.m_MaxBound[1] = 1400.0f; generator.m_MaxBound[2] = 1100.0f;
+
+	std::vector<LightDesc> serial, parallel;
+
+	generator.m_Threads = 1;
+	auto start = std::chrono::steady_clock::now();
+	Generate(generator, serial);
+	result.m_SerialMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	generator.m_Threads = desc.m_Threads != 0 ? desc.m_Threads : std::max(std::thread::hardware_concurrency(), 1u);
+	result.m_Threads = generator.m_Threads;
+	start = std::chrono::steady_clock::now();
+	Generate(generator, parallel);
+	result.m_ParallelMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	result.m_Hash = Hash(serial);
+	result.m_bValid = result.m_bValid && serial.size() == parallel.size() && result.m_Hash == Hash(parallel) &&
+		std::memcmp(serial.data(), parallel.data(), serial.size() * sizeof(LightDesc)) == 0;
+
+	// Everything within bounds and ranges, with unit cone directions
+	for (const LightDesc& light : serial)
+	{
+		bool bInRange = IsValid(light) && light.m_Radius >= 200.0f && light.m_Radius < 1000.0f;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+			bInRange = bInRange && light.m_Position[axis] >= generator.m_MinBound[axis] && light.m_Position[axis] <= generator.m_MaxBound[axis];
+		const float lengthSq = light.m_ConeDir[0] * light.m_ConeDir[0] + light.m_ConeDir[1] * light.m_ConeDir[1] + light.m_ConeDir[2] * light.m_ConeDir[2];
+		result.m_bValid = result.m_bValid && bInRange && std::fabs(lengthSq - 1.0f) < 1e-4f;
+	}
+
+	std::vector<uint8_t> data;
+	std::vector<LightDesc> reloaded;
+	Serialize(serial, data);
+	result.m_bValid = result.m_bValid && Deserialize(data.data(), data.size(), reloaded) && Hash(reloaded) == result.m_Hash;
+
+	// A file with a light Lighting can't use is turned away whole, rather than loaded up to that light
+	if (!serial.empty())
+	{
+		LightDesc badLight = serial[serial.size() / 2];
+		badLight.m_Type = 3;
+		std::memcpy(data.data() + kHeaderSize + (serial.size() / 2) * sizeof(LightDesc), &badLight, sizeof(LightDesc));
+		result.m_bValid = result.m_bValid && !Deserialize(data.data(), data.size(), reloaded) && reloaded.empty();
+	}
+
+	std::vector<LightDesc> reference;
+	Generate(GeneratorDesc(), reference);
+	result.m_bMatchesReference = Hash(reference) == kReferenceHash;
+	result.m_bValid = result.m_bValid && result.m_bMatchesReference;
+	return result;
+}
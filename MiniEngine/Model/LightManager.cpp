@@ -25,6 +25,33 @@
 #include "CompiledShaders/FillLightGridCS_24.h"
 #include "CompiledShaders/FillLightGridCS_32.h"
 
+//===============================================================================
+// desc: Forward+ lights, their shadows, and the grid that assigns them to screen tiles
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: The light grid can be built on the CPU, as screen tiles or as depth-sliced clusters, and is sized from the internal resolution
+   [AZB] 18/10/26: Random lights come from a seeded LightSets generator instead of srand/rand, and light sets can be saved and loaded
+   [AZB] 18/10/26: Lights are sorted by type before they're uploaded, since the shaders pick a light's type from where its index falls
+*/
+
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+#if AZB_MOD
+#include "AZB_LightClusters.h"
+#include "AZB_LightSets.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#endif
+
 using namespace Math;
 using namespace Graphics;
 
@@ -44,6 +71,17 @@ struct LightData
 
 enum { kMinLightGridDim = 8 };
 
+#if AZB_MOD
+// [AZB]: The grid buffers are made once, since Renderer copies their views into its descriptor table. Enough for 8 pixel tiles at 3840x2160
+static const uint32_t kLightGridCells = ((3840 + kMinLightGridDim - 1) / kMinLightGridDim) * ((2160 + kMinLightGridDim - 1) / kMinLightGridDim);
+
+// [AZB]: How the grid gets built. GPU tiles is the original compute shader, clusters are only built on the CPU
+enum { kGridGpuTiles, kGridCpuTiles, kGridCpuClusters, kGridModeCount };
+
+// [AZB]: WriteBuffer wants its source 16 byte aligned
+struct alignas(16) GridBlock { uint32_t m_Words[4]; };
+#endif
+
 namespace Lighting
 {
     IntVar LightGridDim("Application/Forward+/Light Grid Dim", 16, kMinLightGridDim, 32, 8 );
@@ -59,6 +97,27 @@ namespace Lighting
     ByteAddressBuffer m_LightGrid;
 
     ByteAddressBuffer m_LightGridBitMask;
+#if AZB_MOD
+    const char* LightGridModeLabels[kGridModeCount] = { "GPU Tiles", "CPU Tiles", "CPU Clusters" };
+    EnumVar LightGridMode("Application/Forward+/Light Grid Mode", kGridGpuTiles, kGridModeCount, LightGridModeLabels);
+    IntVar ClusterColumns("Application/Forward+/Cluster Columns", 16, 4, 64, 4);
+    IntVar ClusterSlices("Application/Forward+/Cluster Slices", 24, 1, LightClusters::kMaxSlices, 1);
+
+    // [AZB]: Below this internal height there are too few tiles to keep the GPU busy, so GPU tiles are built on the CPU instead
+    IntVar CpuGridBelowHeight("Application/Forward+/CPU Grid Below Height", 360, 0, 2160, 60);
+
+    LightClusters::GridDesc m_GridDesc;        // What FillLightGrid built last
+    std::unique_ptr<LightClusters::Builder> m_GridBuilder;
+    std::vector<GridBlock> m_CpuLightGrid;
+    std::vector<GridBlock> m_CpuLightGridBitMask;
+
+    void FillLightGridOnCpu(GraphicsContext& gfxContext, const Camera& camera);
+
+    // [AZB]: The set the lights were last made from, kept so it can be saved
+    std::vector<LightSets::LightDesc> m_LightSet;
+
+    void ApplyLightSet(void);
+#endif
     uint32_t m_FirstConeLight;
     uint32_t m_FirstConeShadowedLight;
 
@@ -98,7 +157,17 @@ void Lighting::InitializeResources( void )
     m_FillLightGridCS_32.Finalize();
 
     // Assumes max resolution of 3840x2160
+#if AZB_MOD
+    // [AZB]: FillLightGrid keeps whichever grid it builds within this, whatever the resolution
+    uint32_t lightGridCells = kLightGridCells;
+    static_assert(LightClusters::kMaxLights == MaxLights, "LightClusters must pack as many lights as the shaders expect");
+
+    m_GridBuilder.reset(new LightClusters::Builder());
+    m_CpuLightGrid.resize(Math::DivideByMultiple(lightGridCells * LightClusters::kCellStride, sizeof(GridBlock)));
+    m_CpuLightGridBitMask.resize(Math::DivideByMultiple(lightGridCells * LightClusters::kBitMaskStride, sizeof(GridBlock)));
+#else
     uint32_t lightGridCells = Math::DivideByMultiple(3840, kMinLightGridDim) * Math::DivideByMultiple(2160, kMinLightGridDim);
+#endif
     uint32_t lightGridSizeBytes = lightGridCells * (4 + MaxLights * 4);
     m_LightGrid.Create(L"m_LightGrid", lightGridSizeBytes, 1);
 
@@ -111,6 +180,117 @@ void Lighting::InitializeResources( void )
     m_LightBuffer.Create(L"m_LightBuffer", MaxLights, sizeof(LightData));
 }
 
+#if AZB_MOD
+void Lighting::CreateRandomLights( const Vector3 minBound, const Vector3 maxBound )
+{
+    // [AZB]: Each light draws from its own seeded stream rather than from srand/rand, so every platform gets the same lights
+    LightSets::GeneratorDesc desc;
+    desc.m_Count = MaxLights;
+    desc.m_MinBound[0] = minBound.GetX(); desc.m_MinBound[1] = minBound.GetY(); desc.m_MinBound[2] = minBound.GetZ();
+    desc.m_MaxBound[0] = maxBound.GetX(); desc.m_MaxBound[1] = maxBound.GetY(); desc.m_MaxBound[2] = maxBound.GetZ();
+
+    LightSets::Generate(desc, m_LightSet);
+    ApplyLightSet();
+}
+
+bool Lighting::LoadLightSet(const std::wstring& fileName)
+{
+    std::vector<LightSets::LightDesc> lightSet;
+    if (!LightSets::Load(fileName, lightSet))
+        return false;
+
+    m_LightSet.swap(lightSet);
+    ApplyLightSet();
+    return true;
+}
+
+bool Lighting::SaveLightSet(const std::wstring& fileName)
+{
+    return LightSets::Save(fileName, m_LightSet);
+}
+
+// [AZB]: Turns the first MaxLights of m_LightSet into LightData and shadow matrices, as CreateRandomLights always did. Slots a smaller set
+//        leaves empty get a dark point light with no radius
+void Lighting::ApplyLightSet(void)
+{
+    // [AZB]: The shaders treat everything before m_FirstConeLight as a point and everything from m_FirstConeShadowedLight on as a shadowed
+    //        cone, so the lights have to be grouped by type. The sort is stable so a set that's already grouped, like every generated one,
+    //        keeps its order. m_LightSet itself is left as it was made or loaded, so SaveLightSet writes it back unchanged
+    const uint32_t lightCount = (uint32_t)std::min<size_t>(m_LightSet.size(), MaxLights);
+    std::vector<LightSets::LightDesc> sortedLights(m_LightSet.begin(), m_LightSet.begin() + lightCount);
+    std::stable_sort(sortedLights.begin(), sortedLights.end(),
+        [](const LightSets::LightDesc& a, const LightSets::LightDesc& b) { return a.m_Type < b.m_Type; });
+
+    for (uint32_t n = 0; n < MaxLights; n++)
+    {
+        LightSets::LightDesc light = {};
+        float lightRadius = 1.0f;
+        if (n < lightCount)
+        {
+            ASSERT(LightSets::IsValid(sortedLights[n]));
+            light = sortedLights[n];
+            lightRadius = light.m_Radius;
+        }
+        else
+        {
+            // [AZB]: The shadow camera still needs a frustum for an empty slot, though nothing is ever drawn with it
+            light.m_ConeDir[1] = -1.0f;
+            light.m_ConeOuter = 0.25f;
+        }
+
+        Vector3 pos(light.m_Position[0], light.m_Position[1], light.m_Position[2]);
+        Vector3 coneDir(light.m_ConeDir[0], light.m_ConeDir[1], light.m_ConeDir[2]);
+        float coneInner = light.m_ConeInner;
+        float coneOuter = light.m_ConeOuter;
+
+        Math::Camera shadowCamera;
+        shadowCamera.SetEyeAtUp(pos, pos + coneDir, Vector3(0, 1, 0));
+        shadowCamera.SetPerspectiveMatrix(coneOuter * 2, 1.0f, lightRadius * .05f, lightRadius * 1.0f);
+        shadowCamera.Update();
+        m_LightShadowMatrix[n] = shadowCamera.GetViewProjMatrix();
+        Matrix4 shadowTextureMatrix = Matrix4(AffineTransform(Matrix3::MakeScale( 0.5f, -0.5f, 1.0f ), Vector3(0.5f, 0.5f, 0.0f))) * m_LightShadowMatrix[n];
+
+        m_LightData[n].pos[0] = light.m_Position[0];
+        m_LightData[n].pos[1] = light.m_Position[1];
+        m_LightData[n].pos[2] = light.m_Position[2];
+        m_LightData[n].radiusSq = light.m_Radius * light.m_Radius;
+        m_LightData[n].color[0] = light.m_Color[0];
+        m_LightData[n].color[1] = light.m_Color[1];
+        m_LightData[n].color[2] = light.m_Color[2];
+        m_LightData[n].type = light.m_Type;
+        m_LightData[n].coneDir[0] = coneDir.GetX();
+        m_LightData[n].coneDir[1] = coneDir.GetY();
+        m_LightData[n].coneDir[2] = coneDir.GetZ();
+        m_LightData[n].coneAngles[0] = 1.0f / (cosf(coneInner) - cosf(coneOuter));
+        m_LightData[n].coneAngles[1] = cosf(coneOuter);
+        std::memcpy(m_LightData[n].shadowTextureMatrix, &shadowTextureMatrix, sizeof(shadowTextureMatrix));
+    }
+
+    // [AZB]: A set might have no cones of either kind. With no unshadowed cones the first shadowed one starts the cones too, so it isn't
+    //        read as an unshadowed one. Only the set's own lights are searched; the empty slots after them have no radius or colour, so
+    //        nothing is ever lit by them whichever way they're read
+    m_FirstConeLight = MaxLights;
+    m_FirstConeShadowedLight = MaxLights;
+    for (uint32_t n = 0; n < lightCount; n++)
+    {
+        if (m_LightData[n].type >= 1)
+        {
+            m_FirstConeLight = n;
+            break;
+        }
+    }
+    for (uint32_t n = 0; n < lightCount; n++)
+    {
+        if (m_LightData[n].type == 2)
+        {
+            m_FirstConeShadowedLight = n;
+            break;
+        }
+    }
+
+    CommandContext::InitializeBuffer(m_LightBuffer, m_LightData, MaxLights * sizeof(LightData));
+}
+#else
 void Lighting::CreateRandomLights( const Vector3 minBound, const Vector3 maxBound )
 {
     Vector3 posScale = maxBound - minBound;
@@ -257,6 +437,7 @@ void Lighting::CreateRandomLights( const Vector3 minBound, const Vector3 maxBoun
 
     CommandContext::InitializeBuffer(m_LightBuffer, m_LightData, MaxLights * sizeof(LightData));
 }
+#endif
 
 void Lighting::Shutdown(void)
 {
@@ -265,17 +446,71 @@ void Lighting::Shutdown(void)
     m_LightGridBitMask.Destroy();
     m_LightShadowArray.Destroy();
     m_LightShadowTempBuffer.Destroy();
+#if AZB_MOD
+    m_GridBuilder.reset();
+    m_CpuLightGrid = std::vector<GridBlock>();
+    m_CpuLightGridBitMask = std::vector<GridBlock>();
+    m_LightSet = std::vector<LightSets::LightDesc>();
+#endif
 }
 
 void Lighting::FillLightGrid(GraphicsContext& gfxContext, const Camera& camera)
 {
     ScopedTimer _prof(L"FillLightGrid", gfxContext);
 
+#if AZB_MOD
+    // [AZB]: Size the grid from the internal resolution DLSS is rendering at, rather than assuming one
+    const uint32_t internalWidth = g_SceneColorBuffer.GetWidth();
+    const uint32_t internalHeight = g_SceneColorBuffer.GetHeight();
+    const float projScaleX = camera.GetProjMatrix().GetX().GetX();
+    const float projScaleY = camera.GetProjMatrix().GetY().GetY();
+
+    int32_t gridMode = LightGridMode;
+    if (gridMode == kGridGpuTiles && internalHeight < (uint32_t)(int32_t)CpuGridBelowHeight)
+        gridMode = kGridCpuTiles;
+
+    if (gridMode == kGridCpuClusters)
+    {
+        m_GridDesc = LightClusters::MakeClusterGrid(internalWidth, internalHeight, ClusterColumns, ClusterSlices, camera.GetNearClip(), camera.GetFarClip(),
+            projScaleX, projScaleY);
+
+        // [AZB]: Give up depth slices before overrunning the buffers
+        const uint32_t tiles = m_GridDesc.m_TilesX * m_GridDesc.m_TilesY;
+        if (m_GridDesc.GetCellCount() > kLightGridCells)
+        {
+            m_GridDesc = LightClusters::MakeClusterGrid(internalWidth, internalHeight, ClusterColumns, std::max(1u, kLightGridCells / tiles), camera.GetNearClip(),
+                camera.GetFarClip(), projScaleX, projScaleY);
+        }
+    }
+    else
+    {
+        // [AZB]: Past 4K internal, step up to the next tile size that fits
+        uint32_t tileDim = LightGridDim;
+        m_GridDesc = LightClusters::MakeTileGrid(internalWidth, internalHeight, tileDim, projScaleX, projScaleY);
+        while (m_GridDesc.GetCellCount() > kLightGridCells && tileDim < 32)
+        {
+            tileDim += 8;
+            m_GridDesc = LightClusters::MakeTileGrid(internalWidth, internalHeight, tileDim, projScaleX, projScaleY);
+        }
+    }
+    ASSERT(m_GridDesc.GetCellCount() <= kLightGridCells, "Light grid doesn't fit its buffers");
+
+    if (gridMode != kGridGpuTiles)
+    {
+        FillLightGridOnCpu(gfxContext, camera);
+        return;
+    }
+#endif
+
     ComputeContext& Context = gfxContext.GetComputeContext();
 
     Context.SetRootSignature(m_FillLightRootSig);
 
+#if AZB_MOD
+    switch ((int)m_GridDesc.m_TileWidth)
+#else
     switch ((int)LightGridDim)
+#endif
     {
     case  8: Context.SetPipelineState(m_FillLightGridCS_8 ); break;
     case 16: Context.SetPipelineState(m_FillLightGridCS_16); break;
@@ -298,9 +533,14 @@ void Lighting::FillLightGrid(GraphicsContext& gfxContext, const Camera& camera)
     Context.SetDynamicDescriptor(2, 0, m_LightGrid.GetUAV());
     Context.SetDynamicDescriptor(2, 1, m_LightGridBitMask.GetUAV());
 
+#if AZB_MOD
+    uint32_t tileCountX = m_GridDesc.m_TilesX;
+    uint32_t tileCountY = m_GridDesc.m_TilesY;
+#else
     // todo: assumes 1920x1080 resolution
     uint32_t tileCountX = Math::DivideByMultiple(g_SceneColorBuffer.GetWidth(), LightGridDim);
     uint32_t tileCountY = Math::DivideByMultiple(g_SceneColorBuffer.GetHeight(), LightGridDim);
+#endif
 
     float FarClipDist = camera.GetFarClip();
     float NearClipDist = camera.GetNearClip();
@@ -317,7 +557,11 @@ void Lighting::FillLightGrid(GraphicsContext& gfxContext, const Camera& camera)
     // todo: assumes 1920x1080 resolution
     csConstants.ViewportWidth = g_SceneColorBuffer.GetWidth();
     csConstants.ViewportHeight = g_SceneColorBuffer.GetHeight();
+#if AZB_MOD
+    csConstants.InvTileDim = 1.0f / m_GridDesc.m_TileWidth;
+#else
     csConstants.InvTileDim = 1.0f / LightGridDim;
+#endif
     csConstants.RcpZMagic = RcpZMagic;
     csConstants.TileCount = tileCountX;
     csConstants.ViewProjMatrix = camera.GetViewProjMatrix();
@@ -329,3 +573,43 @@ void Lighting::FillLightGrid(GraphicsContext& gfxContext, const Camera& camera)
     Context.TransitionResource(m_LightGrid, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
     Context.TransitionResource(m_LightGridBitMask, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 }
+
+#if AZB_MOD
+// [AZB]: Builds the grid on the CPU and uploads it in the same layout FillLightGridCS leaves. There's no depth buffer to bound each tile with
+//        here, so a tile lists every light along its whole length unless it's cut into depth slices
+void Lighting::FillLightGridOnCpu(GraphicsContext& gfxContext, const Camera& camera)
+{
+    LightClusters::Light lights[MaxLights];
+    const Matrix4& viewMatrix = camera.GetViewMatrix();
+    for (uint32_t n = 0; n < MaxLights; n++)
+    {
+        Vector4 viewPos = viewMatrix * Vector3(m_LightData[n].pos[0], m_LightData[n].pos[1], m_LightData[n].pos[2]);
+        lights[n].m_ViewPos[0] = viewPos.GetX();
+        lights[n].m_ViewPos[1] = viewPos.GetY();
+        lights[n].m_ViewPos[2] = viewPos.GetZ();
+        lights[n].m_Radius = sqrtf(m_LightData[n].radiusSq);
+        lights[n].m_Type = m_LightData[n].type;
+    }
+
+    m_GridBuilder->Build(m_GridDesc, lights, MaxLights, m_CpuLightGrid.data(), m_CpuLightGridBitMask.data());
+
+    gfxContext.WriteBuffer(m_LightGrid, 0, m_CpuLightGrid.data(), m_GridDesc.GetGridSize());
+    gfxContext.WriteBuffer(m_LightGridBitMask, 0, m_CpuLightGridBitMask.data(), m_GridDesc.GetBitMaskSize());
+
+    gfxContext.TransitionResource(m_LightBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    gfxContext.TransitionResource(m_LightGrid, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    gfxContext.TransitionResource(m_LightGridBitMask, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+}
+
+void Lighting::GetLightGridConstants(float invTileDim[4], uint32_t tileCount[4])
+{
+    invTileDim[0] = 1.0f / m_GridDesc.m_TileWidth;
+    invTileDim[1] = 1.0f / m_GridDesc.m_TileHeight;
+    invTileDim[2] = m_GridDesc.m_SliceScale;
+    invTileDim[3] = m_GridDesc.m_SliceBias;
+    tileCount[0] = m_GridDesc.m_TilesX;
+    tileCount[1] = m_GridDesc.m_TilesY;
+    tileCount[2] = m_GridDesc.m_Slices;
+    tileCount[3] = 0;
+}
+#endif
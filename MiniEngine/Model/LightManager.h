@@ -13,9 +13,29 @@
 //
 
 #pragma once
+//===============================================================================
+// desc: Forward+ lights, their shadows, and the grid that assigns them to screen tiles
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: The light grid can be built on the CPU, as screen tiles or as depth-sliced clusters, and is sized from the internal resolution
+   [AZB] 18/10/26: Light sets can be saved and loaded, so a run can be repeated on exactly the same lights
+*/
 
 #include <cstdint>
 
+//
+// [AZB]: Custom includes
+//
+
+// [AZB]: Container file for code modifications and other helper tools. Contains the global "AZB_MOD" macro.
+#include "AZB_Utils.h"
+#if AZB_MOD
+#include <string>
+#endif
+
 class StructuredBuffer;
 class ByteAddressBuffer;
 class ColorBuffer;
@@ -51,4 +71,16 @@ namespace Lighting
     void CreateRandomLights(const Math::Vector3 minBound, const Math::Vector3 maxBound);
     void FillLightGrid(GraphicsContext& gfxContext, const Math::Camera& camera);
     void Shutdown(void);
+
+#if AZB_MOD
+    // [AZB]: The InvTileDim and TileCount pixel shader constants for the grid FillLightGrid last built. InvTileDim.xy take pixels to tiles and .zw
+    //        scale and bias log2 of view depth to a depth slice, while TileCount holds columns, rows and slices
+    void GetLightGridConstants(float invTileDim[4], std::uint32_t tileCount[4]);
+
+    // [AZB]: Replace the lights with a set written by SaveLightSet or LightSets::Save. Only the first MaxLights are used, and fewer leave the
+    //        rest dark. They're grouped by type as they're uploaded, so a set in any order works. SaveLightSet writes whichever set the
+    //        lights were last made from, in its own order
+    bool LoadLightSet(const std::wstring& fileName);
+    bool SaveLightSet(const std::wstring& fileName);
+#endif
 }
@@ -14,12 +14,23 @@
 #include "Model.h"
 #include "Renderer.h"
 #include "ConstantBuffers.h"
+#if AZB_MOD
+#include "AZB_DLSS.h"
+#include "AZB_TLSF.h"
+#include "AZB_ShadowCascades.h"
+#endif
 
 using namespace Math;
 using namespace Renderer;
 
 void Model::Destroy()
 {
+#if AZB_MOD
+    // [AZB]: Close off this model's entries in the allocation trace
+    for (uint32_t id : m_AllocationTraceIds)
+        TLSF::TraceFree(id);
+    m_AllocationTraceIds.clear();
+#endif
     m_BoundingSphere = BoundingSphere(kZero);
     m_DataBuffer.Destroy();
     m_MaterialConstants.Destroy();
@@ -41,10 +52,26 @@ void Model::Render(
     const Frustum& frustum = sorter.GetViewFrustum();
     const AffineTransform& viewMat = (const AffineTransform&)sorter.GetViewMatrix();
 
+#if AZB_MOD
+    // [AZB]: Only the main view decides which texture mips get streamed in - shadow maps don't sample material textures. The viewport is at
+    //        the internal resolution, and the samplers' DLSS LOD bias is applied on top, so the estimate matches what the GPU will actually fetch
+    const bool bRequestMips = sorter.GetBatchType() == MeshSorter::kDefault && !m_MaterialTextures.empty();
+    const float pixelsPerUnit = bRequestMips ? (float)sorter.GetProjMatrix().GetY().GetY() * sorter.GetViewport().Height * 0.5f : 0.f;
+#endif
+
     for (uint32_t i = 0; i < m_NumMeshes; ++i)
     {
         const Mesh& mesh = *(const Mesh*)pMesh;
 
+#if AZB_MOD
+        // [AZB]: Already culled with the rest of the casters in one pass, if the sorter was given masks
+        if (!sorter.IsNextCasterWanted())
+        {
+            pMesh += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
+            continue;
+        }
+#endif
+
         const AffineTransform& sphereXform = sphereTransforms[mesh.meshCBV];
         Scalar scaleXSqr = LengthSquare((Vector3)sphereXform.GetX());
         Scalar scaleYSqr = LengthSquare((Vector3)sphereXform.GetY());
@@ -64,6 +91,23 @@ void Model::Render(
                 meshConstants.GetGpuVirtualAddress() + sizeof(MeshConstants) * mesh.meshCBV,
                 m_MaterialConstants.GetGpuVirtualAddress() + sizeof(MaterialConstants) * mesh.materialCBV,
                 m_DataBuffer.GetGpuVirtualAddress(), skeleton);
+
+#if AZB_MOD
+            if (bRequestMips)
+            {
+                // Diameter on screen in pixels. With the camera inside the bounds everything is wanted at full detail
+                const float depth = -(float)sphereVS.GetCenter().GetZ();
+                const float radius = (float)sphereVS.GetRadius();
+                const float screenPixels = depth > radius ? 2.f * radius * pixelsPerUnit / depth : FLT_MAX;
+
+                const uint16_t* materialTextures = &m_MaterialTextures[mesh.materialCBV * kNumTextures];
+                for (uint32_t j = 0; j < kNumTextures; ++j)
+                {
+                    if (materialTextures[j] != 0xffff)
+                        textures[materialTextures[j]].RequestStreaming(screenPixels, DLSS::m_LodBias);
+                }
+            }
+#endif
         }
 
         pMesh += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
@@ -80,6 +124,40 @@ void ModelInstance::Render(MeshSorter& sorter) const
     }
 }
 
+#if AZB_MOD
+void Model::GatherCasterBounds(const AffineTransform sphereTransforms[], ShadowCascades::CasterBounds& bounds,
+    const uint32_t nodeVersions[], uint32_t skinVersion, std::vector<uint32_t>* versions) const
+{
+    const uint8_t* pMesh = m_MeshData.get();
+
+    for (uint32_t i = 0; i < m_NumMeshes; ++i)
+    {
+        const Mesh& mesh = *(const Mesh*)pMesh;
+
+        const AffineTransform& sphereXform = sphereTransforms[mesh.meshCBV];
+        Scalar scaleXSqr = LengthSquare((Vector3)sphereXform.GetX());
+        Scalar scaleYSqr = LengthSquare((Vector3)sphereXform.GetY());
+        Scalar scaleZSqr = LengthSquare((Vector3)sphereXform.GetZ());
+        Scalar sphereScale = Sqrt(Max(Max(scaleXSqr, scaleYSqr), scaleZSqr));
+
+        BoundingSphere sphereLS((const XMFLOAT4*)mesh.bounds);
+        Vector3 centerWS = sphereXform * sphereLS.GetCenter();
+        bounds.Add(centerWS.GetX(), centerWS.GetY(), centerWS.GetZ(), sphereScale * sphereLS.GetRadius());
+
+        if (versions != nullptr)
+            versions->push_back(nodeVersions[mesh.meshCBV] + (mesh.numJoints > 0 ? skinVersion : 0));
+
+        pMesh += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
+    }
+}
+
+void ModelInstance::GatherCasterBounds(ShadowCascades::CasterBounds& bounds, std::vector<uint32_t>* versions) const
+{
+    if (m_Model != nullptr)
+        m_Model->GatherCasterBounds(m_BoundingSphereTransforms.get(), bounds, m_TransformVersions.get(), m_SkinVersion, versions);
+}
+#endif
+
 ModelInstance::ModelInstance( std::shared_ptr<const Model> sourceModel )
     : m_Model(sourceModel), m_Locator(kIdentity)
 {
@@ -89,6 +167,9 @@ ModelInstance::ModelInstance( std::shared_ptr<const Model> sourceModel )
         m_MeshConstantsCPU.Destroy();
         m_MeshConstantsGPU.Destroy();
         m_BoundingSphereTransforms = nullptr;
+#if AZB_MOD
+        m_TransformVersions = nullptr;
+#endif
         m_AnimGraph = nullptr;
         m_AnimState.clear();
         m_Skeleton = nullptr;
@@ -100,6 +181,10 @@ ModelInstance::ModelInstance( std::shared_ptr<const Model> sourceModel )
 
         m_BoundingSphereTransforms.reset(new AffineTransform[sourceModel->m_NumNodes]);
         m_Skeleton.reset(new Joint[sourceModel->m_NumJoints]);
+#if AZB_MOD
+        m_TransformVersions.reset(new uint32_t[sourceModel->m_NumNodes]());
+        m_SkinVersion = 0;
+#endif
 
         if (sourceModel->m_NumAnimations > 0)
         {
@@ -129,6 +214,9 @@ ModelInstance& ModelInstance::operator=( std::shared_ptr<const Model> sourceMode
         m_MeshConstantsCPU.Destroy();
         m_MeshConstantsGPU.Destroy();
         m_BoundingSphereTransforms = nullptr;
+#if AZB_MOD
+        m_TransformVersions = nullptr;
+#endif
         m_AnimGraph = nullptr;
         m_AnimState.clear();
         m_Skeleton = nullptr;
@@ -140,6 +228,10 @@ ModelInstance& ModelInstance::operator=( std::shared_ptr<const Model> sourceMode
 
         m_BoundingSphereTransforms.reset(new AffineTransform[sourceModel->m_NumNodes]);
         m_Skeleton.reset(new Joint[sourceModel->m_NumJoints]);
+#if AZB_MOD
+        m_TransformVersions.reset(new uint32_t[sourceModel->m_NumNodes]());
+        m_SkinVersion = 0;
+#endif
 
         if (sourceModel->m_NumAnimations > 0)
         {
@@ -188,6 +280,10 @@ void ModelInstance::Update(GraphicsContext& gfxContext, float deltaTime)
 
     const GraphNode* sceneGraph = m_AnimGraph ? m_AnimGraph.get() : m_Model->m_SceneGraph.get();
 
+#if AZB_MOD
+    bool bTransformChanged = false;
+#endif
+
     // Traverse the scene graph in depth first order.  This is the same as linear order
     // for how the nodes are stored in memory.  Uses a matrix stack instead of recursion.
     for (const GraphNode* Node = sceneGraph; ; ++Node)
@@ -204,11 +300,26 @@ void ModelInstance::Update(GraphicsContext& gfxContext, float deltaTime)
             cbv.World = xform;
             cbv.WorldIT = InverseTranspose(xform.Get3x3());
 
+#if AZB_MOD
+            // [AZB]: Only a transform that's different from last frame's counts as a change, so a static model's shadow can stay cached
+            AffineTransform sphereXform(
+                (Vector3)xform.GetX(),
+                (Vector3)xform.GetY(),
+                (Vector3)xform.GetZ(),
+                (Vector3)xform.GetW());
+            if (std::memcmp(&m_BoundingSphereTransforms[Node->matrixIdx], &sphereXform, sizeof(AffineTransform)) != 0)
+            {
+                ++m_TransformVersions[Node->matrixIdx];
+                bTransformChanged = true;
+            }
+            m_BoundingSphereTransforms[Node->matrixIdx] = sphereXform;
+#else
             m_BoundingSphereTransforms[Node->matrixIdx] = AffineTransform(
                 (Vector3)xform.GetX(),
                 (Vector3)xform.GetY(),
                 (Vector3)xform.GetZ(),
                 (Vector3)xform.GetW());
+#endif
        }
 
         // If the next node will be a descendent, replace the parent matrix with our new matrix
@@ -233,6 +344,12 @@ void ModelInstance::Update(GraphicsContext& gfxContext, float deltaTime)
         }
     }
 
+#if AZB_MOD
+    // [AZB]: Joints are built from the node transforms, so if none of those moved the skeleton hasn't either
+    if (bTransformChanged && m_Model->m_NumJoints > 0)
+        ++m_SkinVersion;
+#endif
+
     // Update skeletal joints
     for (uint32_t i = 0; i < m_Model->m_NumJoints; ++i)
     {
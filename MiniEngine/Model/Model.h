@@ -29,6 +29,13 @@ namespace Renderer
     class MeshSorter;
 }
 
+#if AZB_MOD
+namespace ShadowCascades
+{
+    struct CasterBounds;
+}
+#endif
+
 //
 // To request a PSO index, provide flags that describe the kind of PSO
 // you need.  If one has not yet been created, it will be created.
@@ -126,6 +133,19 @@ public:
     std::unique_ptr<uint16_t[]> m_JointIndices;
     std::unique_ptr<Math::Matrix4[]> m_JointIBMs;
 
+#if AZB_MOD
+    // [AZB]: Index into textures for each of a material's kNumTextures slots (0xffff where it uses a default), so streaming knows what each mesh samples
+    std::vector<uint16_t> m_MaterialTextures;
+
+    // [AZB]: Ids of this model's buffers in the TLSF allocation trace, if one was being recorded when it loaded. Freed along with the model
+    std::vector<uint32_t> m_AllocationTraceIds;
+
+    // [AZB]: Appends each mesh's world space bounding sphere, worked out the same way Render() does, for culling shadow casters per cascade.
+    //        With versions, also appends a number for each mesh that changes whenever its node's transform, or for a skinned mesh the skeleton, does
+    void GatherCasterBounds(const Math::AffineTransform sphereTransforms[], ShadowCascades::CasterBounds& bounds,
+        const uint32_t nodeVersions[] = nullptr, uint32_t skinVersion = 0, std::vector<uint32_t>* versions = nullptr) const;
+#endif
+
 protected:
     void Destroy();
 };
@@ -167,6 +187,9 @@ public:
     Math::UniformTransform& GetTransfrom() { return m_Locator; }
     ByteAddressBuffer& GetGPUMeshConstants() { return m_MeshConstantsGPU; }
 
+    // [AZB]: Valid once Update() has placed the meshes. versions is for ShadowCache, to tell which casters have changed since the last frame
+    void GatherCasterBounds(ShadowCascades::CasterBounds& bounds, std::vector<uint32_t>* versions = nullptr) const;
+
 #endif
 
 private:
@@ -176,6 +199,12 @@ private:
     std::unique_ptr<Math::AffineTransform[]> m_BoundingSphereTransforms;
     Math::UniformTransform m_Locator;
 
+#if AZB_MOD
+    // [AZB]: Bumped by Update() whenever a node's transform actually changes, and whenever any joint's does for the skeleton as a whole
+    std::unique_ptr<uint32_t[]> m_TransformVersions;
+    uint32_t m_SkinVersion = 0;
+#endif
+
     std::unique_ptr<GraphNode[]> m_AnimGraph;   // A copy of the scene graph when instancing animation
     std::vector<AnimationState> m_AnimState;    // Per-animation (not per-curve)
     std::unique_ptr<Joint[]> m_Skeleton;
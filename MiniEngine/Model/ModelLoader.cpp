@@ -38,6 +38,7 @@ using namespace Graphics;
 #if AZB_MOD
 #include "AZB_BistroRenderer.h"
 #include "AZB_DLSS.h"
+#include "AZB_TLSF.h"
 #endif
 
 //#if AZB_MOD
@@ -89,12 +90,27 @@ void LoadMaterials(Model& model,
         CompileTextureOnDemand(originalFile, textureOptions[ti]);
 
         std::wstring ddsFile = Utility::RemoveExtension(originalFile) + L".dds";
+#if AZB_MOD
+        // [AZB]: Queue every texture before waiting on any of them, so the loader can overlap their reads, parsing and uploads. Only the
+        //        coarse mips come in now - Model::Render asks for the rest as the meshes using them come into view
+        model.textures[ti] = TextureManager::LoadDDSFromFileStreamed(ddsFile);
+#else
         model.textures[ti] = TextureManager::LoadDDSFromFile(ddsFile);
+#endif
     }
 
+#if AZB_MOD
+    // [AZB]: The SRVs are copied into the material tables below, so everything has to have landed first
+    for (const TextureRef& texture : model.textures)
+        texture.WaitForLoad();
+#endif
+
     // Generate descriptor tables and record offsets for each material
     const uint32_t numMaterials = (uint32_t)materialTextures.size();
     std::vector<uint32_t> tableOffsets(numMaterials);
+#if AZB_MOD
+    model.m_MaterialTextures.assign(numMaterials * kNumTextures, 0xffff);
+#endif
 
     for (uint32_t matIdx = 0; matIdx < numMaterials; ++matIdx)
     {
@@ -126,6 +142,18 @@ void LoadMaterials(Model& model,
         g_Device->CopyDescriptors(1, &TextureHandles, &DestCount,
             DestCount, SourceTextures, SourceCounts, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
+#if AZB_MOD
+        // [AZB]: Streaming swaps the resource behind these SRVs, so it needs to know where the copies went
+        for (uint32_t j = 0; j < kNumTextures; ++j)
+        {
+            if (srcMat.stringIdx[j] == 0xffff)
+                continue;
+
+            model.m_MaterialTextures[matIdx * kNumTextures + j] = srcMat.stringIdx[j];
+            model.textures[srcMat.stringIdx[j]].TrackDescriptorCopy(TextureHandles + j * Renderer::s_TextureHeap.GetDescriptorSize());
+        }
+#endif
+
         // See if this combination of samplers has been used before.  If not, allocate more from the heap
         // and copy in the descriptors.
         uint32_t addressModes = srcMat.addressModes;
@@ -195,9 +223,22 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
 
     bool needBuild = forceRebuild;
 
+#if AZB_MOD
+    // [AZB]: Same rules as textures - the conversion cache decides when it knows the source, file times when it doesn't. Only the glTF/H3D
+    //        file itself is hashed, so edits to a .bin it references alone still need -rebuild 1
+    ConversionCache::Key miniKey;
+    ConversionCache::eStatus miniStatus = ConversionCache::STATUS_UNKNOWN;
+    if (!sourceFileMissing)
+        miniStatus = GetConversionCache().Check(filePath, miniFileName, 0, CURRENT_MINI_FILE_VERSION, miniKey);
+
+    if (miniFileMissing || miniStatus == ConversionCache::STATUS_STALE ||
+        miniStatus == ConversionCache::STATUS_UNKNOWN && !sourceFileMissing && sourceFileStat.st_mtime > miniFileStat.st_mtime)
+        needBuild = true;
+#else
     // Check if .mini file exists and it is newer than source file
     if (miniFileMissing || !sourceFileMissing && sourceFileStat.st_mtime > miniFileStat.st_mtime)
         needBuild = true;
+#endif
 
     // Check if it's an older version of .mini
     if (!needBuild)
@@ -250,6 +291,12 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
         inFile.read((char*)&header, sizeof(FileHeader));
     }
 
+#if AZB_MOD
+    // [AZB]: Rebuilt or adopted as it is, either way the .mini on disk is now the one to keep
+    if (!sourceFileMissing && (needBuild || miniStatus != ConversionCache::STATUS_UP_TO_DATE) && inFile)
+        GetConversionCache().Record(filePath, miniFileName, miniKey);
+#endif
+
     if (!inFile)
         return nullptr;
 
@@ -276,6 +323,26 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
     inFile.read((char*)model->m_SceneGraph.get(), header.numNodes * sizeof(GraphNode));
     inFile.read((char*)model->m_MeshData.get(), header.meshDataSize);
 
+#if AZB_MOD
+    // [AZB]: Record the buffers this model would need if each mesh's geometry were sub-allocated on its own, rather than packed into m_DataBuffer.
+    //        TLSF::RunBenchmark replays these to compare allocators on real load patterns
+    if (TLSF::IsTracing())
+    {
+        const uint8_t* pMesh = model->m_MeshData.get();
+        for (uint32_t i = 0; i < header.numMeshes; ++i)
+        {
+            const Mesh& mesh = *(const Mesh*)pMesh;
+            model->m_AllocationTraceIds.push_back(TLSF::TraceAllocate(mesh.vbSize, 16));
+            if (mesh.vbDepthSize > 0)
+                model->m_AllocationTraceIds.push_back(TLSF::TraceAllocate(mesh.vbDepthSize, 16));
+            model->m_AllocationTraceIds.push_back(TLSF::TraceAllocate(mesh.ibSize, 4));
+            pMesh += sizeof(Mesh) + (mesh.numDraws - 1) * sizeof(Mesh::Draw);
+        }
+        if (header.numMaterials > 0)
+            model->m_AllocationTraceIds.push_back(TLSF::TraceAllocate(header.numMaterials * sizeof(MaterialConstants), 256));
+    }
+#endif
+
 	if (header.numMaterials > 0)
 	{
 		UploadBuffer materialConstants;
@@ -313,6 +380,11 @@ std::shared_ptr<Model> Renderer::LoadModel(const std::wstring& filePath, bool fo
 
     LoadMaterials(*model, materialTextures, textureNames, textureOptions, basePath);
 
+#if AZB_MOD
+    // [AZB]: Every texture this model uses has been checked by now, so save what was learned in case we don't exit cleanly
+    FlushConversionCache();
+#endif
+
     model->m_BoundingSphere = BoundingSphere(*(XMFLOAT4*)header.boundingSphere);
     model->m_BoundingBox = AxisAlignedBox(Vector3(*(XMFLOAT3*)header.minPos), Vector3(*(XMFLOAT3*)header.maxPos));
 
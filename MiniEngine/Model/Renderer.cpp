@@ -593,6 +593,10 @@ void MeshSorter::AddMesh( const Mesh& mesh, float distance,
 
 void MeshSorter::Sort()
 {
+#if AZB_MOD
+    // [AZB]: Every mask should have been read, or the meshes rendered weren't the ones the masks were made for
+    ASSERT(m_CasterMasks == nullptr || m_NextCaster == m_CasterMaskCount, "Fewer meshes were rendered than the caster masks were made for");
+#endif
     struct { bool operator()(uint64_t a, uint64_t b) const { return a < b; } } Cmp;
     std::sort(m_SortKeys.begin(), m_SortKeys.end(), Cmp);
 }
@@ -624,7 +628,15 @@ void MeshSorter::RenderMeshes(
 	if (m_BatchType == kShadows)
 	{
 		context.TransitionResource(*m_DSV, D3D12_RESOURCE_STATE_DEPTH_WRITE, true);
+#if AZB_MOD
+		// [AZB]: Everything outside the dirty region is kept from the last time the map was drawn
+		if (m_bDirtyRegion)
+			context.ClearDepth(*m_DSV, m_DirtyRect);
+		else
+			context.ClearDepth(*m_DSV);
+#else
 		context.ClearDepth(*m_DSV);
+#endif
 		context.SetDepthStencilTarget(m_DSV->GetDSV());
 
 		if (m_Viewport.Width == 0)
@@ -641,6 +653,16 @@ void MeshSorter::RenderMeshes(
 			m_Scissor.top = 1;
 			m_Scissor.bottom = m_DSV->GetHeight() - 2;
 		}
+
+#if AZB_MOD
+		if (m_bDirtyRegion)
+		{
+			m_Scissor.left = std::max(m_Scissor.left, m_DirtyRect.left);
+			m_Scissor.right = std::min(m_Scissor.right, m_DirtyRect.right);
+			m_Scissor.top = std::max(m_Scissor.top, m_DirtyRect.top);
+			m_Scissor.bottom = std::min(m_Scissor.bottom, m_DirtyRect.bottom);
+		}
+#endif
 	}
 	else
 	{
@@ -780,7 +802,15 @@ void MeshSorter::RenderMeshes(DrawPass pass, GraphicsContext& context, GlobalCon
     if (m_BatchType == kShadows)
     {
         context.TransitionResource(*m_DSV, D3D12_RESOURCE_STATE_DEPTH_WRITE, true);
+#if AZB_MOD
+        // [AZB]: Everything outside the dirty region is kept from the last time the map was drawn
+        if (m_bDirtyRegion)
+            context.ClearDepth(*m_DSV, m_DirtyRect);
+        else
+            context.ClearDepth(*m_DSV);
+#else
         context.ClearDepth(*m_DSV);
+#endif
         context.SetDepthStencilTarget(m_DSV->GetDSV());
 
         if (m_Viewport.Width == 0)
@@ -797,6 +827,16 @@ void MeshSorter::RenderMeshes(DrawPass pass, GraphicsContext& context, GlobalCon
             m_Scissor.top = 1;
             m_Scissor.bottom = m_DSV->GetHeight() - 2;
         }
+
+#if AZB_MOD
+        if (m_bDirtyRegion)
+        {
+            m_Scissor.left = std::max(m_Scissor.left, m_DirtyRect.left);
+            m_Scissor.right = std::min(m_Scissor.right, m_DirtyRect.right);
+            m_Scissor.top = std::max(m_Scissor.top, m_DirtyRect.top);
+            m_Scissor.bottom = std::min(m_Scissor.bottom, m_DirtyRect.bottom);
+        }
+#endif
     }
     else
     {
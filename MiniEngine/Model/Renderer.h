@@ -103,6 +103,14 @@ namespace Renderer
 			std::memset(m_PassCounts, 0, sizeof(m_PassCounts));
 			m_CurrentPass = kZPass;
 			m_CurrentDraw = 0;
+#if AZB_MOD
+			m_bDirtyRegion = false;
+			m_DirtyRect = {};
+			m_CasterMasks = nullptr;
+			m_CasterMaskCount = 0;
+			m_CasterMaskBit = 0;
+			m_NextCaster = 0;
+#endif
 		}
 
 		void SetCamera( const BaseCamera& camera ) { m_Camera = &camera; }
@@ -116,8 +124,49 @@ namespace Renderer
 		void SetDepthStencilTarget( DepthBuffer& DSV ) { m_DSV = &DSV; }
 
         const Frustum& GetWorldFrustum() const { return m_Camera->GetWorldSpaceFrustum(); }
+#if AZB_MOD
+        const Frustum& GetViewFrustum() const { return m_bDirtyRegion ? m_DirtyFrustum : m_Camera->GetViewSpaceFrustum(); }
+#else
         const Frustum& GetViewFrustum() const { return m_Camera->GetViewSpaceFrustum(); }
+#endif
         const Matrix4& GetViewMatrix() const { return m_Camera->GetViewMatrix(); }
+#if AZB_MOD
+        // [AZB]: Enough to work out how big a mesh is on screen, for texture streaming
+        BatchType GetBatchType() const { return m_BatchType; }
+        const Matrix4& GetProjMatrix() const { return m_Camera->GetProjMatrix(); }
+        const D3D12_VIEWPORT& GetViewport() const { return m_Viewport; }
+
+        // [AZB]: For a kShadows sorter redrawing part of a cached shadow map. Only rect is cleared and drawn to, and meshes are culled against
+        //        cullFrustum, in the camera's view space and covering rect, instead of the camera's own. Set before rendering anything into the sorter
+        void SetDirtyRegion( const D3D12_RECT& rect, const Frustum& cullFrustum )
+        {
+            m_bDirtyRegion = true;
+            m_DirtyRect = rect;
+            m_DirtyFrustum = cullFrustum;
+        }
+
+        // [AZB]: One byte per mesh, in the order ModelInstance::GatherCasterBounds lists them. Meshes without bit set are skipped before
+        //        they're tested against the frustum. Set before rendering anything into the sorter, and keep masks alive until Sort()
+        void SetCasterMasks( const uint8_t* masks, uint32_t count, uint8_t bit )
+        {
+            m_CasterMasks = masks;
+            m_CasterMaskCount = count;
+            m_CasterMaskBit = bit;
+            m_NextCaster = 0;
+        }
+
+        // [AZB]: Model::Render asks once per mesh, in mesh order
+        bool IsNextCasterWanted()
+        {
+            if (m_CasterMasks == nullptr)
+                return true;
+
+            ASSERT(m_NextCaster < m_CasterMaskCount, "More meshes were rendered than the caster masks were made for");
+            if (m_NextCaster >= m_CasterMaskCount)
+                return true;
+            return (m_CasterMasks[m_NextCaster++] & m_CasterMaskBit) != 0;
+        }
+#endif
 
         void AddMesh( const Mesh& mesh, float distance,
             D3D12_GPU_VIRTUAL_ADDRESS meshCBV,
@@ -171,6 +220,15 @@ namespace Renderer
 		uint32_t m_NumRTVs;
 		ColorBuffer* m_RTV[8];
 		DepthBuffer* m_DSV;
+#if AZB_MOD
+		bool m_bDirtyRegion;
+		D3D12_RECT m_DirtyRect;
+		Frustum m_DirtyFrustum;
+		const uint8_t* m_CasterMasks;
+		uint32_t m_CasterMaskCount;
+		uint8_t m_CasterMaskBit;
+		uint32_t m_NextCaster;
+#endif
 	};
 
 } // namespace Renderer
\ No newline at end of file
@@ -41,3 +41,13 @@ uint GetTileOffset(uint tileIndex)
 {
     return tileIndex * TILE_SIZE;
 }
+
+// [AZB]: Cells of a clustered grid follow on from each other a depth slice at a time, so with one slice this is GetTileIndex().
+// sliceScaleBias takes log2 of view depth to a slice, and tileCount holds columns, rows and slices
+uint GetClusterIndex(uint2 tilePos, float viewDepth, float2 sliceScaleBias, uint3 tileCount)
+{
+    uint slice = 0;
+    if (tileCount.z > 1)
+        slice = (uint)clamp(floor(log2(viewDepth) * sliceScaleBias.x + sliceScaleBias.y), 0.0, float(tileCount.z - 1));
+    return (slice * tileCount.y + tilePos.y) * tileCount.x + tilePos.x;
+}
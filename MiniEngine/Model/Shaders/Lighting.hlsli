@@ -319,11 +319,14 @@ void ShadeLights(inout float3 colorSum, uint2 pixelPos,
 	float gloss,
 	float3 normal,
 	float3 viewDir,
-	float3 worldPos
+	float3 worldPos,
+	float viewDepth		// [AZB]: Picks the depth slice when the light grid is clustered
 	)
 {
     uint2 tilePos = GetTilePos(pixelPos, InvTileDim.xy);
-    uint tileIndex = GetTileIndex(tilePos, TileCount.x);
+    // [AZB]: Original 2D lookup
+    //uint tileIndex = GetTileIndex(tilePos, TileCount.x);
+    uint tileIndex = GetClusterIndex(tilePos, viewDepth, InvTileDim.zw, TileCount.xyz);
     uint tileOffset = GetTileOffset(tileIndex);
 
     // Light Grid Preloading setup
@@ -76,7 +76,8 @@ MRT main(VSOutput vsOutput)
 		gloss,
 		normal,
 		viewDir,
-		vsOutput.worldPos
+		vsOutput.worldPos,
+		vsOutput.position.w		// [AZB]: Clip space w, which is view depth
 		);
 
 	mrt.Normal = normal;
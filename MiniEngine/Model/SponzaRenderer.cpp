@@ -36,6 +36,16 @@
 #include "CompiledShaders/ModelViewerVS.h"
 #include "CompiledShaders/ModelViewerPS.h"
 
+//===============================================================================
+// desc: Renders Sponza with the ModelViewer shaders and Forward+ lights
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
+/*
+   Change Log:
+   [AZB] 18/10/26: Light grid constants come from whichever grid Lighting::FillLightGrid built, rather than assuming LightGridDim tiles
+*/
+
 using namespace Math;
 using namespace Graphics;
 
@@ -329,6 +339,10 @@ void Sponza::RenderScene(
     if (!skipDiffusePass)
     {
         Lighting::FillLightGrid(gfxContext, camera);
+#if AZB_MOD
+        // [AZB]: The grid's shape is only settled once it's been built
+        Lighting::GetLightGridConstants(psConstants.InvTileDim, psConstants.TileCount);
+#endif
 
         if (!SSAO::DebugDraw)
         {
@@ -14,14 +14,96 @@
 // This code depends on DirectXTex
 //
 
+//===============================================================================
+// desc: Block compression goes through a multithreaded encoder of my own, normal maps get BC5, and the two encoders can be benchmarked side by side.
+//       Whether a DDS needs rebuilding is decided by a content-hashed conversion cache rather than file times
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+
 #include "TextureConvert.h"
 #include "../Core/Utility.h"
 #include "DirectXTex.h"
 
+#if AZB_MOD
+#include "AZB_BCEncoder.h"
+
+#include <chrono>
+#include <cmath>
+#endif
+
+/*
+   Change Log:
+
+   [AZB] 18/10/26: BC1/BC3/BC5/BC7 are encoded with BCEncoder rather than DirectXTex, and kNormalMap with kDefaultBC now means BC5
+   [AZB] 18/10/26: Added BenchmarkBlockCompression() to compare the two encoders on a source image
+   [AZB] 18/10/26: CompileTextureOnDemand checks the conversion cache, so touched sources aren't rebuilt and changed flags are
+*/
+
 using namespace DirectX;
 
 #define GetFlag(f) ((Flags & f) != 0)
 
+#if AZB_MOD
+namespace
+{
+    // [AZB]: The BCEncoder format for a DXGI block format, if it's one BCEncoder does. BC6H stays with DirectXTex
+    bool GetEncoderFormat(DXGI_FORMAT format, BCEncoder::eFormat& encoderFormat)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            encoderFormat = BCEncoder::FORMAT_BC1;
+            return true;
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            encoderFormat = BCEncoder::FORMAT_BC3;
+            return true;
+        case DXGI_FORMAT_BC4_UNORM:
+            encoderFormat = BCEncoder::FORMAT_BC4;
+            return true;
+        case DXGI_FORMAT_BC5_UNORM:
+            encoderFormat = BCEncoder::FORMAT_BC5;
+            return true;
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            encoderFormat = BCEncoder::FORMAT_BC7;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool IsRGBA8(DXGI_FORMAT format)
+    {
+        return format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    }
+
+    // [AZB]: Compresses every image in source - each mip, array slice and depth slice - into result, which takes source's layout in cformat.
+    //        Each image is spread across every core by the encoder itself
+    HRESULT EncodeBlocks(const ScratchImage& source, DXGI_FORMAT cformat, const BCEncoder::EncodeDesc& desc, ScratchImage& result)
+    {
+        TexMetadata metadata = source.GetMetadata();
+        metadata.format = cformat;
+
+        HRESULT hr = result.Initialize(metadata);
+        if (FAILED(hr))
+            return hr;
+
+        // Both use the same image order, since only the format differs
+        const Image* sourceImages = source.GetImages();
+        const Image* resultImages = result.GetImages();
+        for (size_t i = 0; i < source.GetImageCount(); ++i)
+        {
+            BCEncoder::EncodeImage(sourceImages[i].pixels, sourceImages[i].rowPitch, (uint32_t)sourceImages[i].width, (uint32_t)sourceImages[i].height,
+                desc, resultImages[i].pixels, resultImages[i].rowPitch);
+        }
+
+        return S_OK;
+    }
+}
+#endif
+
 void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
 {
     std::wstring ddsFile = Utility::RemoveExtension(originalFile) + L".dds";
@@ -37,14 +119,81 @@ void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags)
         return;
     }
 
+#if AZB_MOD
+    // [AZB]: Nothing to convert from, or the source already is the DDS
+    if (srcFileMissing || Utility::ToLower(originalFile) == Utility::ToLower(ddsFile))
+        return;
+
+    // [AZB]: Rebuild when the cache says something the DDS depends on has changed. Sources it hasn't seen fall back on the old time check, and
+    //        a DDS that passes that is adopted as it is rather than rebuilt
+    ConversionCache::Key key;
+    ConversionCache::eStatus status = GetConversionCache().Check(originalFile, ddsFile, flags, kTextureConverterVersion, key);
+    if (status == ConversionCache::STATUS_UP_TO_DATE)
+        return;
+
+    if (status == ConversionCache::STATUS_STALE || ddsFileMissing || ddsFileStat.st_mtime < srcFileStat.st_mtime)
+    {
+        Utility::Printf("DDS texture %ws missing or out of date.  Rebuilding.\n", Utility::RemoveBasePath(originalFile).c_str());
+        if (!ConvertToDDS(originalFile, flags))
+            return;
+    }
+
+    GetConversionCache().Record(originalFile, ddsFile, key);
+#else
     // If we can find the source texture and the DDS file is older, reconvert.
     if (ddsFileMissing || !srcFileMissing && ddsFileStat.st_mtime < srcFileStat.st_mtime)
     {
         Utility::Printf("DDS texture %ws missing or older than source.  Rebuilding.\n", Utility::RemoveBasePath(originalFile).c_str());
         ConvertToDDS(originalFile, flags);
     }
+#endif
+}
+
+#if AZB_MOD
+namespace
+{
+    const wchar_t* kConversionCacheFile = L"ConversionCache.bin";
+
+    // [AZB]: Loads the cache on construction and saves anything outstanding on the way out
+    struct ConversionCacheHolder
+    {
+        ConversionCacheHolder()
+        {
+            m_Cache.Load(kConversionCacheFile);
+        }
+
+        ~ConversionCacheHolder()
+        {
+            if (m_Cache.IsDirty())
+                m_Cache.Save(kConversionCacheFile);
+        }
+
+        ConversionCache::Cache m_Cache;
+    };
+}
+
+ConversionCache::Cache& GetConversionCache(void)
+{
+    // [AZB]: Function-local, so it's loaded by whoever needs it first and only then
+    static ConversionCacheHolder s_Holder;
+    return s_Holder.m_Cache;
 }
 
+void FlushConversionCache(void)
+{
+    ConversionCache::Cache& cache = GetConversionCache();
+    if (!cache.IsDirty())
+        return;
+
+    ConversionCache::Stats stats = cache.GetStats();
+    Utility::Printf("Conversion cache: %u up to date, %u stale, %u unrecorded, %u sources hashed (%.1f MB)\n", stats.m_UpToDate, stats.m_Stale,
+        stats.m_Unknown, stats.m_FilesHashed, stats.m_BytesHashed / (1024.0 * 1024.0));
+
+    if (!cache.Save(kConversionCacheFile))
+        Utility::Printf("Could not write the conversion cache to \"%ws\".\n", kConversionCacheFile);
+}
+#endif
+
 bool ConvertToDDS( const std::wstring& filePath, uint32_t Flags )
 {
     bool bInterpretAsSRGB =	GetFlag(kSRGB);
@@ -168,6 +317,12 @@ bool ConvertToDDS( const std::wstring& filePath, uint32_t Flags )
     else if (bBlockCompress)
     {
         tformat = bInterpretAsSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+#if AZB_MOD
+        // [AZB]: Normals only need X and Y, and two BC4 channels keep far more of them than BC1 or BC7 spread over three. Whatever samples it has to rebuild Z
+        if (bContainsNormals)
+            cformat = DXGI_FORMAT_BC5_UNORM;
+        else
+#endif
         if (bUseBestBC)
             cformat = bInterpretAsSRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
         else if (bPreserveAlpha)
@@ -243,7 +398,24 @@ bool ConvertToDDS( const std::wstring& filePath, uint32_t Flags )
         {
             std::unique_ptr<ScratchImage> timage(new ScratchImage);
 
+#if AZB_MOD
+            // [AZB]: Anything BCEncoder can take goes to it - fast preset for kDefaultBC, quality for kQualityBC. Colour error is weighted by
+            //        luminance for sRGB textures only, so normals and masks are fit channel for channel
+            HRESULT hr;
+            BCEncoder::EncodeDesc encodeDesc;
+            if (IsRGBA8(image->GetMetadata().format) && GetEncoderFormat(cformat, encodeDesc.m_Format))
+            {
+                encodeDesc.m_Quality = bUseBestBC ? BCEncoder::QUALITY_HIGH : BCEncoder::QUALITY_FAST;
+                encodeDesc.m_bPerceptual = bInterpretAsSRGB && !bContainsNormals;
+                hr = EncodeBlocks(*image, cformat, encodeDesc, *timage);
+            }
+            else
+            {
+                hr = Compress( image->GetImages(), image->GetImageCount(), image->GetMetadata(), cformat, TEX_COMPRESS_DEFAULT, 0.5f, *timage );
+            }
+#else
             HRESULT hr = Compress( image->GetImages(), image->GetImageCount(), image->GetMetadata(), cformat, TEX_COMPRESS_DEFAULT, 0.5f, *timage );
+#endif
             if (FAILED(hr))
             {
                 Utility::Printf( "Failing compressing \"%ws\" (WIC: %08X).\n", filePath.c_str(), hr );
@@ -268,3 +440,119 @@ bool ConvertToDDS( const std::wstring& filePath, uint32_t Flags )
 
     return true;
 }
+
+#if AZB_MOD
+namespace
+{
+    // [AZB]: PSNR of a compressed image against the original over its first channelCount channels. Infinite when they match exactly
+    double BlockPSNR(const Image& original, const Image& compressed, uint32_t channelCount)
+    {
+        ScratchImage decoded;
+        if (FAILED(Decompress(compressed, original.format, decoded)))
+            return 0.0;
+
+        float mse = 0.f;
+        float channelMSE[4] = {};
+        if (FAILED(ComputeMSE(original, *decoded.GetImage(0, 0, 0), mse, channelMSE)))
+            return 0.0;
+
+        double total = 0.0;
+        for (uint32_t c = 0; c < channelCount; ++c)
+            total += channelMSE[c];
+        total /= channelCount;
+
+        return total > 0.0 ? 10.0 * std::log10(1.0 / total) : INFINITY;
+    }
+}
+
+void BenchmarkBlockCompression(const std::wstring& filePath)
+{
+    std::wstring ext = Utility::ToLower(Utility::GetFileExtension(filePath));
+
+    TexMetadata info;
+    ScratchImage image;
+    HRESULT hr;
+    if (ext == L"dds")
+        hr = LoadFromDDSFile(filePath.c_str(), DDS_FLAGS_NONE, &info, image);
+    else if (ext == L"tga")
+        hr = LoadFromTGAFile(filePath.c_str(), &info, image);
+    else
+        hr = LoadFromWICFile(filePath.c_str(), WIC_FLAGS_NONE, &info, image);
+
+    if (FAILED(hr))
+    {
+        Utility::Printf("Could not load \"%ws\" to benchmark (%08X).\n", filePath.c_str(), hr);
+        return;
+    }
+
+    // Only the top mip, in the same RGBA8 ConvertToDDS hands the compressor
+    ScratchImage source;
+    if (IsRGBA8(info.format))
+        hr = source.InitializeFromImage(*image.GetImage(0, 0, 0));
+    else
+        hr = Convert(*image.GetImage(0, 0, 0), DXGI_FORMAT_R8G8B8A8_UNORM, TEX_FILTER_DEFAULT, 0.5f, source);
+
+    if (FAILED(hr))
+    {
+        Utility::Printf("Could not convert \"%ws\" to RGBA8 (%08X).\n", filePath.c_str(), hr);
+        return;
+    }
+
+    const Image& original = *source.GetImage(0, 0, 0);
+    const double megapixels = (double)original.width * original.height / 1e6;
+    Utility::Printf("Block compression benchmark: \"%ws\" (%Iux%Iu)\n", filePath.c_str(), original.width, original.height);
+
+    struct Case
+    {
+        DXGI_FORMAT m_Format;
+        const char* m_Name;
+        uint32_t m_Channels;    // Compared for PSNR - BC1 ignores alpha and BC5 only has two
+    };
+    const Case cases[] =
+    {
+        { DXGI_FORMAT_BC1_UNORM, "BC1", 3 },
+        { DXGI_FORMAT_BC3_UNORM, "BC3", 4 },
+        { DXGI_FORMAT_BC5_UNORM, "BC5", 2 },
+        { DXGI_FORMAT_BC7_UNORM, "BC7", 4 },
+    };
+
+    for (const Case& test : cases)
+    {
+        // The existing DirectXTex path first, with the settings ConvertToDDS used
+        ScratchImage reference;
+        auto start = std::chrono::high_resolution_clock::now();
+        hr = Compress(original, test.m_Format, TEX_COMPRESS_DEFAULT, 0.5f, reference);
+        double referenceMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (FAILED(hr))
+        {
+            Utility::Printf("  %s: DirectXTex failed (%08X)\n", test.m_Name, hr);
+            continue;
+        }
+
+        Utility::Printf("  %s DirectXTex:  %9.1f ms %7.1f MPix/s %6.2f dB\n", test.m_Name, referenceMs, megapixels / (referenceMs / 1000.0),
+            BlockPSNR(original, *reference.GetImage(0, 0, 0), test.m_Channels));
+
+        for (uint32_t quality = BCEncoder::QUALITY_FAST; quality <= BCEncoder::QUALITY_HIGH; ++quality)
+        {
+            BCEncoder::EncodeDesc desc;
+            GetEncoderFormat(test.m_Format, desc.m_Format);
+            desc.m_Quality = (BCEncoder::eQuality)quality;
+
+            ScratchImage encoded;
+            start = std::chrono::high_resolution_clock::now();
+            hr = EncodeBlocks(source, test.m_Format, desc, encoded);
+            double encodeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            if (FAILED(hr))
+            {
+                Utility::Printf("  %s BCEncoder failed (%08X)\n", test.m_Name, hr);
+                continue;
+            }
+
+            Utility::Printf("  %s BCEncoder %s: %9.1f ms %7.1f MPix/s %6.2f dB\n", test.m_Name, quality == BCEncoder::QUALITY_HIGH ? "high" : "fast",
+                encodeMs, megapixels / (encodeMs / 1000.0), BlockPSNR(original, *encoded.GetImage(0, 0, 0), test.m_Channels));
+        }
+    }
+}
+#endif
@@ -16,11 +16,27 @@
 #include <cstdint>
 #include <string>
 
+//===============================================================================
+// desc: Block compression goes through a multithreaded encoder of my own, normal maps get BC5, and the two encoders can be benchmarked side by side.
+//       Whether a DDS needs rebuilding is decided by a content-hashed conversion cache rather than file times
+// modified: Aliyaan Zulfiqar
+//===============================================================================
+#include "AZB_Utils.h"
+#include "AZB_ConversionCache.h"
+
+/*
+   Change Log:
+
+   [AZB] 18/10/26: BC1/BC3/BC5/BC7 are encoded with BCEncoder rather than DirectXTex, and kNormalMap with kDefaultBC now means BC5
+   [AZB] 18/10/26: Added BenchmarkBlockCompression() to compare the two encoders on a source image
+   [AZB] 18/10/26: CompileTextureOnDemand checks the conversion cache, so touched sources aren't rebuilt and changed flags are
+*/
+
 enum TexConversionFlags
 {
     kSRGB = 1,          // Texture contains sRGB colors
     kPreserveAlpha = 2, // Keep four channels
-    kNormalMap = 4,     // Texture contains normals
+    kNormalMap = 4,     // Texture contains normals (BC5 when block compressed)
     kBumpToNormal = 8,  // Generate a normal map from a bump map
     kDefaultBC = 16,    // Apply standard block compression (BC1-5)
     kQualityBC = 32,    // Apply quality block compression (BC6H/7)
@@ -33,6 +49,7 @@ inline uint8_t TextureOptions(bool sRGB, bool hasAlpha=false, bool invertY=false
 }
 
 // If the DDS version of the texture specified does not exist or is older than the source texture, reconvert it.
+// [AZB]: Now if its source contents, flags or the converter have changed since it was built. Sources the cache hasn't seen yet still go by file times
 void CompileTextureOnDemand(const std::wstring& originalFile, uint32_t flags);
 
 // Loads a non-DDS texture such as TGA, PNG, or JPG, then converts it to a more optimal
@@ -42,3 +59,20 @@ bool ConvertToDDS(
     const std::wstring& filePath,	// UTF8-encoded path to source file
     uint32_t Flags                  // flags ORed together
 );
+
+#if AZB_MOD
+// [AZB]: Loads an image the same way ConvertToDDS does, then compresses its top mip with DirectXTex and with BCEncoder's presets and prints
+//        the time and PSNR of each. Writes nothing to disk
+void BenchmarkBlockCompression(const std::wstring& filePath);
+#endif
+
+#if AZB_MOD
+// [AZB]: Bump whenever ConvertToDDS would write something different for the same source and flags, so every DDS is rebuilt once
+constexpr uint32_t kTextureConverterVersion = 2;
+
+// [AZB]: Shared by texture and model conversion, and loaded from the working directory the first time it's asked for
+ConversionCache::Cache& GetConversionCache(void);
+
+// [AZB]: Writes the cache out if anything has been recorded since the last flush. It's also flushed at exit
+void FlushConversionCache(void);
+#endif
@@ -44,6 +44,38 @@
    Change Log:
    [AZB] 13/11/24: Added a check to apply post-processing to DLSS_OutputBuffer and not the main color buffer when DLSS enabled!
    [AZB] 25/01/25: Renamed file (and project) to reflect significance of changes made.
+   [AZB] 18/10/26: Added a scripted benchmark mode, launched with -benchmark <spec.json>
+   [AZB] 18/10/26: Added -loadbenchmark <count> to time the async texture loader against serial loading, headless
+   [AZB] 18/10/26: Texture streaming is updated once a frame, ahead of the scene being submitted
+   [AZB] 18/10/26: Added -bcbenchmark <image> to compare BCEncoder against DirectXTex compression, headless
+   [AZB] 18/10/26: Added -buddybenchmark <ops> to time the bitmap buddy allocator against the old free lists, headless
+   [AZB] 18/10/26: Added -alloctrace <file> to record model buffer allocations, and -tlsfbenchmark <trace> to replay them through TLSF and buddy allocators
+   [AZB] 18/10/26: Added -pagebenchmark <frames> to stress the lock-free linear allocator page recycling against a simulated fence, headless
+   [AZB] 18/10/26: Added -descriptorbenchmark <ops> to churn descriptors through the per-thread magazines against the old bump allocator, headless
+   [AZB] 18/10/26: Added -allocatorbenchmark <frames> to compare the fenced command allocator pool against the old mutex-guarded queue, headless
+   [AZB] 18/10/26: Added -clusterbenchmark <sets> to check and time the CPU light grid builder against a one light at a time reference, headless
+   [AZB] 18/10/26: Added -lightset <file> and -savelightset <file> to load or keep Sponza's lights, and -lightsetbenchmark <lights> to check the generator
+   [AZB] 18/10/26: Added -cascadestats <cascades> to count shadow casters per cascade in the scene, and -cascadebenchmark <views> to check and time the culling, headless
+   [AZB] 18/10/26: The sun shadow map is cached between frames and only redrawn where casters have changed, with a toggle under Viewer/Lighting,
+                   and -shadowcachebenchmark <frames> to check the dirty regions against full redraws, headless
+   [AZB] 18/10/26: Added -particlebenchmark <frames> to check and time the CPU particle backend against a one particle at a time reference, headless
+   [AZB] 18/10/26: Added -effectslotbenchmark <frames> to stress effect handles with threads spawning and expiring thousands a second, headless
+   [AZB] 18/10/26: Added -capturehdr <frames> to write the HDR input to post effects to disk, and -tonemapbenchmark <frames> to run the CPU tone mapping
+                   reference over it (or a synthetic scene) at two resolutions, with exposure adapted and replayed. -hdrcapturefile <file> names the capture
+   [AZB] 18/10/26: Added -recordexposure <file> to keep every frame's adapted exposure, -replayexposure <file> to play one back in place of adapting,
+                   and -exposurebenchmark <frames> to check the stream and replay over two simulated runs, headless
+   [AZB] 18/10/26: Added -capturedepth <frames> to write scene depth to disk for the CPU SSAO reference, and -ssaobenchmark <frames> to run it over the
+                   capture (or a synthetic room) at native and each upscaler's internal resolution. -depthcapturefile <file> names the capture
+   [AZB] 18/10/26: Added -capturepostfx <frames> to write what DoF and motion blur read to disk, and -postfxbenchmark <frames> to run the CPU
+                   references for both over it (or a synthetic courtyard) at native and each upscaler's internal resolution. -postfxcapturefile <file>
+                   names the capture
+   [AZB] 18/10/26: Added -benchmarkselftest 1 to drive the benchmark runner through a scripted frame source and check its phases and statistics, headless
+   [AZB] 18/10/26: The sun shadow pass skips casters that one SIMD pass over their bounding spheres puts outside the shadow camera's box
+   [AZB] 18/10/26: -tonemapbenchmark only loads a capture named with -tonemapcapture <file>, and says what it loaded. -tonemapupscaled <file> names a
+                   capture of the same path through DLSS to use as the second run, in place of resampling the first
+   [AZB] 18/10/26: -benchmarkselftest moved out to AZBTests, which runs the runner's self test without a device or a window
+   [AZB] 18/10/26: The headless module benchmarks moved out to AZBTests too, each run by name there (-loadbenchmark is "AZBTests load", and so on).
+                   The captures they can run over are still written from here
 
 */
 
@@ -60,6 +92,12 @@
 #include "AZB_DLSS.h"
 #include "AZB_MotionVectors.h"
 #include "AZB_BistroRenderer.h"     
+#include "AZB_Benchmark.h"
+#include "AZB_TLSF.h"
+#include "AZB_ShadowCascades.h"
+#include "AZB_ShadowCache.h"
+#include "LightManager.h"
+#include "AZB_GUI.h"            // The benchmark drives the pipeline through the same helpers as the GUI
 
 #include "TextureConvert.h"     // For converting HDRI PNGs to DDS
 #endif
@@ -81,6 +119,99 @@ using Renderer::MeshSorter;
 
 #pragma region Application Class Definition
 
+#if AZB_MOD
+// [AZB]: Drives the app on behalf of the benchmark runner. Every config change goes through the same RTUA_GUI helpers a user would trigger by clicking.
+class RTUABenchmarkSource : public Benchmark::FrameSource
+{
+public:
+    RTUABenchmarkSource(Camera& camera, std::array<ModelInstance, kNumScenes>& scenes, int& activeScene)
+        : m_Camera(camera), m_Scenes(scenes), m_ActiveScene(activeScene) {}
+
+    virtual bool SupportsConfig(const Benchmark::SweepConfig& config) override
+    {
+        if (config.m_Scene >= kNumScenes || m_Scenes[config.m_Scene].IsNull())
+            return false;
+        if (config.m_RenderingMode == RTUA_GUI::eRenderingMode::DLSS && !DLSS::m_bIsNGXSupported)
+            return false;
+        return config.m_RenderingMode < RTUA_GUI::eRenderingMode::NUM_RENDER_MODES;
+    }
+
+    virtual bool ApplyConfig(const Benchmark::SweepConfig& config) override
+    {
+        // Each step waits for the previous one to make it through UpdateGraphics(), otherwise they would trample each other's m_NewWidth/m_NewHeight
+        if (RTUA_GUI::IsPipelineChangePending())
+            return false;
+
+        switch (m_ApplyStep++)
+        {
+            case 0:
+            {
+                // Start every config from native so nothing carries over from the previous one
+                m_ActiveScene = (int)config.m_Scene;
+                RTUA_GUI::SetRenderingMode(RTUA_GUI::eRenderingMode::NATIVE);
+                RTUA_GUI::SetLodBiasOverride(false, 0.f);
+                return false;
+            }
+            case 1:
+            {
+                if (config.m_NativeResolution.m_Width != 0)
+                    RTUA_GUI::SetNativeResolution(config.m_NativeResolution);
+                return false;
+            }
+            case 2:
+            {
+                if (config.m_RenderingMode == RTUA_GUI::eRenderingMode::BILINEAR_UPSCALE)
+                {
+                    RTUA_GUI::SetBilinearInputResolution(config.m_InternalResolution);
+                }
+                else if (config.m_RenderingMode == RTUA_GUI::eRenderingMode::DLSS)
+                {
+                    // DLSS picks up the quality mode when it gets created, so set it before switching
+                    DLSS::m_CurrentQualityMode = config.m_DLSSMode;
+                }
+                RTUA_GUI::SetRenderingMode((RTUA_GUI::eRenderingMode)config.m_RenderingMode);
+                return false;
+            }
+            case 3:
+            {
+                if (config.m_bOverrideLodBias)
+                    RTUA_GUI::SetLodBiasOverride(true, config.m_LodBias);
+                return false;
+            }
+            default:
+            {
+                m_ApplyStep = 0;
+                return true;
+            }
+        }
+    }
+
+    virtual void PrepareFrame(const Benchmark::SweepConfig&, const Benchmark::CameraKey* camera) override
+    {
+        if (camera == nullptr)
+            return;
+
+        m_Camera.SetEyeAtUp(Vector3(camera->m_Eye[0], camera->m_Eye[1], camera->m_Eye[2]), Vector3(camera->m_At[0], camera->m_At[1], camera->m_At[2]), Vector3(kYUnitVector));
+        m_Camera.Update();
+    }
+
+    virtual Benchmark::FrameSample SampleLastFrame(void) override
+    {
+        Benchmark::FrameSample sample;
+        sample.m_CpuMs = EngineProfiling::GetLastCPUTime();
+        sample.m_GpuMs = EngineProfiling::GetLastGPUTime();
+        sample.m_FrameMs = EngineProfiling::GetLastFrameTime();
+        return sample;
+    }
+
+private:
+    Camera& m_Camera;
+    std::array<ModelInstance, kNumScenes>& m_Scenes;
+    int& m_ActiveScene;
+    uint32_t m_ApplyStep = 0;
+};
+#endif
+
 // [AZB]: RTUA - Real Time Upscaling Analyser
 class RTUA : public GameCore::IGameApp
 {
@@ -102,8 +233,17 @@ public:
 
     // [AZB]: New function that returns the currently loaded scene - needed to get a pointer to our GUI which then passes it off to the renderer to allow for sampler updating!
     virtual const Model* GetScene() override { return m_Scenes[activeScene].GetModel().get(); }
+
+    // [AZB]: Quit once a benchmark sweep has finished
+    virtual bool IsDone( void ) override;
 #endif
 private:
+#if AZB_MOD
+    // [AZB]: Prints how many casters each cascade of a cascaded shadow map would take from the current view, against the single shadow camera.
+    //        Nothing is rendered with the cascades yet, so this is what they would save rather than what they do
+    void ReportCascades( Vector3 LightDirection );
+#endif
+
     Camera m_Camera;
     unique_ptr<CameraController> m_CameraController;
 
@@ -115,6 +255,24 @@ private:
     std::array<ModelInstance, kNumScenes> m_Scenes;
     // [AZB]: Index into array, acting as a track on currently active scene to render
     int activeScene = 1;        // 0 for Bistro, 1 for Sponza. Bistro has improved significantly but it is still broken!
+
+    // [AZB]: Scripted benchmark sweep. Only created when launched with -benchmark <spec.json>
+    unique_ptr<Benchmark::Runner> m_BenchmarkRunner;
+    unique_ptr<RTUABenchmarkSource> m_BenchmarkSource;
+
+    // [AZB]: Where to write the allocation trace at shutdown, if -alloctrace was given
+    std::wstring m_AllocTraceFile;
+
+    // [AZB]: Cascades to report on at the next frame, if -cascadestats was given. Waits for a frame so the meshes have been placed
+    uint32_t m_ReportCascades = 0;
+
+    // [AZB]: The sun shadow map is kept between frames, and only redrawn where casters have changed or in full when the sun moves
+    ShadowCache::View m_SunShadowCache;
+    ShadowCascades::CasterBounds m_ShadowCasters;
+    std::vector<uint32_t> m_ShadowCasterVersions;
+    std::vector<uint8_t> m_ShadowCasterMasks;
+    int m_ShadowCacheScene = -1;
+    uint32_t m_ShadowCacheBufferID = 0;
 #else
     // [AZB]: Original singular instance
     ModelInstance m_ModelInst;
@@ -142,6 +300,10 @@ NumVar g_IBLBias("Viewer/Lighting/Gloss Reduction", 0.0f, 0.0f, 16.0f, 1.0f, Cha
 #else
 NumVar g_IBLBias("Viewer/Lighting/Gloss Reduction", 2.0f, 0.0f, 10.0f, 1.0f, ChangeIBLBias);
 #endif
+#if AZB_MOD
+// [AZB]: Off redraws the whole sun shadow map every frame, as it was before the cache
+BoolVar g_CacheSunShadow("Viewer/Lighting/Cache Sun Shadow", true);
+#endif
 void ChangeIBLSet(EngineVar::ActionType)
 {
     int setIdx = g_IBLSet - 1;
@@ -359,6 +521,74 @@ void RTUA::Startup( void )
     //[AZB]: Source code originally loaded models through command line. Going to go my own way on this as I want multiple scenes loaded!
 #if AZB_MOD
 
+    // [AZB]: Compare my block compressor against DirectXTex on one image, for both speed and PSNR
+    std::wstring bcBenchmarkFile;
+    if (CommandLineArgs::GetString(L"bcbenchmark", bcBenchmarkFile))
+        BenchmarkBlockCompression(bcBenchmarkFile);
+
+    uint32_t reportCascades;
+    if (CommandLineArgs::GetInteger(L"cascadestats", reportCascades))
+        m_ReportCascades = std::min(std::max(reportCascades, 1u), ShadowCascades::kMaxCascades);
+
+    // [AZB]: Capture the scene as post effects sees it, for the tone mapping reference to run over offline
+    std::wstring hdrCaptureFile = L"HDRCapture.hdrf";
+    CommandLineArgs::GetString(L"hdrcapturefile", hdrCaptureFile);
+
+    uint32_t hdrCaptureFrames;
+    if (CommandLineArgs::GetInteger(L"capturehdr", hdrCaptureFrames) && hdrCaptureFrames > 0)
+    {
+        PostEffects::BeginHDRCapture(hdrCaptureFile, hdrCaptureFrames);
+        Utility::Printf("HDR capture: writing the next %u frames to %ls\n", hdrCaptureFrames, hdrCaptureFile.c_str());
+    }
+
+    // [AZB]: Record this run's exposure, or play back another's, so runs with different upscalers are tone mapped alike
+    std::wstring exposureFile;
+    if (CommandLineArgs::GetString(L"recordexposure", exposureFile))
+    {
+        if (PostEffects::BeginExposureRecording(exposureFile))
+            Utility::Printf("Exposure recording: writing every frame to %ls\n", exposureFile.c_str());
+        else
+            Utility::Printf("Exposure recording: couldn't open %ls\n", exposureFile.c_str());
+    }
+    if (CommandLineArgs::GetString(L"replayexposure", exposureFile))
+    {
+        if (PostEffects::BeginExposureReplay(exposureFile))
+            Utility::Printf("Exposure replay: playing back %ls\n", exposureFile.c_str());
+        else
+            Utility::Printf("Exposure replay: failed to load %ls, adapting as normal\n", exposureFile.c_str());
+    }
+
+    // [AZB]: Capture scene depth as SSAO sees it, for the SSAO reference to run over offline
+    std::wstring depthCaptureFile = L"DepthCapture.dpth";
+    CommandLineArgs::GetString(L"depthcapturefile", depthCaptureFile);
+
+    uint32_t depthCaptureFrames;
+    if (CommandLineArgs::GetInteger(L"capturedepth", depthCaptureFrames) && depthCaptureFrames > 0)
+    {
+        SSAO::BeginDepthCapture(depthCaptureFile, depthCaptureFrames);
+        Utility::Printf("Depth capture: writing the next %u frames to %ls\n", depthCaptureFrames, depthCaptureFile.c_str());
+    }
+
+    // [AZB]: Capture what DoF and motion blur read, for their references to run over offline. Neither runs alongside DLSS, so this is the only
+    //        way to see what they'd do to the upscaled frame
+    std::wstring postFXCaptureFile = L"PostFXCapture.pfx";
+    CommandLineArgs::GetString(L"postfxcapturefile", postFXCaptureFile);
+
+    uint32_t postFXCaptureFrames;
+    if (CommandLineArgs::GetInteger(L"capturepostfx", postFXCaptureFrames) && postFXCaptureFrames > 0)
+    {
+        MotionBlur::BeginPostFXCapture(postFXCaptureFile, postFXCaptureFrames);
+        Utility::Printf("Post effects capture: writing the next %u frames to %ls\n", postFXCaptureFrames, postFXCaptureFile.c_str());
+    }
+
+    // [AZB]: Record model buffer allocations from here until shutdown
+    std::wstring allocTraceFile;
+    if (CommandLineArgs::GetString(L"alloctrace", allocTraceFile))
+    {
+        m_AllocTraceFile = allocTraceFile;
+        TLSF::StartTrace();
+    }
+
     // [AZB]: First, begin explicitly loading Bistro scene. Regardless of rendering mode, we want this model loaded
     // [AZB]: Load our lovely bistro model
     //m_Scenes[0] = Renderer::LoadModel(L"Bistro/BistroExterior/BistroExterior.gltf", forceRebuild);
@@ -370,6 +600,13 @@ void RTUA::Startup( void )
 
     // [AZB]: Get sponza started up
     Sponza::Startup(m_Camera);
+
+    // [AZB]: Swap in a saved light set, and/or keep the one we ended up with for a later run
+    std::wstring lightSetFile;
+    if (CommandLineArgs::GetString(L"lightset", lightSetFile) && !Lighting::LoadLightSet(lightSetFile))
+        Utility::Printf("Failed to load light set %ls, keeping the generated lights\n", lightSetFile.c_str());
+    if (CommandLineArgs::GetString(L"savelightset", lightSetFile) && !Lighting::SaveLightSet(lightSetFile))
+        Utility::Printf("Failed to save light set %ls\n", lightSetFile.c_str());
     // [AZB]: Now spin up bistro
     //Bistro::Startup(m_Camera, m_Scenes[0]);
 #else
@@ -392,6 +629,25 @@ void RTUA::Startup( void )
     m_Camera.SetZRange(1.0f, 10000.0f);
     m_CameraController.reset(new FlyingFPSCamera(m_Camera, Vector3(kYUnitVector)));
 
+    // [AZB]: Check if we've been asked to run a benchmark sweep instead of an interactive session
+    std::wstring benchmarkSpecFile;
+    if (CommandLineArgs::GetString(L"benchmark", benchmarkSpecFile))
+    {
+        Benchmark::SweepSpec spec;
+        std::string error;
+        if (Benchmark::LoadSweepSpec(benchmarkSpecFile, spec, error))
+        {
+            Utility::Printf("Running benchmark sweep with %u configs\n", (uint32_t)spec.m_Configs.size());
+            m_BenchmarkRunner.reset(new Benchmark::Runner(spec));
+            m_BenchmarkSource.reset(new RTUABenchmarkSource(m_Camera, m_Scenes, activeScene));
+            RTUA_GUI::m_bBenchmarkActive = true;
+        }
+        else
+        {
+            Utility::Printf("Failed to load benchmark spec: %s\n", error.c_str());
+        }
+    }
+
 #else
     // [AZB]: Original model loading
     if (CommandLineArgs::GetString(L"model", gltfFileName) == false)
@@ -441,8 +697,87 @@ void RTUA::Cleanup( void )
 #endif
 
     Renderer::Shutdown();
+
+#if AZB_MOD
+    // [AZB]: Models have all been released by now, so the trace has their frees too
+    if (!m_AllocTraceFile.empty() && !TLSF::StopTrace(m_AllocTraceFile))
+        Utility::Printf(L"Failed to write allocation trace %ws\n", m_AllocTraceFile.c_str());
+
+    const ShadowCache::Stats& shadowCacheStats = m_SunShadowCache.GetStats();
+    if (shadowCacheStats.m_Frames > 0)
+    {
+        Utility::Printf("Sun shadow cache: %llu frames, %llu full / %llu partial / %llu kept, %llu caster draws skipped (%.1f a frame)\n",
+            (unsigned long long)shadowCacheStats.m_Frames, (unsigned long long)shadowCacheStats.m_FullRedraws,
+            (unsigned long long)shadowCacheStats.m_PartialRedraws, (unsigned long long)shadowCacheStats.m_CachedFrames,
+            (unsigned long long)shadowCacheStats.m_CastersSkipped, (double)shadowCacheStats.m_CastersSkipped / (double)shadowCacheStats.m_Frames);
+    }
+#endif
+}
+
+#if AZB_MOD
+bool RTUA::IsDone( void )
+{
+    if (m_BenchmarkRunner && m_BenchmarkRunner->IsFinished())
+        return true;
+
+    return GameCore::IGameApp::IsDone();
 }
 
+void RTUA::ReportCascades( Vector3 LightDirection )
+{
+    ShadowCascades::CasterBounds casters;
+    m_Scenes[activeScene].GatherCasterBounds(casters);
+
+    const Vector3 position = m_Camera.GetPosition();
+    const Vector3 forward = m_Camera.GetForwardVec();
+    ShadowCascades::ViewDesc view;
+    view.m_Position[0] = position.GetX(); view.m_Position[1] = position.GetY(); view.m_Position[2] = position.GetZ();
+    view.m_Forward[0] = forward.GetX(); view.m_Forward[1] = forward.GetY(); view.m_Forward[2] = forward.GetZ();
+    view.m_TanHalfFovX = 1.0f / m_Camera.GetProjMatrix().GetX().GetX();
+    view.m_TanHalfFovY = 1.0f / m_Camera.GetProjMatrix().GetY().GetY();
+    view.m_Near = m_Camera.GetNearClip();
+    view.m_Far = m_Camera.GetFarClip();
+
+    // [AZB]: Reach back across the whole scene for casters
+    ShadowCascades::Settings settings;
+    settings.m_Cascades = m_ReportCascades;
+    settings.m_BufferSize = (uint32_t)g_ShadowBuffer.GetWidth();
+    settings.m_Extrusion = 2.0f * m_Scenes[activeScene].GetRadius();
+
+    // [AZB]: The single shadow camera as RenderScene sets it up, in the last slot
+    const float lightDirection[3] = { LightDirection.GetX(), LightDirection.GetY(), LightDirection.GetZ() };
+    const float fixedCenter[3] = { 0.0f, 0.0f, 0.0f };
+    const float fixedBounds[3] = { 5000.0f, 3000.0f, 3000.0f };
+    ShadowCascades::Cascade boxes[ShadowCascades::kMaxCascades + 1];
+    const uint32_t cascadeCount = ShadowCascades::FitCascades(view, lightDirection, settings, boxes);
+    boxes[cascadeCount] = ShadowCascades::MakeFixedCascade(lightDirection, fixedCenter, fixedBounds, settings.m_BufferSize, settings.m_BufferPrecision);
+
+    std::vector<uint8_t> masks;
+    uint32_t counts[ShadowCascades::kMaxCullBoxes];
+    ShadowCascades::CullCasters(casters, ShadowCascades::MakeLightBasis(lightDirection), boxes, cascadeCount + 1, masks);
+    ShadowCascades::CountCasters(masks, cascadeCount + 1, counts);
+
+    Utility::Printf("Shadow cascades: %u casters, the single shadow camera takes %u\n", casters.GetCount(), counts[cascadeCount]);
+    for (uint32_t c = 0; c < cascadeCount; ++c)
+    {
+        // [AZB]: Alongside what the cascade's own frustum planes would let through a MeshSorter, which are looser at the corners
+        ShadowCamera cascadeCamera;
+        cascadeCamera.UpdateCascade(LightDirection, boxes[c], (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), settings.m_BufferPrecision);
+        const Frustum& frustum = cascadeCamera.GetWorldSpaceFrustum();
+
+        uint32_t frustumCount = 0;
+        for (uint32_t i = 0; i < casters.GetCount(); ++i)
+        {
+            if (frustum.IntersectSphere(BoundingSphere(casters.m_X[i], casters.m_Y[i], casters.m_Z[i], casters.m_Radius[i])))
+                ++frustumCount;
+        }
+
+        Utility::Printf("  Cascade %u: %.0f to %.0f, %.0f across, %u casters (%u through its frustum planes)\n",
+            c, boxes[c].m_SplitNear, boxes[c].m_SplitFar, boxes[c].m_Bounds[0], counts[c], frustumCount);
+    }
+}
+#endif
+
 namespace Graphics
 {
     extern EnumVar DebugZoom;
@@ -457,7 +792,32 @@ void RTUA::Update( float deltaT )
     else if (GameInput::IsFirstPressed(GameInput::kRShoulder))
         DebugZoom.Increment();
 
+#if AZB_MOD
+    // [AZB]: The benchmark runner owns the camera and pipeline state while it's running
+    if (m_BenchmarkRunner)
+    {
+        m_BenchmarkRunner->Tick(*m_BenchmarkSource);
+        RTUA_GUI::m_BenchmarkStatus = m_BenchmarkRunner->GetStatus();
+
+        if (m_BenchmarkRunner->IsFinished() && RTUA_GUI::m_bBenchmarkActive)
+        {
+            const std::string& outputPath = m_BenchmarkRunner->GetSpec().m_OutputPath;
+            if (Benchmark::WriteResults(outputPath, m_BenchmarkRunner->GetResults()))
+                Utility::Printf("Benchmark results written to %s.json and %s.csv\n", outputPath.c_str(), outputPath.c_str());
+            else
+                Utility::Printf("Failed to write benchmark results to %s\n", outputPath.c_str());
+
+            RTUA_GUI::m_bBenchmarkActive = false;
+        }
+    }
+    else
+        m_CameraController->Update(deltaT);
+
+    // [AZB]: Swap in last frame's finished mips and queue the next lot, before any meshes are submitted this frame
+    TextureManager::UpdateStreaming();
+#else
     m_CameraController->Update(deltaT);
+#endif
 
     GraphicsContext& gfxContext = GraphicsContext::Begin(L"Scene Update");
 
@@ -540,6 +900,13 @@ void RTUA::RenderScene( void )
     m_SunShadowCamera.UpdateMatrix(-SunDirection, ShadowCenter, Vector3(5000, 3000, 3000),
         (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), 16);
 
+    // [AZB]: Meshes have been placed by now, so the -cascadestats report can go out
+    if (m_ReportCascades != 0)
+    {
+        ReportCascades(-SunDirection);
+        m_ReportCascades = 0;
+    }
+
     GlobalConstants globals;
     globals.ViewProjMatrix = m_Camera.GetViewProjMatrix();
     globals.SunShadowMatrix = m_SunShadowCamera.GetShadowMatrix();
@@ -582,14 +949,62 @@ void RTUA::RenderScene( void )
            //         https://github.com/microsoft/DirectX-Graphics-Samples/pull/891/commits/bec16cef860fee2a68a07b7c18551b942e1374a4 
            //        See this commit here that shows my implementation of it: https://github.com/AliyaanZBH/Real-Time-Upscaling-Analyser/pull/7/commits/5e971e3b648aa088ff9f1f83df6ca75cf64dee13
 
-           MeshSorter shadowSorter(MeshSorter::kShadows);
-           shadowSorter.SetCamera(m_SunShadowCamera);
-           shadowSorter.SetDepthStencilTarget(g_ShadowBuffer);
-           
-           m_Scenes[activeScene].Render(shadowSorter);
+           // [AZB]: Keep last frame's map wherever nothing in it has changed. Casters are matched to last frame's by mesh order, so a different
+           //        scene, or a recreated buffer, starts again from a full redraw
+           if (!g_CacheSunShadow || m_ShadowCacheScene != activeScene || m_ShadowCacheBufferID != g_ShadowBuffer.GetVersionID())
+               m_SunShadowCache.Invalidate();
+           m_ShadowCacheScene = activeScene;
+           m_ShadowCacheBufferID = g_ShadowBuffer.GetVersionID();
+
+           m_ShadowCasters.Clear();
+           m_ShadowCasterVersions.clear();
+           m_Scenes[activeScene].GatherCasterBounds(m_ShadowCasters, &m_ShadowCasterVersions);
 
-           shadowSorter.Sort();
-           shadowSorter.RenderMeshes(MeshSorter::kZPass, gfxContext, globals);
+           const Vector3 shadowEye = m_SunShadowCamera.GetPosition();
+           const ShadowCache::ViewState shadowState =
+           {
+               { -(float)SunDirection.GetX(), -(float)SunDirection.GetY(), -(float)SunDirection.GetZ() },
+               { (float)shadowEye.GetX(), (float)shadowEye.GetY(), (float)shadowEye.GetZ() },
+               { 5000.0f, 3000.0f, 3000.0f },
+               (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight()
+           };
+           const ShadowCache::FrameResult shadowFrame = m_SunShadowCache.Update(shadowState, m_ShadowCasters, m_ShadowCasterVersions);
+
+           if (!shadowFrame.m_DirtyRect.IsEmpty())
+           {
+               MeshSorter shadowSorter(MeshSorter::kShadows);
+               shadowSorter.SetCamera(m_SunShadowCamera);
+               shadowSorter.SetDepthStencilTarget(g_ShadowBuffer);
+
+               // [AZB]: The casters were gathered for the cache anyway, so one SIMD pass over them against the shadow camera's box (grown by a
+               //        texel for its snapping) rules out most before the sorter transforms and tests them one at a time. The box is what the
+               //        camera renders, so this only ever drops meshes the sorter would have dropped, and ones it only caught at its corners
+               const float shadowCenter[3] = { (float)ShadowCenter.GetX(), (float)ShadowCenter.GetY(), (float)ShadowCenter.GetZ() };
+               const ShadowCascades::Cascade shadowBox = ShadowCascades::MakeFixedCascade(shadowState.m_LightDirection, shadowCenter, shadowState.m_Bounds,
+                   std::min(shadowState.m_Width, shadowState.m_Height), 16);
+               ShadowCascades::CullCasters(m_ShadowCasters, ShadowCascades::MakeLightBasis(shadowState.m_LightDirection), &shadowBox, 1, m_ShadowCasterMasks);
+               shadowSorter.SetCasterMasks(m_ShadowCasterMasks.data(), m_ShadowCasters.GetCount(), 1);
+
+               if (!shadowFrame.m_bFullRedraw)
+               {
+                   // The shadow camera's orthographic projection narrowed to the dirty rect, for culling casters against
+                   const float* dirtyView = shadowFrame.m_DirtyView;
+                   Matrix4 dirtyProj = m_SunShadowCamera.GetProjMatrix();
+                   dirtyProj.SetX(Vector4(2.0f / (dirtyView[1] - dirtyView[0]), 0.0f, 0.0f, 0.0f));
+                   dirtyProj.SetY(Vector4(0.0f, 2.0f / (dirtyView[3] - dirtyView[2]), 0.0f, 0.0f));
+                   dirtyProj.SetW(Vector4(-(dirtyView[1] + dirtyView[0]) / (dirtyView[1] - dirtyView[0]),
+                       -(dirtyView[3] + dirtyView[2]) / (dirtyView[3] - dirtyView[2]), dirtyProj.GetW().GetZ(), 1.0f));
+
+                   const ShadowCache::Rect& dirtyRect = shadowFrame.m_DirtyRect;
+                   shadowSorter.SetDirtyRegion(CD3DX12_RECT((LONG)dirtyRect.m_Left, (LONG)dirtyRect.m_Top, (LONG)dirtyRect.m_Right, (LONG)dirtyRect.m_Bottom),
+                       Frustum(dirtyProj));
+               }
+
+               m_Scenes[activeScene].Render(shadowSorter);
+
+               shadowSorter.Sort();
+               shadowSorter.RenderMeshes(MeshSorter::kZPass, gfxContext, globals);
+           }
         }
 
         gfxContext.TransitionResource(g_SceneColorBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET, true);